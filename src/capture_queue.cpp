@@ -0,0 +1,761 @@
+#include "capture_queue.h"
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include <png.h>
+#include <pbkit/pbkit.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "debug_output.h"
+#include "depth_conversion.h"
+#include "qoi_encoder.h"
+#include "sdl_subsystems.h"
+#include "texture_swizzle.h"
+
+static void SplitTargetFile(const std::string &target_file, std::string &directory, std::string &name);
+static SDL_RWops *CreateVectorRWops(std::vector<uint8_t> &buffer);
+static bool EncodeGrayPNG(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t bytes_per_pixel,
+                          std::vector<uint8_t> &output);
+
+CaptureQueue::CaptureQueue(uint32_t num_staging_buffers) : sink_(std::make_unique<FileResultSink>()) {
+  ASSERT(num_staging_buffers && "At least one staging buffer is required.");
+
+  InitializeCriticalSection(&lock_);
+  work_available_event_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  buffer_available_event_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  idle_event_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  ASSERT(work_available_event_ && buffer_available_event_ && idle_event_ && "Failed to create capture queue events.");
+
+  // Buffers are grown on demand so that the pool adapts to whatever surface sizes are actually captured.
+  staging_buffers_.resize(num_staging_buffers);
+  for (uint32_t i = 0; i < num_staging_buffers; ++i) {
+    free_staging_buffers_.push_back(i);
+  }
+
+  worker_thread_ = CreateThread(nullptr, 0, ThreadProc, this, 0, nullptr);
+  ASSERT(worker_thread_ && "Failed to create capture worker thread.");
+}
+
+CaptureQueue::~CaptureQueue() {
+  Flush();
+  sink_.reset();
+
+  EnterCriticalSection(&lock_);
+  shutdown_requested_ = true;
+  LeaveCriticalSection(&lock_);
+  SetEvent(work_available_event_);
+
+  WaitForSingleObject(worker_thread_, INFINITE);
+  CloseHandle(worker_thread_);
+  CloseHandle(work_available_event_);
+  CloseHandle(buffer_available_event_);
+  CloseHandle(idle_event_);
+  DeleteCriticalSection(&lock_);
+}
+
+const char *CaptureQueue::GetFileExtension(ImageFormat format) {
+  switch (format) {
+    case FORMAT_PNG:
+      return ".png";
+
+    case FORMAT_RAW:
+      return ".raw";
+
+    case FORMAT_QOI:
+      return ".qoi";
+  }
+
+  return "";
+}
+
+void CaptureQueue::Enqueue(const std::string &target_file, ImageFormat format, const void *pixels, int width,
+                           int height, int depth, int pitch, uint32_t sdl_pixel_format, bool swizzled) {
+  Capture capture{target_file, format, 0, width, height, depth, pitch, sdl_pixel_format, swizzled};
+  capture.is_depth_stencil = false;
+  EnqueueCapture(std::move(capture), pixels, pitch * height);
+}
+
+void CaptureQueue::EnqueueDepthStencil(const std::string &depth_target_file, const std::string &stencil_target_file,
+                                       ImageFormat format, const void *pixels, int width, int height, int pitch,
+                                       uint32_t depth_format, bool float_mode, float max_depth) {
+  int depth = depth_format == NV097_SET_SURFACE_FORMAT_ZETA_Z16 ? 16 : 32;
+  Capture capture{depth_target_file, format, 0, width, height, depth, pitch, 0, false};
+  capture.is_depth_stencil = true;
+  capture.stencil_target_file = stencil_target_file;
+  capture.depth_format = depth_format;
+  capture.float_mode = float_mode;
+  capture.max_depth = max_depth;
+  EnqueueCapture(std::move(capture), pixels, pitch * height);
+}
+
+void CaptureQueue::EnqueueCapture(Capture &&capture, const void *pixels, uint32_t size) {
+  capture.staging_buffer = AcquireStagingBuffer();
+
+  // The source is typically write-combined AGP memory, so take a single linear pass over it and let the (slow) encode
+  // operate on cached memory.
+  auto &buffer = staging_buffers_[capture.staging_buffer];
+  if (buffer.size() < size) {
+    buffer.resize(size);
+  }
+  memcpy(buffer.data(), pixels, size);
+
+  EnterCriticalSection(&lock_);
+  pending_captures_.push_back(std::move(capture));
+  ++num_in_flight_;
+  LeaveCriticalSection(&lock_);
+
+  SetEvent(work_available_event_);
+}
+
+void CaptureQueue::Flush() {
+  while (true) {
+    EnterCriticalSection(&lock_);
+    uint32_t in_flight = num_in_flight_;
+    LeaveCriticalSection(&lock_);
+
+    if (!in_flight) {
+      break;
+    }
+
+    WaitForSingleObject(idle_event_, INFINITE);
+  }
+
+  if (skip_unchanged_) {
+    SaveResultManifests();
+  }
+  if (compare_with_golden_) {
+    SaveComparisonResults();
+  }
+
+  if (!sink_->Flush()) {
+    PrintMsg("Failed to flush result sink\n");
+  }
+}
+
+void CaptureQueue::SetArchiveResults(bool enable) {
+  archive_results_ = enable;
+  if (enable) {
+    sink_ = std::make_unique<ArchiveResultSink>(kArchiveFilename);
+  } else {
+    sink_ = std::make_unique<FileResultSink>();
+  }
+}
+
+void CaptureQueue::SetCompareWithGolden(bool enable, uint8_t tolerance) {
+  compare_with_golden_ = enable;
+  comparison_tolerance_ = tolerance;
+}
+
+const std::vector<CaptureQueue::ComparisonResult> &CaptureQueue::GetComparisonResults(
+    const std::string &output_directory) const {
+  static const std::vector<ComparisonResult> kEmpty;
+  auto it = comparison_results_.find(output_directory);
+  return it == comparison_results_.end() ? kEmpty : it->second;
+}
+
+const CaptureQueue::ComparisonResult *CaptureQueue::FindComparisonResult(const std::string &target_file) const {
+  std::string directory;
+  std::string name;
+  SplitTargetFile(target_file, directory, name);
+
+  auto it = comparison_results_.find(directory);
+  if (it == comparison_results_.end()) {
+    return nullptr;
+  }
+  for (auto &result : it->second) {
+    if (result.name == name) {
+      return &result;
+    }
+  }
+  return nullptr;
+}
+
+const CaptureQueue::CaptureRecord *CaptureQueue::FindCaptureRecord(const std::string &target_file) const {
+  auto it = capture_records_.find(target_file);
+  return it == capture_records_.end() ? nullptr : &it->second;
+}
+
+void CaptureQueue::SetResultSink(std::unique_ptr<ResultSink> sink) {
+  ASSERT(sink && "Result sink must not be null.");
+  archive_results_ = false;
+  sink_ = std::move(sink);
+}
+
+DWORD WINAPI CaptureQueue::ThreadProc(LPVOID param) {
+  auto queue = reinterpret_cast<CaptureQueue *>(param);
+  queue->ProcessCaptures();
+  return 0;
+}
+
+void CaptureQueue::ProcessCaptures() {
+  while (true) {
+    WaitForSingleObject(work_available_event_, INFINITE);
+
+    while (true) {
+      EnterCriticalSection(&lock_);
+      if (pending_captures_.empty()) {
+        bool shutdown = shutdown_requested_;
+        LeaveCriticalSection(&lock_);
+        if (shutdown) {
+          return;
+        }
+        break;
+      }
+
+      Capture capture = std::move(pending_captures_.front());
+      pending_captures_.pop_front();
+      LeaveCriticalSection(&lock_);
+
+      WriteCapture(capture);
+      ReleaseStagingBuffer(capture.staging_buffer);
+
+      EnterCriticalSection(&lock_);
+      bool idle = --num_in_flight_ == 0;
+      LeaveCriticalSection(&lock_);
+      if (idle) {
+        SetEvent(idle_event_);
+      }
+    }
+  }
+}
+
+void CaptureQueue::WriteCapture(const Capture &capture) {
+  const uint8_t *pixels = staging_buffers_[capture.staging_buffer].data();
+
+  CaptureRecord *record = nullptr;
+  uint32_t hash = 0;
+  if (skip_unchanged_ || record_results_) {
+    hash = HashSurface(pixels, capture.width, capture.height, capture.pitch, capture.depth / 8);
+  }
+  if (record_results_) {
+    record = &capture_records_[capture.target_file];
+    *record = {hash, false};
+  }
+
+  if (skip_unchanged_ && MatchesGoldenResult(capture, hash)) {
+    return;
+  }
+
+  if (capture.is_depth_stencil) {
+    WriteDepthStencil(capture, pixels);
+    if (record) {
+      record->written = true;
+    }
+    return;
+  }
+
+  const bool compare =
+      compare_with_golden_ && capture.depth == 32 && capture.sdl_pixel_format == SDL_PIXELFORMAT_ARGB8888;
+
+  Capture linear = capture;
+  const uint8_t *linear_pixels = pixels;
+  if (capture.swizzled && (compare || capture.format != FORMAT_RAW)) {
+    const uint32_t bytes_per_pixel = capture.depth / 8;
+    const uint32_t pitch = capture.width * bytes_per_pixel;
+    if (unswizzle_buffer_.size() < pitch * capture.height) {
+      unswizzle_buffer_.resize(pitch * capture.height);
+    }
+    UnswizzleRect(pixels, capture.width, capture.height, unswizzle_buffer_.data(), pitch, bytes_per_pixel);
+
+    linear.pitch = static_cast<int>(pitch);
+    linear.swizzled = false;
+    linear_pixels = unswizzle_buffer_.data();
+  }
+
+  if (compare && CompareWithGolden(linear, linear_pixels)) {
+    return;
+  }
+  if (record) {
+    record->written = true;
+  }
+
+  if (capture.format == FORMAT_RAW) {
+    // Raw captures preserve the surface layout and flag swizzled data in their header.
+    WriteRaw(capture, pixels);
+    return;
+  }
+
+  WriteEncoded(linear, linear_pixels);
+}
+
+void CaptureQueue::WriteEncoded(const Capture &capture, const uint8_t *pixels) {
+  switch (capture.format) {
+    case FORMAT_PNG:
+      WritePNG(capture, pixels);
+      break;
+
+    case FORMAT_QOI:
+      WriteQOI(capture, pixels);
+      break;
+
+    case FORMAT_RAW:
+      WriteRaw(capture, pixels);
+      break;
+  }
+}
+
+void CaptureQueue::WritePNG(const Capture &capture, const uint8_t *pixels) {
+  SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom((void *)pixels, capture.width, capture.height,
+                                                            capture.depth, capture.pitch, capture.sdl_pixel_format);
+
+  // Encode to memory so that the sink receives the result in a single write rather than many small ones.
+  encode_buffer_.clear();
+  if (!SDLSubsystems::EnsureImageSupport() || IMG_SavePNG_RW(surface, CreateVectorRWops(encode_buffer_), 1)) {
+    PrintMsg("Failed to encode PNG file '%s'\n", capture.target_file.c_str());
+    ASSERT(!"Failed to encode PNG file.");
+  }
+  Emit(capture.target_file, encode_buffer_.data(), encode_buffer_.size());
+
+  SDL_FreeSurface(surface);
+}
+
+void CaptureQueue::WriteRaw(const Capture &capture, const uint8_t *pixels) {
+  RawCaptureHeader header{{'N', 'X', 'R', 'W'},
+                          kRawCaptureVersion,
+                          static_cast<uint32_t>(capture.width),
+                          static_cast<uint32_t>(capture.height),
+                          static_cast<uint32_t>(capture.pitch),
+                          capture.sdl_pixel_format,
+                          capture.swizzled ? 1U : 0U};
+
+  Emit(capture.target_file, &header, sizeof(header), pixels, capture.pitch * capture.height);
+}
+
+void CaptureQueue::WriteQOI(const Capture &capture, const uint8_t *pixels) {
+  SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom((void *)pixels, capture.width, capture.height,
+                                                            capture.depth, capture.pitch, capture.sdl_pixel_format);
+
+  // QOI operates on RGBA bytes, anything else is converted first (as IMG_SavePNG would do internally).
+  SDL_Surface *rgba = surface;
+  if (capture.sdl_pixel_format != SDL_PIXELFORMAT_RGBA32) {
+    rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    ASSERT(rgba && "Failed to convert surface for QOI encoding.");
+  }
+
+  encode_buffer_.clear();
+  QOIEncode(static_cast<const uint8_t *>(rgba->pixels), rgba->w, rgba->h, rgba->pitch, encode_buffer_);
+  Emit(capture.target_file, encode_buffer_.data(), encode_buffer_.size());
+
+  if (rgba != surface) {
+    SDL_FreeSurface(rgba);
+  }
+  SDL_FreeSurface(surface);
+}
+
+void CaptureQueue::WriteDepthStencil(const Capture &capture, const uint8_t *pixels) {
+  const auto width = static_cast<uint32_t>(capture.width);
+  const auto height = static_cast<uint32_t>(capture.height);
+  const bool has_stencil = capture.depth_format == NV097_SET_SURFACE_FORMAT_ZETA_Z24S8;
+
+  depth_plane_.resize(width * height);
+  if (has_stencil) {
+    stencil_plane_.resize(width * height);
+  }
+
+  ConvertDepthStencil(pixels, width, height, capture.pitch, capture.depth_format, capture.float_mode,
+                      capture.max_depth, depth_plane_.data(), has_stencil ? stencil_plane_.data() : nullptr);
+
+  WritePlane(capture.target_file, capture.format, reinterpret_cast<const uint8_t *>(depth_plane_.data()), width,
+             height, 2);
+  if (has_stencil) {
+    WritePlane(capture.stencil_target_file, capture.format, stencil_plane_.data(), width, height, 1);
+  }
+}
+
+void CaptureQueue::WritePlane(const std::string &target_file, ImageFormat format, const uint8_t *pixels,
+                              uint32_t width, uint32_t height, uint32_t bytes_per_pixel) {
+  const uint32_t size = width * height * bytes_per_pixel;
+
+  switch (format) {
+    case FORMAT_PNG:
+      encode_buffer_.clear();
+      if (!EncodeGrayPNG(pixels, width, height, bytes_per_pixel, encode_buffer_)) {
+        PrintMsg("Failed to encode PNG file '%s'\n", target_file.c_str());
+        ASSERT(!"Failed to encode PNG file.");
+      }
+      Emit(target_file, encode_buffer_.data(), encode_buffer_.size());
+      break;
+
+    case FORMAT_RAW: {
+      RawCaptureHeader header{{'N', 'X', 'R', 'W'},
+                              kRawCaptureVersion,
+                              width,
+                              height,
+                              width * bytes_per_pixel,
+                              bytes_per_pixel == 2 ? kRawPixelFormatGray16 : kRawPixelFormatGray8,
+                              0};
+      Emit(target_file, &header, sizeof(header), pixels, size);
+    } break;
+
+    case FORMAT_QOI: {
+      conversion_buffer_.resize(width * height * 4);
+      uint8_t *out = conversion_buffer_.data();
+      if (bytes_per_pixel == 2) {
+        auto in = reinterpret_cast<const uint16_t *>(pixels);
+        for (uint32_t i = 0; i < width * height; ++i) {
+          *out++ = in[i] >> 8;
+          *out++ = in[i] & 0xFF;
+          *out++ = 0;
+          *out++ = 0xFF;
+        }
+      } else {
+        for (uint32_t i = 0; i < width * height; ++i) {
+          *out++ = pixels[i];
+          *out++ = pixels[i];
+          *out++ = pixels[i];
+          *out++ = 0xFF;
+        }
+      }
+
+      encode_buffer_.clear();
+      QOIEncode(conversion_buffer_.data(), width, height, width * 4, encode_buffer_);
+      Emit(target_file, encode_buffer_.data(), encode_buffer_.size());
+    } break;
+  }
+}
+
+bool CaptureQueue::MatchesGoldenResult(const Capture &capture, uint32_t hash) {
+  std::string directory;
+  std::string name;
+  SplitTargetFile(capture.target_file, directory, name);
+
+  result_manifests_[directory].Set(name, hash);
+
+  auto golden = golden_manifests_.find(directory);
+  if (golden == golden_manifests_.end()) {
+    golden = golden_manifests_.emplace(directory, HashManifest()).first;
+    golden->second.Load(directory + "\\" + kGoldenManifestFilename);
+  }
+
+  uint32_t golden_hash;
+  return golden->second.Lookup(name, golden_hash) && golden_hash == hash;
+}
+
+void CaptureQueue::SaveResultManifests() {
+  for (auto &entry : result_manifests_) {
+    std::string path = entry.first + "\\" + kResultManifestFilename;
+    if (!entry.second.Save(path)) {
+      PrintMsg("Failed to save hash manifest '%s'\n", path.c_str());
+    }
+  }
+}
+
+bool CaptureQueue::CompareWithGolden(const Capture &capture, const uint8_t *pixels) {
+  std::string directory;
+  std::string name;
+  SplitTargetFile(capture.target_file, directory, name);
+
+  // Repeated captures of the same result (e.g., when a test is rerun) replace the earlier comparison.
+  auto &results = comparison_results_[directory];
+  auto existing = std::find_if(results.begin(), results.end(),
+                               [&name](const ComparisonResult &entry) { return entry.name == name; });
+  if (existing == results.end()) {
+    existing = results.insert(results.end(), ComparisonResult{name, COMPARISON_MISSING, {}});
+  }
+  ComparisonResult &result = *existing;
+  result.status = COMPARISON_MISSING;
+  result.metrics = {};
+
+  const GoldenImage *golden = LoadGoldenImage(directory, name);
+  if (!golden) {
+    return false;
+  }
+
+  const auto width = static_cast<uint32_t>(capture.width);
+  const auto height = static_cast<uint32_t>(capture.height);
+  const uint32_t factor = width / golden->width;
+  if (!factor || (factor & (factor - 1)) || golden->width * factor != width || golden->height * factor != height) {
+    PrintMsg("Ignoring golden image for '%s', %ux%u does not evenly divide %ux%u\n", capture.target_file.c_str(),
+             golden->width, golden->height, width, height);
+    return false;
+  }
+
+  uint32_t pitch = capture.pitch;
+  if (factor > 1) {
+    downsample_buffer_.resize(golden->width * golden->height * 4);
+    DownsampleBox(pixels, pitch, width, height, factor, downsample_buffer_.data());
+    pixels = downsample_buffer_.data();
+    pitch = golden->width * 4;
+  }
+
+  const uint32_t golden_pitch = golden->width * 4;
+  DiffImages(pixels, pitch, golden->pixels.data(), golden_pitch, golden->width, golden->height, comparison_tolerance_,
+             result.metrics);
+  result.status = result.metrics.mismatched_pixels ? COMPARISON_FAILED : COMPARISON_PASSED;
+
+  if (result.status == COMPARISON_PASSED) {
+    return true;
+  }
+
+  heatmap_.resize(golden->width * golden->height);
+  RenderDiffHeatmap(pixels, pitch, golden->pixels.data(), golden_pitch, golden->width, golden->height,
+                    heatmap_.data());
+  WritePlane(directory + "\\" + name + kDiffHeatmapSuffix + GetFileExtension(capture.format), capture.format,
+             heatmap_.data(), golden->width, golden->height, 1);
+  return false;
+}
+
+// Reads a FORMAT_RAW capture of a linear ARGB8888 surface into tightly packed `pixels`.
+static bool LoadRawGoldenImage(const std::string &path, uint32_t &width, uint32_t &height,
+                               std::vector<uint8_t> &pixels) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp) {
+    return false;
+  }
+
+  CaptureQueue::RawCaptureHeader header{};
+  bool valid = fread(&header, sizeof(header), 1, fp) == 1 && !memcmp(header.magic, "NXRW", 4) &&
+               header.sdl_pixel_format == SDL_PIXELFORMAT_ARGB8888 && !header.swizzled &&
+               header.pitch >= header.width * 4;
+  if (valid) {
+    width = header.width;
+    height = header.height;
+    pixels.resize(width * height * 4);
+    for (uint32_t y = 0; y < height && valid; ++y) {
+      valid = fread(pixels.data() + y * width * 4, width * 4, 1, fp) == 1 &&
+              (header.pitch == width * 4 || !fseek(fp, static_cast<long>(header.pitch - width * 4), SEEK_CUR));
+    }
+  }
+
+  fclose(fp);
+  return valid;
+}
+
+static bool LoadPNGGoldenImage(const std::string &path, uint32_t &width, uint32_t &height,
+                               std::vector<uint8_t> &pixels) {
+  if (!SDLSubsystems::EnsureImageSupport()) {
+    return false;
+  }
+
+  SDL_Surface *surface = IMG_Load(path.c_str());
+  if (!surface) {
+    return false;
+  }
+
+  SDL_Surface *argb = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+  SDL_FreeSurface(surface);
+  if (!argb) {
+    return false;
+  }
+
+  width = argb->w;
+  height = argb->h;
+  pixels.resize(width * height * 4);
+  for (uint32_t y = 0; y < height; ++y) {
+    memcpy(pixels.data() + y * width * 4, static_cast<const uint8_t *>(argb->pixels) + y * argb->pitch, width * 4);
+  }
+  SDL_FreeSurface(argb);
+  return true;
+}
+
+const CaptureQueue::GoldenImage *CaptureQueue::LoadGoldenImage(const std::string &directory,
+                                                               const std::string &name) {
+  if (directory != golden_image_directory_) {
+    golden_images_.clear();
+    golden_image_directory_ = directory;
+  }
+
+  auto it = golden_images_.find(name);
+  if (it == golden_images_.end()) {
+    GoldenImage image;
+    std::string path = directory + "\\" + kGoldenImageDirectory + "\\" + name;
+    if (!LoadRawGoldenImage(path + GetFileExtension(FORMAT_RAW), image.width, image.height, image.pixels) &&
+        !LoadPNGGoldenImage(path + GetFileExtension(FORMAT_PNG), image.width, image.height, image.pixels)) {
+      image.pixels.clear();
+    }
+    it = golden_images_.emplace(name, std::move(image)).first;
+  }
+
+  return it->second.pixels.empty() ? nullptr : &it->second;
+}
+
+void CaptureQueue::SaveComparisonResults() {
+  static constexpr const char *kStatusNames[] = {"missing", "passed", "failed"};
+
+  for (auto &entry : comparison_results_) {
+    std::string contents = "name,status,max_error_r,max_error_g,max_error_b,max_error_a,mismatched_pixels,psnr\n";
+    char line[256];
+    for (auto &result : entry.second) {
+      auto &metrics = result.metrics;
+      snprintf(line, sizeof(line), "%s,%s,%u,%u,%u,%u,%u,%.2f\n", result.name.c_str(), kStatusNames[result.status],
+               metrics.max_error[2], metrics.max_error[1], metrics.max_error[0], metrics.max_error[3],
+               metrics.mismatched_pixels, result.status == COMPARISON_MISSING ? 0.0 : metrics.psnr);
+      contents += line;
+    }
+
+    std::string path = entry.first + "\\" + kImageDiffFilename;
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp || fwrite(contents.data(), contents.size(), 1, fp) != 1) {
+      PrintMsg("Failed to save image diff results '%s'\n", path.c_str());
+    }
+    if (fp) {
+      fclose(fp);
+    }
+  }
+}
+
+void CaptureQueue::Emit(const std::string &target_file, const void *data, uint32_t size, const void *data2,
+                        uint32_t size2) {
+  if (!sink_->Write(target_file, data, size, data2, size2)) {
+    PrintMsg("Failed to write result '%s'\n", target_file.c_str());
+    ASSERT(!"Failed to write result.");
+  }
+}
+
+uint32_t CaptureQueue::AcquireStagingBuffer() {
+  while (true) {
+    EnterCriticalSection(&lock_);
+    if (!free_staging_buffers_.empty()) {
+      uint32_t index = free_staging_buffers_.back();
+      free_staging_buffers_.pop_back();
+      LeaveCriticalSection(&lock_);
+      return index;
+    }
+    LeaveCriticalSection(&lock_);
+
+    WaitForSingleObject(buffer_available_event_, INFINITE);
+  }
+}
+
+void CaptureQueue::ReleaseStagingBuffer(uint32_t index) {
+  EnterCriticalSection(&lock_);
+  free_staging_buffers_.push_back(index);
+  LeaveCriticalSection(&lock_);
+
+  SetEvent(buffer_available_event_);
+}
+
+// Splits a full output path into the containing directory and the filename without its extension.
+static void SplitTargetFile(const std::string &target_file, std::string &directory, std::string &name) {
+  auto slash = target_file.rfind('\\');
+  if (slash == std::string::npos) {
+    directory.clear();
+    name = target_file;
+  } else {
+    directory = target_file.substr(0, slash);
+    name = target_file.substr(slash + 1);
+  }
+
+  auto dot = name.rfind('.');
+  if (dot != std::string::npos) {
+    name.resize(dot);
+  }
+}
+
+// SDL_RWops implementation that appends to a std::vector.
+struct VectorStream {
+  std::vector<uint8_t> *buffer;
+  size_t position;
+};
+
+static Sint64 SDLCALL VectorSize(SDL_RWops *context) {
+  auto stream = static_cast<VectorStream *>(context->hidden.unknown.data1);
+  return static_cast<Sint64>(stream->buffer->size());
+}
+
+static Sint64 SDLCALL VectorSeek(SDL_RWops *context, Sint64 offset, int whence) {
+  auto stream = static_cast<VectorStream *>(context->hidden.unknown.data1);
+  Sint64 base = 0;
+  if (whence == RW_SEEK_CUR) {
+    base = static_cast<Sint64>(stream->position);
+  } else if (whence == RW_SEEK_END) {
+    base = static_cast<Sint64>(stream->buffer->size());
+  }
+
+  Sint64 position = base + offset;
+  if (position < 0) {
+    return -1;
+  }
+  stream->position = static_cast<size_t>(position);
+  return position;
+}
+
+static size_t SDLCALL VectorRead(SDL_RWops *context, void *ptr, size_t size, size_t num) {
+  auto stream = static_cast<VectorStream *>(context->hidden.unknown.data1);
+  size_t available = stream->position < stream->buffer->size() ? stream->buffer->size() - stream->position : 0;
+  size_t count = size ? std::min(num, available / size) : 0;
+  memcpy(ptr, stream->buffer->data() + stream->position, count * size);
+  stream->position += count * size;
+  return count;
+}
+
+static size_t SDLCALL VectorWrite(SDL_RWops *context, const void *ptr, size_t size, size_t num) {
+  auto stream = static_cast<VectorStream *>(context->hidden.unknown.data1);
+  size_t length = size * num;
+  if (stream->position + length > stream->buffer->size()) {
+    stream->buffer->resize(stream->position + length);
+  }
+  memcpy(stream->buffer->data() + stream->position, ptr, length);
+  stream->position += length;
+  return num;
+}
+
+static int SDLCALL VectorClose(SDL_RWops *context) {
+  delete static_cast<VectorStream *>(context->hidden.unknown.data1);
+  SDL_FreeRW(context);
+  return 0;
+}
+
+static SDL_RWops *CreateVectorRWops(std::vector<uint8_t> &buffer) {
+  SDL_RWops *ret = SDL_AllocRW();
+  ASSERT(ret && "Failed to allocate SDL_RWops.");
+
+  ret->size = VectorSize;
+  ret->seek = VectorSeek;
+  ret->read = VectorRead;
+  ret->write = VectorWrite;
+  ret->close = VectorClose;
+  ret->type = SDL_RWOPS_UNKNOWN;
+  ret->hidden.unknown.data1 = new VectorStream{&buffer, 0};
+  return ret;
+}
+
+static void PNGWriteToVector(png_structp png, png_bytep data, png_size_t length) {
+  auto output = static_cast<std::vector<uint8_t> *>(png_get_io_ptr(png));
+  output->insert(output->end(), data, data + length);
+}
+
+static void PNGFlush(png_structp png) {}
+
+// Encodes a grayscale image via libpng directly, as SDL_image does not support 16-bit channels.
+static bool EncodeGrayPNG(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t bytes_per_pixel,
+                          std::vector<uint8_t> &output) {
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+  if (!png) {
+    return false;
+  }
+
+  png_infop info = png_create_info_struct(png);
+  if (!info) {
+    png_destroy_write_struct(&png, nullptr);
+    return false;
+  }
+
+  if (setjmp(png_jmpbuf(png))) {
+    png_destroy_write_struct(&png, &info);
+    return false;
+  }
+
+  png_set_write_fn(png, &output, PNGWriteToVector, PNGFlush);
+  png_set_IHDR(png, info, width, height, static_cast<int>(bytes_per_pixel * 8), PNG_COLOR_TYPE_GRAY,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png, info);
+
+  // PNG stores 16-bit samples as big endian.
+  if (bytes_per_pixel == 2) {
+    png_set_swap(png);
+  }
+
+  const uint32_t row_size = width * bytes_per_pixel;
+  for (uint32_t y = 0; y < height; ++y) {
+    png_write_row(png, pixels + y * row_size);
+  }
+
+  png_write_end(png, nullptr);
+  png_destroy_write_struct(&png, &info);
+  return true;
+}
@@ -0,0 +1,245 @@
+#ifndef NXDK_PGRAPH_TESTS_CAPTURE_QUEUE_H
+#define NXDK_PGRAPH_TESTS_CAPTURE_QUEUE_H
+
+#include <windows.h>
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hash_manifest.h"
+#include "image_diff.h"
+#include "result_sink.h"
+
+// Snapshots surfaces into cached staging buffers and writes them out on a worker thread, allowing rendering to
+// continue while previous results are encoded and written to disk.
+class CaptureQueue {
+ public:
+  enum ImageFormat {
+    // zlib compressed PNG via SDL_image.
+    FORMAT_PNG,
+    // Uncompressed copy of the surface prefixed with a RawCaptureHeader.
+    FORMAT_RAW,
+    // "Quite OK Image" format, lossless and far cheaper to encode than PNG.
+    FORMAT_QOI,
+  };
+
+  // Header prepended to FORMAT_RAW captures. All fields are little endian.
+  struct RawCaptureHeader {
+    char magic[4];  // "NXRW"
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint32_t sdl_pixel_format;
+    uint32_t swizzled;
+  } __attribute__((packed));
+
+  static constexpr uint32_t kRawCaptureVersion = 1;
+
+  // Values used in RawCaptureHeader::sdl_pixel_format for single channel planes that have no SDL equivalent.
+  static constexpr uint32_t kRawPixelFormatGray8 = 0xFFFF0008;
+  static constexpr uint32_t kRawPixelFormatGray16 = 0xFFFF0010;
+
+  // Manifest of known-good hashes that is consulted when skipping unchanged results.
+  static constexpr const char *kGoldenManifestFilename = "golden_hashes.txt";
+  // Manifest of the hashes of every result captured in a given directory, written by Flush.
+  static constexpr const char *kResultManifestFilename = "hashes.txt";
+  // Container holding all results from a given directory when archiving is enabled.
+  static constexpr const char *kArchiveFilename = "results.nxpk";
+  // Subdirectory of each output directory holding reference images for golden comparison, named after the result with
+  // a .raw (ARGB8888) or .png extension. References may be downsampled by a power of two.
+  static constexpr const char *kGoldenImageDirectory = "golden";
+  // Table of the metrics of every result compared against a golden image in a given directory, written by Flush.
+  static constexpr const char *kImageDiffFilename = "image_diff.csv";
+  // Suffix appended to the name of a failing result to form the name of its difference heatmap.
+  static constexpr const char *kDiffHeatmapSuffix = "_diff";
+
+  enum ComparisonStatus {
+    // No reference image exists, so the result was written out.
+    COMPARISON_MISSING,
+    // Every pixel is within the tolerance, so the result was not written.
+    COMPARISON_PASSED,
+    // The result and its heatmap were written.
+    COMPARISON_FAILED,
+  };
+
+  struct ComparisonResult {
+    std::string name;
+    ComparisonStatus status;
+    ImageDiffMetrics metrics;
+  };
+
+  // Outcome of a single capture, kept when result recording is enabled.
+  struct CaptureRecord {
+    // See HashSurface, computed over the surface as captured (i.e., before unswizzling or depth conversion).
+    uint32_t hash;
+    // False if the result was not written because it matched its golden hash or image.
+    bool written;
+  };
+
+ public:
+  explicit CaptureQueue(uint32_t num_staging_buffers = 4);
+  ~CaptureQueue();
+
+  // Returns the filename extension (including the leading '.') used for the given format.
+  static const char *GetFileExtension(ImageFormat format);
+
+  // Copies the given surface into a staging buffer and queues it to be saved to `target_file`. Blocks if all staging
+  // buffers are in use. Swizzled surfaces are unswizzled before being encoded, except in FORMAT_RAW.
+  void Enqueue(const std::string &target_file, ImageFormat format, const void *pixels, int width, int height,
+               int depth, int pitch, uint32_t sdl_pixel_format, bool swizzled = false);
+
+  // Copies a depth/stencil surface into a staging buffer and queues it to be unpacked into a 16-bit grayscale depth
+  // plane saved to `depth_target_file` and, for Z24S8 surfaces, an 8-bit stencil plane saved to `stencil_target_file`.
+  // See ConvertDepthStencil for a description of `depth_format`, `float_mode`, and `max_depth`.
+  // Note: QOI output stores the high byte of 16-bit depth values in the red channel and the low byte in green.
+  void EnqueueDepthStencil(const std::string &depth_target_file, const std::string &stencil_target_file,
+                           ImageFormat format, const void *pixels, int width, int height, int pitch,
+                           uint32_t depth_format, bool float_mode, float max_depth);
+
+  // Blocks until all previously enqueued captures have been written. If hashing is enabled, the result manifest for
+  // each output directory is also written.
+  void Flush();
+
+  // When enabled, every capture is hashed and results whose hash matches the golden manifest in their output directory
+  // are not written.
+  void SetSkipUnchanged(bool enable = true) { skip_unchanged_ = enable; }
+  bool GetSkipUnchanged() const { return skip_unchanged_; }
+
+  // When enabled, results are appended to a single ResultArchive per output directory rather than written as
+  // individual files. Replaces any sink set via SetResultSink. Must be set before any captures are enqueued.
+  void SetArchiveResults(bool enable = true);
+  bool GetArchiveResults() const { return archive_results_; }
+
+  // Replaces the destination that encoded results are written to. Must be set before any captures are enqueued.
+  void SetResultSink(std::unique_ptr<ResultSink> sink);
+
+  // When enabled, 32bpp color captures are compared against the reference image of the same name in their output
+  // directory's kGoldenImageDirectory. Only results with a channel differing by more than `tolerance` are written, along
+  // with a heatmap of the differences. Must be set before any captures are enqueued.
+  void SetCompareWithGolden(bool enable = true, uint8_t tolerance = 0);
+  bool GetCompareWithGolden() const { return compare_with_golden_; }
+
+  // Returns the results of golden comparisons made in the given output directory. Only valid after Flush.
+  const std::vector<ComparisonResult> &GetComparisonResults(const std::string &output_directory) const;
+  // Returns the golden comparison of the capture saved to `target_file`, or nullptr if it was not compared. Only valid
+  // after Flush.
+  const ComparisonResult *FindComparisonResult(const std::string &target_file) const;
+
+  // When enabled, the hash of every capture and whether it was written are kept for FindCaptureRecord. Must be set
+  // before any captures are enqueued.
+  void SetRecordResults(bool enable = true) { record_results_ = enable; }
+  // Returns the record of the capture enqueued for `target_file`, or nullptr if there is none. Depth/stencil captures
+  // are recorded under their depth target. Only valid after Flush.
+  const CaptureRecord *FindCaptureRecord(const std::string &target_file) const;
+
+ private:
+  struct Capture {
+    std::string target_file;
+    ImageFormat format;
+    uint32_t staging_buffer;
+    int width;
+    int height;
+    int depth;
+    int pitch;
+    uint32_t sdl_pixel_format;
+    bool swizzled;
+
+    // Depth/stencil captures are converted into separate planes before being written.
+    bool is_depth_stencil;
+    std::string stencil_target_file;
+    uint32_t depth_format;
+    bool float_mode;
+    float max_depth;
+  };
+
+  struct GoldenImage {
+    uint32_t width{0};
+    uint32_t height{0};
+    // Tightly packed ARGB8888, empty if no reference exists.
+    std::vector<uint8_t> pixels;
+  };
+
+  void EnqueueCapture(Capture &&capture, const void *pixels, uint32_t size);
+
+  static DWORD WINAPI ThreadProc(LPVOID param);
+  void ProcessCaptures();
+  void WriteCapture(const Capture &capture);
+  // Records the capture's hash in the result manifest, returning true if it matches the golden result.
+  bool MatchesGoldenResult(const Capture &capture, uint32_t hash);
+  void SaveResultManifests();
+  // Compares a linear capture against its reference image, returning true if it passed and need not be written.
+  bool CompareWithGolden(const Capture &capture, const uint8_t *pixels);
+  // Returns the cached reference image for `name` in `directory`, or nullptr if none exists.
+  const GoldenImage *LoadGoldenImage(const std::string &directory, const std::string &name);
+  void SaveComparisonResults();
+
+  // Writes an encoded result to the current ResultSink.
+  void Emit(const std::string &target_file, const void *data, uint32_t size, const void *data2 = nullptr,
+            uint32_t size2 = 0);
+  // Encodes a linear capture in its requested image format.
+  void WriteEncoded(const Capture &capture, const uint8_t *pixels);
+  void WritePNG(const Capture &capture, const uint8_t *pixels);
+  void WriteRaw(const Capture &capture, const uint8_t *pixels);
+  void WriteQOI(const Capture &capture, const uint8_t *pixels);
+  void WriteDepthStencil(const Capture &capture, const uint8_t *pixels);
+  // Writes a tightly packed single channel plane with 1 or 2 bytes per pixel.
+  void WritePlane(const std::string &target_file, ImageFormat format, const uint8_t *pixels, uint32_t width,
+                  uint32_t height, uint32_t bytes_per_pixel);
+
+  uint32_t AcquireStagingBuffer();
+  void ReleaseStagingBuffer(uint32_t index);
+
+ private:
+  CRITICAL_SECTION lock_{};
+  HANDLE worker_thread_{nullptr};
+  HANDLE work_available_event_{nullptr};
+  HANDLE buffer_available_event_{nullptr};
+  HANDLE idle_event_{nullptr};
+
+  std::vector<std::vector<uint8_t>> staging_buffers_;
+  std::vector<uint32_t> free_staging_buffers_;
+  std::deque<Capture> pending_captures_;
+
+  // Scratch buffers used by the worker thread when encoding.
+  std::vector<uint8_t> encode_buffer_;
+  std::vector<uint8_t> conversion_buffer_;
+  std::vector<uint8_t> unswizzle_buffer_;
+  std::vector<uint16_t> depth_plane_;
+  std::vector<uint8_t> stencil_plane_;
+
+  bool skip_unchanged_{false};
+  // Map of output directory to the known-good and actual results in that directory. Only accessed by the worker thread
+  // or while the queue is idle.
+  std::map<std::string, HashManifest> golden_manifests_;
+  std::map<std::string, HashManifest> result_manifests_;
+
+  bool archive_results_{false};
+  std::unique_ptr<ResultSink> sink_;
+
+  bool compare_with_golden_{false};
+  uint8_t comparison_tolerance_{0};
+  // Reference images are cached for the output directory currently being written, i.e., for the current suite.
+  std::string golden_image_directory_;
+  std::map<std::string, GoldenImage> golden_images_;
+  std::vector<uint8_t> downsample_buffer_;
+  std::vector<uint8_t> heatmap_;
+  // Map of output directory to the comparisons made in that directory. Only accessed by the worker thread or while the
+  // queue is idle.
+  std::map<std::string, std::vector<ComparisonResult>> comparison_results_;
+
+  bool record_results_{false};
+  // Map of target file to the outcome of its most recent capture. Only accessed by the worker thread or while the queue
+  // is idle.
+  std::map<std::string, CaptureRecord> capture_records_;
+
+  // Number of captures that have been enqueued but not yet written.
+  uint32_t num_in_flight_{0};
+  bool shutdown_requested_{false};
+};
+
+#endif  // NXDK_PGRAPH_TESTS_CAPTURE_QUEUE_H
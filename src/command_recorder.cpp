@@ -0,0 +1,110 @@
+#include "command_recorder.h"
+
+#include <pbkit/pbkit.h>
+
+#include <cstring>
+
+#include "debug_output.h"
+
+CommandRecorder *CommandRecorder::active_ = nullptr;
+
+CommandRecorder::CommandRecorder(uint32_t capacity_dwords) {
+  ASSERT(capacity_dwords >= kMaxDwordsPerSubmit && "Command recorder arena is too small.");
+  arena_.resize(capacity_dwords);
+  write_position_ = arena_.data();
+}
+
+CommandRecorder::~CommandRecorder() {
+  if (IsRecording()) {
+    depth_ = 1;
+    Stop();
+  }
+}
+
+void CommandRecorder::Start() {
+  if (depth_++) {
+    return;
+  }
+
+  previous_ = active_;
+  active_ = this;
+}
+
+void CommandRecorder::Stop() {
+  ASSERT(depth_ && "Stop called without a matching Start.");
+  if (--depth_) {
+    return;
+  }
+
+  Flush();
+  ASSERT(active_ == this && "Command recorders must be stopped in the reverse order they were started.");
+  active_ = previous_;
+  previous_ = nullptr;
+}
+
+void CommandRecorder::Flush() {
+  ASSERT(!block_start_ && "Flush called between Begin and End.");
+
+  const uint32_t *base = arena_.data();
+  uint32_t submitted = 0;
+  uint32_t pending_end = 0;
+
+  auto submit = [base](uint32_t start, uint32_t end) {
+    uint32_t count = end - start;
+    auto p = pb_begin();
+    memcpy(p, base + start, count * sizeof(*p));
+    pb_end(p + count);
+  };
+
+  // Greedily pack whole blocks into each submission so that no method's parameters are split across a pushbuffer
+  // wrap.
+  for (auto block_end : block_ends_) {
+    if (block_end - submitted > kMaxDwordsPerSubmit) {
+      submit(submitted, pending_end);
+      submitted = pending_end;
+    }
+    pending_end = block_end;
+  }
+  if (pending_end > submitted) {
+    submit(submitted, pending_end);
+  }
+
+  block_ends_.clear();
+  write_position_ = arena_.data();
+}
+
+void CommandRecorder::FlushActive() {
+  if (active_) {
+    active_->Flush();
+  }
+}
+
+uint32_t *CommandRecorder::Begin() {
+  CommandRecorder *recorder = active_;
+  if (!recorder) {
+    return pb_begin();
+  }
+
+  ASSERT(!recorder->block_start_ && "Begin called while another block is open.");
+  if (recorder->write_position_ + kMaxDwordsPerSubmit > recorder->arena_.data() + recorder->arena_.size()) {
+    recorder->Flush();
+  }
+
+  recorder->block_start_ = recorder->write_position_;
+  return recorder->block_start_;
+}
+
+void CommandRecorder::End(uint32_t *p) {
+  CommandRecorder *recorder = active_;
+  if (!recorder) {
+    pb_end(p);
+    return;
+  }
+
+  ASSERT(recorder->block_start_ && "End called without a matching Begin.");
+  ASSERT(p - recorder->block_start_ <= static_cast<int>(kMaxDwordsPerSubmit) && "Recorded block is too large.");
+
+  recorder->write_position_ = p;
+  recorder->block_start_ = nullptr;
+  recorder->block_ends_.push_back(static_cast<uint32_t>(p - recorder->arena_.data()));
+}
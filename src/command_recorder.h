@@ -0,0 +1,52 @@
+#ifndef NXDK_PGRAPH_TESTS_COMMAND_RECORDER_H
+#define NXDK_PGRAPH_TESTS_COMMAND_RECORDER_H
+
+#include <cstdint>
+#include <vector>
+
+// Records pushbuffer commands into a preallocated arena and submits them to pbkit in as few pb_begin/pb_end pairs as
+// possible.
+//
+// Code that would normally use pb_begin/pb_end may use CommandRecorder::Begin/CommandRecorder::End instead, which
+// write into the active recorder while one is recording and fall through to pbkit otherwise.
+//
+// Commands pushed directly via pb_begin (including those issued internally by pbkit functions like pb_fill) bypass the
+// recorder, so Flush must be called before any such command or GPU wait while recording.
+class CommandRecorder {
+ public:
+  // Maximum number of dwords that may be written to the pushbuffer in a single pb_begin/pb_end pair.
+  static constexpr uint32_t kMaxDwordsPerSubmit = 128;
+
+  explicit CommandRecorder(uint32_t capacity_dwords = 16384);
+  ~CommandRecorder();
+
+  // Begins redirecting CommandRecorder::Begin/End into this recorder. Calls may be nested, recording continues until
+  // the matching outermost Stop.
+  void Start();
+  // Ends recording, submitting any recorded commands.
+  void Stop();
+  bool IsRecording() const { return depth_ > 0; }
+
+  // Submits all recorded commands to the pushbuffer.
+  void Flush();
+
+  // Flushes the active recorder, if any.
+  static void FlushActive();
+
+  // Drop in replacements for pb_begin/pb_end. Recorded blocks must not exceed kMaxDwordsPerSubmit dwords.
+  static uint32_t *Begin();
+  static void End(uint32_t *p);
+
+ private:
+  std::vector<uint32_t> arena_;
+  uint32_t *block_start_{nullptr};
+  uint32_t *write_position_{nullptr};
+  // Offsets into the arena of the end of each recorded block, used to split submissions on packet boundaries.
+  std::vector<uint32_t> block_ends_;
+  uint32_t depth_{0};
+
+  CommandRecorder *previous_{nullptr};
+  static CommandRecorder *active_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_COMMAND_RECORDER_H
@@ -0,0 +1,75 @@
+#include "contiguous_memory_pool.h"
+
+#include <pbkit/pbkit.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+std::vector<void *> ContiguousMemoryPool::free_lists_[kNumClasses];
+uint32_t ContiguousMemoryPool::cached_bytes_ = 0;
+
+uint32_t ContiguousMemoryPool::GetSizeClass(uint32_t size) {
+  uint32_t size_class = 0;
+  while (size_class < kNumClasses && (1u << (size_class + kMinClassShift)) < size) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+uint32_t ContiguousMemoryPool::GetAllocationSize(uint32_t size) {
+  uint32_t size_class = GetSizeClass(size);
+  if (size_class >= kNumClasses) {
+    return size;
+  }
+  return 1u << (size_class + kMinClassShift);
+}
+
+void *ContiguousMemoryPool::AllocateFromKernel(uint32_t size) {
+  return MmAllocateContiguousMemoryEx(size, 0, MAXRAM, 0, PAGE_WRITECOMBINE | PAGE_READWRITE);
+}
+
+void *ContiguousMemoryPool::Allocate(uint32_t size, MemoryTracker::Category category) {
+  const uint32_t allocation_size = GetAllocationSize(size);
+  uint32_t size_class = GetSizeClass(size);
+
+  void *ret = nullptr;
+  if (size_class < kNumClasses && !free_lists_[size_class].empty()) {
+    auto &free_list = free_lists_[size_class];
+    ret = free_list.back();
+    free_list.pop_back();
+    cached_bytes_ -= allocation_size;
+  } else {
+    ret = AllocateFromKernel(allocation_size);
+  }
+
+  if (ret) {
+    MemoryTracker::RecordAllocation(category, allocation_size);
+  }
+  return ret;
+}
+
+void ContiguousMemoryPool::Release(void *block, uint32_t size, MemoryTracker::Category category) {
+  if (!block) {
+    return;
+  }
+
+  const uint32_t allocation_size = GetAllocationSize(size);
+  MemoryTracker::RecordRelease(category, allocation_size);
+
+  uint32_t size_class = GetSizeClass(size);
+  if (size_class >= kNumClasses) {
+    MmFreeContiguousMemory(block);
+    return;
+  }
+
+  free_lists_[size_class].push_back(block);
+  cached_bytes_ += allocation_size;
+}
+
+void ContiguousMemoryPool::Trim() {
+  for (auto &free_list : free_lists_) {
+    for (auto block : free_list) {
+      MmFreeContiguousMemory(block);
+    }
+    free_list.clear();
+  }
+  cached_bytes_ = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef NXDK_PGRAPH_TESTS_CONTIGUOUS_MEMORY_POOL_H
+#define NXDK_PGRAPH_TESTS_CONTIGUOUS_MEMORY_POOL_H
+
+#include <cstdint>
+#include <vector>
+
+#include "memory_tracker.h"
+
+// Size-classed cache of write-combined contiguous memory blocks.
+//
+// Blocks are rounded up to a power of two (minimum one page) and returned to a per-class free list on Release rather
+// than to the kernel, so repeatedly creating and destroying buffers of similar sizes does not hit
+// MmAllocateContiguousMemoryEx and does not fragment contiguous memory over long runs. Requests larger than the
+// largest size class are passed straight through to the kernel.
+//
+// Outstanding blocks are reported to MemoryTracker under the category given by the caller.
+class ContiguousMemoryPool {
+ public:
+  // Returns a block of at least `size` bytes, or nullptr if the allocation failed.
+  static void *Allocate(uint32_t size, MemoryTracker::Category category);
+  // Returns a block obtained from Allocate(`size`, `category`) to the pool.
+  static void Release(void *block, uint32_t size, MemoryTracker::Category category);
+
+  // Returns the number of bytes actually reserved for an allocation of `size` bytes.
+  static uint32_t GetAllocationSize(uint32_t size);
+
+  // Returns all cached blocks to the kernel.
+  static void Trim();
+
+  // Returns the number of bytes held in the free lists.
+  static uint32_t GetCachedBytes() { return cached_bytes_; }
+
+ private:
+  static constexpr uint32_t kMinClassShift = 12;
+  static constexpr uint32_t kMaxClassShift = 22;
+  static constexpr uint32_t kNumClasses = kMaxClassShift - kMinClassShift + 1;
+
+  static uint32_t GetSizeClass(uint32_t size);
+  static void *AllocateFromKernel(uint32_t size);
+
+  static std::vector<void *> free_lists_[kNumClasses];
+  static uint32_t cached_bytes_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_CONTIGUOUS_MEMORY_POOL_H
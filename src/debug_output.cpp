@@ -6,11 +6,21 @@
 
 #include <cstdio>
 
+#include "io_worker.h"
+
 extern "C" {
 void _putchar(char character) { putchar(character); }
 }
 
+void PrintDebugMessage(const char *message, uint32_t length) {
+  if (!IoWorker::LogActive(message, length)) {
+    DbgPrint("%s", message);
+  }
+}
+
 void PrintAssertAndWaitForever(const char *assert_code, const char *filename, uint32_t line) {
+  // Make sure that any messages leading up to the failure are not lost.
+  IoWorker::FlushActive();
   DbgPrint("ASSERT FAILED: '%s' at %s:%d\n", assert_code, filename, line);
   debugPrint("ASSERT FAILED!\n-=[\n\n%s\n\n]=-\nat %s:%d\n", assert_code, filename, line);
   debugPrint("\nHalted, please reboot.\n");
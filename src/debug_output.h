@@ -12,14 +12,21 @@
     PrintAssertAndWaitForever(#c, __FILE__, __LINE__); \
   }
 
+// Longer messages are truncated.
+static constexpr uint32_t kMaxDebugMessageLength = 511;
+
+// Sends the `length` characters of the null terminated `message` to the debug output. Messages from the render thread
+// are queued to the I/O worker (see IoWorker) so that slow serial output does not stall rendering.
+void PrintDebugMessage(const char *message, uint32_t length);
+
 template <typename... VarArgs>
 inline void PrintMsg(const char *fmt, VarArgs &&...args) {
-  int string_length = snprintf_(nullptr, 0, fmt, args...);
-  std::string buf;
-  buf.resize(string_length);
-
-  snprintf_(&buf[0], string_length + 1, fmt, args...);
-  DbgPrint("%s", buf.c_str());
+  char buffer[kMaxDebugMessageLength + 1];
+  int length = snprintf_(buffer, sizeof(buffer), fmt, args...);
+  if (length < 0) {
+    return;
+  }
+  PrintDebugMessage(buffer, length < static_cast<int>(sizeof(buffer)) ? length : sizeof(buffer) - 1);
 }
 
 void PrintAssertAndWaitForever(const char *assert_code, const char *filename, uint32_t line);
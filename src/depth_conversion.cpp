@@ -0,0 +1,107 @@
+#include "depth_conversion.h"
+
+#include <pbkit/pbkit.h>
+
+#ifdef __MMX__
+#include <mmintrin.h>
+#endif
+
+#include <cstring>
+
+#include "pbkit_ext.h"
+
+static inline uint16_t NormalizeDepth(float value, float max_depth) {
+  float normalized = value / max_depth;
+  if (normalized <= 0.0f) {
+    return 0;
+  }
+  if (normalized >= 1.0f) {
+    return 0xFFFF;
+  }
+  return static_cast<uint16_t>(normalized * 65535.0f + 0.5f);
+}
+
+static void ConvertZ24S8Row(const uint32_t *source, uint32_t width, uint16_t *depth, uint8_t *stencil) {
+  uint32_t x = 0;
+
+#ifdef __MMX__
+  // MMX lacks an unsigned 32->16 pack, so values are biased into signed range before packing and the sign bit is
+  // flipped afterwards.
+  const __m64 bias = _mm_set1_pi32(0x8000);
+  const __m64 sign_flip = _mm_set1_pi16(static_cast<short>(0x8000));
+  const __m64 stencil_mask = _mm_set1_pi32(0xFF);
+
+  auto in = reinterpret_cast<const __m64 *>(source);
+  for (; x + 8 <= width; x += 8, in += 4) {
+    __m64 a = in[0];
+    __m64 b = in[1];
+    __m64 c = in[2];
+    __m64 d = in[3];
+
+    __m64 za = _mm_sub_pi32(_mm_srli_pi32(a, 16), bias);
+    __m64 zb = _mm_sub_pi32(_mm_srli_pi32(b, 16), bias);
+    __m64 zc = _mm_sub_pi32(_mm_srli_pi32(c, 16), bias);
+    __m64 zd = _mm_sub_pi32(_mm_srli_pi32(d, 16), bias);
+    *reinterpret_cast<__m64 *>(depth + x) = _mm_xor_si64(_mm_packs_pi32(za, zb), sign_flip);
+    *reinterpret_cast<__m64 *>(depth + x + 4) = _mm_xor_si64(_mm_packs_pi32(zc, zd), sign_flip);
+
+    if (stencil) {
+      __m64 s_low = _mm_packs_pi32(_mm_and_si64(a, stencil_mask), _mm_and_si64(b, stencil_mask));
+      __m64 s_high = _mm_packs_pi32(_mm_and_si64(c, stencil_mask), _mm_and_si64(d, stencil_mask));
+      *reinterpret_cast<__m64 *>(stencil + x) = _mm_packs_pu16(s_low, s_high);
+    }
+  }
+  _mm_empty();
+#endif
+
+  for (; x < width; ++x) {
+    uint32_t value = source[x];
+    depth[x] = static_cast<uint16_t>(value >> 16);
+    if (stencil) {
+      stencil[x] = static_cast<uint8_t>(value & 0xFF);
+    }
+  }
+}
+
+static void ConvertZ24S8FloatRow(const uint32_t *source, uint32_t width, float max_depth, uint16_t *depth,
+                                 uint8_t *stencil) {
+  for (uint32_t x = 0; x < width; ++x) {
+    uint32_t value = source[x];
+    depth[x] = NormalizeDepth(z24_to_float(value >> 8), max_depth);
+    if (stencil) {
+      stencil[x] = static_cast<uint8_t>(value & 0xFF);
+    }
+  }
+}
+
+static void ConvertZ16FloatRow(const uint16_t *source, uint32_t width, float max_depth, uint16_t *depth) {
+  for (uint32_t x = 0; x < width; ++x) {
+    depth[x] = NormalizeDepth(z16_to_float(source[x]), max_depth);
+  }
+}
+
+void ConvertDepthStencil(const uint8_t *source, uint32_t width, uint32_t height, uint32_t pitch, uint32_t depth_format,
+                         bool float_mode, float max_depth, uint16_t *depth, uint8_t *stencil) {
+  for (uint32_t y = 0; y < height; ++y, source += pitch, depth += width) {
+    if (depth_format == NV097_SET_SURFACE_FORMAT_ZETA_Z16) {
+      auto row = reinterpret_cast<const uint16_t *>(source);
+      if (float_mode) {
+        ConvertZ16FloatRow(row, width, max_depth, depth);
+      } else {
+        memcpy(depth, row, width * sizeof(*depth));
+      }
+      continue;
+    }
+
+    auto row = reinterpret_cast<const uint32_t *>(source);
+    if (float_mode) {
+      ConvertZ24S8FloatRow(row, width, max_depth, depth, stencil);
+    } else {
+      ConvertZ24S8Row(row, width, depth, stencil);
+    }
+
+    if (stencil) {
+      stencil += width;
+    }
+  }
+}
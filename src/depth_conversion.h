@@ -0,0 +1,16 @@
+#ifndef NXDK_PGRAPH_TESTS_DEPTH_CONVERSION_H
+#define NXDK_PGRAPH_TESTS_DEPTH_CONVERSION_H
+
+#include <cstdint>
+
+// Unpacks a depth/stencil surface into a 16-bit depth plane and (for Z24S8) an 8-bit stencil plane.
+//
+// `depth_format` is one of the NV097_SET_SURFACE_FORMAT_ZETA_* values.
+// In fixed point mode the most significant 16 bits of the depth value are retained. In float mode depth values are
+// converted to floats and scaled such that `max_depth` maps to 0xFFFF.
+// `stencil` may be null, and is ignored for Z16 surfaces.
+// The output planes are tightly packed (i.e., their pitch is `width` elements).
+void ConvertDepthStencil(const uint8_t *source, uint32_t width, uint32_t height, uint32_t pitch, uint32_t depth_format,
+                         bool float_mode, float max_depth, uint16_t *depth, uint8_t *stencil);
+
+#endif  // NXDK_PGRAPH_TESTS_DEPTH_CONVERSION_H
@@ -0,0 +1,37 @@
+#include "frame_pipeline.h"
+
+#include "debug_output.h"
+
+FramePipeline *FramePipeline::active_ = nullptr;
+
+FramePipeline::FramePipeline() {
+  previous_ = active_;
+  active_ = this;
+}
+
+FramePipeline::~FramePipeline() {
+  ASSERT(active_ == this && "Frame pipelines must be destroyed in the reverse order they were created.");
+  active_ = previous_;
+}
+
+void FramePipeline::Submit(CompletionCallback on_complete) {
+  Retire();
+  on_complete_ = std::move(on_complete);
+}
+
+void FramePipeline::Retire() {
+  if (!on_complete_) {
+    return;
+  }
+
+  // The callback may submit further work, so it is cleared before being invoked.
+  auto on_complete = std::move(on_complete_);
+  on_complete_ = nullptr;
+  on_complete();
+}
+
+void FramePipeline::RetireActive() {
+  if (active_) {
+    active_->Retire();
+  }
+}
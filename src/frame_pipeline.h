@@ -0,0 +1,38 @@
+#ifndef NXDK_PGRAPH_TESTS_FRAME_PIPELINE_H
+#define NXDK_PGRAPH_TESTS_FRAME_PIPELINE_H
+
+#include <functional>
+
+// Tracks the most recently submitted frame whose rendering may still be in progress on the GPU, allowing the CPU to
+// start building the next frame before the previous one has been captured and presented.
+//
+// Code that writes memory the GPU may be reading (vertex arrays, texture memory, the render targets) must call Retire
+// (or RetireActive) first, which blocks until the pending frame, if any, completes and then runs its completion
+// callback.
+class FramePipeline {
+ public:
+  using CompletionCallback = std::function<void()>;
+
+ public:
+  FramePipeline();
+  ~FramePipeline();
+
+  // Marks a frame as submitted. `on_complete` is invoked from the Retire call that follows. Any previously submitted
+  // frame is retired first.
+  void Submit(CompletionCallback on_complete);
+
+  // Completes the pending frame, if any.
+  void Retire();
+  bool IsPending() const { return static_cast<bool>(on_complete_); }
+
+  // Retires the pending frame of the most recently constructed pipeline, if any.
+  static void RetireActive();
+
+ private:
+  CompletionCallback on_complete_;
+
+  FramePipeline *previous_{nullptr};
+  static FramePipeline *active_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_FRAME_PIPELINE_H
@@ -0,0 +1,55 @@
+#include "frame_time_histogram.h"
+
+#include <algorithm>
+
+void FrameTimeHistogram::Add(uint32_t microseconds) {
+  if (!samples_.empty() && microseconds < samples_.back()) {
+    sorted_ = false;
+  }
+  samples_.push_back(microseconds);
+  total_ += microseconds;
+
+  uint32_t bucket = microseconds ? 31 - __builtin_clz(microseconds) : 0;
+  ++buckets_[std::min(bucket, kNumBuckets - 1)];
+}
+
+void FrameTimeHistogram::Clear() {
+  samples_.clear();
+  sorted_ = true;
+  total_ = 0;
+  std::fill(std::begin(buckets_), std::end(buckets_), 0);
+}
+
+uint32_t FrameTimeHistogram::GetMean() const {
+  if (samples_.empty()) {
+    return 0;
+  }
+  return static_cast<uint32_t>(total_ / samples_.size());
+}
+
+uint32_t FrameTimeHistogram::GetMax() const {
+  if (samples_.empty()) {
+    return 0;
+  }
+  Sort();
+  return samples_.back();
+}
+
+uint32_t FrameTimeHistogram::GetPercentile(uint32_t percentile) const {
+  if (samples_.empty()) {
+    return 0;
+  }
+  Sort();
+
+  // Nearest rank: the smallest sample that is greater than or equal to `percentile` percent of all samples.
+  uint32_t rank = (percentile * samples_.size() + 99) / 100;
+  rank = std::max(rank, 1U);
+  return samples_[std::min<uint32_t>(rank, samples_.size()) - 1];
+}
+
+void FrameTimeHistogram::Sort() const {
+  if (!sorted_) {
+    std::sort(samples_.begin(), samples_.end());
+    sorted_ = true;
+  }
+}
@@ -0,0 +1,38 @@
+#ifndef NXDK_PGRAPH_TESTS_FRAME_TIME_HISTOGRAM_H
+#define NXDK_PGRAPH_TESTS_FRAME_TIME_HISTOGRAM_H
+
+#include <cstdint>
+#include <vector>
+
+// Collects frame times and summarizes them as percentiles and a power of two bucketed histogram.
+class FrameTimeHistogram {
+ public:
+  // Bucket `i` counts samples in [2^i, 2^(i + 1)) microseconds, with bucket 0 also counting samples under 1us and the
+  // last bucket counting everything above its lower bound.
+  static constexpr uint32_t kNumBuckets = 24;
+
+ public:
+  void Reserve(uint32_t num_samples) { samples_.reserve(num_samples); }
+  void Add(uint32_t microseconds);
+  void Clear();
+
+  uint32_t GetNumSamples() const { return samples_.size(); }
+  uint32_t GetMean() const;
+  uint32_t GetMax() const;
+  // Returns the nearest rank `percentile` (0 - 100) sample.
+  uint32_t GetPercentile(uint32_t percentile) const;
+
+  uint32_t GetBucketCount(uint32_t bucket) const { return buckets_[bucket]; }
+  static uint32_t GetBucketMin(uint32_t bucket) { return bucket ? 1 << bucket : 0; }
+
+ private:
+  void Sort() const;
+
+ private:
+  mutable std::vector<uint32_t> samples_;
+  mutable bool sorted_{true};
+  uint64_t total_{0};
+  uint32_t buckets_[kNumBuckets]{};
+};
+
+#endif  // NXDK_PGRAPH_TESTS_FRAME_TIME_HISTOGRAM_H
@@ -0,0 +1,126 @@
+#include "geometry_builder.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "debug_output.h"
+
+static constexpr float kPi = 3.14159265358979f;
+
+// Widest stripe whose previous row is still resident in the post-transform cache when the next row is emitted.
+static constexpr uint32_t kStripeColumns = kPostTransformCacheSize / 2 - 1;
+
+// Appends the indices of a `columns` x `rows` grid of quads whose (columns + 1) x (rows + 1) vertices are stored row
+// major from `first`. Stripes are walked top to bottom so that each row of vertices is transformed once per stripe
+// rather than once per quad.
+static void AppendGridIndices(IndexBuffer &indices, uint32_t first, uint32_t columns, uint32_t rows) {
+  const uint32_t row_pitch = columns + 1;
+  indices.Reserve(indices.GetNumIndices() + columns * rows * 6);
+
+  for (uint32_t stripe = 0; stripe < columns; stripe += kStripeColumns) {
+    const uint32_t stripe_end = std::min(stripe + kStripeColumns, columns);
+    for (uint32_t row = 0; row < rows; ++row) {
+      const uint32_t top = first + row * row_pitch;
+      const uint32_t bottom = top + row_pitch;
+      for (uint32_t column = stripe; column < stripe_end; ++column) {
+        const uint32_t ul = top + column;
+        const uint32_t ur = ul + 1;
+        const uint32_t ll = bottom + column;
+        const uint32_t lr = ll + 1;
+
+        indices.Append(ul);
+        indices.Append(ur);
+        indices.Append(lr);
+
+        indices.Append(ul);
+        indices.Append(lr);
+        indices.Append(ll);
+      }
+    }
+  }
+}
+
+static void SetTexCoords(Vertex &vertex, float u, float v) {
+  vertex.SetTexCoord0(u, v, 0.0f, 0.0f);
+  vertex.SetTexCoord1(u, v, 0.0f, 0.0f);
+  vertex.SetTexCoord2(u, v, 0.0f, 0.0f);
+  vertex.SetTexCoord3(u, v, 0.0f, 0.0f);
+}
+
+void DefineGrid(VertexBuffer &buffer, uint32_t start_vertex, IndexBuffer &indices, float left, float top, float right,
+                float bottom, float z, uint32_t columns, uint32_t rows, const Color &diffuse) {
+  ASSERT(columns && rows && "Grid must contain at least one quad.");
+  const uint32_t num_vertices = GetGridVertexCount(columns, rows);
+
+  Vertex *vertex = buffer.Lock(start_vertex, num_vertices);
+  for (uint32_t row = 0; row <= rows; ++row) {
+    const float v = static_cast<float>(row) / static_cast<float>(rows);
+    const float y = top + (bottom - top) * v;
+    for (uint32_t column = 0; column <= columns; ++column, ++vertex) {
+      const float u = static_cast<float>(column) / static_cast<float>(columns);
+      vertex->SetPosition(left + (right - left) * u, y, z);
+      vertex->SetNormal(0.0f, 0.0f, 1.0f);
+      vertex->SetDiffuse(diffuse.r, diffuse.g, diffuse.b, diffuse.a);
+      vertex->SetSpecular(1.0f, 1.0f, 1.0f, 1.0f);
+      SetTexCoords(*vertex, u, v);
+    }
+  }
+  buffer.Unlock();
+
+  AppendGridIndices(indices, start_vertex, columns, rows);
+}
+
+void DefineSphere(VertexBuffer &buffer, uint32_t start_vertex, IndexBuffer &indices, const float *center, float radius,
+                  uint32_t slices, uint32_t stacks, const Color &diffuse) {
+  ASSERT(slices >= 3 && stacks >= 2 && "Sphere requires at least 3 slices and 2 stacks.");
+  const uint32_t num_vertices = GetSphereVertexCount(slices, stacks);
+
+  Vertex *vertex = buffer.Lock(start_vertex, num_vertices);
+  for (uint32_t stack = 0; stack <= stacks; ++stack) {
+    const float v = static_cast<float>(stack) / static_cast<float>(stacks);
+    const float polar = v * kPi;
+    const float ring_radius = sinf(polar);
+    const float ny = cosf(polar);
+    for (uint32_t slice = 0; slice <= slices; ++slice, ++vertex) {
+      const float u = static_cast<float>(slice) / static_cast<float>(slices);
+      const float azimuth = u * 2.0f * kPi;
+      const float nx = ring_radius * cosf(azimuth);
+      const float nz = ring_radius * sinf(azimuth);
+      vertex->SetPosition(center[0] + nx * radius, center[1] + ny * radius, center[2] + nz * radius);
+      vertex->SetNormal(nx, ny, nz);
+      vertex->SetDiffuse(diffuse.r, diffuse.g, diffuse.b, diffuse.a);
+      vertex->SetSpecular(1.0f, 1.0f, 1.0f, 1.0f);
+      SetTexCoords(*vertex, u, v);
+    }
+  }
+  buffer.Unlock();
+
+  // The quads touching the poles collapse into single triangles plus a degenerate one, which the GPU discards.
+  AppendGridIndices(indices, start_vertex, slices, stacks);
+}
+
+void AppendTriangleStrip(IndexBuffer &indices, uint32_t first, uint32_t count) {
+  ASSERT(count >= 3 && "Triangle strip requires at least 3 vertices.");
+  indices.Reserve(indices.GetNumIndices() + (count - 2) * 3);
+  for (uint32_t i = 0; i < count - 2; ++i) {
+    const uint32_t index = first + i;
+    if (i & 0x01) {
+      indices.Append(index + 1);
+      indices.Append(index);
+    } else {
+      indices.Append(index);
+      indices.Append(index + 1);
+    }
+    indices.Append(index + 2);
+  }
+}
+
+void AppendTriangleFan(IndexBuffer &indices, uint32_t first, uint32_t count) {
+  ASSERT(count >= 3 && "Triangle fan requires at least 3 vertices.");
+  indices.Reserve(indices.GetNumIndices() + (count - 2) * 3);
+  for (uint32_t i = 1; i < count - 1; ++i) {
+    indices.Append(first);
+    indices.Append(first + i);
+    indices.Append(first + i + 1);
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef NXDK_PGRAPH_TESTS_GEOMETRY_BUILDER_H
+#define NXDK_PGRAPH_TESTS_GEOMETRY_BUILDER_H
+
+#include <cstdint>
+
+#include "index_buffer.h"
+#include "vertex_buffer.h"
+
+// Builds indexed meshes whose vertices are shared between adjacent triangles, for rendering as triangle primitives via
+// TestHost::DrawInlineElements16. Each builder writes its vertices into `buffer` starting at `start_vertex` and appends
+// triangle list indices to `indices`. Each quad is split into the same two triangles, in the same vertex order, as
+// VertexBuffer::DefineBiTri.
+
+// Number of entries assumed for the post-transform vertex cache when ordering indices. Triangles are emitted in
+// vertical stripes narrow enough that the previous row of a stripe is still cached when the next row references it.
+static constexpr uint32_t kPostTransformCacheSize = 16;
+
+// Returns the number of vertices needed by DefineGrid.
+inline uint32_t GetGridVertexCount(uint32_t columns, uint32_t rows) { return (columns + 1) * (rows + 1); }
+// Returns the number of indices appended by DefineGrid.
+inline uint32_t GetGridIndexCount(uint32_t columns, uint32_t rows) { return columns * rows * 6; }
+
+// Defines a `columns` x `rows` grid of quads spanning the given rectangle at depth `z`. texcoord0 through texcoord3
+// span 0 to 1 across the grid, normals face +z and every vertex takes `diffuse`.
+void DefineGrid(VertexBuffer &buffer, uint32_t start_vertex, IndexBuffer &indices, float left, float top, float right,
+                float bottom, float z, uint32_t columns, uint32_t rows, const Color &diffuse);
+
+// Returns the number of vertices needed by DefineSphere.
+inline uint32_t GetSphereVertexCount(uint32_t slices, uint32_t stacks) { return (slices + 1) * (stacks + 1); }
+// Returns the number of indices appended by DefineSphere.
+inline uint32_t GetSphereIndexCount(uint32_t slices, uint32_t stacks) { return slices * stacks * 6; }
+
+// Defines a UV sphere of `radius` centered on `center` with `slices` segments around the y axis and `stacks` segments
+// from pole to pole. Normals point outwards and texcoord0 wraps once around the sphere. The seam and pole vertices are
+// duplicated so that each carries a distinct texcoord.
+void DefineSphere(VertexBuffer &buffer, uint32_t start_vertex, IndexBuffer &indices, const float *center, float radius,
+                  uint32_t slices, uint32_t stacks, const Color &diffuse);
+
+// Appends the triangle list indices equivalent to a triangle strip over vertices [first, first + count), preserving
+// the alternating winding of the strip.
+void AppendTriangleStrip(IndexBuffer &indices, uint32_t first, uint32_t count);
+// Appends the triangle list indices equivalent to a triangle fan over vertices [first, first + count).
+void AppendTriangleFan(IndexBuffer &indices, uint32_t first, uint32_t count);
+
+#endif  // NXDK_PGRAPH_TESTS_GEOMETRY_BUILDER_H
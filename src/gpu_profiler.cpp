@@ -0,0 +1,126 @@
+#include "gpu_profiler.h"
+
+#include <cstring>
+
+#include "command_recorder.h"
+#include "contiguous_memory_pool.h"
+#include "debug_output.h"
+#include "nxdk_ext.h"
+#include "pbkit_ext.h"
+
+// Each scope writes a report when it begins and another when it ends.
+static constexpr uint32_t kReportsPerScope = 2;
+
+GpuProfiler::~GpuProfiler() {
+  if (reports_) {
+    ContiguousMemoryPool::Release(reports_, kMaxPendingScopes * kReportsPerScope * sizeof(Report),
+                                  MemoryTracker::CATEGORY_GPU_PROFILER);
+  }
+}
+
+void GpuProfiler::Initialize(uint32_t context_channel) {
+  if (reports_) {
+    return;
+  }
+
+  const uint32_t size = kMaxPendingScopes * kReportsPerScope * sizeof(Report);
+  reports_ = static_cast<Report *>(ContiguousMemoryPool::Allocate(size, MemoryTracker::CATEGORY_GPU_PROFILER));
+  ASSERT(reports_ && "Failed to allocate GPU profiler reports.");
+  memset(reports_, 0, size);
+
+  // NV097_GET_REPORT only carries a 24-bit offset, so the context starts at the report buffer rather than at address 0.
+  pb_create_dma_ctx(context_channel, DMA_CLASS_3D, reinterpret_cast<uint32_t>(reports_), size - 1, &dma_ctx_);
+  pb_bind_channel(&dma_ctx_);
+
+  auto p = CommandRecorder::Begin();
+  p = pb_push1(p, NV097_SET_CONTEXT_DMA_REPORT, dma_ctx_.ChannelID);
+  CommandRecorder::End(p);
+}
+
+void GpuProfiler::BeginScope(Scope scope) {
+  if (!enabled_) {
+    return;
+  }
+  ASSERT(nesting_depth_ < kMaxNestingDepth && "GPU profiler scopes nested too deeply.");
+
+  if (num_pending_ == kMaxPendingScopes) {
+    ++dropped_scopes_;
+    open_scopes_[nesting_depth_++] = kMaxPendingScopes;
+    return;
+  }
+
+  const uint32_t index = num_pending_++;
+  pending_[index] = {scope, index * kReportsPerScope};
+  open_scopes_[nesting_depth_++] = index;
+  PushReport(pending_[index].first_report);
+}
+
+void GpuProfiler::EndScope() {
+  if (!enabled_) {
+    return;
+  }
+  ASSERT(nesting_depth_ && "EndScope called without a matching BeginScope.");
+
+  const uint32_t index = open_scopes_[--nesting_depth_];
+  if (index != kMaxPendingScopes) {
+    PushReport(pending_[index].first_report + 1);
+  }
+}
+
+void GpuProfiler::PushReport(uint32_t index) const {
+  const uint32_t offset = index * sizeof(Report);
+
+  auto p = CommandRecorder::Begin();
+  p = pb_push1(p, NV097_GET_REPORT,
+               MASK(NV097_GET_REPORT_TYPE, NV097_GET_REPORT_TYPE_ZPASS_PIXEL_CNT) |
+                   MASK(NV097_GET_REPORT_OFFSET, offset));
+  CommandRecorder::End(p);
+}
+
+void GpuProfiler::Resolve() {
+  ASSERT(!nesting_depth_ && "Resolve called with open GPU profiler scopes.");
+
+  for (uint32_t i = 0; i < num_pending_; ++i) {
+    const PendingScope &pending = pending_[i];
+    const Report &begin = reports_[pending.first_report];
+    const Report &end = reports_[pending.first_report + 1];
+
+    // A zero timestamp means the report was never written (e.g., the commands were discarded by a pb_reset).
+    if (begin.timestamp && end.timestamp >= begin.timestamp) {
+      auto &stats = stats_[pending.scope];
+      stats.elapsed_ns += end.timestamp - begin.timestamp;
+      ++stats.count;
+    }
+  }
+
+  if (num_pending_) {
+    memset(reports_, 0, num_pending_ * kReportsPerScope * sizeof(Report));
+    num_pending_ = 0;
+  }
+}
+
+void GpuProfiler::Reset() {
+  if (num_pending_) {
+    memset(reports_, 0, num_pending_ * kReportsPerScope * sizeof(Report));
+    num_pending_ = 0;
+  }
+  memset(stats_, 0, sizeof(stats_));
+  dropped_scopes_ = 0;
+}
+
+const char *GpuProfiler::GetScopeName(Scope scope) {
+  switch (scope) {
+    case SCOPE_PREPARE_DRAW:
+      return "prepare_draw";
+    case SCOPE_DRAW:
+      return "draw";
+    case SCOPE_CLEAR:
+      return "clear";
+    case SCOPE_BLIT:
+      return "blit";
+    case SCOPE_USER:
+      return "user";
+    default:
+      return "unknown";
+  }
+}
@@ -0,0 +1,101 @@
+#ifndef NXDK_PGRAPH_TESTS_GPU_PROFILER_H
+#define NXDK_PGRAPH_TESTS_GPU_PROFILER_H
+
+#include <pbkit/pbkit.h>
+
+#include <cstdint>
+
+// Attributes GPU execution time to scopes by inserting NV097_GET_REPORT commands into the pushbuffer around them.
+//
+// Each report is written by the GPU once every preceding command has passed through the pipeline and carries a PTIMER
+// timestamp (in nanoseconds), so the difference between the reports at either end of a scope is the time the GPU
+// spent processing it. Reports are only read back by Resolve, which must not be called until the GPU is idle.
+//
+// Scopes may be nested, in which case time spent in the inner scope is also counted towards the outer one. Note that
+// emulators may not provide meaningful report timestamps.
+class GpuProfiler {
+ public:
+  enum Scope {
+    SCOPE_PREPARE_DRAW,
+    SCOPE_DRAW,
+    SCOPE_CLEAR,
+    SCOPE_BLIT,
+    // Available to tests that want to time arbitrary commands.
+    SCOPE_USER,
+    SCOPE_COUNT,
+  };
+
+  struct ScopeStats {
+    uint64_t elapsed_ns;
+    uint32_t count;
+  };
+
+  // Times a scope for the lifetime of the instance.
+  class ScopedRegion {
+   public:
+    ScopedRegion(GpuProfiler &profiler, Scope scope) : profiler_(profiler) { profiler_.BeginScope(scope); }
+    ~ScopedRegion() { profiler_.EndScope(); }
+
+   private:
+    GpuProfiler &profiler_;
+  };
+
+ public:
+  ~GpuProfiler();
+
+  // Allocates the report buffer, creates a DMA context for it in `context_channel`, and binds it as the 3D class report
+  // context.
+  void Initialize(uint32_t context_channel);
+
+  void SetEnabled(bool enabled) { enabled_ = enabled && reports_; }
+  bool IsEnabled() const { return enabled_; }
+
+  void BeginScope(Scope scope);
+  void EndScope();
+
+  // Accumulates every completed scope into the per-scope stats and releases its reports.
+  void Resolve();
+  // Discards all stats, including scopes that have not yet been resolved.
+  void Reset();
+
+  const ScopeStats &GetStats(Scope scope) const { return stats_[scope]; }
+  // Number of scopes that were not timed because the report buffer was full.
+  uint32_t GetNumDroppedScopes() const { return dropped_scopes_; }
+
+  static const char *GetScopeName(Scope scope);
+
+ private:
+  struct Report {
+    uint64_t timestamp;
+    uint32_t value;
+    uint32_t status;
+  };
+
+  struct PendingScope {
+    Scope scope;
+    uint32_t first_report;
+  };
+
+  void PushReport(uint32_t index) const;
+
+ private:
+  static constexpr uint32_t kMaxPendingScopes = 4096;
+  static constexpr uint32_t kMaxNestingDepth = 8;
+
+  bool enabled_{false};
+  Report *reports_{nullptr};
+  struct s_CtxDma dma_ctx_ {};
+
+  PendingScope pending_[kMaxPendingScopes]{};
+  uint32_t num_pending_{0};
+
+  // Indices into `pending_` of the scopes that have begun but not ended. Scopes that were dropped are recorded as
+  // kMaxPendingScopes so that the matching EndScope is ignored.
+  uint32_t open_scopes_[kMaxNestingDepth]{};
+  uint32_t nesting_depth_{0};
+
+  ScopeStats stats_[SCOPE_COUNT]{};
+  uint32_t dropped_scopes_{0};
+};
+
+#endif  // NXDK_PGRAPH_TESTS_GPU_PROFILER_H
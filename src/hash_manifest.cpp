@@ -0,0 +1,135 @@
+#include "hash_manifest.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static constexpr uint32_t kPrime1 = 0x9E3779B1U;
+static constexpr uint32_t kPrime2 = 0x85EBCA77U;
+static constexpr uint32_t kPrime3 = 0xC2B2AE3DU;
+static constexpr uint32_t kPrime4 = 0x27D4EB2FU;
+static constexpr uint32_t kPrime5 = 0x165667B1U;
+
+static inline uint32_t Rotl(uint32_t value, uint32_t amount) { return (value << amount) | (value >> (32 - amount)); }
+
+static inline uint32_t Read32(const uint8_t *p) {
+  uint32_t ret;
+  memcpy(&ret, p, sizeof(ret));
+  return ret;
+}
+
+static inline uint32_t Round(uint32_t acc, uint32_t input) {
+  acc += input * kPrime2;
+  acc = Rotl(acc, 13);
+  return acc * kPrime1;
+}
+
+uint32_t XXH32(const void *data, uint32_t length, uint32_t seed) {
+  auto p = static_cast<const uint8_t *>(data);
+  const uint8_t *end = p + length;
+  uint32_t hash;
+
+  if (length >= 16) {
+    const uint8_t *limit = end - 16;
+    uint32_t v1 = seed + kPrime1 + kPrime2;
+    uint32_t v2 = seed + kPrime2;
+    uint32_t v3 = seed;
+    uint32_t v4 = seed - kPrime1;
+
+    do {
+      v1 = Round(v1, Read32(p));
+      v2 = Round(v2, Read32(p + 4));
+      v3 = Round(v3, Read32(p + 8));
+      v4 = Round(v4, Read32(p + 12));
+      p += 16;
+    } while (p <= limit);
+
+    hash = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+  } else {
+    hash = seed + kPrime5;
+  }
+
+  hash += length;
+
+  while (p + 4 <= end) {
+    hash += Read32(p) * kPrime3;
+    hash = Rotl(hash, 17) * kPrime4;
+    p += 4;
+  }
+
+  while (p < end) {
+    hash += (*p++) * kPrime5;
+    hash = Rotl(hash, 11) * kPrime1;
+  }
+
+  hash ^= hash >> 15;
+  hash *= kPrime2;
+  hash ^= hash >> 13;
+  hash *= kPrime3;
+  hash ^= hash >> 16;
+
+  return hash;
+}
+
+uint32_t HashSurface(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, uint32_t bytes_per_pixel) {
+  const uint32_t row_size = width * bytes_per_pixel;
+  if (row_size == pitch) {
+    return XXH32(pixels, pitch * height);
+  }
+
+  uint32_t hash = 0;
+  for (uint32_t y = 0; y < height; ++y, pixels += pitch) {
+    hash = XXH32(pixels, row_size, hash);
+  }
+  return hash;
+}
+
+bool HashManifest::Load(const std::string &path) {
+  FILE *fp = fopen(path.c_str(), "r");
+  if (!fp) {
+    return false;
+  }
+
+  char line[512];
+  while (fgets(line, sizeof(line), fp)) {
+    char *separator = strrchr(line, ' ');
+    if (!separator) {
+      continue;
+    }
+
+    *separator = 0;
+    uint32_t hash = strtoul(separator + 1, nullptr, 16);
+    entries_[line] = hash;
+  }
+
+  fclose(fp);
+  return true;
+}
+
+bool HashManifest::Save(const std::string &path) const {
+  FILE *fp = fopen(path.c_str(), "w");
+  if (!fp) {
+    return false;
+  }
+
+  bool ok = true;
+  for (auto &entry : entries_) {
+    if (fprintf(fp, "%s %08X\n", entry.first.c_str(), entry.second) < 0) {
+      ok = false;
+      break;
+    }
+  }
+
+  fclose(fp);
+  return ok;
+}
+
+bool HashManifest::Lookup(const std::string &name, uint32_t &hash) const {
+  auto it = entries_.find(name);
+  if (it == entries_.end()) {
+    return false;
+  }
+
+  hash = it->second;
+  return true;
+}
@@ -0,0 +1,34 @@
+#ifndef NXDK_PGRAPH_TESTS_HASH_MANIFEST_H
+#define NXDK_PGRAPH_TESTS_HASH_MANIFEST_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Computes the 32-bit xxHash of the given data.
+uint32_t XXH32(const void *data, uint32_t length, uint32_t seed = 0);
+
+// Computes a hash over the visible portion of a surface, ignoring any padding between rows.
+uint32_t HashSurface(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, uint32_t bytes_per_pixel);
+
+// Maps result names to the hash of their output.
+//
+// Manifests are stored as text files with one "<name> <hash as 8 hex digits>" entry per line.
+class HashManifest {
+ public:
+  // Loads entries from the given file, returning false if the file could not be opened.
+  bool Load(const std::string &path);
+  // Writes all entries to the given file, returning false on failure.
+  bool Save(const std::string &path) const;
+
+  bool Lookup(const std::string &name, uint32_t &hash) const;
+  void Set(const std::string &name, uint32_t hash) { entries_[name] = hash; }
+
+  bool Empty() const { return entries_.empty(); }
+  void Clear() { entries_.clear(); }
+
+ private:
+  std::map<std::string, uint32_t> entries_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_HASH_MANIFEST_H
@@ -0,0 +1,124 @@
+#include "image_diff.h"
+
+#include <mmintrin.h>
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Excludes alpha from the squared error used for PSNR.
+static constexpr uint32_t kColorMask = 0x00FFFFFF;
+
+static inline uint8_t AbsDiff(uint8_t a, uint8_t b) { return a > b ? a - b : b - a; }
+
+void DiffImages(const uint8_t *actual, uint32_t actual_pitch, const uint8_t *expected, uint32_t expected_pitch,
+                uint32_t width, uint32_t height, uint8_t tolerance, ImageDiffMetrics &metrics) {
+  // The Xbox CPU lacks SSE2, so the kernel operates on pairs of pixels in MMX registers using the SSE extensions to
+  // MMX (pmaxub) where needed.
+  const __m64 zero = _mm_setzero_si64();
+  const __m64 color_mask = _mm_set1_pi32(static_cast<int>(kColorMask));
+  const __m64 tolerance_bytes = _mm_set1_pi8(static_cast<char>(tolerance));
+
+  __m64 max_error = zero;
+  uint64_t squared_error = 0;
+  uint32_t matched_pixels = 0;
+  uint8_t tail_max[4] = {0, 0, 0, 0};
+  const uint32_t pairs = width / 2;
+
+  for (uint32_t y = 0; y < height; ++y) {
+    auto a = reinterpret_cast<const __m64 *>(actual + y * actual_pitch);
+    auto e = reinterpret_cast<const __m64 *>(expected + y * expected_pitch);
+
+    // Each 32-bit lane gains at most 3 * 255^2 per pixel, which cannot overflow for any surface width pgraph supports.
+    __m64 row_squares = zero;
+    __m64 row_matches = zero;
+    for (uint32_t i = 0; i < pairs; ++i) {
+      const __m64 diff = _mm_or_si64(_mm_subs_pu8(a[i], e[i]), _mm_subs_pu8(e[i], a[i]));
+      max_error = _mm_max_pu8(max_error, diff);
+
+      // Pixels whose channels are all within the tolerance compare equal to zero, adding 1 to the lane.
+      row_matches = _mm_sub_pi32(row_matches, _mm_cmpeq_pi32(_mm_subs_pu8(diff, tolerance_bytes), zero));
+
+      const __m64 color = _mm_and_si64(diff, color_mask);
+      const __m64 low = _mm_unpacklo_pi8(color, zero);
+      const __m64 high = _mm_unpackhi_pi8(color, zero);
+      row_squares = _mm_add_pi32(row_squares, _mm_add_pi32(_mm_madd_pi16(low, low), _mm_madd_pi16(high, high)));
+    }
+
+    squared_error += static_cast<uint32_t>(_mm_cvtsi64_si32(row_squares)) +
+                     static_cast<uint64_t>(static_cast<uint32_t>(_mm_cvtsi64_si32(_mm_srli_si64(row_squares, 32))));
+    matched_pixels += static_cast<uint32_t>(_mm_cvtsi64_si32(row_matches)) +
+                      static_cast<uint32_t>(_mm_cvtsi64_si32(_mm_srli_si64(row_matches, 32)));
+
+    if (width & 1) {
+      const uint8_t *pa = actual + y * actual_pitch + (width - 1) * 4;
+      const uint8_t *pe = expected + y * expected_pitch + (width - 1) * 4;
+      bool matched = true;
+      for (uint32_t c = 0; c < 4; ++c) {
+        const uint8_t diff = AbsDiff(pa[c], pe[c]);
+        tail_max[c] = std::max(tail_max[c], diff);
+        matched = matched && diff <= tolerance;
+        if (c < 3) {
+          squared_error += diff * diff;
+        }
+      }
+      matched_pixels += matched ? 1 : 0;
+    }
+  }
+
+  // Fold the maxima of the two pixel lanes together.
+  const __m64 folded = _mm_max_pu8(max_error, _mm_srli_si64(max_error, 32));
+  const auto lanes = static_cast<uint32_t>(_mm_cvtsi64_si32(folded));
+  _mm_empty();
+
+  for (uint32_t c = 0; c < 4; ++c) {
+    metrics.max_error[c] = std::max(static_cast<uint8_t>(lanes >> (c * 8)), tail_max[c]);
+  }
+  metrics.total_pixels = width * height;
+  metrics.mismatched_pixels = metrics.total_pixels - matched_pixels;
+
+  if (!squared_error) {
+    metrics.psnr = INFINITY;
+  } else {
+    const double mse = static_cast<double>(squared_error) / (static_cast<double>(metrics.total_pixels) * 3.0);
+    metrics.psnr = 10.0 * log10((255.0 * 255.0) / mse);
+  }
+}
+
+void RenderDiffHeatmap(const uint8_t *actual, uint32_t actual_pitch, const uint8_t *expected, uint32_t expected_pitch,
+                       uint32_t width, uint32_t height, uint8_t *heatmap) {
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint8_t *pa = actual + y * actual_pitch;
+    const uint8_t *pe = expected + y * expected_pitch;
+    for (uint32_t x = 0; x < width; ++x, pa += 4, pe += 4) {
+      uint32_t diff = std::max(std::max(AbsDiff(pa[0], pe[0]), AbsDiff(pa[1], pe[1])),
+                               std::max(AbsDiff(pa[2], pe[2]), AbsDiff(pa[3], pe[3])));
+      *heatmap++ = static_cast<uint8_t>(std::min(diff * 4, 255U));
+    }
+  }
+}
+
+void DownsampleBox(const uint8_t *source, uint32_t source_pitch, uint32_t width, uint32_t height, uint32_t factor,
+                   uint8_t *dest) {
+  const uint32_t out_width = width / factor;
+  const uint32_t out_height = height / factor;
+  const uint32_t samples = factor * factor;
+
+  for (uint32_t y = 0; y < out_height; ++y) {
+    for (uint32_t x = 0; x < out_width; ++x) {
+      uint32_t sums[4] = {0, 0, 0, 0};
+      for (uint32_t sy = 0; sy < factor; ++sy) {
+        const uint8_t *row = source + (y * factor + sy) * source_pitch + x * factor * 4;
+        for (uint32_t sx = 0; sx < factor * 4; sx += 4) {
+          sums[0] += row[sx];
+          sums[1] += row[sx + 1];
+          sums[2] += row[sx + 2];
+          sums[3] += row[sx + 3];
+        }
+      }
+      for (auto sum : sums) {
+        *dest++ = static_cast<uint8_t>((sum + samples / 2) / samples);
+      }
+    }
+  }
+}
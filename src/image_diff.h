@@ -0,0 +1,31 @@
+#ifndef NXDK_PGRAPH_TESTS_IMAGE_DIFF_H
+#define NXDK_PGRAPH_TESTS_IMAGE_DIFF_H
+
+#include <cstdint>
+
+// Error metrics between a 32bpp result and its reference image.
+struct ImageDiffMetrics {
+  // Largest absolute difference in each channel, in memory (B, G, R, A for ARGB8888) order.
+  uint8_t max_error[4];
+  // Number of pixels where any channel differs by more than the tolerance given to DiffImages.
+  uint32_t mismatched_pixels;
+  uint32_t total_pixels;
+  // Peak signal to noise ratio of the color channels in dB, or INFINITY if they are identical.
+  double psnr;
+};
+
+// Compares two 32bpp images of `width` x `height` pixels.
+void DiffImages(const uint8_t *actual, uint32_t actual_pitch, const uint8_t *expected, uint32_t expected_pitch,
+                uint32_t width, uint32_t height, uint8_t tolerance, ImageDiffMetrics &metrics);
+
+// Writes the largest channel difference of each pixel, scaled by 4 and saturated so that small errors remain visible,
+// into the tightly packed 8bpp `heatmap`.
+void RenderDiffHeatmap(const uint8_t *actual, uint32_t actual_pitch, const uint8_t *expected, uint32_t expected_pitch,
+                       uint32_t width, uint32_t height, uint8_t *heatmap);
+
+// Averages each `factor` x `factor` block of the 32bpp `source` into the tightly packed `dest`, which receives
+// (width / factor) x (height / factor) pixels.
+void DownsampleBox(const uint8_t *source, uint32_t source_pitch, uint32_t width, uint32_t height, uint32_t factor,
+                   uint8_t *dest);
+
+#endif  // NXDK_PGRAPH_TESTS_IMAGE_DIFF_H
@@ -0,0 +1,15 @@
+#include "index_buffer.h"
+
+#include "debug_output.h"
+
+IndexBuffer::IndexBuffer(const std::vector<uint32_t> &indices) {
+  indices_.reserve(indices.size());
+  for (auto index : indices) {
+    Append(index);
+  }
+}
+
+void IndexBuffer::Append(uint32_t index) {
+  ASSERT(index < 0xFFFF && "16-bit indices must be < 0xFFFF.");
+  indices_.push_back(static_cast<uint16_t>(index));
+}
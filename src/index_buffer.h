@@ -0,0 +1,35 @@
+#ifndef NXDK_PGRAPH_TESTS_INDEX_BUFFER_H
+#define NXDK_PGRAPH_TESTS_INDEX_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+
+// Holds 16-bit vertex indices in the layout expected by NV097_ARRAY_ELEMENT16, allowing them to be copied directly
+// into the pushbuffer.
+class IndexBuffer {
+ public:
+  IndexBuffer() = default;
+  explicit IndexBuffer(const std::vector<uint32_t> &indices);
+
+  void Clear() { indices_.clear(); }
+  void Reserve(uint32_t num_indices) { indices_.reserve(num_indices); }
+
+  // Appends an index, which must be < 0xFFFF.
+  void Append(uint32_t index);
+
+  uint32_t GetNumIndices() const { return indices_.size(); }
+
+  // Returns the number of complete NV097_ARRAY_ELEMENT16 pairs.
+  uint32_t GetNumPairs() const { return indices_.size() / 2; }
+
+  // Returns the indices packed as NV097_ARRAY_ELEMENT16 parameters (first index of each pair in the low 16 bits).
+  const uint32_t *GetPairs() const { return reinterpret_cast<const uint32_t *>(indices_.data()); }
+
+  bool HasTrailingIndex() const { return indices_.size() & 1; }
+  uint32_t GetTrailingIndex() const { return indices_.back(); }
+
+ private:
+  std::vector<uint16_t> indices_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_INDEX_BUFFER_H
@@ -0,0 +1,166 @@
+#include "io_worker.h"
+
+#include <cstdio>
+#include <utility>
+
+#include "debug_output.h"
+
+IoWorker *IoWorker::active_ = nullptr;
+
+IoWorker::IoWorker(uint32_t capacity, uint32_t log_capacity)
+    : jobs_(capacity), log_ring_(log_capacity), producer_thread_id_(GetCurrentThreadId()) {
+  ASSERT(capacity && "IoWorker capacity must be non-zero.");
+
+  work_available_event_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  space_available_event_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  idle_event_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  ASSERT(work_available_event_ && space_available_event_ && idle_event_ && "Failed to create I/O worker events.");
+
+  worker_thread_ = CreateThread(nullptr, 0, ThreadProc, this, 0, nullptr);
+  ASSERT(worker_thread_ && "Failed to create I/O worker thread.");
+
+  previous_ = active_;
+  active_ = this;
+}
+
+IoWorker::~IoWorker() {
+  ASSERT(active_ == this && "I/O workers must be destroyed in the reverse order they were created.");
+  active_ = previous_;
+
+  Flush();
+  shutdown_requested_.store(true);
+  SetEvent(work_available_event_);
+
+  WaitForSingleObject(worker_thread_, INFINITE);
+  if (log_file_) {
+    fclose(log_file_);
+  }
+  CloseHandle(worker_thread_);
+  CloseHandle(work_available_event_);
+  CloseHandle(space_available_event_);
+  CloseHandle(idle_event_);
+}
+
+void IoWorker::Post(Job job) {
+  ASSERT(IsProducerThread() && "IoWorker jobs may only be posted by the thread that created the worker.");
+
+  const uint32_t index = posted_.load(std::memory_order_relaxed);
+  while (index - consumed_.load(std::memory_order_acquire) >= jobs_.size()) {
+    WaitForSingleObject(space_available_event_, INFINITE);
+  }
+
+  jobs_[index % jobs_.size()] = std::move(job);
+  posted_.store(index + 1, std::memory_order_release);
+  SetEvent(work_available_event_);
+}
+
+void IoWorker::PostWriteFile(std::string path, std::string contents) {
+  Post([path = std::move(path), contents = std::move(contents)]() {
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+      PrintMsg("Failed to open '%s'\n", path.c_str());
+      return;
+    }
+    if (fwrite(contents.data(), 1, contents.size(), fp) != contents.size()) {
+      PrintMsg("Failed to write '%s'\n", path.c_str());
+    }
+    fclose(fp);
+  });
+}
+
+void IoWorker::Flush() {
+  const uint32_t target = posted_.load(std::memory_order_relaxed);
+  while (completed_.load(std::memory_order_acquire) != target) {
+    WaitForSingleObject(idle_event_, INFINITE);
+  }
+}
+
+void IoWorker::SetLogFile(std::string path) {
+  Post([this, path = std::move(path)]() {
+    if (log_file_) {
+      fclose(log_file_);
+    }
+    log_file_ = fopen(path.c_str(), "a");
+    if (!log_file_) {
+      DbgPrint("Failed to open log file '%s'\n", path.c_str());
+    }
+  });
+}
+
+void IoWorker::Log(const char *message, uint32_t length) {
+  log_ring_.Write(message, length);
+  // Dropped messages still need a drain to report them.
+  if (!log_drain_pending_.exchange(true)) {
+    Post([this]() { DrainLog(); });
+  }
+}
+
+void IoWorker::DrainLog() {
+  // Cleared before draining so that a message written during the drain is guaranteed a new job.
+  log_drain_pending_.store(false);
+
+  log_ring_.Drain(
+      [](void *context, const char *message, uint32_t length) {
+        DbgPrint("%s", message);
+        auto log_file = static_cast<FILE *>(context);
+        if (log_file) {
+          fwrite(message, 1, length, log_file);
+        }
+      },
+      log_file_);
+
+  const uint32_t dropped = log_ring_.TakeDroppedCount();
+  if (dropped) {
+    DbgPrint("[%u log messages dropped]\n", dropped);
+    if (log_file_) {
+      fprintf(log_file_, "[%u log messages dropped]\n", dropped);
+    }
+  }
+  if (log_file_) {
+    // Keeps the log useful if the run ends in a crash.
+    fflush(log_file_);
+  }
+}
+
+bool IoWorker::LogActive(const char *message, uint32_t length) {
+  if (!active_ || !active_->IsProducerThread()) {
+    return false;
+  }
+
+  active_->Log(message, length);
+  return true;
+}
+
+void IoWorker::FlushActive() {
+  if (active_ && active_->IsProducerThread()) {
+    active_->Flush();
+  }
+}
+
+DWORD WINAPI IoWorker::ThreadProc(LPVOID param) {
+  static_cast<IoWorker *>(param)->ProcessJobs();
+  return 0;
+}
+
+void IoWorker::ProcessJobs() {
+  while (true) {
+    const uint32_t index = consumed_.load(std::memory_order_relaxed);
+    if (index == posted_.load(std::memory_order_acquire)) {
+      SetEvent(idle_event_);
+      if (shutdown_requested_.load()) {
+        return;
+      }
+      WaitForSingleObject(work_available_event_, INFINITE);
+      continue;
+    }
+
+    // The slot is released before the job runs so that the producer is not held up by a slow write.
+    Job job = std::move(jobs_[index % jobs_.size()]);
+    jobs_[index % jobs_.size()] = nullptr;
+    consumed_.store(index + 1, std::memory_order_release);
+    SetEvent(space_available_event_);
+
+    job();
+    completed_.store(index + 1, std::memory_order_release);
+  }
+}
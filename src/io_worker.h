@@ -0,0 +1,82 @@
+#ifndef NXDK_PGRAPH_TESTS_IO_WORKER_H
+#define NXDK_PGRAPH_TESTS_IO_WORKER_H
+
+#include <windows.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "log_ring.h"
+
+// Runs file writes and debug logging on a dedicated thread so that the render thread never blocks on FATX or serial
+// output.
+//
+// Jobs are passed through a bounded lock-free single producer/single consumer ring. Only the thread that constructed
+// the worker may post jobs; Post blocks if the ring is full. Log messages are copied into a separate fixed size
+// LogRing, which the worker drains, so logging never allocates or blocks.
+class IoWorker {
+ public:
+  using Job = std::function<void()>;
+
+ public:
+  explicit IoWorker(uint32_t capacity = 256, uint32_t log_capacity = 64 * 1024);
+  ~IoWorker();
+
+  // Queues `job` to be run on the worker thread. Jobs run in the order they were posted.
+  void Post(Job job);
+  // Queues `contents` to be written to `path`, replacing any existing file.
+  void PostWriteFile(std::string path, std::string contents);
+
+  // Blocks until every posted job has run.
+  void Flush();
+
+  // Appends every subsequent log message to the file at `path`, in addition to the debug output.
+  void SetLogFile(std::string path);
+
+  // Returns true if called from the thread that may post to this worker.
+  bool IsProducerThread() const { return GetCurrentThreadId() == producer_thread_id_; }
+
+  // Queues `message` to be sent to the debug output by the most recently constructed worker. Returns false, leaving
+  // the caller to print the message itself, if there is no worker or the calling thread may not post to it.
+  static bool LogActive(const char *message, uint32_t length);
+  // Flushes the most recently constructed worker if called from its producer thread.
+  static void FlushActive();
+
+ private:
+  static DWORD WINAPI ThreadProc(LPVOID param);
+  void ProcessJobs();
+
+  void Log(const char *message, uint32_t length);
+  // Writes the contents of log_ring_ to the debug output and log file. Worker thread only.
+  void DrainLog();
+
+ private:
+  std::vector<Job> jobs_;
+  // Total number of jobs posted, completed by the worker, and removed from the ring. Slots are indexed modulo the
+  // ring size.
+  std::atomic<uint32_t> posted_{0};
+  std::atomic<uint32_t> completed_{0};
+  std::atomic<uint32_t> consumed_{0};
+  std::atomic<bool> shutdown_requested_{false};
+
+  LogRing log_ring_;
+  // Set while a DrainLog job is queued.
+  std::atomic<bool> log_drain_pending_{false};
+  // Only accessed by the worker thread.
+  FILE *log_file_{nullptr};
+
+  DWORD producer_thread_id_{0};
+  HANDLE worker_thread_{nullptr};
+  HANDLE work_available_event_{nullptr};
+  HANDLE space_available_event_{nullptr};
+  HANDLE idle_event_{nullptr};
+
+  IoWorker *previous_{nullptr};
+  static IoWorker *active_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_IO_WORKER_H
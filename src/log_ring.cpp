@@ -0,0 +1,64 @@
+#include "log_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint32_t kHeaderSize = sizeof(uint16_t);
+
+LogRing::LogRing(uint32_t capacity) {
+  uint32_t size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  buffer_.resize(size);
+  mask_ = size - 1;
+}
+
+void LogRing::CopyIn(uint32_t position, const void *data, uint32_t size) {
+  const uint32_t offset = position & mask_;
+  const uint32_t first = std::min(size, static_cast<uint32_t>(buffer_.size()) - offset);
+  memcpy(&buffer_[offset], data, first);
+  memcpy(&buffer_[0], static_cast<const char *>(data) + first, size - first);
+}
+
+void LogRing::CopyOut(uint32_t position, void *data, uint32_t size) const {
+  const uint32_t offset = position & mask_;
+  const uint32_t first = std::min(size, static_cast<uint32_t>(buffer_.size()) - offset);
+  memcpy(data, &buffer_[offset], first);
+  memcpy(static_cast<char *>(data) + first, &buffer_[0], size - first);
+}
+
+bool LogRing::Write(const char *message, uint32_t length) {
+  length = std::min(length, kMaxMessageLength);
+
+  const uint32_t head = head_.load(std::memory_order_relaxed);
+  const uint32_t used = head - tail_.load(std::memory_order_acquire);
+  if (used + kHeaderSize + length > buffer_.size()) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  const auto header = static_cast<uint16_t>(length);
+  CopyIn(head, &header, kHeaderSize);
+  CopyIn(head + kHeaderSize, message, length);
+  head_.store(head + kHeaderSize + length, std::memory_order_release);
+  return true;
+}
+
+void LogRing::Drain(Sink sink, void *context) {
+  char message[kMaxMessageLength + 1];
+
+  uint32_t tail = tail_.load(std::memory_order_relaxed);
+  const uint32_t head = head_.load(std::memory_order_acquire);
+  while (tail != head) {
+    uint16_t length;
+    CopyOut(tail, &length, kHeaderSize);
+    CopyOut(tail + kHeaderSize, message, length);
+    message[length] = 0;
+
+    // The space is released before the sink runs so that the producer is not held up by slow output.
+    tail += kHeaderSize + length;
+    tail_.store(tail, std::memory_order_release);
+    sink(context, message, length);
+  }
+}
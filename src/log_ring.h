@@ -0,0 +1,45 @@
+#ifndef NXDK_PGRAPH_TESTS_LOG_RING_H
+#define NXDK_PGRAPH_TESTS_LOG_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Fixed size single producer/single consumer ring of log messages.
+//
+// Each message is stored as a 16-bit length followed by its characters, so writing and draining never allocate.
+// Messages that do not fit are dropped and counted rather than blocking the producer.
+class LogRing {
+ public:
+  // Messages longer than this are truncated.
+  static constexpr uint32_t kMaxMessageLength = 511;
+
+  using Sink = void (*)(void *context, const char *message, uint32_t length);
+
+ public:
+  // `capacity` is rounded up to a power of two.
+  explicit LogRing(uint32_t capacity);
+
+  // Appends `message`. Returns false if it was dropped because the ring is full. Producer only.
+  bool Write(const char *message, uint32_t length);
+
+  // Passes each message written since the last drain, in order and null terminated, to `sink`. Consumer only.
+  void Drain(Sink sink, void *context);
+
+  // Returns the number of messages dropped since the last call.
+  uint32_t TakeDroppedCount() { return dropped_.exchange(0); }
+
+ private:
+  void CopyIn(uint32_t position, const void *data, uint32_t size);
+  void CopyOut(uint32_t position, void *data, uint32_t size) const;
+
+ private:
+  std::vector<char> buffer_;
+  uint32_t mask_;
+  // Total number of bytes written and consumed. Positions within buffer_ are taken modulo its size.
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  std::atomic<uint32_t> dropped_{0};
+};
+
+#endif  // NXDK_PGRAPH_TESTS_LOG_RING_H
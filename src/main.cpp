@@ -3,54 +3,116 @@
  * using pbkit. Based on the pbkit demo sources.
  */
 
-#include <SDL_image.h>
 #include <hal/debug.h>
 #include <hal/video.h>
 #include <nxdk/mount.h>
 #include <pbkit/pbkit.h>
 #include <windows.h>
+#ifdef NETWORK_RESULTS_HOST
+#include <nxdk/net.h>
+#endif
 
+#include <cstdio>
 #include <memory>
 #include <vector>
 
+#ifdef NETWORK_RESULTS_HOST
+#include "network_result_sink.h"
+#endif
+#include "hash_manifest.h"
+#include "memory_tracker.h"
+#include "parameter_sweep.h"
+#include "results_manifest.h"
 #include "test_driver.h"
+#include "test_filter.h"
 #include "test_host.h"
+#include "test_suite_registry.h"
 #include "tests/attribute_carryover_tests.h"
 #include "tests/attribute_explicit_setter_tests.h"
+#include "tests/attribute_format_tests.h"
 #include "tests/combiner_tests.h"
+#include "tests/depth_benchmark_tests.h"
 #include "tests/depth_format_tests.h"
+#include "tests/draw_path_benchmark_tests.h"
+#include "tests/fill_rate_benchmark_tests.h"
+#include "tests/fog_benchmark_tests.h"
 #include "tests/fog_tests.h"
 #include "tests/front_face_tests.h"
 #include "tests/image_blit_tests.h"
+#include "tests/lighting_benchmark_tests.h"
 #include "tests/lighting_normal_tests.h"
 #include "tests/material_alpha_tests.h"
 #include "tests/material_color_source_tests.h"
 #include "tests/material_color_tests.h"
+#include "tests/pushbuffer_bandwidth_tests.h"
+#include "tests/render_target_layout_benchmark_tests.h"
 #include "tests/set_vertex_data_tests.h"
+#include "tests/state_change_benchmark_tests.h"
 #include "tests/texture_border_tests.h"
 #include "tests/texture_format_tests.h"
 #include "tests/texture_render_target_tests.h"
+#include "tests/texture_sampling_benchmark_tests.h"
 #include "tests/three_d_primitive_tests.h"
+#include "tests/trace_replay_tests.h"
 #include "tests/two_d_line_tests.h"
 #include "tests/vertex_shader_rounding_tests.h"
+#include "tests/vertex_shader_throughput_tests.h"
 #include "tests/volume_texture_tests.h"
 #include "tests/w_param_tests.h"
 #include "tests/zero_stride_tests.h"
 
 #define FALLBACK_XBE_DIRECTORY "f:\\";
-static constexpr int kFramebufferWidth = 640;
-static constexpr int kFramebufferHeight = 480;
+// Optional list of "Suite name/Test name" glob patterns selecting the tests to register (see TestFilter). D: is always
+// mapped to the directory containing the XBE.
+static constexpr const char* kTestFilterPath = "D:\\test_filter.txt";
+// Optional "<index>/<count>" (e.g., "0/4") selecting a disjoint slice of the registered tests, allowing a full run to
+// be split across several machines.
+static constexpr const char* kTestShardPath = "D:\\test_shard.txt";
+// Optional coverage and axis overrides for suites that register their tests via ParameterSweep (see
+// ParameterSweep::LoadConfiguration).
+static constexpr const char* kSweepConfigPath = "D:\\sweep_config.txt";
+// Optional "<width>x<height> [<samples>]" (e.g., "1280x720 4") selecting the framebuffer resolution and the number of
+// antialiasing samples per pixel (1, 2, or 4). Captures are always saved at the framebuffer resolution.
+static constexpr const char* kVideoModePath = "D:\\video_mode.txt";
+static constexpr int kDefaultFramebufferWidth = 640;
+static constexpr int kDefaultFramebufferHeight = 480;
 static constexpr int kTextureWidth = 256;
 static constexpr int kTextureHeight = 256;
 
-static void register_suites(TestHost& host, std::vector<std::shared_ptr<TestSuite>>& test_suites,
-                            const std::string& output_directory);
+static void register_suites(TestHost& host, TestSuiteRegistry& registry, const std::string& output_directory);
+static bool load_test_shard(uint32_t& shard_index, uint32_t& shard_count);
+static bool load_video_mode(int& width, int& height, TestHost::AntiAliasingSetting& anti_aliasing);
 static bool get_xbe_directory(std::string& xbe_root_directory);
 static bool get_test_output_path(std::string& test_output_directory);
+static DWORD WINAPI prepare_output_directory(LPVOID param);
+#ifdef NETWORK_RESULTS_HOST
+static void stream_results(TestHost& host);
+#endif
+
+struct OutputDirectoryTask {
+  const std::string& directory;
+  // Whether F: must be mounted before `directory` is accessible.
+  bool mount_required;
+  bool succeeded;
+};
 
 /* Main program function */
 int main() {
-  XVideoSetMode(kFramebufferWidth, kFramebufferHeight, 32, REFRESH_DEFAULT);
+  // SDL's heap must be hooked before SDL allocates anything.
+  MemoryTracker::InstallSDLHeapHooks();
+
+  int framebuffer_width = kDefaultFramebufferWidth;
+  int framebuffer_height = kDefaultFramebufferHeight;
+  TestHost::AntiAliasingSetting anti_aliasing = TestHost::AA_CENTER_1;
+  load_video_mode(framebuffer_width, framebuffer_height, anti_aliasing);
+  if (!XVideoSetMode(framebuffer_width, framebuffer_height, 32, REFRESH_DEFAULT)) {
+    // HD modes require an HD capable AV pack and dashboard setting.
+    debugPrint("Video mode %dx%d is not supported, falling back to %dx%d\n", framebuffer_width, framebuffer_height,
+               kDefaultFramebufferWidth, kDefaultFramebufferHeight);
+    framebuffer_width = kDefaultFramebufferWidth;
+    framebuffer_height = kDefaultFramebufferHeight;
+    XVideoSetMode(framebuffer_width, framebuffer_height, 32, REFRESH_DEFAULT);
+  }
 
   int status = pb_init();
   if (status) {
@@ -60,38 +122,134 @@ int main() {
     return 1;
   }
 
-  if (SDL_Init(SDL_INIT_GAMECONTROLLER)) {
-    debugPrint("Failed to initialize SDL_GAMECONTROLLER.");
-    debugPrint("%s", SDL_GetError());
-    pb_show_debug_screen();
-    Sleep(2000);
-    return 1;
-  }
+  // SDL_image and the game controller subsystem are initialized on first use (see SDLSubsystems).
 
-  if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
-    debugPrint("Failed to initialize SDL_image PNG mode.");
-    pb_show_debug_screen();
-    Sleep(2000);
-    return 1;
+  std::string test_output_directory;
+  const bool mount_required = get_test_output_path(test_output_directory);
+
+  uint32_t shard_index = 0;
+  uint32_t shard_count = 1;
+  const bool sharded = load_test_shard(shard_index, shard_count);
+  if (sharded) {
+    // Each shard writes into its own directory so that results from several machines can be merged without conflict.
+    char shard_directory[32];
+    snprintf(shard_directory, sizeof(shard_directory), "\\shard_%u_of_%u", shard_index, shard_count);
+    test_output_directory += shard_directory;
   }
 
-  std::string test_output_directory;
-  if (!get_test_output_path(test_output_directory)) {
-    debugPrint("Failed to mount F:");
-    pb_show_debug_screen();
-    Sleep(2000);
-    return 1;
-  };
+  // Mounting the output drive and creating the output directory are overlapped with host setup and suite registration,
+  // none of which write to the output directory.
+  OutputDirectoryTask output_task{test_output_directory, mount_required, false};
+  HANDLE output_thread = CreateThread(nullptr, 0, prepare_output_directory, &output_task, 0, nullptr);
+  if (!output_thread) {
+    prepare_output_directory(&output_task);
+  }
 
   pb_show_front_screen();
 
-  TestHost host(kFramebufferWidth, kFramebufferHeight, kTextureWidth, kTextureHeight);
+  TestHost host(framebuffer_width, framebuffer_height, kTextureWidth, kTextureHeight);
+  host.SetAntiAliasing(anti_aliasing);
+#if defined(CAPTURE_FORMAT_QOI)
+  host.SetSaveFormat(CaptureQueue::FORMAT_QOI);
+#elif defined(CAPTURE_FORMAT_RAW)
+  host.SetSaveFormat(CaptureQueue::FORMAT_RAW);
+#endif
+#ifdef SKIP_UNCHANGED_RESULTS
+  host.SetSkipUnchangedResults();
+#endif
+#ifdef COMPARE_GOLDEN_RESULTS
+  host.SetCompareWithGolden(true, GOLDEN_TOLERANCE);
+#endif
+#ifdef ARCHIVE_RESULTS
+  host.SetArchiveResults();
+#endif
+#ifdef THROUGHPUT_MODE
+  host.SetThroughputMode();
+#endif
+#ifdef ELIDE_UNIFORM_ATTRIBUTES
+  host.SetElideUniformAttributes();
+#endif
+#ifdef GPU_PROFILING
+  host.SetGpuProfilingEnabled();
+#endif
+#ifdef TRACE_CAPTURE
+  host.SetTraceCaptureEnabled();
+#endif
+#ifdef TILED_RENDERING
+  host.SetMaxTilesPerFrame(TILED_RENDERING_TILES);
+#endif
+#ifdef NETWORK_RESULTS_HOST
+  stream_results(host);
+#endif
+
+#ifdef PAIRWISE_SWEEPS
+  ParameterSweep::SetDefaultCoverage(ParameterSweep::COVERAGE_PAIRWISE);
+#endif
+  ParameterSweep::LoadConfiguration(kSweepConfigPath);
 
-  std::vector<std::shared_ptr<TestSuite>> test_suites;
+  TestSuiteRegistry test_suites;
   register_suites(host, test_suites, test_output_directory);
 
-  TestDriver driver(host, test_suites, kFramebufferWidth, kFramebufferHeight);
+  TestFilter filter;
+  const bool filtered = filter.Load(kTestFilterPath) && !filter.IsEmpty();
+  if (filtered) {
+    // Suites that cannot contain a selected test are dropped without ever being constructed.
+    test_suites.RetainSuites([&filter](const std::string& suite_name) { return filter.MayMatchSuite(suite_name); });
+  }
+  if (filtered || sharded) {
+    test_suites.SetSetup([&filter, filtered, sharded, shard_index, shard_count](TestSuite& suite) {
+      if (filtered) {
+        suite.ApplyFilter(filter);
+      }
+      if (sharded) {
+        // Tests are assigned by a hash of their name rather than their position so that the partition can be computed
+        // one suite at a time and is unaffected by which other suites are registered.
+        const std::string key_prefix = suite.Name() + "/";
+        suite.RetainTests([&key_prefix, shard_index, shard_count](const std::string& test_name) {
+          const std::string key = key_prefix + test_name;
+          return XXH32(key.c_str(), key.size()) % shard_count == shard_index;
+        });
+      }
+    });
+  }
+
+  if (output_thread) {
+    WaitForSingleObject(output_thread, INFINITE);
+    CloseHandle(output_thread);
+  }
+  if (!output_task.succeeded) {
+    debugPrint("Failed to mount F:");
+    pb_show_debug_screen();
+    Sleep(2000);
+    return 1;
+  }
+#ifdef PERSIST_LOG
+  host.GetIoWorker().SetLogFile(test_output_directory + "\\log.txt");
+#endif
+
+  TestDriver driver(host, test_suites, framebuffer_width, framebuffer_height);
+  // Lets a run that crashed or hung the machine pick up where it left off after a reboot.
+  driver.SetProgressJournalPath(test_output_directory + "\\progress_journal.txt");
+  driver.SetResultsManifestPath(test_output_directory + "\\" + ResultsManifest::kFilename);
+#ifdef HEADLESS
+  driver.SetHeadless();
+#ifndef DISABLE_AUTORUN
+  // Nobody is watching a headless run, so the autorun countdown only delays it.
+  driver.SetSkipMenu();
+#endif
+#endif
+#ifdef PIPELINED_MODE
+  driver.SetPipelined();
+#endif
+#ifdef SUSTAINED_BENCHMARKS
+  driver.SetSustainedBenchmarkMode(
+      {SUSTAINED_BENCHMARK_WARMUP, SUSTAINED_BENCHMARK_ITERATIONS, SUSTAINED_BENCHMARK_DURATION_MS});
+#endif
+#ifdef SOAK_MODE
+  driver.SetSoakMode({SOAK_PASSES, SOAK_DURATION_MINUTES * 60 * 1000});
+#endif
   driver.Run();
+  host.WaitForPendingSaves();
 
   debugPrint("Results written to %s\n\nRebooting in 4 seconds...\n", test_output_directory.c_str());
   pb_show_debug_screen();
@@ -101,131 +259,148 @@ int main() {
   return 0;
 }
 
+// Returns true if the returned directory is on F:, which must be mounted before use.
 bool get_xbe_directory(std::string& xbe_root_directory) {
   std::string xbe_directory = XeImageFileName->Buffer;
   if (xbe_directory.find("\\Device\\CdRom") == 0) {
     debugPrint("Running from readonly media, using default path for test output.\n");
     xbe_root_directory = FALLBACK_XBE_DIRECTORY;
-
-    if (!nxMountDrive('F', R"(\Device\Harddisk0\Partition6)")) {
-      return false;
-    }
     return true;
   }
 
   xbe_root_directory = "D:";
-  return true;
+  return false;
 }
 
+// Returns true if the returned directory is on F:, which must be mounted before use.
 static bool get_test_output_path(std::string& test_output_directory) {
-  if (!get_xbe_directory(test_output_directory)) {
-    return false;
-  }
+  const bool mount_required = get_xbe_directory(test_output_directory);
   if (test_output_directory.back() == '\\') {
     test_output_directory.pop_back();
   }
   test_output_directory += "\\nxdk_pgraph_tests";
-  return true;
+  return mount_required;
 }
 
-static void register_suites(TestHost& host, std::vector<std::shared_ptr<TestSuite>>& test_suites,
-                            const std::string& output_directory) {
-  // Must be the first suite run for valid results. The first test depends on having a cleared initial state.
-  {
-    auto suite = std::make_shared<LightingNormalTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
+static DWORD WINAPI prepare_output_directory(LPVOID param) {
+  auto task = static_cast<OutputDirectoryTask*>(param);
+  if (task->mount_required && !nxMountDrive('F', R"(\Device\Harddisk0\Partition6)")) {
+    task->succeeded = false;
+    return 0;
   }
 
-  {
-    auto suite = std::make_shared<AttributeCarryoverTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<AttributeExplicitSetterTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<CombinerTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<FogTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<FogCustomShaderTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<FogInfiniteFogCoordinateTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<FogVec4CoordTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<FrontFaceTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<DepthFormatTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<ImageBlitTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<MaterialAlphaTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<MaterialColorTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<MaterialColorSourceTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<SetVertexDataTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<TextureBorderTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<TextureFormatTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
-  }
-  {
-    auto suite = std::make_shared<TextureRenderTargetTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
+  TestHost::EnsureFolderExists(task->directory);
+  task->succeeded = true;
+  return 0;
+}
+
+static bool load_test_shard(uint32_t& shard_index, uint32_t& shard_count) {
+  FILE* fp = fopen(kTestShardPath, "r");
+  if (!fp) {
+    return false;
   }
-  {
-    auto suite = std::make_shared<ThreeDPrimitiveTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
+
+  unsigned int index = 0;
+  unsigned int count = 0;
+  int parsed = fscanf(fp, "%u/%u", &index, &count);
+  fclose(fp);
+
+  if (parsed != 2 || !count || index >= count) {
+    debugPrint("Ignoring invalid shard specification in %s\n", kTestShardPath);
+    return false;
   }
-  {
-    auto suite = std::make_shared<TwoDLineTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
+
+  shard_index = index;
+  shard_count = count;
+  return true;
+}
+
+static bool load_video_mode(int& width, int& height, TestHost::AntiAliasingSetting& anti_aliasing) {
+  FILE* fp = fopen(kVideoModePath, "r");
+  if (!fp) {
+    return false;
   }
-  {
-    auto suite = std::make_shared<VertexShaderRoundingTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
+
+  int mode_width = 0;
+  int mode_height = 0;
+  int samples = 1;
+  int parsed = fscanf(fp, "%dx%d %d", &mode_width, &mode_height, &samples);
+  fclose(fp);
+
+  const bool valid_mode = (mode_width == 640 && mode_height == 480) || (mode_width == 720 && mode_height == 480) ||
+                          (mode_width == 1280 && mode_height == 720);
+  if (parsed < 2 || !valid_mode || (samples != 1 && samples != 2 && samples != 4)) {
+    debugPrint("Ignoring invalid video mode specification in %s\n", kVideoModePath);
+    return false;
   }
-  {
-    auto suite = std::make_shared<VolumeTextureTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
+
+  width = mode_width;
+  height = mode_height;
+  if (samples == 4) {
+    anti_aliasing = TestHost::AA_SQUARE_OFFSET_4;
+  } else if (samples == 2) {
+    anti_aliasing = TestHost::AA_CENTER_CORNER_2;
+  } else {
+    anti_aliasing = TestHost::AA_CENTER_1;
   }
-  {
-    auto suite = std::make_shared<WParamTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
+  return true;
+}
+
+static void register_suites(TestHost& host, TestSuiteRegistry& registry, const std::string& output_directory) {
+  // Must be the first suite run for valid results. The first test depends on having a cleared initial state.
+  registry.Register<LightingNormalTests>("Lighting normals", host, output_directory);
+
+  registry.Register<AttributeCarryoverTests>("Attrib carryover", host, output_directory);
+  registry.Register<AttributeExplicitSetterTests>("Attrib setter", host, output_directory);
+  registry.Register<AttributeFormatTests>("Attribute format", host, output_directory);
+  registry.Register<CombinerTests>("Combiner", host, output_directory);
+  registry.Register<FogTests>("Fog", host, output_directory);
+  registry.Register<FogCustomShaderTests>("Fog vsh", host, output_directory);
+  registry.Register<FogInfiniteFogCoordinateTests>("Fog inf coord", host, output_directory);
+  registry.Register<FogVec4CoordTests>("Fog coord vec4", host, output_directory);
+  registry.Register<FrontFaceTests>("Front face", host, output_directory);
+  registry.Register<DepthFormatTests>("Depth buffer", host, output_directory);
+  registry.Register<ImageBlitTests>("Image blit", host, output_directory);
+  registry.Register<MaterialAlphaTests>("Material alpha", host, output_directory);
+  registry.Register<MaterialColorTests>("Material color", host, output_directory);
+  registry.Register<MaterialColorSourceTests>("Material color source", host, output_directory);
+  registry.Register<SetVertexDataTests>("SetVertexData", host, output_directory);
+  registry.Register<TextureBorderTests>("Texture border", host, output_directory);
+  registry.Register<TextureFormatTests>("Texture format", host, output_directory);
+  registry.Register<TextureRenderTargetTests>("Texture render target", host, output_directory);
+  registry.Register<ThreeDPrimitiveTests>("3D primitive", host, output_directory);
+  registry.Register<TwoDLineTests>("2D Lines", host, output_directory);
+  registry.Register<VertexShaderRoundingTests>("Vertex shader rounding tests", host, output_directory);
+  registry.Register<VertexShaderThroughputTests>("VS throughput", host, output_directory);
+  registry.Register<FillRateBenchmarkTests>("Fill rate", host, output_directory);
+  registry.Register<DrawPathBenchmarkTests>("Draw path", host, output_directory);
+  registry.Register<PushbufferBandwidthTests>("Pushbuffer bandwidth", host, output_directory);
+  registry.Register<TextureSamplingBenchmarkTests>("Texture sampling", host, output_directory);
+  registry.Register<DepthBenchmarkTests>("Depth performance", host, output_directory);
+  registry.Register<StateChangeBenchmarkTests>("State change", host, output_directory);
+  registry.Register<LightingBenchmarkTests>("Lighting performance", host, output_directory);
+  registry.Register<FogBenchmarkTests>("Fog performance", host, output_directory);
+  registry.Register<RenderTargetLayoutBenchmarkTests>("Render target layout", host, output_directory);
+  registry.Register<VolumeTextureTests>("Volume texture", host, output_directory);
+  registry.Register<WParamTests>("W param", host, output_directory);
+  registry.Register<ZeroStrideTests>("Zero stride", host, output_directory);
+  registry.Register<TraceReplayTests>("Trace replay", host, output_directory);
+}
+
+#ifdef NETWORK_RESULTS_HOST
+// Sends results to the collector at NETWORK_RESULTS_HOST, falling back to writing them locally on failure.
+static void stream_results(TestHost& host) {
+  if (nxNetInit(nullptr)) {
+    debugPrint("Failed to initialize network, saving results locally.\n");
+    return;
   }
-  {
-    auto suite = std::make_shared<ZeroStrideTests>(host, output_directory);
-    test_suites.push_back(std::dynamic_pointer_cast<TestSuite>(suite));
+
+  auto sink = std::make_unique<NetworkResultSink>();
+  if (!sink->Connect(NETWORK_RESULTS_HOST, NETWORK_RESULTS_PORT)) {
+    debugPrint("Failed to connect to %s:%d, saving results locally.\n", NETWORK_RESULTS_HOST, NETWORK_RESULTS_PORT);
+    return;
   }
+
+  host.SetResultSink(std::move(sink));
 }
+#endif
@@ -0,0 +1,88 @@
+#include "math3d_sse.h"
+
+#include <xmmintrin.h>
+
+// Selects the X, Y, and Z components of a vector. Built from raw bits as the SSE2 integer intrinsics are unavailable.
+alignas(16) static const uint32_t kXYZMask[4] = {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0};
+
+// Returns sum(row[i] * rows[i]) for a row vector `row`, i.e., one row of row * [rows].
+static inline __m128 CombineRows(__m128 row, const __m128 *rows) {
+  __m128 ret = _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0)), rows[0]);
+  ret = _mm_add_ps(ret, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1)), rows[1]));
+  ret = _mm_add_ps(ret, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2)), rows[2]));
+  return _mm_add_ps(ret, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3)), rows[3]));
+}
+
+static inline void LoadRows(__m128 *rows, const MATRIX matrix) {
+  rows[0] = _mm_loadu_ps(matrix + _11);
+  rows[1] = _mm_loadu_ps(matrix + _21);
+  rows[2] = _mm_loadu_ps(matrix + _31);
+  rows[3] = _mm_loadu_ps(matrix + _41);
+}
+
+static inline void LoadColumns(__m128 *columns, const MATRIX matrix) {
+  LoadRows(columns, matrix);
+  _MM_TRANSPOSE4_PS(columns[0], columns[1], columns[2], columns[3]);
+}
+
+void matrix_unit_sse(MATRIX output) {
+  const __m128 one = _mm_set_ss(1.0f);
+  _mm_storeu_ps(output + _11, one);
+  _mm_storeu_ps(output + _21, _mm_shuffle_ps(one, one, _MM_SHUFFLE(1, 1, 0, 1)));
+  _mm_storeu_ps(output + _31, _mm_shuffle_ps(one, one, _MM_SHUFFLE(1, 0, 1, 1)));
+  _mm_storeu_ps(output + _41, _mm_shuffle_ps(one, one, _MM_SHUFFLE(0, 1, 1, 1)));
+}
+
+void matrix_multiply_sse(MATRIX output, const MATRIX input0, const MATRIX input1) {
+  __m128 a[4];
+  __m128 b[4];
+  LoadRows(a, input0);
+  LoadRows(b, input1);
+
+  _mm_storeu_ps(output + _11, CombineRows(a[0], b));
+  _mm_storeu_ps(output + _21, CombineRows(a[1], b));
+  _mm_storeu_ps(output + _31, CombineRows(a[2], b));
+  _mm_storeu_ps(output + _41, CombineRows(a[3], b));
+}
+
+void matrix_inverse_sse(MATRIX output, const MATRIX input0) {
+  __m128 work[4];
+  LoadColumns(work, input0);
+
+  // Clear the _14, _24, _34 terms of the transposed rotation.
+  const __m128 xyz_mask = _mm_load_ps(reinterpret_cast<const float *>(kXYZMask));
+  work[0] = _mm_and_ps(work[0], xyz_mask);
+  work[1] = _mm_and_ps(work[1], xyz_mask);
+  work[2] = _mm_and_ps(work[2], xyz_mask);
+
+  // The translation row is the negated original translation, rotated into the new basis.
+  __m128 translation = _mm_mul_ps(_mm_set1_ps(input0[_41]), work[0]);
+  translation = _mm_add_ps(translation, _mm_mul_ps(_mm_set1_ps(input0[_42]), work[1]));
+  translation = _mm_add_ps(translation, _mm_mul_ps(_mm_set1_ps(input0[_43]), work[2]));
+  translation = _mm_sub_ps(_mm_setzero_ps(), translation);
+  work[3] = _mm_or_ps(_mm_and_ps(translation, xyz_mask), _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f));
+
+  _mm_storeu_ps(output + _11, work[0]);
+  _mm_storeu_ps(output + _21, work[1]);
+  _mm_storeu_ps(output + _31, work[2]);
+  _mm_storeu_ps(output + _41, work[3]);
+}
+
+void vector_apply_sse(VECTOR output, const VECTOR input0, const MATRIX input1) {
+  __m128 columns[4];
+  LoadColumns(columns, input1);
+  _mm_storeu_ps(output, CombineRows(_mm_loadu_ps(input0), columns));
+}
+
+void vector_apply_batch_sse(float *output, uint32_t output_stride, const float *input, uint32_t input_stride,
+                            uint32_t count, const MATRIX matrix) {
+  __m128 columns[4];
+  LoadColumns(columns, matrix);
+
+  auto in = reinterpret_cast<const uint8_t *>(input);
+  auto out = reinterpret_cast<uint8_t *>(output);
+  for (uint32_t i = 0; i < count; ++i, in += input_stride, out += output_stride) {
+    __m128 result = CombineRows(_mm_loadu_ps(reinterpret_cast<const float *>(in)), columns);
+    _mm_storeu_ps(reinterpret_cast<float *>(out), result);
+  }
+}
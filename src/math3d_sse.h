@@ -0,0 +1,28 @@
+#ifndef NXDK_PGRAPH_TESTS_MATH3D_SSE_H
+#define NXDK_PGRAPH_TESTS_MATH3D_SSE_H
+
+#include <cstdint>
+
+#include "math3d.h"
+
+// SSE implementations of the math3d routines used when building per-test transforms. Results match the math3d
+// equivalents (up to floating point rounding) and the output may alias an input. No alignment is required.
+
+// As matrix_unit.
+void matrix_unit_sse(MATRIX output);
+
+// As matrix_multiply.
+void matrix_multiply_sse(MATRIX output, const MATRIX input0, const MATRIX input1);
+
+// As matrix_inverse (i.e., assumes `input0` is a rotation and translation).
+void matrix_inverse_sse(MATRIX output, const MATRIX input0);
+
+// As vector_apply.
+void vector_apply_sse(VECTOR output, const VECTOR input0, const MATRIX input1);
+
+// Applies vector_apply to `count` 4 component vectors that are `input_stride` bytes apart, writing the results
+// `output_stride` bytes apart (e.g., `&vertices[0].pos` with a stride of sizeof(Vertex)). `output` may equal `input`.
+void vector_apply_batch_sse(float *output, uint32_t output_stride, const float *input, uint32_t input_stride,
+                            uint32_t count, const MATRIX matrix);
+
+#endif  // NXDK_PGRAPH_TESTS_MATH3D_SSE_H
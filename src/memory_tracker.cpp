@@ -0,0 +1,148 @@
+#include "memory_tracker.h"
+
+#include <SDL.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "contiguous_memory_pool.h"
+
+static constexpr uint32_t kPageSize = 4096;
+// Each SDL allocation is prefixed with its size, padded to keep the memory returned to SDL 16 byte aligned.
+static constexpr uint32_t kHeapHeaderSize = 16;
+
+MemoryTracker::Counter MemoryTracker::counters_[CATEGORY_COUNT];
+MemoryTracker::Counter MemoryTracker::total_;
+
+void MemoryTracker::Counter::Add(uint32_t size) {
+  const uint32_t value = current += size;
+  uint32_t previous_peak = peak.load();
+  while (value > previous_peak && !peak.compare_exchange_weak(previous_peak, value)) {
+  }
+}
+
+void MemoryTracker::RecordAllocation(Category category, uint32_t size) {
+  counters_[category].Add(size);
+  total_.Add(size);
+}
+
+void MemoryTracker::RecordRelease(Category category, uint32_t size) {
+  counters_[category].Subtract(size);
+  total_.Subtract(size);
+}
+
+void MemoryTracker::ResetPeaks() {
+  for (auto &counter : counters_) {
+    counter.ResetPeak();
+  }
+  total_.ResetPeak();
+}
+
+static void *SDLCALL TrackedMalloc(size_t size) {
+  auto block = static_cast<uint8_t *>(malloc(size + kHeapHeaderSize));
+  if (!block) {
+    return nullptr;
+  }
+  *reinterpret_cast<size_t *>(block) = size;
+  MemoryTracker::RecordAllocation(MemoryTracker::CATEGORY_SDL_HEAP, size);
+  return block + kHeapHeaderSize;
+}
+
+static void *SDLCALL TrackedCalloc(size_t num_elements, size_t element_size) {
+  const size_t size = num_elements * element_size;
+  void *ret = TrackedMalloc(size);
+  if (ret) {
+    memset(ret, 0, size);
+  }
+  return ret;
+}
+
+static void SDLCALL TrackedFree(void *memory) {
+  if (!memory) {
+    return;
+  }
+  auto block = static_cast<uint8_t *>(memory) - kHeapHeaderSize;
+  MemoryTracker::RecordRelease(MemoryTracker::CATEGORY_SDL_HEAP, *reinterpret_cast<size_t *>(block));
+  free(block);
+}
+
+static void *SDLCALL TrackedRealloc(void *memory, size_t size) {
+  if (!memory) {
+    return TrackedMalloc(size);
+  }
+
+  auto block = static_cast<uint8_t *>(memory) - kHeapHeaderSize;
+  const size_t old_size = *reinterpret_cast<size_t *>(block);
+  auto new_block = static_cast<uint8_t *>(realloc(block, size + kHeapHeaderSize));
+  if (!new_block) {
+    return nullptr;
+  }
+  *reinterpret_cast<size_t *>(new_block) = size;
+  MemoryTracker::RecordRelease(MemoryTracker::CATEGORY_SDL_HEAP, old_size);
+  MemoryTracker::RecordAllocation(MemoryTracker::CATEGORY_SDL_HEAP, size);
+  return new_block + kHeapHeaderSize;
+}
+
+void MemoryTracker::InstallSDLHeapHooks() {
+  SDL_SetMemoryFunctions(TrackedMalloc, TrackedCalloc, TrackedRealloc, TrackedFree);
+}
+
+uint32_t MemoryTracker::GetAvailableSystemMemory() {
+  MM_STATISTICS statistics{};
+  statistics.Length = sizeof(statistics);
+  if (!NT_SUCCESS(MmQueryStatistics(&statistics))) {
+    return 0;
+  }
+  return statistics.AvailablePages * kPageSize;
+}
+
+const char *MemoryTracker::GetCategoryName(Category category) {
+  switch (category) {
+    case CATEGORY_TEXTURE:
+      return "texture";
+    case CATEGORY_TEXTURE_STAGING:
+      return "texture_staging";
+    case CATEGORY_RENDER_TARGET:
+      return "render_target";
+    case CATEGORY_VERTEX_BUFFER:
+      return "vertex_buffer";
+    case CATEGORY_LINEAR_VERTICES:
+      return "linear_vertices";
+    case CATEGORY_PUSHBUFFER_TRACE:
+      return "pushbuffer_trace";
+    case CATEGORY_GPU_PROFILER:
+      return "gpu_profiler";
+    case CATEGORY_SUITE:
+      return "suite";
+    case CATEGORY_SDL_HEAP:
+      return "sdl_heap";
+    case CATEGORY_COUNT:
+      break;
+  }
+  return "unknown";
+}
+
+std::string MemoryTracker::FormatUsageCSV() {
+  std::string ret = "category,current_bytes,peak_bytes\n";
+  char line[128];
+
+  for (uint32_t i = 0; i < CATEGORY_COUNT; ++i) {
+    auto category = static_cast<Category>(i);
+    auto usage = GetUsage(category);
+    snprintf(line, sizeof(line), "%s,%u,%u\n", GetCategoryName(category), usage.current, usage.peak);
+    ret += line;
+  }
+
+  auto total = GetTotalUsage();
+  snprintf(line, sizeof(line), "total,%u,%u\n", total.current, total.peak);
+  ret += line;
+
+  // Neither value is tracked over time, so only the current value is reported.
+  snprintf(line, sizeof(line), "pool_cached,%u,\n", ContiguousMemoryPool::GetCachedBytes());
+  ret += line;
+  snprintf(line, sizeof(line), "system_available,%u,\n", GetAvailableSystemMemory());
+  ret += line;
+  return ret;
+}
@@ -0,0 +1,77 @@
+#ifndef NXDK_PGRAPH_TESTS_MEMORY_TRACKER_H
+#define NXDK_PGRAPH_TESTS_MEMORY_TRACKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Tracks the current and peak number of bytes held by each category of contiguous and SDL heap allocation.
+//
+// ContiguousMemoryPool records its allocations automatically; memory obtained directly from the kernel must be
+// reported via RecordAllocation/RecordRelease. Memory allocated internally by pbkit cannot be attributed and is only
+// reflected in GetAvailableSystemMemory. Recording is thread safe, as SDL may allocate from the IoWorker thread.
+class MemoryTracker {
+ public:
+  enum Category {
+    CATEGORY_TEXTURE,
+    CATEGORY_TEXTURE_STAGING,
+    CATEGORY_RENDER_TARGET,
+    CATEGORY_VERTEX_BUFFER,
+    // Copies made by VertexBuffer::Linearize.
+    CATEGORY_LINEAR_VERTICES,
+    CATEGORY_PUSHBUFFER_TRACE,
+    CATEGORY_GPU_PROFILER,
+    // Memory allocated by individual test suites.
+    CATEGORY_SUITE,
+    // SDL surfaces and other allocations made through SDL_malloc.
+    CATEGORY_SDL_HEAP,
+
+    CATEGORY_COUNT,
+  };
+
+  struct Usage {
+    uint32_t current;
+    // The largest value of `current` since the last call to ResetPeaks.
+    uint32_t peak;
+  };
+
+ public:
+  static void RecordAllocation(Category category, uint32_t size);
+  static void RecordRelease(Category category, uint32_t size);
+
+  static Usage GetUsage(Category category) { return counters_[category].Get(); }
+  // Returns the sum of the current usage of every category along with the peak of that sum.
+  static Usage GetTotalUsage() { return total_.Get(); }
+
+  // Sets the peak of every category to its current usage, e.g., so that peaks may be attributed to a single suite.
+  static void ResetPeaks();
+
+  // Routes SDL's allocations through the tracker under CATEGORY_SDL_HEAP. Must be called before any other SDL
+  // function.
+  static void InstallSDLHeapHooks();
+
+  // Returns the number of bytes of physical memory the kernel has not yet committed.
+  static uint32_t GetAvailableSystemMemory();
+
+  static const char *GetCategoryName(Category category);
+
+  // Returns a CSV table of the usage of each category, the total, the bytes cached by ContiguousMemoryPool, and the
+  // available system memory.
+  static std::string FormatUsageCSV();
+
+ private:
+  struct Counter {
+    std::atomic<uint32_t> current{0};
+    std::atomic<uint32_t> peak{0};
+
+    void Add(uint32_t size);
+    void Subtract(uint32_t size) { current -= size; }
+    void ResetPeak() { peak = current.load(); }
+    Usage Get() const { return {current.load(), peak.load()}; }
+  };
+
+  static Counter counters_[CATEGORY_COUNT];
+  static Counter total_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_MEMORY_TRACKER_H
@@ -5,6 +5,9 @@
 #include <chrono>
 #include <utility>
 
+#include "memory_tracker.h"
+#include "test_host.h"
+#include "test_suite_registry.h"
 #include "tests/test_suite.h"
 
 static constexpr uint32_t kAutoTestAllTimeoutMilliseconds = 3000;
@@ -24,14 +27,10 @@ void MenuItem::PrepareDraw(uint32_t background_color) const {
 
 void MenuItem::Swap() {
   pb_draw_text_screen();
-  while (pb_busy()) {
-    /* Wait for completion... */
-  }
+  TestHost::WaitForPushbufferDrained();
 
   /* Swap buffers (if we can) */
-  while (pb_finished()) {
-    /* Not ready to swap yet */
-  }
+  TestHost::WaitForFlip();
 }
 
 void MenuItem::Draw() {
@@ -75,6 +74,13 @@ void MenuItem::Draw() {
     pb_print("...\n");
   }
 
+#ifdef MEMORY_OVERLAY
+  // Peaks cover the period since the most recently initialized suite began.
+  auto usage = MemoryTracker::GetTotalUsage();
+  pb_print("\nMem: %u KiB (peak %u KiB) Free: %u KiB\n", usage.current >> 10, usage.peak >> 10,
+           MemoryTracker::GetAvailableSystemMemory() >> 10);
+#endif
+
   Swap();
 }
 
@@ -85,8 +91,16 @@ void MenuItem::Activate() {
     active_submenu->Activate();
     return;
   }
+  if (submenu.empty()) {
+    return;
+  }
 
   auto activated_item = submenu[cursor_position];
+  activated_item->Populate();
+  if (activated_item->IsEmpty()) {
+    RemoveCurrentItem();
+    return;
+  }
   if (activated_item->IsEnterable()) {
     active_submenu = activated_item;
     activated_item->OnEnter();
@@ -100,10 +114,25 @@ void MenuItem::ActivateCurrentSuite() {
     active_submenu->ActivateCurrentSuite();
     return;
   }
+  if (submenu.empty()) {
+    return;
+  }
   auto activated_item = submenu[cursor_position];
+  activated_item->Populate();
+  if (activated_item->IsEmpty()) {
+    RemoveCurrentItem();
+    return;
+  }
   activated_item->ActivateCurrentSuite();
 }
 
+void MenuItem::RemoveCurrentItem() {
+  submenu.erase(submenu.begin() + cursor_position);
+  if (cursor_position && cursor_position >= submenu.size()) {
+    --cursor_position;
+  }
+}
+
 bool MenuItem::Deactivate() {
   if (!active_submenu) {
     return false;
@@ -188,15 +217,16 @@ void MenuItemCallable::Draw() {}
 
 void MenuItemCallable::Activate() { on_activate(); }
 
-MenuItemTest::MenuItemTest(std::shared_ptr<TestSuite> suite, std::string name, uint32_t width, uint32_t height)
-    : MenuItem(std::move(name), width, height), suite(std::move(suite)) {}
+MenuItemTest::MenuItemTest(std::shared_ptr<TestSuite> suite, uint32_t test_id, std::string name, uint32_t width,
+                           uint32_t height)
+    : MenuItem(std::move(name), width, height), suite(std::move(suite)), test_id(test_id) {}
 
 void MenuItemTest::Draw() {
   if (one_shot_mode_ && has_run_once_) {
     return;
   }
 
-  suite->Run(name);
+  suite->RunById(test_id);
   suite->SetSavingAllowed(false);
   has_run_once_ = true;
 }
@@ -221,19 +251,33 @@ void MenuItemTest::CursorUp() { parent->CursorUpAndActivate(); }
 
 void MenuItemTest::CursorDown() { parent->CursorDownAndActivate(); }
 
-MenuItemSuite::MenuItemSuite(const std::shared_ptr<TestSuite> &suite, uint32_t width, uint32_t height)
-    : MenuItem(suite->Name(), width, height), suite(suite) {
-  auto tests = suite->TestNames();
+MenuItemSuite::MenuItemSuite(TestSuiteRegistry &registry, uint32_t suite_index, uint32_t width, uint32_t height)
+    : MenuItem(registry.GetName(suite_index), width, height), registry(registry), suite_index(suite_index) {}
+
+void MenuItemSuite::Populate() {
+  if (populated) {
+    return;
+  }
+  populated = true;
+
+  auto suite = registry.Get(suite_index);
+  const auto &tests = suite->Tests();
+  if (!tests.size()) {
+    registry.Release(suite_index);
+    return;
+  }
   submenu.reserve(tests.size());
 
-  for (auto &test : tests) {
-    auto child = std::make_shared<MenuItemTest>(suite, test, width, height);
+  for (uint32_t i = 0; i < tests.size(); ++i) {
+    const auto &test = tests.At(i);
+    auto child = std::make_shared<MenuItemTest>(suite, test.id, test.name, width, height);
     child->parent = this;
     submenu.push_back(child);
   }
 }
 
 void MenuItemSuite::ActivateCurrentSuite() {
+  auto suite = registry.Get(suite_index);
   suite->Initialize();
   suite->SetSavingAllowed(true);
   suite->RunAll();
@@ -241,14 +285,14 @@ void MenuItemSuite::ActivateCurrentSuite() {
   MenuItem::Deactivate();
 }
 
-MenuItemRoot::MenuItemRoot(const std::vector<std::shared_ptr<TestSuite>> &suites, std::function<void()> on_run_all,
-                           std::function<void()> on_exit, uint32_t width, uint32_t height)
+MenuItemRoot::MenuItemRoot(TestSuiteRegistry &registry, std::function<void()> on_run_all, std::function<void()> on_exit,
+                           uint32_t width, uint32_t height)
     : MenuItem("<<root>>", width, height), on_run_all(std::move(on_run_all)), on_exit(std::move(on_exit)) {
 #ifndef DISABLE_AUTORUN
   submenu.push_back(std::make_shared<MenuItemCallable>(on_run_all, "Run all and exit", width, height));
 #endif  // DISABLE_AUTORUN
-  for (auto &suite : suites) {
-    auto child = std::make_shared<MenuItemSuite>(suite, width, height);
+  for (uint32_t i = 0; i < registry.GetNumSuites(); ++i) {
+    auto child = std::make_shared<MenuItemSuite>(registry, i, width, height);
     child->parent = this;
     submenu.push_back(child);
   }
@@ -280,6 +324,16 @@ void MenuItemRoot::Draw() {
   MenuItem::Draw();
 }
 
+bool MenuItemRoot::IsAnimating() const {
+#ifndef DISABLE_AUTORUN
+  // The autorun countdown is only displayed while the root menu itself is shown.
+  if (!active_submenu && !timer_cancelled) {
+    return true;
+  }
+#endif  // DISABLE_AUTORUN
+  return MenuItem::IsAnimating();
+}
+
 void MenuItemRoot::Activate() {
   timer_cancelled = true;
   MenuItem::Activate();
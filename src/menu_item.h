@@ -9,6 +9,7 @@
 #include <vector>
 
 class TestSuite;
+class TestSuiteRegistry;
 
 struct MenuItem {
  public:
@@ -19,7 +20,14 @@ struct MenuItem {
   // Whether or not this menu item becomes the active drawable when activated.
   virtual bool IsEnterable() const { return !submenu.empty(); }
 
+  // Builds any lazily created children. Invoked before the item is entered or activated.
+  virtual void Populate() {}
+  // Whether Populate found nothing for this item to do, in which case its parent removes it from the menu.
+  virtual bool IsEmpty() const { return false; }
+
   virtual void Draw();
+  // Whether this item must be redrawn every frame, as opposed to only in response to input.
+  virtual bool IsAnimating() const { return active_submenu && active_submenu->IsAnimating(); }
 
   // Invoked when this MenuItem becomes the active drawable.
   virtual void OnEnter();
@@ -41,6 +49,8 @@ struct MenuItem {
 
  protected:
   void PrepareDraw(uint32_t background_color) const;
+  // Removes the item under the cursor, e.g., once it is found to be empty.
+  void RemoveCurrentItem();
   static void Swap();
 
  public:
@@ -69,13 +79,14 @@ struct MenuItemCallable : public MenuItem {
 struct MenuItemTest : public MenuItem {
   static bool one_shot_mode_;
 
-  MenuItemTest(std::shared_ptr<TestSuite> suite, std::string name, uint32_t width, uint32_t height);
+  MenuItemTest(std::shared_ptr<TestSuite> suite, uint32_t test_id, std::string name, uint32_t width, uint32_t height);
 
   static void SetOneShotMode(bool val) { one_shot_mode_ = val; }
 
   bool IsEnterable() const override { return true; }
 
   void Draw() override;
+  bool IsAnimating() const override { return !one_shot_mode_ || !has_run_once_; }
   void OnEnter() override;
   void Activate() override { OnEnter(); }
   bool Deactivate() override;
@@ -86,21 +97,30 @@ struct MenuItemTest : public MenuItem {
   void CursorRight() override {}
 
   std::shared_ptr<TestSuite> suite;
+  uint32_t test_id;
   bool has_run_once_{false};
 };
 
+// Constructs its suite and lists its tests the first time it is entered.
 struct MenuItemSuite : public MenuItem {
-  explicit MenuItemSuite(const std::shared_ptr<TestSuite>& suite, uint32_t width, uint32_t height);
+  MenuItemSuite(TestSuiteRegistry& registry, uint32_t suite_index, uint32_t width, uint32_t height);
 
+  void Populate() override;
+  // Suites may be left without tests by a filter or shard, which is only known once they are constructed.
+  bool IsEmpty() const override { return populated && submenu.empty(); }
   void ActivateCurrentSuite() override;
-  std::shared_ptr<TestSuite> suite;
+
+  TestSuiteRegistry& registry;
+  uint32_t suite_index;
+  bool populated{false};
 };
 
 struct MenuItemRoot : public MenuItem {
-  explicit MenuItemRoot(const std::vector<std::shared_ptr<TestSuite>>& suites, std::function<void()> on_run_all,
-                        std::function<void()> on_exit, uint32_t width, uint32_t height);
+  explicit MenuItemRoot(TestSuiteRegistry& registry, std::function<void()> on_run_all, std::function<void()> on_exit,
+                        uint32_t width, uint32_t height);
 
   void Draw() override;
+  bool IsAnimating() const override;
   void Activate() override;
   void ActivateCurrentSuite() override;
   bool Deactivate() override;
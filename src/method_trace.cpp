@@ -0,0 +1,287 @@
+#include "method_trace.h"
+
+#include <SDL_image.h>
+#include <pbkit/pbkit.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "command_recorder.h"
+#include "debug_output.h"
+#include "sdl_subsystems.h"
+#include "test_host.h"
+#include "texture_generator.h"
+#include "vertex_buffer.h"
+
+static constexpr uint32_t kMaxLineLength = 1024;
+// Each method is pushed as a single packet.
+static constexpr uint32_t kMaxParameters = CommandRecorder::kMaxDwordsPerSubmit - 1;
+
+static constexpr const char kTextureResource[] = "@texture";
+static constexpr const char kVerticesResource[] = "@vertices";
+
+static std::vector<std::string> Tokenize(const std::string &line) {
+  std::vector<std::string> ret;
+  std::string::size_type end = line.find('#');
+  if (end == std::string::npos) {
+    end = line.size();
+  }
+
+  std::string::size_type pos = 0;
+  while (pos < end) {
+    pos = line.find_first_not_of(" \t\r\n", pos);
+    if (pos == std::string::npos || pos >= end) {
+      break;
+    }
+    auto token_end = std::min(line.find_first_of(" \t\r\n", pos), end);
+    ret.push_back(line.substr(pos, token_end - pos));
+    pos = token_end;
+  }
+  return ret;
+}
+
+static bool ParseInteger(const std::string &token, uint32_t &value) {
+  if (token.empty()) {
+    return false;
+  }
+  char *end = nullptr;
+  value = strtoul(token.c_str(), &end, 0);
+  return !*end;
+}
+
+static bool ParseFloat(const std::string &token, float &value) {
+  if (token.empty()) {
+    return false;
+  }
+  char *end = nullptr;
+  value = strtof(token.c_str(), &end);
+  return !*end || (end[0] == 'f' && !end[1]);
+}
+
+bool MethodTrace::Load(const std::string &path) {
+  clear_color_ = 0xFF000000;
+  textures_.clear();
+  quads_.clear();
+  statements_.clear();
+
+  auto separator = path.find_last_of('\\');
+  directory_ = separator == std::string::npos ? std::string() : path.substr(0, separator);
+
+  FILE *fp = fopen(path.c_str(), "r");
+  if (!fp) {
+    PrintMsg("Failed to open method trace '%s'\n", path.c_str());
+    return false;
+  }
+
+  char buffer[kMaxLineLength];
+  uint32_t line_number = 0;
+  std::string error;
+  while (fgets(buffer, sizeof(buffer), fp)) {
+    ++line_number;
+    uint32_t length = strlen(buffer);
+    if (length == sizeof(buffer) - 1 && buffer[length - 1] != '\n' && !feof(fp)) {
+      error = "line too long";
+      break;
+    }
+    if (!ParseLine(buffer, error)) {
+      break;
+    }
+  }
+  fclose(fp);
+
+  if (!error.empty()) {
+    PrintMsg("%s:%u: %s\n", path.c_str(), line_number, error.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool MethodTrace::ParseLine(const std::string &line, std::string &error) {
+  auto tokens = Tokenize(line);
+  if (tokens.empty()) {
+    return true;
+  }
+
+  const std::string &keyword = tokens[0];
+  if (keyword == "clear") {
+    if (tokens.size() != 2 || !ParseInteger(tokens[1], clear_color_)) {
+      error = "expected 'clear <argb>'";
+      return false;
+    }
+    return true;
+  }
+
+  if (keyword == "texture") {
+    Texture texture;
+    if (tokens.size() != 3 || !ParseInteger(tokens[1], texture.stage) || texture.stage >= 4) {
+      error = "expected 'texture <stage 0-3> <source>'";
+      return false;
+    }
+    texture.source = tokens[2];
+    textures_.push_back(texture);
+    return true;
+  }
+
+  if (keyword == "quad") {
+    Quad quad{0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    if ((tokens.size() != 5 && tokens.size() != 6) || !ParseFloat(tokens[1], quad.left) ||
+        !ParseFloat(tokens[2], quad.top) || !ParseFloat(tokens[3], quad.right) || !ParseFloat(tokens[4], quad.bottom) ||
+        (tokens.size() == 6 && !ParseFloat(tokens[5], quad.z))) {
+      error = "expected 'quad <left> <top> <right> <bottom> [<z>]'";
+      return false;
+    }
+    quads_.push_back(quad);
+    return true;
+  }
+
+  if (keyword == "draw") {
+    if (tokens.size() != 1 || quads_.empty()) {
+      error = "'draw' takes no parameters and must follow at least one 'quad'";
+      return false;
+    }
+    statements_.push_back({STATEMENT_DRAW, 0, {}});
+    return true;
+  }
+
+  Statement statement{STATEMENT_METHOD, 0, {}};
+  if (!ParseInteger(keyword, statement.method) || statement.method >= 0x2000 || (statement.method & 0x03)) {
+    error = "unknown statement '" + keyword + "'";
+    return false;
+  }
+  if (tokens.size() - 1 > kMaxParameters) {
+    error = "too many parameters";
+    return false;
+  }
+
+  for (uint32_t i = 1; i < tokens.size(); ++i) {
+    Parameter parameter{};
+    if (!ParseParameter(tokens[i], parameter)) {
+      error = "invalid parameter '" + tokens[i] + "'";
+      return false;
+    }
+    statement.parameters.push_back(parameter);
+  }
+  statements_.push_back(std::move(statement));
+  return true;
+}
+
+bool MethodTrace::ParseParameter(const std::string &token, Parameter &parameter) {
+  parameter = {0, RESOURCE_NONE, 0};
+
+  if (token[0] == '@') {
+    auto plus = token.find('+');
+    std::string name = token.substr(0, plus);
+    if (plus != std::string::npos && !ParseInteger(token.substr(plus + 1), parameter.value)) {
+      return false;
+    }
+
+    if (name == kVerticesResource) {
+      parameter.resource = RESOURCE_VERTICES;
+      return true;
+    }
+
+    const auto prefix_length = sizeof(kTextureResource) - 1;
+    if (!name.compare(0, prefix_length, kTextureResource) && ParseInteger(name.substr(prefix_length), parameter.stage) &&
+        parameter.stage < 4) {
+      parameter.resource = RESOURCE_TEXTURE;
+      return true;
+    }
+    return false;
+  }
+
+  if (token.find('.') != std::string::npos) {
+    float value;
+    if (!ParseFloat(token, value)) {
+      return false;
+    }
+    memcpy(&parameter.value, &value, sizeof(parameter.value));
+    return true;
+  }
+
+  return ParseInteger(token, parameter.value);
+}
+
+uint32_t MethodTrace::ResolveParameter(TestHost &host, const Parameter &parameter) const {
+  switch (parameter.resource) {
+    case RESOURCE_NONE:
+      return parameter.value;
+
+    case RESOURCE_TEXTURE:
+      return (host.GetTextureAddress(parameter.stage) + parameter.value) & 0x03FFFFFF;
+
+    case RESOURCE_VERTICES: {
+      auto buffer = host.GetVertexBuffer();
+      if (!buffer) {
+        return parameter.value;
+      }
+      auto vertices = buffer->Lock();
+      buffer->Unlock();
+      return (reinterpret_cast<uint32_t>(vertices) + parameter.value) & 0x03FFFFFF;
+    }
+  }
+  return parameter.value;
+}
+
+void MethodTrace::UploadTexture(TestHost &host, const Texture &texture) const {
+  const int width = static_cast<int>(host.GetMaxTextureWidth());
+  const int height = static_cast<int>(host.GetMaxTextureHeight());
+
+  // Generated surfaces are memoized and must not be freed.
+  SDL_Surface *surface = nullptr;
+  bool owned = false;
+  if (texture.source == "gradient") {
+    surface = GetGradientSurface(width, height);
+  } else if (texture.source == "checkerboard") {
+    surface = GetCheckerboardSurface(width, height, 0xFF00FFFF, 0xFF000080, 8);
+  } else if (texture.source == "noise") {
+    surface = GetNoiseSurface(width, height, 0);
+  } else {
+    std::string path = directory_.empty() ? texture.source : directory_ + "\\" + texture.source;
+    surface = SDLSubsystems::EnsureImageSupport() ? IMG_Load(path.c_str()) : nullptr;
+    owned = true;
+    if (!surface) {
+      PrintMsg("Failed to load texture '%s'\n", path.c_str());
+      return;
+    }
+  }
+
+  host.SetTexture(surface, texture.stage);
+  host.SetTextureStageEnabled(texture.stage);
+  if (owned) {
+    SDL_FreeSurface(surface);
+  }
+}
+
+void MethodTrace::Run(TestHost &host) const {
+  if (!quads_.empty()) {
+    auto buffer = host.AllocateVertexBuffer(quads_.size() * 6);
+    for (uint32_t i = 0; i < quads_.size(); ++i) {
+      auto &quad = quads_[i];
+      buffer->DefineBiTri(i * 6, quad.left, quad.top, quad.right, quad.bottom, quad.z);
+    }
+  }
+  for (auto &texture : textures_) {
+    UploadTexture(host, texture);
+  }
+
+  host.PrepareDraw(clear_color_);
+
+  for (auto &statement : statements_) {
+    if (statement.type == STATEMENT_DRAW) {
+      host.DrawArrays();
+      continue;
+    }
+
+    auto p = CommandRecorder::Begin();
+    pb_push_to(SUBCH_3D, p++, statement.method, statement.parameters.size());
+    for (auto &parameter : statement.parameters) {
+      *p++ = ResolveParameter(host, parameter);
+    }
+    CommandRecorder::End(p);
+  }
+
+  // The trace may have written any register.
+  host.InvalidateRegisterShadow();
+}
@@ -0,0 +1,85 @@
+#ifndef NXDK_PGRAPH_TESTS_METHOD_TRACE_H
+#define NXDK_PGRAPH_TESTS_METHOD_TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class TestHost;
+
+// A hand editable list of 3D subchannel methods, e.g., trimmed from an xemu nv2a log, along with the TestHost
+// resources they use.
+//
+// Each line holds one statement, and everything after a '#' is ignored:
+//   clear <argb>                              Sets the color passed to TestHost::PrepareDraw (default 0xFF000000).
+//   texture <stage> <source>                  Uploads a texture to `stage` and enables it. `source` is "gradient",
+//                                             "checkerboard", "noise", or the path of a PNG relative to the trace.
+//   quad <left> <top> <right> <bottom> [<z>]  Appends two triangles covering the given screen rectangle to the vertex
+//                                             buffer.
+//   draw                                      Draws the vertex buffer as triangles with TestHost::DrawArrays.
+//   <method> [<param> ...]                    Pushes `method` with the given parameters.
+//
+// Methods and integer parameters may be decimal or 0x prefixed hex, and parameters containing a '.' are pushed as
+// floats. A parameter of the form "@texture<stage>[+<offset>]" or "@vertices[+<offset>]" is replaced by the GPU
+// address of the stage's texture memory or the vertex buffer's vertex array.
+class MethodTrace {
+ public:
+  // Parses the trace at `path`, printing the first error encountered. Returns false if the trace could not be loaded.
+  bool Load(const std::string &path);
+
+  // Uploads the trace's textures and vertices, calls TestHost::PrepareDraw, and then submits the statements in order.
+  // The caller is responsible for calling TestHost::FinishDraw.
+  void Run(TestHost &host) const;
+
+ private:
+  enum StatementType {
+    STATEMENT_METHOD,
+    STATEMENT_DRAW,
+  };
+
+  enum Resource {
+    RESOURCE_NONE,
+    RESOURCE_TEXTURE,
+    RESOURCE_VERTICES,
+  };
+
+  struct Parameter {
+    uint32_t value;
+    // If set, `value` is an offset from the address of the given resource.
+    Resource resource;
+    uint32_t stage;
+  };
+
+  struct Statement {
+    StatementType type;
+    uint32_t method;
+    std::vector<Parameter> parameters;
+  };
+
+  struct Texture {
+    uint32_t stage;
+    std::string source;
+  };
+
+  struct Quad {
+    float left;
+    float top;
+    float right;
+    float bottom;
+    float z;
+  };
+
+  bool ParseLine(const std::string &line, std::string &error);
+  static bool ParseParameter(const std::string &token, Parameter &parameter);
+  uint32_t ResolveParameter(TestHost &host, const Parameter &parameter) const;
+  void UploadTexture(TestHost &host, const Texture &texture) const;
+
+ private:
+  std::string directory_;
+  uint32_t clear_color_{0xFF000000};
+  std::vector<Texture> textures_;
+  std::vector<Quad> quads_;
+  std::vector<Statement> statements_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_METHOD_TRACE_H
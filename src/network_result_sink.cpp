@@ -0,0 +1,82 @@
+#include "network_result_sink.h"
+
+#include <lwip/sockets.h>
+
+#include "debug_output.h"
+
+NetworkResultSink::~NetworkResultSink() { Disconnect(); }
+
+bool NetworkResultSink::Connect(const std::string &address, uint16_t port) {
+  Disconnect();
+
+  struct sockaddr_in collector {};
+  collector.sin_family = AF_INET;
+  collector.sin_port = htons(port);
+  if (inet_aton(address.c_str(), &collector.sin_addr) != 1) {
+    PrintMsg("Invalid result collector address '%s'\n", address.c_str());
+    return false;
+  }
+
+  socket_ = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (socket_ < 0) {
+    PrintMsg("Failed to create result collector socket\n");
+    return false;
+  }
+
+  // Results are sent as large frames, so there is nothing to be gained from Nagle's algorithm delaying the tail of
+  // each frame.
+  int enable = 1;
+  lwip_setsockopt(socket_, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+  if (lwip_connect(socket_, reinterpret_cast<struct sockaddr *>(&collector), sizeof(collector))) {
+    PrintMsg("Failed to connect to result collector at %s:%d\n", address.c_str(), port);
+    Disconnect();
+    return false;
+  }
+
+  return true;
+}
+
+void NetworkResultSink::Disconnect() {
+  if (socket_ < 0) {
+    return;
+  }
+
+  lwip_close(socket_);
+  socket_ = -1;
+}
+
+bool NetworkResultSink::Write(const std::string &target_file, const void *data, uint32_t size, const void *data2,
+                              uint32_t size2) {
+  if (!IsConnected()) {
+    return fallback_.Write(target_file, data, size, data2, size2);
+  }
+
+  NetworkResultFrameHeader header{{'N', 'X', 'R', 'S'},
+                                  kFrameVersion,
+                                  static_cast<uint32_t>(target_file.length()),
+                                  size + (data2 ? size2 : 0)};
+
+  bool ok = SendAll(&header, sizeof(header)) && SendAll(target_file.c_str(), header.path_length) &&
+            SendAll(data, size) && (!data2 || SendAll(data2, size2));
+  if (!ok) {
+    // A partially sent frame leaves the stream unrecoverable, so this and all later results are saved locally instead.
+    PrintMsg("Failed to send '%s' to result collector, saving results locally\n", target_file.c_str());
+    Disconnect();
+    return fallback_.Write(target_file, data, size, data2, size2);
+  }
+  return true;
+}
+
+bool NetworkResultSink::SendAll(const void *data, uint32_t size) {
+  auto buffer = static_cast<const uint8_t *>(data);
+  while (size) {
+    int sent = lwip_send(socket_, buffer, size, 0);
+    if (sent <= 0) {
+      return false;
+    }
+    buffer += sent;
+    size -= sent;
+  }
+  return true;
+}
@@ -0,0 +1,46 @@
+#ifndef NXDK_PGRAPH_TESTS_NETWORK_RESULT_SINK_H
+#define NXDK_PGRAPH_TESTS_NETWORK_RESULT_SINK_H
+
+#include <cstdint>
+#include <string>
+
+#include "result_sink.h"
+
+// Streams results over TCP to a collector running on another machine.
+//
+// Each result is sent as a NetworkResultFrameHeader followed by `path_length` bytes of the (non null terminated)
+// target path and `data_length` bytes of encoded result data. All values are little endian.
+//
+// If the connection is lost, results are written to the local filesystem for the remainder of the run.
+class NetworkResultSink : public ResultSink {
+ public:
+  struct NetworkResultFrameHeader {
+    char magic[4];  // "NXRS"
+    uint32_t version;
+    uint32_t path_length;
+    uint32_t data_length;
+  } __attribute__((packed));
+
+  static constexpr uint32_t kFrameVersion = 1;
+
+ public:
+  NetworkResultSink() = default;
+  ~NetworkResultSink() override;
+
+  // Connects to the collector at the given IPv4 address and port. The network stack must already be initialized.
+  bool Connect(const std::string &address, uint16_t port);
+  void Disconnect();
+  bool IsConnected() const { return socket_ >= 0; }
+
+  bool Write(const std::string &target_file, const void *data, uint32_t size, const void *data2,
+             uint32_t size2) override;
+
+ private:
+  bool SendAll(const void *data, uint32_t size);
+
+ private:
+  int socket_{-1};
+  FileResultSink fallback_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_NETWORK_RESULT_SINK_H
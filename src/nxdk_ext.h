@@ -22,6 +22,14 @@
 #define NV2A_VERTEX_ATTR_14 14
 #define NV2A_VERTEX_ATTR_15 15
 
+#ifndef NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_UB_D3D
+#define NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_UB_D3D 0
+#define NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_S1 1
+#define NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_UB_OGL 4
+#define NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_S32K 5
+#define NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_CMP 6
+#endif
+
 #define NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_G8B8 0x17
 #define NV097_SET_TEXTURE_FORMAT_COLOR_SZ_B8G8R8A8 0x3B
 #define NV097_SET_TEXTURE_FORMAT_COLOR_LC_IMAGE_CR8YB8CB8YA8 0x24
@@ -31,6 +39,13 @@
 #define NV097_SET_CONTROL0_COLOR_SPACE_CONVERT 0xF0000000
 #define NV097_SET_CONTROL0_COLOR_SPACE_CONVERT_CRYCB_TO_RGB 0x1
 
+#ifndef NV097_SET_COLOR_CLEAR_VALUE
+#define NV097_SET_COLOR_CLEAR_VALUE 0x00001D90
+#endif
+#ifndef NV097_CLEAR_SURFACE_COLOR
+#define NV097_CLEAR_SURFACE_COLOR 0x000000F0
+#endif
+
 #define NV097_SET_TEXTURE_CONTROL0_ENABLE (1 << 30)
 #define NV097_SET_TEXTURE_CONTROL0_MIN_LOD_CLAMP 0x3FFC0000
 #define NV097_SET_TEXTURE_CONTROL0_MAX_LOD_CLAMP 0x0003FFC0
@@ -179,4 +194,14 @@
 #define NV097_SET_WINDOW_CLIP_HORIZONTAL 0x2C0
 #define NV097_SET_WINDOW_CLIP_VERTICAL 0x2E0
 
+// Report writes used by GpuProfiler. Each report is 16 bytes: a 64-bit PTIMER timestamp, the report value, and a
+// status word.
+#ifndef NV097_GET_REPORT
+#define NV097_SET_CONTEXT_DMA_REPORT 0x1A8
+#define NV097_GET_REPORT 0x1D50
+#define NV097_GET_REPORT_OFFSET 0x00FFFFFF
+#define NV097_GET_REPORT_TYPE 0xFF000000
+#define NV097_GET_REPORT_TYPE_ZPASS_PIXEL_CNT 1
+#endif
+
 #endif  // NXDK_ZBUFFER_TESTS_NXDK_MISSING_DEFINES_H
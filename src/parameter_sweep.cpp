@@ -0,0 +1,282 @@
+#include "parameter_sweep.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+#include "debug_output.h"
+
+static constexpr const char kCoverageKey[] = "coverage";
+static constexpr uint32_t kUnassigned = 0xFFFFFFFF;
+
+namespace {
+struct Configuration {
+  ParameterSweep::Coverage default_coverage{ParameterSweep::COVERAGE_EXHAUSTIVE};
+  // Keyed by sweep name.
+  std::map<std::string, ParameterSweep::Coverage> coverage;
+  // Keyed by "<sweep name>/<axis name>".
+  std::map<std::string, std::vector<uint32_t>> axis_values;
+};
+}  // namespace
+
+static Configuration &GetConfiguration() {
+  static Configuration configuration;
+  return configuration;
+}
+
+static std::string Trim(const std::string &text) {
+  auto start = text.find_first_not_of(" \t\r\n");
+  if (start == std::string::npos) {
+    return {};
+  }
+  auto end = text.find_last_not_of(" \t\r\n");
+  return text.substr(start, end - start + 1);
+}
+
+static bool ParseCoverage(const std::string &text, ParameterSweep::Coverage &coverage) {
+  if (text == "exhaustive") {
+    coverage = ParameterSweep::COVERAGE_EXHAUSTIVE;
+    return true;
+  }
+  if (text == "pairwise") {
+    coverage = ParameterSweep::COVERAGE_PAIRWISE;
+    return true;
+  }
+  return false;
+}
+
+static bool ParseIndices(const std::string &text, std::vector<uint32_t> &indices) {
+  const char *p = text.c_str();
+  while (*p) {
+    char *end = nullptr;
+    uint32_t index = strtoul(p, &end, 0);
+    if (end == p) {
+      return false;
+    }
+    indices.push_back(index);
+    p = end;
+    while (*p == ' ' || *p == '\t' || *p == ',') {
+      ++p;
+    }
+  }
+  return !indices.empty();
+}
+
+uint32_t ParameterSweep::AddAxis(const std::string &name, uint32_t num_values) {
+  axes_.push_back({name, num_values});
+  return axes_.size() - 1;
+}
+
+void ParameterSweep::ForEach(const std::function<void(const Combination &)> &callback) const {
+  for (auto &combination : Generate()) {
+    callback(combination);
+  }
+}
+
+ParameterSweep::Coverage ParameterSweep::GetCoverage() const {
+  auto &configuration = GetConfiguration();
+  auto it = configuration.coverage.find(name_);
+  return it == configuration.coverage.end() ? configuration.default_coverage : it->second;
+}
+
+void ParameterSweep::SetDefaultCoverage(Coverage coverage) { GetConfiguration().default_coverage = coverage; }
+
+bool ParameterSweep::LoadConfiguration(const std::string &path) {
+  FILE *fp = fopen(path.c_str(), "r");
+  if (!fp) {
+    return false;
+  }
+
+  auto &configuration = GetConfiguration();
+  char buffer[512];
+  while (fgets(buffer, sizeof(buffer), fp)) {
+    std::string line = Trim(buffer);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    auto separator = line.find('=');
+    if (separator == std::string::npos) {
+      PrintMsg("Ignoring invalid sweep configuration line '%s'\n", line.c_str());
+      continue;
+    }
+    std::string key = Trim(line.substr(0, separator));
+    std::string value = Trim(line.substr(separator + 1));
+
+    auto slash = key.rfind('/');
+    std::string setting = slash == std::string::npos ? key : key.substr(slash + 1);
+    bool valid;
+    if (setting == kCoverageKey) {
+      Coverage coverage;
+      valid = ParseCoverage(value, coverage);
+      if (valid && slash == std::string::npos) {
+        configuration.default_coverage = coverage;
+      } else if (valid) {
+        configuration.coverage[key.substr(0, slash)] = coverage;
+      }
+    } else {
+      std::vector<uint32_t> indices;
+      valid = slash != std::string::npos && ParseIndices(value, indices);
+      if (valid) {
+        configuration.axis_values[key] = std::move(indices);
+      }
+    }
+
+    if (!valid) {
+      PrintMsg("Ignoring invalid sweep configuration line '%s'\n", line.c_str());
+    }
+  }
+
+  fclose(fp);
+  return true;
+}
+
+std::vector<ParameterSweep::Combination> ParameterSweep::Generate(Coverage coverage) const {
+  auto axis_values = GetAxisValues();
+  for (auto &values : axis_values) {
+    if (values.empty()) {
+      return {};
+    }
+  }
+
+  if (coverage == COVERAGE_PAIRWISE && axis_values.size() > 2) {
+    return GeneratePairwise(axis_values);
+  }
+  // With two or fewer axes every combination is needed to cover every pair.
+  return GenerateExhaustive(axis_values);
+}
+
+std::vector<std::vector<uint32_t>> ParameterSweep::GetAxisValues() const {
+  auto &configuration = GetConfiguration();
+  std::vector<std::vector<uint32_t>> ret;
+  ret.reserve(axes_.size());
+
+  for (auto &axis : axes_) {
+    std::vector<uint32_t> values;
+    auto it = configuration.axis_values.find(name_ + "/" + axis.name);
+    if (it != configuration.axis_values.end()) {
+      for (auto index : it->second) {
+        if (index < axis.num_values && std::find(values.begin(), values.end(), index) == values.end()) {
+          values.push_back(index);
+        }
+      }
+      if (values.empty()) {
+        PrintMsg("Ignoring sweep configuration for %s/%s, no valid indices\n", name_.c_str(), axis.name.c_str());
+      }
+    }
+
+    if (values.empty()) {
+      for (uint32_t i = 0; i < axis.num_values; ++i) {
+        values.push_back(i);
+      }
+    }
+    ret.push_back(std::move(values));
+  }
+  return ret;
+}
+
+std::vector<ParameterSweep::Combination> ParameterSweep::GenerateExhaustive(
+    const std::vector<std::vector<uint32_t>> &axis_values) {
+  std::vector<Combination> ret;
+  // Odometer over the position within each axis, with the last axis varying fastest.
+  std::vector<uint32_t> positions(axis_values.size(), 0);
+  while (true) {
+    Combination combination(axis_values.size());
+    for (uint32_t i = 0; i < axis_values.size(); ++i) {
+      combination[i] = axis_values[i][positions[i]];
+    }
+    ret.push_back(std::move(combination));
+
+    int32_t axis = static_cast<int32_t>(axis_values.size()) - 1;
+    for (; axis >= 0; --axis) {
+      if (++positions[axis] < axis_values[axis].size()) {
+        break;
+      }
+      positions[axis] = 0;
+    }
+    if (axis < 0) {
+      return ret;
+    }
+  }
+}
+
+std::vector<ParameterSweep::Combination> ParameterSweep::GeneratePairwise(
+    const std::vector<std::vector<uint32_t>> &axis_values) {
+  const uint32_t num_axes = axis_values.size();
+
+  // covered[i * num_axes + j] (i < j) tracks which pairs of positions on axes i and j have been generated.
+  std::vector<std::vector<bool>> covered(num_axes * num_axes);
+  uint32_t remaining = 0;
+  for (uint32_t i = 0; i < num_axes; ++i) {
+    for (uint32_t j = i + 1; j < num_axes; ++j) {
+      const uint32_t num_pairs = axis_values[i].size() * axis_values[j].size();
+      covered[i * num_axes + j].assign(num_pairs, false);
+      remaining += num_pairs;
+    }
+  }
+
+  auto pair_covered = [&](uint32_t i, uint32_t a, uint32_t j, uint32_t b) -> std::vector<bool>::reference {
+    if (i > j) {
+      std::swap(i, j);
+      std::swap(a, b);
+    }
+    return covered[i * num_axes + j][a * axis_values[j].size() + b];
+  };
+
+  // Greedily builds combinations, each seeded with the first uncovered pair and completed one axis at a time with the
+  // position that covers the most new pairs. This is deterministic, so the selected tests are stable between runs.
+  std::vector<Combination> ret;
+  while (remaining) {
+    std::vector<uint32_t> positions(num_axes, kUnassigned);
+    bool seeded = false;
+    for (uint32_t i = 0; i < num_axes && !seeded; ++i) {
+      for (uint32_t j = i + 1; j < num_axes && !seeded; ++j) {
+        auto &pairs = covered[i * num_axes + j];
+        auto it = std::find(pairs.begin(), pairs.end(), false);
+        if (it != pairs.end()) {
+          const uint32_t pair = it - pairs.begin();
+          positions[i] = pair / axis_values[j].size();
+          positions[j] = pair % axis_values[j].size();
+          seeded = true;
+        }
+      }
+    }
+
+    for (uint32_t k = 0; k < num_axes; ++k) {
+      if (positions[k] != kUnassigned) {
+        continue;
+      }
+
+      uint32_t best_position = 0;
+      uint32_t best_gain = 0;
+      for (uint32_t v = 0; v < axis_values[k].size(); ++v) {
+        uint32_t gain = 0;
+        for (uint32_t m = 0; m < num_axes; ++m) {
+          if (m != k && positions[m] != kUnassigned && !pair_covered(k, v, m, positions[m])) {
+            ++gain;
+          }
+        }
+        if (gain > best_gain) {
+          best_gain = gain;
+          best_position = v;
+        }
+      }
+      positions[k] = best_position;
+    }
+
+    Combination combination(num_axes);
+    for (uint32_t i = 0; i < num_axes; ++i) {
+      combination[i] = axis_values[i][positions[i]];
+      for (uint32_t j = i + 1; j < num_axes; ++j) {
+        auto pair = pair_covered(i, positions[i], j, positions[j]);
+        if (!pair) {
+          pair = true;
+          --remaining;
+        }
+      }
+    }
+    ret.push_back(std::move(combination));
+  }
+  return ret;
+}
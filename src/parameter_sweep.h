@@ -0,0 +1,77 @@
+#ifndef NXDK_PGRAPH_TESTS_PARAMETER_SWEEP_H
+#define NXDK_PGRAPH_TESTS_PARAMETER_SWEEP_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Generates the combinations of a set of named axes that a suite registers as tests, e.g.
+//
+//   ParameterSweep sweep(suite_name);
+//   sweep.AddAxis("mode", kModes);
+//   sweep.AddAxis("winding", kWindings);
+//   sweep.ForEach([this](const ParameterSweep::Combination &c) { AddTest(kModes[c[0]], kWindings[c[1]]); });
+//
+// By default every combination is generated. Pairwise coverage instead generates a (much smaller) set of combinations
+// that contains every pair of values from any two axes at least once.
+//
+// The coverage and the values of each axis may be overridden at runtime via LoadConfiguration, which reads lines of the
+// form:
+//   coverage = <exhaustive|pairwise>                  Sets the coverage of every sweep.
+//   <sweep name>/coverage = <exhaustive|pairwise>     Sets the coverage of a single sweep.
+//   <sweep name>/<axis name> = <index> [<index> ...]  Restricts an axis to the given (0-based) value indices.
+// Blank lines and lines starting with '#' are ignored.
+class ParameterSweep {
+ public:
+  enum Coverage {
+    COVERAGE_EXHAUSTIVE,
+    COVERAGE_PAIRWISE,
+  };
+
+  // The index of the selected value of each axis, in the order the axes were added.
+  using Combination = std::vector<uint32_t>;
+
+ public:
+  // `name` identifies the sweep in the configuration, suites generally use their own name.
+  explicit ParameterSweep(std::string name) : name_(std::move(name)) {}
+
+  // Adds an axis with `num_values` values and returns its index within each Combination.
+  uint32_t AddAxis(const std::string &name, uint32_t num_values);
+  template <typename T, uint32_t N>
+  uint32_t AddAxis(const std::string &name, const T (&)[N]) {
+    return AddAxis(name, N);
+  }
+
+  // Returns the combinations selected by the active configuration.
+  std::vector<Combination> Generate() const { return Generate(GetCoverage()); }
+  std::vector<Combination> Generate(Coverage coverage) const;
+
+  void ForEach(const std::function<void(const Combination &)> &callback) const;
+
+  // Returns the coverage that Generate will use for this sweep.
+  Coverage GetCoverage() const;
+
+  // Sets the coverage of sweeps that are not configured otherwise.
+  static void SetDefaultCoverage(Coverage coverage);
+  // Adds the settings in the given file to the active configuration. Returns false if the file could not be opened.
+  static bool LoadConfiguration(const std::string &path);
+
+ private:
+  struct Axis {
+    std::string name;
+    uint32_t num_values;
+  };
+
+  // Returns the value indices of each axis permitted by the configuration.
+  std::vector<std::vector<uint32_t>> GetAxisValues() const;
+
+  static std::vector<Combination> GenerateExhaustive(const std::vector<std::vector<uint32_t>> &axis_values);
+  static std::vector<Combination> GeneratePairwise(const std::vector<std::vector<uint32_t>> &axis_values);
+
+ private:
+  std::string name_;
+  std::vector<Axis> axes_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_PARAMETER_SWEEP_H
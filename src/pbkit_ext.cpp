@@ -7,9 +7,29 @@
 #include "debug_output.h"
 #include "nxdk_ext.h"
 
+static uint32_t pack_zstencil_clear_value(uint32_t depth_buffer_format, uint32_t depth_value, uint8_t stencil_value) {
+  switch (depth_buffer_format) {
+    case NV097_SET_SURFACE_FORMAT_ZETA_Z16:
+      return depth_value & 0xFFFF;
+
+    case NV097_SET_SURFACE_FORMAT_ZETA_Z24S8:
+      return ((depth_value & 0x00FFFFFF) << 8) | stencil_value;
+
+    default:
+      ASSERT(!"Invalid depth_buffer_format");
+  }
+  return 0;
+}
+
 void set_depth_stencil_buffer_region(uint32_t depth_buffer_format, uint32_t depth_value, uint8_t stencil_value,
                                      uint32_t left, uint32_t top, uint32_t width, uint32_t height) {
   // See: pbkit.c: pb_erase_depth_stencil_buffer
+  clear_surface_region(NV097_CLEAR_SURFACE_Z | NV097_CLEAR_SURFACE_STENCIL, 0, depth_buffer_format, depth_value,
+                       stencil_value, left, top, width, height);
+}
+
+void clear_surface_region(uint32_t surfaces, uint32_t argb, uint32_t depth_buffer_format, uint32_t depth_value,
+                          uint8_t stencil_value, uint32_t left, uint32_t top, uint32_t width, uint32_t height) {
   uint32_t right = left + width;
   uint32_t bottom = top + height;
 
@@ -19,20 +39,15 @@ void set_depth_stencil_buffer_region(uint32_t depth_buffer_format, uint32_t dept
   p = pb_push1(p, NV097_SET_CLEAR_RECT_HORIZONTAL, ((right - 1) << 16) | (left & 0xFFFF));
   p = pb_push1(p, NV097_SET_CLEAR_RECT_VERTICAL, ((bottom - 1) << 16) | (top & 0xFFFF));
 
-  switch (depth_buffer_format) {
-    case NV097_SET_SURFACE_FORMAT_ZETA_Z16:
-      p = pb_push1(p, NV097_SET_ZSTENCIL_CLEAR_VALUE, depth_value & 0xFFFF);
-      break;
-
-    case NV097_SET_SURFACE_FORMAT_ZETA_Z24S8:
-      p = pb_push1(p, NV097_SET_ZSTENCIL_CLEAR_VALUE, ((depth_value & 0x00FFFFFF) << 8) | stencil_value);
-      break;
-
-    default:
-      ASSERT(!"Invalid depth_buffer_format");
+  if (surfaces & (NV097_CLEAR_SURFACE_Z | NV097_CLEAR_SURFACE_STENCIL)) {
+    p = pb_push1(p, NV097_SET_ZSTENCIL_CLEAR_VALUE,
+                 pack_zstencil_clear_value(depth_buffer_format, depth_value, stencil_value));
+  }
+  if (surfaces & NV097_CLEAR_SURFACE_COLOR) {
+    p = pb_push1(p, NV097_SET_COLOR_CLEAR_VALUE, argb);
   }
 
-  p = pb_push1(p, NV097_CLEAR_SURFACE, NV097_CLEAR_SURFACE_Z | NV097_CLEAR_SURFACE_STENCIL);
+  p = pb_push1(p, NV097_CLEAR_SURFACE, surfaces);
 
   pb_end(p);
 }
@@ -45,6 +45,11 @@
 void set_depth_stencil_buffer_region(uint32_t depth_buffer_format, uint32_t depth_value, uint8_t stencil_value,
                                      uint32_t left, uint32_t top, uint32_t width, uint32_t height);
 
+// Clears the color and/or depth and stencil buffers within the given region with a single NV097_CLEAR_SURFACE.
+// `surfaces` is a combination of the NV097_CLEAR_SURFACE_* flags.
+void clear_surface_region(uint32_t surfaces, uint32_t argb, uint32_t depth_buffer_format, uint32_t depth_value,
+                          uint8_t stencil_value, uint32_t left, uint32_t top, uint32_t width, uint32_t height);
+
 constexpr float kF16Max = 511.9375f;
 constexpr float kF24Max = 3.4027977E38;
 
@@ -0,0 +1,86 @@
+#include "progress_journal.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "debug_output.h"
+
+static constexpr const char kStarted[] = "started";
+static constexpr const char kCompleted[] = "completed";
+static constexpr const char kSkipped[] = "skipped";
+static constexpr const char kFinished[] = "finished";
+
+bool ProgressJournal::Load(const std::string &path) {
+  path_ = path;
+  completed_.clear();
+  skipped_.clear();
+  finished_suites_.clear();
+
+  FILE *fp = fopen(path_.c_str(), "r");
+  if (!fp) {
+    return false;
+  }
+
+  // Tests rendered into a shared tiled frame are all started before any of them is completed.
+  std::set<std::string> interrupted;
+  char line[512];
+  while (fgets(line, sizeof(line), fp)) {
+    line[strcspn(line, "\r\n")] = 0;
+    char *key = strchr(line, ' ');
+    if (!key) {
+      continue;
+    }
+    *key++ = 0;
+
+    if (!strcmp(line, kStarted)) {
+      interrupted.insert(key);
+    } else if (!strcmp(line, kCompleted)) {
+      completed_.insert(key);
+      interrupted.erase(key);
+    } else if (!strcmp(line, kSkipped)) {
+      skipped_.insert(key);
+    } else if (!strcmp(line, kFinished)) {
+      finished_suites_.insert(key);
+    }
+  }
+  fclose(fp);
+
+  for (auto &key : interrupted) {
+    PrintMsg("Skipping '%s', which did not complete in the previous run\n", key.c_str());
+    skipped_.insert(key);
+    Append(kSkipped, key);
+  }
+
+  return true;
+}
+
+void ProgressJournal::Remove() {
+  if (!path_.empty()) {
+    remove(path_.c_str());
+  }
+  completed_.clear();
+  skipped_.clear();
+  finished_suites_.clear();
+}
+
+void ProgressJournal::RecordStarted(const std::string &key) const { Append(kStarted, key); }
+
+void ProgressJournal::RecordCompleted(const std::string &key) {
+  completed_.insert(key);
+  Append(kCompleted, key);
+}
+
+void ProgressJournal::RecordSuiteFinished(const std::string &suite_name) {
+  finished_suites_.insert(suite_name);
+  Append(kFinished, suite_name);
+}
+
+void ProgressJournal::Append(const char *action, const std::string &key) const {
+  FILE *fp = fopen(path_.c_str(), "a");
+  if (!fp) {
+    PrintMsg("Failed to open progress journal '%s'\n", path_.c_str());
+    return;
+  }
+  fprintf(fp, "%s %s\n", action, key.c_str());
+  fclose(fp);
+}
@@ -0,0 +1,49 @@
+#ifndef NXDK_PGRAPH_TESTS_PROGRESS_JOURNAL_H
+#define NXDK_PGRAPH_TESTS_PROGRESS_JOURNAL_H
+
+#include <set>
+#include <string>
+
+// Records the progress of a non-interactive run so that it can be resumed after a crash or hang.
+//
+// Each test appends a "started" entry before it runs and a "completed" entry after it finishes, and the file is closed
+// after every entry so that it survives a hard reset. A test that was started but never completed is assumed to have
+// brought down the machine and is recorded as skipped when the journal is next loaded. Tests that share a tiled frame
+// are only completed once the frame has been captured, so a crash within the frame skips all of them. Once every test of a suite has
+// run and its results have been written, a "finished" entry records the suite as a whole. Suites without one are rerun
+// from the start when resuming, as their result archives and CSV files only hold the output of a complete run.
+class ProgressJournal {
+ public:
+  // Loads the entries written by an interrupted run. Returns false if there was no journal at `path`, in which case a
+  // new one is started.
+  bool Load(const std::string &path);
+
+  // Removes the journal file, e.g., once the run has finished.
+  void Remove();
+
+  bool IsCompleted(const std::string &key) const { return completed_.find(key) != completed_.end(); }
+  bool IsSkipped(const std::string &key) const { return skipped_.find(key) != skipped_.end(); }
+  bool IsSuiteFinished(const std::string &suite_name) const {
+    return finished_suites_.find(suite_name) != finished_suites_.end();
+  }
+
+  void RecordStarted(const std::string &key) const;
+  void RecordCompleted(const std::string &key);
+  void RecordSuiteFinished(const std::string &suite_name);
+
+  // Returns the key identifying the given test in the journal.
+  static std::string MakeKey(const std::string &suite_name, const std::string &test_name) {
+    return suite_name + "/" + test_name;
+  }
+
+ private:
+  void Append(const char *action, const std::string &key) const;
+
+ private:
+  std::string path_;
+  std::set<std::string> completed_;
+  std::set<std::string> skipped_;
+  std::set<std::string> finished_suites_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_PROGRESS_JOURNAL_H
@@ -0,0 +1,205 @@
+#include "pushbuffer_trace.h"
+
+#include <pbkit/pbkit.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "command_recorder.h"
+#include "contiguous_memory_pool.h"
+#include "debug_output.h"
+#include "test_host.h"
+
+static constexpr char kTraceMagic[4] = {'N', 'X', 'P', 'B'};
+
+static constexpr uint32_t kPhysicalAddressMask = 0x03FFFFFF;
+// NV097_SET_TEXTURE_PALETTE keeps its context DMA and length in the low bits.
+static constexpr uint32_t kPaletteAddressMask = 0x03FFFFC0;
+static constexpr uint32_t kPageMask = 0xFFF;
+
+static constexpr uint32_t kNonIncrementingFlag = 0x40000000;
+
+static inline uint32_t PhysicalAddress(const void *memory) {
+  return reinterpret_cast<uint32_t>(memory) & kPhysicalAddressMask;
+}
+
+static inline bool IsJumpOrCall(uint32_t header) {
+  // Old style jumps, new style jumps and calls, and returns.
+  return (header & 0xE0000003) == 0x20000000 || (header & 0x03) == 0x01 || (header & 0x03) == 0x02 ||
+         header == 0x00020000;
+}
+
+static inline uint32_t EncodeHeader(uint32_t subchannel, uint32_t method, uint32_t count, bool non_incrementing) {
+  return (non_incrementing ? kNonIncrementingFlag : 0) | (count << 18) | (subchannel << 13) | method;
+}
+
+void PushbufferTrace::Clear() {
+  commands_.clear();
+  regions_.clear();
+}
+
+void PushbufferTrace::AddRegion(const void *memory, uint32_t size) {
+  auto data = static_cast<const uint8_t *>(memory);
+  regions_.push_back({PhysicalAddress(memory), std::vector<uint8_t>(data, data + size)});
+}
+
+std::string PushbufferTrace::Serialize() const {
+  std::string ret;
+
+  TraceHeader header{};
+  memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+  header.version = kVersion;
+  header.num_regions = regions_.size();
+  header.num_dwords = commands_.size();
+  ret.append(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  for (auto &region : regions_) {
+    RegionHeader region_header{region.address, static_cast<uint32_t>(region.data.size())};
+    ret.append(reinterpret_cast<const char *>(&region_header), sizeof(region_header));
+    ret.append(reinterpret_cast<const char *>(region.data.data()), region.data.size());
+    ret.append((4 - (region.data.size() & 3)) & 3, '\0');
+  }
+
+  ret.append(reinterpret_cast<const char *>(commands_.data()), commands_.size() * sizeof(commands_[0]));
+  return ret;
+}
+
+bool PushbufferTrace::Load(const std::string &path) {
+  Clear();
+
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp) {
+    return false;
+  }
+
+  bool valid = false;
+  TraceHeader header{};
+  if (fread(&header, sizeof(header), 1, fp) == 1 && !memcmp(header.magic, kTraceMagic, sizeof(kTraceMagic)) &&
+      header.version == kVersion) {
+    valid = true;
+    for (uint32_t i = 0; i < header.num_regions && valid; ++i) {
+      RegionHeader region_header{};
+      if (fread(&region_header, sizeof(region_header), 1, fp) != 1) {
+        valid = false;
+        break;
+      }
+
+      Region region{region_header.address, std::vector<uint8_t>(region_header.size)};
+      uint32_t padding = (4 - (region_header.size & 3)) & 3;
+      valid = fread(region.data.data(), 1, region_header.size, fp) == region_header.size &&
+              !fseek(fp, padding, SEEK_CUR);
+      regions_.push_back(std::move(region));
+    }
+
+    if (valid) {
+      commands_.resize(header.num_dwords);
+      valid = fread(commands_.data(), sizeof(commands_[0]), header.num_dwords, fp) == header.num_dwords;
+    }
+  }
+  fclose(fp);
+
+  if (!valid) {
+    PrintMsg("Invalid pushbuffer trace '%s'\n", path.c_str());
+    Clear();
+  }
+  return valid;
+}
+
+uint32_t PushbufferTrace::Relocate(uint32_t method, uint32_t value, const std::vector<uint32_t> &new_addresses) const {
+  uint32_t mask;
+  if (method >= NV097_SET_VERTEX_DATA_ARRAY_OFFSET && method < NV097_SET_VERTEX_DATA_ARRAY_OFFSET + 16 * 4) {
+    mask = kPhysicalAddressMask;
+  } else if (method == NV20_TCL_PRIMITIVE_3D_TX_OFFSET(0) || method == NV20_TCL_PRIMITIVE_3D_TX_OFFSET(1) ||
+             method == NV20_TCL_PRIMITIVE_3D_TX_OFFSET(2) || method == NV20_TCL_PRIMITIVE_3D_TX_OFFSET(3)) {
+    mask = kPhysicalAddressMask;
+  } else if (method == NV20_TCL_PRIMITIVE_3D_TX_PALETTE_OFFSET(0) ||
+             method == NV20_TCL_PRIMITIVE_3D_TX_PALETTE_OFFSET(1) ||
+             method == NV20_TCL_PRIMITIVE_3D_TX_PALETTE_OFFSET(2) ||
+             method == NV20_TCL_PRIMITIVE_3D_TX_PALETTE_OFFSET(3)) {
+    mask = kPaletteAddressMask;
+  } else {
+    return value;
+  }
+
+  uint32_t address = value & mask;
+  for (uint32_t i = 0; i < regions_.size(); ++i) {
+    auto &region = regions_[i];
+    if (address >= region.address && address < region.address + region.data.size()) {
+      return (value & ~mask) | ((new_addresses[i] + (address - region.address)) & mask);
+    }
+  }
+  return value;
+}
+
+bool PushbufferTrace::Replay() const {
+  uint32_t end = 0;
+  while (end < commands_.size()) {
+    uint32_t header = commands_[end];
+    if (IsJumpOrCall(header)) {
+      PrintMsg("Pushbuffer trace contains a jump or call at dword %u\n", end);
+      return false;
+    }
+    end += 1 + ((header >> 18) & 0x7FF);
+  }
+  if (end != commands_.size()) {
+    PrintMsg("Pushbuffer trace ends with a truncated packet\n");
+    return false;
+  }
+
+  // Copies keep the page offset of the original so that any alignment requirements are preserved.
+  std::vector<uint8_t *> copies;
+  std::vector<uint32_t> new_addresses;
+  copies.reserve(regions_.size());
+  new_addresses.reserve(regions_.size());
+  for (auto &region : regions_) {
+    uint32_t page_offset = region.address & kPageMask;
+    auto block = static_cast<uint8_t *>(
+        ContiguousMemoryPool::Allocate(page_offset + region.data.size(), MemoryTracker::CATEGORY_PUSHBUFFER_TRACE));
+    ASSERT(block && "Failed to allocate memory for a pushbuffer trace region.");
+    memcpy(block + page_offset, region.data.data(), region.data.size());
+    copies.push_back(block);
+    new_addresses.push_back(PhysicalAddress(block + page_offset));
+  }
+
+  static constexpr uint32_t kMaxDwords = CommandRecorder::kMaxDwordsPerSubmit;
+  auto start = CommandRecorder::Begin();
+  auto p = start;
+  for (uint32_t i = 0; i < commands_.size();) {
+    uint32_t header = commands_[i++];
+    uint32_t subchannel = (header >> 13) & 0x07;
+    uint32_t method = header & 0x1FFC;
+    uint32_t count = (header >> 18) & 0x7FF;
+    bool non_incrementing = header & kNonIncrementingFlag;
+
+    // Packets are split as necessary to fit within a single submission.
+    uint32_t sent = 0;
+    do {
+      if (p - start + 2 > kMaxDwords) {
+        CommandRecorder::End(p);
+        start = p = CommandRecorder::Begin();
+      }
+
+      uint32_t chunk = std::min(count - sent, kMaxDwords - 1 - static_cast<uint32_t>(p - start));
+      uint32_t chunk_method = non_incrementing ? method : method + sent * 4;
+      *p++ = EncodeHeader(subchannel, chunk_method, chunk, non_incrementing);
+      for (uint32_t j = 0; j < chunk; ++j) {
+        uint32_t value = commands_[i + sent + j];
+        if (subchannel == SUBCH_3D) {
+          value = Relocate(non_incrementing ? method : chunk_method + j * 4, value, new_addresses);
+        }
+        *p++ = value;
+      }
+      sent += chunk;
+    } while (sent < count);
+    i += count;
+  }
+  CommandRecorder::End(p);
+
+  TestHost::WaitForGpuIdle();
+  for (uint32_t i = 0; i < regions_.size(); ++i) {
+    ContiguousMemoryPool::Release(copies[i], (regions_[i].address & kPageMask) + regions_[i].data.size(),
+                                  MemoryTracker::CATEGORY_PUSHBUFFER_TRACE);
+  }
+  return true;
+}
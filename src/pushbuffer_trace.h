@@ -0,0 +1,63 @@
+#ifndef NXDK_PGRAPH_TESTS_PUSHBUFFER_TRACE_H
+#define NXDK_PGRAPH_TESTS_PUSHBUFFER_TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The pushbuffer commands submitted by a single test frame along with copies of the texture and vertex memory they
+// reference, allowing the frame to be replayed without the test that produced it.
+//
+// Traces are stored as a TraceHeader followed by `num_regions` RegionHeaders, each immediately followed by its data
+// (padded to a multiple of 4 bytes), and finally `num_dwords` command dwords. All fields are little endian.
+class PushbufferTrace {
+ public:
+  struct TraceHeader {
+    char magic[4];  // "NXPB"
+    uint32_t version;
+    uint32_t num_regions;
+    uint32_t num_dwords;
+  } __attribute__((packed));
+
+  struct RegionHeader {
+    // Physical address of the region when it was captured.
+    uint32_t address;
+    uint32_t size;
+  } __attribute__((packed));
+
+  static constexpr uint32_t kVersion = 1;
+
+  struct Region {
+    uint32_t address;
+    std::vector<uint8_t> data;
+  };
+
+ public:
+  void Clear();
+
+  void SetCommands(const uint32_t *commands, uint32_t num_dwords) { commands_.assign(commands, commands + num_dwords); }
+  // Copies `size` bytes of contiguous memory starting at `memory` into the trace.
+  void AddRegion(const void *memory, uint32_t size);
+
+  const std::vector<uint32_t> &GetCommands() const { return commands_; }
+  const std::vector<Region> &GetRegions() const { return regions_; }
+
+  std::string Serialize() const;
+  bool Load(const std::string &path);
+
+  // Copies each region into newly allocated contiguous memory and submits the commands, rewriting any vertex array,
+  // texture, or palette address that falls within a captured region to point at its copy. Blocks until the GPU has
+  // finished with the copies. Returns false if the commands contain a jump or call, which cannot be replayed.
+  bool Replay() const;
+
+ private:
+  // Returns the relocated value of a parameter of `method`, or `value` if the method does not carry an address within
+  // a region.
+  uint32_t Relocate(uint32_t method, uint32_t value, const std::vector<uint32_t> &new_addresses) const;
+
+ private:
+  std::vector<uint32_t> commands_;
+  std::vector<Region> regions_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_PUSHBUFFER_TRACE_H
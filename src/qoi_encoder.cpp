@@ -0,0 +1,118 @@
+#include "qoi_encoder.h"
+
+#include <cstring>
+
+static constexpr uint8_t kOpIndex = 0x00;
+static constexpr uint8_t kOpDiff = 0x40;
+static constexpr uint8_t kOpLuma = 0x80;
+static constexpr uint8_t kOpRun = 0xC0;
+static constexpr uint8_t kOpRGB = 0xFE;
+static constexpr uint8_t kOpRGBA = 0xFF;
+
+static constexpr uint32_t kMaxRun = 62;
+static constexpr uint8_t kEndMarker[] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+union Pixel {
+  struct {
+    uint8_t r, g, b, a;
+  } rgba;
+  uint32_t value;
+};
+
+static inline uint32_t Hash(const Pixel &px) {
+  return (px.rgba.r * 3 + px.rgba.g * 5 + px.rgba.b * 7 + px.rgba.a * 11) & 0x3F;
+}
+
+static inline void Write32(std::vector<uint8_t> &output, uint32_t value) {
+  output.push_back((value >> 24) & 0xFF);
+  output.push_back((value >> 16) & 0xFF);
+  output.push_back((value >> 8) & 0xFF);
+  output.push_back(value & 0xFF);
+}
+
+void QOIEncode(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t pitch, std::vector<uint8_t> &output) {
+  // Worst case is one RGBA op per pixel.
+  output.reserve(output.size() + 14 + width * height * 5 + sizeof(kEndMarker));
+
+  output.push_back('q');
+  output.push_back('o');
+  output.push_back('i');
+  output.push_back('f');
+  Write32(output, width);
+  Write32(output, height);
+  output.push_back(4);  // RGBA
+  output.push_back(0);  // sRGB with linear alpha
+
+  Pixel index[64];
+  memset(index, 0, sizeof(index));
+
+  Pixel prev{};
+  prev.rgba.a = 0xFF;
+
+  uint32_t run = 0;
+  const uint32_t num_pixels = width * height;
+  uint32_t pixel_index = 0;
+
+  for (uint32_t y = 0; y < height; ++y) {
+    auto row = reinterpret_cast<const uint32_t *>(rgba + y * pitch);
+    for (uint32_t x = 0; x < width; ++x) {
+      Pixel px;
+      px.value = row[x];
+      ++pixel_index;
+
+      if (px.value == prev.value) {
+        ++run;
+        if (run == kMaxRun || pixel_index == num_pixels) {
+          output.push_back(kOpRun | (run - 1));
+          run = 0;
+        }
+        continue;
+      }
+
+      if (run) {
+        output.push_back(kOpRun | (run - 1));
+        run = 0;
+      }
+
+      uint32_t hash = Hash(px);
+      if (index[hash].value == px.value) {
+        output.push_back(kOpIndex | hash);
+        prev = px;
+        continue;
+      }
+      index[hash] = px;
+
+      if (px.rgba.a != prev.rgba.a) {
+        output.push_back(kOpRGBA);
+        output.push_back(px.rgba.r);
+        output.push_back(px.rgba.g);
+        output.push_back(px.rgba.b);
+        output.push_back(px.rgba.a);
+        prev = px;
+        continue;
+      }
+
+      auto vr = static_cast<int8_t>(px.rgba.r - prev.rgba.r);
+      auto vg = static_cast<int8_t>(px.rgba.g - prev.rgba.g);
+      auto vb = static_cast<int8_t>(px.rgba.b - prev.rgba.b);
+      int vg_r = vr - vg;
+      int vg_b = vb - vg;
+
+      if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+        output.push_back(kOpDiff | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+      } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+        output.push_back(kOpLuma | (vg + 32));
+        output.push_back((vg_r + 8) << 4 | (vg_b + 8));
+      } else {
+        output.push_back(kOpRGB);
+        output.push_back(px.rgba.r);
+        output.push_back(px.rgba.g);
+        output.push_back(px.rgba.b);
+      }
+
+      prev = px;
+    }
+  }
+
+  output.insert(output.end(), kEndMarker, kEndMarker + sizeof(kEndMarker));
+}
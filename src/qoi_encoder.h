@@ -0,0 +1,11 @@
+#ifndef NXDK_PGRAPH_TESTS_QOI_ENCODER_H
+#define NXDK_PGRAPH_TESTS_QOI_ENCODER_H
+
+#include <cstdint>
+#include <vector>
+
+// Encodes an RGBA8 (byte order R, G, B, A) image as a "Quite OK Image" (https://qoiformat.org/), appending the result
+// to `output`.
+void QOIEncode(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t pitch, std::vector<uint8_t> &output);
+
+#endif  // NXDK_PGRAPH_TESTS_QOI_ENCODER_H
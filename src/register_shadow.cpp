@@ -0,0 +1,109 @@
+#include "register_shadow.h"
+
+#include <pbkit/pbkit.h>
+
+#include <cstring>
+
+#include "debug_output.h"
+
+static inline uint32_t MethodIndex(uint32_t method) {
+  ASSERT(!(method & 0x03) && "Method must be dword aligned.");
+  uint32_t index = method >> 2;
+  ASSERT(index < 0x2000 / 4 && "Method out of range for the register shadow.");
+  return index;
+}
+
+static inline uint32_t FloatBits(float value) {
+  uint32_t ret;
+  memcpy(&ret, &value, sizeof(ret));
+  return ret;
+}
+
+bool RegisterShadow::IsLatched(uint32_t index, uint32_t value) const {
+  return !force_writes_ && valid_[index] && values_[index] == value;
+}
+
+uint32_t *RegisterShadow::Push(uint32_t *p, uint32_t method, uint32_t value) {
+  uint32_t index = MethodIndex(method);
+  if (IsLatched(index, value)) {
+    return p;
+  }
+
+  values_[index] = value;
+  valid_.set(index);
+  return pb_push1(p, method, value);
+}
+
+uint32_t *RegisterShadow::PushF(uint32_t *p, uint32_t method, float value) { return Push(p, method, FloatBits(value)); }
+
+uint32_t *RegisterShadow::Push(uint32_t *p, uint32_t method, const uint32_t *values, uint32_t count) {
+  uint32_t index = MethodIndex(method);
+  ASSERT(index + count <= kNumRegisters && "Method range out of range for the register shadow.");
+
+  bool latched = true;
+  for (uint32_t i = 0; i < count && latched; ++i) {
+    latched = IsLatched(index + i, values[i]);
+  }
+  if (latched) {
+    return p;
+  }
+
+  pb_push_to(SUBCH_3D, p++, method, count);
+  for (uint32_t i = 0; i < count; ++i) {
+    values_[index + i] = values[i];
+    valid_.set(index + i);
+    *(p++) = values[i];
+  }
+  return p;
+}
+
+uint32_t *RegisterShadow::PushF(uint32_t *p, uint32_t method, const float *values, uint32_t count) {
+  uint32_t bits[16];
+  ASSERT(count <= sizeof(bits) / sizeof(bits[0]) && "Too many float parameters.");
+  for (uint32_t i = 0; i < count; ++i) {
+    bits[i] = FloatBits(values[i]);
+  }
+  return Push(p, method, bits, count);
+}
+
+// Calls `visit(index, value)` for every register written by the given method packets.
+template <typename Visitor>
+static void ForEachRegister(const uint32_t *commands, uint32_t num_dwords, Visitor visit) {
+  const uint32_t *end = commands + num_dwords;
+  while (commands < end) {
+    uint32_t header = *commands++;
+    ASSERT(!(header & 0x40000000) && "Non-incrementing methods are not supported.");
+    ASSERT(((header >> 13) & 0x07) == SUBCH_3D && "Only 3D subchannel methods are supported.");
+    uint32_t index = MethodIndex(header & 0x1FFC);
+    uint32_t count = (header >> 18) & 0x7FF;
+    ASSERT(commands + count <= end && "Truncated method packet.");
+
+    for (uint32_t i = 0; i < count; ++i) {
+      visit(index + i, *commands++);
+    }
+  }
+}
+
+uint32_t *RegisterShadow::PushCommands(uint32_t *p, const uint32_t *commands, uint32_t num_dwords) {
+  bool latched = true;
+  ForEachRegister(commands, num_dwords, [this, &latched](uint32_t index, uint32_t value) {
+    latched = latched && IsLatched(index, value);
+  });
+  if (latched) {
+    return p;
+  }
+
+  ForEachRegister(commands, num_dwords, [this](uint32_t index, uint32_t value) {
+    values_[index] = value;
+    valid_.set(index);
+  });
+  memcpy(p, commands, num_dwords * sizeof(*p));
+  return p + num_dwords;
+}
+
+void RegisterShadow::Invalidate(uint32_t method, uint32_t count) {
+  uint32_t index = MethodIndex(method);
+  for (uint32_t i = 0; i < count && index + i < kNumRegisters; ++i) {
+    valid_.reset(index + i);
+  }
+}
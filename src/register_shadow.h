@@ -0,0 +1,48 @@
+#ifndef NXDK_PGRAPH_TESTS_REGISTER_SHADOW_H
+#define NXDK_PGRAPH_TESTS_REGISTER_SHADOW_H
+
+#include <bitset>
+#include <cstdint>
+
+// Tracks the last value written to each NV097 method so that writes that would not change the latched pgraph state
+// can be dropped from the pushbuffer.
+//
+// Only writes made through this class are tracked. Code that pushes a shadowed method directly must call Invalidate
+// afterwards, or the shadow may suppress a write that is actually needed.
+class RegisterShadow {
+ public:
+  // Pushes `value` to `method` unless it is known to already be latched. Returns the advanced pushbuffer pointer.
+  uint32_t *Push(uint32_t *p, uint32_t method, uint32_t value);
+  uint32_t *PushF(uint32_t *p, uint32_t method, float value);
+
+  // Pushes `count` consecutive registers starting at `method` as a single packet. The packet is only dropped if every
+  // register is already latched.
+  uint32_t *Push(uint32_t *p, uint32_t method, const uint32_t *values, uint32_t count);
+  uint32_t *PushF(uint32_t *p, uint32_t method, const float *values, uint32_t count);
+
+  // Copies a prebuilt sequence of `num_dwords` dwords of 3D subchannel, incrementing method packets into the pushbuffer
+  // unless every register it writes is already latched.
+  uint32_t *PushCommands(uint32_t *p, const uint32_t *commands, uint32_t num_dwords);
+
+  // Forgets all tracked state, forcing the next write to every method.
+  void Invalidate() { valid_.reset(); }
+  // Forgets the tracked state for `count` consecutive registers starting at `method`.
+  void Invalidate(uint32_t method, uint32_t count = 1);
+
+  // When enabled, every write is pushed regardless of the tracked state (the shadow is still updated).
+  void SetForceWrites(bool force) { force_writes_ = force; }
+  bool GetForceWrites() const { return force_writes_; }
+
+ private:
+  bool IsLatched(uint32_t index, uint32_t value) const;
+
+ private:
+  // NV097 methods occupy 0x0000 - 0x1FFC.
+  static constexpr uint32_t kNumRegisters = 0x2000 / 4;
+
+  uint32_t values_[kNumRegisters]{};
+  std::bitset<kNumRegisters> valid_;
+  bool force_writes_{false};
+};
+
+#endif  // NXDK_PGRAPH_TESTS_REGISTER_SHADOW_H
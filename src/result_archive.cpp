@@ -0,0 +1,77 @@
+#include "result_archive.h"
+
+static constexpr char kArchiveMagic[4] = {'N', 'X', 'P', 'K'};
+
+ResultArchive::~ResultArchive() { Close(); }
+
+bool ResultArchive::Open(const std::string &path) {
+  Close();
+
+  fp_ = fopen(path.c_str(), "wb");
+  if (!fp_) {
+    return false;
+  }
+
+  data_end_ = 0;
+  entries_.clear();
+  return true;
+}
+
+void ResultArchive::Close() {
+  if (!fp_) {
+    return;
+  }
+
+  WriteIndex();
+  fclose(fp_);
+  fp_ = nullptr;
+}
+
+bool ResultArchive::Append(const std::string &name, const void *data, uint32_t size, const void *data2,
+                           uint32_t size2) {
+  if (!fp_) {
+    return false;
+  }
+
+  // Overwrite any previously written index, it will be regenerated by the next WriteIndex.
+  if (fseek(fp_, static_cast<long>(data_end_), SEEK_SET)) {
+    return false;
+  }
+
+  if (fwrite(data, 1, size, fp_) != size) {
+    return false;
+  }
+  if (data2 && fwrite(data2, 1, size2, fp_) != size2) {
+    return false;
+  }
+
+  entries_.push_back({name, data_end_, size + size2});
+  data_end_ += size + size2;
+  return true;
+}
+
+bool ResultArchive::WriteIndex() {
+  if (!fp_) {
+    return false;
+  }
+
+  if (fseek(fp_, static_cast<long>(data_end_), SEEK_SET)) {
+    return false;
+  }
+
+  bool ok = true;
+  for (auto &entry : entries_) {
+    auto name_length = static_cast<uint16_t>(entry.name.length());
+    ok = ok && fwrite(&name_length, sizeof(name_length), 1, fp_) == 1;
+    ok = ok && fwrite(entry.name.c_str(), 1, name_length, fp_) == name_length;
+    ok = ok && fwrite(&entry.offset, sizeof(entry.offset), 1, fp_) == 1;
+    ok = ok && fwrite(&entry.size, sizeof(entry.size), 1, fp_) == 1;
+  }
+
+  auto entry_count = static_cast<uint32_t>(entries_.size());
+  ok = ok && fwrite(&data_end_, sizeof(data_end_), 1, fp_) == 1;
+  ok = ok && fwrite(&entry_count, sizeof(entry_count), 1, fp_) == 1;
+  ok = ok && fwrite(kArchiveMagic, 1, sizeof(kArchiveMagic), fp_) == sizeof(kArchiveMagic);
+
+  return ok && !fflush(fp_);
+}
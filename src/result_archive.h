@@ -0,0 +1,48 @@
+#ifndef NXDK_PGRAPH_TESTS_RESULT_ARCHIVE_H
+#define NXDK_PGRAPH_TESTS_RESULT_ARCHIVE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Packs many result files into a single container to avoid the cost of creating individual files on FATX.
+//
+// Layout:
+//   [entry data...]
+//   [index: for each entry {uint16_t name_length, char name[name_length], uint32_t offset, uint32_t size}]
+//   [footer: uint32_t index_offset, uint32_t entry_count, char magic[4] = "NXPK"]
+// All values are little endian. The index is rewritten each time WriteIndex is called, so the archive remains valid
+// as long as WriteIndex is called periodically.
+class ResultArchive {
+ public:
+  ResultArchive() = default;
+  ~ResultArchive();
+
+  // Creates (or truncates) the archive at the given path.
+  bool Open(const std::string &path);
+  // Writes the index and closes the archive.
+  void Close();
+
+  bool IsOpen() const { return fp_ != nullptr; }
+
+  // Appends an entry composed of the concatenation of `data` and `data2`.
+  bool Append(const std::string &name, const void *data, uint32_t size, const void *data2 = nullptr,
+              uint32_t size2 = 0);
+
+  // Writes the index and footer after the current entry data.
+  bool WriteIndex();
+
+ private:
+  struct Entry {
+    std::string name;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  FILE *fp_{nullptr};
+  uint32_t data_end_{0};
+  std::vector<Entry> entries_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_RESULT_ARCHIVE_H
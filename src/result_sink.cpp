@@ -0,0 +1,56 @@
+#include "result_sink.h"
+
+#include <cstdio>
+
+#include "debug_output.h"
+
+bool FileResultSink::Write(const std::string &target_file, const void *data, uint32_t size, const void *data2,
+                           uint32_t size2) {
+  FILE *fp = fopen(target_file.c_str(), "wb");
+  if (!fp) {
+    PrintMsg("Failed to open output file '%s'\n", target_file.c_str());
+    return false;
+  }
+
+  bool ok = fwrite(data, 1, size, fp) == size;
+  if (ok && data2) {
+    ok = fwrite(data2, 1, size2, fp) == size2;
+  }
+  fclose(fp);
+
+  return ok;
+}
+
+bool ArchiveResultSink::Write(const std::string &target_file, const void *data, uint32_t size, const void *data2,
+                              uint32_t size2) {
+  std::string directory;
+  std::string name = target_file;
+  auto slash = target_file.rfind('\\');
+  if (slash != std::string::npos) {
+    directory = target_file.substr(0, slash);
+    name = target_file.substr(slash + 1);
+  }
+
+  auto &archive = archives_[directory];
+  if (!archive) {
+    archive = std::make_unique<ResultArchive>();
+    std::string archive_path = directory + "\\" + archive_filename_;
+    if (!archive->Open(archive_path)) {
+      PrintMsg("Failed to open result archive '%s'\n", archive_path.c_str());
+      return false;
+    }
+  }
+
+  return archive->Append(name, data, size, data2, size2);
+}
+
+bool ArchiveResultSink::Flush() {
+  bool ok = true;
+  for (auto &entry : archives_) {
+    if (entry.second->IsOpen() && !entry.second->WriteIndex()) {
+      PrintMsg("Failed to write index for archive in '%s'\n", entry.first.c_str());
+      ok = false;
+    }
+  }
+  return ok;
+}
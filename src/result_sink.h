@@ -0,0 +1,51 @@
+#ifndef NXDK_PGRAPH_TESTS_RESULT_SINK_H
+#define NXDK_PGRAPH_TESTS_RESULT_SINK_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "result_archive.h"
+
+// Destination for encoded test results.
+//
+// `target_file` is always the full path the result would have on the local filesystem; sinks are free to interpret it
+// as they see fit. Sinks are only ever accessed from a single thread at a time.
+class ResultSink {
+ public:
+  virtual ~ResultSink() = default;
+
+  // Writes a result composed of the concatenation of `data` and `data2`. Returns false on failure.
+  virtual bool Write(const std::string &target_file, const void *data, uint32_t size, const void *data2,
+                     uint32_t size2) = 0;
+
+  // Ensures that all previously written results have been committed. Returns false on failure.
+  virtual bool Flush() { return true; }
+};
+
+// Writes each result to its own file.
+class FileResultSink : public ResultSink {
+ public:
+  bool Write(const std::string &target_file, const void *data, uint32_t size, const void *data2,
+             uint32_t size2) override;
+};
+
+// Appends results to a single ResultArchive per output directory.
+class ArchiveResultSink : public ResultSink {
+ public:
+  explicit ArchiveResultSink(std::string archive_filename) : archive_filename_(std::move(archive_filename)) {}
+
+  bool Write(const std::string &target_file, const void *data, uint32_t size, const void *data2,
+             uint32_t size2) override;
+  // Rewrites the index of every open archive.
+  bool Flush() override;
+
+ private:
+  std::string archive_filename_;
+  // Map of output directory to the archive holding its results.
+  std::map<std::string, std::unique_ptr<ResultArchive>> archives_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_RESULT_SINK_H
@@ -0,0 +1,286 @@
+#include "results_manifest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "capture_queue.h"
+#include "string_format.h"
+
+static constexpr const char *kPhaseNames[TestHost::TIMING_NUM_PHASES] = {
+    "prepare_draw", "build_pushbuffer", "gpu_wait", "vblank_wait", "save",
+};
+
+// Appends `text` as a quoted JSON string.
+static void AppendString(std::string &output, const std::string &text) {
+  output += '"';
+  for (char c : text) {
+    switch (c) {
+      case '"':
+        output += "\\\"";
+        break;
+      case '\\':
+        output += "\\\\";
+        break;
+      case '\n':
+        output += "\\n";
+        break;
+      case '\r':
+        output += "\\r";
+        break;
+      case '\t':
+        output += "\\t";
+        break;
+      default:
+        if (static_cast<uint8_t>(c) < 0x20) {
+          AppendFormatted(output, "\\u%04x", static_cast<uint32_t>(c));
+        } else {
+          output += c;
+        }
+        break;
+    }
+  }
+  output += '"';
+}
+
+// Reads the JSON string value of `name` within `object` into `value`. Returns false if there is no such member.
+static bool ReadString(const std::string &object, const char *name, std::string &value) {
+  std::string prefix = std::string("\"") + name + "\": \"";
+  auto pos = object.find(prefix);
+  if (pos == std::string::npos) {
+    return false;
+  }
+
+  value.clear();
+  for (pos += prefix.size(); pos < object.size() && object[pos] != '"'; ++pos) {
+    char c = object[pos];
+    if (c != '\\' || pos + 1 >= object.size()) {
+      value += c;
+      continue;
+    }
+
+    c = object[++pos];
+    switch (c) {
+      case 'n':
+        value += '\n';
+        break;
+      case 'r':
+        value += '\r';
+        break;
+      case 't':
+        value += '\t';
+        break;
+      case 'u':
+        value += static_cast<char>(strtoul(object.substr(pos + 1, 4).c_str(), nullptr, 16));
+        pos += 4;
+        break;
+      default:
+        value += c;
+        break;
+    }
+  }
+  return true;
+}
+
+// Returns the number of times `needle` occurs in `haystack`.
+static uint32_t CountOccurrences(const std::string &haystack, const char *needle) {
+  uint32_t count = 0;
+  const auto length = strlen(needle);
+  for (auto pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + length)) {
+    ++count;
+  }
+  return count;
+}
+
+static const char *GetComparisonStatusName(CaptureQueue::ComparisonStatus status) {
+  switch (status) {
+    case CaptureQueue::COMPARISON_MISSING:
+      return "missing";
+    case CaptureQueue::COMPARISON_PASSED:
+      return "passed";
+    case CaptureQueue::COMPARISON_FAILED:
+      return "failed";
+  }
+  return "unknown";
+}
+
+void ResultsManifest::Record(Entry &&entry) {
+  std::string key = entry.suite + "/" + entry.test;
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    index_.emplace(std::move(key), static_cast<uint32_t>(entries_.size()));
+    entries_.push_back(std::move(entry));
+    return;
+  }
+
+  Entry &existing = entries_[it->second];
+  for (auto &file : entry.files) {
+    if (std::find(existing.files.begin(), existing.files.end(), file) == existing.files.end()) {
+      existing.files.push_back(std::move(file));
+    }
+  }
+  existing.total_us = entry.total_us;
+  std::copy(std::begin(entry.phase_us), std::end(entry.phase_us), std::begin(existing.phase_us));
+  existing.memory = entry.memory;
+  existing.gpu_timeouts += entry.gpu_timeouts;
+}
+
+bool ResultsManifest::Load(const std::string &path) {
+  loaded_entries_.clear();
+
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp) {
+    return false;
+  }
+  std::string contents;
+  char buffer[4096];
+  size_t bytes_read;
+  while ((bytes_read = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+    contents.append(buffer, bytes_read);
+  }
+  fclose(fp);
+
+  static constexpr const char kTestsMember[] = "\"tests\": [";
+  auto pos = contents.find(kTestsMember);
+  if (pos == std::string::npos) {
+    return false;
+  }
+
+  // Splits the tests array into its top level objects, ignoring braces within strings.
+  uint32_t depth = 0;
+  bool in_string = false;
+  size_t object_start = 0;
+  for (pos += sizeof(kTestsMember) - 1; pos < contents.size(); ++pos) {
+    const char c = contents[pos];
+    if (in_string) {
+      if (c == '\\') {
+        ++pos;
+      } else if (c == '"') {
+        in_string = false;
+      }
+      continue;
+    }
+
+    if (c == '"') {
+      in_string = true;
+    } else if (c == '{') {
+      if (!depth++) {
+        object_start = pos;
+      }
+    } else if (c == '}') {
+      if (!depth || --depth) {
+        continue;
+      }
+
+      std::string object = contents.substr(object_start, pos - object_start + 1);
+      std::string suite;
+      std::string test;
+      if (!ReadString(object, "suite", suite) || !ReadString(object, "test", test)) {
+        continue;
+      }
+
+      LoadedEntry entry;
+      entry.key = suite + "/" + test;
+      entry.num_failed_comparisons = CountOccurrences(object, "\"status\": \"failed\"");
+      static constexpr const char kTimeoutsMember[] = "\"gpu_timeouts\": ";
+      auto timeouts = object.find(kTimeoutsMember);
+      entry.timed_out = timeouts != std::string::npos &&
+                        strtoul(object.c_str() + timeouts + sizeof(kTimeoutsMember) - 1, nullptr, 10);
+      entry.json = std::move(object);
+      loaded_entries_.push_back(std::move(entry));
+    } else if (c == ']' && !depth) {
+      break;
+    }
+  }
+
+  return true;
+}
+
+bool ResultsManifest::Save(const std::string &path, const CaptureQueue &queue) const {
+  uint32_t num_failed = 0;
+  uint32_t num_timed_out = 0;
+  uint32_t num_tests = 0;
+  std::string tests;
+
+  // Loaded tests keep their original order ahead of those run since, unless they were run again.
+  for (const auto &loaded : loaded_entries_) {
+    if (index_.find(loaded.key) != index_.end()) {
+      continue;
+    }
+    tests += num_tests++ ? ",\n    " : "\n    ";
+    tests += loaded.json;
+    num_failed += loaded.num_failed_comparisons;
+    if (loaded.timed_out) {
+      ++num_timed_out;
+    }
+  }
+
+  for (const auto &entry : entries_) {
+    tests += num_tests++ ? ",\n    {\"suite\": " : "\n    {\"suite\": ";
+    AppendString(tests, entry.suite);
+    tests += ", \"test\": ";
+    AppendString(tests, entry.test);
+
+    AppendFormatted(tests, ",\n     \"timing_us\": {\"total\": %llu", static_cast<unsigned long long>(entry.total_us));
+    for (uint32_t phase = 0; phase < TestHost::TIMING_NUM_PHASES; ++phase) {
+      AppendFormatted(tests, ", \"%s\": %llu", kPhaseNames[phase],
+                      static_cast<unsigned long long>(entry.phase_us[phase]));
+    }
+    AppendFormatted(tests, "},\n     \"memory_bytes\": {\"current\": %u, \"peak\": %u},", entry.memory.current,
+                    entry.memory.peak);
+    if (entry.gpu_timeouts) {
+      ++num_timed_out;
+    }
+    AppendFormatted(tests, "\n     \"gpu_timeouts\": %u,\n     \"results\": [", entry.gpu_timeouts);
+
+    for (uint32_t f = 0; f < entry.files.size(); ++f) {
+      const auto &file = entry.files[f];
+      tests += f ? ",\n       {\"file\": " : "\n       {\"file\": ";
+      AppendString(tests, file);
+
+      if (auto record = queue.FindCaptureRecord(file)) {
+        AppendFormatted(tests, ", \"hash\": \"%08x\", \"written\": %s", record->hash,
+                        record->written ? "true" : "false");
+      }
+
+      if (auto comparison = queue.FindComparisonResult(file)) {
+        if (comparison->status == CaptureQueue::COMPARISON_FAILED) {
+          ++num_failed;
+        }
+        AppendFormatted(tests, ", \"comparison\": {\"status\": \"%s\"", GetComparisonStatusName(comparison->status));
+        if (comparison->status != CaptureQueue::COMPARISON_MISSING) {
+          const auto &metrics = comparison->metrics;
+          AppendFormatted(tests, ", \"mismatched_pixels\": %u, \"total_pixels\": %u", metrics.mismatched_pixels,
+                          metrics.total_pixels);
+          // Identical images have an infinite PSNR, which JSON cannot represent.
+          if (std::isfinite(metrics.psnr)) {
+            AppendFormatted(tests, ", \"psnr\": %.3f", metrics.psnr);
+          } else {
+            tests += ", \"psnr\": null";
+          }
+        }
+        tests += "}";
+      }
+      tests += "}";
+    }
+    tests += entry.files.empty() ? "]}" : "\n     ]}";
+  }
+
+  std::string contents;
+  AppendFormatted(contents,
+                  "{\n  \"version\": %u,\n  \"num_tests\": %u,\n  \"num_failed_comparisons\": %u,\n"
+                  "  \"num_timed_out_tests\": %u,\n",
+                  kVersion, num_tests, num_failed, num_timed_out);
+  contents += "  \"tests\": [";
+  contents += tests;
+  contents += num_tests ? "\n  ]\n}\n" : "]\n}\n";
+
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (!fp) {
+    return false;
+  }
+  const bool written = fwrite(contents.data(), 1, contents.size(), fp) == contents.size();
+  return !fclose(fp) && written;
+}
@@ -0,0 +1,63 @@
+#ifndef NXDK_PGRAPH_TESTS_RESULTS_MANIFEST_H
+#define NXDK_PGRAPH_TESTS_RESULTS_MANIFEST_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "memory_tracker.h"
+#include "test_host.h"
+
+class CaptureQueue;
+
+// Structured record of every test run by a non-interactive pass, written as a single JSON document so that host
+// tooling need not scrape the per-suite CSV files and result filenames.
+class ResultsManifest {
+ public:
+  static constexpr const char *kFilename = "results_manifest.json";
+  static constexpr uint32_t kVersion = 1;
+
+  struct Entry {
+    std::string suite;
+    std::string test;
+    // Results queued for saving by the test, see TestHost::TakeQueuedResultFiles.
+    std::vector<std::string> files;
+    uint64_t total_us;
+    uint64_t phase_us[TestHost::TIMING_NUM_PHASES];
+    // Total tracked memory once the test finished, the peak being the high-water mark of the run so far.
+    MemoryTracker::Usage memory;
+    // Number of GPU waits that timed out while the test ran, see TestHost::WaitForGpuIdle. Any timeout fails the test.
+    uint32_t gpu_timeouts{0};
+  };
+
+ public:
+  // Adds `entry`. Repeated runs of the same test (e.g., by TestSuite::RunAllSustained) replace its timings and memory
+  // usage and add any new files.
+  void Record(Entry &&entry);
+
+  // Loads the tests written to `path` by an earlier, interrupted run so that Save merges them into its output. Tests
+  // recorded by this run replace loaded tests of the same name. Returns false if there was no manifest at `path`.
+  bool Load(const std::string &path);
+
+  // Writes every entry to `path` along with the hash and golden comparison status of each file, as recorded by
+  // `queue`. The queue must have been flushed.
+  bool Save(const std::string &path, const CaptureQueue &queue) const;
+
+ private:
+  // A test loaded from an earlier run's manifest, kept as its serialized JSON object since the capture records that
+  // describe its files are no longer available.
+  struct LoadedEntry {
+    std::string key;
+    std::string json;
+    uint32_t num_failed_comparisons;
+    bool timed_out;
+  };
+
+  std::vector<LoadedEntry> loaded_entries_;
+  std::vector<Entry> entries_;
+  // Map of "<suite>/<test>" to the index of its entry.
+  std::map<std::string, uint32_t> index_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_RESULTS_MANIFEST_H
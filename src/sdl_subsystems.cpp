@@ -0,0 +1,40 @@
+#include "sdl_subsystems.h"
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+#include "debug_output.h"
+
+std::atomic<uint32_t> SDLSubsystems::image_state_{STATE_UNINITIALIZED};
+SDLSubsystems::InitState SDLSubsystems::game_controller_state_ = STATE_UNINITIALIZED;
+
+bool SDLSubsystems::EnsureImageSupport() {
+  uint32_t state = image_state_.load(std::memory_order_acquire);
+  if (state == STATE_UNINITIALIZED) {
+    uint32_t expected = STATE_UNINITIALIZED;
+    if (image_state_.compare_exchange_strong(expected, STATE_INITIALIZING, std::memory_order_acq_rel)) {
+      const bool ready = (IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) != 0;
+      if (!ready) {
+        PrintMsg("Failed to initialize SDL_image PNG mode: %s\n", IMG_GetError());
+      }
+      image_state_.store(ready ? STATE_READY : STATE_FAILED, std::memory_order_release);
+      return ready;
+    }
+    state = expected;
+  }
+
+  // Another thread is mid-initialization; IMG_Init is fast, so yield rather than block on an event.
+  while (state == STATE_INITIALIZING) {
+    NtYieldExecution();
+    state = image_state_.load(std::memory_order_acquire);
+  }
+  return state == STATE_READY;
+}
+
+bool SDLSubsystems::EnsureGameControllerSupport() {
+  if (game_controller_state_ == STATE_UNINITIALIZED) {
+    game_controller_state_ = SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER) ? STATE_FAILED : STATE_READY;
+  }
+  return game_controller_state_ == STATE_READY;
+}
@@ -0,0 +1,31 @@
+#ifndef NXDK_PGRAPH_TESTS_SDL_SUBSYSTEMS_H
+#define NXDK_PGRAPH_TESTS_SDL_SUBSYSTEMS_H
+
+#include <atomic>
+#include <cstdint>
+
+// Initializes optional SDL subsystems the first time they are needed rather than at boot, so that runs that never
+// touch a PNG or a gamepad (e.g., headless QOI or RAW captures) skip their setup entirely.
+class SDLSubsystems {
+ public:
+  // Initializes SDL_image PNG support, returning false if it is unavailable. Thread safe, as PNG captures are encoded
+  // and golden images are loaded on the CaptureQueue thread.
+  static bool EnsureImageSupport();
+
+  // Initializes the SDL game controller subsystem, returning false (see SDL_GetError) if it is unavailable. Must only be
+  // called from the main thread.
+  static bool EnsureGameControllerSupport();
+
+ private:
+  enum InitState : uint32_t {
+    STATE_UNINITIALIZED,
+    STATE_INITIALIZING,
+    STATE_READY,
+    STATE_FAILED,
+  };
+
+  static std::atomic<uint32_t> image_state_;
+  static InitState game_controller_state_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_SDL_SUBSYSTEMS_H
@@ -1,5 +1,7 @@
 #include "orthographic_vertex_shader.h"
 
+#include "math3d_sse.h"
+
 OrthographicVertexShader::OrthographicVertexShader(uint32_t framebuffer_width, uint32_t framebuffer_height, float left,
                                                    float right, float bottom, float top, float near, float far,
                                                    float z_min, float z_max)
@@ -11,7 +13,7 @@ OrthographicVertexShader::OrthographicVertexShader(uint32_t framebuffer_width, u
 }
 
 void OrthographicVertexShader::CalculateProjectionMatrix() {
-  matrix_unit(projection_matrix_);
+  matrix_unit_sse(projection_matrix_);
   projection_matrix_[0] = 2.0f / width_;
   projection_matrix_[5] = 2.0f / height_;
   projection_matrix_[10] = -2.0f / far_minus_near_;
@@ -2,28 +2,42 @@
 
 #include <pbkit/pbkit.h>
 
-void PixelShaderProgram::LoadTexturedPixelShader() {
-  uint32_t *p = pb_begin();
+#include "command_recorder.h"
+#include "debug_output.h"
 
+// Upper bound on the size of a captured program, programs are bound in a single CommandRecorder block.
+static constexpr uint32_t kMaxProgramDwords = CommandRecorder::kMaxDwordsPerSubmit;
+
+PixelShaderProgram::PixelShaderProgram(uint32_t *(*record)(uint32_t *p)) {
+  // Leave headroom so that an oversized program is detected rather than overrunning the capture buffer.
+  uint32_t buffer[kMaxProgramDwords * 4];
+  uint32_t *end = record(buffer);
+
+  auto num_dwords = static_cast<uint32_t>(end - buffer);
+  ASSERT(num_dwords <= kMaxProgramDwords && "Pixel shader program is too large.");
+  commands_.assign(buffer, end);
+}
+
+static uint32_t *RecordTexturedPixelShader(uint32_t *p) {
 // clang format off
 #include "textured_pixelshader.inl"
   // clang format on
-
-  pb_end(p);
+  return p;
 }
 
-void PixelShaderProgram::LoadUntexturedPixelShader() {
-  uint32_t *p = pb_begin();
-
+static uint32_t *RecordUntexturedPixelShader(uint32_t *p) {
 // clang format off
 #include "untextured_pixelshader.inl"
   // clang format on
+  return p;
+}
 
-  pb_end(p);
+const PixelShaderProgram &PixelShaderProgram::Textured() {
+  static const PixelShaderProgram program(RecordTexturedPixelShader);
+  return program;
 }
 
-void PixelShaderProgram::DisablePixelShader() {
-  uint32_t *p = pb_begin();
-  p = pb_push1(p, NV097_SET_SHADER_STAGE_PROGRAM, 0);
-  pb_end(p);
+const PixelShaderProgram &PixelShaderProgram::Untextured() {
+  static const PixelShaderProgram program(RecordUntexturedPixelShader);
+  return program;
 }
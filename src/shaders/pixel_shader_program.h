@@ -1,11 +1,25 @@
 #ifndef NXDK_PGRAPH_TESTS_PIXEL_SHADER_PROGRAM_H
 #define NXDK_PGRAPH_TESTS_PIXEL_SHADER_PROGRAM_H
 
+#include <cstdint>
+#include <vector>
+
+// Register combiner and shader stage setup, captured once as a prebuilt pushbuffer fragment. Programs are bound via
+// TestHost::SetPixelShaderProgram, which skips the upload if the program's values are still latched.
 class PixelShaderProgram {
  public:
-  static void LoadTexturedPixelShader();
-  static void LoadUntexturedPixelShader();
-  static void DisablePixelShader();
+  // Captures the commands written by `record`, which is passed a pointer to write pushbuffer commands to and must
+  // return the advanced pointer. Commands must be incrementing 3D subchannel methods.
+  explicit PixelShaderProgram(uint32_t *(*record)(uint32_t *p));
+
+  const std::vector<uint32_t> &GetCommands() const { return commands_; }
+
+  // Programs compiled from textured_pixelshader.ps.cg and untextured_pixelshader.ps.cg.
+  static const PixelShaderProgram &Textured();
+  static const PixelShaderProgram &Untextured();
+
+ private:
+  std::vector<uint32_t> commands_;
 };
 
 #endif  // NXDK_PGRAPH_TESTS_PIXEL_SHADER_PROGRAM_H
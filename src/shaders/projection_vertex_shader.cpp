@@ -6,6 +6,7 @@
 #include <memory>
 
 #include "math3d.h"
+#include "math3d_sse.h"
 
 // clang format off
 static constexpr uint32_t kVertexShaderLighting[] = {
@@ -27,7 +28,7 @@ ProjectionVertexShader::ProjectionVertexShader(uint32_t framebuffer_width, uint3
       z_min_(z_min),
       z_max_(z_max),
       enable_lighting_{enable_lighting} {
-  matrix_unit(view_matrix_);
+  matrix_unit_sse(view_matrix_);
 
   VECTOR rot = {0, 0, 0, 1};
   create_world_view(view_matrix_, camera_position_, rot);
@@ -85,7 +86,7 @@ void ProjectionVertexShader::LookTo(const float *camera_position, const float *c
 void ProjectionVertexShader::SetCamera(const VECTOR position, const VECTOR rotation) {
   memcpy(camera_position_, position, sizeof(camera_position_));
 
-  matrix_unit(view_matrix_);
+  matrix_unit_sse(view_matrix_);
   create_world_view(view_matrix_, camera_position_, rotation);
 }
 
@@ -97,10 +98,10 @@ void ProjectionVertexShader::UpdateMatrices() {
   CalculateProjectionMatrix();
 
   matrix_viewport(viewport_matrix_, 0, 0, framebuffer_width_, framebuffer_height_, z_min_, z_max_);
-  matrix_multiply(projection_viewport_matrix_, projection_matrix_, viewport_matrix_);
+  matrix_multiply_sse(projection_viewport_matrix_, projection_matrix_, viewport_matrix_);
 
   /* Create local->world matrix given our updated object */
-  matrix_unit(model_matrix_);
+  matrix_unit_sse(model_matrix_);
 }
 
 void ProjectionVertexShader::OnActivate() { UpdateMatrices(); }
@@ -109,7 +110,7 @@ void ProjectionVertexShader::OnLoadShader() {
   if (enable_lighting_) {
     LoadShaderProgram(kVertexShaderLighting, sizeof(kVertexShaderLighting));
   } else {
-    LoadShaderProgram(kVertexShaderNoLighting, sizeof(kVertexShaderLighting));
+    LoadShaderProgram(kVertexShaderNoLighting, sizeof(kVertexShaderNoLighting));
   }
 }
 
@@ -144,7 +145,7 @@ void ProjectionVertexShader::OnLoadConstants() {
 
 /* Construct a viewport transformation matrix */
 static void matrix_viewport(MATRIX out, float x, float y, float width, float height, float z_min, float z_max) {
-  matrix_unit(out);
+  matrix_unit_sse(out);
   out[0] = width / 2.0f;
   out[5] = height / -2.0f;
   out[10] = (z_max - z_min) / 2.0f;
@@ -0,0 +1,89 @@
+#include "transform_program_memory.h"
+
+#include <pbkit/pbkit.h>
+
+#include <cstring>
+
+#include "command_recorder.h"
+#include "debug_output.h"
+#include "pbkit_ext.h"
+
+// NV097_SET_TRANSFORM_PROGRAM is a 32 dword method array, the load cursor advances after every 4th dword.
+static constexpr uint32_t kInstructionsPerPacket = 32 / TransformProgramMemory::kDwordsPerInstruction;
+static constexpr uint32_t kPacketsPerSubmit = 3;
+
+std::vector<TransformProgramMemory::ResidentProgram> TransformProgramMemory::resident_programs_;
+uint32_t TransformProgramMemory::use_counter_ = 0;
+
+uint32_t TransformProgramMemory::MakeResident(const uint32_t *program, uint32_t program_size) {
+  uint32_t num_instructions = program_size / (kDwordsPerInstruction * sizeof(uint32_t));
+  ASSERT(num_instructions && num_instructions <= kMaxInstructions && "Invalid transform program size.");
+
+  for (auto &entry : resident_programs_) {
+    if (entry.program == program && entry.num_instructions == num_instructions) {
+      entry.last_use = ++use_counter_;
+      return entry.start;
+    }
+  }
+
+  int32_t start = FindFreeRange(num_instructions);
+  while (start < 0) {
+    auto lru = resident_programs_.begin();
+    for (auto it = resident_programs_.begin(); it != resident_programs_.end(); ++it) {
+      if (it->last_use < lru->last_use) {
+        lru = it;
+      }
+    }
+    resident_programs_.erase(lru);
+    start = FindFreeRange(num_instructions);
+  }
+
+  Upload(program, num_instructions, start);
+
+  ResidentProgram entry{program, static_cast<uint32_t>(start), num_instructions, ++use_counter_};
+  auto it = resident_programs_.begin();
+  while (it != resident_programs_.end() && it->start < entry.start) {
+    ++it;
+  }
+  resident_programs_.insert(it, entry);
+
+  return entry.start;
+}
+
+void TransformProgramMemory::Invalidate() { resident_programs_.clear(); }
+
+int32_t TransformProgramMemory::FindFreeRange(uint32_t num_instructions) {
+  uint32_t gap_start = 0;
+  for (auto &entry : resident_programs_) {
+    if (entry.start - gap_start >= num_instructions) {
+      return static_cast<int32_t>(gap_start);
+    }
+    gap_start = entry.start + entry.num_instructions;
+  }
+
+  if (kMaxInstructions - gap_start >= num_instructions) {
+    return static_cast<int32_t>(gap_start);
+  }
+  return -1;
+}
+
+void TransformProgramMemory::Upload(const uint32_t *program, uint32_t num_instructions, uint32_t start) {
+  auto p = CommandRecorder::Begin();
+  p = pb_push1(p, NV097_SET_TRANSFORM_PROGRAM_LOAD, start);
+  CommandRecorder::End(p);
+
+  while (num_instructions) {
+    p = CommandRecorder::Begin();
+    for (uint32_t packet = 0; packet < kPacketsPerSubmit && num_instructions; ++packet) {
+      uint32_t count = num_instructions < kInstructionsPerPacket ? num_instructions : kInstructionsPerPacket;
+      uint32_t num_dwords = count * kDwordsPerInstruction;
+
+      pb_push(p++, NV097_SET_TRANSFORM_PROGRAM, num_dwords);
+      memcpy(p, program, num_dwords * sizeof(uint32_t));
+      p += num_dwords;
+      program += num_dwords;
+      num_instructions -= count;
+    }
+    CommandRecorder::End(p);
+  }
+}
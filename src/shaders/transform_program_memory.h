@@ -0,0 +1,42 @@
+#ifndef NXDK_PGRAPH_TESTS_SHADERS_TRANSFORM_PROGRAM_MEMORY_H_
+#define NXDK_PGRAPH_TESTS_SHADERS_TRANSFORM_PROGRAM_MEMORY_H_
+
+#include <cstdint>
+#include <vector>
+
+// Tracks the contents of the nv2a transform program RAM, packing multiple vertex programs into it so that switching
+// between programs that are already resident only requires changing NV097_SET_TRANSFORM_PROGRAM_START.
+//
+// Programs are identified by the address and size of their microcode, so callers must not modify a program's contents
+// after it has been made resident.
+class TransformProgramMemory {
+ public:
+  static constexpr uint32_t kMaxInstructions = 136;
+  static constexpr uint32_t kDwordsPerInstruction = 4;
+
+  // Ensures that the given program (`program_size` is in bytes) is loaded, evicting the least recently used programs
+  // if there is insufficient space. Returns the instruction slot at which the program starts.
+  static uint32_t MakeResident(const uint32_t *program, uint32_t program_size);
+
+  // Forgets all resident programs. Must be called after writing to transform program memory without going through
+  // this class.
+  static void Invalidate();
+
+ private:
+  struct ResidentProgram {
+    const uint32_t *program;
+    uint32_t start;
+    uint32_t num_instructions;
+    uint32_t last_use;
+  };
+
+  // Returns the first slot of a gap of at least `num_instructions` slots, or -1 if no such gap exists.
+  static int32_t FindFreeRange(uint32_t num_instructions);
+  static void Upload(const uint32_t *program, uint32_t num_instructions, uint32_t start);
+
+  // Resident programs, ordered by start slot.
+  static std::vector<ResidentProgram> resident_programs_;
+  static uint32_t use_counter_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_SHADERS_TRANSFORM_PROGRAM_MEMORY_H_
@@ -0,0 +1,283 @@
+#include "vertex_program_assembler.h"
+
+#include <set>
+
+#include "debug_output.h"
+#include "transform_program_memory.h"
+
+// Operand sources.
+static constexpr uint32_t kMuxTemp = 1;
+static constexpr uint32_t kMuxInput = 2;
+static constexpr uint32_t kMuxConstant = 3;
+
+static constexpr uint32_t kSwizzleXYZW = 0x1B;
+
+// Register 96 (c[0] in Cg) is the first constant written by VertexShaderProgram.
+static constexpr int32_t kConstantBase = 96;
+static constexpr int32_t kNumConstants = 192;
+
+// Indicates that an instruction does not write a temporary register.
+static constexpr uint32_t kNoTempOutput = 7;
+
+enum MACOp {
+  MAC_NOP = 0,
+  MAC_MOV,
+  MAC_MUL,
+  MAC_ADD,
+  MAC_MAD,
+  MAC_DP3,
+  MAC_DPH,
+  MAC_DP4,
+  MAC_DST,
+  MAC_MIN,
+  MAC_MAX,
+  MAC_SLT,
+  MAC_SGE,
+  MAC_ARL,
+};
+
+enum ILUOp {
+  ILU_NOP = 0,
+  ILU_MOV,
+  ILU_RCP,
+  ILU_RCC,
+  ILU_RSQ,
+  ILU_EXP,
+  ILU_LOG,
+  ILU_LIT,
+};
+
+VertexProgramAssembler::Source VertexProgramAssembler::Source::Swizzle(const char *components) const {
+  Source ret = *this;
+  ret.swizzle = 0;
+
+  uint32_t component = 0;
+  for (uint32_t i = 0; i < 4; ++i) {
+    if (*components) {
+      switch (*components++) {
+        case 'x':
+          component = 0;
+          break;
+        case 'y':
+          component = 1;
+          break;
+        case 'z':
+          component = 2;
+          break;
+        case 'w':
+          component = 3;
+          break;
+        default:
+          ASSERT(!"Invalid swizzle component.");
+      }
+    }
+    ret.swizzle = (ret.swizzle << 2) | component;
+  }
+
+  return ret;
+}
+
+VertexProgramAssembler::Source VertexProgramAssembler::Source::Relative() const {
+  ASSERT(mux == kMuxConstant && "Only constant registers may be addressed relative to A0.");
+  Source ret = *this;
+  ret.relative = true;
+  return ret;
+}
+
+VertexProgramAssembler::Source VertexProgramAssembler::R(uint32_t index) {
+  ASSERT(index <= 12 && "Invalid temporary register.");
+  return {kMuxTemp, index, kSwizzleXYZW, false, false};
+}
+
+VertexProgramAssembler::Source VertexProgramAssembler::V(uint32_t index) {
+  ASSERT(index < 16 && "Invalid input register.");
+  return {kMuxInput, index, kSwizzleXYZW, false, false};
+}
+
+VertexProgramAssembler::Source VertexProgramAssembler::C(int32_t index) {
+  ASSERT(index >= -kConstantBase && index < kNumConstants - kConstantBase && "Invalid constant register.");
+  return {kMuxConstant, static_cast<uint32_t>(index + kConstantBase), kSwizzleXYZW, false, false};
+}
+
+VertexProgramAssembler::Destination VertexProgramAssembler::Temp(uint32_t index, uint32_t mask) {
+  ASSERT(index < 12 && "Invalid temporary register.");
+  return {Destination::TEMP, index, mask};
+}
+
+VertexProgramAssembler::Destination VertexProgramAssembler::Output(OutputRegister reg, uint32_t mask) {
+  return {Destination::OUTPUT, static_cast<uint32_t>(reg), mask};
+}
+
+VertexProgramAssembler::Destination VertexProgramAssembler::Constant(int32_t index, uint32_t mask) {
+  ASSERT(index >= -kConstantBase && index < kNumConstants - kConstantBase && "Invalid constant register.");
+  return {Destination::CONSTANT, static_cast<uint32_t>(index + kConstantBase), mask};
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Mov(const Destination &dst, const Source &a) {
+  return EmitMAC(MAC_MOV, dst, &a, nullptr, nullptr);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Mul(const Destination &dst, const Source &a, const Source &b) {
+  return EmitMAC(MAC_MUL, dst, &a, &b, nullptr);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Add(const Destination &dst, const Source &a, const Source &b) {
+  // ADD reads its second operand from the C slot.
+  return EmitMAC(MAC_ADD, dst, &a, nullptr, &b);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Mad(const Destination &dst, const Source &a, const Source &b,
+                                                    const Source &c) {
+  return EmitMAC(MAC_MAD, dst, &a, &b, &c);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Dp3(const Destination &dst, const Source &a, const Source &b) {
+  return EmitMAC(MAC_DP3, dst, &a, &b, nullptr);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Dph(const Destination &dst, const Source &a, const Source &b) {
+  return EmitMAC(MAC_DPH, dst, &a, &b, nullptr);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Dp4(const Destination &dst, const Source &a, const Source &b) {
+  return EmitMAC(MAC_DP4, dst, &a, &b, nullptr);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Dst(const Destination &dst, const Source &a, const Source &b) {
+  return EmitMAC(MAC_DST, dst, &a, &b, nullptr);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Min(const Destination &dst, const Source &a, const Source &b) {
+  return EmitMAC(MAC_MIN, dst, &a, &b, nullptr);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Max(const Destination &dst, const Source &a, const Source &b) {
+  return EmitMAC(MAC_MAX, dst, &a, &b, nullptr);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Slt(const Destination &dst, const Source &a, const Source &b) {
+  return EmitMAC(MAC_SLT, dst, &a, &b, nullptr);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Sge(const Destination &dst, const Source &a, const Source &b) {
+  return EmitMAC(MAC_SGE, dst, &a, &b, nullptr);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Arl(const Source &a) {
+  static constexpr Destination kAddress = {Destination::ADDRESS, 0, 0};
+  return EmitMAC(MAC_ARL, kAddress, &a, nullptr, nullptr);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Rcp(const Destination &dst, const Source &a) {
+  return EmitILU(ILU_RCP, dst, a);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Rcc(const Destination &dst, const Source &a) {
+  return EmitILU(ILU_RCC, dst, a);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Rsq(const Destination &dst, const Source &a) {
+  return EmitILU(ILU_RSQ, dst, a);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Exp(const Destination &dst, const Source &a) {
+  return EmitILU(ILU_EXP, dst, a);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Log(const Destination &dst, const Source &a) {
+  return EmitILU(ILU_LOG, dst, a);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::Lit(const Destination &dst, const Source &a) {
+  return EmitILU(ILU_LIT, dst, a);
+}
+
+VertexProgramAssembler &VertexProgramAssembler::EmitMAC(uint32_t op, const Destination &dst, const Source *a,
+                                                        const Source *b, const Source *c) {
+  Emit(op, ILU_NOP, dst, a, b, c);
+  return *this;
+}
+
+VertexProgramAssembler &VertexProgramAssembler::EmitILU(uint32_t op, const Destination &dst, const Source &c) {
+  // The ILU only reads the C operand.
+  Emit(MAC_NOP, op, dst, nullptr, nullptr, &c);
+  return *this;
+}
+
+void VertexProgramAssembler::Emit(uint32_t mac, uint32_t ilu, const Destination &dst, const Source *a,
+                                  const Source *b, const Source *c) {
+  ASSERT(GetNumInstructions() < TransformProgramMemory::kMaxInstructions && "Vertex program too long.");
+  ASSERT((dst.type == Destination::ADDRESS || (dst.mask && dst.mask <= MASK_XYZW)) && "Invalid write mask.");
+
+  static constexpr Source kUnused = {kMuxInput, 0, kSwizzleXYZW, false, false};
+  const Source *operands[3] = {a ? a : &kUnused, b ? b : &kUnused, c ? c : &kUnused};
+
+  // Each instruction has a single input and a single constant register index shared by all of its operands.
+  uint32_t input_index = 0;
+  uint32_t constant_index = 0;
+  bool constant_relative = false;
+  bool has_input = false;
+  bool has_constant = false;
+  for (auto operand : operands) {
+    if (operand == &kUnused) {
+      continue;
+    }
+    if (operand->mux == kMuxInput) {
+      ASSERT((!has_input || input_index == operand->index) && "Instruction reads multiple input registers.");
+      input_index = operand->index;
+      has_input = true;
+    } else if (operand->mux == kMuxConstant) {
+      ASSERT((!has_constant || (constant_index == operand->index && constant_relative == operand->relative)) &&
+             "Instruction reads multiple constant registers.");
+      constant_index = operand->index;
+      constant_relative = operand->relative;
+      has_constant = true;
+    }
+  }
+
+  auto temp_index = [](const Source *operand) { return operand->mux == kMuxTemp ? operand->index : 0; };
+  const uint32_t a_r = temp_index(operands[0]);
+  const uint32_t b_r = temp_index(operands[1]);
+  const uint32_t c_r = temp_index(operands[2]);
+
+  uint32_t mac_mask = 0;
+  uint32_t ilu_mask = 0;
+  uint32_t out_r = kNoTempOutput;
+  uint32_t output_mask = 0;
+  uint32_t output_is_register = 1;
+  uint32_t output_address = 0;
+  if (dst.type == Destination::TEMP) {
+    out_r = dst.address;
+    if (ilu) {
+      ilu_mask = dst.mask;
+    } else {
+      mac_mask = dst.mask;
+    }
+  } else if (dst.type != Destination::ADDRESS) {
+    output_mask = dst.mask;
+    output_is_register = dst.type == Destination::OUTPUT ? 1 : 0;
+    output_address = dst.address;
+  }
+  const uint32_t output_from_ilu = ilu ? 1 : 0;
+
+  microcode_.push_back(0);
+  microcode_.push_back((ilu << 25) | (mac << 21) | (constant_index << 13) | (input_index << 9) |
+                       (operands[0]->negate << 8) | operands[0]->swizzle);
+  microcode_.push_back((a_r << 28) | (operands[0]->mux << 26) | (operands[1]->negate << 25) |
+                       (operands[1]->swizzle << 17) | (b_r << 13) | (operands[1]->mux << 11) |
+                       (operands[2]->negate << 10) | (operands[2]->swizzle << 2) | (c_r >> 2));
+  microcode_.push_back(((c_r & 0x03) << 30) | (operands[2]->mux << 28) | (mac_mask << 24) | (out_r << 20) |
+                       (ilu_mask << 16) | (output_mask << 12) | (output_is_register << 11) | (output_address << 3) |
+                       (output_from_ilu << 2) | (constant_relative << 1));
+}
+
+const std::vector<uint32_t> &VertexProgramAssembler::Assemble() const {
+  ASSERT(!microcode_.empty() && "Vertex program has no instructions.");
+
+  // std::set nodes are never relocated, so the returned storage may be used as a TransformProgramMemory key.
+  static std::set<std::vector<uint32_t>> cache;
+
+  std::vector<uint32_t> program = microcode_;
+  program.back() |= 1;  // FINAL
+  return *cache.insert(program).first;
+}
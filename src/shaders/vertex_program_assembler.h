@@ -0,0 +1,121 @@
+#ifndef NXDK_PGRAPH_TESTS_SHADERS_VERTEX_PROGRAM_ASSEMBLER_H_
+#define NXDK_PGRAPH_TESTS_SHADERS_VERTEX_PROGRAM_ASSEMBLER_H_
+
+#include <cstdint>
+#include <vector>
+
+// Builds nv2a transform program microcode at runtime, allowing tests to generate shader permutations on demand rather
+// than compiling a Cg source for each one.
+//
+// Each instruction is executed by a single unit (MAC or ILU); paired instructions are not supported. As on the
+// hardware, an instruction may read at most one distinct input (v) register and one distinct constant (c) register.
+//
+// E.g.,
+//   VertexProgramAssembler vp;
+//   vp.Mov(VertexProgramAssembler::Output(VertexProgramAssembler::OUT_POSITION), VertexProgramAssembler::V(0));
+//   auto &program = vp.Assemble();
+//   shader->SetShaderOverride(program.data(), program.size() * sizeof(uint32_t));
+class VertexProgramAssembler {
+ public:
+  // Output (o) register addresses.
+  enum OutputRegister {
+    OUT_POSITION = 0,
+    OUT_DIFFUSE = 3,
+    OUT_SPECULAR = 4,
+    OUT_FOG = 5,
+    OUT_POINT_SIZE = 6,
+    OUT_BACK_DIFFUSE = 7,
+    OUT_BACK_SPECULAR = 8,
+    OUT_TEX0 = 9,
+    OUT_TEX1 = 10,
+    OUT_TEX2 = 11,
+    OUT_TEX3 = 12,
+  };
+
+  enum WriteMask {
+    MASK_W = 1,
+    MASK_Z = 2,
+    MASK_Y = 4,
+    MASK_X = 8,
+    MASK_XY = MASK_X | MASK_Y,
+    MASK_XYZ = MASK_X | MASK_Y | MASK_Z,
+    MASK_XYZW = MASK_X | MASK_Y | MASK_Z | MASK_W,
+  };
+
+  struct Source {
+    // Returns a copy of this source reading the given components (e.g., "wzyx"). Fewer than four components repeat the
+    // last (e.g., "w" is equivalent to "wwww").
+    Source Swizzle(const char *components) const;
+    Source operator-() const {
+      Source ret = *this;
+      ret.negate = !ret.negate;
+      return ret;
+    }
+    // Returns a copy of this constant source that is addressed relative to A0.x (i.e., c[A0.x + index]).
+    Source Relative() const;
+
+    uint32_t mux;
+    uint32_t index;
+    uint32_t swizzle;
+    bool negate;
+    bool relative;
+  };
+
+  struct Destination {
+    enum Type { TEMP, OUTPUT, CONSTANT, ADDRESS };
+
+    Type type;
+    uint32_t address;
+    uint32_t mask;
+  };
+
+  // Temporary register R`index`. R12 reads back the value written to oPos.
+  static Source R(uint32_t index);
+  // Vertex attribute `index` (e.g., 0 for position, 3 for diffuse).
+  static Source V(uint32_t index);
+  // Constant c[`index`], where c[0] is the first constant uploaded by VertexShaderProgram (i.e., register 96).
+  static Source C(int32_t index);
+
+  static Destination Temp(uint32_t index, uint32_t mask = MASK_XYZW);
+  static Destination Output(OutputRegister reg, uint32_t mask = MASK_XYZW);
+  static Destination Constant(int32_t index, uint32_t mask = MASK_XYZW);
+
+  VertexProgramAssembler &Mov(const Destination &dst, const Source &a);
+  VertexProgramAssembler &Mul(const Destination &dst, const Source &a, const Source &b);
+  VertexProgramAssembler &Add(const Destination &dst, const Source &a, const Source &b);
+  VertexProgramAssembler &Mad(const Destination &dst, const Source &a, const Source &b, const Source &c);
+  VertexProgramAssembler &Dp3(const Destination &dst, const Source &a, const Source &b);
+  VertexProgramAssembler &Dph(const Destination &dst, const Source &a, const Source &b);
+  VertexProgramAssembler &Dp4(const Destination &dst, const Source &a, const Source &b);
+  VertexProgramAssembler &Dst(const Destination &dst, const Source &a, const Source &b);
+  VertexProgramAssembler &Min(const Destination &dst, const Source &a, const Source &b);
+  VertexProgramAssembler &Max(const Destination &dst, const Source &a, const Source &b);
+  VertexProgramAssembler &Slt(const Destination &dst, const Source &a, const Source &b);
+  VertexProgramAssembler &Sge(const Destination &dst, const Source &a, const Source &b);
+  // Loads floor(a.x) into the address register A0.x.
+  VertexProgramAssembler &Arl(const Source &a);
+
+  VertexProgramAssembler &Rcp(const Destination &dst, const Source &a);
+  VertexProgramAssembler &Rcc(const Destination &dst, const Source &a);
+  VertexProgramAssembler &Rsq(const Destination &dst, const Source &a);
+  VertexProgramAssembler &Exp(const Destination &dst, const Source &a);
+  VertexProgramAssembler &Log(const Destination &dst, const Source &a);
+  VertexProgramAssembler &Lit(const Destination &dst, const Source &a);
+
+  uint32_t GetNumInstructions() const { return microcode_.size() / 4; }
+
+  // Returns the encoded program, suitable for VertexShaderProgram::SetShaderOverride. Encoded programs are cached and
+  // identical programs share the same storage, which remains valid for the lifetime of the application.
+  const std::vector<uint32_t> &Assemble() const;
+
+ private:
+  VertexProgramAssembler &EmitMAC(uint32_t op, const Destination &dst, const Source *a, const Source *b,
+                                  const Source *c);
+  VertexProgramAssembler &EmitILU(uint32_t op, const Destination &dst, const Source &c);
+  void Emit(uint32_t mac, uint32_t ilu, const Destination &dst, const Source *a, const Source *b, const Source *c);
+
+ private:
+  std::vector<uint32_t> microcode_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_SHADERS_VERTEX_PROGRAM_ASSEMBLER_H_
@@ -4,16 +4,18 @@
 
 #include <memory>
 
+#include "command_recorder.h"
+#include "debug_output.h"
 #include "pbkit_ext.h"
+#include "transform_program_memory.h"
 
 void VertexShaderProgram::LoadShaderProgram(const uint32_t *shader, uint32_t shader_size) const {
-  uint32_t *p;
-  int i;
+  uint32_t start = TransformProgramMemory::MakeResident(shader, shader_size);
 
-  p = pb_begin();
+  auto p = CommandRecorder::Begin();
 
   // Set run address of shader
-  p = pb_push1(p, NV097_SET_TRANSFORM_PROGRAM_START, 0);
+  p = pb_push1(p, NV097_SET_TRANSFORM_PROGRAM_START, start);
 
   p = pb_push1(
       p, NV097_SET_TRANSFORM_EXECUTION_MODE,
@@ -21,25 +23,16 @@ void VertexShaderProgram::LoadShaderProgram(const uint32_t *shader, uint32_t sha
           MASK(NV097_SET_TRANSFORM_EXECUTION_MODE_RANGE_MODE, NV097_SET_TRANSFORM_EXECUTION_MODE_RANGE_MODE_PRIV));
 
   p = pb_push1(p, NV097_SET_TRANSFORM_PROGRAM_CXT_WRITE_EN, 0);
-  pb_end(p);
-
-  // Set cursor and begin copying program
-  p = pb_begin();
-  p = pb_push1(p, NV097_SET_TRANSFORM_PROGRAM_LOAD, 0);
-  pb_end(p);
-
-  for (i = 0; i < shader_size / 16; i++) {
-    p = pb_begin();
-    pb_push(p++, NV097_SET_TRANSFORM_PROGRAM, 4);
-    memcpy(p, &shader[i * 4], 4 * 4);
-    p += 4;
-    pb_end(p);
-  }
+  CommandRecorder::End(p);
 }
 
 void VertexShaderProgram::Activate() {
   OnActivate();
 
+  // Constant memory is shared with other programs and the fixed function pipeline, so everything must be resent.
+  num_uploaded_slots_ = 0;
+  uniform_upload_required_ = true;
+
   if (shader_override_) {
     LoadShaderProgram(shader_override_, shader_override_size_);
   } else {
@@ -50,7 +43,7 @@ void VertexShaderProgram::Activate() {
 void VertexShaderProgram::PrepareDraw() {
   OnLoadConstants();
 
-  if (base_transform_constants_.empty() || !uniform_upload_required_) {
+  if (!num_slots_ || !uniform_upload_required_) {
     return;
   }
 
@@ -60,13 +53,51 @@ void VertexShaderProgram::PrepareDraw() {
 void VertexShaderProgram::UploadConstants() {
   MergeUniforms();
 
-  auto p = pb_begin();
+  uint32_t slot = 0;
+  while (slot < num_slots_) {
+    if (!IsSlotModified(slot)) {
+      ClearDirty(slot++);
+      continue;
+    }
+
+    uint32_t run_start = slot;
+    while (slot < num_slots_ && slot - run_start < kMaxSlotsPerSubmit && IsSlotModified(slot)) {
+      ClearDirty(slot++);
+    }
+    UploadConstantRange(run_start, slot - run_start);
+  }
+
+  num_uploaded_slots_ = num_slots_;
+  uniform_upload_required_ = false;
+}
+
+bool VertexShaderProgram::IsSlotModified(uint32_t slot) const {
+  if (slot >= num_uploaded_slots_) {
+    return true;
+  }
+  if (!IsDirty(slot)) {
+    return false;
+  }
+
+  // Uniform overrides are reapplied over base constants on every merge, so a dirty slot may still hold the value that
+  // was last sent.
+  return memcmp(&base_transform_constants_[slot], &uploaded_constants_[slot], sizeof(TransformConstant)) != 0;
+}
 
-  /* Set shader constants cursor at C0 */
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_VP_UPLOAD_CONST_ID, 96 + uniform_start_offset_);
+void VertexShaderProgram::UploadConstantRange(uint32_t first_slot, uint32_t num_slots) {
+  // The offset may have changed since the constants were set.
+  ASSERT(first_slot + num_slots <= GetNumAddressableSlots() && "Transform constant out of range.");
 
-  uint32_t *uniforms = base_transform_constants_.data();
-  uint32_t values_remaining = base_transform_constants_.size();
+  auto p = CommandRecorder::Begin();
+
+  /* Set shader constants cursor at the first modified constant */
+  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_VP_UPLOAD_CONST_ID, 96 + uniform_start_offset_ + first_slot);
+
+  memcpy(&uploaded_constants_[first_slot], &base_transform_constants_[first_slot],
+         num_slots * sizeof(TransformConstant));
+
+  auto uniforms = reinterpret_cast<const uint32_t *>(&base_transform_constants_[first_slot]);
+  uint32_t values_remaining = num_slots * 4;
   while (values_remaining > 16) {
     pb_push(p++, NV20_TCL_PRIMITIVE_3D_VP_UPLOAD_CONST_X, 16);
     memcpy(p, uniforms, 16 * 4);
@@ -81,24 +112,24 @@ void VertexShaderProgram::UploadConstants() {
     p += values_remaining;
   }
 
-  pb_end(p);
-  uniform_upload_required_ = false;
+  CommandRecorder::End(p);
 }
 
 void VertexShaderProgram::SetTransformConstantBlock(uint32_t slot, const uint32_t *values, uint32_t num_slots) {
-  // Constants are always provided as int4 vectors.
-  uint32_t index = slot * 4;
-  uint32_t num_ints = num_slots * 4;
-  uint32_t required_size = index + num_ints;
-
-  if (base_transform_constants_.size() < required_size) {
-    base_transform_constants_.resize(required_size);
+  ASSERT(slot + num_slots <= GetNumAddressableSlots() && "Transform constant out of range.");
+  if (num_slots_ < slot + num_slots) {
+    num_slots_ = slot + num_slots;
   }
 
-  uint32_t *data = base_transform_constants_.data() + index;
-  memcpy(data, values, num_ints * sizeof(uint32_t));
-
-  uniform_upload_required_ = true;
+  // Constants are always provided as int4 vectors.
+  auto data = &base_transform_constants_[slot];
+  for (uint32_t i = 0; i < num_slots; ++i, ++slot, ++data, values += 4) {
+    if (memcmp(data, values, sizeof(*data)) != 0) {
+      memcpy(data, values, sizeof(*data));
+      SetDirty(slot);
+      uniform_upload_required_ = true;
+    }
+  }
 }
 
 void VertexShaderProgram::SetBaseUniform4x4F(uint32_t slot, const float *value) {
@@ -144,30 +175,53 @@ void VertexShaderProgram::SetUniformF(uint32_t slot, float x, float y, float z,
 }
 
 void VertexShaderProgram::SetUniformBlock(uint32_t slot, const uint32_t *values, uint32_t num_slots) {
-  for (auto i = 0; i < num_slots; ++i, ++slot) {
-    TransformConstant val = {*values++, *values++, *values++, *values++};
-    uniforms_[slot] = val;
+  ASSERT(slot + num_slots <= GetNumAddressableSlots() && "Uniform out of range.");
+  if (num_slots_ < slot + num_slots) {
+    num_slots_ = slot + num_slots;
   }
 
-  uint32_t index = slot * 4;
-  uint32_t num_ints = num_slots * 4;
-  uint32_t required_size = index + num_ints;
-
-  if (base_transform_constants_.size() < required_size) {
-    base_transform_constants_.resize(required_size);
+  memcpy(&uniforms_[slot], values, num_slots * sizeof(TransformConstant));
+  for (uint32_t i = 0; i < num_slots; ++i, ++slot) {
+    uniform_mask_[slot / 32] |= 1 << (slot % 32);
+    SetDirty(slot);
   }
 
   uniform_upload_required_ = true;
 }
 
+void VertexShaderProgram::DefineConstantSets(uint32_t selector_slot, uint32_t first_slot, uint32_t slots_per_set,
+                                             uint32_t num_sets) {
+  ASSERT(slots_per_set && num_sets && "Invalid constant set layout.");
+  ASSERT(first_slot + slots_per_set * num_sets <= GetNumAddressableSlots() && "Constant sets out of range.");
+  ASSERT((selector_slot < first_slot || selector_slot >= first_slot + slots_per_set * num_sets) &&
+         "Constant set selector overlaps the sets.");
+
+  constant_set_selector_slot_ = selector_slot;
+  constant_set_first_slot_ = first_slot;
+  constant_set_slots_ = slots_per_set;
+  num_constant_sets_ = num_sets;
+
+  SelectConstantSet(0);
+}
+
+void VertexShaderProgram::SetConstantSet(uint32_t set, const float *values) {
+  ASSERT(set < num_constant_sets_ && "Invalid constant set.");
+  SetUniformBlock(constant_set_first_slot_ + set * constant_set_slots_, reinterpret_cast<const uint32_t *>(values),
+                  constant_set_slots_);
+}
+
+void VertexShaderProgram::SelectConstantSet(uint32_t set) {
+  ASSERT(set < num_constant_sets_ && "Invalid constant set.");
+  SetUniformF(constant_set_selector_slot_, static_cast<float>(set * constant_set_slots_));
+}
+
 void VertexShaderProgram::MergeUniforms() {
-  for (auto item : uniforms_) {
-    uint32_t slot = item.first;
-
-    uint32_t index = slot * 4;
-    base_transform_constants_[index++] = item.second.x;
-    base_transform_constants_[index++] = item.second.y;
-    base_transform_constants_[index++] = item.second.z;
-    base_transform_constants_[index++] = item.second.w;
+  for (uint32_t word = 0; word < kMaskWords; ++word) {
+    uint32_t bits = uniform_mask_[word] & dirty_mask_[word];
+    while (bits) {
+      uint32_t slot = word * 32 + __builtin_ctz(bits);
+      bits &= bits - 1;
+      base_transform_constants_[slot] = uniforms_[slot];
+    }
   }
 }
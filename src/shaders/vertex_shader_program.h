@@ -2,8 +2,6 @@
 #define NXDK_PGRAPH_TESTS_VERTEX_SHADER_PROGRAM_H
 
 #include <cstdint>
-#include <map>
-#include <vector>
 
 class VertexShaderProgram {
  public:
@@ -27,6 +25,14 @@ class VertexShaderProgram {
   void SetUniformF(uint32_t slot, float x, float y = 0.0f, float z = 0.0f, float w = 0.0f);
   void SetUniformI(uint32_t slot, uint32_t x, uint32_t y = 0, uint32_t z = 0, uint32_t w = 0);
 
+  // Reserves `num_sets` consecutive blocks of `slots_per_set` uniforms starting at `first_slot`. Every set is uploaded
+  // once, after which selecting a set only writes its offset from `first_slot` into `selector_slot`.x. The shader is
+  // expected to load the selector into A0 and address the set relative to it (see VertexProgramAssembler::Arl).
+  void DefineConstantSets(uint32_t selector_slot, uint32_t first_slot, uint32_t slots_per_set, uint32_t num_sets);
+  // Sets the `slots_per_set` * 4 values of the given constant set.
+  void SetConstantSet(uint32_t set, const float *values);
+  void SelectConstantSet(uint32_t set);
+
  protected:
   virtual void OnActivate() {}
   virtual void OnLoadShader() {}
@@ -48,19 +54,59 @@ class VertexShaderProgram {
   void UploadConstants();
   void MergeUniforms();
 
+ private:
+  // Returns true if the given slot was modified since it was last uploaded.
+  bool IsSlotModified(uint32_t slot) const;
+  // Sends `num_slots` contiguous constants starting at `first_slot`.
+  void UploadConstantRange(uint32_t first_slot, uint32_t num_slots);
+
+  // Returns the number of slots that fit below the last transform constant register, as slot 0 is uploaded to register
+  // 96 + `uniform_start_offset_`.
+  inline uint32_t GetNumAddressableSlots() const {
+    return kNumConstantSlots - static_cast<uint32_t>(96 + uniform_start_offset_);
+  }
+
+  inline bool IsDirty(uint32_t slot) const { return dirty_mask_[slot / 32] & (1 << (slot % 32)); }
+  inline void SetDirty(uint32_t slot) { dirty_mask_[slot / 32] |= 1 << (slot % 32); }
+  inline void ClearDirty(uint32_t slot) { dirty_mask_[slot / 32] &= ~(1 << (slot % 32)); }
+
  protected:
+  // Number of transform constant registers exposed by the nv2a.
+  static constexpr uint32_t kNumConstantSlots = 192;
+  static constexpr uint32_t kMaskWords = kNumConstantSlots / 32;
+  // Maximum number of constant slots sent in a single pushbuffer submission.
+  static constexpr uint32_t kMaxSlotsPerSubmit = 24;
+
   const uint32_t *shader_override_{nullptr};
   uint32_t shader_override_size_{0};
 
   int32_t uniform_start_offset_{0};
-  // Transform program constants calculated by the shader C++ code.
-  std::vector<uint32_t> base_transform_constants_;
-  // Overrides for
+
   struct TransformConstant {
     uint32_t x, y, z, w;
   };
-  std::map<uint32_t, TransformConstant> uniforms_;
+
+  // Number of leading slots that have been written by either base constants or uniforms.
+  uint32_t num_slots_{0};
+  // Transform program constants calculated by the shader C++ code, with uniform overrides merged in.
+  TransformConstant base_transform_constants_[kNumConstantSlots]{};
+  // Overrides for base constants, valid for slots set in `uniform_mask_`.
+  TransformConstant uniforms_[kNumConstantSlots]{};
+  uint32_t uniform_mask_[kMaskWords]{};
   bool uniform_upload_required_{true};
+
+  // Slots that have been written since they were last uploaded.
+  uint32_t dirty_mask_[kMaskWords]{};
+  // The values most recently sent to the GPU.
+  TransformConstant uploaded_constants_[kNumConstantSlots]{};
+  // Number of leading slots in `uploaded_constants_` that are known to match the GPU, reset whenever the program is
+  // activated.
+  uint32_t num_uploaded_slots_{0};
+
+  uint32_t constant_set_selector_slot_{0};
+  uint32_t constant_set_first_slot_{0};
+  uint32_t constant_set_slots_{0};
+  uint32_t num_constant_sets_{0};
 };
 
 #endif  // NXDK_PGRAPH_TESTS_VERTEX_SHADER_PROGRAM_H
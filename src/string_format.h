@@ -0,0 +1,19 @@
+#ifndef NXDK_PGRAPH_TESTS_STRING_FORMAT_H
+#define NXDK_PGRAPH_TESTS_STRING_FORMAT_H
+
+#include <cstdio>
+#include <string>
+
+// Appends printf style formatted text to `output`.
+template <typename... VarArgs>
+inline void AppendFormatted(std::string &output, const char *fmt, VarArgs &&...args) {
+  int length = snprintf(nullptr, 0, fmt, args...);
+  if (length <= 0) {
+    return;
+  }
+  const auto start = output.size();
+  output.resize(start + length);
+  snprintf(&output[start], length + 1, fmt, args...);
+}
+
+#endif  // NXDK_PGRAPH_TESTS_STRING_FORMAT_H
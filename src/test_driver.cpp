@@ -4,10 +4,14 @@
 #include <pbkit/pbkit.h>
 #include <windows.h>
 
+#include "debug_output.h"
 #include "menu_item.h"
+#include "progress_journal.h"
+#include "results_manifest.h"
+#include "sdl_subsystems.h"
 
-TestDriver::TestDriver(TestHost &host, const std::vector<std::shared_ptr<TestSuite>> &test_suites,
-                       uint32_t framebuffer_width, uint32_t framebuffer_height)
+TestDriver::TestDriver(TestHost &host, TestSuiteRegistry &test_suites, uint32_t framebuffer_width,
+                       uint32_t framebuffer_height)
     : test_host_(host),
       test_suites_(test_suites),
       framebuffer_width_(framebuffer_width),
@@ -26,9 +30,25 @@ TestDriver::~TestDriver() {
 }
 
 void TestDriver::Run() {
+  if (skip_menu_) {
+    RunAllTestsNonInteractive();
+    return;
+  }
+
+  if (!SDLSubsystems::EnsureGameControllerSupport()) {
+    debugPrint("Failed to initialize SDL_GAMECONTROLLER.");
+    debugPrint("%s", SDL_GetError());
+    ShowDebugMessageAndExit();
+    return;
+  }
+
+  // The menu is only redrawn in response to input unless the active item is animating (e.g., the autorun countdown
+  // or a test rendering continuously), leaving the CPU and GPU idle while waiting on the user.
+  bool redraw_required = true;
   while (running_) {
     SDL_Event event;
-    while (SDL_PollEvent(&event)) {
+    bool has_event = (redraw_required || menu_->IsAnimating()) ? SDL_PollEvent(&event) : SDL_WaitEvent(&event);
+    while (has_event) {
       switch (event.type) {
         case SDL_CONTROLLERDEVICEADDED:
           OnControllerAdded(event.cdevice);
@@ -42,31 +62,104 @@ void TestDriver::Run() {
           // Fallthrough
         case SDL_CONTROLLERBUTTONUP:
           OnControllerButtonEvent(event.cbutton);
+          redraw_required = true;
           break;
 
         default:
           break;
       }
+      has_event = SDL_PollEvent(&event);
     }
 
-    if (!test_host_.GetSaveResults()) {
-      menu_->SetBackgroundColor(0xFF3E1E1E);
-    } else {
-      menu_->SetBackgroundColor(0xFF1E1E1E);
+    if (!running_) {
+      break;
     }
 
-    menu_->Draw();
+    uint32_t background_color = test_host_.GetSaveResults() ? 0xFF1E1E1E : 0xFF3E1E1E;
+    if (background_color != MenuItem::menu_background_color_) {
+      menu_->SetBackgroundColor(background_color);
+      redraw_required = true;
+    }
 
-    Sleep(10);
+    if (redraw_required || menu_->IsAnimating()) {
+      menu_->Draw();
+      redraw_required = false;
+    }
   }
 }
 
+void TestDriver::SetResultsManifestPath(std::string path) {
+  manifest_path_ = std::move(path);
+  // Hashes are only kept while requested, as every capture would otherwise accumulate an entry.
+  test_host_.SetRecordResults(!manifest_path_.empty());
+}
+
 void TestDriver::RunAllTestsNonInteractive() {
-  for (auto &suite : test_suites_) {
+  // Soak runs hash every frame, which must not include the text overlay as many suites print measured timings into it.
+  test_host_.SetHeadless(headless_ || soak_);
+  test_host_.SetPipelinedMode(pipelined_ && !soak_);
+
+  ProgressJournal journal;
+  const bool journaled = !journal_path_.empty() && !soak_;
+  const bool resuming = journaled && journal.Load(journal_path_);
+
+  ResultsManifest manifest;
+  ResultsManifest *manifest_ptr = manifest_path_.empty() ? nullptr : &manifest;
+  if (manifest_ptr && resuming) {
+    // Tests completed before the interruption are not run again, so their results come from the saved manifest.
+    manifest.Load(manifest_path_);
+  }
+
+  for (uint32_t i = 0; i < test_suites_.GetNumSuites(); ++i) {
+    auto suite = test_suites_.Get(i);
+    if (journaled) {
+      // The first suite relies on the initial hardware state, so it is always run in full when resuming to get the
+      // hardware back into a known state before any later suite continues.
+      suite->SetProgressJournal(&journal, resuming && !i);
+    }
+
+    suite->SetResultsManifest(manifest_ptr);
+
+    if (!suite->HasPendingTests()) {
+      suite->SetProgressJournal(nullptr);
+      test_suites_.Release(i);
+      continue;
+    }
+
     suite->Initialize();
-    suite->RunAll();
+    if (soak_) {
+      suite->RunAllSoak(soak_settings_);
+    } else if (sustained_benchmarks_ && suite->IsBenchmark()) {
+      suite->RunAllSustained(sustained_settings_);
+    } else {
+      suite->RunAll();
+    }
+    // The suite's last frame may still reference resources released by Deinitialize.
+    test_host_.RetirePendingFrame();
     suite->Deinitialize();
+    suite->SetProgressJournal(nullptr);
+    suite->SetResultsManifest(nullptr);
+    // Each suite is only needed for the duration of its run.
+    test_suites_.Release(i);
+
+    if (manifest_ptr && journaled) {
+      // Keeps the manifest in step with the journal so that a resumed run has every completed suite to merge into.
+      test_host_.WaitForPendingSaves();
+      if (!manifest.Save(manifest_path_, test_host_.GetCaptureQueue())) {
+        PrintMsg("Failed to save results manifest '%s'\n", manifest_path_.c_str());
+      }
+    }
+  }
+  test_host_.WaitForPendingSaves();
+
+  if (manifest_ptr && !manifest.Save(manifest_path_, test_host_.GetCaptureQueue())) {
+    PrintMsg("Failed to save results manifest '%s'\n", manifest_path_.c_str());
+  }
+  if (journaled) {
+    journal.Remove();
   }
+  test_host_.SetPipelinedMode(false);
+  test_host_.SetHeadless(false);
   running_ = false;
 }
 
@@ -6,9 +6,11 @@
 #include <cstdint>
 #include <list>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "test_host.h"
+#include "test_suite_registry.h"
 #include "tests/test_suite.h"
 
 constexpr uint32_t kMaxGamepads = 4;
@@ -17,13 +19,45 @@ struct MenuItem;
 
 class TestDriver {
  public:
-  TestDriver(TestHost &host, const std::vector<std::shared_ptr<TestSuite>> &test_suites, uint32_t framebuffer_width,
-             uint32_t framebuffer_height);
+  TestDriver(TestHost &host, TestSuiteRegistry &test_suites, uint32_t framebuffer_width, uint32_t framebuffer_height);
   ~TestDriver();
 
   void Run();
   void RunAllTestsNonInteractive();
 
+  // When enabled, non-interactive runs render headless (see TestHost::SetHeadless).
+  void SetHeadless(bool enable = true) { headless_ = enable; }
+
+  // When enabled, Run() skips the menu and its autorun countdown and immediately runs every test non-interactively.
+  // The game controller subsystem is never initialized.
+  void SetSkipMenu(bool enable = true) { skip_menu_ = enable; }
+
+  // When enabled, non-interactive runs overlap each test's setup with the previous test's rendering (see
+  // TestHost::SetPipelinedMode).
+  void SetPipelined(bool enable = true) { pipelined_ = enable; }
+
+  // Causes non-interactive runs to journal their progress to `path` and, if a journal left by an interrupted run is
+  // found there, to resume after the last completed test. The journal is removed once a run finishes.
+  void SetProgressJournalPath(std::string path) { journal_path_ = std::move(path); }
+
+  // Causes non-interactive runs to write a ResultsManifest describing every test run to `path`. Journaled runs rewrite
+  // it after each suite, and a resumed run merges its results into the manifest left by the interrupted one.
+  void SetResultsManifestPath(std::string path);
+
+  // Causes non-interactive runs to repeat the tests of benchmark suites (see TestSuite::RunAllSustained).
+  void SetSustainedBenchmarkMode(const TestSuite::SustainedRunSettings &settings) {
+    sustained_benchmarks_ = true;
+    sustained_settings_ = settings;
+  }
+
+  // Causes non-interactive runs to repeat the tests of every suite without reinitializing it (see
+  // TestSuite::RunAllSoak) rather than running them once. Progress is not journaled and pipelining is disabled so that
+  // each frame can be hashed as it completes. Soak runs are always headless, so hashes exclude the text overlay.
+  void SetSoakMode(const TestSuite::SoakRunSettings &settings) {
+    soak_ = true;
+    soak_settings_ = settings;
+  }
+
  private:
   void OnControllerAdded(const SDL_ControllerDeviceEvent &event);
   void OnControllerRemoved(const SDL_ControllerDeviceEvent &event);
@@ -47,8 +81,17 @@ class TestDriver {
   volatile bool running_{true};
   // Whether tests should render once and stop (true) or continually render frames (false).
   bool one_shot_tests_{true};
+  bool headless_{false};
+  bool skip_menu_{false};
+  bool pipelined_{false};
+  bool sustained_benchmarks_{false};
+  TestSuite::SustainedRunSettings sustained_settings_{};
+  bool soak_{false};
+  TestSuite::SoakRunSettings soak_settings_{};
+  std::string journal_path_;
+  std::string manifest_path_;
 
-  const std::vector<std::shared_ptr<TestSuite>> &test_suites_;
+  TestSuiteRegistry &test_suites_;
   SDL_GameController *gamepads_[kMaxGamepads]{nullptr};
 
   uint32_t framebuffer_width_;
@@ -0,0 +1,116 @@
+#include "test_filter.h"
+
+#include <cstdio>
+
+bool TestFilter::Load(const std::string &path) {
+  FILE *fp = fopen(path.c_str(), "r");
+  if (!fp) {
+    return false;
+  }
+
+  char line[512];
+  while (fgets(line, sizeof(line), fp)) {
+    std::string pattern = line;
+    while (!pattern.empty() && (pattern.back() == '\n' || pattern.back() == '\r' || pattern.back() == ' ')) {
+      pattern.pop_back();
+    }
+    if (pattern.empty() || pattern[0] == '#') {
+      continue;
+    }
+
+    if (pattern[0] == '-') {
+      AddExclude(pattern.substr(1));
+    } else if (pattern[0] == '+') {
+      AddInclude(pattern.substr(1));
+    } else {
+      AddInclude(pattern);
+    }
+  }
+
+  fclose(fp);
+  return true;
+}
+
+bool TestFilter::Matches(const std::string &suite_name, const std::string &test_name) const {
+  const std::string name = suite_name + "/" + test_name;
+
+  bool included = includes_.empty();
+  for (auto &pattern : includes_) {
+    if (GlobMatch(pattern.c_str(), name.c_str())) {
+      included = true;
+      break;
+    }
+  }
+  if (!included) {
+    return false;
+  }
+
+  for (auto &pattern : excludes_) {
+    if (GlobMatch(pattern.c_str(), name.c_str())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestFilter::MayMatchSuite(const std::string &suite_name) const {
+  if (includes_.empty()) {
+    return true;
+  }
+
+  const std::string prefix = suite_name + "/";
+  for (auto &pattern : includes_) {
+    if (GlobMatchPrefix(pattern.c_str(), prefix.c_str())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TestFilter::GlobMatchPrefix(const char *pattern, const char *text) {
+  // Once `text` has been consumed, the rest of the pattern can always be satisfied by a suitable suffix.
+  const char *star = nullptr;
+  const char *star_text = nullptr;
+
+  while (*text) {
+    if (*pattern == '*') {
+      star = pattern++;
+      star_text = text;
+    } else if (*pattern && (*pattern == '?' || *pattern == *text)) {
+      ++pattern;
+      ++text;
+    } else if (star) {
+      pattern = star + 1;
+      text = ++star_text;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestFilter::GlobMatch(const char *pattern, const char *text) {
+  // Iterative matcher that backtracks only to the most recent '*'.
+  const char *star = nullptr;
+  const char *star_text = nullptr;
+
+  while (*text) {
+    if (*pattern == '*') {
+      star = pattern++;
+      star_text = text;
+    } else if (*pattern == '?' || *pattern == *text) {
+      ++pattern;
+      ++text;
+    } else if (star) {
+      pattern = star + 1;
+      text = ++star_text;
+    } else {
+      return false;
+    }
+  }
+
+  while (*pattern == '*') {
+    ++pattern;
+  }
+  return !*pattern;
+}
@@ -0,0 +1,39 @@
+#ifndef NXDK_PGRAPH_TESTS_TEST_FILTER_H
+#define NXDK_PGRAPH_TESTS_TEST_FILTER_H
+
+#include <string>
+#include <vector>
+
+// Selects tests by their "Suite name/Test name" using include and exclude glob patterns, where '*' matches any run of
+// characters (including '/') and '?' matches any single character.
+//
+// A test is selected if it matches any include pattern (or there are no include patterns) and does not match any
+// exclude pattern.
+class TestFilter {
+ public:
+  // Loads patterns from a text file with one pattern per line. Lines starting with '-' are exclude patterns, an
+  // optional leading '+' marks an include pattern, and blank lines and lines starting with '#' are ignored. Returns
+  // false if the file could not be opened.
+  bool Load(const std::string &path);
+
+  void AddInclude(const std::string &pattern) { includes_.push_back(pattern); }
+  void AddExclude(const std::string &pattern) { excludes_.push_back(pattern); }
+
+  // Returns true if no patterns have been added, in which case every test is selected.
+  bool IsEmpty() const { return includes_.empty() && excludes_.empty(); }
+
+  bool Matches(const std::string &suite_name, const std::string &test_name) const;
+  // Returns false if no test in the named suite can be selected, allowing the suite to be skipped without building its
+  // test list. Exclude patterns are not considered.
+  bool MayMatchSuite(const std::string &suite_name) const;
+
+  static bool GlobMatch(const char *pattern, const char *text);
+  // Returns true if `pattern` matches some string that begins with `text`.
+  static bool GlobMatchPrefix(const char *pattern, const char *text);
+
+ private:
+  std::vector<std::string> includes_;
+  std::vector<std::string> excludes_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_TEST_FILTER_H
@@ -6,18 +6,26 @@
 // clang format on
 
 #include <SDL.h>
-#include <SDL_image.h>
 #include <strings.h>
 #include <windows.h>
 #include <xboxkrnl/xboxkrnl.h>
 
 #include <algorithm>
+#include <cstdio>
 #include <utility>
 
+#include "command_recorder.h"
+#include "contiguous_memory_pool.h"
 #include "debug_output.h"
+#include "hash_manifest.h"
+#include "math3d_sse.h"
+#include "memory_tracker.h"
 #include "nxdk_ext.h"
 #include "pbkit_ext.h"
+#include "pushbuffer_trace.h"
+#include "shaders/pixel_shader_program.h"
 #include "shaders/vertex_shader_program.h"
+#include "texture_mipmaps.h"
 #include "vertex_buffer.h"
 
 #define SET_MASK(mask, val) (((val) << (__builtin_ffs(mask) - 1)) & (mask))
@@ -26,6 +34,22 @@
 static void SetVertexAttribute(uint32_t index, uint32_t format, uint32_t size, uint32_t stride, const void *data);
 static void ClearVertexAttribute(uint32_t index);
 
+std::set<std::string> TestHost::created_folders_;
+uint32_t TestHost::gpu_timeout_count_ = 0;
+
+static constexpr uint32_t kClearedCombiners[8] = {0};
+
+// See pb_init in pbkit.c, where the channel contexts are set up.
+// SUBCH_3 == GR_CLASS_9F, which contains the IMAGE_BLIT commands.
+static constexpr uint32_t kImageBlitSubchannel = SUBCH_3;
+// SUBCH_4 == GR_CLASS_62, which contains the NV10 2D surface commands.
+static constexpr uint32_t kSurfaces2DSubchannel = SUBCH_4;
+
+// Async texture uploads are copied as rows of 32-bit texels. Both values satisfy the 64 byte pitch/offset alignment
+// required by the 2D surface object.
+static constexpr uint32_t kTextureCopyPitch = 4096;
+static constexpr uint32_t kTextureStagingAlignment = TextureHeap::kDefaultAlignment;
+
 TestHost::TestHost(uint32_t framebuffer_width, uint32_t framebuffer_height, uint32_t max_texture_width,
                    uint32_t max_texture_height, uint32_t max_texture_depth)
     : framebuffer_width_(framebuffer_width),
@@ -33,40 +57,54 @@ TestHost::TestHost(uint32_t framebuffer_width, uint32_t framebuffer_height, uint
       max_texture_width_(max_texture_width),
       max_texture_height_(max_texture_height),
       max_texture_depth_(max_texture_depth) {
-  // allocate texture memory buffer large enough for all types
+  // Allocate a texture heap with room for one maximally sized texture per stage, followed by the palettes.
   uint32_t stride = max_texture_width_ * 4;
   uint32_t texture_size = stride * max_texture_height * max_texture_depth;
 
-  static constexpr uint32_t kMaxPaletteSize = 256 * 4;
-  uint32_t palette_size = kMaxPaletteSize * 4;
+  uint32_t palette_size = kPaletteSlotSize * kPaletteSlotsPerStage * 4;
 
   static constexpr uint32_t kMaxTextures = 4;
-  uint32_t total_size = texture_size * kMaxTextures + palette_size;
+  uint32_t heap_size = texture_size * kMaxTextures;
+  uint32_t total_size = heap_size + palette_size;
 
   texture_memory_ = static_cast<uint8_t *>(
       MmAllocateContiguousMemoryEx(total_size, 0, MAXRAM, 0, PAGE_WRITECOMBINE | PAGE_READWRITE));
   ASSERT(texture_memory_ && "Failed to allocate texture memory.");
+  texture_memory_size_ = total_size;
+  MemoryTracker::RecordAllocation(MemoryTracker::CATEGORY_TEXTURE, texture_memory_size_);
+  texture_heap_.Reset(heap_size);
 
-  texture_palette_memory_ = texture_memory_ + texture_size;
+  texture_palette_memory_ = texture_memory_ + heap_size;
 
-  matrix_unit(fixed_function_model_view_matrix_);
-  matrix_unit(fixed_function_projection_matrix_);
+  matrix_unit_sse(fixed_function_model_view_matrix_);
+  matrix_unit_sse(fixed_function_projection_matrix_);
 
-  uint32_t texture_offset = 0;
-  uint32_t palette_offset = 0;
-  for (auto i = 0; i < 4; ++i, texture_offset += texture_size, palette_offset += kMaxPaletteSize) {
+  for (auto i = 0; i < 4; ++i) {
     texture_stage_[i].SetStage(i);
     texture_stage_[i].SetTextureDimensions(max_texture_width, max_texture_height);
     texture_stage_[i].SetImageDimensions(max_texture_width, max_texture_height);
-    texture_stage_[i].SetTextureOffset(texture_offset);
-    texture_stage_[i].SetPaletteOffset(palette_offset);
+    texture_stage_[i].SetPaletteOffset(GetPaletteSlotOffset(i, 0));
   }
 }
 
 TestHost::~TestHost() {
+  capture_queue_.Flush();
+  for (auto &entry : mipmap_chains_) {
+    for (auto surface : entry.second) {
+      SDL_FreeSurface(surface);
+    }
+  }
   vertex_buffer_.reset();
   if (texture_memory_) {
     MmFreeContiguousMemory(texture_memory_);
+    MemoryTracker::RecordRelease(MemoryTracker::CATEGORY_TEXTURE, texture_memory_size_);
+  }
+  if (texture_staging_memory_) {
+    MmFreeContiguousMemory(texture_staging_memory_);
+    MemoryTracker::RecordRelease(MemoryTracker::CATEGORY_TEXTURE_STAGING, texture_staging_size_);
+  }
+  for (auto &target : render_targets_) {
+    ContiguousMemoryPool::Release(target->memory, target->size, MemoryTracker::CATEGORY_RENDER_TARGET);
   }
   // texture_palette_memory_ is an offset into texture_memory_ and is intentionally not freed.
   texture_palette_memory_ = nullptr;
@@ -96,10 +134,13 @@ void TestHost::SetFillColorRegion(uint32_t argb, uint32_t left, uint32_t top, ui
 
 void TestHost::EraseText() { pb_erase_text_screen(); }
 
-void TestHost::Clear(uint32_t argb, uint32_t depth_value, uint8_t stencil_value) const {
-  SetupControl0();
-  SetFillColorRegion(argb);
-  SetDepthStencilRegion(depth_value, stencil_value);
+void TestHost::Clear(uint32_t argb, uint32_t depth_value, uint8_t stencil_value, uint32_t surfaces) const {
+  if (surfaces) {
+    GpuProfiler::ScopedRegion scope(gpu_profiler_, GpuProfiler::SCOPE_CLEAR);
+    SetupControl0();
+    clear_surface_region(surfaces, argb, depth_buffer_format_, depth_value, stencil_value, 0, 0, framebuffer_width_,
+                         framebuffer_height_);
+  }
   EraseText();
 }
 
@@ -118,32 +159,178 @@ void TestHost::SetSurfaceFormat(SurfaceColorFormat color_format, SurfaceZetaForm
     value |= SET_MASK(NV097_SET_SURFACE_FORMAT_HEIGHT, log_height);
   }
 
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_SURFACE_FORMAT, value);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_SURFACE_FORMAT, value);
   if (!swizzle) {
-    p = pb_push1(p, NV097_SET_SURFACE_CLIP_HORIZONTAL, (width << 16) + clip_x);
-    p = pb_push1(p, NV097_SET_SURFACE_CLIP_VERTICAL, (height << 16) + clip_y);
+    p = register_shadow_.Push(p, NV097_SET_SURFACE_CLIP_HORIZONTAL, (width << 16) + clip_x);
+    p = register_shadow_.Push(p, NV097_SET_SURFACE_CLIP_VERTICAL, (height << 16) + clip_y);
   }
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetDepthClip(float min, float max) const {
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.PushF(p, NV097_SET_CLIP_MIN, min);
+  p = register_shadow_.PushF(p, NV097_SET_CLIP_MAX, max);
+  CommandRecorder::End(p);
+}
+
+// Returns the address at which the next pushbuffer command will be written.
+static uint32_t *GetPushbufferPosition() {
   auto p = pb_begin();
-  p = pb_push1f(p, NV097_SET_CLIP_MIN, min);
-  p = pb_push1f(p, NV097_SET_CLIP_MAX, max);
   pb_end(p);
+  return p;
 }
 
-void TestHost::PrepareDraw(uint32_t argb, uint32_t depth_value, uint8_t stencil_value) {
-  pb_wait_for_vbl();
-  pb_reset();
+void TestHost::PrepareDraw(uint32_t argb, uint32_t depth_value, uint8_t stencil_value, uint32_t clear_surfaces) {
+  // The previous frame must be captured before its render target is cleared and the pushbuffer is reset.
+  frame_pipeline_.Retire();
+
+  uint64_t start = GetPerformanceCounter();
+  if (last_prepare_draw_end_) {
+    // Multiple draws in a single test, count the time since the last PrepareDraw as pushbuffer construction time.
+    start = AccumulateTiming(TIMING_BUILD_PUSHBUFFER, last_prepare_draw_end_);
+  }
 
+  // Tiles are drawn behind the earlier tiles of the same frame, which may still be rendering.
+  if (!tiled_frame_) {
+    if (throughput_mode_ || pipelined_mode_) {
+      WaitForGpuIdle();
+      start = AccumulateTiming(TIMING_GPU_WAIT, start);
+    } else {
+      pb_wait_for_vbl();
+      start = AccumulateTiming(TIMING_VBLANK_WAIT, start);
+    }
+    pb_reset();
+    if (trace_capture_enabled_) {
+      trace_start_ = GetPushbufferPosition();
+    }
+  }
+  gpu_profiler_.BeginScope(GpuProfiler::SCOPE_PREPARE_DRAW);
+
+  command_recorder_.Start();
   SetupTextureStages();
 
-  SetSurfaceFormat(SCF_A8R8G8B8, (SurfaceZetaFormat)depth_buffer_format_, framebuffer_width_, framebuffer_height_);
+  SetSurfaceFormat(SCF_A8R8G8B8, (SurfaceZetaFormat)depth_buffer_format_, framebuffer_width_, framebuffer_height_,
+                   false, 0, 0, anti_aliasing_);
+  if (aa_color_target_) {
+    BindAntiAliasedTargets();
+  }
 
   // Override the values set in pb_init. Unfortunately the default is not exposed and must be recreated here.
+  float max_depth = GetMaxDepthValue();
+  SetDepthClip(0.0f, max_depth);
+  if (tiled_frame_) {
+    BindTile();
+  }
+  // Clear pushes directly, bypassing the recorder.
+  command_recorder_.Stop();
+
+  Clear(argb, depth_value, stencil_value, clear_surfaces);
+
+  if (vertex_shader_program_) {
+    vertex_shader_program_->PrepareDraw();
+  }
+  gpu_profiler_.EndScope();
+  start = AccumulateTiming(TIMING_PREPARE_DRAW, start);
+
+  if (tiled_frame_) {
+    // Texture staging memory is recycled by EndTiledFrame once the GPU is idle.
+    last_prepare_draw_end_ = start;
+    return;
+  }
+
+  WaitForPushbufferDrained();
+  // Any previously queued async texture uploads have completed.
+  texture_staging_used_ = 0;
+  last_prepare_draw_end_ = AccumulateTiming(TIMING_GPU_WAIT, start);
+}
+
+bool TestHost::WaitForGpuIdle(uint32_t timeout_ms) {
+  CommandRecorder::FlushActive();
+
+  auto p = pb_begin();
+  p = pb_push1(p, NV097_NO_OPERATION, 0);
+  p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
+  pb_end(p);
+
+  return WaitForPushbufferDrained(timeout_ms);
+}
+
+bool TestHost::WaitForPushbufferDrained(uint32_t timeout_ms) {
+  return WaitWhileBusy([]() { return pb_busy() != 0; }, timeout_ms, "the pushbuffer to drain");
+}
+
+bool TestHost::WaitForFlip(uint32_t timeout_ms) {
+  return WaitWhileBusy([]() { return pb_finished() != 0; }, timeout_ms, "a buffer flip");
+}
+
+bool TestHost::WaitWhileBusy(bool (*busy)(), uint32_t timeout_ms, const char *operation) {
+  if (!busy()) {
+    return true;
+  }
+
+  // pbkit does not expose a waitable completion event, so the GPU is polled. Yielding between polls lets the I/O worker
+  // and any other ready thread run while the GPU renders.
+  static const uint64_t ticks_per_ms = GetPerformanceFrequency() / 1000;
+  const uint64_t timeout_ticks = ticks_per_ms * timeout_ms;
+  const uint64_t start = GetPerformanceCounter();
+  while (busy()) {
+    if (GetPerformanceCounter() - start >= timeout_ticks) {
+      ++gpu_timeout_count_;
+      PrintMsg("Timed out after %u ms waiting for %s\n", timeout_ms, operation);
+      return false;
+    }
+    NtYieldExecution();
+  }
+  return true;
+}
+
+void TestHost::PushStateCommands(const uint32_t *commands, uint32_t num_dwords) {
+  ASSERT(num_dwords <= CommandRecorder::kMaxDwordsPerSubmit && "Too many state commands for a single submission.");
+
+  // The shadow cannot be trusted for methods that are not normally written through it, so every register is pushed.
+  const bool force_writes = register_shadow_.GetForceWrites();
+  register_shadow_.SetForceWrites(true);
+
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.PushCommands(p, commands, num_dwords);
+  CommandRecorder::End(p);
+
+  register_shadow_.SetForceWrites(force_writes);
+}
+
+uint64_t TestHost::GetPerformanceCounter() { return KeQueryPerformanceCounter(); }
+
+uint64_t TestHost::GetPerformanceFrequency() { return KeQueryPerformanceFrequency(); }
+
+void TestHost::ResetTimings() {
+  timings_ = TestTimings{};
+  last_prepare_draw_end_ = 0;
+  gpu_profiler_.Reset();
+}
+
+void TestHost::SetPipelinedMode(bool enable) {
+  if (!enable) {
+    frame_pipeline_.Retire();
+  }
+  pipelined_mode_ = enable;
+}
+
+void TestHost::SetGpuProfilingEnabled(bool enable) {
+  if (enable) {
+    gpu_profiler_.Initialize(kGpuProfilerContextChannel);
+  }
+  gpu_profiler_.SetEnabled(enable);
+}
+
+uint64_t TestHost::AccumulateTiming(TimingPhase phase, uint64_t start) {
+  uint64_t now = GetPerformanceCounter();
+  timings_.ticks[phase] += now - start;
+  return now;
+}
 
+float TestHost::GetMaxDepthValue() const {
   float max_depth;
   if (depth_buffer_format_ == NV097_SET_SURFACE_FORMAT_ZETA_Z16) {
     if (depth_buffer_mode_float_) {
@@ -160,38 +347,49 @@ void TestHost::PrepareDraw(uint32_t argb, uint32_t depth_value, uint8_t stencil_
       max_depth = static_cast<float>(0x00FFFFFF);
     }
   }
+  return max_depth;
+}
 
-  SetDepthClip(0.0f, max_depth);
-
-  Clear(argb, depth_value, stencil_value);
-
-  if (vertex_shader_program_) {
-    vertex_shader_program_->PrepareDraw();
-  }
+void TestHost::SetVertexBufferAttributes(uint32_t enabled_fields, bool allow_uniform_elision) {
+  ASSERT(vertex_buffer_ && "Vertex buffer must be set before calling SetVertexBufferAttributes.");
+  // FIXME: Figure out what to do in cases where there are multiple stages with different swizzle flags.
+  // Is this supported by hardware?
+  Vertex *vptr = texture_stage_[0].IsSwizzled() ? vertex_buffer_->normalized_vertex_buffer_
+                                                : vertex_buffer_->GetLinearVertices();
 
-  while (pb_busy()) {
-    /* Wait for completion... */
+  const bool packed = vertex_buffer_->RequiresPacking();
+  if (packed && (!vertex_buffer_->IsCacheValid() || vertex_buffer_->packed_source_ != vptr ||
+                 vertex_buffer_->packed_fields_ != enabled_fields)) {
+    vertex_buffer_->Pack(vptr, enabled_fields);
+    vertex_buffer_->SetCacheValid(false);
   }
-}
 
-void TestHost::SetVertexBufferAttributes(uint32_t enabled_fields) {
-  ASSERT(vertex_buffer_ && "Vertex buffer must be set before calling SetVertexBufferAttributes.");
   if (!vertex_buffer_->IsCacheValid()) {
-    auto p = pb_begin();
+    auto p = CommandRecorder::Begin();
     p = pb_push1(p, NV097_BREAK_VERTEX_BUFFER_CACHE, 0);
-    pb_end(p);
+    CommandRecorder::End(p);
     vertex_buffer_->SetCacheValid();
   }
 
-  // FIXME: Figure out what to do in cases where there are multiple stages with different swizzle flags.
-  // Is this supported by hardware?
-  Vertex *vptr = texture_stage_[0].IsSwizzled() ? vertex_buffer_->normalized_vertex_buffer_
-                                                : vertex_buffer_->linear_vertex_buffer_;
+  // Every vertex reads the first element of a uniform attribute, so the GPU fetches a single value for the draw.
+  const uint32_t uniform_fields = allow_uniform_elision && elide_uniform_attributes_
+                                      ? vertex_buffer_->GetUniformFields(vptr, enabled_fields)
+                                      : 0;
 
-  auto set = [this, enabled_fields](VertexAttribute attribute, uint32_t attribute_index, uint32_t format, uint32_t size,
-                                    const void *data) {
+  auto set = [this, enabled_fields, packed, uniform_fields](VertexAttribute attribute, uint32_t attribute_index,
+                                                            uint32_t format, uint32_t size, const void *data) {
     if (enabled_fields & attribute) {
       uint32_t stride = sizeof(Vertex);
+      if (packed) {
+        const auto &packed_attribute = vertex_buffer_->packed_attributes_[attribute_index];
+        format = packed_attribute.type;
+        size = packed_attribute.count;
+        stride = packed_attribute.stride;
+        data = vertex_buffer_->packed_vertex_buffer_ + packed_attribute.offset;
+      }
+      if (uniform_fields & attribute) {
+        stride = 0;
+      }
       if (vertex_attribute_stride_override_[attribute_index] != kNoStrideOverride) {
         stride = vertex_attribute_stride_override_[attribute_index];
       }
@@ -238,47 +436,122 @@ void TestHost::SetVertexBufferAttributes(uint32_t enabled_fields) {
 }
 
 void TestHost::DrawArrays(uint32_t enabled_vertex_fields, DrawPrimitive primitive) {
+  GpuProfiler::ScopedRegion scope(gpu_profiler_, GpuProfiler::SCOPE_DRAW);
   if (vertex_shader_program_) {
     vertex_shader_program_->PrepareDraw();
   }
 
   ASSERT(vertex_buffer_ && "Vertex buffer must be set before calling DrawArrays.");
-  static constexpr int kVerticesPerPush = 120;
+  SetVertexBufferAttributes(enabled_vertex_fields, true);
 
-  SetVertexBufferAttributes(enabled_vertex_fields);
-  int num_vertices = static_cast<int>(vertex_buffer_->num_vertices_);
+  DrawRange range{0, vertex_buffer_->num_vertices_};
+  PushDrawArrays(&range, 1, primitive);
+}
+
+void TestHost::MultiDrawArrays(const std::vector<DrawRange> &ranges, uint32_t enabled_vertex_fields,
+                               DrawPrimitive primitive) {
+  GpuProfiler::ScopedRegion scope(gpu_profiler_, GpuProfiler::SCOPE_DRAW);
+  if (vertex_shader_program_) {
+    vertex_shader_program_->PrepareDraw();
+  }
 
-  int start = 0;
-  while (start < num_vertices) {
-    int count = std::min(num_vertices - start, kVerticesPerPush);
+  ASSERT(vertex_buffer_ && "Vertex buffer must be set before calling MultiDrawArrays.");
+  SetVertexBufferAttributes(enabled_vertex_fields, true);
 
-    auto p = pb_begin();
-    p = pb_push1(p, NV097_SET_BEGIN_END, primitive);
+  PushDrawArrays(ranges.data(), ranges.size(), primitive);
+}
 
-    p = pb_push1(p, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_DRAW_ARRAYS),
-                 MASK(NV097_DRAW_ARRAYS_COUNT, count - 1) | MASK(NV097_DRAW_ARRAYS_START_INDEX, start));
+void TestHost::PushDrawArrays(const DrawRange *ranges, uint32_t num_ranges, DrawPrimitive primitive) {
+  // NV097_DRAW_ARRAYS encodes (count - 1) in 8 bits.
+  static constexpr uint32_t kMaxVerticesPerBatch = 256;
+  // Begin (2 dwords) + DRAW_ARRAYS header + at least one batch + end (2 dwords).
+  static constexpr uint32_t kMinDwordsPerRange = 6;
+  static constexpr uint32_t kMaxDwords = CommandRecorder::kMaxDwordsPerSubmit;
 
-    p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_END);
+  auto p = CommandRecorder::Begin();
+  uint32_t *block_start = p;
+  auto start_new_block_if_needed = [&p, &block_start](uint32_t required_dwords) {
+    if (p - block_start + required_dwords > kMaxDwords) {
+      CommandRecorder::End(p);
+      p = CommandRecorder::Begin();
+      block_start = p;
+    }
+  };
 
-    pb_end(p);
+  for (auto range = ranges; range != ranges + num_ranges; ++range) {
+    if (!range->count) {
+      continue;
+    }
+
+    start_new_block_if_needed(kMinDwordsPerRange);
+    p = pb_push1(p, NV097_SET_BEGIN_END, primitive);
+
+    // Many batches are packed under a single NV097_DRAW_ARRAYS header, and a single begin/end may span several
+    // submissions so that large draws are not broken into separate primitives.
+    uint32_t start = range->start;
+    uint32_t remaining = range->count;
+    while (remaining) {
+      // Reserve room for the header and the trailing end command.
+      start_new_block_if_needed(4);
+      uint32_t available = kMaxDwords - (p - block_start) - 3;
+      uint32_t num_batches = std::min((remaining + kMaxVerticesPerBatch - 1) / kMaxVerticesPerBatch, available);
+
+      pb_push(p++, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_DRAW_ARRAYS), num_batches);
+      for (uint32_t i = 0; i < num_batches; ++i) {
+        uint32_t count = std::min(remaining, kMaxVerticesPerBatch);
+        *p++ = MASK(NV097_DRAW_ARRAYS_COUNT, count - 1) | MASK(NV097_DRAW_ARRAYS_START_INDEX, start);
+        start += count;
+        remaining -= count;
+      }
+    }
 
-    start += count;
+    p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_END);
   }
+
+  CommandRecorder::End(p);
 }
 
 void TestHost::Begin(DrawPrimitive primitive) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push1(p, NV097_SET_BEGIN_END, primitive);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::End() const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_END);
-  pb_end(p);
+  CommandRecorder::End(p);
+}
+
+// Returns the specialized emitter for commonly used field masks, or the generic runtime emitter for any other mask.
+template <template <uint32_t> class Emitter>
+static InlineVertexEmitter SelectEmitter(uint32_t enabled_vertex_fields) {
+  switch (enabled_vertex_fields) {
+    case TestHost::POSITION:
+      return Emitter<TestHost::POSITION>::Emit;
+    case TestHost::POSITION | TestHost::DIFFUSE:
+      return Emitter<TestHost::POSITION | TestHost::DIFFUSE>::Emit;
+    case TestHost::POSITION | TestHost::TEXCOORD0:
+      return Emitter<TestHost::POSITION | TestHost::TEXCOORD0>::Emit;
+    case TestHost::POSITION | TestHost::DIFFUSE | TestHost::TEXCOORD0:
+      return Emitter<TestHost::POSITION | TestHost::DIFFUSE | TestHost::TEXCOORD0>::Emit;
+    case TestHost::POSITION | TestHost::NORMAL | TestHost::DIFFUSE:
+      return Emitter<TestHost::POSITION | TestHost::NORMAL | TestHost::DIFFUSE>::Emit;
+    case TestHost::POSITION | TestHost::NORMAL | TestHost::DIFFUSE | TestHost::SPECULAR:
+      return Emitter<TestHost::POSITION | TestHost::NORMAL | TestHost::DIFFUSE | TestHost::SPECULAR>::Emit;
+    case TestHost::POSITION | TestHost::NORMAL | TestHost::TEXCOORD0:
+      return Emitter<TestHost::POSITION | TestHost::NORMAL | TestHost::TEXCOORD0>::Emit;
+    default:
+      return Emitter<kRuntimeVertexFields>::Emit;
+  }
 }
 
 void TestHost::DrawInlineBuffer(uint32_t enabled_vertex_fields, DrawPrimitive primitive) {
+  DrawInlineBuffer(enabled_vertex_fields, primitive, SelectEmitter<InlineBufferEmitter>(enabled_vertex_fields));
+}
+
+void TestHost::DrawInlineBuffer(uint32_t enabled_vertex_fields, DrawPrimitive primitive, InlineVertexEmitter emit) {
+  GpuProfiler::ScopedRegion scope(gpu_profiler_, GpuProfiler::SCOPE_DRAW);
   if (vertex_shader_program_) {
     vertex_shader_program_->PrepareDraw();
   }
@@ -286,414 +559,431 @@ void TestHost::DrawInlineBuffer(uint32_t enabled_vertex_fields, DrawPrimitive pr
   ASSERT(vertex_buffer_ && "Vertex buffer must be set before calling DrawInlineBuffer.");
   SetVertexBufferAttributes(enabled_vertex_fields);
 
-  Begin(primitive);
+  const bool position_is_4f = vertex_buffer_->position_count_ != 3;
 
-  auto vertex = vertex_buffer_->Lock();
-  for (auto i = 0; i < vertex_buffer_->GetNumVertices(); ++i, ++vertex) {
-    if (enabled_vertex_fields & WEIGHT) {
-      SetWeight(vertex->weight[0]);
-    }
-    if (enabled_vertex_fields & NORMAL) {
-      SetNormal(vertex->normal[0], vertex->normal[1], vertex->normal[2]);
-    }
-    if (enabled_vertex_fields & DIFFUSE) {
-      SetDiffuse(vertex->diffuse[0], vertex->diffuse[1], vertex->diffuse[2], vertex->diffuse[3]);
-    }
-    if (enabled_vertex_fields & SPECULAR) {
-      SetSpecular(vertex->specular[0], vertex->specular[1], vertex->specular[2], vertex->specular[3]);
-    }
-    if (enabled_vertex_fields & FOG_COORD) {
-      SetFogCoord(vertex->fog_coord);
-    }
-    if (enabled_vertex_fields & POINT_SIZE) {
-      SetPointSize(vertex->point_size);
-    }
-    if (enabled_vertex_fields & TEXCOORD0) {
-      SetTexCoord0(vertex->texcoord0[0], vertex->texcoord0[1]);
-    }
-    if (enabled_vertex_fields & TEXCOORD1) {
-      SetTexCoord1(vertex->texcoord1[0], vertex->texcoord1[1]);
-    }
-    if (enabled_vertex_fields & TEXCOORD2) {
-      SetTexCoord2(vertex->texcoord2[0], vertex->texcoord2[1]);
-    }
-    if (enabled_vertex_fields & TEXCOORD3) {
-      SetTexCoord3(vertex->texcoord3[0], vertex->texcoord3[1]);
+  // Each method is a 1 dword header followed by its parameters.
+  uint32_t dwords_per_vertex = 0;
+  auto add_method = [&dwords_per_vertex, enabled_vertex_fields](VertexAttribute attribute, uint32_t num_params) {
+    if (enabled_vertex_fields & attribute) {
+      dwords_per_vertex += 1 + num_params;
     }
+  };
+  add_method(WEIGHT, 1);
+  add_method(NORMAL, 3);
+  add_method(DIFFUSE, 4);
+  add_method(SPECULAR, 4);
+  add_method(FOG_COORD, 1);
+  add_method(POINT_SIZE, 1);
+  add_method(TEXCOORD0, 2);
+  add_method(TEXCOORD1, 2);
+  add_method(TEXCOORD2, 2);
+  add_method(TEXCOORD3, 2);
+  add_method(POSITION, position_is_4f ? 4 : 3);
+
+  // Batch as many vertices as possible into each submission, leaving room for the begin and end commands.
+  const uint32_t max_vertices_per_push =
+      dwords_per_vertex ? (CommandRecorder::kMaxDwordsPerSubmit - 4) / dwords_per_vertex : 0xFFFFFFFF;
+
+  const uint32_t num_vertices = vertex_buffer_->GetNumVertices();
+  const Vertex *vertex = vertex_buffer_->normalized_vertex_buffer_;
+
+  auto p = CommandRecorder::Begin();
+  p = pb_push1(p, NV097_SET_BEGIN_END, primitive);
 
-    // Setting the position locks in the previously set values and must be done last.
-    if (enabled_vertex_fields & POSITION) {
-      if (vertex_buffer_->position_count_ == 3) {
-        SetVertex(vertex->pos[0], vertex->pos[1], vertex->pos[2]);
-      } else {
-        SetVertex(vertex->pos[0], vertex->pos[1], vertex->pos[2], vertex->pos[3]);
-      }
+  for (uint32_t i = 0; i < num_vertices; i += max_vertices_per_push) {
+    if (i) {
+      CommandRecorder::End(p);
+      p = CommandRecorder::Begin();
     }
+    uint32_t count = std::min(max_vertices_per_push, num_vertices - i);
+    p = emit(p, vertex + i, count, enabled_vertex_fields, position_is_4f);
   }
-  vertex_buffer_->Unlock();
   vertex_buffer_->SetCacheValid();
 
-  End();
+  p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_END);
+  CommandRecorder::End(p);
 }
 
 void TestHost::DrawInlineArray(uint32_t enabled_vertex_fields, DrawPrimitive primitive) {
+  DrawInlineArray(enabled_vertex_fields, primitive, SelectEmitter<InlineArrayEmitter>(enabled_vertex_fields));
+}
+
+void TestHost::DrawInlineArray(uint32_t enabled_vertex_fields, DrawPrimitive primitive, InlineVertexEmitter emit) {
+  GpuProfiler::ScopedRegion scope(gpu_profiler_, GpuProfiler::SCOPE_DRAW);
   if (vertex_shader_program_) {
     vertex_shader_program_->PrepareDraw();
   }
 
   ASSERT(vertex_buffer_ && "Vertex buffer must be set before calling DrawInlineArray.");
-  static constexpr int kElementsPerPush = 64;
 
   SetVertexBufferAttributes(enabled_vertex_fields);
 
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_BEGIN_END, primitive);
+  const bool packed = vertex_buffer_->RequiresPacking();
+  const bool position_is_4f = vertex_buffer_->position_count_ != 3;
 
-  int num_pushed = 0;
-  auto vertex = vertex_buffer_->Lock();
-  for (auto i = 0; i < vertex_buffer_->GetNumVertices(); ++i, ++vertex) {
-    // Note: Ordering is important and must follow the NV2A_VERTEX_ATTR_POSITION, ... ordering.
-    if (enabled_vertex_fields & POSITION) {
-      auto vals = (uint32_t *)vertex->pos;
-      if (vertex_buffer_->position_count_ == 3) {
-        p = pb_push3(p, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_INLINE_ARRAY), vals[0], vals[1], vals[2]);
-        num_pushed += 3;
-      } else {
-        p = pb_push4(p, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_INLINE_ARRAY), vals[0], vals[1], vals[2], vals[3]);
-        num_pushed += 4;
+  uint32_t dwords_per_vertex = 0;
+  if (packed) {
+    for (uint32_t index = 0; index < VertexBuffer::kNumAttributes; ++index) {
+      if (enabled_vertex_fields & (1 << index)) {
+        dwords_per_vertex += vertex_buffer_->packed_attributes_[index].size / 4;
       }
     }
-    if (enabled_vertex_fields & WEIGHT) {
-      ASSERT(!"WEIGHT not supported");
-    }
-    if (enabled_vertex_fields & NORMAL) {
-      auto vals = (uint32_t *)vertex->normal;
-      p = pb_push3(p, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_INLINE_ARRAY), vals[0], vals[1], vals[2]);
-      num_pushed += 3;
-    }
-    if (enabled_vertex_fields & DIFFUSE) {
-      // TODO: Enable sending as a DWORD by changing the type and size sent via SetVertexBufferAttributes.
-      auto vals = (uint32_t *)vertex->diffuse;
-      p = pb_push4(p, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_INLINE_ARRAY), vals[0], vals[1], vals[2], vals[3]);
-      num_pushed += 4;
-    }
-    if (enabled_vertex_fields & SPECULAR) {
-      // TODO: Enable sending as a DWORD by changing the type and size sent via SetVertexBufferAttributes.
-      auto vals = (uint32_t *)vertex->specular;
-      p = pb_push4(p, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_INLINE_ARRAY), vals[0], vals[1], vals[2], vals[3]);
-      num_pushed += 4;
-    }
-    if (enabled_vertex_fields & FOG_COORD) {
-      ASSERT(!"FOG_COORD not supported");
-    }
-    if (enabled_vertex_fields & POINT_SIZE) {
-      ASSERT(!"POINT_SIZE not supported");
-    }
-    if (enabled_vertex_fields & BACK_DIFFUSE) {
-      ASSERT(!"BACK_DIFFUSE not supported");
-    }
-    if (enabled_vertex_fields & BACK_SPECULAR) {
-      ASSERT(!"BACK_SPECULAR not supported");
-    }
-    if (enabled_vertex_fields & TEXCOORD0) {
-      auto vals = (uint32_t *)vertex->texcoord0;
-      p = pb_push2(p, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_INLINE_ARRAY), vals[0], vals[1]);
-      num_pushed += 2;
-    }
-    if (enabled_vertex_fields & TEXCOORD1) {
-      auto vals = (uint32_t *)vertex->texcoord1;
-      p = pb_push2(p, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_INLINE_ARRAY), vals[0], vals[1]);
-      num_pushed += 2;
-    }
-    if (enabled_vertex_fields & TEXCOORD2) {
-      auto vals = (uint32_t *)vertex->texcoord2;
-      p = pb_push2(p, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_INLINE_ARRAY), vals[0], vals[1]);
-      num_pushed += 2;
+  } else {
+    ASSERT(!(enabled_vertex_fields & WEIGHT) && "WEIGHT not supported");
+    ASSERT(!(enabled_vertex_fields & FOG_COORD) && "FOG_COORD not supported");
+    ASSERT(!(enabled_vertex_fields & POINT_SIZE) && "POINT_SIZE not supported");
+    ASSERT(!(enabled_vertex_fields & BACK_DIFFUSE) && "BACK_DIFFUSE not supported");
+    ASSERT(!(enabled_vertex_fields & BACK_SPECULAR) && "BACK_SPECULAR not supported");
+
+    auto add = [&dwords_per_vertex, enabled_vertex_fields](VertexAttribute attribute, uint32_t num_params) {
+      if (enabled_vertex_fields & attribute) {
+        dwords_per_vertex += num_params;
+      }
+    };
+    add(POSITION, position_is_4f ? 4 : 3);
+    add(NORMAL, 3);
+    add(DIFFUSE, 4);
+    add(SPECULAR, 4);
+    add(TEXCOORD0, 2);
+    add(TEXCOORD1, 2);
+    add(TEXCOORD2, 2);
+    add(TEXCOORD3, 2);
+  }
+
+  const uint32_t num_vertices = vertex_buffer_->GetNumVertices();
+  const Vertex *vertex = vertex_buffer_->normalized_vertex_buffer_;
+
+  // Batch as many vertices as possible under each INLINE_ARRAY header, leaving room for the header and the begin and
+  // end commands.
+  const uint32_t max_vertices_per_push =
+      dwords_per_vertex ? (CommandRecorder::kMaxDwordsPerSubmit - 5) / dwords_per_vertex : num_vertices;
+
+  auto p = CommandRecorder::Begin();
+  p = pb_push1(p, NV097_SET_BEGIN_END, primitive);
+
+  for (uint32_t i = 0; dwords_per_vertex && i < num_vertices; i += max_vertices_per_push) {
+    if (i) {
+      CommandRecorder::End(p);
+      p = CommandRecorder::Begin();
     }
-    if (enabled_vertex_fields & TEXCOORD3) {
-      auto vals = (uint32_t *)vertex->texcoord3;
-      p = pb_push2(p, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_INLINE_ARRAY), vals[0], vals[1]);
-      num_pushed += 2;
+    uint32_t count = std::min(max_vertices_per_push, num_vertices - i);
+    pb_push(p++, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_INLINE_ARRAY), count * dwords_per_vertex);
+
+    if (!packed) {
+      p = emit(p, vertex + i, count, enabled_vertex_fields, position_is_4f);
+      continue;
     }
 
-    if (num_pushed > kElementsPerPush) {
-      pb_end(p);
-      p = pb_begin();
-      num_pushed = 0;
+    // Packed attributes are already in the format declared by SetVertexBufferAttributes, so they may be sent verbatim
+    // in NV2A_VERTEX_ATTR_* order.
+    for (uint32_t v = i; v < i + count; ++v) {
+      for (uint32_t index = 0; index < VertexBuffer::kNumAttributes; ++index) {
+        if (!(enabled_vertex_fields & (1 << index))) {
+          continue;
+        }
+        const auto &attribute = vertex_buffer_->packed_attributes_[index];
+        memcpy(p, vertex_buffer_->packed_vertex_buffer_ + attribute.offset + v * attribute.stride, attribute.size);
+        p += attribute.size / 4;
+      }
     }
   }
-  vertex_buffer_->Unlock();
   vertex_buffer_->SetCacheValid();
 
   p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_END);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::DrawInlineElements16(const std::vector<uint32_t> &indices, uint32_t enabled_vertex_fields,
                                     DrawPrimitive primitive) {
+  DrawInlineElements16(IndexBuffer(indices), enabled_vertex_fields, primitive);
+}
+
+void TestHost::DrawInlineElements16(const IndexBuffer &indices, uint32_t enabled_vertex_fields,
+                                    DrawPrimitive primitive) {
+  GpuProfiler::ScopedRegion scope(gpu_profiler_, GpuProfiler::SCOPE_DRAW);
   if (vertex_shader_program_) {
     vertex_shader_program_->PrepareDraw();
   }
 
   ASSERT(vertex_buffer_ && "Vertex buffer must be set before calling DrawInlineElements.");
-  static constexpr int kIndicesPerPush = 64;
+  static constexpr uint32_t kMaxDwords = CommandRecorder::kMaxDwordsPerSubmit;
 
-  SetVertexBufferAttributes(enabled_vertex_fields);
+  SetVertexBufferAttributes(enabled_vertex_fields, true);
 
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
+  uint32_t *block_start = p;
   p = pb_push1(p, NV097_SET_BEGIN_END, primitive);
 
-  ASSERT(indices.size() < 0x7FFFFFFF);
-  int indices_remaining = static_cast<int>(indices.size());
-  int num_pushed = 0;
-  const uint32_t *next_index = indices.data();
-  while (indices_remaining >= 2) {
-    if (num_pushed++ > kIndicesPerPush) {
-      pb_end(p);
-      p = pb_begin();
-      num_pushed = 0;
+  // The packed pairs are copied verbatim under as few NV097_ARRAY_ELEMENT16 headers as possible, leaving room in each
+  // submission for the trailing ARRAY_ELEMENT32 and end commands.
+  const uint32_t *next_pair = indices.GetPairs();
+  uint32_t pairs_remaining = indices.GetNumPairs();
+  while (pairs_remaining) {
+    // One dword for the ARRAY_ELEMENT16 header and four for the trailing commands.
+    const int32_t available = static_cast<int32_t>(kMaxDwords) - static_cast<int32_t>(p - block_start) - 5;
+    if (available <= 0) {
+      CommandRecorder::End(p);
+      p = CommandRecorder::Begin();
+      block_start = p;
+      continue;
     }
 
-    uint32_t index_pair = *next_index++ & 0xFFFF;
-    index_pair += *next_index++ << 16;
-
-    p = pb_push1(p, NV097_ARRAY_ELEMENT16, index_pair);
-
-    indices_remaining -= 2;
+    uint32_t count = std::min(pairs_remaining, static_cast<uint32_t>(available));
+    pb_push(p++, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_ARRAY_ELEMENT16), count);
+    memcpy(p, next_pair, count * sizeof(*p));
+    p += count;
+    next_pair += count;
+    pairs_remaining -= count;
   }
 
-  if (indices_remaining) {
-    p = pb_push1(p, NV097_ARRAY_ELEMENT32, *next_index);
+  if (indices.HasTrailingIndex()) {
+    p = pb_push1(p, NV097_ARRAY_ELEMENT32, indices.GetTrailingIndex());
   }
 
   p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_END);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::DrawInlineElements32(const std::vector<uint32_t> &indices, uint32_t enabled_vertex_fields,
                                     DrawPrimitive primitive) {
+  GpuProfiler::ScopedRegion scope(gpu_profiler_, GpuProfiler::SCOPE_DRAW);
   if (vertex_shader_program_) {
     vertex_shader_program_->PrepareDraw();
   }
 
   ASSERT(vertex_buffer_ && "Vertex buffer must be set before calling DrawInlineElementsForce32.");
-  static constexpr int kIndicesPerPush = 64;
+  static constexpr uint32_t kMaxDwords = CommandRecorder::kMaxDwordsPerSubmit;
 
-  SetVertexBufferAttributes(enabled_vertex_fields);
+  SetVertexBufferAttributes(enabled_vertex_fields, true);
 
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
+  uint32_t *block_start = p;
   p = pb_push1(p, NV097_SET_BEGIN_END, primitive);
 
-  int num_pushed = 0;
-  for (auto index : indices) {
-    if (num_pushed++ > kIndicesPerPush) {
-      pb_end(p);
-      p = pb_begin();
-      num_pushed = 0;
+  // As DrawInlineElements16, the indices are copied verbatim under as few NV097_ARRAY_ELEMENT32 headers as possible.
+  const uint32_t *next_index = indices.data();
+  uint32_t indices_remaining = indices.size();
+  while (indices_remaining) {
+    // One dword for the ARRAY_ELEMENT32 header and two for the end command.
+    const int32_t available = static_cast<int32_t>(kMaxDwords) - static_cast<int32_t>(p - block_start) - 3;
+    if (available <= 0) {
+      CommandRecorder::End(p);
+      p = CommandRecorder::Begin();
+      block_start = p;
+      continue;
     }
 
-    p = pb_push1(p, NV097_ARRAY_ELEMENT32, index);
+    uint32_t count = std::min(indices_remaining, static_cast<uint32_t>(available));
+    pb_push(p++, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_ARRAY_ELEMENT32), count);
+    memcpy(p, next_index, count * sizeof(*p));
+    p += count;
+    next_index += count;
+    indices_remaining -= count;
   }
 
   p = pb_push1(p, NV097_SET_BEGIN_END, NV097_SET_BEGIN_END_OP_END);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetVertex(float x, float y, float z) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push3f(p, NV097_SET_VERTEX3F, x, y, z);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetVertex(float x, float y, float z, float w) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push4f(p, NV097_SET_VERTEX4F, x, y, z, w);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetWeight(float w1, float w2, float w3, float w4) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push4f(p, NV097_SET_WEIGHT4F, w1, w2, w3, w4);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetWeight(float w) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push1f(p, NV097_SET_WEIGHT1F, w);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetNormal(float x, float y, float z) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push3(p, NV097_SET_NORMAL3F, *(uint32_t *)&x, *(uint32_t *)&y, *(uint32_t *)&z);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetNormal3S(int x, int y, int z) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   uint32_t xy = (x & 0xFFFF) | y << 16;
   uint32_t z0 = z & 0xFFFF;
   p = pb_push2(p, NV097_SET_NORMAL3S, xy, z0);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetDiffuse(float r, float g, float b, float a) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push4f(p, NV097_SET_DIFFUSE_COLOR4F, r, g, b, a);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetDiffuse(float r, float g, float b) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push3f(p, NV097_SET_DIFFUSE_COLOR3F, r, g, b);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetDiffuse(uint32_t color) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push1(p, NV097_SET_DIFFUSE_COLOR4I, color);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetSpecular(float r, float g, float b, float a) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push4f(p, NV097_SET_SPECULAR_COLOR4F, r, g, b, a);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetSpecular(float r, float g, float b) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push3f(p, NV097_SET_SPECULAR_COLOR3F, r, g, b);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetSpecular(uint32_t color) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push1(p, NV097_SET_SPECULAR_COLOR4I, color);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetFogCoord(float fc) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push1f(p, NV097_SET_FOG_COORD, fc);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetPointSize(float ps) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push1f(p, NV097_SET_POINT_SIZE, ps);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetTexCoord0(float u, float v) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push2(p, NV097_SET_TEXCOORD0_2F, *(uint32_t *)&u, *(uint32_t *)&v);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetTexCoord0S(int u, int v) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   uint32_t uv = (u & 0xFFFF) | (v << 16);
   p = pb_push1(p, NV097_SET_TEXCOORD0_2S, uv);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetTexCoord0(float s, float t, float p, float q) const {
-  auto pb = pb_begin();
+  auto pb = CommandRecorder::Begin();
   pb = pb_push4f(pb, NV097_SET_TEXCOORD0_4F, s, t, p, q);
-  pb_end(pb);
+  CommandRecorder::End(pb);
 }
 
 void TestHost::SetTexCoord0S(int s, int t, int p, int q) const {
-  auto pb = pb_begin();
+  auto pb = CommandRecorder::Begin();
   uint32_t st = (s & 0xFFFF) | (t << 16);
   uint32_t pq = (p & 0xFFFF) | (q << 16);
   pb = pb_push2(pb, NV097_SET_TEXCOORD0_4S, st, pq);
-  pb_end(pb);
+  CommandRecorder::End(pb);
 }
 
 void TestHost::SetTexCoord1(float u, float v) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push2(p, NV097_SET_TEXCOORD1_2F, *(uint32_t *)&u, *(uint32_t *)&v);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetTexCoord1S(int u, int v) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   uint32_t uv = (u & 0xFFFF) | (v << 16);
   p = pb_push1(p, NV097_SET_TEXCOORD1_2S, uv);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetTexCoord1(float s, float t, float p, float q) const {
-  auto pb = pb_begin();
+  auto pb = CommandRecorder::Begin();
   pb = pb_push4f(pb, NV097_SET_TEXCOORD1_4F, s, t, p, q);
-  pb_end(pb);
+  CommandRecorder::End(pb);
 }
 
 void TestHost::SetTexCoord1S(int s, int t, int p, int q) const {
-  auto pb = pb_begin();
+  auto pb = CommandRecorder::Begin();
   uint32_t st = (s & 0xFFFF) | (t << 16);
   uint32_t pq = (p & 0xFFFF) | (q << 16);
   pb = pb_push2(pb, NV097_SET_TEXCOORD1_4S, st, pq);
-  pb_end(pb);
+  CommandRecorder::End(pb);
 }
 
 void TestHost::SetTexCoord2(float u, float v) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push2f(p, NV097_SET_TEXCOORD2_2F, u, v);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetTexCoord2S(int u, int v) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   uint32_t uv = (u & 0xFFFF) | (v << 16);
   p = pb_push1(p, NV097_SET_TEXCOORD2_2S, uv);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetTexCoord2(float s, float t, float p, float q) const {
-  auto pb = pb_begin();
+  auto pb = CommandRecorder::Begin();
   pb = pb_push4f(pb, NV097_SET_TEXCOORD2_4F, s, t, p, q);
-  pb_end(pb);
+  CommandRecorder::End(pb);
 }
 
 void TestHost::SetTexCoord2S(int s, int t, int p, int q) const {
-  auto pb = pb_begin();
+  auto pb = CommandRecorder::Begin();
   uint32_t st = (s & 0xFFFF) | (t << 16);
   uint32_t pq = (p & 0xFFFF) | (q << 16);
   pb = pb_push2(pb, NV097_SET_TEXCOORD2_4S, st, pq);
-  pb_end(pb);
+  CommandRecorder::End(pb);
 }
 
 void TestHost::SetTexCoord3(float u, float v) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push2(p, NV097_SET_TEXCOORD3_2F, *(uint32_t *)&u, *(uint32_t *)&v);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetTexCoord3S(int u, int v) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   uint32_t uv = (u & 0xFFFF) | (v << 16);
   p = pb_push1(p, NV097_SET_TEXCOORD3_2S, uv);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetTexCoord3(float s, float t, float p, float q) const {
-  auto pb = pb_begin();
+  auto pb = CommandRecorder::Begin();
   pb = pb_push4f(pb, NV097_SET_TEXCOORD3_4F, s, t, p, q);
-  pb_end(pb);
+  CommandRecorder::End(pb);
 }
 
 void TestHost::SetTexCoord3S(int s, int t, int p, int q) const {
-  auto pb = pb_begin();
+  auto pb = CommandRecorder::Begin();
   uint32_t st = (s & 0xFFFF) | (t << 16);
   uint32_t pq = (p & 0xFFFF) | (q << 16);
   pb = pb_push2(pb, NV097_SET_TEXCOORD3_4S, st, pq);
-  pb_end(pb);
+  CommandRecorder::End(pb);
 }
 
 void TestHost::EnsureFolderExists(const std::string &folder_path) {
+  if (created_folders_.find(folder_path) != created_folders_.end()) {
+    return;
+  }
+
   if (folder_path.length() > MAX_FILE_PATH_SIZE) {
     ASSERT(!"Folder Path is too long.");
   }
@@ -716,16 +1006,19 @@ void TestHost::EnsureFolderExists(const std::string &folder_path) {
   if (!CreateDirectory(path_start, nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
     ASSERT(!"Failed to create output directory.");
   }
+
+  created_folders_.insert(folder_path);
 }
 
 // Returns the full output filepath including the filename
 // Creates output directory if it does not exist
-std::string TestHost::PrepareSaveFilePNG(std::string output_directory, const std::string &filename) {
+std::string TestHost::PrepareSaveFile(std::string output_directory, const std::string &filename,
+                                      const char *extension) {
   EnsureFolderExists(output_directory);
 
   output_directory += "\\";
   output_directory += filename;
-  output_directory += ".png";
+  output_directory += extension;
 
   if (output_directory.length() > MAX_FILE_PATH_SIZE) {
     ASSERT(!"Full save file path is too long.");
@@ -734,48 +1027,55 @@ std::string TestHost::PrepareSaveFilePNG(std::string output_directory, const std
   return output_directory;
 }
 
+void TestHost::RecordQueuedResultFiles(const std::string &output_directory, const std::string &name,
+                                       const std::string &z_buffer_name) {
+  const char *extension = CaptureQueue::GetFileExtension(save_format_);
+  queued_result_files_.push_back(output_directory + "\\" + name + extension);
+  if (z_buffer_name.empty()) {
+    return;
+  }
+  queued_result_files_.push_back(output_directory + "\\" + z_buffer_name + extension);
+  if (depth_buffer_format_ == NV097_SET_SURFACE_FORMAT_ZETA_Z24S8) {
+    queued_result_files_.push_back(output_directory + "\\" + z_buffer_name + "_S" + extension);
+  }
+}
+
 void TestHost::SaveBackBuffer(const std::string &output_directory, const std::string &name) {
-  auto target_file = PrepareSaveFilePNG(output_directory, name);
+  auto target_file = PrepareSaveFile(output_directory, name, CaptureQueue::GetFileExtension(save_format_));
 
   auto buffer = pb_agp_access(pb_back_buffer());
   auto width = static_cast<int>(pb_back_buffer_width());
   auto height = static_cast<int>(pb_back_buffer_height());
   auto pitch = static_cast<int>(pb_back_buffer_pitch());
 
-  SDL_Surface *surface =
-      SDL_CreateRGBSurfaceWithFormatFrom((void *)buffer, width, height, 32, pitch, SDL_PIXELFORMAT_ARGB8888);
-  if (IMG_SavePNG(surface, target_file.c_str())) {
-    PrintMsg("Failed to save PNG file '%s'\n", target_file.c_str());
-    ASSERT(!"Failed to save PNG file.");
-  }
-
-  SDL_FreeSurface(surface);
+  capture_queue_.Enqueue(target_file, save_format_, buffer, width, height, 32, pitch, SDL_PIXELFORMAT_ARGB8888);
 }
 
-void TestHost::SaveZBuffer(const std::string &output_directory, const std::string &name) const {
-  auto target_file = PrepareSaveFilePNG(output_directory, name);
-
-  auto buffer = pb_agp_access(pb_depth_stencil_buffer());
-  auto size = pb_depth_stencil_size();
+void TestHost::SaveZBuffer(const std::string &output_directory, const std::string &name) {
+  const char *extension = CaptureQueue::GetFileExtension(save_format_);
+  auto target_file = PrepareSaveFile(output_directory, name, extension);
+  auto stencil_target_file = PrepareSaveFile(output_directory, name + "_S", extension);
 
-  PrintMsg("Saving z-buffer to %s. Size: %lu. Pitch %lu.\n", target_file.c_str(), size, pb_depth_stencil_pitch());
-
-  // The Z buffer set up by pbkit uses a 32bpp pitch regardless of the actual format being used by the HW.
-  int pitch = static_cast<int>(pb_depth_stencil_pitch());
-  int depth = depth_buffer_format_ == NV097_SET_SURFACE_FORMAT_ZETA_Z16 ? 16 : 32;
-  int format =
-      depth_buffer_format_ == NV097_SET_SURFACE_FORMAT_ZETA_Z16 ? SDL_PIXELFORMAT_RGB565 : SDL_PIXELFORMAT_ARGB8888;
-
-  SDL_Surface *surface =
-      SDL_CreateRGBSurfaceWithFormatFrom((void *)buffer, static_cast<int>(framebuffer_width_),
-                                         static_cast<int>(framebuffer_height_), depth, pitch, format);
-
-  if (IMG_SavePNG(surface, target_file.c_str())) {
-    PrintMsg("Failed to save PNG file '%s'\n", target_file.c_str());
-    ASSERT(!"Failed to save PNG file.");
+  void *buffer;
+  int width = static_cast<int>(framebuffer_width_);
+  int height = static_cast<int>(framebuffer_height_);
+  int pitch;
+  if (aa_zeta_target_) {
+    // Every sample is saved rather than attempting to resolve depth values.
+    buffer = aa_zeta_target_->memory;
+    width = static_cast<int>(aa_zeta_target_->width);
+    height = static_cast<int>(aa_zeta_target_->height);
+    pitch = static_cast<int>(aa_zeta_target_->pitch);
+  } else {
+    buffer = pb_agp_access(pb_depth_stencil_buffer());
+    // The Z buffer set up by pbkit uses a 32bpp pitch regardless of the actual format being used by the HW.
+    pitch = static_cast<int>(pb_depth_stencil_pitch());
   }
 
-  SDL_FreeSurface(surface);
+  PrintMsg("Saving z-buffer to %s. Size: %dx%d. Pitch %d.\n", target_file.c_str(), width, height, pitch);
+
+  capture_queue_.EnqueueDepthStencil(target_file, stencil_target_file, save_format_, buffer, width, height, pitch,
+                                     depth_buffer_format_, depth_buffer_mode_float_, GetMaxDepthValue());
 }
 
 void TestHost::SetupControl0() const {
@@ -790,9 +1090,9 @@ void TestHost::SetupControl0() const {
   if (requires_colorspace_conversion) {
     control0 |= MASK(NV097_SET_CONTROL0_COLOR_SPACE_CONVERT, NV097_SET_CONTROL0_COLOR_SPACE_CONVERT_CRYCB_TO_RGB);
   }
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_CONTROL0, control0);
-  pb_end(p);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_CONTROL0, control0);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetupTextureStages() const {
@@ -800,7 +1100,7 @@ void TestHost::SetupTextureStages() const {
   auto texture_dma_offset = reinterpret_cast<uint32_t>(texture_memory_);
   auto palette_dma_offset = reinterpret_cast<uint32_t>(texture_palette_memory_);
   for (auto &stage : texture_stage_) {
-    stage.Commit(texture_dma_offset, palette_dma_offset);
+    stage.Commit(texture_dma_offset, palette_dma_offset, register_shadow_);
   }
 }
 
@@ -812,6 +1112,11 @@ void TestHost::SetDefaultTextureParams(uint32_t stage) {
 }
 
 void TestHost::SetDepthBufferFormat(uint32_t fmt) {
+  if (fmt == depth_buffer_format_) {
+    return;
+  }
+  // A pending frame's depth capture is decoded and labelled using the format it was drawn with.
+  frame_pipeline_.Retire();
   depth_buffer_format_ = fmt;
 
   switch (fixed_function_matrix_mode_) {
@@ -828,77 +1133,983 @@ void TestHost::SetDepthBufferFormat(uint32_t fmt) {
   }
 }
 
-void TestHost::SetDepthBufferFloatMode(bool enabled) { depth_buffer_mode_float_ = enabled; }
+void TestHost::SetDepthBufferFloatMode(bool enabled) {
+  if (enabled == depth_buffer_mode_float_) {
+    return;
+  }
+  // See SetDepthBufferFormat.
+  frame_pipeline_.Retire();
+  depth_buffer_mode_float_ = enabled;
+}
 
-int TestHost::SetTexture(SDL_Surface *surface, uint32_t stage) {
-  return texture_stage_[stage].SetTexture(surface, texture_memory_);
+TextureHeap::Handle TestHost::AllocateTextureMemory(uint32_t size) {
+  TextureHeap::Handle handle = texture_heap_.Allocate(size);
+  ASSERT(handle != TextureHeap::kInvalidHandle && "Texture heap exhausted.");
+  return handle;
 }
 
-int TestHost::SetVolumetricTexture(const SDL_Surface **surface, uint32_t depth, uint32_t stage) {
-  return texture_stage_[stage].SetVolumetricTexture(surface, depth, texture_memory_);
+void TestHost::FreeTextureMemory(TextureHeap::Handle handle) {
+  for (auto i = 0; i < 4; ++i) {
+    ASSERT(bound_texture_memory_[i] != handle && "Texture memory freed while bound to a stage.");
+  }
+  resident_textures_.erase(handle);
+  texture_heap_.Free(handle);
 }
 
-int TestHost::SetRawTexture(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint32_t pitch,
-                            uint32_t bytes_per_pixel, bool swizzle, uint32_t stage) {
-  const uint32_t max_stride = max_texture_width_ * 4;
-  const uint32_t max_texture_size = max_stride * max_texture_height_ * max_texture_depth_;
+void TestHost::BindTextureMemory(uint32_t stage, TextureHeap::Handle handle) {
+  bound_texture_memory_[stage] = handle;
+  if (handle == TextureHeap::kInvalidHandle) {
+    handle = stage_texture_memory_[stage];
+  }
+  texture_stage_[stage].SetTextureOffset(handle == TextureHeap::kInvalidHandle ? 0 : texture_heap_.GetOffset(handle));
+}
 
-  const uint32_t layer_size = pitch * height;
-  const uint32_t surface_size = layer_size * depth;
-  ASSERT(surface_size < max_texture_size && "Texture too large.");
+TextureHeap::Handle TestHost::PrepareTextureMemory(uint32_t stage, uint32_t size) {
+  TextureHeap::Handle handle = bound_texture_memory_[stage];
+  if (handle != TextureHeap::kInvalidHandle) {
+    ASSERT(size <= texture_heap_.GetSize(handle) && "Texture too large for bound texture memory.");
+    // The stage may have been pointed at a render target.
+    texture_stage_[stage].SetTextureOffset(texture_heap_.GetOffset(handle));
+    return handle;
+  }
 
-  return texture_stage_[stage].SetRawTexture(source, width, height, depth, pitch, bytes_per_pixel, swizzle,
-                                             texture_memory_);
+  handle = stage_texture_memory_[stage];
+  if (handle == TextureHeap::kInvalidHandle || texture_heap_.GetSize(handle) < size) {
+    if (handle != TextureHeap::kInvalidHandle) {
+      FreeTextureMemory(handle);
+    }
+    handle = AllocateTextureMemory(size);
+    stage_texture_memory_[stage] = handle;
+  }
+  texture_stage_[stage].SetTextureOffset(texture_heap_.GetOffset(handle));
+  return handle;
 }
 
-int TestHost::SetPalette(const uint32_t *palette, PaletteSize size, uint32_t stage) {
-  return texture_stage_[stage].SetPalette(palette, size, texture_palette_memory_);
+bool TestHost::IsTextureResident(TextureHeap::Handle handle, const ResidentTexture &key) const {
+  auto it = resident_textures_.find(handle);
+  return it != resident_textures_.end() && it->second == key;
 }
 
-void TestHost::FinishDraw(bool allow_saving, const std::string &output_directory, const std::string &name,
-                          const std::string &z_buffer_name) {
-  bool perform_save = allow_saving && save_results_;
-  if (!perform_save) {
-    pb_printat(0, 55, (char *)"ns");
-    pb_draw_text_screen();
-  }
+TestHost::ResidentTexture TestHost::MakeSurfaceKey(const SDL_Surface *surface, const TextureStage &texture_stage) {
+  ResidentTexture key;
+  key.content_hash = HashSurface(static_cast<const uint8_t *>(surface->pixels), surface->w, surface->h, surface->pitch,
+                                 surface->format->BytesPerPixel);
+  key.xbox_format = texture_stage.format_.xbox_format;
+  key.swizzle = texture_stage.IsSwizzled();
+  key.width = surface->w;
+  key.height = surface->h;
+  key.depth = 1;
+  key.pitch = surface->pitch;
+  key.bytes_per_pixel = surface->format->BytesPerPixel;
+  key.compression_quality = texture_stage.GetCompressionQuality();
+  return key;
+}
 
-  while (pb_busy()) {
-    /* Wait for completion... */
+int TestHost::SetTexture(SDL_Surface *surface, uint32_t stage) {
+  if (pipelined_mode_) {
+    // Converting into staging memory avoids waiting for the previous frame to stop sampling the texture memory.
+    return SetTextureAsync(surface, stage);
   }
 
-  if (perform_save) {
-    // TODO: See why waiting for tiles to be non-busy results in the screen not updating anymore.
-    // In theory this should wait for all tiles to be rendered before capturing.
-    pb_wait_for_vbl();
-
-    SaveBackBuffer(output_directory, name);
+  const TextureStage &texture_stage = texture_stage_[stage];
+  ResidentTexture key = MakeSurfaceKey(surface, texture_stage);
 
-    if (!z_buffer_name.empty()) {
-      SaveZBuffer(output_directory, z_buffer_name);
-    }
+  // Converted rows are padded to a multiple of 4 bytes.
+  const uint32_t converted_pitch = (surface->w * texture_stage.format_.xbox_bpp + 3) & ~3;
+  TextureHeap::Handle handle = PrepareTextureMemory(stage, converted_pitch * surface->h);
+  texture_stage_[stage].SetMipMapLevels(1);
+  if (IsTextureResident(handle, key)) {
+    return 0;
   }
 
-  /* Swap buffers (if we can) */
-  while (pb_finished()) {
-    /* Not ready to swap yet */
+  resident_textures_.erase(handle);
+  frame_pipeline_.Retire();
+  int ret = texture_stage.SetTexture(surface, texture_memory_);
+  if (!ret) {
+    resident_textures_[handle] = key;
   }
+  return ret;
 }
 
-void TestHost::SetVertexShaderProgram(std::shared_ptr<VertexShaderProgram> program) {
+int TestHost::SetTextureAsync(SDL_Surface *surface, uint32_t stage) {
+  TextureStage &texture_stage = texture_stage_[stage];
+  ResidentTexture key = MakeSurfaceKey(surface, texture_stage);
+
+  const uint32_t converted_pitch = (surface->w * texture_stage.format_.xbox_bpp + 3) & ~3;
+  const uint32_t size = converted_pitch * surface->h;
+  TextureHeap::Handle handle = PrepareTextureMemory(stage, size);
+  texture_stage.SetMipMapLevels(1);
+  if (IsTextureResident(handle, key)) {
+    return 0;
+  }
+
+  resident_textures_.erase(handle);
+  uint8_t *staging = ReserveTextureStaging(size);
+  int ret = texture_stage.UploadSurface(surface, staging);
+  if (ret) {
+    return ret;
+  }
+
+  QueueTextureCopy(staging, handle, size);
+  resident_textures_[handle] = key;
+  return 0;
+}
+
+int TestHost::SetVolumetricTexture(const SDL_Surface **surface, uint32_t depth, uint32_t stage) {
+  const TextureStage &texture_stage = texture_stage_[stage];
+  ResidentTexture key;
+  for (auto i = 0; i < depth; ++i) {
+    const SDL_Surface *layer = surface[i];
+    uint32_t layer_hash = HashSurface(static_cast<const uint8_t *>(layer->pixels), layer->w, layer->h, layer->pitch,
+                                      layer->format->BytesPerPixel);
+    key.content_hash = XXH32(&layer_hash, sizeof(layer_hash), key.content_hash);
+  }
+  key.xbox_format = texture_stage.format_.xbox_format;
+  key.swizzle = texture_stage.IsSwizzled();
+  key.width = surface[0]->w;
+  key.height = surface[0]->h;
+  key.depth = depth;
+  key.pitch = surface[0]->pitch;
+  key.bytes_per_pixel = surface[0]->format->BytesPerPixel;
+
+  const uint32_t converted_pitch = (surface[0]->w * texture_stage.format_.xbox_bpp + 3) & ~3;
+  TextureHeap::Handle handle = PrepareTextureMemory(stage, converted_pitch * surface[0]->h * depth);
+  texture_stage_[stage].SetMipMapLevels(1);
+  if (IsTextureResident(handle, key)) {
+    return 0;
+  }
+
+  resident_textures_.erase(handle);
+  frame_pipeline_.Retire();
+  int ret = texture_stage.SetVolumetricTexture(surface, depth, texture_memory_);
+  if (!ret) {
+    resident_textures_[handle] = key;
+  }
+  return ret;
+}
+
+int TestHost::SetVolumetricTexture(uint32_t width, uint32_t height, uint32_t depth,
+                                   const TextureStage::VolumeLayerGenerator &generate_layer, uint32_t stage) {
+  const TextureStage &texture_stage = texture_stage_[stage];
+  const uint32_t converted_pitch = (width * texture_stage.format_.xbox_bpp + 3) & ~3;
+  TextureHeap::Handle handle = PrepareTextureMemory(stage, converted_pitch * height * depth);
+  texture_stage_[stage].SetMipMapLevels(1);
+
+  resident_textures_.erase(handle);
+  frame_pipeline_.Retire();
+
+  // The key is built exactly as the array variant builds it, hashing each layer as it passes through.
+  ResidentTexture key;
+  key.xbox_format = texture_stage.format_.xbox_format;
+  key.swizzle = texture_stage.IsSwizzled();
+  key.width = width;
+  key.height = height;
+  key.depth = depth;
+  auto hash_layer = [&generate_layer, &key](uint32_t index) -> SDL_Surface * {
+    SDL_Surface *layer = generate_layer(index);
+    if (layer) {
+      uint32_t layer_hash = HashSurface(static_cast<const uint8_t *>(layer->pixels), layer->w, layer->h, layer->pitch,
+                                        layer->format->BytesPerPixel);
+      key.content_hash = XXH32(&layer_hash, sizeof(layer_hash), key.content_hash);
+      key.pitch = layer->pitch;
+      key.bytes_per_pixel = layer->format->BytesPerPixel;
+    }
+    return layer;
+  };
+
+  int ret = texture_stage.SetVolumetricTexture(width, height, depth, hash_layer, texture_memory_);
+  if (!ret) {
+    resident_textures_[handle] = key;
+  }
+  return ret;
+}
+
+int TestHost::SetMipMappedTexture(SDL_Surface *surface, uint32_t levels, bool gamma_correct, uint32_t stage) {
+  TextureStage &texture_stage = texture_stage_[stage];
+  ASSERT(texture_stage.IsSwizzled() && "Mipmapped textures using linear formats are not supported by XBOX.");
+
+  const uint32_t full_levels = GetFullMipMapLevels(surface->w, surface->h);
+  if (!levels || levels > full_levels) {
+    levels = full_levels;
+  }
+
+  ResidentTexture key;
+  key.content_hash = HashSurface(static_cast<const uint8_t *>(surface->pixels), surface->w, surface->h, surface->pitch,
+                                 surface->format->BytesPerPixel);
+  key.xbox_format = texture_stage.format_.xbox_format;
+  key.swizzle = true;
+  key.width = surface->w;
+  key.height = surface->h;
+  key.depth = 1;
+  key.pitch = surface->pitch;
+  key.bytes_per_pixel = surface->format->BytesPerPixel;
+  key.mipmap_levels = levels;
+  key.gamma_correct_mipmaps = gamma_correct;
+  key.compression_quality = texture_stage.GetCompressionQuality();
+
+  uint32_t chain_size = 0;
+  for (uint32_t i = 0, width = surface->w, height = surface->h; i < levels; ++i) {
+    chain_size += texture_stage.GetImageSize(width, height);
+    width = width > 1 ? width >> 1 : 1;
+    height = height > 1 ? height >> 1 : 1;
+  }
+
+  TextureHeap::Handle handle = PrepareTextureMemory(stage, chain_size);
+  texture_stage.SetMipMapLevels(levels);
+  if (IsTextureResident(handle, key)) {
+    return 0;
+  }
+
+  MipMapChainKey chain_key{key.content_hash, key.width, key.height, levels, gamma_correct};
+  auto chain = mipmap_chains_.find(chain_key);
+  if (chain == mipmap_chains_.end()) {
+    std::vector<SDL_Surface *> surfaces;
+    if (!GenerateMipMapChain(surface, levels, gamma_correct, surfaces)) {
+      return 5;
+    }
+    chain = mipmap_chains_.emplace(chain_key, std::move(surfaces)).first;
+  }
+
+  resident_textures_.erase(handle);
+  frame_pipeline_.Retire();
+  const auto &surfaces = chain->second;
+  int ret = texture_stage.SetMipMappedTexture(surfaces.data(), surfaces.size(), texture_memory_);
+  if (!ret) {
+    resident_textures_[handle] = key;
+  }
+  return ret;
+}
+
+int TestHost::SetRawTexture(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint32_t pitch,
+                            uint32_t bytes_per_pixel, bool swizzle, uint32_t stage) {
+  if (pipelined_mode_) {
+    return SetRawTextureAsync(source, width, height, depth, pitch, bytes_per_pixel, swizzle, stage);
+  }
+
+  const uint32_t max_stride = max_texture_width_ * 4;
+  const uint32_t max_texture_size = max_stride * max_texture_height_ * max_texture_depth_;
+
+  const uint32_t layer_size = pitch * height;
+  const uint32_t surface_size = layer_size * depth;
+  ASSERT(surface_size < max_texture_size && "Texture too large.");
+
+  // Raw uploads are copied verbatim, so the stage's format does not participate in the key.
+  ResidentTexture key;
+  key.content_hash = XXH32(source, surface_size);
+  key.xbox_format = kRawTextureFormat;
+  key.swizzle = swizzle;
+  key.width = width;
+  key.height = height;
+  key.depth = depth;
+  key.pitch = pitch;
+  key.bytes_per_pixel = bytes_per_pixel;
+
+  TextureHeap::Handle handle = PrepareTextureMemory(stage, surface_size);
+  if (IsTextureResident(handle, key)) {
+    return 0;
+  }
+
+  resident_textures_.erase(handle);
+  frame_pipeline_.Retire();
+  int ret = texture_stage_[stage].SetRawTexture(source, width, height, depth, pitch, bytes_per_pixel, swizzle,
+                                                texture_memory_);
+  if (!ret) {
+    resident_textures_[handle] = key;
+  }
+  return ret;
+}
+
+int TestHost::SetRawTextureAsync(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint32_t pitch,
+                                 uint32_t bytes_per_pixel, bool swizzle, uint32_t stage) {
+  const uint32_t surface_size = pitch * height * depth;
+  ResidentTexture key;
+  key.content_hash = XXH32(source, surface_size);
+  key.xbox_format = kRawTextureFormat;
+  key.swizzle = swizzle;
+  key.width = width;
+  key.height = height;
+  key.depth = depth;
+  key.pitch = pitch;
+  key.bytes_per_pixel = bytes_per_pixel;
+
+  TextureHeap::Handle handle = PrepareTextureMemory(stage, surface_size);
+  if (IsTextureResident(handle, key)) {
+    return 0;
+  }
+
+  resident_textures_.erase(handle);
+  uint8_t *staging = ReserveTextureStaging(surface_size);
+  TextureStage::WriteTexels(source, width, height, depth, pitch, bytes_per_pixel, swizzle, staging);
+
+  QueueTextureCopy(staging, handle, surface_size);
+  resident_textures_[handle] = key;
+  return 0;
+}
+
+void TestHost::WaitForTextureUploads() {
+  WaitForGpuIdle();
+  texture_staging_used_ = 0;
+}
+
+uint8_t *TestHost::ReserveTextureStaging(uint32_t size) {
+  if (!texture_staging_memory_) {
+    // Large enough for any single texture that fits in a stage's slab of the texture heap.
+    texture_staging_size_ = max_texture_width_ * 4 * max_texture_height_ * max_texture_depth_;
+    texture_staging_memory_ = static_cast<uint8_t *>(
+        MmAllocateContiguousMemoryEx(texture_staging_size_, 0, MAXRAM, 0, PAGE_WRITECOMBINE | PAGE_READWRITE));
+    ASSERT(texture_staging_memory_ && "Failed to allocate texture staging memory.");
+    MemoryTracker::RecordAllocation(MemoryTracker::CATEGORY_TEXTURE_STAGING, texture_staging_size_);
+    InitializeHostContexts();
+  }
+
+  size = (size + kTextureStagingAlignment - 1) & ~(kTextureStagingAlignment - 1);
+  ASSERT(size <= texture_staging_size_ && "Texture too large for staging memory.");
+  if (texture_staging_used_ + size > texture_staging_size_) {
+    WaitForTextureUploads();
+  }
+
+  uint8_t *ret = texture_staging_memory_ + texture_staging_used_;
+  texture_staging_used_ += size;
+  return ret;
+}
+
+void TestHost::QueueTextureCopy(const uint8_t *source, TextureHeap::Handle handle, uint32_t size) {
+  // Texels are copied as 32-bit values. Allocations start on 128 byte boundaries, so the padding never reaches into the
+  // next allocation.
+  size = (size + 3) & ~3;
+
+  // The physical memory DMA context starts at address 0.
+  uint32_t source_offset = reinterpret_cast<uint32_t>(source) & 0x03FFFFFF;
+  uint32_t dest_offset = (reinterpret_cast<uint32_t>(texture_memory_) & 0x03FFFFFF) + texture_heap_.GetOffset(handle);
+
+  // Ensure the staged texels have left the write combining buffers before pgraph reads them.
+  __asm__ __volatile__("sfence" ::: "memory");
+
+  auto blit = [this](uint32_t *p, uint32_t src, uint32_t dst, uint32_t width, uint32_t height) {
+    p = pb_push1_to(kImageBlitSubchannel, p, NV_IMAGE_BLIT_OPERATION, NV09F_SET_OPERATION_SRCCOPY);
+    p = pb_push1_to(kSurfaces2DSubchannel, p, NV10_CONTEXT_SURFACES_2D_SET_DMA_IN_MEMORY0,
+                    physical_memory_dma_ctx_.ChannelID);
+    p = pb_push1_to(kSurfaces2DSubchannel, p, NV10_CONTEXT_SURFACES_2D_SET_DMA_IN_MEMORY1,
+                    physical_memory_dma_ctx_.ChannelID);
+    p = pb_push1_to(kSurfaces2DSubchannel, p, NV10_CONTEXT_SURFACES_2D_FORMAT, NV04_SURFACE_2D_FORMAT_Y32);
+    p = pb_push1_to(kSurfaces2DSubchannel, p, NV10_CONTEXT_SURFACES_2D_PITCH,
+                    kTextureCopyPitch | (kTextureCopyPitch << 16));
+    p = pb_push1_to(kSurfaces2DSubchannel, p, NV10_CONTEXT_SURFACES_2D_OFFSET_SRC, src);
+    p = pb_push1_to(kSurfaces2DSubchannel, p, NV10_CONTEXT_SURFACES_2D_OFFSET_DST, dst);
+
+    // A null clip rectangle disables clipping, so the copy is not limited to the framebuffer dimensions.
+    const uint32_t null_ctx = null_ctx_.ChannelID;
+    p = pb_push1_to(kImageBlitSubchannel, p, NV_IMAGE_BLIT_CLIP_RECTANGLE, null_ctx);
+    p = pb_push1_to(kImageBlitSubchannel, p, NV_IMAGE_BLIT_COLOR_KEY, null_ctx);
+    p = pb_push1_to(kImageBlitSubchannel, p, NV_IMAGE_BLIT_PATTERN, null_ctx);
+    p = pb_push1_to(kImageBlitSubchannel, p, NV_IMAGE_BLIT_ROP5, null_ctx);
+    p = pb_push1_to(kImageBlitSubchannel, p, NV_IMAGE_BLIT_SET_BETA, null_ctx);
+    p = pb_push1_to(kImageBlitSubchannel, p, NV_IMAGE_BLIT_SET_BETA4, null_ctx);
+
+    p = pb_push1_to(kImageBlitSubchannel, p, NV_IMAGE_BLIT_POINT_IN, 0);
+    p = pb_push1_to(kImageBlitSubchannel, p, NV_IMAGE_BLIT_POINT_OUT, 0);
+    p = pb_push1_to(kImageBlitSubchannel, p, NV_IMAGE_BLIT_SIZE, width | (height << 16));
+    return p;
+  };
+
+  const uint32_t texels_per_row = kTextureCopyPitch / 4;
+  const uint32_t full_rows = size / kTextureCopyPitch;
+  const uint32_t remainder = size % kTextureCopyPitch;
+
+  GpuProfiler::ScopedRegion scope(gpu_profiler_, GpuProfiler::SCOPE_BLIT);
+
+  auto p = CommandRecorder::Begin();
+  if (full_rows) {
+    p = blit(p, source_offset, dest_offset, texels_per_row, full_rows);
+  }
+  if (remainder) {
+    const uint32_t tail_offset = full_rows * kTextureCopyPitch;
+    p = blit(p, source_offset + tail_offset, dest_offset + tail_offset, remainder / 4, 1);
+  }
+
+  // Subsequent draws must not sample the texture until the copy has landed.
+  p = pb_push1(p, NV097_NO_OPERATION, 0);
+  p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
+  CommandRecorder::End(p);
+}
+
+void TestHost::InitializeHostContexts() {
+  if (host_contexts_initialized_) {
+    return;
+  }
+
+  auto channel = kHostContextChannel;
+  pb_create_dma_ctx(channel++, DMA_CLASS_3D, 0, MAXRAM, &physical_memory_dma_ctx_);
+  pb_bind_channel(&physical_memory_dma_ctx_);
+
+  pb_create_gr_ctx(channel++, GR_CLASS_30, &null_ctx_);
+  pb_bind_channel(&null_ctx_);
+  host_contexts_initialized_ = true;
+}
+
+const struct s_CtxDma &TestHost::GetGraphicsObject(uint32_t class_id) {
+  auto it = graphics_objects_.find(class_id);
+  if (it != graphics_objects_.end()) {
+    return it->second;
+  }
+
+  auto &object = graphics_objects_[class_id];
+  pb_create_gr_ctx(next_context_channel_++, class_id, &object);
+  pb_bind_channel(&object);
+  return object;
+}
+
+const struct s_CtxDma &TestHost::BindDmaContext(SharedDmaContextId id, const void *address, uint32_t limit) {
+  auto it = dma_contexts_.find(id);
+  if (it == dma_contexts_.end()) {
+    it = dma_contexts_.emplace(id, SharedDmaContext()).first;
+    pb_create_dma_ctx(next_context_channel_++, DMA_CLASS_3D, 0, MAXRAM, &it->second.context);
+    pb_bind_channel(&it->second.context);
+  } else if (it->second.address == address && it->second.limit == limit) {
+    return it->second.context;
+  }
+
+  auto &shared = it->second;
+  pb_set_dma_address(&shared.context, address, limit);
+  shared.address = address;
+  shared.limit = limit;
+  return shared.context;
+}
+
+void TestHost::BindSubchannel(uint32_t subchannel, const struct s_CtxDma &object) {
+  ASSERT(subchannel >= kNextSubchannel && subchannel < 8 && "Subchannel is reserved or out of range.");
+  if (subchannel_objects_[subchannel] == object.ChannelID) {
+    return;
+  }
+  pb_bind_subchannel(subchannel, &object);
+  subchannel_objects_[subchannel] = object.ChannelID;
+}
+
+TestHost::RenderTarget *TestHost::AcquireRenderTarget(uint32_t width, uint32_t height, uint32_t bytes_per_pixel,
+                                                      bool swizzled) {
+  ASSERT((!swizzled || (!(width & (width - 1)) && !(height & (height - 1)))) &&
+         "Swizzled render targets must have power of two dimensions.");
+  const uint32_t pitch = width * bytes_per_pixel;
+  for (auto &target : render_targets_) {
+    if (!target->in_use && target->width == width && target->height == height && target->pitch == pitch &&
+        target->swizzled == swizzled) {
+      target->in_use = true;
+      return target.get();
+    }
+  }
+
+  std::unique_ptr<RenderTarget> target(new RenderTarget());
+  target->width = width;
+  target->height = height;
+  target->pitch = pitch;
+  target->size = pitch * height;
+  target->swizzled = swizzled;
+  target->memory =
+      static_cast<uint8_t *>(ContiguousMemoryPool::Allocate(target->size, MemoryTracker::CATEGORY_RENDER_TARGET));
+  ASSERT(target->memory && "Failed to allocate render target.");
+  target->in_use = true;
+
+  render_targets_.push_back(std::move(target));
+  return render_targets_.back().get();
+}
+
+void TestHost::ReleaseRenderTarget(RenderTarget *target) {
+  ASSERT(target && target->in_use && "Render target released more than once.");
+  target->in_use = false;
+}
+
+void TestHost::BindRenderTarget(const RenderTarget *target, uint32_t zeta_pitch) {
+  InitializeHostContexts();
+  if (!zeta_pitch) {
+    zeta_pitch = aa_zeta_target_ ? aa_zeta_target_->pitch : framebuffer_width_ * 4;
+  }
+
+  auto p = CommandRecorder::Begin();
+  uint32_t *start = p;
+  p = register_shadow_.Push(p, NV097_SET_SURFACE_PITCH,
+                            SET_MASK(NV097_SET_SURFACE_PITCH_COLOR, target->pitch) |
+                                SET_MASK(NV097_SET_SURFACE_PITCH_ZETA, zeta_pitch));
+  p = register_shadow_.Push(p, NV097_SET_CONTEXT_DMA_COLOR, physical_memory_dma_ctx_.ChannelID);
+  p = register_shadow_.Push(p, NV097_SET_SURFACE_COLOR_OFFSET, reinterpret_cast<uint32_t>(target->memory) & 0x03FFFFFF);
+  if (p != start) {
+    // TODO: Investigate if this is actually necessary. Morrowind does this after changing offsets.
+    p = pb_push1(p, NV097_NO_OPERATION, 0);
+    p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
+  }
+  CommandRecorder::End(p);
+}
+
+void TestHost::SetRenderTargetSurfaceFormat(const RenderTarget *target, SurfaceColorFormat color_format) const {
+  SetSurfaceFormat(color_format, static_cast<SurfaceZetaFormat>(depth_buffer_format_), target->width, target->height,
+                   target->swizzled);
+}
+
+void TestHost::BindRenderTargetTexture(uint32_t stage, const RenderTarget *target) {
+  // Stage offsets are relative to texture_memory_ and wrap within the DMA range, so any contiguous address may be used.
+  texture_stage_[stage].SetTextureOffset(reinterpret_cast<uint32_t>(target->memory) -
+                                         reinterpret_cast<uint32_t>(texture_memory_));
+}
+
+void TestHost::SaveRenderTarget(const RenderTarget *target, const std::string &output_directory,
+                                const std::string &name) {
+  const uint32_t bytes_per_pixel = target->pitch / target->width;
+  ASSERT((bytes_per_pixel == 4 || bytes_per_pixel == 2) && "Unsupported render target depth.");
+  WaitForGpuIdle();
+
+  auto target_file = PrepareSaveFile(output_directory, name, CaptureQueue::GetFileExtension(save_format_));
+  queued_result_files_.push_back(target_file);
+  capture_queue_.Enqueue(target_file, save_format_, target->memory, static_cast<int>(target->width),
+                         static_cast<int>(target->height), static_cast<int>(bytes_per_pixel * 8),
+                         static_cast<int>(target->pitch),
+                         bytes_per_pixel == 4 ? SDL_PIXELFORMAT_ARGB8888 : SDL_PIXELFORMAT_RGB565, target->swizzled);
+}
+
+void TestHost::UnbindRenderTarget() {
+  if (tiled_frame_) {
+    BindTile();
+    return;
+  }
+  if (aa_color_target_) {
+    BindAntiAliasedTargets();
+    return;
+  }
+
+  const uint32_t framebuffer_pitch = framebuffer_width_ * 4;
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_SURFACE_PITCH,
+                            SET_MASK(NV097_SET_SURFACE_PITCH_COLOR, framebuffer_pitch) |
+                                SET_MASK(NV097_SET_SURFACE_PITCH_ZETA, framebuffer_pitch));
+  p = register_shadow_.Push(p, NV097_SET_CONTEXT_DMA_COLOR, DMA_CHANNEL_PIXEL_RENDERER);
+  p = register_shadow_.Push(p, NV097_SET_SURFACE_COLOR_OFFSET, 0);
+  CommandRecorder::End(p);
+}
+
+void TestHost::GetAntiAliasingScale(AntiAliasingSetting aa, uint32_t &scale_x, uint32_t &scale_y) {
+  switch (aa) {
+    case AA_CENTER_1:
+      scale_x = scale_y = 1;
+      return;
+    case AA_CENTER_CORNER_2:
+      scale_x = 2;
+      scale_y = 1;
+      return;
+    case AA_SQUARE_OFFSET_4:
+      scale_x = scale_y = 2;
+      return;
+  }
+  ASSERT(!"Invalid antialiasing setting.");
+}
+
+void TestHost::SetAntiAliasing(AntiAliasingSetting aa) {
+  ASSERT(!tiled_frame_ && "Antialiasing may not be changed during a tiled frame.");
+  if (aa == anti_aliasing_) {
+    return;
+  }
+
+  // The GPU may still be rendering into the current targets.
+  frame_pipeline_.Retire();
+  WaitForGpuIdle();
+  if (aa_color_target_) {
+    ReleaseRenderTarget(aa_color_target_);
+    ReleaseRenderTarget(aa_zeta_target_);
+    aa_color_target_ = aa_zeta_target_ = nullptr;
+  }
+  anti_aliasing_ = aa;
+
+  if (aa == AA_CENTER_1) {
+    // Return to the pbkit framebuffer and depth buffer.
+    auto p = CommandRecorder::Begin();
+    p = register_shadow_.Push(p, NV097_SET_CONTEXT_DMA_ZETA, DMA_CHANNEL_DEPTH_STENCIL_RENDERER);
+    p = register_shadow_.Push(p, NV097_SET_SURFACE_ZETA_OFFSET, 0);
+    CommandRecorder::End(p);
+    UnbindRenderTarget();
+    return;
+  }
+
+  uint32_t scale_x;
+  uint32_t scale_y;
+  GetAntiAliasingScale(aa, scale_x, scale_y);
+  // The zeta target is always allocated at 32bpp, matching the pbkit depth buffer.
+  aa_color_target_ = AcquireRenderTarget(framebuffer_width_ * scale_x, framebuffer_height_ * scale_y);
+  aa_zeta_target_ = AcquireRenderTarget(framebuffer_width_ * scale_x, framebuffer_height_ * scale_y);
+}
+
+void TestHost::BindAntiAliasedTargets() {
+  BindRenderTarget(aa_color_target_, aa_zeta_target_->pitch);
+
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_CONTEXT_DMA_ZETA, physical_memory_dma_ctx_.ChannelID);
+  p = register_shadow_.Push(p, NV097_SET_SURFACE_ZETA_OFFSET,
+                            reinterpret_cast<uint32_t>(aa_zeta_target_->memory) & 0x03FFFFFF);
+  CommandRecorder::End(p);
+}
+
+void TestHost::ResolveAntiAliasedFrame() {
+  // The fence guarantees that all rendering has been written back to memory.
+  WaitForGpuIdle();
+
+  uint32_t scale_x;
+  uint32_t scale_y;
+  GetAntiAliasingScale(anti_aliasing_, scale_x, scale_y);
+  const uint32_t sample_shift = __builtin_ctz(scale_x * scale_y);
+
+  auto destination = static_cast<uint8_t *>(pb_agp_access(pb_back_buffer()));
+  const uint32_t destination_pitch = pb_back_buffer_pitch();
+  const uint32_t source_pitch = aa_color_target_->pitch;
+
+  for (uint32_t y = 0; y < framebuffer_height_; ++y) {
+    auto out = reinterpret_cast<uint32_t *>(destination + y * destination_pitch);
+    const uint8_t *row = aa_color_target_->memory + y * scale_y * source_pitch;
+
+    for (uint32_t x = 0; x < framebuffer_width_; ++x) {
+      uint32_t sums[4]{};
+      for (uint32_t sy = 0; sy < scale_y; ++sy) {
+        auto samples = reinterpret_cast<const uint32_t *>(row + sy * source_pitch) + x * scale_x;
+        for (uint32_t sx = 0; sx < scale_x; ++sx) {
+          const uint32_t sample = samples[sx];
+          sums[0] += sample & 0xFF;
+          sums[1] += (sample >> 8) & 0xFF;
+          sums[2] += (sample >> 16) & 0xFF;
+          sums[3] += sample >> 24;
+        }
+      }
+      *out++ = (sums[0] >> sample_shift) | ((sums[1] >> sample_shift) << 8) | ((sums[2] >> sample_shift) << 16) |
+               ((sums[3] >> sample_shift) << 24);
+    }
+  }
+}
+
+void TestHost::BeginTiledFrame(uint32_t num_tiles) {
+  ASSERT(!tiled_frame_ && "Tiled frames may not be nested.");
+  ASSERT(num_tiles && "Tiled frames must contain at least one tile.");
+
+  frame_pipeline_.Retire();
+  // Tiles are stacked vertically so that every tile shares the framebuffer (and depth buffer) pitch.
+  tiled_frame_ = AcquireRenderTarget(framebuffer_width_, framebuffer_height_ * num_tiles);
+  num_tiles_ = num_tiles;
+  current_tile_ = 0;
+
+  // PrepareDraw does not reset the pushbuffer while tiling, so start the frame with an empty one.
+  WaitForGpuIdle();
+  pb_reset();
+}
+
+void TestHost::SetTile(uint32_t index) {
+  ASSERT(tiled_frame_ && index < num_tiles_ && "Invalid tile.");
+  current_tile_ = index;
+}
+
+void TestHost::BindTile() {
+  const RenderTarget tile{tiled_frame_->memory + current_tile_ * framebuffer_height_ * tiled_frame_->pitch,
+                          framebuffer_width_, framebuffer_height_, tiled_frame_->pitch};
+  BindRenderTarget(&tile);
+}
+
+void TestHost::EndTiledFrame() {
+  ASSERT(tiled_frame_ && "EndTiledFrame called without BeginTiledFrame.");
+
+  uint64_t start = GetPerformanceCounter();
+  WaitForGpuIdle();
+  if (gpu_profiler_.IsEnabled()) {
+    gpu_profiler_.Resolve();
+  }
+  texture_staging_used_ = 0;
+  start = AccumulateTiming(TIMING_GPU_WAIT, start);
+
+  const char *extension = CaptureQueue::GetFileExtension(save_format_);
+  for (auto &pending : pending_tiles_) {
+    auto target_file = PrepareSaveFile(pending.output_directory, pending.name, extension);
+    const uint8_t *pixels = tiled_frame_->memory + pending.tile * framebuffer_height_ * tiled_frame_->pitch;
+    capture_queue_.Enqueue(target_file, save_format_, pixels, static_cast<int>(framebuffer_width_),
+                           static_cast<int>(framebuffer_height_), 32, static_cast<int>(tiled_frame_->pitch),
+                           SDL_PIXELFORMAT_ARGB8888);
+    if (headless_) {
+      RecordResultMetadata(pending.output_directory, pending.name, pending.z_buffer_name);
+    }
+  }
+  pending_tiles_.clear();
+  AccumulateTiming(TIMING_SAVE, start);
+
+  ReleaseRenderTarget(tiled_frame_);
+  tiled_frame_ = nullptr;
+  UnbindRenderTarget();
+}
+
+void TestHost::InvalidateTextureCache() {
+  resident_textures_.clear();
+  for (auto &stage_slots : palette_slots_) {
+    for (auto &slot : stage_slots) {
+      slot = PaletteSlot{};
+    }
+  }
+}
+
+int TestHost::SetPalette(const uint32_t *palette, PaletteSize size, uint32_t stage) {
+  TextureStage &texture_stage = texture_stage_[stage];
+  const uint32_t content_hash = XXH32(palette, size * 4);
+  PaletteSlot *slots = palette_slots_[stage];
+
+  // Reuse a slot that already holds this palette, otherwise replace the least recently used one.
+  uint32_t target = 0;
+  for (uint32_t i = 0; i < kPaletteSlotsPerStage; ++i) {
+    const PaletteSlot &slot = slots[i];
+    if (slot.size == size && slot.content_hash == content_hash) {
+      target = i;
+      break;
+    }
+    if (slot.last_use < slots[target].last_use) {
+      target = i;
+    }
+  }
+
+  PaletteSlot &slot = slots[target];
+  slot.last_use = ++palette_use_counter_;
+  texture_stage.SetPaletteOffset(GetPaletteSlotOffset(stage, target));
+  if (slot.size == size && slot.content_hash == content_hash) {
+    return texture_stage.SetPaletteLength(size);
+  }
+
+  frame_pipeline_.Retire();
+  int ret = texture_stage.SetPalette(palette, size, texture_palette_memory_);
+  if (!ret) {
+    slot.content_hash = content_hash;
+    slot.size = size;
+  } else {
+    slot = PaletteSlot{};
+  }
+  return ret;
+}
+
+void TestHost::FinishDraw(bool allow_saving, const std::string &output_directory, const std::string &name,
+                          const std::string &z_buffer_name) {
+  if (last_prepare_draw_end_) {
+    AccumulateTiming(TIMING_BUILD_PUSHBUFFER, last_prepare_draw_end_);
+    last_prepare_draw_end_ = 0;
+  }
+
+  CommandRecorder::FlushActive();
+
+  bool perform_save = allow_saving && save_results_;
+  if (perform_save) {
+    // Saving may be deferred to a later frame, so the files are attributed to the test that queued them here.
+    RecordQueuedResultFiles(output_directory, name, z_buffer_name);
+  }
+  if (trace_start_) {
+    if (perform_save) {
+      CaptureTrace(output_directory, name);
+    }
+    trace_start_ = nullptr;
+  }
+
+  if (!perform_save && !headless_) {
+    pb_printat(0, 55, (char *)"ns");
+    pb_draw_text_screen();
+  }
+
+  if (tiled_frame_) {
+    if (perform_save) {
+      pending_tiles_.push_back({output_directory, name, z_buffer_name, current_tile_});
+      if (!z_buffer_name.empty()) {
+        // The depth buffer is shared by every tile, so it must be captured before the next tile clears it.
+        WaitForGpuIdle();
+        SaveZBuffer(output_directory, z_buffer_name);
+      }
+    }
+    return;
+  }
+
+  if (pipelined_mode_) {
+    // The vertex buffer is retained until the frame completes in case the next test replaces it, so that its storage
+    // is not freed while the GPU may still be reading it.
+    frame_pipeline_.Submit([this, perform_save, output_directory, name, z_buffer_name, vertices = vertex_buffer_]() {
+      CompleteFrame(perform_save, output_directory, name, z_buffer_name);
+    });
+    return;
+  }
+
+  uint64_t start = GetPerformanceCounter();
+  WaitForPushbufferDrained();
+  if (gpu_profiler_.IsEnabled()) {
+    // The last reports may still be in flight once the pushbuffer has been consumed.
+    WaitForGpuIdle();
+    gpu_profiler_.Resolve();
+  }
+  start = AccumulateTiming(TIMING_GPU_WAIT, start);
+
+  if (aa_color_target_ && (perform_save || hash_frames_ || (!headless_ && !throughput_mode_))) {
+    ResolveAntiAliasedFrame();
+    start = AccumulateTiming(TIMING_SAVE, start);
+  }
+
+  if (hash_frames_) {
+    // The fence guarantees that all rendering has been written back to memory before hashing.
+    WaitForGpuIdle();
+    HashBackBuffer();
+    start = AccumulateTiming(TIMING_SAVE, start);
+  }
+
+  if (perform_save) {
+    if (throughput_mode_) {
+      // The fence guarantees that all rendering has been written back to memory before the capture.
+      WaitForGpuIdle();
+      start = AccumulateTiming(TIMING_GPU_WAIT, start);
+    } else {
+      // TODO: See why waiting for tiles to be non-busy results in the screen not updating anymore.
+      // In theory this should wait for all tiles to be rendered before capturing.
+      pb_wait_for_vbl();
+      start = AccumulateTiming(TIMING_VBLANK_WAIT, start);
+    }
+
+    SaveFrame(output_directory, name, z_buffer_name);
+    start = AccumulateTiming(TIMING_SAVE, start);
+  }
+
+  if (headless_ || throughput_mode_) {
+    // Nothing is presented, the next test simply renders over the same back buffer.
+    return;
+  }
+
+  /* Swap buffers (if we can) */
+  WaitForFlip();
+  AccumulateTiming(TIMING_GPU_WAIT, start);
+}
+
+void TestHost::CaptureTrace(const std::string &output_directory, const std::string &name) {
+  uint32_t *end = GetPushbufferPosition();
+  if (end < trace_start_) {
+    PrintMsg("Pushbuffer wrapped while capturing '%s', trace not saved\n", name.c_str());
+    return;
+  }
+
+  PushbufferTrace trace;
+  trace.SetCommands(trace_start_, end - trace_start_);
+
+  for (uint32_t i = 0; i < 4; ++i) {
+    const auto &stage = texture_stage_[i];
+    if (!stage.enabled_) {
+      continue;
+    }
+    auto handle = bound_texture_memory_[i];
+    if (handle == TextureHeap::kInvalidHandle) {
+      handle = stage_texture_memory_[i];
+    }
+    if (handle != TextureHeap::kInvalidHandle) {
+      trace.AddRegion(texture_memory_ + texture_heap_.GetOffset(handle), texture_heap_.GetSize(handle));
+    }
+    if (stage.format_.xbox_format == NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8) {
+      trace.AddRegion(texture_palette_memory_ + GetPaletteSlotOffset(i, 0), kPaletteSlotSize * kPaletteSlotsPerStage);
+    }
+  }
+
+  if (vertex_buffer_) {
+    const uint32_t vertices_size = vertex_buffer_->num_vertices_ * sizeof(Vertex);
+    trace.AddRegion(vertex_buffer_->normalized_vertex_buffer_, vertices_size);
+    if (vertex_buffer_->linear_vertex_buffer_) {
+      trace.AddRegion(vertex_buffer_->linear_vertex_buffer_, vertices_size);
+    }
+    if (vertex_buffer_->packed_vertex_buffer_) {
+      trace.AddRegion(vertex_buffer_->packed_vertex_buffer_, vertex_buffer_->packed_buffer_size_);
+    }
+  }
+
+  io_worker_.PostWriteFile(PrepareSaveFile(output_directory, name, ".pbtrace"), trace.Serialize());
+}
+
+void TestHost::CompleteFrame(bool perform_save, const std::string &output_directory, const std::string &name,
+                             const std::string &z_buffer_name) {
+  uint64_t start = GetPerformanceCounter();
+  // The fence also guarantees that all rendering has been written back to memory before the capture.
+  WaitForGpuIdle();
+  if (gpu_profiler_.IsEnabled()) {
+    gpu_profiler_.Resolve();
+  }
+  start = AccumulateTiming(TIMING_GPU_WAIT, start);
+
+  if (aa_color_target_ && (perform_save || hash_frames_ || (!headless_ && !throughput_mode_))) {
+    ResolveAntiAliasedFrame();
+    start = AccumulateTiming(TIMING_SAVE, start);
+  }
+
+  if (hash_frames_) {
+    HashBackBuffer();
+    start = AccumulateTiming(TIMING_SAVE, start);
+  }
+
+  if (perform_save) {
+    SaveFrame(output_directory, name, z_buffer_name);
+    start = AccumulateTiming(TIMING_SAVE, start);
+  }
+
+  if (!headless_ && !throughput_mode_) {
+    WaitForFlip();
+    AccumulateTiming(TIMING_GPU_WAIT, start);
+  }
+}
+
+void TestHost::HashBackBuffer() {
+  auto buffer = static_cast<const uint8_t *>(pb_agp_access(pb_back_buffer()));
+  last_frame_hash_ = HashSurface(buffer, pb_back_buffer_width(), pb_back_buffer_height(), pb_back_buffer_pitch(), 4);
+  frame_hash_valid_ = true;
+}
+
+void TestHost::SaveFrame(const std::string &output_directory, const std::string &name,
+                         const std::string &z_buffer_name) {
+  // The surfaces are copied into staging buffers immediately, the encode and write happen asynchronously.
+  SaveBackBuffer(output_directory, name);
+
+  if (!z_buffer_name.empty()) {
+    SaveZBuffer(output_directory, z_buffer_name);
+  }
+  if (headless_) {
+    RecordResultMetadata(output_directory, name, z_buffer_name);
+  }
+}
+
+void TestHost::DrawTextScreen() const {
+  if (!headless_) {
+    pb_draw_text_screen();
+  }
+}
+
+void TestHost::RecordResultMetadata(const std::string &output_directory, const std::string &name,
+                                    const std::string &z_buffer_name) {
+  char line[256];
+  snprintf(line, sizeof(line), "%s,%s,%u,%u,%s,%s", name.c_str(), z_buffer_name.c_str(), framebuffer_width_,
+           framebuffer_height_, depth_buffer_format_ == NV097_SET_SURFACE_FORMAT_ZETA_Z16 ? "z16" : "z24s8",
+           depth_buffer_mode_float_ ? "float" : "fixed");
+  result_metadata_[output_directory].emplace_back(line);
+}
+
+void TestHost::SaveResultMetadata(const std::string &output_directory) {
+  auto it = result_metadata_.find(output_directory);
+  if (it == result_metadata_.end()) {
+    return;
+  }
+
+  std::string contents = "name,z_buffer_name,width,height,depth_format,depth_mode\n";
+  for (auto &line : it->second) {
+    contents += line;
+    contents += "\n";
+  }
+  io_worker_.PostWriteFile(output_directory + "\\" + kResultMetadataFilename, std::move(contents));
+
+  result_metadata_.erase(it);
+}
+
+void TestHost::SetVertexShaderProgram(std::shared_ptr<VertexShaderProgram> program) {
   vertex_shader_program_ = std::move(program);
 
   if (vertex_shader_program_) {
     vertex_shader_program_->Activate();
   } else {
-    auto p = pb_begin();
+    auto p = CommandRecorder::Begin();
     p = pb_push1(
         p, NV097_SET_TRANSFORM_EXECUTION_MODE,
         MASK(NV097_SET_TRANSFORM_EXECUTION_MODE_MODE, NV097_SET_TRANSFORM_EXECUTION_MODE_MODE_FIXED) |
             MASK(NV097_SET_TRANSFORM_EXECUTION_MODE_RANGE_MODE, NV097_SET_TRANSFORM_EXECUTION_MODE_RANGE_MODE_PRIV));
     p = pb_push1(p, NV097_SET_TRANSFORM_PROGRAM_CXT_WRITE_EN, 0x0);
     p = pb_push1(p, NV097_SET_TRANSFORM_CONSTANT_LOAD, 0x0);
-    pb_end(p);
+    CommandRecorder::End(p);
   }
 }
 
@@ -935,7 +2146,7 @@ void TestHost::SetDefaultViewportAndFixedFunctionMatrices() {
   }
 
   MATRIX matrix;
-  matrix_unit(matrix);
+  matrix_unit_sse(matrix);
   SetFixedFunctionModelViewMatrix(matrix);
 
   matrix[_11] = 640.0f;
@@ -1018,42 +2229,64 @@ void TestHost::GetDefaultXDKProjectionMatrix(MATRIX matrix) const {
 }
 
 void TestHost::SetWindowClip(uint32_t width, uint32_t height, uint32_t x, uint32_t y) {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_WINDOW_CLIP_HORIZONTAL, x + (width << 16));
-  p = pb_push1(p, NV097_SET_WINDOW_CLIP_VERTICAL, y + (height << 16));
-  pb_end(p);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_WINDOW_CLIP_HORIZONTAL, x + (width << 16));
+  p = register_shadow_.Push(p, NV097_SET_WINDOW_CLIP_VERTICAL, y + (height << 16));
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetViewportOffset(float x, float y, float z, float w) const {
-  auto p = pb_begin();
-  p = pb_push4f(p, NV097_SET_VIEWPORT_OFFSET, x, y, z, w);
-  pb_end(p);
+  const float offset[] = {x, y, z, w};
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.PushF(p, NV097_SET_VIEWPORT_OFFSET, offset, 4);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetViewportScale(float x, float y, float z, float w) const {
-  auto p = pb_begin();
-  p = pb_push4f(p, NV097_SET_VIEWPORT_SCALE, x, y, z, w);
-  pb_end(p);
+  const float scale[] = {x, y, z, w};
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.PushF(p, NV097_SET_VIEWPORT_SCALE, scale, 4);
+  CommandRecorder::End(p);
+}
+
+static void TransposeMatrix(MATRIX output, const MATRIX input) {
+  for (uint32_t row = 0; row < 4; ++row) {
+    for (uint32_t col = 0; col < 4; ++col) {
+      output[col * 4 + row] = input[row * 4 + col];
+    }
+  }
 }
 
 void TestHost::SetFixedFunctionModelViewMatrix(const MATRIX model_matrix) {
-  memcpy(fixed_function_model_view_matrix_, model_matrix, sizeof(fixed_function_model_view_matrix_));
+  // The inverse is only recalculated when the matrix actually changes.
+  if (!fixed_function_inverse_valid_ ||
+      memcmp(fixed_function_model_view_matrix_, model_matrix, sizeof(fixed_function_model_view_matrix_))) {
+    memcpy(fixed_function_model_view_matrix_, model_matrix, sizeof(fixed_function_model_view_matrix_));
+    matrix_inverse_sse(fixed_function_inverse_model_view_matrix_, fixed_function_model_view_matrix_);
+    fixed_function_inverse_valid_ = true;
+  }
 
-  auto p = pb_begin();
-  p = pb_push_transposed_matrix(p, NV097_SET_MODEL_VIEW_MATRIX, fixed_function_model_view_matrix_);
-  MATRIX inverse;
-  matrix_inverse(inverse, fixed_function_model_view_matrix_);
-  p = pb_push_4x3_matrix(p, NV097_SET_INVERSE_MODEL_VIEW_MATRIX, inverse);
-  pb_end(p);
+  MATRIX transposed;
+  TransposeMatrix(transposed, fixed_function_model_view_matrix_);
+
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.PushF(p, NV097_SET_MODEL_VIEW_MATRIX, transposed, 16);
+  // The inverse omits the 4th row and is not transposed.
+  p = register_shadow_.PushF(p, NV097_SET_INVERSE_MODEL_VIEW_MATRIX, fixed_function_inverse_model_view_matrix_, 12);
+  CommandRecorder::End(p);
 
   fixed_function_matrix_mode_ = MATRIX_MODE_USER;
 }
 
 void TestHost::SetFixedFunctionProjectionMatrix(const MATRIX projection_matrix) {
   memcpy(fixed_function_projection_matrix_, projection_matrix, sizeof(fixed_function_projection_matrix_));
-  auto p = pb_begin();
-  p = pb_push_transposed_matrix(p, NV097_SET_COMPOSITE_MATRIX, fixed_function_projection_matrix_);
-  pb_end(p);
+
+  MATRIX transposed;
+  TransposeMatrix(transposed, fixed_function_projection_matrix_);
+
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.PushF(p, NV097_SET_COMPOSITE_MATRIX, transposed, 16);
+  CommandRecorder::End(p);
 
   fixed_function_matrix_mode_ = MATRIX_MODE_USER;
 }
@@ -1098,234 +2331,280 @@ std::string TestHost::GetPrimitiveName(TestHost::DrawPrimitive primitive) {
 }
 
 void TestHost::SetAlphaBlendEnabled(bool enable) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push1(p, NV097_SET_BLEND_ENABLE, enable);
   if (enable) {
     p = pb_push1(p, NV097_SET_BLEND_EQUATION, NV097_SET_BLEND_EQUATION_V_FUNC_ADD);
     p = pb_push1(p, NV097_SET_BLEND_FUNC_SFACTOR, NV097_SET_BLEND_FUNC_SFACTOR_V_SRC_ALPHA);
     p = pb_push1(p, NV097_SET_BLEND_FUNC_DFACTOR, NV097_SET_BLEND_FUNC_DFACTOR_V_ONE_MINUS_SRC_ALPHA);
   }
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
-void TestHost::SetCombinerControl(int num_combiners, bool same_factor0, bool same_factor1, bool mux_msb) const {
-  ASSERT(num_combiners > 0 && num_combiners < 8);
-  uint32_t setting = MASK(NV097_SET_COMBINER_CONTROL_ITERATION_COUNT, num_combiners);
-  if (!same_factor0) {
-    setting |= MASK(NV097_SET_COMBINER_CONTROL_FACTOR0, NV097_SET_COMBINER_CONTROL_FACTOR0_EACH_STAGE);
+const uint32_t TestHost::Material::kSpecularParamsPower10[6] = {0xBF34DCE5, 0xC020743F, 0x40333D06,
+                                                                0xBF003612, 0xBFF852A5, 0x401C1BCE};
+const uint32_t TestHost::Material::kSpecularParamsPower125[6] = {0xBF78DF9C, 0xC04D3531, 0x404EFD4A,
+                                                                 0xBF71F52E, 0xC048FA21, 0x404C7CD6};
+
+static void Normalize3(float *out, float x, float y, float z) {
+  float length = sqrtf(x * x + y * y + z * z);
+  if (length == 0.0f) {
+    out[0] = out[1] = out[2] = 0.0f;
+    return;
   }
-  if (!same_factor1) {
-    setting |= MASK(NV097_SET_COMBINER_CONTROL_FACTOR1, NV097_SET_COMBINER_CONTROL_FACTOR1_EACH_STAGE);
+  out[0] = x / length;
+  out[1] = y / length;
+  out[2] = z / length;
+}
+
+TestHost::Light &TestHost::Light::SetInfinite(float x, float y, float z) {
+  type_ = LIGHT_INFINITE;
+  range_ = 1e30f;
+  Normalize3(inverse_direction_, -x, -y, -z);
+  Normalize3(half_vector_, inverse_direction_[0], inverse_direction_[1], inverse_direction_[2] + 1.0f);
+  return *this;
+}
+
+TestHost::Light &TestHost::Light::SetHalfVector(float x, float y, float z) {
+  half_vector_[0] = x;
+  half_vector_[1] = y;
+  half_vector_[2] = z;
+  return *this;
+}
+
+TestHost::Light &TestHost::Light::SetLocal(const float *position, float range, float constant, float linear,
+                                           float quadratic) {
+  type_ = LIGHT_LOCAL;
+  range_ = range;
+  memcpy(position_, position, sizeof(position_));
+  attenuation_[0] = constant;
+  attenuation_[1] = linear;
+  attenuation_[2] = quadratic;
+  return *this;
+}
+
+// Each light occupies a contiguous run of registers from NV097_SET_LIGHT_AMBIENT_COLOR, repeated every kLightStride
+// bytes.
+static constexpr uint32_t kLightStride = 0x80;
+static constexpr uint32_t kLightRegisters = 29;
+static_assert(NV097_SET_LIGHT_LOCAL_RANGE == NV097_SET_LIGHT_AMBIENT_COLOR + 9 * 4, "Unexpected light layout.");
+static_assert(NV097_SET_LIGHT_INFINITE_HALF_VECTOR == NV097_SET_LIGHT_AMBIENT_COLOR + 10 * 4,
+              "Unexpected light layout.");
+static_assert(NV097_SET_LIGHT_INFINITE_DIRECTION == NV097_SET_LIGHT_AMBIENT_COLOR + 13 * 4, "Unexpected light layout.");
+
+void TestHost::SetLighting(const Color &scene_ambient, const Material &material, const Light *lights,
+                           uint32_t num_lights) const {
+  ASSERT(num_lights <= kNumLights && "Too many lights.");
+
+  auto p = CommandRecorder::Begin();
+  uint32_t *block_start = p;
+
+  const Light kDisabledLight;
+  uint32_t enable_mask = 0;
+  for (uint32_t i = 0; i < kNumLights; ++i) {
+    const Light &light = i < num_lights ? lights[i] : kDisabledLight;
+    enable_mask |= light.type_ << (i * 2);
+
+    float values[kLightRegisters] = {
+        scene_ambient.r * light.ambient_.r,
+        scene_ambient.g * light.ambient_.g,
+        scene_ambient.b * light.ambient_.b,
+        material.diffuse_.r * light.diffuse_.r,
+        material.diffuse_.g * light.diffuse_.g,
+        material.diffuse_.b * light.diffuse_.b,
+        material.specular_.r * light.specular_.r,
+        material.specular_.g * light.specular_.g,
+        material.specular_.b * light.specular_.b,
+        light.range_,
+        light.half_vector_[0],
+        light.half_vector_[1],
+        light.half_vector_[2],
+        light.inverse_direction_[0],
+        light.inverse_direction_[1],
+        light.inverse_direction_[2],
+        // Spot falloff and direction are not supported.
+        0.0f,
+        0.0f,
+        0.0f,
+        0.0f,
+        0.0f,
+        0.0f,
+        0.0f,
+        light.position_[0],
+        light.position_[1],
+        light.position_[2],
+        light.attenuation_[0],
+        light.attenuation_[1],
+        light.attenuation_[2],
+    };
+
+    // Leave room for this light's packet and the material state that follows the last light.
+    if (kMaxDwordsPerSubmit - (p - block_start) < (kLightRegisters + 1) + 16) {
+      CommandRecorder::End(p);
+      p = CommandRecorder::Begin();
+      block_start = p;
+    }
+    pb_push_to(SUBCH_3D, p++, NV097_SET_LIGHT_AMBIENT_COLOR + i * kLightStride, kLightRegisters);
+    for (auto value : values) {
+      *(p++) = *reinterpret_cast<uint32_t *>(&value);
+    }
   }
-  if (mux_msb) {
-    setting |= MASK(NV097_SET_COMBINER_CONTROL_MUX_SELECT, NV097_SET_COMBINER_CONTROL_MUX_SELECT_MSB);
+
+  p = pb_push3f(p, NV097_SET_SCENE_AMBIENT_COLOR, scene_ambient.r * material.ambient_.r + material.emissive_.r,
+                scene_ambient.g * material.ambient_.g + material.emissive_.g,
+                scene_ambient.b * material.ambient_.b + material.emissive_.b);
+  // The emission is already incorporated into the scene ambient color.
+  p = pb_push3(p, NV097_SET_MATERIAL_EMISSION, 0, 0, 0);
+  p = pb_push1f(p, NV097_SET_MATERIAL_ALPHA, material.diffuse_.a);
+  pb_push_to(SUBCH_3D, p++, NV097_SET_SPECULAR_PARAMS, 6);
+  for (auto param : material.specular_params_) {
+    *(p++) = param;
   }
+  p = pb_push1(p, NV097_SET_LIGHT_ENABLE_MASK, enable_mask);
+  CommandRecorder::End(p);
+}
 
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_CONTROL, setting);
-  pb_end(p);
+void TestHost::SetCombinerState(const CombinerState &state) const {
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_ALPHA_ICW, state.alpha_icw_, 8);
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_SPECULAR_FOG_CW0, state.final_cw_, 2);
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_ALPHA_OCW, state.alpha_ocw_, 8);
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_COLOR_ICW, state.color_icw_, 8);
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_COLOR_OCW, state.color_ocw_, 8);
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_CONTROL, state.control_);
+  CommandRecorder::End(p);
+}
+
+void TestHost::SetCombinerControl(int num_combiners, bool same_factor0, bool same_factor1, bool mux_msb) const {
+  ASSERT(num_combiners > 0 && num_combiners < 8);
+  uint32_t setting = CombinerState().SetCombinerControl(num_combiners, same_factor0, same_factor1, mux_msb).control_;
+
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_CONTROL, setting);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetInputColorCombiner(int combiner, CombinerSource a_source, bool a_alpha, CombinerMapping a_mapping,
                                      CombinerSource b_source, bool b_alpha, CombinerMapping b_mapping,
                                      CombinerSource c_source, bool c_alpha, CombinerMapping c_mapping,
                                      CombinerSource d_source, bool d_alpha, CombinerMapping d_mapping) const {
-  uint32_t value = MakeInputCombiner(a_source, a_alpha, a_mapping, b_source, b_alpha, b_mapping, c_source, c_alpha,
-                                     c_mapping, d_source, d_alpha, d_mapping);
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_COLOR_ICW + combiner * 4, value);
-  pb_end(p);
+  uint32_t value = CombinerState::MakeInputCombiner({a_source, a_alpha, a_mapping}, {b_source, b_alpha, b_mapping},
+                                                    {c_source, c_alpha, c_mapping}, {d_source, d_alpha, d_mapping});
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_COLOR_ICW + combiner * 4, value);
+  CommandRecorder::End(p);
 }
 
 void TestHost::ClearInputColorCombiner(int combiner) const {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_COLOR_ICW + combiner * 4, 0);
-  pb_end(p);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_COLOR_ICW + combiner * 4, 0);
+  CommandRecorder::End(p);
 }
 
 void TestHost::ClearInputColorCombiners() const {
-  auto p = pb_begin();
-  pb_push_to(SUBCH_3D, p++, NV097_SET_COMBINER_COLOR_ICW, 8);
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  pb_end(p);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_COLOR_ICW, kClearedCombiners, 8);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetInputAlphaCombiner(int combiner, CombinerSource a_source, bool a_alpha, CombinerMapping a_mapping,
                                      CombinerSource b_source, bool b_alpha, CombinerMapping b_mapping,
                                      CombinerSource c_source, bool c_alpha, CombinerMapping c_mapping,
                                      CombinerSource d_source, bool d_alpha, CombinerMapping d_mapping) const {
-  uint32_t value = MakeInputCombiner(a_source, a_alpha, a_mapping, b_source, b_alpha, b_mapping, c_source, c_alpha,
-                                     c_mapping, d_source, d_alpha, d_mapping);
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_ALPHA_ICW + combiner * 4, value);
-  pb_end(p);
+  uint32_t value = CombinerState::MakeInputCombiner({a_source, a_alpha, a_mapping}, {b_source, b_alpha, b_mapping},
+                                                    {c_source, c_alpha, c_mapping}, {d_source, d_alpha, d_mapping});
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_ALPHA_ICW + combiner * 4, value);
+  CommandRecorder::End(p);
 }
 
 void TestHost::ClearInputAlphaColorCombiner(int combiner) const {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_ALPHA_ICW + combiner * 4, 0);
-  pb_end(p);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_ALPHA_ICW + combiner * 4, 0);
+  CommandRecorder::End(p);
 }
 
 void TestHost::ClearInputAlphaCombiners() const {
-  auto p = pb_begin();
-  pb_push_to(SUBCH_3D, p++, NV097_SET_COMBINER_ALPHA_ICW, 8);
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  pb_end(p);
-}
-
-uint32_t TestHost::MakeInputCombiner(CombinerSource a_source, bool a_alpha, CombinerMapping a_mapping,
-                                     CombinerSource b_source, bool b_alpha, CombinerMapping b_mapping,
-                                     CombinerSource c_source, bool c_alpha, CombinerMapping c_mapping,
-                                     CombinerSource d_source, bool d_alpha, CombinerMapping d_mapping) const {
-  auto channel = [](CombinerSource src, bool alpha, CombinerMapping mapping) {
-    return src + (alpha << 4) + (mapping << 5);
-  };
-
-  uint32_t ret = (channel(a_source, a_alpha, a_mapping) << 24) + (channel(b_source, b_alpha, b_mapping) << 16) +
-                 (channel(c_source, c_alpha, c_mapping) << 8) + channel(d_source, d_alpha, d_mapping);
-  return ret;
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_ALPHA_ICW, kClearedCombiners, 8);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetOutputColorCombiner(int combiner, TestHost::CombinerDest ab_dst, TestHost::CombinerDest cd_dst,
                                       TestHost::CombinerDest sum_dst, bool ab_dot_product, bool cd_dot_product,
                                       TestHost::CombinerSumMuxMode sum_or_mux, TestHost::CombinerOutOp op,
                                       bool alpha_from_ab_blue, bool alpha_from_cd_blue) const {
-  uint32_t value = MakeOutputCombiner(ab_dst, cd_dst, sum_dst, ab_dot_product, cd_dot_product, sum_or_mux, op);
-  if (alpha_from_ab_blue) {
-    value |= (1 << 19);
-  }
-  if (alpha_from_cd_blue) {
-    value |= (1 << 18);
-  }
+  uint32_t value = CombinerState::MakeOutputCombiner(ab_dst, cd_dst, sum_dst, ab_dot_product, cd_dot_product,
+                                                     sum_or_mux, op, alpha_from_ab_blue, alpha_from_cd_blue);
 
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_COLOR_OCW + combiner * 4, value);
-  pb_end(p);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_COLOR_OCW + combiner * 4, value);
+  CommandRecorder::End(p);
 }
 
 void TestHost::ClearOutputColorCombiner(int combiner) const {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_COLOR_OCW + combiner * 4, 0);
-  pb_end(p);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_COLOR_OCW + combiner * 4, 0);
+  CommandRecorder::End(p);
 }
 
 void TestHost::ClearOutputColorCombiners() const {
-  auto p = pb_begin();
-  pb_push_to(SUBCH_3D, p++, NV097_SET_COMBINER_COLOR_OCW, 8);
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  pb_end(p);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_COLOR_OCW, kClearedCombiners, 8);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetOutputAlphaCombiner(int combiner, CombinerDest ab_dst, CombinerDest cd_dst, CombinerDest sum_dst,
                                       bool ab_dot_product, bool cd_dot_product, CombinerSumMuxMode sum_or_mux,
                                       CombinerOutOp op) const {
-  uint32_t value = MakeOutputCombiner(ab_dst, cd_dst, sum_dst, ab_dot_product, cd_dot_product, sum_or_mux, op);
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_ALPHA_OCW + combiner * 4, value);
-  pb_end(p);
+  uint32_t value =
+      CombinerState::MakeOutputCombiner(ab_dst, cd_dst, sum_dst, ab_dot_product, cd_dot_product, sum_or_mux, op);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_ALPHA_OCW + combiner * 4, value);
+  CommandRecorder::End(p);
 }
 
 void TestHost::ClearOutputAlphaColorCombiner(int combiner) const {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_ALPHA_OCW + combiner * 4, 0);
-  pb_end(p);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_ALPHA_OCW + combiner * 4, 0);
+  CommandRecorder::End(p);
 }
 
 void TestHost::ClearOutputAlphaCombiners() const {
-  auto p = pb_begin();
-  pb_push_to(SUBCH_3D, p++, NV097_SET_COMBINER_ALPHA_OCW, 8);
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  pb_end(p);
-}
-
-uint32_t TestHost::MakeOutputCombiner(TestHost::CombinerDest ab_dst, TestHost::CombinerDest cd_dst,
-                                      TestHost::CombinerDest sum_dst, bool ab_dot_product, bool cd_dot_product,
-                                      TestHost::CombinerSumMuxMode sum_or_mux, TestHost::CombinerOutOp op) const {
-  uint32_t ret = cd_dst | (ab_dst << 4) | (sum_dst << 8);
-  if (cd_dot_product) {
-    ret |= 1 << 12;
-  }
-  if (ab_dot_product) {
-    ret |= 1 << 13;
-  }
-  if (sum_or_mux) {
-    ret |= 1 << 14;
-  }
-  ret |= op << 15;
-
-  return ret;
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_ALPHA_OCW, kClearedCombiners, 8);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetFinalCombiner0(TestHost::CombinerSource a_source, bool a_alpha, bool a_invert,
                                  TestHost::CombinerSource b_source, bool b_alpha, bool b_invert,
                                  TestHost::CombinerSource c_source, bool c_alpha, bool c_invert,
                                  TestHost::CombinerSource d_source, bool d_alpha, bool d_invert) const {
-  auto channel = [](CombinerSource src, bool alpha, bool invert) { return src + (alpha << 4) + (invert << 5); };
-
-  uint32_t value = (channel(a_source, a_alpha, a_invert) << 24) + (channel(b_source, b_alpha, b_invert) << 16) +
-                   (channel(c_source, c_alpha, c_invert) << 8) + channel(d_source, d_alpha, d_invert);
+  uint32_t value = CombinerState::MakeFinalCombiner0(a_source, a_alpha, a_invert, b_source, b_alpha, b_invert, c_source,
+                                                     c_alpha, c_invert, d_source, d_alpha, d_invert);
 
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_SPECULAR_FOG_CW0, value);
-  pb_end(p);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_SPECULAR_FOG_CW0, value);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetFinalCombiner1(TestHost::CombinerSource e_source, bool e_alpha, bool e_invert,
                                  TestHost::CombinerSource f_source, bool f_alpha, bool f_invert,
                                  TestHost::CombinerSource g_source, bool g_alpha, bool g_invert,
                                  bool specular_add_invert_r12, bool specular_add_invert_r5, bool specular_clamp) const {
-  auto channel = [](CombinerSource src, bool alpha, bool invert) { return src + (alpha << 4) + (invert << 5); };
+  uint32_t value = CombinerState::MakeFinalCombiner1(e_source, e_alpha, e_invert, f_source, f_alpha, f_invert, g_source,
+                                                     g_alpha, g_invert, specular_add_invert_r12, specular_add_invert_r5,
+                                                     specular_clamp);
 
-  uint32_t value = (channel(e_source, e_alpha, e_invert) << 24) + (channel(f_source, f_alpha, f_invert) << 16) +
-                   (channel(g_source, g_alpha, g_invert) << 8);
-  if (specular_add_invert_r12) {
-    value += 0x20;
-  }
-  if (specular_add_invert_r5) {
-    value += (1 << 6);
-  }
-  if (specular_clamp) {
-    value += (1 << 7);
-  }
-
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_COMBINER_SPECULAR_FOG_CW1, value);
-  pb_end(p);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_COMBINER_SPECULAR_FOG_CW1, value);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetCombinerFactorC0(int combiner, uint32_t value) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push1(p, NV097_SET_COMBINER_FACTOR0 + 4 * combiner, value);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetCombinerFactorC0(int combiner, float red, float green, float blue, float alpha) const {
@@ -1334,9 +2613,9 @@ void TestHost::SetCombinerFactorC0(int combiner, float red, float green, float b
 }
 
 void TestHost::SetCombinerFactorC1(int combiner, uint32_t value) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push1(p, NV097_SET_COMBINER_FACTOR1 + 4 * combiner, value);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetCombinerFactorC1(int combiner, float red, float green, float blue, float alpha) const {
@@ -1345,9 +2624,9 @@ void TestHost::SetCombinerFactorC1(int combiner, float red, float green, float b
 }
 
 void TestHost::SetFinalCombinerFactorC0(uint32_t value) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push1(p, NV097_SET_SPECULAR_FOG_FACTOR, value);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetFinalCombinerFactorC0(float red, float green, float blue, float alpha) const {
@@ -1356,9 +2635,9 @@ void TestHost::SetFinalCombinerFactorC0(float red, float green, float blue, floa
 }
 
 void TestHost::SetFinalCombinerFactorC1(uint32_t value) const {
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   p = pb_push1(p, NV097_SET_SPECULAR_FOG_FACTOR + 0x04, value);
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetFinalCombinerFactorC1(float red, float green, float blue, float alpha) const {
@@ -1368,21 +2647,28 @@ void TestHost::SetFinalCombinerFactorC1(float red, float green, float blue, floa
 
 void TestHost::SetShaderStageProgram(ShaderStageProgram stage_0, ShaderStageProgram stage_1, ShaderStageProgram stage_2,
                                      ShaderStageProgram stage_3) const {
-  auto p = pb_begin();
-  p = pb_push1(
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(
       p, NV097_SET_SHADER_STAGE_PROGRAM,
       MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE0, stage_0) | MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE1, stage_1) |
           MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE2, stage_2) | MASK(NV097_SET_SHADER_STAGE_PROGRAM_STAGE3, stage_3));
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TestHost::SetShaderStageInput(uint32_t stage_2_input, uint32_t stage_3_input) const {
-  auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_SHADER_OTHER_STAGE_INPUT,
-               MASK(NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE1, 0) |
-                   MASK(NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE2, stage_2_input) |
-                   MASK(NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE3, stage_3_input));
-  pb_end(p);
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.Push(p, NV097_SET_SHADER_OTHER_STAGE_INPUT,
+                            MASK(NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE1, 0) |
+                                MASK(NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE2, stage_2_input) |
+                                MASK(NV097_SET_SHADER_OTHER_STAGE_INPUT_STAGE3, stage_3_input));
+  CommandRecorder::End(p);
+}
+
+void TestHost::SetPixelShaderProgram(const PixelShaderProgram &program) const {
+  auto &commands = program.GetCommands();
+  auto p = CommandRecorder::Begin();
+  p = register_shadow_.PushCommands(p, commands.data(), commands.size());
+  CommandRecorder::End(p);
 }
 
 void TestHost::OverrideVertexAttributeStride(TestHost::VertexAttribute attribute, uint32_t stride) {
@@ -1401,7 +2687,7 @@ void TestHost::ClearVertexAttributeStrideOverride(TestHost::VertexAttribute attr
 }
 
 static void SetVertexAttribute(uint32_t index, uint32_t format, uint32_t size, uint32_t stride, const void *data) {
-  uint32_t *p = pb_begin();
+  uint32_t *p = CommandRecorder::Begin();
   p = pb_push1(p, NV097_SET_VERTEX_DATA_ARRAY_FORMAT + index * 4,
                MASK(NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE, format) |
                    MASK(NV097_SET_VERTEX_DATA_ARRAY_FORMAT_SIZE, size) |
@@ -1409,7 +2695,7 @@ static void SetVertexAttribute(uint32_t index, uint32_t format, uint32_t size, u
   if (size && data) {
     p = pb_push1(p, NV097_SET_VERTEX_DATA_ARRAY_OFFSET + index * 4, (uint32_t)data & 0x03ffffff);
   }
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 static void ClearVertexAttribute(uint32_t index) {
@@ -5,15 +5,31 @@
 #include <printf/printf.h>
 
 #include <cstdint>
+#include <cstring>
+#include <map>
 #include <memory>
-
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "capture_queue.h"
+#include "command_recorder.h"
+#include "frame_pipeline.h"
+#include "gpu_profiler.h"
+#include "index_buffer.h"
+#include "io_worker.h"
 #include "math3d.h"
 #include "nxdk_ext.h"
+#include "register_shadow.h"
 #include "string"
 #include "texture_format.h"
+#include "texture_heap.h"
 #include "texture_stage.h"
 #include "vertex_buffer.h"
+#include "vertex_emitters.h"
 
+class PixelShaderProgram;
 class VertexShaderProgram;
 struct Vertex;
 class VertexBuffer;
@@ -22,13 +38,30 @@ class VertexBuffer;
 // It appears that this must be exactly one more than the last subchannel configured by pbkit or it will trigger an
 // exception in xemu.
 constexpr uint32_t kNextSubchannel = NEXT_SUBCH;
-// The first pgraph context channel that can be used by tests.
-constexpr uint32_t kNextContextChannel = 25;
+// The first pgraph context channel used by TestHost for its own DMA and graphics objects.
+constexpr uint32_t kHostContextChannel = 25;
+// The pgraph context channel used by the GpuProfiler report DMA context.
+constexpr uint32_t kGpuProfilerContextChannel = kHostContextChannel + 2;
+// The first pgraph context channel available for objects created on behalf of tests, see
+// TestHost::GetGraphicsObject.
+constexpr uint32_t kNextContextChannel = kGpuProfilerContextChannel + 1;
 
 constexpr uint32_t kNoStrideOverride = 0xFFFFFFFF;
 
 class TestHost {
  public:
+  // An offscreen color surface in contiguous memory that may be rendered into and then sampled as a texture.
+  struct RenderTarget {
+    uint8_t *memory{nullptr};
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t pitch{0};
+    uint32_t size{0};
+    // Swizzled targets have power of two dimensions and store pixels in the Morton order used by swizzled textures.
+    bool swizzled{false};
+    bool in_use{false};
+  };
+
   enum VertexAttribute {
     POSITION = 1 << NV2A_VERTEX_ATTR_POSITION,
     WEIGHT = 1 << NV2A_VERTEX_ATTR_WEIGHT,
@@ -50,6 +83,9 @@ class TestHost {
 
   static constexpr uint32_t kDefaultVertexFields = POSITION | DIFFUSE | TEXCOORD0;
 
+  // Name of the file written by SaveResultMetadata.
+  static constexpr const char *kResultMetadataFilename = "metadata.csv";
+
   enum DrawPrimitive {
     PRIMITIVE_POINTS = NV097_SET_BEGIN_END_OP_POINTS,
     PRIMITIVE_LINES = NV097_SET_BEGIN_END_OP_LINES,
@@ -133,7 +169,7 @@ class TestHost {
   };
 
   struct ColorInput : public CombinerInput {
-    explicit ColorInput(CombinerSource s, CombinerMapping m = MAP_UNSIGNED_IDENTITY) : CombinerInput() {
+    constexpr explicit ColorInput(CombinerSource s, CombinerMapping m = MAP_UNSIGNED_IDENTITY) : CombinerInput() {
       source = s;
       alpha = false;
       mapping = m;
@@ -141,7 +177,7 @@ class TestHost {
   };
 
   struct AlphaInput : public CombinerInput {
-    explicit AlphaInput(CombinerSource s, CombinerMapping m = MAP_UNSIGNED_IDENTITY) : CombinerInput() {
+    constexpr explicit AlphaInput(CombinerSource s, CombinerMapping m = MAP_UNSIGNED_IDENTITY) : CombinerInput() {
       source = s;
       alpha = true;
       mapping = m;
@@ -149,7 +185,7 @@ class TestHost {
   };
 
   struct ZeroInput : public CombinerInput {
-    explicit ZeroInput() : CombinerInput() {
+    constexpr explicit ZeroInput() : CombinerInput() {
       source = SRC_ZERO;
       alpha = false;
       mapping = MAP_UNSIGNED_IDENTITY;
@@ -157,7 +193,7 @@ class TestHost {
   };
 
   struct NegativeOneInput : public CombinerInput {
-    explicit NegativeOneInput() : CombinerInput() {
+    constexpr explicit NegativeOneInput() : CombinerInput() {
       source = SRC_ZERO;
       alpha = false;
       mapping = MAP_EXPAND_NORMAL;
@@ -165,13 +201,266 @@ class TestHost {
   };
 
   struct OneInput : public CombinerInput {
-    explicit OneInput() : CombinerInput() {
+    constexpr explicit OneInput() : CombinerInput() {
       source = SRC_ZERO;
       alpha = false;
       mapping = MAP_UNSIGNED_INVERT;
     }
   };
 
+  // A complete register combiner configuration: the input and output control words for all eight stages, both final
+  // combiner control words, and NV097_SET_COMBINER_CONTROL. Stages that are not explicitly configured are cleared.
+  //
+  // States are intended to be built once (typically as constexpr) and applied with SetCombinerState, e.g.,
+  //   static constexpr auto kState = TestHost::CombinerState().SetCombinerControl(2).SetInputColorCombiner(...);
+  class CombinerState {
+   public:
+    constexpr CombinerState &SetCombinerControl(int num_combiners = 1, bool same_factor0 = false,
+                                                bool same_factor1 = false, bool mux_msb = false) {
+      control_ = Mask(NV097_SET_COMBINER_CONTROL_ITERATION_COUNT, num_combiners);
+      if (!same_factor0) {
+        control_ |= Mask(NV097_SET_COMBINER_CONTROL_FACTOR0, NV097_SET_COMBINER_CONTROL_FACTOR0_EACH_STAGE);
+      }
+      if (!same_factor1) {
+        control_ |= Mask(NV097_SET_COMBINER_CONTROL_FACTOR1, NV097_SET_COMBINER_CONTROL_FACTOR1_EACH_STAGE);
+      }
+      if (mux_msb) {
+        control_ |= Mask(NV097_SET_COMBINER_CONTROL_MUX_SELECT, NV097_SET_COMBINER_CONTROL_MUX_SELECT_MSB);
+      }
+      return *this;
+    }
+
+    constexpr CombinerState &SetInputColorCombiner(int combiner, CombinerInput a, CombinerInput b = ZeroInput(),
+                                                   CombinerInput c = ZeroInput(), CombinerInput d = ZeroInput()) {
+      color_icw_[combiner] = MakeInputCombiner(a, b, c, d);
+      return *this;
+    }
+
+    constexpr CombinerState &SetInputAlphaCombiner(int combiner, CombinerInput a, CombinerInput b = ZeroInput(),
+                                                   CombinerInput c = ZeroInput(), CombinerInput d = ZeroInput()) {
+      alpha_icw_[combiner] = MakeInputCombiner(a, b, c, d);
+      return *this;
+    }
+
+    constexpr CombinerState &SetOutputColorCombiner(int combiner, CombinerDest ab_dst = DST_DISCARD,
+                                                    CombinerDest cd_dst = DST_DISCARD,
+                                                    CombinerDest sum_dst = DST_DISCARD, bool ab_dot_product = false,
+                                                    bool cd_dot_product = false, CombinerSumMuxMode sum_or_mux = SM_SUM,
+                                                    CombinerOutOp op = OP_IDENTITY, bool alpha_from_ab_blue = false,
+                                                    bool alpha_from_cd_blue = false) {
+      color_ocw_[combiner] = MakeOutputCombiner(ab_dst, cd_dst, sum_dst, ab_dot_product, cd_dot_product, sum_or_mux,
+                                                op, alpha_from_ab_blue, alpha_from_cd_blue);
+      return *this;
+    }
+
+    constexpr CombinerState &SetOutputAlphaCombiner(int combiner, CombinerDest ab_dst = DST_DISCARD,
+                                                    CombinerDest cd_dst = DST_DISCARD,
+                                                    CombinerDest sum_dst = DST_DISCARD, bool ab_dot_product = false,
+                                                    bool cd_dot_product = false, CombinerSumMuxMode sum_or_mux = SM_SUM,
+                                                    CombinerOutOp op = OP_IDENTITY) {
+      alpha_ocw_[combiner] =
+          MakeOutputCombiner(ab_dst, cd_dst, sum_dst, ab_dot_product, cd_dot_product, sum_or_mux, op);
+      return *this;
+    }
+
+    constexpr CombinerState &SetFinalCombiner0Just(CombinerSource d_source, bool d_alpha = false,
+                                                   bool d_invert = false) {
+      return SetFinalCombiner0(SRC_ZERO, false, false, SRC_ZERO, false, false, SRC_ZERO, false, false, d_source,
+                               d_alpha, d_invert);
+    }
+    constexpr CombinerState &SetFinalCombiner0(CombinerSource a_source = SRC_ZERO, bool a_alpha = false,
+                                               bool a_invert = false, CombinerSource b_source = SRC_ZERO,
+                                               bool b_alpha = false, bool b_invert = false,
+                                               CombinerSource c_source = SRC_ZERO, bool c_alpha = false,
+                                               bool c_invert = false, CombinerSource d_source = SRC_ZERO,
+                                               bool d_alpha = false, bool d_invert = false) {
+      final_cw_[0] = MakeFinalCombiner0(a_source, a_alpha, a_invert, b_source, b_alpha, b_invert, c_source, c_alpha,
+                                        c_invert, d_source, d_alpha, d_invert);
+      return *this;
+    }
+
+    constexpr CombinerState &SetFinalCombiner1Just(CombinerSource g_source, bool g_alpha = false,
+                                                   bool g_invert = false) {
+      return SetFinalCombiner1(SRC_ZERO, false, false, SRC_ZERO, false, false, g_source, g_alpha, g_invert);
+    }
+    constexpr CombinerState &SetFinalCombiner1(CombinerSource e_source = SRC_ZERO, bool e_alpha = false,
+                                               bool e_invert = false, CombinerSource f_source = SRC_ZERO,
+                                               bool f_alpha = false, bool f_invert = false,
+                                               CombinerSource g_source = SRC_ZERO, bool g_alpha = false,
+                                               bool g_invert = false, bool specular_add_invert_r12 = false,
+                                               bool specular_add_invert_r5 = false, bool specular_clamp = false) {
+      final_cw_[1] = MakeFinalCombiner1(e_source, e_alpha, e_invert, f_source, f_alpha, f_invert, g_source, g_alpha,
+                                        g_invert, specular_add_invert_r12, specular_add_invert_r5, specular_clamp);
+      return *this;
+    }
+
+    static constexpr uint32_t MakeInputCombiner(CombinerInput a, CombinerInput b, CombinerInput c, CombinerInput d) {
+      return (InputChannel(a) << 24) + (InputChannel(b) << 16) + (InputChannel(c) << 8) + InputChannel(d);
+    }
+
+    static constexpr uint32_t MakeOutputCombiner(CombinerDest ab_dst, CombinerDest cd_dst, CombinerDest sum_dst,
+                                                 bool ab_dot_product, bool cd_dot_product,
+                                                 CombinerSumMuxMode sum_or_mux, CombinerOutOp op,
+                                                 bool alpha_from_ab_blue = false, bool alpha_from_cd_blue = false) {
+      uint32_t ret = cd_dst | (ab_dst << 4) | (sum_dst << 8);
+      if (cd_dot_product) {
+        ret |= 1 << 12;
+      }
+      if (ab_dot_product) {
+        ret |= 1 << 13;
+      }
+      if (sum_or_mux) {
+        ret |= 1 << 14;
+      }
+      ret |= op << 15;
+      if (alpha_from_ab_blue) {
+        ret |= 1 << 19;
+      }
+      if (alpha_from_cd_blue) {
+        ret |= 1 << 18;
+      }
+      return ret;
+    }
+
+    static constexpr uint32_t MakeFinalCombiner0(CombinerSource a_source, bool a_alpha, bool a_invert,
+                                                 CombinerSource b_source, bool b_alpha, bool b_invert,
+                                                 CombinerSource c_source, bool c_alpha, bool c_invert,
+                                                 CombinerSource d_source, bool d_alpha, bool d_invert) {
+      return (FinalChannel(a_source, a_alpha, a_invert) << 24) + (FinalChannel(b_source, b_alpha, b_invert) << 16) +
+             (FinalChannel(c_source, c_alpha, c_invert) << 8) + FinalChannel(d_source, d_alpha, d_invert);
+    }
+
+    static constexpr uint32_t MakeFinalCombiner1(CombinerSource e_source, bool e_alpha, bool e_invert,
+                                                 CombinerSource f_source, bool f_alpha, bool f_invert,
+                                                 CombinerSource g_source, bool g_alpha, bool g_invert,
+                                                 bool specular_add_invert_r12, bool specular_add_invert_r5,
+                                                 bool specular_clamp) {
+      uint32_t ret = (FinalChannel(e_source, e_alpha, e_invert) << 24) +
+                     (FinalChannel(f_source, f_alpha, f_invert) << 16) + (FinalChannel(g_source, g_alpha, g_invert) << 8);
+      if (specular_add_invert_r12) {
+        ret += 0x20;
+      }
+      if (specular_add_invert_r5) {
+        ret += (1 << 6);
+      }
+      if (specular_clamp) {
+        ret += (1 << 7);
+      }
+      return ret;
+    }
+
+   private:
+    friend class TestHost;
+
+    static constexpr uint32_t Mask(uint32_t mask, uint32_t val) { return (val << __builtin_ctz(mask)) & mask; }
+    static constexpr uint32_t InputChannel(CombinerInput input) {
+      return input.source + (input.alpha << 4) + (input.mapping << 5);
+    }
+    static constexpr uint32_t FinalChannel(CombinerSource src, bool alpha, bool invert) {
+      return src + (alpha << 4) + (invert << 5);
+    }
+
+    uint32_t color_icw_[8]{};
+    uint32_t color_ocw_[8]{};
+    uint32_t alpha_icw_[8]{};
+    uint32_t alpha_ocw_[8]{};
+    uint32_t final_cw_[2]{};
+    uint32_t control_{1};
+  };
+
+  // Number of fixed function lights supported by the hardware.
+  static constexpr uint32_t kNumLights = 8;
+
+  // A fixed function light described in D3D terms. Values derived from the description, such as the inverse direction
+  // and half vector of an infinite light, are computed when it is configured rather than each time it is uploaded. The
+  // colors are combined with a Material by SetLighting.
+  //
+  // Positions and directions are given in eye space, as they are not transformed by the hardware.
+  class Light {
+   public:
+    enum Type {
+      LIGHT_OFF = 0,
+      LIGHT_INFINITE = 1,
+      LIGHT_LOCAL = 2,
+    };
+
+    // Makes this a directional light shining along `x`, `y`, `z`. The half vector assumes a viewer at infinity down the
+    // -z axis, as in D3D with D3DRS_LOCALVIEWER disabled.
+    Light &SetInfinite(float x, float y, float z);
+    // Overrides the half vector computed by SetInfinite.
+    Light &SetHalfVector(float x, float y, float z);
+    // Makes this a point light at `position` whose intensity is scaled by 1 / (constant + linear * d + quadratic * d^2).
+    Light &SetLocal(const float *position, float range, float constant, float linear, float quadratic);
+
+    Light &SetAmbient(const Color &color) {
+      ambient_ = color;
+      return *this;
+    }
+    Light &SetDiffuse(const Color &color) {
+      diffuse_ = color;
+      return *this;
+    }
+    Light &SetSpecular(const Color &color) {
+      specular_ = color;
+      return *this;
+    }
+
+    Type GetType() const { return type_; }
+
+   private:
+    friend class TestHost;
+
+    Type type_{LIGHT_OFF};
+    Color ambient_{0.0f, 0.0f, 0.0f, 0.0f};
+    Color diffuse_{0.0f, 0.0f, 0.0f, 0.0f};
+    Color specular_{0.0f, 0.0f, 0.0f, 0.0f};
+    float range_{1e30f};
+    float half_vector_[3]{};
+    float inverse_direction_[3]{};
+    float position_[3]{};
+    float attenuation_[3]{};
+  };
+
+  // A fixed function material described in D3D terms, see SetLighting.
+  class Material {
+   public:
+    // NV097_SET_SPECULAR_PARAMS values matching D3D material powers (the derivation is not known).
+    static const uint32_t kSpecularParamsPower10[6];
+    static const uint32_t kSpecularParamsPower125[6];
+
+    Material() { SetSpecularParams(kSpecularParamsPower10); }
+
+    Material &SetDiffuse(const Color &color) {
+      diffuse_ = color;
+      return *this;
+    }
+    Material &SetSpecular(const Color &color) {
+      specular_ = color;
+      return *this;
+    }
+    Material &SetAmbient(const Color &color) {
+      ambient_ = color;
+      return *this;
+    }
+    Material &SetEmissive(const Color &color) {
+      emissive_ = color;
+      return *this;
+    }
+    Material &SetSpecularParams(const uint32_t *params) {
+      memcpy(specular_params_, params, sizeof(specular_params_));
+      return *this;
+    }
+
+   private:
+    friend class TestHost;
+
+    Color diffuse_{1.0f, 1.0f, 1.0f, 1.0f};
+    Color specular_{0.0f, 0.0f, 0.0f, 0.0f};
+    Color ambient_{0.0f, 0.0f, 0.0f, 0.0f};
+    Color emissive_{0.0f, 0.0f, 0.0f, 0.0f};
+    uint32_t specular_params_[6];
+  };
+
   enum PaletteSize {
     PALETTE_32 = 32,
     PALETTE_64 = 64,
@@ -207,6 +496,13 @@ class TestHost {
     AA_SQUARE_OFFSET_4 = NV097_SET_SURFACE_FORMAT_ANTI_ALIASING_SQUARE_OFFSET_4,
   };
 
+  enum ClearSurface {
+    CLEAR_NONE = 0,
+    CLEAR_COLOR = NV097_CLEAR_SURFACE_COLOR,
+    CLEAR_DEPTH_STENCIL = NV097_CLEAR_SURFACE_Z | NV097_CLEAR_SURFACE_STENCIL,
+    CLEAR_ALL = CLEAR_COLOR | CLEAR_DEPTH_STENCIL,
+  };
+
   enum SurfaceColorFormat {
     SCF_X1R5G5B5_Z1R5G5B5 = NV097_SET_SURFACE_FORMAT_COLOR_LE_X1R5G5B5_Z1R5G5B5,
     SCF_X1R5G5B5_O1R5G5B5 = NV097_SET_SURFACE_FORMAT_COLOR_LE_X1R5G5B5_O1R5G5B5,
@@ -225,6 +521,26 @@ class TestHost {
     SZF_Z24S8 = NV097_SET_SURFACE_FORMAT_ZETA_Z24S8
   };
 
+  // Categories of time spent while running a test.
+  enum TimingPhase {
+    TIMING_PREPARE_DRAW,      // PrepareDraw, excluding waits.
+    TIMING_BUILD_PUSHBUFFER,  // Test code between PrepareDraw and FinishDraw.
+    TIMING_GPU_WAIT,          // Waiting for the GPU to go idle.
+    TIMING_VBLANK_WAIT,       // Waiting for vertical blank.
+    TIMING_SAVE,              // Capturing results for saving.
+    TIMING_NUM_PHASES,
+  };
+
+  // Range of vertices within the current vertex buffer.
+  struct DrawRange {
+    uint32_t start;
+    uint32_t count;
+  };
+
+  struct TestTimings {
+    uint64_t ticks[TIMING_NUM_PHASES];
+  };
+
  public:
   TestHost(uint32_t framebuffer_width, uint32_t framebuffer_height, uint32_t max_texture_width,
            uint32_t max_texture_height, uint32_t max_texture_depth = 4);
@@ -235,10 +551,77 @@ class TestHost {
   void SetDefaultTextureParams(uint32_t stage = 0);
   int SetTexture(SDL_Surface *surface, uint32_t stage = 0);
   int SetVolumetricTexture(const SDL_Surface **surface, uint32_t depth, uint32_t stage = 0);
+  // Streams a `width` x `height` x `depth` volume from `generate_layer`, one layer at a time (see
+  // TextureStage::SetVolumetricTexture). The layers are not known in advance, so the upload is never skipped as
+  // resident, but the result is cached for later calls with the same layers.
+  int SetVolumetricTexture(uint32_t width, uint32_t height, uint32_t depth,
+                           const TextureStage::VolumeLayerGenerator &generate_layer, uint32_t stage = 0);
+  // Uploads `surface` along with `levels` - 1 box filtered mipmap levels (or a complete chain if `levels` is 0) and sets
+  // the stage's mipmap level count. The format must be swizzled. Generated chains are cached by source content, so
+  // repeated uploads of the same surface do not regenerate them.
+  int SetMipMappedTexture(SDL_Surface *surface, uint32_t levels = 0, bool gamma_correct = false, uint32_t stage = 0);
   int SetRawTexture(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint32_t pitch,
                     uint32_t bytes_per_pixel, bool swizzle, uint32_t stage = 0);
 
+  // Texture uploads are skipped if the stage's texture memory already holds an identical image (same content hash,
+  // format, dimensions, and swizzle mode). Tests that modify texture memory by other means must call
+  // InvalidateTextureCache.
+  void InvalidateTextureCache();
+
+  // Variants of SetTexture and SetRawTexture that convert the image once into staging memory and queue a pgraph image
+  // blit to copy it into the stage's texture memory. The copy is ordered with the surrounding pushbuffer commands, so
+  // it is safe to call while earlier draws sampling the same memory are still in flight. Staging memory is recycled
+  // once the GPU is known to be idle (e.g., in PrepareDraw); WaitForTextureUploads blocks until all copies are
+  // complete, which is only necessary before reading texture memory from the CPU.
+  int SetTextureAsync(SDL_Surface *surface, uint32_t stage = 0);
+  int SetRawTextureAsync(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint32_t pitch,
+                         uint32_t bytes_per_pixel, bool swizzle, uint32_t stage = 0);
+  void WaitForTextureUploads();
+
+  // Each stage is given its own allocation from the texture heap, grown as needed by SetTexture and friends.
+  // Alternatively, any number of allocations may be made up front and bound to a stage, allowing textures to remain
+  // resident across tests. Uploads to a stage write into its bound allocation.
+  TextureHeap::Handle AllocateTextureMemory(uint32_t size);
+  void FreeTextureMemory(TextureHeap::Handle handle);
+  // Points `stage` at the given allocation, or back at the stage's own allocation if `handle` is kInvalidHandle.
+  void BindTextureMemory(uint32_t stage, TextureHeap::Handle handle);
+
+  // Each stage keeps several palettes resident; switching to a palette that is already held just repoints the stage
+  // rather than rewriting palette memory. Like texture uploads, changes made by other means require
+  // InvalidateTextureCache.
   int SetPalette(const uint32_t *palette, PaletteSize size, uint32_t stage = 0);
+
+  // Returns an unused offscreen color surface of exactly the given dimensions and layout, reusing a previously released
+  // one if possible. Contents are undefined. Targets remain owned by TestHost and must be returned via
+  // ReleaseRenderTarget.
+  RenderTarget *AcquireRenderTarget(uint32_t width, uint32_t height, uint32_t bytes_per_pixel = 4,
+                                    bool swizzled = false);
+  void ReleaseRenderTarget(RenderTarget *target);
+  // Redirects color output into `target` until UnbindRenderTarget. The zeta surface is left in place, using
+  // `zeta_pitch` (or the framebuffer pitch if 0). The surface format and clip must still be configured by the caller,
+  // e.g., via SetRenderTargetSurfaceFormat. Swizzled surfaces also swizzle the zeta surface, so depth testing into a
+  // swizzled target larger than the framebuffer will overrun the depth buffer.
+  void BindRenderTarget(const RenderTarget *target, uint32_t zeta_pitch = 0);
+  // Sets the surface format, layout, and clip to match `target`, using the current depth buffer format.
+  void SetRenderTargetSurfaceFormat(const RenderTarget *target, SurfaceColorFormat color_format = SCF_A8R8G8B8) const;
+  // Points `stage` directly at the memory of `target` so that it may be sampled without a copy. The stage format and
+  // dimensions must be configured by the caller to match the target's layout. The next upload to the stage, or
+  // BindTextureMemory, returns the stage to texture memory.
+  void BindRenderTargetTexture(uint32_t stage, const RenderTarget *target);
+  // Queues `target` to be saved as `name` in `output_directory`, unswizzling it if necessary. Waits for the GPU to
+  // finish rendering into it first. Only 32bpp and 16bpp (R5G6B5) targets are supported.
+  void SaveRenderTarget(const RenderTarget *target, const std::string &output_directory, const std::string &name);
+  // Restores color output to the framebuffer (or the antialiased surface, see SetAntiAliasing).
+  void UnbindRenderTarget();
+
+  // Renders into offscreen color and zeta surfaces with the given multisampling mode instead of the framebuffer. Surface
+  // clip, viewport, and window coordinates remain in framebuffer units. Each frame is box filtered down into the back
+  // buffer before it is saved or presented; saved depth buffers keep every sample. Tiled rendering is disabled while
+  // antialiasing is enabled.
+  void SetAntiAliasing(AntiAliasingSetting aa);
+  AntiAliasingSetting GetAntiAliasing() const { return anti_aliasing_; }
+  // Retrieves the number of samples along each axis for the given mode.
+  static void GetAntiAliasingScale(AntiAliasingSetting aa, uint32_t &scale_x, uint32_t &scale_y);
   void SetTextureStageEnabled(uint32_t stage, bool enabled = true);
 
   void SetDepthBufferFormat(uint32_t fmt);
@@ -247,6 +630,14 @@ class TestHost {
   void SetDepthBufferFloatMode(bool enabled);
   bool GetDepthBufferFloatMode() const { return depth_buffer_mode_float_; }
 
+  // Returns the maximum depth value for the current depth buffer format and mode.
+  float GetMaxDepthValue() const;
+
+  // Returns the GPU address of the texture memory used by the given stage.
+  uint32_t GetTextureAddress(uint32_t stage) const {
+    return (reinterpret_cast<uint32_t>(texture_memory_) + texture_stage_[stage].texture_memory_offset_) & 0x03FFFFFF;
+  }
+
   uint32_t GetMaxTextureWidth() const { return max_texture_width_; }
   uint32_t GetMaxTextureHeight() const { return max_texture_height_; }
   uint32_t GetMaxTextureDepth() const { return max_texture_depth_; }
@@ -258,7 +649,10 @@ class TestHost {
   void SetVertexBuffer(std::shared_ptr<VertexBuffer> buffer);
   std::shared_ptr<VertexBuffer> GetVertexBuffer() { return vertex_buffer_; }
 
-  void Clear(uint32_t argb = 0xFF000000, uint32_t depth_value = 0xFFFFFFFF, uint8_t stencil_value = 0x00) const;
+  // Clears the given surfaces (a combination of ClearSurface flags) across the whole framebuffer with a single clear
+  // command, then erases the text overlay.
+  void Clear(uint32_t argb = 0xFF000000, uint32_t depth_value = 0xFFFFFFFF, uint8_t stencil_value = 0x00,
+             uint32_t surfaces = CLEAR_ALL) const;
   void SetDepthStencilRegion(uint32_t depth_value, uint8_t stencil_value, uint32_t left = 0, uint32_t top = 0,
                              uint32_t width = 0, uint32_t height = 0) const;
   void SetFillColorRegion(uint32_t argb, uint32_t left = 0, uint32_t top = 0, uint32_t width = 0,
@@ -269,27 +663,77 @@ class TestHost {
   // E.g., texture stages, shader states
   // This is not an exhaustive list and is not necessarily up to date. Prefer to call this just before initiating draw
   // and be suspect of order dependence if you see results that seem to indicate that settings are being ignored.
-  void PrepareDraw(uint32_t argb = 0xFF000000, uint32_t depth_value = 0xFFFFFFFF, uint8_t stencil_value = 0x00);
+  //
+  // Tests that overwrite every pixel of the color and/or depth buffer may omit those surfaces from `clear_surfaces` to
+  // skip clearing them.
+  void PrepareDraw(uint32_t argb = 0xFF000000, uint32_t depth_value = 0xFFFFFFFF, uint8_t stencil_value = 0x00,
+                   uint32_t clear_surfaces = CLEAR_ALL);
 
   void DrawArrays(uint32_t enabled_vertex_fields = kDefaultVertexFields, DrawPrimitive primitive = PRIMITIVE_TRIANGLES);
+  // Draws each range of the vertex buffer as a separate primitive, packing all of them into as few pushbuffer
+  // submissions as possible.
+  void MultiDrawArrays(const std::vector<DrawRange> &ranges, uint32_t enabled_vertex_fields = kDefaultVertexFields,
+                       DrawPrimitive primitive = PRIMITIVE_TRIANGLES);
   void DrawInlineBuffer(uint32_t enabled_vertex_fields = kDefaultVertexFields,
                         DrawPrimitive primitive = PRIMITIVE_TRIANGLES);
+  // Variant of DrawInlineBuffer whose per-vertex emitter is specialized for the given field mask at compile time.
+  template <uint32_t kEnabledVertexFields>
+  void DrawInlineBuffer(DrawPrimitive primitive = PRIMITIVE_TRIANGLES) {
+    DrawInlineBuffer(kEnabledVertexFields, primitive, InlineBufferEmitter<kEnabledVertexFields>::Emit);
+  }
 
   // Sends vertices as an interleaved array of vertex fields. E.g., [POS_0,DIFFUSE_0,POS_1,DIFFUSE_1,...]
   void DrawInlineArray(uint32_t enabled_vertex_fields = kDefaultVertexFields,
                        DrawPrimitive primitive = PRIMITIVE_TRIANGLES);
+  // Variant of DrawInlineArray whose per-vertex emitter is specialized for the given field mask at compile time.
+  template <uint32_t kEnabledVertexFields>
+  void DrawInlineArray(DrawPrimitive primitive = PRIMITIVE_TRIANGLES) {
+    DrawInlineArray(kEnabledVertexFields, primitive, InlineArrayEmitter<kEnabledVertexFields>::Emit);
+  }
 
   // Sends vertices via an index array. Index values must be < 0xFFFF and are sent two per command.
   void DrawInlineElements16(const std::vector<uint32_t> &indices, uint32_t enabled_vertex_fields = kDefaultVertexFields,
                             DrawPrimitive primitive = PRIMITIVE_TRIANGLES);
+  void DrawInlineElements16(const IndexBuffer &indices, uint32_t enabled_vertex_fields = kDefaultVertexFields,
+                            DrawPrimitive primitive = PRIMITIVE_TRIANGLES);
 
   // Sends vertices via an index array. Index values are unsigned integers.
   void DrawInlineElements32(const std::vector<uint32_t> &indices, uint32_t enabled_vertex_fields = kDefaultVertexFields,
                             DrawPrimitive primitive = PRIMITIVE_TRIANGLES);
 
+  // Saves the back buffer as `name` and, if `z_buffer_name` is not empty, the depth buffer as a 16-bit grayscale image
+  // named `z_buffer_name`. The stencil plane of Z24S8 buffers is saved alongside as `z_buffer_name`_S.
   void FinishDraw(bool allow_saving, const std::string &output_directory, const std::string &name,
                   const std::string &z_buffer_name = "");
 
+  // Creates the given folder and any missing parents. Folders that have already been created by this process are
+  // remembered and skipped.
+  static void EnsureFolderExists(const std::string &folder_path);
+
+  // Returns the value of the high resolution performance counter.
+  static uint64_t GetPerformanceCounter();
+  // Returns the number of performance counter ticks per second.
+  static uint64_t GetPerformanceFrequency();
+
+  // Clears accumulated per-phase timings, including GPU profiler stats.
+  void ResetTimings();
+  const TestTimings &GetTimings() const { return timings_; }
+
+  // When enabled, PrepareDraw, draws, clears, and texture copies are timed on the GPU via GetGpuProfiler. Completed
+  // scopes are resolved by FinishDraw.
+  void SetGpuProfilingEnabled(bool enable = true);
+  GpuProfiler &GetGpuProfiler() { return gpu_profiler_; }
+
+  // Blocks until all results queued by FinishDraw and all files posted to the I/O worker have been written to disk.
+  void WaitForPendingSaves() {
+    RetirePendingFrame();
+    capture_queue_.Flush();
+    io_worker_.Flush();
+  }
+
+  // Worker used to write result files and debug output off of the render thread.
+  IoWorker &GetIoWorker() { return io_worker_; }
+
   // Set the surface format
   // width and height are treated differently depending on whether swizzle is enabled or not.
   // swizzle = true
@@ -367,8 +811,166 @@ class TestHost {
   bool GetSaveResults() const { return save_results_; }
   void SetSaveResults(bool enable = true) { save_results_ = enable; }
 
+  // Selects the file format used when saving results. Non-PNG formats are intended to be converted by host tooling.
+  void SetSaveFormat(CaptureQueue::ImageFormat format) { save_format_ = format; }
+  CaptureQueue::ImageFormat GetSaveFormat() const { return save_format_; }
+
+  // When enabled, results whose hash matches the golden manifest in their output directory are not written to disk.
+  void SetSkipUnchangedResults(bool enable = true) { capture_queue_.SetSkipUnchanged(enable); }
+  // See CaptureQueue::SetCompareWithGolden.
+  void SetCompareWithGolden(bool enable = true, uint8_t tolerance = 0) {
+    capture_queue_.SetCompareWithGolden(enable, tolerance);
+  }
+  bool GetSkipUnchangedResults() const { return capture_queue_.GetSkipUnchanged(); }
+
+  // When enabled, all results for a given output directory are packed into a single archive file.
+  void SetArchiveResults(bool enable = true) { capture_queue_.SetArchiveResults(enable); }
+  bool GetArchiveResults() const { return capture_queue_.GetArchiveResults(); }
+
+  // Replaces the destination that saved results are written to (e.g., to stream them over the network).
+  void SetResultSink(std::unique_ptr<ResultSink> sink) { capture_queue_.SetResultSink(std::move(sink)); }
+
+  // See CaptureQueue::SetRecordResults.
+  void SetRecordResults(bool enable = true) { capture_queue_.SetRecordResults(enable); }
+  const CaptureQueue &GetCaptureQueue() const { return capture_queue_; }
+
+  // Returns the paths of the results queued for saving by FinishDraw and SaveRenderTarget since the last call. The
+  // files may not have been written yet, see WaitForPendingSaves.
+  std::vector<std::string> TakeQueuedResultFiles() { return std::move(queued_result_files_); }
+
+  // When enabled, PrepareDraw and FinishDraw synchronize with the GPU via a pushbuffer fence rather than waiting for
+  // vblank, and FinishDraw does not swap buffers, removing the refresh rate cap on test throughput. Frames are still
+  // saved but the screen is not updated.
+  void SetThroughputMode(bool enable = true) { throughput_mode_ = enable; }
+  bool GetThroughputMode() const { return throughput_mode_; }
+
+  // When enabled, DrawArrays, MultiDrawArrays and DrawInlineElements* bind any enabled attribute whose value is the same
+  // in every vertex of the buffer with a stride of 0, so that a single element is fetched for the whole draw. Explicit
+  // stride overrides take precedence. Disabled by default as it changes the fetch behavior under test.
+  void SetElideUniformAttributes(bool enable = true) { elide_uniform_attributes_ = enable; }
+
+  // When enabled, FinishDraw returns as soon as the frame has been submitted rather than waiting for the GPU, so the
+  // next test's setup (geometry generation, texture conversion, state recording) overlaps the current frame's
+  // rendering. The frame is captured and presented by the next PrepareDraw or GPU memory write, and SetTexture and
+  // SetRawTexture use their async variants. Implies throughput mode. Tests must not draw before calling PrepareDraw.
+  void SetPipelinedMode(bool enable = true);
+  bool GetPipelinedMode() const { return pipelined_mode_; }
+
+  // Blocks until the frame submitted by a pipelined FinishDraw, if any, has been captured and presented.
+  void RetirePendingFrame() { frame_pipeline_.Retire(); }
+
+  // When enabled, FinishDraw writes the pushbuffer commands submitted since PrepareDraw, along with the texture and
+  // vertex memory they reference, to "<name>.pbtrace" next to each saved result (see PushbufferTrace). State set
+  // before PrepareDraw is not part of the trace. Frames rendered into tiles are not captured.
+  void SetTraceCaptureEnabled(bool enable = true) { trace_capture_enabled_ = enable; }
+  bool GetTraceCaptureEnabled() const { return trace_capture_enabled_; }
+
+  // Sets the number of tests that TestSuite::RunAll batches into a single tiled frame for suites that support it. 0 or
+  // 1 disables tiling.
+  void SetMaxTilesPerFrame(uint32_t max_tiles) { max_tiles_per_frame_ = max_tiles; }
+  uint32_t GetMaxTilesPerFrame() const { return anti_aliasing_ == AA_CENTER_1 ? max_tiles_per_frame_ : 0; }
+
+  // Between BeginTiledFrame and EndTiledFrame, PrepareDraw renders into a framebuffer sized tile of an offscreen
+  // surface holding `num_tiles` tiles rather than into the framebuffer, without waiting for the GPU or presenting. Each
+  // tile is selected via SetTile before its test's PrepareDraw. FinishDraw only records the results to be saved, and
+  // EndTiledFrame waits for the GPU once and saves every recorded tile. The depth buffer is shared by all tiles, so
+  // depth captures wait for the GPU immediately.
+  void BeginTiledFrame(uint32_t num_tiles);
+  void SetTile(uint32_t index);
+  void EndTiledFrame();
+  bool IsTiledFrameActive() const { return tiled_frame_ != nullptr; }
+
+  // When enabled, FinishDraw renders only into the back buffer; text compositing and buffer swaps are skipped and
+  // metadata about each saved result is recorded for SaveResultMetadata instead.
+  void SetHeadless(bool enable = true) { headless_ = enable; }
+  bool GetHeadless() const { return headless_; }
+
+  // When enabled, FinishDraw hashes the completed back buffer (see HashSurface) for TakeFrameHash. Frames rendered into
+  // tiles are not hashed.
+  void SetHashFrames(bool enable = true) { hash_frames_ = enable; }
+  // Retrieves the hash of the last frame completed since the previous call, returning false if there was none.
+  bool TakeFrameHash(uint32_t &hash) {
+    hash = last_frame_hash_;
+    bool ret = frame_hash_valid_;
+    frame_hash_valid_ = false;
+    return ret;
+  }
+
+  // Composites the pbkit text screen into the back buffer unless running headless.
+  void DrawTextScreen() const;
+
+  // Writes the metadata recorded for results saved into `output_directory` while headless.
+  void SaveResultMetadata(const std::string &output_directory);
+
+  // Coalesces the pushbuffer commands issued by TestHost helpers until the matching EndCommandRecording. Commands
+  // pushed directly via pb_begin will be reordered relative to recorded ones unless FlushCommandRecording is called
+  // first. Calls may be nested.
+  void BeginCommandRecording() { command_recorder_.Start(); }
+  void FlushCommandRecording() { command_recorder_.Flush(); }
+  void EndCommandRecording() { command_recorder_.Stop(); }
+
+  // Surface, clip, viewport, fixed function matrix, control0, combiner, shader stage, and texture stage writes made
+  // through TestHost are dropped if they would not change the latched pgraph state. Tests that push any of these
+  // methods directly must call InvalidateRegisterShadow afterwards, or use SetForceStateWrites to push every write
+  // unconditionally.
+  void InvalidateRegisterShadow() { register_shadow_.Invalidate(); }
+  void SetForceStateWrites(bool force) { register_shadow_.SetForceWrites(force); }
+  // Pushes a prebuilt sequence of `num_dwords` dwords of 3D subchannel, incrementing method packets unconditionally
+  // and updates the register shadow to match, leaving any other tracked state intact.
+  void PushStateCommands(const uint32_t *commands, uint32_t num_dwords);
+
+  // Returns the graphics object of class `class_id` (e.g., NV04_SOLID_LINE), creating it on first use. Objects are
+  // created once per run on context channels from kNextContextChannel and shared by every suite that uses them.
+  const struct s_CtxDma &GetGraphicsObject(uint32_t class_id);
+  // Identifiers of the retargetable DMA contexts shared via BindDmaContext.
+  enum SharedDmaContextId {
+    // Source image of NV_IMAGE_BLIT operations.
+    DMA_CONTEXT_BLIT_SOURCE,
+  };
+
+  // Returns the DMA context identified by `id`, creating it on first use, and points it at [address, address + limit].
+  // Retargeting requires a series of interrupts that serialize the GPU, so it is skipped if the context already covers
+  // the given range.
+  const struct s_CtxDma &BindDmaContext(SharedDmaContextId id, const void *address, uint32_t limit);
+  // Binds `object` to `subchannel` (at or after kNextSubchannel) unless it is already bound there.
+  void BindSubchannel(uint32_t subchannel, const struct s_CtxDma &object);
+  // Returns a graphics object that may be used to clear an object slot (e.g., NV_IMAGE_BLIT_PATTERN).
+  const struct s_CtxDma &GetNullObject() {
+    InitializeHostContexts();
+    return null_ctx_;
+  }
+
+  // Maximum time any single GPU wait may take before it is abandoned and counted as a timeout.
+  static constexpr uint32_t kGpuWaitTimeoutMs = 5000;
+
+  // Inserts a fence into the pushbuffer and blocks until the GPU has processed all preceding commands. The waiting
+  // thread yields between polls. Returns false if the GPU did not become idle within `timeout_ms`.
+  static bool WaitForGpuIdle(uint32_t timeout_ms = kGpuWaitTimeoutMs);
+  // Blocks until the GPU has fetched every pushed command, without waiting for rendering to complete.
+  static bool WaitForPushbufferDrained(uint32_t timeout_ms = kGpuWaitTimeoutMs);
+  // Blocks until pbkit accepts a request to present the back buffer.
+  static bool WaitForFlip(uint32_t timeout_ms = kGpuWaitTimeoutMs);
+  // Returns the number of GPU waits that timed out since the last call.
+  static uint32_t TakeGpuTimeoutCount() { return std::exchange(gpu_timeout_count_, 0); }
+
   void SetAlphaBlendEnabled(bool enable = true) const;
 
+  // Applies every register in `state`. Groups of registers (e.g., the eight color input control words) that already
+  // match the bound state are skipped, so switching between similar states only sends the groups that differ.
+  void SetCombinerState(const CombinerState &state) const;
+
+  // Uploads `num_lights` lights, disabling the remainder, along with `material` lit by `scene_ambient`. The hardware
+  // takes the products of the light and material colors, which are computed here:
+  //   scene_ambient * material.ambient + material.emissive => NV097_SET_SCENE_AMBIENT_COLOR
+  //   scene_ambient * light.ambient => NV097_SET_LIGHT_AMBIENT_COLOR
+  //   material.diffuse * light.diffuse => NV097_SET_LIGHT_DIFFUSE_COLOR
+  //   material.specular * light.specular => NV097_SET_LIGHT_SPECULAR_COLOR
+  //   material.diffuse.a => NV097_SET_MATERIAL_ALPHA
+  // Every light's registers are written as a single packet, and the whole state is submitted together. Lighting
+  // itself, NV097_SET_LIGHT_CONTROL, and NV097_SET_COLOR_MATERIAL are left unchanged.
+  void SetLighting(const Color &scene_ambient, const Material &material, const Light *lights,
+                   uint32_t num_lights) const;
+
   // Sets up the number of enabled color combiners and behavior flags.
   //
   // same_factor0 == true will reuse the C0 constant across all enabled stages.
@@ -456,7 +1058,13 @@ class TestHost {
   // E.g., to have stage2 use stage1's input and stage3 use stage2's the params would be (1, 2).
   void SetShaderStageInput(uint32_t stage_2_input = 0, uint32_t stage_3_input = 0) const;
 
-  void SetVertexBufferAttributes(uint32_t enabled_fields);
+  // Binds the given register combiner/shader stage program. Binding a program whose values are still latched is a
+  // no-op.
+  void SetPixelShaderProgram(const PixelShaderProgram &program) const;
+
+  // Binds the enabled attributes of the current vertex buffer. If `allow_uniform_elision` is set and uniform attribute
+  // elision is enabled, attributes that hold the same value in every vertex are fetched with a stride of 0.
+  void SetVertexBufferAttributes(uint32_t enabled_fields, bool allow_uniform_elision = false);
 
   // Overrides the default calculation of stride for a vertex attribute. "0" is special cased by the hardware to cause
   // all reads for the attribute to be serviced by the first value in the buffer.
@@ -476,16 +1084,49 @@ class TestHost {
   void SetupTextureStages() const;
 
  private:
-  uint32_t MakeInputCombiner(CombinerSource a_source, bool a_alpha, CombinerMapping a_mapping, CombinerSource b_source,
-                             bool b_alpha, CombinerMapping b_mapping, CombinerSource c_source, bool c_alpha,
-                             CombinerMapping c_mapping, CombinerSource d_source, bool d_alpha,
-                             CombinerMapping d_mapping) const;
-  uint32_t MakeOutputCombiner(CombinerDest ab_dst, CombinerDest cd_dst, CombinerDest sum_dst, bool ab_dot_product,
-                              bool cd_dot_product, CombinerSumMuxMode sum_or_mux, CombinerOutOp op) const;
-  static void EnsureFolderExists(const std::string &folder_path);
-  static std::string PrepareSaveFilePNG(std::string output_directory, const std::string &filename);
-  static void SaveBackBuffer(const std::string &output_directory, const std::string &name);
-  void SaveZBuffer(const std::string &output_directory, const std::string &name) const;
+  static std::string PrepareSaveFile(std::string output_directory, const std::string &filename,
+                                     const char *extension = ".png");
+  // Adds the files SaveFrame will produce for the given result to queued_result_files_.
+  void RecordQueuedResultFiles(const std::string &output_directory, const std::string &name,
+                               const std::string &z_buffer_name);
+  void SaveBackBuffer(const std::string &output_directory, const std::string &name);
+  void SaveZBuffer(const std::string &output_directory, const std::string &name);
+
+  // Pushes a begin/end pair wrapping NV097_DRAW_ARRAYS commands for each of the given ranges.
+  static void PushDrawArrays(const DrawRange *ranges, uint32_t num_ranges, DrawPrimitive primitive);
+
+  // Inline draw implementations using the given per-vertex emitter. The public runtime mask variants select a
+  // specialized emitter for commonly used masks.
+  void DrawInlineBuffer(uint32_t enabled_vertex_fields, DrawPrimitive primitive, InlineVertexEmitter emit);
+  void DrawInlineArray(uint32_t enabled_vertex_fields, DrawPrimitive primitive, InlineVertexEmitter emit);
+
+  // Adds the time since `start` to the given phase, returning the current counter value.
+  uint64_t AccumulateTiming(TimingPhase phase, uint64_t start);
+
+  // Points the color surface at the current tile of the tiled frame.
+  void BindTile();
+  // Points the color and zeta surfaces at the antialiased targets.
+  void BindAntiAliasedTargets();
+  // Averages the samples of the antialiased color target into the back buffer.
+  void ResolveAntiAliasedFrame();
+  // Records the hash of the back buffer for TakeFrameHash. The GPU must be idle.
+  void HashBackBuffer();
+  // Queues the back buffer and optional depth buffer for saving. The GPU must be idle.
+  void SaveFrame(const std::string &output_directory, const std::string &name, const std::string &z_buffer_name);
+  // Completes a frame submitted by a pipelined FinishDraw.
+  void CompleteFrame(bool perform_save, const std::string &output_directory, const std::string &name,
+                     const std::string &z_buffer_name);
+  void RecordResultMetadata(const std::string &output_directory, const std::string &name,
+                            const std::string &z_buffer_name);
+  // Writes the commands pushed since `trace_start_` and the memory they reference to a trace file.
+  void CaptureTrace(const std::string &output_directory, const std::string &name);
+
+  // Set of folders that are known to exist.
+  static std::set<std::string> created_folders_;
+
+  // Polls `busy` until it returns zero, yielding the CPU between polls. Returns false after `timeout_ms`.
+  static bool WaitWhileBusy(bool (*busy)(), uint32_t timeout_ms, const char *operation);
+  static uint32_t gpu_timeout_count_;
 
  private:
   uint32_t framebuffer_width_;
@@ -497,14 +1138,131 @@ class TestHost {
 
   TextureStage texture_stage_[4];
 
+  // Describes the image most recently uploaded into a texture heap allocation.
+  static constexpr uint32_t kRawTextureFormat = 0xFFFFFFFF;
+  struct ResidentTexture {
+    uint32_t content_hash{0};
+    uint32_t xbox_format{0};
+    bool swizzle{false};
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t depth{0};
+    uint32_t pitch{0};
+    uint32_t bytes_per_pixel{0};
+    uint32_t mipmap_levels{1};
+    bool gamma_correct_mipmaps{false};
+    CompressionQuality compression_quality{COMPRESSION_FAST};
+
+    bool operator==(const ResidentTexture &other) const {
+      return content_hash == other.content_hash && xbox_format == other.xbox_format && swizzle == other.swizzle &&
+             width == other.width && height == other.height && depth == other.depth && pitch == other.pitch &&
+             bytes_per_pixel == other.bytes_per_pixel && mipmap_levels == other.mipmap_levels &&
+             gamma_correct_mipmaps == other.gamma_correct_mipmaps && compression_quality == other.compression_quality;
+    }
+  };
+
+  struct MipMapChainKey {
+    uint32_t content_hash;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    bool gamma_correct;
+
+    bool operator<(const MipMapChainKey &other) const {
+      return std::tie(content_hash, width, height, levels, gamma_correct) <
+             std::tie(other.content_hash, other.width, other.height, other.levels, other.gamma_correct);
+    }
+  };
+
+  // Returns the allocation that uploads to `stage` should target, (re)allocating the stage's own memory if necessary to
+  // hold `size` bytes.
+  TextureHeap::Handle PrepareTextureMemory(uint32_t stage, uint32_t size);
+  bool IsTextureResident(TextureHeap::Handle handle, const ResidentTexture &key) const;
+  static ResidentTexture MakeSurfaceKey(const SDL_Surface *surface, const TextureStage &texture_stage);
+
+  // Returns `size` bytes of staging memory for an async texture upload, waiting for the GPU to release previously queued
+  // uploads if necessary.
+  uint8_t *ReserveTextureStaging(uint32_t size);
+  // Queues a pgraph copy of `size` bytes from `source` (in staging memory) to the given texture heap allocation.
+  void QueueTextureCopy(const uint8_t *source, TextureHeap::Handle handle, uint32_t size);
+  void InitializeHostContexts();
+
+  TextureHeap texture_heap_;
+  TextureHeap::Handle stage_texture_memory_[4]{TextureHeap::kInvalidHandle, TextureHeap::kInvalidHandle,
+                                               TextureHeap::kInvalidHandle, TextureHeap::kInvalidHandle};
+  TextureHeap::Handle bound_texture_memory_[4]{TextureHeap::kInvalidHandle, TextureHeap::kInvalidHandle,
+                                               TextureHeap::kInvalidHandle, TextureHeap::kInvalidHandle};
+  std::map<TextureHeap::Handle, ResidentTexture> resident_textures_;
+
+  // Each palette slot is large enough for a 256 entry palette, which also keeps slots aligned to the 64 bytes required
+  // by NV097_SET_TEXTURE_PALETTE.
+  static constexpr uint32_t kPaletteSlotSize = 256 * 4;
+  static constexpr uint32_t kPaletteSlotsPerStage = 4;
+  struct PaletteSlot {
+    uint32_t content_hash{0};
+    // Number of entries, 0 if the slot is unused.
+    uint32_t size{0};
+    uint32_t last_use{0};
+  };
+  static uint32_t GetPaletteSlotOffset(uint32_t stage, uint32_t slot) {
+    return (stage * kPaletteSlotsPerStage + slot) * kPaletteSlotSize;
+  }
+  PaletteSlot palette_slots_[4][kPaletteSlotsPerStage];
+  uint32_t palette_use_counter_{0};
+  // Mipmap chains generated by SetMipMappedTexture, in ARGB8888.
+  std::map<MipMapChainKey, std::vector<SDL_Surface *>> mipmap_chains_;
+
   uint32_t depth_buffer_format_{NV097_SET_SURFACE_FORMAT_ZETA_Z24S8};
   bool depth_buffer_mode_float_{false};
   std::shared_ptr<VertexShaderProgram> vertex_shader_program_{};
 
   std::shared_ptr<VertexBuffer> vertex_buffer_{};
   uint8_t *texture_memory_{nullptr};
+  uint32_t texture_memory_size_{0};
   uint8_t *texture_palette_memory_{nullptr};
 
+  // Source buffer for async texture uploads, allocated on first use.
+  uint8_t *texture_staging_memory_{nullptr};
+  uint32_t texture_staging_size_{0};
+  uint32_t texture_staging_used_{0};
+  // Created on first use by texture uploads and render targets. The DMA context covers all of RAM so that any
+  // contiguous allocation can be addressed by its physical address.
+  bool host_contexts_initialized_{false};
+  struct s_CtxDma physical_memory_dma_ctx_ {};
+  struct s_CtxDma null_ctx_ {};
+
+  // Objects created by GetGraphicsObject, keyed by class.
+  std::map<uint32_t, struct s_CtxDma> graphics_objects_;
+  struct SharedDmaContext {
+    struct s_CtxDma context {};
+    const void *address{nullptr};
+    uint32_t limit{0};
+  };
+  // Contexts created by BindDmaContext.
+  std::map<SharedDmaContextId, SharedDmaContext> dma_contexts_;
+  uint32_t next_context_channel_{kNextContextChannel};
+  // ChannelID of the object bound to each subchannel by BindSubchannel, 0 if none.
+  uint32_t subchannel_objects_[8]{};
+
+  std::vector<std::unique_ptr<RenderTarget>> render_targets_;
+
+  AntiAliasingSetting anti_aliasing_{AA_CENTER_1};
+  // Multisampled surfaces used in place of the framebuffer while anti_aliasing_ is not AA_CENTER_1.
+  RenderTarget *aa_color_target_{nullptr};
+  RenderTarget *aa_zeta_target_{nullptr};
+
+  uint32_t max_tiles_per_frame_{0};
+  RenderTarget *tiled_frame_{nullptr};
+  uint32_t num_tiles_{0};
+  uint32_t current_tile_{0};
+  struct PendingTile {
+    std::string output_directory;
+    std::string name;
+    std::string z_buffer_name;
+    uint32_t tile;
+  };
+  std::vector<PendingTile> pending_tiles_;
+
   enum FixedFunctionMatrixSetting {
     MATRIX_MODE_DEFAULT_NXDK,
     MATRIX_MODE_DEFAULT_XDK,
@@ -512,9 +1270,38 @@ class TestHost {
   };
   FixedFunctionMatrixSetting fixed_function_matrix_mode_{MATRIX_MODE_DEFAULT_NXDK};
   MATRIX fixed_function_model_view_matrix_{};
+  MATRIX fixed_function_inverse_model_view_matrix_{};
+  bool fixed_function_inverse_valid_{false};
   MATRIX fixed_function_projection_matrix_{};
 
   bool save_results_{true};
+  bool throughput_mode_{false};
+  bool elide_uniform_attributes_{false};
+  bool pipelined_mode_{false};
+  bool trace_capture_enabled_{false};
+  // Pushbuffer position at the start of the frame being captured, if any.
+  uint32_t *trace_start_{nullptr};
+  bool headless_{false};
+  bool hash_frames_{false};
+  bool frame_hash_valid_{false};
+  uint32_t last_frame_hash_{0};
+  // Map of output directory to the metadata lines for results saved to it while headless.
+  std::map<std::string, std::vector<std::string>> result_metadata_;
+  std::vector<std::string> queued_result_files_;
+  CaptureQueue::ImageFormat save_format_{CaptureQueue::FORMAT_PNG};
+  // Declared before capture_queue_ so that it outlives any messages logged while the queue shuts down.
+  IoWorker io_worker_;
+  CaptureQueue capture_queue_;
+  CommandRecorder command_recorder_;
+  FramePipeline frame_pipeline_;
+  // Mutable as state setters are const.
+  mutable RegisterShadow register_shadow_;
+  // Mutable as Clear is const.
+  mutable GpuProfiler gpu_profiler_;
+
+  TestTimings timings_{};
+  // Counter value at the end of the last PrepareDraw, used to measure pushbuffer construction time.
+  uint64_t last_prepare_draw_end_{0};
 
   uint32_t vertex_attribute_stride_override_[16]{
       kNoStrideOverride, kNoStrideOverride, kNoStrideOverride, kNoStrideOverride, kNoStrideOverride, kNoStrideOverride,
@@ -0,0 +1,30 @@
+#include "test_suite_registry.h"
+
+#include "debug_output.h"
+#include "tests/test_suite.h"
+
+void TestSuiteRegistry::Register(std::string name, Factory factory) {
+  entries_.push_back({std::move(name), std::move(factory), nullptr});
+}
+
+void TestSuiteRegistry::RetainSuites(const std::function<bool(const std::string &)> &predicate) {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (predicate(it->name)) {
+      ++it;
+    } else {
+      it = entries_.erase(it);
+    }
+  }
+}
+
+std::shared_ptr<TestSuite> TestSuiteRegistry::Get(uint32_t index) {
+  auto &entry = entries_[index];
+  if (!entry.suite) {
+    entry.suite = entry.factory();
+    ASSERT(entry.suite->Name() == entry.name && "Registered suite name does not match TestSuite::Name.");
+    if (setup_) {
+      setup_(*entry.suite);
+    }
+  }
+  return entry.suite;
+}
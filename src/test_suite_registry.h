@@ -0,0 +1,54 @@
+#ifndef NXDK_PGRAPH_TESTS_TEST_SUITE_REGISTRY_H
+#define NXDK_PGRAPH_TESTS_TEST_SUITE_REGISTRY_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class TestHost;
+class TestSuite;
+
+// Ordered list of test suites that are only constructed (and thus only build their test tables) when first accessed.
+class TestSuiteRegistry {
+ public:
+  using Factory = std::function<std::shared_ptr<TestSuite>()>;
+  // Invoked on each suite immediately after it is constructed (e.g., to remove unselected tests).
+  using Setup = std::function<void(TestSuite &)>;
+
+ public:
+  // `name` must match the TestSuite::Name of the constructed suite.
+  void Register(std::string name, Factory factory);
+
+  template <typename T>
+  void Register(std::string name, TestHost &host, const std::string &output_directory) {
+    Register(std::move(name), [&host, output_directory]() { return std::make_shared<T>(host, output_directory); });
+  }
+
+  void SetSetup(Setup setup) { setup_ = std::move(setup); }
+
+  // Unregisters every suite for which `predicate(name)` returns false, without constructing any of them.
+  void RetainSuites(const std::function<bool(const std::string &)> &predicate);
+
+  uint32_t GetNumSuites() const { return entries_.size(); }
+  const std::string &GetName(uint32_t index) const { return entries_[index].name; }
+
+  // Returns the suite at `index`, constructing it on first use.
+  std::shared_ptr<TestSuite> Get(uint32_t index);
+  // Drops the registry's reference to the suite at `index`. It is destroyed once no other references remain and will
+  // be reconstructed by the next Get.
+  void Release(uint32_t index) { entries_[index].suite.reset(); }
+
+ private:
+  struct Entry {
+    std::string name;
+    Factory factory;
+    std::shared_ptr<TestSuite> suite;
+  };
+
+  std::vector<Entry> entries_;
+  Setup setup_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_TEST_SUITE_REGISTRY_H
@@ -0,0 +1,75 @@
+#include "test_table.h"
+
+#include <algorithm>
+
+TestTable::Test &TestTable::operator[](std::string name) {
+  entries_.push_back({std::move(name), 0, nullptr});
+  sorted_ = false;
+  return entries_.back().test;
+}
+
+void TestTable::clear() {
+  entries_.clear();
+  sorted_ = true;
+}
+
+const TestTable::Entry &TestTable::At(uint32_t index) const {
+  Sort();
+  return entries_[index];
+}
+
+uint32_t TestTable::FindByName(const std::string &name) const {
+  Sort();
+  auto it = std::lower_bound(entries_.begin(), entries_.end(), name,
+                             [](const Entry &entry, const std::string &value) { return entry.name < value; });
+  if (it == entries_.end() || it->name != name) {
+    return kInvalidIndex;
+  }
+  return it - entries_.begin();
+}
+
+uint32_t TestTable::FindById(TestId id) const {
+  Sort();
+  // IDs are assigned in name order, so the table is also ordered by ID.
+  auto it = std::lower_bound(entries_.begin(), entries_.end(), id,
+                             [](const Entry &entry, TestId value) { return entry.id < value; });
+  if (it == entries_.end() || it->id != id) {
+    return kInvalidIndex;
+  }
+  return it - entries_.begin();
+}
+
+void TestTable::Retain(const std::function<bool(const Entry &)> &predicate) {
+  Sort();
+  entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                [&predicate](const Entry &entry) { return !predicate(entry); }),
+                 entries_.end());
+}
+
+void TestTable::Sort() const {
+  if (sorted_) {
+    return;
+  }
+  sorted_ = true;
+
+  std::stable_sort(entries_.begin(), entries_.end(),
+                   [](const Entry &a, const Entry &b) { return a.name < b.name; });
+
+  // Keep the last registration of each name.
+  auto out = entries_.begin();
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    auto next = it + 1;
+    if (next != entries_.end() && next->name == it->name) {
+      continue;
+    }
+    if (out != it) {
+      *out = std::move(*it);
+    }
+    ++out;
+  }
+  entries_.erase(out, entries_.end());
+
+  for (uint32_t i = 0; i < entries_.size(); ++i) {
+    entries_[i].id = i;
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef NXDK_PGRAPH_TESTS_TEST_TABLE_H
+#define NXDK_PGRAPH_TESTS_TEST_TABLE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Flat table of the tests provided by a TestSuite, ordered by name.
+//
+// Tests are appended to a contiguous vector as they are registered. The first query after registration sorts the
+// table by name once, discarding all but the last registration of any duplicated name, and assigns each test an ID
+// equal to its sorted position. IDs are not changed by Remove, so they continue to identify the same test after the
+// table has been filtered.
+class TestTable {
+ public:
+  using TestId = uint32_t;
+  using Test = std::function<void()>;
+
+  struct Entry {
+    std::string name;
+    TestId id;
+    Test test;
+  };
+
+  static constexpr uint32_t kInvalidIndex = 0xFFFFFFFF;
+
+ public:
+  // Registers a test named `name`, returning the callable to be assigned. Registering a name again replaces the
+  // earlier test.
+  Test &operator[](std::string name);
+
+  void clear();
+  bool empty() const { return entries_.empty(); }
+  uint32_t size() const { return entries_.size(); }
+
+  // Returns the entry at `index`. Entries are ordered by name.
+  const Entry &At(uint32_t index) const;
+
+  // Returns the index of the named test or the test with the given ID, or kInvalidIndex if there is no such test.
+  uint32_t FindByName(const std::string &name) const;
+  uint32_t FindById(TestId id) const;
+
+  // Removes every test for which `predicate(entry)` returns false.
+  void Retain(const std::function<bool(const Entry &)> &predicate);
+
+ private:
+  void Sort() const;
+
+ private:
+  mutable std::vector<Entry> entries_;
+  mutable bool sorted_{true};
+};
+
+#endif  // NXDK_PGRAPH_TESTS_TEST_TABLE_H
@@ -4,6 +4,7 @@
 
 #include "../test_host.h"
 #include "debug_output.h"
+#include "parameter_sweep.h"
 #include "pbkit_ext.h"
 #include "shaders/precalculated_vertex_shader.h"
 #include "vertex_buffer.h"
@@ -50,14 +51,17 @@ static TestHost::VertexAttribute TestAttributeToVertexAttribute(AttributeCarryov
 
 AttributeCarryoverTests::AttributeCarryoverTests(TestHost &host, std::string output_dir)
     : TestSuite(host, std::move(output_dir), "Attrib carryover") {
-  for (auto primitive : kPrimitives) {
-    for (auto attr : kTestAttributes) {
-      for (auto config : kTestConfigs) {
-        std::string name = MakeTestName(primitive, attr, config);
-        tests_[name] = [this, primitive, attr, config]() { this->Test(primitive, attr, config); };
-      }
-    }
-  }
+  ParameterSweep sweep(Name());
+  sweep.AddAxis("primitive", kPrimitives);
+  sweep.AddAxis("attribute", kTestAttributes);
+  sweep.AddAxis("config", kTestConfigs);
+  sweep.ForEach([this](const ParameterSweep::Combination &combination) {
+    const auto primitive = kPrimitives[combination[0]];
+    const auto attr = kTestAttributes[combination[1]];
+    const auto config = kTestConfigs[combination[2]];
+    std::string name = MakeTestName(primitive, attr, config);
+    tests_[name] = [this, primitive, attr, config]() { this->Test(primitive, attr, config); };
+  });
 }
 
 void AttributeCarryoverTests::Initialize() {
@@ -268,7 +272,7 @@ void AttributeCarryoverTests::Test(TestHost::DrawPrimitive primitive, Attribute
 
   std::string name = MakeTestName(primitive, test_attribute, config);
   pb_print("%s", name.c_str());
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, name);
 }
@@ -580,7 +580,7 @@ void AttributeExplicitSetterTests::Test(const TestConfig& config) {
 #undef DO_DRAW
 
   pb_printat(0, 0, (char*)config.test_name);
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, config.test_name);
 }
@@ -0,0 +1,158 @@
+#include "attribute_format_tests.h"
+
+#include <pbkit/pbkit.h>
+
+#include <cmath>
+
+#include "debug_output.h"
+#include "nxdk_ext.h"
+#include "shaders/precalculated_vertex_shader.h"
+#include "shaders/vertex_program_assembler.h"
+#include "test_host.h"
+
+// clang-format off
+static constexpr AttributeFormatTests::FormatTest kFormatTests[] = {
+    {"Position_Short", NV2A_VERTEX_ATTR_POSITION, VertexBuffer::ATTRIBUTE_FORMAT_SHORT},
+    {"Normal_NormalizedShort", NV2A_VERTEX_ATTR_NORMAL, VertexBuffer::ATTRIBUTE_FORMAT_NORMALIZED_SHORT},
+    {"Normal_NormPacked3", NV2A_VERTEX_ATTR_NORMAL, VertexBuffer::ATTRIBUTE_FORMAT_NORMPACKED3},
+    {"Diffuse_D3DColor", NV2A_VERTEX_ATTR_DIFFUSE, VertexBuffer::ATTRIBUTE_FORMAT_D3DCOLOR},
+    {"Diffuse_NormalizedShort", NV2A_VERTEX_ATTR_DIFFUSE, VertexBuffer::ATTRIBUTE_FORMAT_NORMALIZED_SHORT},
+};
+
+static constexpr AttributeFormatTests::DrawMode kDrawModes[] = {
+    AttributeFormatTests::DRAW_ARRAYS,
+    AttributeFormatTests::DRAW_INLINE_ARRAY,
+};
+// clang-format on
+
+static constexpr uint32_t kColumns = 8;
+static constexpr uint32_t kRows = 12;
+static constexpr uint32_t kNumVertices = kColumns * kRows * 6;
+// Cells are not a whole number of pixels, so positions stored as shorts are visibly rounded.
+static constexpr float kCellWidth = 23.3f;
+static constexpr float kCellHeight = 27.7f;
+static constexpr float kTop = 56.0f;
+static constexpr float kReferenceLeft = 60.0f;
+static constexpr float kTestLeft = 360.0f;
+
+static constexpr uint32_t kVertexFields = TestHost::POSITION | TestHost::NORMAL | TestHost::DIFFUSE;
+
+AttributeFormatTests::AttributeFormatTests(TestHost &host, std::string output_dir)
+    : TestSuite(host, std::move(output_dir), "Attribute format") {
+  for (auto &format_test : kFormatTests) {
+    for (auto draw_mode : kDrawModes) {
+      tests_[MakeTestName(format_test, draw_mode)] = [this, &format_test, draw_mode]() {
+        Test(format_test, draw_mode);
+      };
+    }
+  }
+}
+
+void AttributeFormatTests::Initialize() {
+  TestSuite::Initialize();
+
+  diffuse_shader_ = std::make_shared<PrecalculatedVertexShader>();
+
+  // Displays the normal as a color, mapping each component from [-1, 1] to [0, 1].
+  using VPA = VertexProgramAssembler;
+  VPA vp;
+  vp.Mov(VPA::Output(VPA::OUT_POSITION), VPA::V(0))
+      .Mad(VPA::Output(VPA::OUT_DIFFUSE, VPA::MASK_XYZ), VPA::V(2), VPA::C(0).Swizzle("x"), VPA::C(0).Swizzle("x"))
+      .Mov(VPA::Output(VPA::OUT_DIFFUSE, VPA::MASK_W), VPA::C(0).Swizzle("y"));
+  auto &program = vp.Assemble();
+  normal_shader_ = std::make_shared<VertexShaderProgram>();
+  normal_shader_->SetShaderOverride(program.data(), program.size() * sizeof(uint32_t));
+  normal_shader_->SetUniformF(0, 0.5f, 1.0f);
+
+  reference_buffer_ = host_.AllocateVertexBuffer(kNumVertices);
+  CreateGeometry(*reference_buffer_, kReferenceLeft);
+  test_buffer_ = host_.AllocateVertexBuffer(kNumVertices);
+  CreateGeometry(*test_buffer_, kTestLeft);
+}
+
+void AttributeFormatTests::Deinitialize() {
+  host_.SetVertexShaderProgram(nullptr);
+  host_.SetVertexBuffer(nullptr);
+  diffuse_shader_.reset();
+  normal_shader_.reset();
+  reference_buffer_.reset();
+  test_buffer_.reset();
+  TestSuite::Deinitialize();
+}
+
+void AttributeFormatTests::CreateGeometry(VertexBuffer &buffer, float left) const {
+  const float width = kCellWidth * kColumns;
+  const float height = kCellHeight * kRows;
+
+  // Each corner of a cell takes a color and a normal derived from its position within the grid, so that the rounding
+  // of every format is visible as banding across the gradients.
+  auto set_vertex = [left, width, height](Vertex *vertex, uint32_t column, uint32_t row) {
+    const float u = static_cast<float>(column) / kColumns;
+    const float v = static_cast<float>(row) / kRows;
+    vertex->SetPosition(left + u * width, kTop + v * height, 0.0f);
+
+    const float nx = u * 2.0f - 1.0f;
+    const float ny = v * 2.0f - 1.0f;
+    const float nz = 0.5f;
+    const float scale = 1.0f / sqrtf(nx * nx + ny * ny + nz * nz);
+    vertex->SetNormal(nx * scale, ny * scale, nz * scale);
+
+    vertex->SetDiffuse(u, v, 1.0f - u * v, 1.0f);
+  };
+
+  Vertex *vertex = buffer.Lock();
+  for (uint32_t row = 0; row < kRows; ++row) {
+    for (uint32_t column = 0; column < kColumns; ++column) {
+      set_vertex(vertex++, column, row);
+      set_vertex(vertex++, column + 1, row);
+      set_vertex(vertex++, column + 1, row + 1);
+
+      set_vertex(vertex++, column, row);
+      set_vertex(vertex++, column + 1, row + 1);
+      set_vertex(vertex++, column, row + 1);
+    }
+  }
+  buffer.Unlock();
+}
+
+void AttributeFormatTests::Draw(DrawMode draw_mode) {
+  switch (draw_mode) {
+    case DRAW_ARRAYS:
+      host_.DrawArrays(kVertexFields);
+      break;
+
+    case DRAW_INLINE_ARRAY:
+      host_.DrawInlineArray(kVertexFields);
+      break;
+  }
+}
+
+void AttributeFormatTests::Test(const FormatTest &format_test, DrawMode draw_mode) {
+  host_.SetVertexShaderProgram(format_test.attribute == NV2A_VERTEX_ATTR_NORMAL ? normal_shader_ : diffuse_shader_);
+  test_buffer_->SetAttributeFormat(format_test.attribute, format_test.format);
+
+  host_.PrepareDraw(0xFE202020);
+
+  host_.SetVertexBuffer(reference_buffer_);
+  Draw(draw_mode);
+  host_.SetVertexBuffer(test_buffer_);
+  Draw(draw_mode);
+
+  std::string name = MakeTestName(format_test, draw_mode);
+  pb_print("%s\n", name.c_str());
+  pb_printat(15, 10, (char *)"Float");
+  pb_printat(15, 34, (char *)"Compact");
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(allow_saving_, output_dir_, name);
+
+  // The compact copy of the vertices is rebuilt by the next test, so the frame must no longer reference it.
+  host_.RetirePendingFrame();
+  test_buffer_->SetAttributeFormat(format_test.attribute, VertexBuffer::ATTRIBUTE_FORMAT_FLOAT);
+}
+
+std::string AttributeFormatTests::MakeTestName(const FormatTest &format_test, DrawMode draw_mode) {
+  std::string ret = format_test.name;
+  ret += draw_mode == DRAW_ARRAYS ? "_DrawArrays" : "_InlineArray";
+  return ret;
+}
@@ -0,0 +1,49 @@
+#ifndef NXDK_PGRAPH_TESTS_ATTRIBUTE_FORMAT_TESTS_H
+#define NXDK_PGRAPH_TESTS_ATTRIBUTE_FORMAT_TESTS_H
+
+#include <memory>
+#include <string>
+
+#include "test_suite.h"
+#include "vertex_buffer.h"
+
+class TestHost;
+class VertexShaderProgram;
+
+// Tests the hardware conversion of each compact vertex attribute storage format by drawing the same geometry from float
+// attributes (left) and from the format under test (right).
+class AttributeFormatTests : public TestSuite {
+ public:
+  enum DrawMode {
+    DRAW_ARRAYS,
+    DRAW_INLINE_ARRAY,
+  };
+
+  struct FormatTest {
+    const char *name;
+    // NV2A_VERTEX_ATTR_* index of the attribute stored in `format`.
+    uint32_t attribute;
+    VertexBuffer::AttributeFormat format;
+  };
+
+ public:
+  AttributeFormatTests(TestHost &host, std::string output_dir);
+  void Initialize() override;
+  void Deinitialize() override;
+
+ private:
+  void CreateGeometry(VertexBuffer &buffer, float left) const;
+  void Test(const FormatTest &format_test, DrawMode draw_mode);
+  void Draw(DrawMode draw_mode);
+
+  static std::string MakeTestName(const FormatTest &format_test, DrawMode draw_mode);
+
+ private:
+  std::shared_ptr<VertexShaderProgram> diffuse_shader_;
+  std::shared_ptr<VertexShaderProgram> normal_shader_;
+
+  std::shared_ptr<VertexBuffer> reference_buffer_;
+  std::shared_ptr<VertexBuffer> test_buffer_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_ATTRIBUTE_FORMAT_TESTS_H
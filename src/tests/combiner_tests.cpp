@@ -9,6 +9,45 @@
 static constexpr const char* kMuxTestName = "Mux";
 static constexpr const char* kIndependenceTestName = "Independence";
 
+static constexpr TestHost::CombinerState kMuxState =
+    TestHost::CombinerState(TestSuite::kDefaultCombinerState)
+        .SetCombinerControl(2, false, false, false)
+        // TODO: Test behavior when r0 is not explicitly set.
+        .SetInputColorCombiner(0, TestHost::OneInput(), TestHost::OneInput())
+        .SetOutputColorCombiner(0, TestHost::DST_R0)
+        .SetInputAlphaCombiner(0, TestHost::AlphaInput(TestHost::SRC_C0), TestHost::OneInput())
+        .SetOutputAlphaCombiner(0, TestHost::DST_R0)
+        .SetInputColorCombiner(1, TestHost::ColorInput(TestHost::SRC_C0), TestHost::OneInput(),
+                               TestHost::ColorInput(TestHost::SRC_C1), TestHost::OneInput())
+        .SetOutputColorCombiner(1, TestHost::DST_DISCARD, TestHost::DST_DISCARD, TestHost::DST_DIFFUSE, false, false,
+                                TestHost::SM_MUX)
+        .SetInputAlphaCombiner(1, TestHost::OneInput(), TestHost::OneInput())
+        .SetOutputAlphaCombiner(1, TestHost::DST_DIFFUSE)
+        .SetFinalCombiner0Just(TestHost::SRC_DIFFUSE)
+        .SetFinalCombiner1Just(TestHost::SRC_DIFFUSE, true);
+
+// Turns R0 green in stage 0, then R0 red in stage 1 while moving the previous (green) value of R0 into R1.
+static constexpr TestHost::CombinerState kIndependenceTwoStageState =
+    TestHost::CombinerState(TestSuite::kDefaultCombinerState)
+        .SetCombinerControl(2)
+        .SetInputColorCombiner(0, TestHost::ColorInput(TestHost::SRC_C0), TestHost::OneInput())
+        .SetOutputColorCombiner(0, TestHost::DST_R0)
+        .SetInputColorCombiner(1, TestHost::ColorInput(TestHost::SRC_C0), TestHost::OneInput(),
+                               TestHost::ColorInput(TestHost::SRC_R0), TestHost::OneInput())
+        .SetOutputColorCombiner(1, TestHost::DST_R0, TestHost::DST_R1)
+        .SetFinalCombiner0Just(TestHost::SRC_R1)
+        .SetFinalCombiner1Just(TestHost::SRC_ZERO, true, true);
+
+// Sets R0 blue to 25% in stage 0, then R0 to 75% white and R1 to 50% white in stage 1 via the blue to alpha flags.
+static constexpr TestHost::CombinerState kIndependenceThreeStageState =
+    TestHost::CombinerState(kIndependenceTwoStageState)
+        .SetCombinerControl(3)
+        .SetOutputColorCombiner(1, TestHost::DST_R0, TestHost::DST_R1, TestHost::DST_DISCARD, false, false,
+                                TestHost::SM_SUM, TestHost::OP_IDENTITY, true, true)
+        .SetInputColorCombiner(2, TestHost::AlphaInput(TestHost::SRC_R0), TestHost::OneInput(),
+                               TestHost::AlphaInput(TestHost::SRC_R1), TestHost::OneInput())
+        .SetOutputColorCombiner(2, TestHost::DST_R0, TestHost::DST_R1);
+
 CombinerTests::CombinerTests(TestHost& host, std::string output_dir)
     : TestSuite(host, std::move(output_dir), "Combiner") {
   tests_[kMuxTestName] = [this]() { TestMux(); };
@@ -72,33 +111,15 @@ void CombinerTests::TestMux() {
 
   uint32_t vertex_elements = host_.POSITION | host_.DIFFUSE | host_.SPECULAR;
 
-  host_.SetCombinerControl(2, false, false, false);
-
-  // TODO: Test behavior when r0 is not explicitly set.
-  host_.SetInputColorCombiner(0, TestHost::OneInput(), TestHost::OneInput());
-  host_.SetOutputColorCombiner(0, TestHost::DST_R0);
-
-  host_.SetOutputAlphaCombiner(0, TestHost::DST_R0);
-
+  host_.SetCombinerState(kMuxState);
   host_.SetCombinerFactorC0(1, 1.0f, 0.0f, 0.0f, 1.0f);
   host_.SetCombinerFactorC1(1, 0.0f, 0.0f, 1.0f, 1.0f);
-  host_.SetInputColorCombiner(1, TestHost::ColorInput(TestHost::SRC_C0), TestHost::OneInput(),
-                              TestHost::ColorInput(TestHost::SRC_C1), TestHost::OneInput());
-  host_.SetOutputColorCombiner(1, TestHost::DST_DISCARD, TestHost::DST_DISCARD, TestHost::DST_DIFFUSE, false, false,
-                               TestHost::SM_MUX);
-
-  host_.SetInputAlphaCombiner(1, TestHost::OneInput(), TestHost::OneInput());
-  host_.SetOutputAlphaCombiner(1, TestHost::DST_DIFFUSE);
-
-  host_.SetFinalCombiner0Just(TestHost::SRC_DIFFUSE);
-  host_.SetFinalCombiner1Just(TestHost::SRC_DIFFUSE, true);
 
   int row = 5;
 
   // Set an alpha value with the MSB set and the LSB unset.
   uint32_t c0 = 0x82000000;
   host_.SetCombinerFactorC0(0, c0);
-  host_.SetInputAlphaCombiner(0, TestHost::AlphaInput(TestHost::SRC_C0), TestHost::OneInput());
   host_.SetCombinerControl(2, false, false, false);
   pb_printat(row, 11, (char*)"LSB 0x%x", (c0 >> 24));
   host_.SetVertexBuffer(vertex_buffers_[0]);
@@ -140,7 +161,7 @@ void CombinerTests::TestMux() {
   pb_printat(0, 0, (char*)"%s\n", kMuxTestName);
   pb_printat(1, 0, (char*)"Unset = Red");
   pb_printat(2, 0, (char*)"Set = Blue");
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, kMuxTestName);
 }
@@ -151,47 +172,17 @@ void CombinerTests::TestCombinerIndependence() {
 
   uint32_t vertex_elements = host_.POSITION | host_.DIFFUSE | host_.SPECULAR;
 
-  host_.SetCombinerControl(2);
-
-  // Turn R0 green.
+  host_.SetCombinerState(kIndependenceTwoStageState);
   host_.SetCombinerFactorC0(0, 0.0f, 1.0f, 0.0f, 1.0f);
-  host_.SetInputColorCombiner(0, TestHost::ColorInput(TestHost::SRC_C0), TestHost::OneInput());
-  host_.SetOutputColorCombiner(0, TestHost::DST_R0);
-
-  // Turn R0 red, and set R1 to the previous (green) value of R0.
   host_.SetCombinerFactorC0(1, 1.0f, 0.0f, 0.0f, 1.0f);
-  host_.SetInputColorCombiner(1, TestHost::ColorInput(TestHost::SRC_C0), TestHost::OneInput(),
-                              TestHost::ColorInput(TestHost::SRC_R0), TestHost::OneInput());
-  host_.SetOutputColorCombiner(1, TestHost::DST_R0, TestHost::DST_R1);
-
-  // Show a green quad.
-  host_.SetFinalCombiner0Just(TestHost::SRC_R1);
-  host_.SetFinalCombiner1Just(TestHost::SRC_ZERO, true, true);
 
   pb_printat(2, 6, (char*)"Green from r0 stage 0");
   host_.SetVertexBuffer(vertex_buffers_[0]);
   host_.DrawArrays(vertex_elements);
 
-  host_.SetCombinerControl(3);
-
-  // Set R0 blue to 25%
+  host_.SetCombinerState(kIndependenceThreeStageState);
   host_.SetCombinerFactorC0(0, 0.0f, 0.0f, 0.25f, 0.0f);
-  host_.SetInputColorCombiner(0, TestHost::ColorInput(TestHost::SRC_C0), TestHost::OneInput());
-  host_.SetOutputColorCombiner(0, TestHost::DST_R0);
-
-  // Turn R0 75% white and R1 50% white
   host_.SetCombinerFactorC0(1, 0.0f, 0.0f, 0.75f, 0.0f);
-  host_.SetInputColorCombiner(1, TestHost::ColorInput(TestHost::SRC_C0), TestHost::OneInput(),
-                              TestHost::ColorInput(TestHost::SRC_R0), TestHost::OneInput());
-  host_.SetOutputColorCombiner(1, TestHost::DST_R0, TestHost::DST_R1, TestHost::DST_DISCARD, false, false,
-                               TestHost::SM_SUM, TestHost::OP_IDENTITY, true, true);
-
-  host_.SetInputColorCombiner(2, TestHost::AlphaInput(TestHost::SRC_R0), TestHost::OneInput(),
-                              TestHost::AlphaInput(TestHost::SRC_R1), TestHost::OneInput());
-  host_.SetOutputColorCombiner(2, TestHost::DST_R0, TestHost::DST_R1);
-
-  host_.SetFinalCombiner0Just(TestHost::SRC_R1);
-  host_.SetFinalCombiner1Just(TestHost::SRC_ZERO, true, true);
 
   pb_printat(7, 20, (char*)"DGrey from r0 stage 1 alpha");
   host_.SetVertexBuffer(vertex_buffers_[2]);
@@ -203,7 +194,7 @@ void CombinerTests::TestCombinerIndependence() {
   host_.DrawArrays(vertex_elements);
 
   pb_printat(0, 0, (char*)"%s\n", kIndependenceTestName);
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, kIndependenceTestName);
 }
\ No newline at end of file
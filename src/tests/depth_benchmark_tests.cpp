@@ -0,0 +1,113 @@
+#include "depth_benchmark_tests.h"
+
+#include <pbkit/pbkit.h>
+
+#include <memory>
+
+#include "pbkit_ext.h"
+#include "shaders/precalculated_vertex_shader.h"
+#include "test_host.h"
+#include "vertex_buffer.h"
+
+static constexpr DepthBenchmarkTests::DrawOrder kDrawOrders[] = {
+    DepthBenchmarkTests::FRONT_TO_BACK,
+    DepthBenchmarkTests::BACK_TO_FRONT,
+};
+
+// Number of full screen quads drawn per frame.
+static constexpr uint32_t kLayers = 64;
+
+DepthBenchmarkTests::DepthBenchmarkTests(TestHost& host, std::string output_dir)
+    : TestSuite(host, std::move(output_dir), "Depth performance") {
+  for (auto& format : DepthFormatTests::kDepthFormats) {
+    for (auto order : kDrawOrders) {
+      tests_[MakeTestName(format, order)] = [this, &format, order]() {
+        CreateGeometry(format, order);
+        Test(format, order);
+      };
+    }
+  }
+}
+
+void DepthBenchmarkTests::Initialize() {
+  TestSuite::Initialize();
+
+  auto shader = std::make_shared<PrecalculatedVertexShader>();
+  host_.SetVertexShaderProgram(shader);
+}
+
+void DepthBenchmarkTests::Deinitialize() {
+  auto p = pb_begin();
+  p = pb_push1(p, NV097_SET_DEPTH_TEST_ENABLE, false);
+  pb_end(p);
+
+  // Match the depth buffer set up by TestSuite::Initialize.
+  host_.SetDepthBufferFormat(NV097_SET_SURFACE_FORMAT_ZETA_Z16);
+  host_.SetDepthBufferFloatMode(false);
+  host_.SetVertexShaderProgram(nullptr);
+  host_.SetVertexBuffer(nullptr);
+  TestSuite::Deinitialize();
+}
+
+void DepthBenchmarkTests::CreateGeometry(const DepthFormatTests::DepthFormat& format, DrawOrder order) {
+  auto fb_width = static_cast<float>(host_.GetFramebufferWidth());
+  auto fb_height = static_cast<float>(host_.GetFramebufferHeight());
+
+  auto buffer = host_.AllocateVertexBuffer(6 * kLayers);
+  for (uint32_t i = 0; i < kLayers; ++i) {
+    uint32_t layer = order == FRONT_TO_BACK ? i : kLayers - 1 - i;
+    auto z = static_cast<uint32_t>((static_cast<uint64_t>(format.max_depth) * (layer + 1)) / (kLayers + 1));
+    Color color{};
+    color.SetGrey(0.25f + 0.75f * static_cast<float>(layer) / kLayers);
+    buffer->DefineBiTri(i, 0.0f, 0.0f, fb_width, fb_height, format.fixed_to_float(z), format.fixed_to_float(z),
+                        format.fixed_to_float(z), format.fixed_to_float(z), color, color, color, color);
+  }
+}
+
+void DepthBenchmarkTests::Test(const DepthFormatTests::DepthFormat& format, DrawOrder order) {
+  host_.SetDepthBufferFormat(format.format);
+  host_.SetDepthBufferFloatMode(format.floating_point);
+  host_.PrepareDraw(0xFF000000, format.max_depth, 0x00);
+
+  auto p = pb_begin();
+  p = pb_push1(p, NV097_SET_DEPTH_TEST_ENABLE, true);
+  p = pb_push1(p, NV097_SET_DEPTH_MASK, true);
+  p = pb_push1(p, NV097_SET_DEPTH_FUNC, NV097_SET_DEPTH_FUNC_V_LESS);
+  p = pb_push1(p, NV097_SET_STENCIL_TEST_ENABLE, false);
+  p = pb_push1(p, NV097_SET_STENCIL_MASK, false);
+  pb_end(p);
+
+  double seconds = MeasureGpuSeconds([this]() { host_.DrawArrays(TestHost::POSITION | TestHost::DIFFUSE); });
+
+  // Every fragment reads the depth buffer, fragments that pass also write it. The savings from early rejection show up
+  // as a higher effective bandwidth.
+  uint32_t bytes_per_pixel = format.format == NV097_SET_SURFACE_FORMAT_ZETA_Z16 ? 2 : 4;
+  double pixels = static_cast<double>(host_.GetFramebufferWidth()) * host_.GetFramebufferHeight();
+  double passing_layers = order == FRONT_TO_BACK ? 1.0 : static_cast<double>(kLayers);
+  double depth_bytes = pixels * bytes_per_pixel * (kLayers + passing_layers);
+  double megabytes_per_second = seconds > 0.0 ? depth_bytes / (1024.0 * 1024.0) / seconds : 0.0;
+
+  std::string name = MakeTestName(format, order);
+  RecordBenchmarkResult(name, "frame_time", seconds * 1000.0, "ms");
+  RecordBenchmarkResult(name, "depth_bandwidth", megabytes_per_second, "MB/s");
+
+  p = pb_begin();
+  p = pb_push1(p, NV097_SET_DEPTH_TEST_ENABLE, false);
+  pb_end(p);
+
+  pb_print("%s\n", name.c_str());
+  pb_print("%u layers\n", kLayers);
+  pb_print("Frame: %u us\n", static_cast<uint32_t>(seconds * 1000000.0));
+  pb_print("Depth: %u MB/s\n", static_cast<uint32_t>(megabytes_per_second));
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(false, output_dir_, name);
+}
+
+std::string DepthBenchmarkTests::MakeTestName(const DepthFormatTests::DepthFormat& format, DrawOrder order) {
+  const char* format_name = format.format == NV097_SET_SURFACE_FORMAT_ZETA_Z16 ? "z16" : "z24";
+  char buf[64] = {0};
+  snprintf(buf, 63, "DepthPerf_%s_FZ%s_%s", format_name, format.floating_point ? "y" : "n",
+           order == FRONT_TO_BACK ? "F2B" : "B2F");
+  return buf;
+}
@@ -0,0 +1,39 @@
+#ifndef NXDK_PGRAPH_TESTS_DEPTH_BENCHMARK_TESTS_H
+#define NXDK_PGRAPH_TESTS_DEPTH_BENCHMARK_TESTS_H
+
+#include <cstdint>
+#include <string>
+
+#include "depth_format_tests.h"
+#include "test_suite.h"
+
+class TestHost;
+
+// Companion to DepthFormatTests that measures the frame time and effective depth bandwidth of depth heavy overdraw
+// under each depth format.
+//
+// Z compression is not measured: the hardware only compresses depth surfaces bound to a tiled memory region, and the
+// depth buffer used here is untiled, so enabling it would measure the same configuration twice.
+class DepthBenchmarkTests : public TestSuite {
+ public:
+  enum DrawOrder {
+    // Every layer after the first fails the depth test.
+    FRONT_TO_BACK,
+    // Every layer passes the depth test.
+    BACK_TO_FRONT,
+  };
+
+ public:
+  DepthBenchmarkTests(TestHost& host, std::string output_dir);
+  void Initialize() override;
+  void Deinitialize() override;
+  bool IsBenchmark() const override { return true; }
+
+ private:
+  void CreateGeometry(const DepthFormatTests::DepthFormat& format, DrawOrder order);
+  void Test(const DepthFormatTests::DepthFormat& format, DrawOrder order);
+
+  static std::string MakeTestName(const DepthFormatTests::DepthFormat& format, DrawOrder order);
+};
+
+#endif  // NXDK_PGRAPH_TESTS_DEPTH_BENCHMARK_TESTS_H
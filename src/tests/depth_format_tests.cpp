@@ -6,36 +6,37 @@
 #include "../test_host.h"
 #include "debug_output.h"
 #include "nxdk_ext.h"
+#include "parameter_sweep.h"
 #include "pbkit_ext.h"
 #include "vertex_buffer.h"
 
 static constexpr uint32_t kF16MaxFixedRepresentation = 0x0000FFFF;
 static constexpr uint32_t kF24MaxFixedRepresentation = 0x00FEFFFF;
 
-constexpr DepthFormatTests::DepthFormat kDepthFormats[] = {
+const DepthFormatTests::DepthFormat DepthFormatTests::kDepthFormats[kNumDepthFormats] = {
     {NV097_SET_SURFACE_FORMAT_ZETA_Z16, 0x0000FFFF, false},
     {NV097_SET_SURFACE_FORMAT_ZETA_Z24S8, 0x00FFFFFF, false},
     {NV097_SET_SURFACE_FORMAT_ZETA_Z16, kF16MaxFixedRepresentation, true},
     {NV097_SET_SURFACE_FORMAT_ZETA_Z24S8, kF24MaxFixedRepresentation, true},
 };
 
-constexpr uint32_t kNumDepthFormats = sizeof(kDepthFormats) / sizeof(kDepthFormats[0]);
 constexpr uint32_t kNumDepthTests = 64;
 constexpr bool kCompressionSettings[] = {false, true};
 
 DepthFormatTests::DepthFormatTests(TestHost &host, std::string output_dir)
     : TestSuite(host, std::move(output_dir), "Depth buffer") {
-  for (auto depth_format : kDepthFormats) {
-    uint32_t depth_cutoff_step = depth_format.max_depth / kNumDepthTests;
-
-    for (auto compression_enabled : kCompressionSettings) {
-      uint32_t depth_cutoff = depth_format.max_depth;
-
-      for (int i = 0; i <= kNumDepthTests; ++i, depth_cutoff -= depth_cutoff_step) {
-        AddTestEntry(depth_format, compression_enabled, depth_cutoff);
-      }
-    }
-  }
+  // Each format is tested at kNumDepthTests + 1 cutoffs stepping down from its maximum depth.
+  ParameterSweep sweep(Name());
+  sweep.AddAxis("depth_format", kDepthFormats);
+  sweep.AddAxis("compression", kCompressionSettings);
+  sweep.AddAxis("cutoff", kNumDepthTests + 1);
+  sweep.ForEach([this](const ParameterSweep::Combination &combination) {
+    const auto &depth_format = kDepthFormats[combination[0]];
+    const bool compression_enabled = kCompressionSettings[combination[1]];
+    const uint32_t depth_cutoff_step = depth_format.max_depth / kNumDepthTests;
+    const uint32_t depth_cutoff = depth_format.max_depth - combination[2] * depth_cutoff_step;
+    AddTestEntry(depth_format, compression_enabled, depth_cutoff);
+  });
 }
 
 void DepthFormatTests::Initialize() {
@@ -68,7 +69,7 @@ void DepthFormatTests::Test(const DepthFormat &format, bool compress_z, uint32_t
   pb_print("FloatZ: %s\n", format.floating_point ? "y" : "n");
   pb_print("Max: %x\n", depth_cutoff);
 
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   std::string name = MakeTestName(format, compress_z, depth_cutoff);
   std::string z_name = name + "_ZB";
@@ -19,6 +19,10 @@ class DepthFormatTests : public TestSuite {
     bool floating_point{false};
   };
 
+  // Z16 and Z24S8, each in fixed and floating point modes.
+  static constexpr uint32_t kNumDepthFormats = 4;
+  static const DepthFormat kDepthFormats[kNumDepthFormats];
+
  public:
   DepthFormatTests(TestHost &host, std::string output_dir);
 
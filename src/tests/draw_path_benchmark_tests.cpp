@@ -0,0 +1,292 @@
+#include "draw_path_benchmark_tests.h"
+
+#include <pbkit/pbkit.h>
+
+#include <cmath>
+#include <memory>
+
+#include "geometry_builder.h"
+#include "shaders/precalculated_vertex_shader.h"
+#include "test_host.h"
+#include "vertex_buffer.h"
+
+// clang-format off
+static constexpr DrawPathBenchmarkTests::DrawMode kDrawModes[] = {
+    DrawPathBenchmarkTests::DRAW_ARRAYS,
+    DrawPathBenchmarkTests::DRAW_INLINE_BUFFER,
+    DrawPathBenchmarkTests::DRAW_INLINE_ARRAY,
+    DrawPathBenchmarkTests::DRAW_INLINE_ELEMENTS16,
+    DrawPathBenchmarkTests::DRAW_INLINE_ELEMENTS32,
+    DrawPathBenchmarkTests::DRAW_INDEXED_GRID,
+    DrawPathBenchmarkTests::DRAW_INDEXED_SPHERE,
+    DrawPathBenchmarkTests::DRAW_INDEXED_STRIP_FAN,
+};
+// clang-format on
+
+// A 1M vertex buffer would not fit in memory, so larger vertex counts are reached by submitting the same ~10k vertex
+// mesh repeatedly.
+static constexpr uint32_t kMeshTriangles = 3334;
+static constexpr uint32_t kMeshVertices = kMeshTriangles * 3;
+static constexpr uint32_t kRepetitions[] = {1, 10, 100};
+
+// The indexed grid renders a similar number of triangles from roughly a sixth of the vertices.
+static constexpr uint32_t kGridColumns = 64;
+static constexpr uint32_t kGridRows = 26;
+static constexpr uint32_t kGridIndices = kGridColumns * kGridRows * 6;
+
+// The sphere and the strips/fans are sized to produce the same number of indices as the grid.
+static constexpr uint32_t kSphereSlices = 64;
+static constexpr uint32_t kSphereStacks = 26;
+
+static constexpr uint32_t kStripFanTriangles = 128;
+static constexpr uint32_t kStripFanVertices = kStripFanTriangles + 2;
+// Rows alternate between a triangle strip and a triangle fan.
+static constexpr uint32_t kStripFanRows = 26;
+
+static constexpr uint32_t kVertexFields = TestHost::POSITION | TestHost::DIFFUSE;
+
+DrawPathBenchmarkTests::DrawPathBenchmarkTests(TestHost& host, std::string output_dir)
+    : TestSuite(host, std::move(output_dir), "Draw path") {
+  for (auto draw_mode : kDrawModes) {
+    for (auto num_repetitions : kRepetitions) {
+      tests_[MakeTestName(draw_mode, num_repetitions)] = [this, draw_mode, num_repetitions]() {
+        Test(draw_mode, num_repetitions);
+      };
+    }
+  }
+}
+
+void DrawPathBenchmarkTests::Initialize() {
+  TestSuite::Initialize();
+
+  auto shader = std::make_shared<PrecalculatedVertexShader>();
+  host_.SetVertexShaderProgram(shader);
+
+  CreateGeometry();
+}
+
+void DrawPathBenchmarkTests::Deinitialize() {
+  host_.SetVertexShaderProgram(nullptr);
+  host_.SetVertexBuffer(nullptr);
+  mesh_buffer_.reset();
+  index_buffer_.clear();
+  index_buffer_.shrink_to_fit();
+  grid_buffer_.reset();
+  grid_index_buffer_ = IndexBuffer();
+  sphere_buffer_.reset();
+  sphere_index_buffer_ = IndexBuffer();
+  strip_fan_buffer_.reset();
+  strip_fan_index_buffer_ = IndexBuffer();
+  TestSuite::Deinitialize();
+}
+
+void DrawPathBenchmarkTests::CreateGeometry() {
+  // Tiny triangles keep the measurement focused on vertex submission rather than rasterization.
+  static constexpr uint32_t kColumns = 64;
+  static constexpr float kSize = 2.0f;
+  static constexpr float kLeft = 64.0f;
+  static constexpr float kTop = 64.0f;
+
+  mesh_buffer_ = host_.AllocateVertexBuffer(kMeshVertices);
+  auto buffer = mesh_buffer_;
+  Color color{0.25f, 0.75f, 0.5f, 1.0f};
+  for (uint32_t i = 0; i < kMeshTriangles; ++i) {
+    float left = kLeft + static_cast<float>(i % kColumns) * kSize * 2.0f;
+    float top = kTop + static_cast<float>(i / kColumns) * kSize * 2.0f;
+    float one[] = {left, top, 0.0f};
+    float two[] = {left + kSize, top, 0.0f};
+    float three[] = {left, top + kSize, 0.0f};
+    buffer->DefineTriangle(i, one, two, three, color, color, color);
+  }
+
+  index_buffer_.clear();
+  index_buffer_.reserve(kMeshVertices);
+  for (uint32_t i = 0; i < kMeshVertices; ++i) {
+    index_buffer_.push_back(i);
+  }
+
+  static constexpr float kGridCell = kSize * 2.0f;
+  grid_buffer_ = host_.AllocateVertexBuffer(GetGridVertexCount(kGridColumns, kGridRows));
+  grid_index_buffer_.Clear();
+  DefineGrid(*grid_buffer_, 0, grid_index_buffer_, kLeft, kTop, kLeft + kGridColumns * kGridCell,
+             kTop + kGridRows * kGridCell, 0.0f, kGridColumns, kGridRows, color);
+
+  // The precalculated shader passes z straight through, so the sphere is pushed forward to keep it in front of z = 0.
+  static constexpr float kSphereRadius = 128.0f;
+  const float center[] = {320.0f, 240.0f, kSphereRadius};
+  sphere_buffer_ = host_.AllocateVertexBuffer(GetSphereVertexCount(kSphereSlices, kSphereStacks));
+  sphere_index_buffer_.Clear();
+  DefineSphere(*sphere_buffer_, 0, sphere_index_buffer_, center, kSphereRadius, kSphereSlices, kSphereStacks, color);
+
+  CreateStripFanGeometry();
+}
+
+void DrawPathBenchmarkTests::CreateStripFanGeometry() {
+  static constexpr float kLeft = 64.0f;
+  static constexpr float kTop = 64.0f;
+  static constexpr float kColumnWidth = 4.0f;
+  static constexpr float kRowHeight = 12.0f;
+  static constexpr float kStripHeight = 4.0f;
+  static constexpr float kFanRadius = 5.0f;
+
+  strip_fan_buffer_ = host_.AllocateVertexBuffer(kStripFanVertices * kStripFanRows);
+  strip_fan_index_buffer_.Clear();
+
+  Color color{0.75f, 0.5f, 0.25f, 1.0f};
+  Vertex* vertex = strip_fan_buffer_->Lock();
+  for (uint32_t row = 0; row < kStripFanRows; ++row) {
+    const uint32_t first = row * kStripFanVertices;
+    const float top = kTop + static_cast<float>(row) * kRowHeight;
+
+    if (row & 0x01) {
+      // A fan around a center point, its rim sweeping a semicircle.
+      const float center_x = kLeft + kFanRadius;
+      const float center_y = top + kFanRadius;
+      vertex->SetPosition(center_x, center_y, 0.0f);
+      vertex->SetDiffuse(color.r, color.g, color.b, color.a);
+      ++vertex;
+      for (uint32_t i = 1; i < kStripFanVertices; ++i, ++vertex) {
+        const float angle = static_cast<float>(M_PI) * static_cast<float>(i - 1) / (kStripFanVertices - 2);
+        vertex->SetPosition(center_x + cosf(angle) * kFanRadius, center_y - sinf(angle) * kFanRadius, 0.0f);
+        vertex->SetDiffuse(color.r, color.g, color.b, color.a);
+      }
+      AppendTriangleFan(strip_fan_index_buffer_, first, kStripFanVertices);
+    } else {
+      // A horizontal ribbon alternating between its top and bottom edges.
+      for (uint32_t i = 0; i < kStripFanVertices; ++i, ++vertex) {
+        const float x = kLeft + static_cast<float>(i / 2) * kColumnWidth;
+        const float y = (i & 0x01) ? top + kStripHeight : top;
+        vertex->SetPosition(x, y, 0.0f);
+        vertex->SetDiffuse(color.r, color.g, color.b, color.a);
+      }
+      AppendTriangleStrip(strip_fan_index_buffer_, first, kStripFanVertices);
+    }
+  }
+  strip_fan_buffer_->Unlock();
+}
+
+std::shared_ptr<VertexBuffer> DrawPathBenchmarkTests::GetVertexBuffer(DrawMode draw_mode) const {
+  switch (draw_mode) {
+    case DRAW_INDEXED_GRID:
+      return grid_buffer_;
+    case DRAW_INDEXED_SPHERE:
+      return sphere_buffer_;
+    case DRAW_INDEXED_STRIP_FAN:
+      return strip_fan_buffer_;
+    default:
+      return mesh_buffer_;
+  }
+}
+
+const IndexBuffer& DrawPathBenchmarkTests::GetIndexBuffer(DrawMode draw_mode) const {
+  switch (draw_mode) {
+    case DRAW_INDEXED_SPHERE:
+      return sphere_index_buffer_;
+    case DRAW_INDEXED_STRIP_FAN:
+      return strip_fan_index_buffer_;
+    default:
+      return grid_index_buffer_;
+  }
+}
+
+void DrawPathBenchmarkTests::Draw(DrawMode draw_mode) {
+  switch (draw_mode) {
+    case DRAW_ARRAYS:
+      host_.DrawArrays(kVertexFields);
+      break;
+
+    case DRAW_INLINE_BUFFER:
+      host_.DrawInlineBuffer<kVertexFields>();
+      break;
+
+    case DRAW_INLINE_ARRAY:
+      host_.DrawInlineArray<kVertexFields>();
+      break;
+
+    case DRAW_INLINE_ELEMENTS16:
+      host_.DrawInlineElements16(index_buffer_, kVertexFields);
+      break;
+
+    case DRAW_INLINE_ELEMENTS32:
+      host_.DrawInlineElements32(index_buffer_, kVertexFields);
+      break;
+
+    case DRAW_INDEXED_GRID:
+    case DRAW_INDEXED_SPHERE:
+    case DRAW_INDEXED_STRIP_FAN:
+      host_.DrawInlineElements16(GetIndexBuffer(draw_mode), kVertexFields);
+      break;
+  }
+}
+
+void DrawPathBenchmarkTests::Test(DrawMode draw_mode, uint32_t num_repetitions) {
+  host_.SetVertexBuffer(GetVertexBuffer(draw_mode));
+  host_.PrepareDraw(0xFF202020);
+
+  auto timing = MeasureSubmission([this, draw_mode, num_repetitions]() {
+    for (uint32_t i = 0; i < num_repetitions; ++i) {
+      Draw(draw_mode);
+    }
+  });
+
+  std::string name = MakeTestName(draw_mode, num_repetitions);
+  uint32_t num_vertices = GetNumIndices(draw_mode) * num_repetitions;
+  RecordBenchmarkResult(name, "vertices", num_vertices, "vertices");
+  RecordBenchmarkResult(name, "cpu_submit_time", timing.cpu_seconds * 1000000.0, "us");
+  RecordBenchmarkResult(name, "gpu_complete_time", timing.gpu_seconds * 1000000.0, "us");
+
+  pb_print("%s\n", name.c_str());
+  pb_print("%u vertices\n", num_vertices);
+  pb_print("CPU submit: %u us\n", static_cast<uint32_t>(timing.cpu_seconds * 1000000.0));
+  pb_print("GPU complete: %u us\n", static_cast<uint32_t>(timing.gpu_seconds * 1000000.0));
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(false, output_dir_, name);
+}
+
+uint32_t DrawPathBenchmarkTests::GetNumIndices(DrawMode draw_mode) {
+  switch (draw_mode) {
+    case DRAW_INDEXED_GRID:
+      return kGridIndices;
+    case DRAW_INDEXED_SPHERE:
+      return GetSphereIndexCount(kSphereSlices, kSphereStacks);
+    case DRAW_INDEXED_STRIP_FAN:
+      return (kStripFanVertices - 2) * 3 * kStripFanRows;
+    default:
+      return kMeshVertices;
+  }
+}
+
+std::string DrawPathBenchmarkTests::MakeTestName(DrawMode draw_mode, uint32_t num_repetitions) {
+  const char* mode_name = "";
+  switch (draw_mode) {
+    case DRAW_ARRAYS:
+      mode_name = "DrawArrays";
+      break;
+    case DRAW_INLINE_BUFFER:
+      mode_name = "InlineBuffer";
+      break;
+    case DRAW_INLINE_ARRAY:
+      mode_name = "InlineArray";
+      break;
+    case DRAW_INLINE_ELEMENTS16:
+      mode_name = "InlineElements16";
+      break;
+    case DRAW_INLINE_ELEMENTS32:
+      mode_name = "InlineElements32";
+      break;
+    case DRAW_INDEXED_GRID:
+      mode_name = "IndexedGrid";
+      break;
+    case DRAW_INDEXED_SPHERE:
+      mode_name = "IndexedSphere";
+      break;
+    case DRAW_INDEXED_STRIP_FAN:
+      mode_name = "IndexedStripFan";
+      break;
+  }
+
+  char buf[48] = {0};
+  snprintf(buf, 47, "%s_%uk", mode_name, (GetNumIndices(draw_mode) * num_repetitions) / 1000);
+  return buf;
+}
@@ -0,0 +1,63 @@
+#ifndef NXDK_PGRAPH_TESTS_DRAW_PATH_BENCHMARK_TESTS_H
+#define NXDK_PGRAPH_TESTS_DRAW_PATH_BENCHMARK_TESTS_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "index_buffer.h"
+#include "test_suite.h"
+
+class TestHost;
+class VertexBuffer;
+
+// Compares the CPU submission and GPU completion time of each TestHost draw path for large vertex counts.
+class DrawPathBenchmarkTests : public TestSuite {
+ public:
+  enum DrawMode {
+    DRAW_ARRAYS,
+    DRAW_INLINE_BUFFER,
+    DRAW_INLINE_ARRAY,
+    DRAW_INLINE_ELEMENTS16,
+    DRAW_INLINE_ELEMENTS32,
+    // DrawInlineElements16 over a grid that shares vertices between adjacent triangles.
+    DRAW_INDEXED_GRID,
+    // DrawInlineElements16 over a UV sphere.
+    DRAW_INDEXED_SPHERE,
+    // DrawInlineElements16 over alternating triangle strips and fans converted to triangle lists.
+    DRAW_INDEXED_STRIP_FAN,
+  };
+
+ public:
+  DrawPathBenchmarkTests(TestHost& host, std::string output_dir);
+  void Initialize() override;
+  void Deinitialize() override;
+  bool IsBenchmark() const override { return true; }
+
+ private:
+  void CreateGeometry();
+  void CreateStripFanGeometry();
+  std::shared_ptr<VertexBuffer> GetVertexBuffer(DrawMode draw_mode) const;
+  const IndexBuffer& GetIndexBuffer(DrawMode draw_mode) const;
+  void Test(DrawMode draw_mode, uint32_t num_repetitions);
+  void Draw(DrawMode draw_mode);
+
+  // Returns the number of vertices submitted (i.e., before any reuse) by a single Draw.
+  static uint32_t GetNumIndices(DrawMode draw_mode);
+  static std::string MakeTestName(DrawMode draw_mode, uint32_t num_repetitions);
+
+ private:
+  std::shared_ptr<VertexBuffer> mesh_buffer_;
+  std::vector<uint32_t> index_buffer_;
+
+  std::shared_ptr<VertexBuffer> grid_buffer_;
+  IndexBuffer grid_index_buffer_;
+
+  std::shared_ptr<VertexBuffer> sphere_buffer_;
+  IndexBuffer sphere_index_buffer_;
+
+  std::shared_ptr<VertexBuffer> strip_fan_buffer_;
+  IndexBuffer strip_fan_index_buffer_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_DRAW_PATH_BENCHMARK_TESTS_H
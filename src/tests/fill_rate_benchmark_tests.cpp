@@ -0,0 +1,162 @@
+#include "fill_rate_benchmark_tests.h"
+
+#include <pbkit/pbkit.h>
+
+#include "parameter_sweep.h"
+#include "pbkit_ext.h"
+#include "shaders/vertex_program_assembler.h"
+#include "shaders/vertex_shader_program.h"
+#include "vertex_buffer.h"
+
+struct ColorFormatInfo {
+  TestHost::SurfaceColorFormat format;
+  const char* name;
+};
+
+// clang-format off
+static constexpr ColorFormatInfo kColorFormats[] = {
+    {TestHost::SCF_X1R5G5B5_Z1R5G5B5, "X1R5G5B5_Z"},
+    {TestHost::SCF_X1R5G5B5_O1R5G5B5, "X1R5G5B5_O"},
+    {TestHost::SCF_R5G6B5, "R5G6B5"},
+    {TestHost::SCF_X8R8G8B8_Z8R8G8B8, "X8R8G8B8_Z"},
+    {TestHost::SCF_X8R8G8B8_O8R8G8B8, "X8R8G8B8_O"},
+    {TestHost::SCF_X1A7R8G8B8_Z1A7R8G8B8, "X1A7R8G8B8_Z"},
+    {TestHost::SCF_X1A7R8G8B8_O1A7R8G8B8, "X1A7R8G8B8_O"},
+    {TestHost::SCF_A8R8G8B8, "A8R8G8B8"},
+    {TestHost::SCF_B8, "B8"},
+    {TestHost::SCF_G8B8, "G8B8"},
+};
+
+static constexpr bool kBlendSettings[] = {false, true};
+
+static constexpr FillRateBenchmarkTests::DepthMode kDepthModes[] = {
+    FillRateBenchmarkTests::DEPTH_OFF,
+    FillRateBenchmarkTests::DEPTH_ON,
+    FillRateBenchmarkTests::DEPTH_ON_COMPRESSED,
+};
+// clang-format on
+
+static constexpr uint32_t kMaxTextures = 4;
+static constexpr uint32_t kQuadsPerFrame = 32;
+static constexpr float kQuadZ = 0.0f;
+
+static const char* GetColorFormatName(TestHost::SurfaceColorFormat format) {
+  for (auto& info : kColorFormats) {
+    if (info.format == format) {
+      return info.name;
+    }
+  }
+  return "Unknown";
+}
+
+FillRateBenchmarkTests::FillRateBenchmarkTests(TestHost& host, std::string output_dir)
+    : TestSuite(host, std::move(output_dir), "Fill rate") {
+  ParameterSweep sweep(Name());
+  sweep.AddAxis("color_format", kColorFormats);
+  sweep.AddAxis("blend", kBlendSettings);
+  sweep.AddAxis("depth_mode", kDepthModes);
+  sweep.AddAxis("num_textures", kMaxTextures + 1);
+  sweep.ForEach([this](const ParameterSweep::Combination& combination) {
+    Config config{kColorFormats[combination[0]].format, kBlendSettings[combination[1]], kDepthModes[combination[2]],
+                  combination[3]};
+    tests_[MakeTestName(config)] = [this, config]() { Test(config); };
+  });
+}
+
+void FillRateBenchmarkTests::Initialize() {
+  TestSuite::Initialize();
+
+  // Pass the first texture coordinate through to every stage so that all stages sample across the whole texture.
+  using VPA = VertexProgramAssembler;
+  VPA vp;
+  vp.Mov(VPA::Output(VPA::OUT_POSITION), VPA::V(0)).Mov(VPA::Output(VPA::OUT_DIFFUSE), VPA::V(3));
+  for (auto output : {VPA::OUT_TEX0, VPA::OUT_TEX1, VPA::OUT_TEX2, VPA::OUT_TEX3}) {
+    vp.Mov(VPA::Output(output), VPA::V(9));
+  }
+  auto& program = vp.Assemble();
+
+  shader_ = std::make_shared<VertexShaderProgram>();
+  shader_->SetShaderOverride(program.data(), program.size() * sizeof(uint32_t));
+  host_.SetVertexShaderProgram(shader_);
+
+  CreateGeometry();
+}
+
+void FillRateBenchmarkTests::Deinitialize() {
+  host_.SetVertexShaderProgram(nullptr);
+  shader_.reset();
+  host_.SetVertexBuffer(nullptr);
+  TestSuite::Deinitialize();
+}
+
+void FillRateBenchmarkTests::CreateGeometry() {
+  auto fb_width = static_cast<float>(host_.GetFramebufferWidth());
+  auto fb_height = static_cast<float>(host_.GetFramebufferHeight());
+
+  auto buffer = host_.AllocateVertexBuffer(6 * kQuadsPerFrame);
+  for (uint32_t i = 0; i < kQuadsPerFrame; ++i) {
+    buffer->DefineBiTri(i, 0.0f, 0.0f, fb_width, fb_height, kQuadZ);
+  }
+}
+
+void FillRateBenchmarkTests::Test(const Config& config) {
+  static constexpr TestHost::ShaderStageProgram kStagePrograms[] = {
+      TestHost::STAGE_NONE,
+      TestHost::STAGE_2D_PROJECTIVE,
+  };
+  auto stage_program = [&config](uint32_t stage) { return kStagePrograms[stage < config.num_textures ? 1 : 0]; };
+
+  for (uint32_t stage = 0; stage < kMaxTextures; ++stage) {
+    host_.SetTextureStageEnabled(stage, stage < config.num_textures);
+  }
+  host_.SetShaderStageProgram(stage_program(0), stage_program(1), stage_program(2), stage_program(3));
+
+  // Every pixel is drawn over, so only the depth buffer needs to start in a known state.
+  host_.PrepareDraw(0xFF000000, 0xFFFFFFFF, 0x00, TestHost::CLEAR_DEPTH_STENCIL);
+
+  host_.SetSurfaceFormat(config.color_format, static_cast<TestHost::SurfaceZetaFormat>(host_.GetDepthBufferFormat()),
+                         host_.GetFramebufferWidth(), host_.GetFramebufferHeight());
+  host_.SetAlphaBlendEnabled(config.blend);
+
+  auto p = pb_begin();
+  p = pb_push1(p, NV097_SET_DEPTH_TEST_ENABLE, config.depth_mode != DEPTH_OFF);
+  p = pb_push1(p, NV097_SET_DEPTH_MASK, config.depth_mode != DEPTH_OFF);
+  // Every quad is at the same depth, so LEQUAL forces a depth read and write for every pixel.
+  p = pb_push1(p, NV097_SET_DEPTH_FUNC, NV097_SET_DEPTH_FUNC_V_LEQUAL);
+  p = pb_push1(p, NV097_SET_COMPRESS_ZBUFFER_EN, config.depth_mode == DEPTH_ON_COMPRESSED);
+  pb_end(p);
+
+  uint32_t vertex_fields = TestHost::POSITION | TestHost::DIFFUSE | TestHost::TEXCOORD0;
+  double seconds = MeasureGpuSeconds([this, vertex_fields]() { host_.DrawArrays(vertex_fields); });
+
+  double num_pixels = static_cast<double>(host_.GetFramebufferWidth()) * host_.GetFramebufferHeight() * kQuadsPerFrame;
+  double pixels_per_second = seconds > 0.0 ? num_pixels / seconds : 0.0;
+
+  std::string name = MakeTestName(config);
+  RecordBenchmarkResult(name, "pixels_per_second", pixels_per_second, "pixels/s");
+
+  // Restore the state expected by the rest of the suite and clear away the benchmark output.
+  p = pb_begin();
+  p = pb_push1(p, NV097_SET_DEPTH_TEST_ENABLE, false);
+  p = pb_push1(p, NV097_SET_COMPRESS_ZBUFFER_EN, false);
+  pb_end(p);
+  host_.SetAlphaBlendEnabled(true);
+  host_.SetSurfaceFormat(TestHost::SCF_A8R8G8B8, static_cast<TestHost::SurfaceZetaFormat>(host_.GetDepthBufferFormat()),
+                         host_.GetFramebufferWidth(), host_.GetFramebufferHeight());
+  host_.Clear(0xFF000000);
+
+  pb_print("%s\n", name.c_str());
+  pb_print("%u Mpixels/s\n", static_cast<uint32_t>(pixels_per_second / 1000000.0));
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(false, output_dir_, name);
+}
+
+std::string FillRateBenchmarkTests::MakeTestName(const Config& config) {
+  static constexpr const char* kDepthNames[] = {"NoDepth", "Depth", "DepthZC"};
+
+  char buf[64] = {0};
+  snprintf(buf, 63, "%s_%s_%s_T%u", GetColorFormatName(config.color_format), config.blend ? "Blend" : "NoBlend",
+           kDepthNames[config.depth_mode], config.num_textures);
+  return buf;
+}
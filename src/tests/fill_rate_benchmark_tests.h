@@ -0,0 +1,45 @@
+#ifndef NXDK_PGRAPH_TESTS_FILL_RATE_BENCHMARK_TESTS_H
+#define NXDK_PGRAPH_TESTS_FILL_RATE_BENCHMARK_TESTS_H
+
+#include <memory>
+#include <string>
+
+#include "test_host.h"
+#include "test_suite.h"
+
+class VertexShaderProgram;
+
+// Measures the pixels per second achieved when drawing full screen quads under various blend, depth, texture, and
+// surface format configurations.
+class FillRateBenchmarkTests : public TestSuite {
+ public:
+  enum DepthMode {
+    DEPTH_OFF,
+    DEPTH_ON,
+    DEPTH_ON_COMPRESSED,
+  };
+
+  struct Config {
+    TestHost::SurfaceColorFormat color_format;
+    bool blend;
+    DepthMode depth_mode;
+    uint32_t num_textures;
+  };
+
+ public:
+  FillRateBenchmarkTests(TestHost& host, std::string output_dir);
+  void Initialize() override;
+  void Deinitialize() override;
+  bool IsBenchmark() const override { return true; }
+
+ private:
+  void CreateGeometry();
+  void Test(const Config& config);
+
+  static std::string MakeTestName(const Config& config);
+
+ private:
+  std::shared_ptr<VertexShaderProgram> shader_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_FILL_RATE_BENCHMARK_TESTS_H
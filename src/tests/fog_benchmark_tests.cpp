@@ -0,0 +1,303 @@
+#include "fog_benchmark_tests.h"
+
+#include <pbkit/pbkit.h>
+
+#include "geometry_builder.h"
+#include "pbkit_ext.h"
+#include "shaders/perspective_vertex_shader.h"
+#include "shaders/vertex_program_assembler.h"
+#include "vertex_buffer.h"
+
+// clang-format off
+static constexpr FogTests::FogMode kFogModes[] = {
+    FogTests::FOG_LINEAR,
+    FogTests::FOG_EXP,
+    FogTests::FOG_EXP2,
+    FogTests::FOG_EXP_ABS,
+    FogTests::FOG_EXP2_ABS,
+    FogTests::FOG_LINEAR_ABS,
+};
+
+// FOG_GEN_FOG_X is omitted as the grid does not carry a fog coordinate attribute.
+static constexpr FogTests::FogGenMode kGenModes[] = {
+    FogTests::FOG_GEN_SPEC_ALPHA,
+    FogTests::FOG_GEN_RADIAL,
+    FogTests::FOG_GEN_PLANAR,
+    FogTests::FOG_GEN_ABS_PLANAR,
+};
+
+// Fog coordinates written by the vertex program, spanning the near to far range used by FogTests.
+static constexpr float kFogCoordinates[] = {
+    0.0f,
+    1.0f,
+    50.0f,
+    200.0f,
+};
+
+// oPos.w values written by the vertex program, which change only the perspective correction of interpolated values.
+static constexpr float kPositionWs[] = {
+    1.0f,
+    10.0f,
+    100.0f,
+    1000.0f,
+};
+// clang-format on
+
+// The grid is large enough to overscan the whole framebuffer from the default XDK camera, so every pixel is shaded by
+// every draw. Fog is evaluated per pixel, so the grid only needs enough vertices to give the generated fog coordinate
+// a gradient.
+static constexpr uint32_t kGridColumns = 64;
+static constexpr uint32_t kGridRows = 48;
+static constexpr float kGridZ = 3.0f;
+static constexpr uint32_t kRepetitions = 10;
+
+static constexpr uint32_t kFogColor = 0x7F2030;
+static constexpr uint32_t kFogCoordinateUniform = 12;
+static constexpr uint32_t kPositionWUniform = 13;
+// The W produced by the projection for the grid, which is kGridZ in front of a camera at z = -7.
+static constexpr float kGridW = kGridZ + 7.0f;
+// Fog coordinate used while sweeping W.
+static constexpr float kWSweepFogCoordinate = 50.0f;
+
+static const char* GetFogModeName(FogTests::FogMode fog_mode) {
+  switch (fog_mode) {
+    case FogTests::FOG_LINEAR:
+      return "Linear";
+    case FogTests::FOG_EXP:
+      return "Exp";
+    case FogTests::FOG_EXP2:
+      return "Exp2";
+    case FogTests::FOG_EXP_ABS:
+      return "ExpAbs";
+    case FogTests::FOG_EXP2_ABS:
+      return "Exp2Abs";
+    case FogTests::FOG_LINEAR_ABS:
+      return "LinearAbs";
+  }
+  return "Unknown";
+}
+
+static const char* GetGenModeName(FogTests::FogGenMode gen_mode) {
+  switch (gen_mode) {
+    case FogTests::FOG_GEN_SPEC_ALPHA:
+      return "SpecAlpha";
+    case FogTests::FOG_GEN_RADIAL:
+      return "Radial";
+    case FogTests::FOG_GEN_PLANAR:
+      return "Planar";
+    case FogTests::FOG_GEN_ABS_PLANAR:
+      return "AbsPlanar";
+    case FogTests::FOG_GEN_FOG_X:
+      return "FogX";
+  }
+  return "Unknown";
+}
+
+FogBenchmarkTests::FogBenchmarkTests(TestHost& host, std::string output_dir)
+    : TestSuite(host, std::move(output_dir), "Fog performance") {
+  for (auto fog_mode : kFogModes) {
+    for (auto gen_mode : kGenModes) {
+      tests_[MakeFixedFunctionTestName(fog_mode, gen_mode)] = [this, fog_mode, gen_mode]() {
+        TestFixedFunction(fog_mode, gen_mode);
+      };
+    }
+    for (auto fog_coordinate : kFogCoordinates) {
+      tests_[MakeShaderFogTestName(fog_mode, fog_coordinate)] = [this, fog_mode, fog_coordinate]() {
+        TestShader(MakeShaderFogTestName(fog_mode, fog_coordinate), fog_mode, fog_coordinate, kGridW);
+      };
+    }
+    for (auto w : kPositionWs) {
+      tests_[MakeShaderWTestName(fog_mode, w)] = [this, fog_mode, w]() {
+        TestShader(MakeShaderWTestName(fog_mode, w), fog_mode, kWSweepFogCoordinate, w);
+      };
+    }
+  }
+}
+
+void FogBenchmarkTests::Initialize() {
+  TestSuite::Initialize();
+
+  host_.SetVertexShaderProgram(nullptr);
+  CreateGeometry();
+  CreateShader();
+  host_.SetXDKDefaultViewportAndFixedFunctionMatrices();
+}
+
+void FogBenchmarkTests::Deinitialize() {
+  auto p = pb_begin();
+  p = pb_push1(p, NV097_SET_FOG_ENABLE, false);
+  pb_end(p);
+  host_.InvalidateRegisterShadow();
+
+  host_.SetVertexShaderProgram(nullptr);
+  shader_.reset();
+  host_.SetVertexBuffer(nullptr);
+  grid_buffer_.reset();
+  grid_index_buffer_ = IndexBuffer();
+  TestSuite::Deinitialize();
+}
+
+void FogBenchmarkTests::CreateGeometry() {
+  grid_buffer_ = host_.AllocateVertexBuffer(GetGridVertexCount(kGridColumns, kGridRows));
+  grid_index_buffer_.Clear();
+  DefineGrid(*grid_buffer_, 0, grid_index_buffer_, -6.0f, 4.5f, 6.0f, -4.5f, kGridZ, kGridColumns, kGridRows,
+             Color{0.0f, 0.0f, 1.0f, 1.0f});
+
+  // Ramp specular alpha across the grid so that FOG_GEN_SPEC_ALPHA produces a gradient like the other modes.
+  auto vertex = grid_buffer_->Lock();
+  for (uint32_t row = 0; row <= kGridRows; ++row) {
+    for (uint32_t column = 0; column <= kGridColumns; ++column, ++vertex) {
+      vertex->SetSpecular(1.0f, 1.0f, 1.0f, static_cast<float>(column) / static_cast<float>(kGridColumns));
+    }
+  }
+  grid_buffer_->Unlock();
+}
+
+void FogBenchmarkTests::CreateShader() {
+  // Matches the camera implied by SetXDKDefaultViewportAndFixedFunctionMatrices so that both paths cover the same
+  // pixels.
+  shader_ = std::make_shared<PerspectiveVertexShader>(host_.GetFramebufferWidth(), host_.GetFramebufferHeight());
+  shader_->SetNear(1.0f);
+  shader_->SetFar(200.0f);
+  VECTOR camera_position{0.0f, 0.0f, -7.0f, 1.0f};
+  VECTOR look_at{0.0f, 0.0f, 0.0f, 1.0f};
+  shader_->LookAt(camera_position, look_at);
+  shader_->SetLightingEnabled(false);
+
+  // Transforms v0 by the model (c[0]), view (c[4]), and projection (c[8]) matrices, replaces the resulting W with
+  // c[13].x, passes through the diffuse color, and writes every oFog component from c[12].
+  using VPA = VertexProgramAssembler;
+  VPA vp;
+  vp.Mul(VPA::Temp(0), VPA::V(0).Swizzle("x"), VPA::C(0))
+      .Mad(VPA::Temp(0), VPA::V(0).Swizzle("y"), VPA::C(1), VPA::R(0))
+      .Mad(VPA::Temp(0), VPA::V(0).Swizzle("z"), VPA::C(2), VPA::R(0))
+      .Add(VPA::Temp(0), VPA::R(0), VPA::C(3));
+
+  for (int32_t matrix = 4; matrix <= 8; matrix += 4) {
+    auto src = VPA::R(matrix == 4 ? 0 : 1);
+    auto dst = VPA::Temp(matrix == 4 ? 1 : 0);
+    vp.Mul(dst, src.Swizzle("x"), VPA::C(matrix))
+        .Mad(dst, src.Swizzle("y"), VPA::C(matrix + 1), VPA::R(dst.address))
+        .Mad(dst, src.Swizzle("z"), VPA::C(matrix + 2), VPA::R(dst.address))
+        .Mad(dst, src.Swizzle("w"), VPA::C(matrix + 3), VPA::R(dst.address));
+  }
+
+  vp.Rcp(VPA::Temp(1, VPA::MASK_X), VPA::R(0).Swizzle("w"))
+      .Mul(VPA::Output(VPA::OUT_POSITION, VPA::MASK_XYZ), VPA::R(0), VPA::R(1).Swizzle("x"))
+      .Mov(VPA::Output(VPA::OUT_POSITION, VPA::MASK_W), VPA::C(kPositionWUniform).Swizzle("x"))
+      .Mov(VPA::Output(VPA::OUT_DIFFUSE), VPA::V(3))
+      .Mov(VPA::Output(VPA::OUT_FOG), VPA::C(kFogCoordinateUniform));
+
+  auto& program = vp.Assemble();
+  shader_->SetShaderOverride(program.data(), program.size() * sizeof(uint32_t));
+}
+
+void FogBenchmarkTests::TestFixedFunction(FogTests::FogMode fog_mode, FogTests::FogGenMode gen_mode) {
+  host_.SetVertexShaderProgram(nullptr);
+  host_.SetXDKDefaultViewportAndFixedFunctionMatrices();
+
+  MeasureFog(MakeFixedFunctionTestName(fog_mode, gen_mode), fog_mode, gen_mode,
+             TestHost::POSITION | TestHost::DIFFUSE | TestHost::SPECULAR);
+}
+
+void FogBenchmarkTests::TestShader(const std::string& name, FogTests::FogMode fog_mode, float fog_coordinate,
+                                   float w) {
+  shader_->SetUniformF(kFogCoordinateUniform, fog_coordinate, fog_coordinate, fog_coordinate, fog_coordinate);
+  shader_->SetUniformF(kPositionWUniform, w);
+  host_.SetVertexShaderProgram(shader_);
+
+  // Gen mode does not seem to matter when using a vertex shader.
+  MeasureFog(name, fog_mode, FogTests::FOG_GEN_SPEC_ALPHA,
+             TestHost::POSITION | TestHost::DIFFUSE);
+}
+
+void FogBenchmarkTests::MeasureFog(const std::string& name, FogTests::FogMode fog_mode, FogTests::FogGenMode gen_mode,
+                                   uint32_t vertex_fields) {
+  host_.SetVertexBuffer(grid_buffer_);
+  host_.PrepareDraw(0xFF303030);
+
+  // Blend the diffuse color towards the fog color by the fog factor in the final combiner.
+  host_.ClearInputColorCombiners();
+  host_.ClearInputAlphaCombiners();
+  host_.ClearOutputColorCombiners();
+  host_.ClearOutputAlphaCombiners();
+  host_.SetInputColorCombiner(0, TestHost::SRC_DIFFUSE, false, TestHost::MAP_UNSIGNED_IDENTITY, TestHost::SRC_ZERO,
+                              false, TestHost::MAP_UNSIGNED_INVERT);
+  host_.SetInputAlphaCombiner(0, TestHost::SRC_DIFFUSE, true, TestHost::MAP_UNSIGNED_IDENTITY, TestHost::SRC_ZERO,
+                              false, TestHost::MAP_UNSIGNED_INVERT);
+  host_.SetOutputColorCombiner(0, TestHost::DST_R0);
+  host_.SetOutputAlphaCombiner(0, TestHost::DST_R0);
+  host_.SetFinalCombiner0(TestHost::SRC_FOG, true, false, TestHost::SRC_FOG, false, false, TestHost::SRC_R0);
+  host_.SetFinalCombiner1(TestHost::SRC_ZERO, false, false, TestHost::SRC_ZERO, false, false, TestHost::SRC_R0, true);
+
+  float bias;
+  float multiplier;
+  FogTests::CalculateFogParams(fog_mode, bias, multiplier);
+
+  auto p = pb_begin();
+  p = pb_push1(p, NV097_SET_COMBINER_CONTROL, 1);
+  p = pb_push1(p, NV097_SET_FOG_ENABLE, false);
+  // Note: Fog color is ABGR and not ARGB
+  p = pb_push1(p, NV097_SET_FOG_COLOR, 0xFF000000 | kFogColor);
+  p = pb_push1(p, NV097_SET_FOG_GEN_MODE, gen_mode);
+  p = pb_push1(p, NV097_SET_FOG_MODE, fog_mode);
+  p = pb_push3f(p, NV097_SET_FOG_PARAMS, bias, multiplier, 0.0f);
+  pb_end(p);
+  host_.InvalidateRegisterShadow();
+
+  auto draw = [this, vertex_fields]() {
+    for (uint32_t i = 0; i < kRepetitions; ++i) {
+      host_.DrawInlineElements16(grid_index_buffer_, vertex_fields);
+    }
+  };
+
+  double baseline_seconds = MeasureGpuSeconds(draw);
+
+  p = pb_begin();
+  p = pb_push1(p, NV097_SET_FOG_ENABLE, true);
+  pb_end(p);
+
+  double fog_seconds = MeasureGpuSeconds(draw);
+
+  // Leave fog disabled so that the text overlay is not fogged.
+  p = pb_begin();
+  p = pb_push1(p, NV097_SET_FOG_ENABLE, false);
+  pb_end(p);
+
+  const double num_pixels =
+      static_cast<double>(host_.GetFramebufferWidth()) * host_.GetFramebufferHeight() * kRepetitions;
+  const double ns_per_pixel = fog_seconds * 1000000000.0 / num_pixels;
+  const double overhead_ns_per_pixel = (fog_seconds - baseline_seconds) * 1000000000.0 / num_pixels;
+
+  RecordBenchmarkResult(name, "pixels", num_pixels, "pixels");
+  RecordBenchmarkResult(name, "baseline_gpu_complete_time", baseline_seconds * 1000000.0, "us");
+  RecordBenchmarkResult(name, "gpu_complete_time", fog_seconds * 1000000.0, "us");
+  RecordBenchmarkResult(name, "ns_per_pixel", ns_per_pixel, "ns");
+  RecordBenchmarkResult(name, "fog_overhead_per_pixel", overhead_ns_per_pixel, "ns");
+
+  pb_print("%s\n", name.c_str());
+  pb_print("Baseline: %u us\n", static_cast<uint32_t>(baseline_seconds * 1000000.0));
+  pb_print("Fog: %u us\n", static_cast<uint32_t>(fog_seconds * 1000000.0));
+  pb_print("Overhead: %d ps/pixel\n", static_cast<int32_t>(overhead_ns_per_pixel * 1000.0));
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(false, output_dir_, name);
+}
+
+std::string FogBenchmarkTests::MakeFixedFunctionTestName(FogTests::FogMode fog_mode, FogTests::FogGenMode gen_mode) {
+  char buf[32] = {0};
+  snprintf(buf, 31, "FF_%s_%s", GetFogModeName(fog_mode), GetGenModeName(gen_mode));
+  return buf;
+}
+
+std::string FogBenchmarkTests::MakeShaderFogTestName(FogTests::FogMode fog_mode, float fog_coordinate) {
+  char buf[32] = {0};
+  snprintf(buf, 31, "Vsh_%s_Fog%.0f", GetFogModeName(fog_mode), fog_coordinate);
+  return buf;
+}
+
+std::string FogBenchmarkTests::MakeShaderWTestName(FogTests::FogMode fog_mode, float w) {
+  char buf[32] = {0};
+  snprintf(buf, 31, "Vsh_%s_W%.0f", GetFogModeName(fog_mode), w);
+  return buf;
+}
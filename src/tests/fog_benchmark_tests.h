@@ -0,0 +1,45 @@
+#ifndef NXDK_PGRAPH_TESTS_FOG_BENCHMARK_TESTS_H
+#define NXDK_PGRAPH_TESTS_FOG_BENCHMARK_TESTS_H
+
+#include <memory>
+#include <string>
+
+#include "fog_tests.h"
+#include "index_buffer.h"
+#include "test_suite.h"
+
+class PerspectiveVertexShader;
+class VertexBuffer;
+
+// Measures the per pixel cost of each fog mode. The geometry is uploaded once and every test is selected purely by
+// fog state, fixed function fog generation mode, or the fog coordinate and position W constants fed to a vertex
+// program, so the difference from the fog disabled baseline is attributable to fog alone.
+class FogBenchmarkTests : public TestSuite {
+ public:
+  FogBenchmarkTests(TestHost& host, std::string output_dir);
+  void Initialize() override;
+  void Deinitialize() override;
+  bool IsBenchmark() const override { return true; }
+
+ private:
+  void CreateGeometry();
+  void CreateShader();
+
+  void TestFixedFunction(FogTests::FogMode fog_mode, FogTests::FogGenMode gen_mode);
+  void TestShader(const std::string& name, FogTests::FogMode fog_mode, float fog_coordinate, float w);
+
+  // Sets up fog for the given mode, then times the grid with fog disabled and enabled and records the results.
+  void MeasureFog(const std::string& name, FogTests::FogMode fog_mode, FogTests::FogGenMode gen_mode,
+                  uint32_t vertex_fields);
+
+  static std::string MakeFixedFunctionTestName(FogTests::FogMode fog_mode, FogTests::FogGenMode gen_mode);
+  static std::string MakeShaderFogTestName(FogTests::FogMode fog_mode, float fog_coordinate);
+  static std::string MakeShaderWTestName(FogTests::FogMode fog_mode, float w);
+
+ private:
+  std::shared_ptr<VertexBuffer> grid_buffer_;
+  IndexBuffer grid_index_buffer_;
+  std::shared_ptr<PerspectiveVertexShader> shader_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_FOG_BENCHMARK_TESTS_H
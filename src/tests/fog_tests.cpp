@@ -4,8 +4,11 @@
 
 #include <utility>
 
+#include "debug_output.h"
+#include "parameter_sweep.h"
 #include "pbkit_ext.h"
 #include "shaders/perspective_vertex_shader.h"
+#include "shaders/vertex_program_assembler.h"
 #include "test_host.h"
 #include "vertex_buffer.h"
 
@@ -31,18 +34,22 @@ static constexpr FogTests::FogGenMode kGenModes[] = {
 };
 // clang-format on
 
+// Alpha doesn't seem to actually have any effect.
+static constexpr uint32_t kAlphas[] = {0xFF};
+
 FogTests::FogTests(TestHost& host, std::string output_dir, std::string suite_name)
     : TestSuite(host, std::move(output_dir), std::move(suite_name)) {
-  for (const auto fog_mode : kFogModes) {
-    for (const auto gen_mode : kGenModes) {
-      // Alpha doesn't seem to actually have any effect.
-      for (auto alpha : {0xFF}) {
-        const std::string test_name = MakeTestName(fog_mode, gen_mode, alpha);
-        auto test = [this, fog_mode, gen_mode, alpha]() { Test(fog_mode, gen_mode, alpha); };
-        tests_[test_name] = test;
-      }
-    }
-  }
+  ParameterSweep sweep(Name());
+  sweep.AddAxis("fog_mode", kFogModes);
+  sweep.AddAxis("gen_mode", kGenModes);
+  sweep.AddAxis("alpha", kAlphas);
+  sweep.ForEach([this](const ParameterSweep::Combination& combination) {
+    const auto fog_mode = kFogModes[combination[0]];
+    const auto gen_mode = kGenModes[combination[1]];
+    const auto alpha = kAlphas[combination[2]];
+    const std::string test_name = MakeTestName(fog_mode, gen_mode, alpha);
+    tests_[test_name] = [this, fog_mode, gen_mode, alpha]() { Test(fog_mode, gen_mode, alpha); };
+  });
 }
 
 void FogTests::Initialize() {
@@ -151,6 +158,26 @@ void FogTests::Test(FogTests::FogMode fog_mode, FogTests::FogGenMode gen_mode, u
   p = pb_push1(p, NV097_SET_FOG_GEN_MODE, gen_mode);
   p = pb_push1(p, NV097_SET_FOG_MODE, fog_mode);
 
+  float bias_param;
+  float multiplier_param;
+  CalculateFogParams(fog_mode, bias_param, multiplier_param);
+
+  // TODO: Figure out what the third parameter is. In all examples I've seen it's always been 0.
+  p = pb_push3f(p, NV097_SET_FOG_PARAMS, bias_param, multiplier_param, 0.0f);
+
+  pb_end(p);
+  host_.InvalidateRegisterShadow();
+
+  host_.DrawArrays(host_.POSITION | host_.DIFFUSE);
+
+  std::string name = MakeTestName(fog_mode, gen_mode, fog_alpha);
+  pb_print("%s\n", name.c_str());
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(allow_saving_, output_dir_, name);
+}
+
+void FogTests::CalculateFogParams(FogMode fog_mode, float& bias, float& multiplier) {
   // Linear parameters.
   // TODO: Parameterize.
   // Right now these are just the near and far planes.
@@ -160,44 +187,31 @@ void FogTests::Test(FogTests::FogMode fog_mode, FogTests::FogGenMode gen_mode, u
   static constexpr float LN_256 = 5.5452f;
   static constexpr float SQRT_LN_256 = 2.3548f;
 
-  float bias_param = 0.0f;
-  float multiplier_param = 1.0f;
+  bias = 0.0f;
+  multiplier = 1.0f;
 
   switch (fog_mode) {
     case FOG_LINEAR:
     case FOG_LINEAR_ABS:
-      multiplier_param = -1.0f / (kFogEnd - kFogStart);
-      bias_param = 1.0f + -kFogEnd * multiplier_param;
+      multiplier = -1.0f / (kFogEnd - kFogStart);
+      bias = 1.0f + -kFogEnd * multiplier;
       break;
 
     case FOG_EXP:
     case FOG_EXP_ABS:
-      bias_param = 1.5f;
-      multiplier_param = -fog_density / (2.0f * LN_256);
+      bias = 1.5f;
+      multiplier = -fog_density / (2.0f * LN_256);
       break;
 
     case FOG_EXP2:
     case FOG_EXP2_ABS:
-      bias_param = 1.5f;
-      multiplier_param = -fog_density / (2.0f * SQRT_LN_256);
+      bias = 1.5f;
+      multiplier = -fog_density / (2.0f * SQRT_LN_256);
       break;
 
     default:
       break;
   }
-
-  // TODO: Figure out what the third parameter is. In all examples I've seen it's always been 0.
-  p = pb_push3f(p, NV097_SET_FOG_PARAMS, bias_param, multiplier_param, 0.0f);
-
-  pb_end(p);
-
-  host_.DrawArrays(host_.POSITION | host_.DIFFUSE);
-
-  std::string name = MakeTestName(fog_mode, gen_mode, fog_alpha);
-  pb_print("%s\n", name.c_str());
-  pb_draw_text_screen();
-
-  host_.FinishDraw(allow_saving_, output_dir_, name);
 }
 
 std::string FogTests::MakeTestName(FogTests::FogMode fog_mode, FogTests::FogGenMode gen_mode, uint32_t fog_alpha) {
@@ -292,74 +306,87 @@ void FogInfiniteFogCoordinateTests::Initialize() {
 
 // FogVec4CoordTests
 
-// clang format off
-static constexpr uint32_t kFogVec4Unset[] = {
-#include "shaders/fog_vec4_unset.inl"
-};
-static constexpr uint32_t kFogVec4W[] = {
-#include "shaders/fog_vec4_w.inl"
-};
-static constexpr uint32_t kFogVec4WX[] = {
-#include "shaders/fog_vec4_wx.inl"
-};
-static constexpr uint32_t kFogVec4WY[] = {
-#include "shaders/fog_vec4_wy.inl"
-};
-static constexpr uint32_t kFogVec4WZYX[] = {
-#include "shaders/fog_vec4_wzyx.inl"
-};
-static constexpr uint32_t kFogVec4X[] = {
-#include "shaders/fog_vec4_x.inl"
-};
-static constexpr uint32_t kFogVec4XYZW[] = {
-#include "shaders/fog_vec4_xyzw.inl"
-};
-static constexpr uint32_t kFogVec4Y[] = {
-#include "shaders/fog_vec4_y.inl"
-};
-static constexpr uint32_t kFogVec4Z[] = {
-#include "shaders/fog_vec4_z.inl"
-};
-// clang format on
-
-#define DEF_SHADER(shader) (shader), sizeof(shader)
-
 // clang format off
 static const FogVec4CoordTests::TestConfig kFogWTests[] = {
-    // None just carries over the last set value.
-    //    {"None", DEF_SHADER(kFogVec4Unset), {0.0f, 0.0f, 0.0f, 0.0f}},
-
-    {"W", DEF_SHADER(kFogVec4W), {0.0f, 0.25f, 0.0f, 0.0f}},
-    {"W", DEF_SHADER(kFogVec4W), {0.5f, 0.5f, 0.0f, 0.0f}},
-    {"W", DEF_SHADER(kFogVec4W), {1.0f, 0.0f, 0.0f, 0.5f}},
-    {"W", DEF_SHADER(kFogVec4W), {0.3f, 0.3f, 0.3f, 1.0f}},
+    {"W", {0.0f, 0.25f, 0.0f, 0.0f}},
+    {"W", {0.5f, 0.5f, 0.0f, 0.0f}},
+    {"W", {1.0f, 0.0f, 0.0f, 0.5f}},
+    {"W", {0.3f, 0.3f, 0.3f, 1.0f}},
 
-    {"WX", DEF_SHADER(kFogVec4WX), {0.25f, 0.0f, 0.0f, 0.5f}},
-    {"WX", DEF_SHADER(kFogVec4WX), {0.65f, 0.0f, 0.0f, 0.0f}},
+    {"WX", {0.25f, 0.0f, 0.0f, 0.5f}},
+    {"WX", {0.65f, 0.0f, 0.0f, 0.0f}},
 
-    {"WY", DEF_SHADER(kFogVec4WY), {1.0f, 0.0f, 1.00f, 0.75f}},
-    {"WY", DEF_SHADER(kFogVec4WY), {0.0f, 0.75f, 0.75f, 0.25f}},
+    {"WY", {1.0f, 0.0f, 1.00f, 0.75f}},
+    {"WY", {0.0f, 0.75f, 0.75f, 0.25f}},
 
-    {"WZYX", DEF_SHADER(kFogVec4WZYX), {0.25f, 0.5f, 0.75f, 1.0f}},
-    {"WZYX", DEF_SHADER(kFogVec4WZYX), {1.0f, 0.75f, 0.5f, 0.25f}},
+    {"WZYX", {0.25f, 0.5f, 0.75f, 1.0f}},
+    {"WZYX", {1.0f, 0.75f, 0.5f, 0.25f}},
 
-    {"X", DEF_SHADER(kFogVec4X), {0.0f, 0.0f, 0.0f, 0.0f}},
-    {"X", DEF_SHADER(kFogVec4X), {0.9f, 0.0f, 0.0f, 0.0f}},
+    {"X", {0.0f, 0.0f, 0.0f, 0.0f}},
+    {"X", {0.9f, 0.0f, 0.0f, 0.0f}},
 
-    {"XYZW", DEF_SHADER(kFogVec4XYZW), {1.0f, 0.25f, 0.75f, 0.5f}},
-    {"XYZW", DEF_SHADER(kFogVec4XYZW), {0.0f, 0.33f, 0.66f, 0.9f}},
+    {"XYZW", {1.0f, 0.25f, 0.75f, 0.5f}},
+    {"XYZW", {0.0f, 0.33f, 0.66f, 0.9f}},
 
-    {"Y", DEF_SHADER(kFogVec4Y), {0.0f, 0.0f, 0.0f, 0.0f}},
-    {"Y", DEF_SHADER(kFogVec4Y), {0.0f, 0.1f, 0.0f, 0.0f}},
-    {"Y", DEF_SHADER(kFogVec4Y), {0.0f, 0.6f, 0.0f, 0.0f}},
+    {"Y", {0.0f, 0.0f, 0.0f, 0.0f}},
+    {"Y", {0.0f, 0.1f, 0.0f, 0.0f}},
+    {"Y", {0.0f, 0.6f, 0.0f, 0.0f}},
 
-    {"Z", DEF_SHADER(kFogVec4Z), {0.0f, 0.0f, 0.0f, 0.0f}},
-    {"Z", DEF_SHADER(kFogVec4Z), {0.0f, 0.0f, 0.2f, 0.0f}},
-    {"Z", DEF_SHADER(kFogVec4Z), {0.0f, 0.0f, 0.8f, 0.0f}},
+    {"Z", {0.0f, 0.0f, 0.0f, 0.0f}},
+    {"Z", {0.0f, 0.0f, 0.2f, 0.0f}},
+    {"Z", {0.0f, 0.0f, 0.8f, 0.0f}},
 };
 // clang format on
 
-#undef DEF_TEST
+// Generates a program that transforms v0 by the model (c[0]), view (c[4]), and projection (c[8]) matrices, passes
+// through the diffuse color, and writes each of the given oFog components (e.g., "WZYX") from c[12], in order.
+static const std::vector<uint32_t>& GenerateFogVec4Shader(const char* components) {
+  using VPA = VertexProgramAssembler;
+  VPA vp;
+
+  vp.Mul(VPA::Temp(0), VPA::V(0).Swizzle("x"), VPA::C(0))
+      .Mad(VPA::Temp(0), VPA::V(0).Swizzle("y"), VPA::C(1), VPA::R(0))
+      .Mad(VPA::Temp(0), VPA::V(0).Swizzle("z"), VPA::C(2), VPA::R(0))
+      .Add(VPA::Temp(0), VPA::R(0), VPA::C(3));
+
+  // The view and projection matrices are applied ping-ponging between R0 and R1.
+  for (int32_t matrix = 4; matrix <= 8; matrix += 4) {
+    auto src = VPA::R(matrix == 4 ? 0 : 1);
+    auto dst = VPA::Temp(matrix == 4 ? 1 : 0);
+    vp.Mul(dst, src.Swizzle("x"), VPA::C(matrix))
+        .Mad(dst, src.Swizzle("y"), VPA::C(matrix + 1), VPA::R(dst.address))
+        .Mad(dst, src.Swizzle("z"), VPA::C(matrix + 2), VPA::R(dst.address))
+        .Mad(dst, src.Swizzle("w"), VPA::C(matrix + 3), VPA::R(dst.address));
+  }
+
+  vp.Rcp(VPA::Temp(1, VPA::MASK_X), VPA::R(0).Swizzle("w"))
+      .Mul(VPA::Output(VPA::OUT_POSITION, VPA::MASK_XYZ), VPA::R(0), VPA::R(1).Swizzle("x"))
+      .Mov(VPA::Output(VPA::OUT_POSITION, VPA::MASK_W), VPA::R(0))
+      .Mov(VPA::Output(VPA::OUT_DIFFUSE), VPA::V(3));
+
+  for (auto component = components; *component; ++component) {
+    uint32_t mask = 0;
+    switch (*component) {
+      case 'X':
+        mask = VPA::MASK_X;
+        break;
+      case 'Y':
+        mask = VPA::MASK_Y;
+        break;
+      case 'Z':
+        mask = VPA::MASK_Z;
+        break;
+      case 'W':
+        mask = VPA::MASK_W;
+        break;
+      default:
+        ASSERT(!"Invalid fog component.");
+    }
+    vp.Mov(VPA::Output(VPA::OUT_FOG, mask), VPA::C(12));
+  }
+
+  return vp.Assemble();
+}
 
 FogVec4CoordTests::FogVec4CoordTests(TestHost& host, std::string output_dir)
     : FogCustomShaderTests(host, std::move(output_dir), "Fog coord vec4") {
@@ -394,12 +421,9 @@ void FogVec4CoordTests::Initialize() {
 
 void FogVec4CoordTests::Test(const TestConfig& config) {
   auto shader = host_.GetShaderProgram();
-  shader->SetShaderOverride(config.shader, config.shader_size);
+  auto& program = GenerateFogVec4Shader(config.prefix);
+  shader->SetShaderOverride(program.data(), program.size() * sizeof(uint32_t));
   shader->SetUniformF(12, config.fog[0], config.fog[1], config.fog[2], config.fog[3]);
-  // const c[13] = 1 0
-  shader->SetUniformF(13, 1.0f, 0.0f);
-  // Hack for bug in Cg/vpcompiler wrt. clamp on the y-value. See fog_vec4_y.vs.cg.
-  shader->SetUniformF(14, config.fog[1]);
   host_.SetVertexShaderProgram(shader);
 
   static constexpr uint32_t kBackgroundColor = 0xFF303030;
@@ -433,12 +457,13 @@ void FogVec4CoordTests::Test(const TestConfig& config) {
   p = pb_push3f(p, NV097_SET_FOG_PARAMS, 1.0f, 1.0f, 0.0f);
 
   pb_end(p);
+  host_.InvalidateRegisterShadow();
 
   host_.DrawArrays(host_.POSITION | host_.DIFFUSE);
 
   std::string name = MakeTestName(config);
   pb_print("%s\n", name.c_str());
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, name);
 }
@@ -36,6 +36,9 @@ class FogTests : public TestSuite {
   void Initialize() override;
   void Deinitialize() override;
 
+  // Calculates the NV097_SET_FOG_PARAMS bias and multiplier used by these tests for the given mode.
+  static void CalculateFogParams(FogMode fog_mode, float& bias, float& multiplier);
+
  protected:
   virtual void CreateGeometry();
   void Test(FogMode fog_mode, FogGenMode gen_mode, uint32_t fog_alpha);
@@ -61,9 +64,8 @@ class FogInfiniteFogCoordinateTests : public FogCustomShaderTests {
 class FogVec4CoordTests : public FogCustomShaderTests {
  public:
   struct TestConfig {
+    // The oFog components written by the test shader, in order.
     const char* prefix;
-    const uint32_t* shader;
-    const uint32_t shader_size;
     float fog[4];
   };
 
@@ -4,6 +4,7 @@
 
 #include "../test_host.h"
 #include "debug_output.h"
+#include "parameter_sweep.h"
 #include "shaders/precalculated_vertex_shader.h"
 #include "vertex_buffer.h"
 
@@ -24,14 +25,15 @@ static constexpr uint32_t kCullFaces[] = {
 
 FrontFaceTests::FrontFaceTests(TestHost& host, std::string output_dir)
     : TestSuite(host, std::move(output_dir), "Front face") {
-  for (auto winding : kWindings) {
-    for (auto cull_face : kCullFaces) {
-      std::string name = MakeTestName(winding, cull_face);
-
-      auto test = [this, winding, cull_face]() { this->Test(winding, cull_face); };
-      tests_[name] = test;
-    }
-  }
+  ParameterSweep sweep(Name());
+  sweep.AddAxis("winding", kWindings);
+  sweep.AddAxis("cull_face", kCullFaces);
+  sweep.ForEach([this](const ParameterSweep::Combination& combination) {
+    const auto winding = kWindings[combination[0]];
+    const auto cull_face = kCullFaces[combination[1]];
+    std::string name = MakeTestName(winding, cull_face);
+    tests_[name] = [this, winding, cull_face]() { this->Test(winding, cull_face); };
+  });
 }
 
 void FrontFaceTests::Initialize() {
@@ -110,8 +112,7 @@ void FrontFaceTests::Test(uint32_t front_face, uint32_t cull_face) {
     pb_end(p);
   }
 
-  while (pb_busy()) {
-  }
+  TestHost::WaitForPushbufferDrained();
 
   auto p = pb_begin();
   p = pb_push1(p, NV097_SET_FRONT_FACE, front_face);
@@ -125,7 +126,7 @@ void FrontFaceTests::Test(uint32_t front_face, uint32_t cull_face) {
   pb_print("CF: %s\n", cull_face_name.c_str());
   pb_printat(8, 19, (char*)"CCW");
   pb_printat(8, 38, (char*)"CW");
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   std::string name = MakeTestName(front_face, cull_face);
   host_.FinishDraw(allow_saving_, output_dir_, name);
@@ -10,6 +10,7 @@ class FrontFaceTests : public TestSuite {
   FrontFaceTests(TestHost &host, std::string output_dir);
 
   void Initialize() override;
+  bool SupportsTiledRendering() const override { return true; }
 
  private:
   void CreateGeometry();
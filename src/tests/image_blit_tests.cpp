@@ -4,8 +4,10 @@
 #include <pbkit/pbkit.h>
 
 #include "debug_output.h"
+#include "memory_tracker.h"
 #include "nxdk_ext.h"
 #include "pbkit_ext.h"
+#include "sdl_subsystems.h"
 #include "test_host.h"
 #include "vertex_buffer.h"
 
@@ -87,6 +89,22 @@ static constexpr ImageBlitTests::BlitTest kTests[] = {
     //    {NV09F_SET_OPERATION_SRCCOPY_PREMULT, NV04_SURFACE_2D_FORMAT_A8R8G8B8, 0x00000033},
 };
 
+// BLEND_AND uses a 1.31 fixed point beta, the premultiplied operations an ARGB beta.
+static constexpr ImageBlitTests::BlitTest kBenchmarks[] = {
+    {NV09F_SET_OPERATION_SRCCOPY, NV04_SURFACE_2D_FORMAT_X8R8G8B8_X8R8G8B8, 0},
+    {NV09F_SET_OPERATION_SRCCOPY, NV04_SURFACE_2D_FORMAT_X8R8G8B8_Z8R8G8B8, 0},
+    {NV09F_SET_OPERATION_SRCCOPY, NV04_SURFACE_2D_FORMAT_A8R8G8B8, 0},
+    {NV09F_SET_OPERATION_BLEND_AND, NV04_SURFACE_2D_FORMAT_X8R8G8B8_X8R8G8B8, 0x40000000},
+    {NV09F_SET_OPERATION_BLEND_AND, NV04_SURFACE_2D_FORMAT_X8R8G8B8_Z8R8G8B8, 0x40000000},
+    {NV09F_SET_OPERATION_BLEND_AND, NV04_SURFACE_2D_FORMAT_A8R8G8B8, 0x40000000},
+    {NV09F_SET_OPERATION_SRCCOPY_PREMULT, NV04_SURFACE_2D_FORMAT_X8R8G8B8_X8R8G8B8, 0x80808080},
+    {NV09F_SET_OPERATION_SRCCOPY_PREMULT, NV04_SURFACE_2D_FORMAT_A8R8G8B8, 0x80808080},
+    {NV09F_SET_OPERATION_BLEND_AND_PREMULT, NV04_SURFACE_2D_FORMAT_X8R8G8B8_X8R8G8B8, 0x80808080},
+    {NV09F_SET_OPERATION_BLEND_AND_PREMULT, NV04_SURFACE_2D_FORMAT_A8R8G8B8, 0x80808080},
+};
+
+static constexpr uint32_t kBenchmarkIterations = 16;
+
 ImageBlitTests::ImageBlitTests(TestHost& host, std::string output_dir)
     : TestSuite(host, std::move(output_dir), "Image blit") {
   for (auto test : kTests) {
@@ -95,12 +113,17 @@ ImageBlitTests::ImageBlitTests(TestHost& host, std::string output_dir)
     auto test_method = [this, test]() { this->Test(test); };
     tests_[name] = test_method;
   }
+
+  for (auto benchmark : kBenchmarks) {
+    tests_[MakeBenchmarkName(benchmark)] = [this, benchmark]() { Benchmark(benchmark); };
+  }
 }
 
 void ImageBlitTests::Initialize() {
   TestSuite::Initialize();
   SetDefaultTextureFormat();
 
+  ASSERT(SDLSubsystems::EnsureImageSupport());
   SDL_Surface* temp = IMG_Load("D:\\image_blit\\TestImage.png");
   ASSERT(temp);
   SDL_Surface* test_image = SDL_ConvertSurfaceFormat(temp, SDL_PIXELFORMAT_BGRA32, 0);
@@ -111,35 +134,34 @@ void ImageBlitTests::Initialize() {
   uint32_t image_bytes = image_pitch_ * image_height_;
 
   source_image_ = static_cast<uint8_t*>(MmAllocateContiguousMemory(image_bytes));
+  MemoryTracker::RecordAllocation(MemoryTracker::CATEGORY_SUITE, image_bytes);
   memcpy(source_image_, test_image->pixels, image_bytes);
   SDL_free(test_image);
 
-  // TODO: Provide a mechanism to find the next unused channel.
-  auto channel = kNextContextChannel;
-
-  pb_create_dma_ctx(channel++, DMA_CLASS_3D, 0, MAXRAM, &image_src_dma_ctx_);
-  pb_bind_channel(&image_src_dma_ctx_);
-
-  pb_create_gr_ctx(channel++, GR_CLASS_30, &null_ctx_);
-  pb_bind_channel(&null_ctx_);
-
-  pb_create_gr_ctx(channel++, GR_CLASS_19, &clip_rect_ctx_);
-  pb_bind_channel(&clip_rect_ctx_);
-  // TODO: Provide a mechanism to find the next unused subchannel.
-  pb_bind_subchannel(SUBCH_CLASS_19, &clip_rect_ctx_);
-
-  pb_create_gr_ctx(channel++, GR_CLASS_12, &beta_ctx_);
-  pb_bind_channel(&beta_ctx_);
-  pb_bind_subchannel(SUBCH_CLASS_12, &beta_ctx_);
+  uint32_t benchmark_bytes = 4 * host_.GetFramebufferWidth() * host_.GetFramebufferHeight();
+  benchmark_image_ = static_cast<uint8_t*>(MmAllocateContiguousMemory(benchmark_bytes));
+  ASSERT(benchmark_image_ && "Failed to allocate benchmark source image.");
+  MemoryTracker::RecordAllocation(MemoryTracker::CATEGORY_SUITE, benchmark_bytes);
+  auto pixel = reinterpret_cast<uint32_t*>(benchmark_image_);
+  for (uint32_t i = 0; i < benchmark_bytes / 4; ++i) {
+    *pixel++ = 0x80000000 | (i * 0x010203);
+  }
 
-  pb_create_gr_ctx(channel++, GR_CLASS_72, &beta4_ctx_);
-  pb_bind_channel(&beta4_ctx_);
-  pb_bind_subchannel(SUBCH_CLASS_72, &beta4_ctx_);
+  // The objects are shared for the whole run, subchannels are bound as each blit needs them.
+  null_ctx_ = &host_.GetNullObject();
+  clip_rect_ctx_ = &host_.GetGraphicsObject(GR_CLASS_19);
+  beta_ctx_ = &host_.GetGraphicsObject(GR_CLASS_12);
+  beta4_ctx_ = &host_.GetGraphicsObject(GR_CLASS_72);
 }
 
 void ImageBlitTests::Deinitialize() {
   MmFreeContiguousMemory(source_image_);
   source_image_ = nullptr;
+  MemoryTracker::RecordRelease(MemoryTracker::CATEGORY_SUITE, image_pitch_ * image_height_);
+  MmFreeContiguousMemory(benchmark_image_);
+  benchmark_image_ = nullptr;
+  MemoryTracker::RecordRelease(MemoryTracker::CATEGORY_SUITE,
+                               4 * host_.GetFramebufferWidth() * host_.GetFramebufferHeight());
 }
 
 void ImageBlitTests::ImageBlit(uint32_t operation, uint32_t beta, uint32_t source_channel, uint32_t destination_channel,
@@ -148,11 +170,19 @@ void ImageBlitTests::ImageBlit(uint32_t operation, uint32_t beta, uint32_t sourc
                                uint32_t destination_offset, uint32_t destination_x, uint32_t destination_y,
                                uint32_t width, uint32_t height, uint32_t clip_x, uint32_t clip_y, uint32_t clip_width,
                                uint32_t clip_height) const {
-  PrintMsg("ImageBlit: %d beta: 0x%08X src: %d dest: %d\n", operation, beta, source_channel, destination_channel);
+  GpuProfiler::ScopedRegion scope(host_.GetGpuProfiler(), GpuProfiler::SCOPE_BLIT);
+
+  host_.BindSubchannel(SUBCH_CLASS_19, *clip_rect_ctx_);
+  if (operation == NV09F_SET_OPERATION_BLEND_AND) {
+    host_.BindSubchannel(SUBCH_CLASS_12, *beta_ctx_);
+  } else if (operation == NV09F_SET_OPERATION_SRCCOPY_PREMULT || operation == NV09F_SET_OPERATION_BLEND_AND_PREMULT) {
+    host_.BindSubchannel(SUBCH_CLASS_72, *beta4_ctx_);
+  }
+
   auto p = pb_begin();
   p = pb_push1_to(SUBCH_CLASS_19, p, NV01_CONTEXT_CLIP_RECTANGLE_SET_POINT, clip_x | (clip_y << 16));
   p = pb_push1_to(SUBCH_CLASS_19, p, NV01_CONTEXT_CLIP_RECTANGLE_SET_SIZE, clip_width | (clip_height << 16));
-  p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_CLIP_RECTANGLE, clip_rect_ctx_.ChannelID);
+  p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_CLIP_RECTANGLE, clip_rect_ctx_->ChannelID);
   pb_end(p);
 
   p = pb_begin();
@@ -166,23 +196,23 @@ void ImageBlitTests::ImageBlit(uint32_t operation, uint32_t beta, uint32_t sourc
   p = pb_push1_to(SUBCH_CLASS_62, p, NV10_CONTEXT_SURFACES_2D_OFFSET_SRC, source_offset);
   p = pb_push1_to(SUBCH_CLASS_62, p, NV10_CONTEXT_SURFACES_2D_OFFSET_DST, destination_offset);
 
-  p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_COLOR_KEY, null_ctx_.ChannelID);
-  p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_PATTERN, null_ctx_.ChannelID);
-  p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_ROP5, null_ctx_.ChannelID);
+  p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_COLOR_KEY, null_ctx_->ChannelID);
+  p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_PATTERN, null_ctx_->ChannelID);
+  p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_ROP5, null_ctx_->ChannelID);
 
   if (operation != NV09F_SET_OPERATION_BLEND_AND) {
-    p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_SET_BETA, null_ctx_.ChannelID);
+    p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_SET_BETA, null_ctx_->ChannelID);
   } else {
     p = pb_push1_to(SUBCH_CLASS_12, p, NV012_SET_BETA, beta);
-    p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_SET_BETA, beta_ctx_.ChannelID);
+    p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_SET_BETA, beta_ctx_->ChannelID);
   }
 
   if (operation != NV09F_SET_OPERATION_SRCCOPY_PREMULT && operation != NV09F_SET_OPERATION_BLEND_AND_PREMULT) {
-    p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_SET_BETA4, null_ctx_.ChannelID);
+    p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_SET_BETA4, null_ctx_->ChannelID);
   } else {
     // beta is ARGB
     p = pb_push1_to(SUBCH_CLASS_72, p, NV072_SET_BETA, beta);
-    p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_SET_BETA4, beta4_ctx_.ChannelID);
+    p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_SET_BETA4, beta4_ctx_->ChannelID);
   }
 
   p = pb_push1_to(SUBCH_CLASS_9F, p, NV_IMAGE_BLIT_POINT_IN, source_x | (source_y << 16));
@@ -196,14 +226,16 @@ void ImageBlitTests::Test(const BlitTest& test) {
   host_.PrepareDraw(0xF0440011);
 
   uint32_t image_bytes = image_pitch_ * image_height_;
-  pb_set_dma_address(&image_src_dma_ctx_, source_image_, image_bytes - 1);
+  auto& image_src_dma_ctx = host_.BindDmaContext(TestHost::DMA_CONTEXT_BLIT_SOURCE, source_image_, image_bytes - 1);
 
   uint32_t clip_x = 0;
   uint32_t clip_y = 0;
   uint32_t clip_w = host_.GetFramebufferWidth();
   uint32_t clip_h = host_.GetFramebufferHeight();
 
-  ImageBlit(test.blit_operation, test.beta, image_src_dma_ctx_.ChannelID,
+  PrintMsg("ImageBlit: %d beta: 0x%08X src: %d dest: %d\n", test.blit_operation, test.beta,
+           image_src_dma_ctx.ChannelID, DMA_CHANNEL_BITBLT_IMAGES);
+  ImageBlit(test.blit_operation, test.beta, image_src_dma_ctx.ChannelID,
             DMA_CHANNEL_BITBLT_IMAGES,  // DMA channel 11 - 0x1117
             test.buffer_color_format, image_pitch_, 4 * host_.GetFramebufferWidth(), 0, SOURCE_X, SOURCE_Y, 0,
             DESTINATION_X, DESTINATION_Y, SOURCE_WIDTH, SOURCE_HEIGHT, clip_x, clip_y, clip_w, clip_h);
@@ -215,12 +247,44 @@ void ImageBlitTests::Test(const BlitTest& test) {
   if (test.blit_operation != NV09F_SET_OPERATION_SRCCOPY) {
     pb_print("Beta: %08X\n", test.beta);
   }
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   std::string name = MakeTestName(test);
   host_.FinishDraw(allow_saving_, output_dir_, name);
 }
 
+void ImageBlitTests::Benchmark(const BlitTest& benchmark) {
+  host_.PrepareDraw(0xF0440011);
+
+  uint32_t width = host_.GetFramebufferWidth();
+  uint32_t height = host_.GetFramebufferHeight();
+  uint32_t pitch = 4 * width;
+  const uint32_t source_channel =
+      host_.BindDmaContext(TestHost::DMA_CONTEXT_BLIT_SOURCE, benchmark_image_, pitch * height - 1).ChannelID;
+
+  double seconds = MeasureGpuSeconds([this, &benchmark, width, height, pitch, source_channel]() {
+    for (uint32_t i = 0; i < kBenchmarkIterations; ++i) {
+      ImageBlit(benchmark.blit_operation, benchmark.beta, source_channel, DMA_CHANNEL_BITBLT_IMAGES,
+                benchmark.buffer_color_format, pitch, pitch, 0, 0, 0, 0, 0, 0, width, height, 0, 0, width, height);
+    }
+  });
+
+  // Measured in bytes of destination written, regardless of whether the operation also reads the destination.
+  double megabytes = static_cast<double>(pitch) * height * kBenchmarkIterations / (1024.0 * 1024.0);
+  double megabytes_per_second = seconds > 0.0 ? megabytes / seconds : 0.0;
+
+  std::string name = MakeBenchmarkName(benchmark);
+  RecordBenchmarkResult(name, "bandwidth", megabytes_per_second, "MB/s");
+
+  host_.Clear(0xF0440011);
+  pb_print("Op: %s\n", OperationName(benchmark.blit_operation).c_str());
+  pb_print("BufFmt: %s\n", ColorFormatName(benchmark.buffer_color_format).c_str());
+  pb_print("%u MB/s\n", static_cast<uint32_t>(megabytes_per_second));
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(false, output_dir_, name);
+}
+
 std::string ImageBlitTests::MakeTestName(const BlitTest& test) {
   char buf[256] = {0};
   snprintf(buf, 255, "ImgBlt_%s_%s_B%08X", OperationName(test.blit_operation).c_str(),
@@ -228,6 +292,13 @@ std::string ImageBlitTests::MakeTestName(const BlitTest& test) {
   return buf;
 }
 
+std::string ImageBlitTests::MakeBenchmarkName(const BlitTest& benchmark) {
+  char buf[256] = {0};
+  snprintf(buf, 255, "ImgBltBench_%s_%s", OperationName(benchmark.blit_operation).c_str(),
+           ColorFormatName(benchmark.buffer_color_format).c_str());
+  return buf;
+}
+
 static std::string OperationName(uint32_t operation) {
   if (operation == NV09F_SET_OPERATION_BLEND_AND) {
     return "BLENDAND";
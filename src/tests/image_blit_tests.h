@@ -23,6 +23,8 @@ class ImageBlitTests : public TestSuite {
 
  private:
   void Test(const BlitTest& test);
+  // Repeatedly blits a full framebuffer sized rectangle to measure throughput.
+  void Benchmark(const BlitTest& benchmark);
   void ImageBlit(uint32_t operation, uint32_t beta, uint32_t source_channel, uint32_t destination_channel,
                  uint32_t surface_format, uint32_t source_pitch, uint32_t destination_pitch, uint32_t source_offset,
                  uint32_t source_x, uint32_t source_y, uint32_t destination_offset, uint32_t destination_x,
@@ -30,16 +32,19 @@ class ImageBlitTests : public TestSuite {
                  uint32_t clip_width, uint32_t clip_height) const;
 
   static std::string MakeTestName(const BlitTest& test);
+  static std::string MakeBenchmarkName(const BlitTest& benchmark);
 
   uint32_t image_pitch_{0};
   uint32_t image_height_{0};
   uint8_t* source_image_{nullptr};
-
-  struct s_CtxDma null_ctx_ {};
-  struct s_CtxDma image_src_dma_ctx_ {};
-  struct s_CtxDma clip_rect_ctx_ {};
-  struct s_CtxDma beta_ctx_ {};
-  struct s_CtxDma beta4_ctx_ {};
+  // Framebuffer sized source for the benchmarks.
+  uint8_t* benchmark_image_{nullptr};
+
+  // Shared objects owned by the TestHost, see TestHost::GetGraphicsObject.
+  const struct s_CtxDma* null_ctx_{nullptr};
+  const struct s_CtxDma* clip_rect_ctx_{nullptr};
+  const struct s_CtxDma* beta_ctx_{nullptr};
+  const struct s_CtxDma* beta4_ctx_{nullptr};
 };
 
 #endif  // NXDK_PGRAPH_TESTS_IMAGE_BLIT_TESTS_H
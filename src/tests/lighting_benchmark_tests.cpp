@@ -0,0 +1,127 @@
+#include "lighting_benchmark_tests.h"
+
+#include <pbkit/pbkit.h>
+
+#include "geometry_builder.h"
+#include "pbkit_ext.h"
+#include "vertex_buffer.h"
+
+static constexpr TestHost::Light::Type kLightTypes[] = {
+    TestHost::Light::LIGHT_INFINITE,
+    TestHost::Light::LIGHT_LOCAL,
+};
+
+// Vertex lighting cost is per vertex, so the grid is dense enough to make transform the bottleneck while keeping every
+// index addressable by DrawInlineElements16.
+static constexpr uint32_t kGridColumns = 128;
+static constexpr uint32_t kGridRows = 72;
+static constexpr uint32_t kRepetitions = 10;
+
+static constexpr uint32_t kVertexFields = TestHost::POSITION | TestHost::NORMAL;
+
+LightingBenchmarkTests::LightingBenchmarkTests(TestHost& host, std::string output_dir)
+    : TestSuite(host, std::move(output_dir), "Lighting") {
+  tests_[MakeTestName(TestHost::Light::LIGHT_OFF, 0)] = [this]() { Test(TestHost::Light::LIGHT_OFF, 0); };
+  for (auto type : kLightTypes) {
+    for (uint32_t num_lights = 1; num_lights <= TestHost::kNumLights; ++num_lights) {
+      tests_[MakeTestName(type, num_lights)] = [this, type, num_lights]() { Test(type, num_lights); };
+    }
+  }
+}
+
+void LightingBenchmarkTests::Initialize() {
+  TestSuite::Initialize();
+
+  host_.SetVertexShaderProgram(nullptr);
+  CreateGeometry();
+  host_.SetXDKDefaultViewportAndFixedFunctionMatrices();
+
+  auto p = pb_begin();
+  p = pb_push1(p, NV097_SET_LIGHT_CONTROL, 0x10001);
+  p = pb_push1(p, NV097_SET_LIGHTING_ENABLE, true);
+  p = pb_push1(p, NV097_SET_SPECULAR_ENABLE, true);
+  p = pb_push1(p, NV097_SET_COLOR_MATERIAL, NV097_SET_COLOR_MATERIAL_ALL_FROM_MATERIAL);
+  pb_end(p);
+}
+
+void LightingBenchmarkTests::Deinitialize() {
+  auto p = pb_begin();
+  p = pb_push1(p, NV097_SET_LIGHTING_ENABLE, false);
+  p = pb_push1(p, NV097_SET_SPECULAR_ENABLE, false);
+  pb_end(p);
+
+  host_.SetVertexBuffer(nullptr);
+  grid_buffer_.reset();
+  grid_index_buffer_ = IndexBuffer();
+  TestSuite::Deinitialize();
+}
+
+void LightingBenchmarkTests::CreateGeometry() {
+  grid_buffer_ = host_.AllocateVertexBuffer(GetGridVertexCount(kGridColumns, kGridRows));
+  grid_index_buffer_.Clear();
+  DefineGrid(*grid_buffer_, 0, grid_index_buffer_, -2.75f, 1.75f, 2.75f, -1.75f, 3.0f, kGridColumns, kGridRows,
+             Color{1.0f, 1.0f, 1.0f, 1.0f});
+}
+
+void LightingBenchmarkTests::Test(TestHost::Light::Type type, uint32_t num_lights) {
+  host_.SetVertexBuffer(grid_buffer_);
+  host_.PrepareDraw(0xFF202020);
+
+  // Spread the lights across the grid with distinct colors so that each contributes visibly.
+  TestHost::Light lights[TestHost::kNumLights];
+  for (uint32_t i = 0; i < num_lights; ++i) {
+    auto& light = lights[i];
+    const float offset = static_cast<float>(i) / static_cast<float>(TestHost::kNumLights) - 0.5f;
+    if (type == TestHost::Light::LIGHT_LOCAL) {
+      float position[] = {offset * 5.0f, offset * -3.0f, 1.5f};
+      light.SetLocal(position, 10.0f, 0.0f, 0.5f, 0.0f);
+    } else {
+      light.SetInfinite(offset, -offset, -1.0f);
+    }
+    light.SetDiffuse({(i & 0x01) ? 0.5f : 0.1f, (i & 0x02) ? 0.5f : 0.1f, (i & 0x04) ? 0.5f : 0.1f, 1.0f})
+        .SetSpecular({0.25f, 0.25f, 0.25f, 1.0f})
+        .SetAmbient({0.1f, 0.1f, 0.1f, 1.0f});
+  }
+
+  TestHost::Material material;
+  material.SetSpecular({1.0f, 1.0f, 1.0f, 1.0f}).SetAmbient({1.0f, 1.0f, 1.0f, 1.0f});
+  host_.SetLighting({0.1f, 0.1f, 0.1f, 1.0f}, material, lights, num_lights);
+
+  double gpu_seconds = MeasureGpuSeconds([this]() {
+    for (uint32_t i = 0; i < kRepetitions; ++i) {
+      host_.DrawInlineElements16(grid_index_buffer_, kVertexFields);
+    }
+  });
+
+  std::string name = MakeTestName(type, num_lights);
+  const uint32_t num_vertices = GetGridIndexCount(kGridColumns, kGridRows) * kRepetitions;
+  RecordBenchmarkResult(name, "lights", num_lights, "lights");
+  RecordBenchmarkResult(name, "vertices", num_vertices, "vertices");
+  RecordBenchmarkResult(name, "gpu_complete_time", gpu_seconds * 1000000.0, "us");
+
+  pb_print("%s\n", name.c_str());
+  pb_print("%u vertices\n", num_vertices);
+  pb_print("GPU complete: %u us\n", static_cast<uint32_t>(gpu_seconds * 1000000.0));
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(false, output_dir_, name);
+}
+
+std::string LightingBenchmarkTests::MakeTestName(TestHost::Light::Type type, uint32_t num_lights) {
+  const char* type_name = "";
+  switch (type) {
+    case TestHost::Light::LIGHT_OFF:
+      type_name = "AmbientOnly";
+      break;
+    case TestHost::Light::LIGHT_INFINITE:
+      type_name = "Infinite";
+      break;
+    case TestHost::Light::LIGHT_LOCAL:
+      type_name = "Local";
+      break;
+  }
+
+  char buf[32] = {0};
+  snprintf(buf, 31, "%s_%u", type_name, num_lights);
+  return buf;
+}
@@ -0,0 +1,32 @@
+#ifndef NXDK_PGRAPH_TESTS_LIGHTING_BENCHMARK_TESTS_H
+#define NXDK_PGRAPH_TESTS_LIGHTING_BENCHMARK_TESTS_H
+
+#include <memory>
+#include <string>
+
+#include "index_buffer.h"
+#include "test_host.h"
+#include "test_suite.h"
+
+class VertexBuffer;
+
+// Measures the GPU cost of fixed function vertex lighting as the number and type of enabled lights grows.
+class LightingBenchmarkTests : public TestSuite {
+ public:
+  LightingBenchmarkTests(TestHost& host, std::string output_dir);
+  void Initialize() override;
+  void Deinitialize() override;
+  bool IsBenchmark() const override { return true; }
+
+ private:
+  void CreateGeometry();
+  void Test(TestHost::Light::Type type, uint32_t num_lights);
+
+  static std::string MakeTestName(TestHost::Light::Type type, uint32_t num_lights);
+
+ private:
+  std::shared_ptr<VertexBuffer> grid_buffer_;
+  IndexBuffer grid_index_buffer_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_LIGHTING_BENCHMARK_TESTS_H
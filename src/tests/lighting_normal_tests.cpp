@@ -40,30 +40,18 @@ LightingNormalTests::LightingNormalTests(TestHost& host, std::string output_dir)
   }
 }
 
-static void SetLightAndMaterial() {
+static void SetLightAndMaterial(TestHost &host) {
   auto p = pb_begin();
-  p = pb_push1(p, NV097_SET_SPECULAR_PARAMS, 0xbf34dce5);
-  p = pb_push1(p, 0x09e4, 0xc020743f);
-  p = pb_push1(p, 0x09e8, 0x40333d06);
-  p = pb_push1(p, 0x09ec, 0xbf003612);
-  p = pb_push1(p, 0x09f0, 0xbff852a5);
-  p = pb_push1(p, 0x09f4, 0x401c1bce);
-
   p = pb_push1(p, NV097_SET_COLOR_MATERIAL, NV097_SET_COLOR_MATERIAL_ALL_FROM_MATERIAL);
-  p = pb_push3(p, NV097_SET_SCENE_AMBIENT_COLOR, 0x0, 0x0, 0x0);
-  p = pb_push3(p, NV097_SET_MATERIAL_EMISSION, 0x0, 0x0, 0x0);
-  p = pb_push1f(p, NV097_SET_MATERIAL_ALPHA, 1.0f);
+  pb_end(p);
 
-  p = pb_push3(p, NV097_SET_LIGHT_AMBIENT_COLOR, 0, 0, 0);
-  p = pb_push3f(p, NV097_SET_LIGHT_DIFFUSE_COLOR, 0.0f, 1.0f, 0.7f);
-  p = pb_push3(p, NV097_SET_LIGHT_SPECULAR_COLOR, 0, 0, 0);
-  p = pb_push1(p, NV097_SET_LIGHT_LOCAL_RANGE, 0x7149f2ca);  // 1e30
-  p = pb_push3(p, NV097_SET_LIGHT_INFINITE_HALF_VECTOR, 0, 0, 0);
-  p = pb_push3f(p, NV097_SET_LIGHT_INFINITE_DIRECTION, 0.0f, 0.0f, 1.0f);
+  TestHost::Light light;
+  light.SetInfinite(0.0f, 0.0f, -1.0f).SetHalfVector(0.0f, 0.0f, 0.0f).SetDiffuse(Color{0.0f, 1.0f, 0.7f, 1.0f});
 
-  p = pb_push1(p, NV097_SET_LIGHT_ENABLE_MASK, NV097_SET_LIGHT_ENABLE_MASK_LIGHT0_INFINITE);
+  TestHost::Material material;
+  material.SetSpecularParams(TestHost::Material::kSpecularParamsPower10);
 
-  pb_end(p);
+  host.SetLighting(Color{0.0f, 0.0f, 0.0f, 0.0f}, material, &light, 1);
 }
 
 void LightingNormalTests::Initialize() {
@@ -82,7 +70,7 @@ void LightingNormalTests::Initialize() {
   p = pb_push1(p, NV097_SET_VERTEX_DATA4UB + (4 * NV2A_VERTEX_ATTR_BACK_SPECULAR), 0);
   pb_end(p);
 
-  SetLightAndMaterial();
+  SetLightAndMaterial(host_);
 }
 
 void LightingNormalTests::Deinitialize() {
@@ -196,7 +184,7 @@ void LightingNormalTests::Test(bool set_normal, const float* normal, DrawMode dr
       pb_print("Inline arrays\n");
       break;
   }
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   std::string name = MakeTestName(set_normal, normal, draw_mode);
   host_.FinishDraw(allow_saving_, output_dir_, name);
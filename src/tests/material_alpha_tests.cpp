@@ -18,6 +18,10 @@ static constexpr float kAlphaValues[] = {
     -1.0f, 0.0f, 0.05f, 0.25f, 0.5f, 0.75f, 1.0f, 2.0f,
 };
 
+// NV097_SET_SPECULAR_PARAMS captured from a D3D material.
+static constexpr uint32_t kSpecularParams[6] = {0xBF7730E0, 0xC0497B30, 0x404BAEF8,
+                                                0xBF6E9EE4, 0xC0463F88, 0x404A97CF};
+
 static std::string DiffuseSourceName(uint32_t diffuse_source);
 
 MaterialAlphaTests::MaterialAlphaTests(TestHost& host, std::string output_dir)
@@ -115,30 +119,6 @@ void MaterialAlphaTests::Test(uint32_t diffuse_source, float material_alpha) {
   host_.PrepareDraw(kBackgroundColor);
 
   auto p = pb_begin();
-
-  // Set up a directional light.
-  p = pb_push1(p, NV097_SET_LIGHT_ENABLE_MASK, NV097_SET_LIGHT_ENABLE_MASK_LIGHT0_INFINITE);
-
-  // Ambient color comes from the material's diffuse color.
-  pb_push_to(SUBCH_3D, p++, NV097_SET_LIGHT_AMBIENT_COLOR, 9);
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x3F6EEEEF;  // 0.933333 0xEE
-  *(p++) = 0x3F3BBBBC;  // 0.733333 0xBB
-  *(p++) = 0x3F2AAAAB;  // 0.666667 0xAA
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  p = pb_push1(p, NV097_SET_LIGHT_LOCAL_RANGE, 0x7149f2ca);  // 1e+30
-  pb_push_to(SUBCH_3D, p++, NV097_SET_LIGHT_INFINITE_HALF_VECTOR, 6);
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x0;
-  *(p++) = 0x3F800000;
-
   p = pb_push1(p, NV097_SET_CONTROL0, 0x100001);
 
   p = pb_push1(p, NV097_SET_VERTEX_DATA4UB + 0x0C, 0xFFFFFFFF);
@@ -148,37 +128,34 @@ void MaterialAlphaTests::Test(uint32_t diffuse_source, float material_alpha) {
 
   p = pb_push1(p, NV10_TCL_PRIMITIVE_3D_POINT_PARAMETERS_ENABLE, 0x0);
 
-  p = pb_push1(p, NV097_SET_SPECULAR_PARAMS, 0xBF7730E0);
-  p = pb_push1(p, NV097_SET_SPECULAR_PARAMS + 4, 0xC0497B30);
-  p = pb_push1(p, NV097_SET_SPECULAR_PARAMS + 8, 0x404BAEF8);
-  p = pb_push1(p, NV097_SET_SPECULAR_PARAMS + 12, 0xBF6E9EE4);
-  p = pb_push1(p, NV097_SET_SPECULAR_PARAMS + 16, 0xC0463F88);
-  p = pb_push1(p, NV097_SET_SPECULAR_PARAMS + 20, 0x404A97CF);
-
   p = pb_push1(p, NV097_SET_LIGHT_CONTROL, 0x10001);
 
   p = pb_push1(p, NV097_SET_LIGHTING_ENABLE, 0x1);
   p = pb_push1(p, NV097_SET_SPECULAR_ENABLE, 0x1);
 
   p = pb_push1(p, NV097_SET_COLOR_MATERIAL, diffuse_source);
-  p = pb_push3(p, NV097_SET_SCENE_AMBIENT_COLOR, 0x0, 0x3C6DDACA, 0x0);
+  pb_end(p);
+  host_.InvalidateRegisterShadow();
 
-  p = pb_push1(p, NV097_SET_MATERIAL_EMISSION, 0x0);
-  p = pb_push1(p, NV097_SET_MATERIAL_EMISSION + 4, 0x0);
-  p = pb_push1(p, NV097_SET_MATERIAL_EMISSION + 8, 0x0);
+  // Set up a directional light.
+  TestHost::Light light;
+  light.SetInfinite(0.0f, 0.0f, -1.0f)
+      .SetHalfVector(0.0f, 0.0f, 0.0f)
+      .SetDiffuse({0xEE / 255.0f, 0xBB / 255.0f, 0xAA / 255.0f, 1.0f});
 
-  // Material's diffuse alpha float
-  uint32_t alpha_int = *(uint32_t*)&material_alpha;
-  p = pb_push1(p, NV097_SET_MATERIAL_ALPHA, alpha_int);
+  TestHost::Material material;
+  material.SetDiffuse({1.0f, 1.0f, 1.0f, material_alpha})
+      .SetAmbient({1.0f, 1.0f, 1.0f, 1.0f})
+      .SetSpecularParams(kSpecularParams);
 
-  pb_end(p);
+  host_.SetLighting({0.0f, 0.0145174954f, 0.0f, 1.0f}, material, &light, 1);
 
   host_.DrawArrays(host_.POSITION | host_.NORMAL | host_.DIFFUSE | host_.SPECULAR);
 
   std::string source = DiffuseSourceName(diffuse_source);
   pb_print("Src: %s\n", source.c_str());
   pb_print("Alpha: %g\n", material_alpha);
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   std::string name = MakeTestName(diffuse_source, material_alpha);
   host_.FinishDraw(allow_saving_, output_dir_, name);
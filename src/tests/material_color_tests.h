@@ -33,6 +33,7 @@ class MaterialColorTests : public TestSuite {
   MaterialColorTests(TestHost& host, std::string output_dir);
 
   void Initialize() override;
+  bool SupportsTiledRendering() const override { return true; }
 
  private:
   void CreateGeometry();
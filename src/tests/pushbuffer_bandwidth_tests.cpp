@@ -0,0 +1,123 @@
+#include "pushbuffer_bandwidth_tests.h"
+
+#include <pbkit/pbkit.h>
+
+#include <cstring>
+
+#include "command_recorder.h"
+#include "debug_output.h"
+#include "pbkit_ext.h"
+#include "test_host.h"
+
+// clang-format off
+static constexpr PushbufferBandwidthTests::Pattern kPatterns[] = {
+    PushbufferBandwidthTests::PATTERN_NOP_FLOOD,
+    PushbufferBandwidthTests::PATTERN_NON_INCREMENTING,
+    PushbufferBandwidthTests::PATTERN_TINY_PACKETS,
+    PushbufferBandwidthTests::PATTERN_TRANSFORM_CONSTANTS,
+};
+// clang-format on
+
+// Every pattern submits (at least) 4 MiB of commands.
+static constexpr uint32_t kTotalDwords = (4 * 1024 * 1024) / 4;
+
+static constexpr uint32_t kMaxDwords = CommandRecorder::kMaxDwordsPerSubmit;
+
+// NV20_TCL_PRIMITIVE_3D_VP_UPLOAD_CONST_X spans 8 constants.
+static constexpr uint32_t kConstantValuesPerPacket = 32;
+// The uploads target c[0], which is reloaded by VertexShaderProgram whenever a program is activated.
+static constexpr uint32_t kFirstConstant = 96;
+
+PushbufferBandwidthTests::PushbufferBandwidthTests(TestHost& host, std::string output_dir)
+    : TestSuite(host, std::move(output_dir), "Pushbuffer bandwidth") {
+  for (auto pattern : kPatterns) {
+    tests_[MakeTestName(pattern)] = [this, pattern]() { Test(pattern); };
+  }
+}
+
+void PushbufferBandwidthTests::Test(Pattern pattern) {
+  host_.SetVertexShaderProgram(nullptr);
+  host_.PrepareDraw(0xFF202020);
+
+  uint32_t num_dwords = 0;
+  uint32_t num_methods = 0;
+  auto timing = MeasureSubmission([pattern, &num_dwords, &num_methods]() {
+    while (num_dwords < kTotalDwords) {
+      auto start = pb_begin();
+      auto p = EmitBlock(pattern, start, num_methods);
+      num_dwords += p - start;
+      pb_end(p);
+    }
+  });
+
+  double megabytes = static_cast<double>(num_dwords) * 4.0 / (1024.0 * 1024.0);
+  double megabytes_per_second = timing.gpu_seconds > 0.0 ? megabytes / timing.gpu_seconds : 0.0;
+  double methods_per_second = timing.gpu_seconds > 0.0 ? num_methods / timing.gpu_seconds : 0.0;
+
+  std::string name = MakeTestName(pattern);
+  RecordBenchmarkResult(name, "bandwidth", megabytes_per_second, "MB/s");
+  RecordBenchmarkResult(name, "method_rate", methods_per_second, "methods/s");
+  RecordBenchmarkResult(name, "cpu_submit_time", timing.cpu_seconds * 1000000.0, "us");
+
+  pb_print("%s\n", name.c_str());
+  pb_print("%u dwords, %u methods\n", num_dwords, num_methods);
+  pb_print("%u KB/s\n", static_cast<uint32_t>(megabytes_per_second * 1024.0));
+  pb_print("%u methods/s\n", static_cast<uint32_t>(methods_per_second));
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(false, output_dir_, name);
+}
+
+uint32_t* PushbufferBandwidthTests::EmitBlock(Pattern pattern, uint32_t* p, uint32_t& num_methods) {
+  switch (pattern) {
+    case PATTERN_NOP_FLOOD:
+      for (uint32_t i = 0; i < kMaxDwords / 2; ++i) {
+        p = pb_push1(p, NV097_NO_OPERATION, 0);
+      }
+      num_methods += kMaxDwords / 2;
+      break;
+
+    case PATTERN_NON_INCREMENTING: {
+      constexpr uint32_t kCount = kMaxDwords - 1;
+      pb_push(p++, NV2A_SUPPRESS_COMMAND_INCREMENT(NV097_NO_OPERATION), kCount);
+      memset(p, 0, kCount * sizeof(*p));
+      p += kCount;
+      num_methods += kCount;
+    } break;
+
+    case PATTERN_TINY_PACKETS:
+      p = pb_push1(p, NV097_NO_OPERATION, 0);
+      ++num_methods;
+      break;
+
+    case PATTERN_TRANSFORM_CONSTANTS: {
+      constexpr uint32_t kPackets = (kMaxDwords - 2) / (kConstantValuesPerPacket + 1);
+      p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_VP_UPLOAD_CONST_ID, kFirstConstant);
+      ++num_methods;
+      for (uint32_t i = 0; i < kPackets; ++i) {
+        pb_push(p++, NV20_TCL_PRIMITIVE_3D_VP_UPLOAD_CONST_X, kConstantValuesPerPacket);
+        memset(p, 0, kConstantValuesPerPacket * sizeof(*p));
+        p += kConstantValuesPerPacket;
+      }
+      num_methods += kPackets * kConstantValuesPerPacket;
+    } break;
+  }
+
+  return p;
+}
+
+std::string PushbufferBandwidthTests::MakeTestName(Pattern pattern) {
+  switch (pattern) {
+    case PATTERN_NOP_FLOOD:
+      return "NopFlood";
+    case PATTERN_NON_INCREMENTING:
+      return "NonIncrementing";
+    case PATTERN_TINY_PACKETS:
+      return "TinyPackets";
+    case PATTERN_TRANSFORM_CONSTANTS:
+      return "TransformConstants";
+  }
+
+  ASSERT(!"Invalid pattern.");
+  return "";
+}
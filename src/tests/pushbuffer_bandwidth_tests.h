@@ -0,0 +1,37 @@
+#ifndef NXDK_PGRAPH_TESTS_PUSHBUFFER_BANDWIDTH_TESTS_H
+#define NXDK_PGRAPH_TESTS_PUSHBUFFER_BANDWIDTH_TESTS_H
+
+#include <string>
+
+#include "test_suite.h"
+
+class TestHost;
+
+// Measures how quickly pgraph consumes pushbuffer data for a number of command patterns. Results are recorded in MB/s
+// and methods/s.
+class PushbufferBandwidthTests : public TestSuite {
+ public:
+  enum Pattern {
+    // Packets of a single NV097_NO_OPERATION, as many as fit in one pb_begin/pb_end block.
+    PATTERN_NOP_FLOOD,
+    // A single non-incrementing NV097_NO_OPERATION packet per block.
+    PATTERN_NON_INCREMENTING,
+    // A single NV097_NO_OPERATION per pb_begin/pb_end block.
+    PATTERN_TINY_PACKETS,
+    // Full width transform constant uploads.
+    PATTERN_TRANSFORM_CONSTANTS,
+  };
+
+ public:
+  PushbufferBandwidthTests(TestHost& host, std::string output_dir);
+  bool IsBenchmark() const override { return true; }
+
+ private:
+  void Test(Pattern pattern);
+
+  // Writes a single block of the given pattern, adding the number of methods invoked to `num_methods`.
+  static uint32_t* EmitBlock(Pattern pattern, uint32_t* p, uint32_t& num_methods);
+  static std::string MakeTestName(Pattern pattern);
+};
+
+#endif  // NXDK_PGRAPH_TESTS_PUSHBUFFER_BANDWIDTH_TESTS_H
@@ -0,0 +1,155 @@
+#include "render_target_layout_benchmark_tests.h"
+
+#include <pbkit/pbkit.h>
+
+#include "pbkit_ext.h"
+#include "shaders/vertex_program_assembler.h"
+#include "shaders/vertex_shader_program.h"
+#include "texture_format.h"
+#include "vertex_buffer.h"
+
+// Swizzled targets must be square powers of two. Both sizes fit within the framebuffer's depth buffer.
+static constexpr uint32_t kSizes[] = {256, 512};
+static constexpr uint32_t kQuadsPerFrame = 32;
+
+RenderTargetLayoutBenchmarkTests::RenderTargetLayoutBenchmarkTests(TestHost& host, std::string output_dir)
+    : TestSuite(host, std::move(output_dir), "Render target layout") {
+  for (auto size : kSizes) {
+    for (auto swizzled : {false, true}) {
+      Config fill{OPERATION_FILL, swizzled, size};
+      tests_[MakeTestName(fill)] = [this, fill]() { TestFill(fill); };
+
+      Config feedback{OPERATION_FEEDBACK, swizzled, size};
+      tests_[MakeTestName(feedback)] = [this, feedback]() { TestFeedback(feedback); };
+    }
+  }
+}
+
+void RenderTargetLayoutBenchmarkTests::Initialize() {
+  TestSuite::Initialize();
+
+  // Positions are given in screen space.
+  using VPA = VertexProgramAssembler;
+  VPA vp;
+  vp.Mov(VPA::Output(VPA::OUT_POSITION), VPA::V(0))
+      .Mov(VPA::Output(VPA::OUT_DIFFUSE), VPA::V(3))
+      .Mov(VPA::Output(VPA::OUT_TEX0), VPA::V(9));
+  auto& program = vp.Assemble();
+
+  shader_ = std::make_shared<VertexShaderProgram>();
+  shader_->SetShaderOverride(program.data(), program.size() * sizeof(uint32_t));
+  host_.SetVertexShaderProgram(shader_);
+
+  auto p = pb_begin();
+  p = pb_push1(p, NV097_SET_DEPTH_TEST_ENABLE, false);
+  p = pb_push1(p, NV097_SET_DEPTH_MASK, false);
+  pb_end(p);
+}
+
+void RenderTargetLayoutBenchmarkTests::Deinitialize() {
+  host_.SetTextureStageEnabled(0, false);
+  host_.SetShaderStageProgram(TestHost::STAGE_NONE);
+  host_.SetFinalCombiner0Just(TestHost::SRC_DIFFUSE);
+  host_.SetVertexShaderProgram(nullptr);
+  shader_.reset();
+  host_.SetVertexBuffer(nullptr);
+  TestSuite::Deinitialize();
+}
+
+void RenderTargetLayoutBenchmarkTests::TestFill(const Config& config) {
+  auto target = host_.AcquireRenderTarget(config.size, config.size, 4, config.swizzled);
+  const auto size = static_cast<float>(config.size);
+  auto buffer = host_.AllocateVertexBuffer(6 * kQuadsPerFrame);
+  for (uint32_t i = 0; i < kQuadsPerFrame; ++i) {
+    buffer->DefineBiTri(i, 0.0f, 0.0f, size, size, 0.0f);
+  }
+
+  host_.SetTextureStageEnabled(0, false);
+  host_.SetShaderStageProgram(TestHost::STAGE_NONE);
+  host_.SetFinalCombiner0Just(TestHost::SRC_DIFFUSE);
+
+  host_.PrepareDraw(0xFF000000);
+  host_.BindRenderTarget(target);
+  host_.SetRenderTargetSurfaceFormat(target);
+  host_.SetWindowClip(config.size - 1, config.size - 1);
+
+  double seconds = MeasureGpuSeconds([this]() { host_.DrawArrays(TestHost::POSITION | TestHost::DIFFUSE); });
+
+  double num_pixels = static_cast<double>(config.size) * config.size * kQuadsPerFrame;
+  double pixels_per_second = seconds > 0.0 ? num_pixels / seconds : 0.0;
+  std::string name = MakeTestName(config);
+  RecordBenchmarkResult(name, "pixels_per_second", pixels_per_second, "pixels/s");
+
+  host_.UnbindRenderTarget();
+  host_.SetSurfaceFormat(TestHost::SCF_A8R8G8B8, static_cast<TestHost::SurfaceZetaFormat>(host_.GetDepthBufferFormat()),
+                         host_.GetFramebufferWidth(), host_.GetFramebufferHeight());
+  host_.SetWindowClip(host_.GetFramebufferWidth() - 1, host_.GetFramebufferHeight() - 1);
+
+  // Both layouts should produce identical images once unswizzled.
+  if (allow_saving_) {
+    host_.SaveRenderTarget(target, output_dir_, name);
+  }
+  host_.ReleaseRenderTarget(target);
+
+  pb_print("%s\n", name.c_str());
+  pb_print("%u Mpixels/s\n", static_cast<uint32_t>(pixels_per_second / 1000000.0));
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(false, output_dir_, name);
+}
+
+void RenderTargetLayoutBenchmarkTests::TestFeedback(const Config& config) {
+  auto target = host_.AcquireRenderTarget(config.size, config.size, 4, config.swizzled);
+  auto fb_width = static_cast<float>(host_.GetFramebufferWidth());
+  auto fb_height = static_cast<float>(host_.GetFramebufferHeight());
+  auto buffer = host_.AllocateVertexBuffer(6 * kQuadsPerFrame);
+  for (uint32_t i = 0; i < kQuadsPerFrame; ++i) {
+    buffer->DefineBiTri(i, 0.0f, 0.0f, fb_width, fb_height, 0.0f);
+  }
+  if (!config.swizzled) {
+    // Linear textures are addressed in texels.
+    buffer->Linearize(static_cast<float>(config.size), static_cast<float>(config.size));
+  }
+
+  host_.SetTextureFormat(GetTextureFormatInfo(config.swizzled ? NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8
+                                                              : NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_A8R8G8B8));
+  auto& stage = host_.GetTextureStage(0);
+  stage.SetTextureDimensions(config.size, config.size);
+  stage.SetImageDimensions(config.size, config.size);
+  host_.BindRenderTargetTexture(0, target);
+  host_.SetTextureStageEnabled(0, true);
+  host_.SetShaderStageProgram(TestHost::STAGE_2D_PROJECTIVE);
+  host_.SetFinalCombiner0Just(TestHost::SRC_TEX0);
+
+  // Depth is disabled and the quads cover the framebuffer, so nothing needs to be cleared.
+  host_.PrepareDraw(0xFF000000, 0xFFFFFFFF, 0x00, TestHost::CLEAR_NONE);
+
+  uint32_t vertex_fields = TestHost::POSITION | TestHost::DIFFUSE | TestHost::TEXCOORD0;
+  double seconds = MeasureGpuSeconds([this, vertex_fields]() { host_.DrawArrays(vertex_fields); });
+
+  double num_pixels = static_cast<double>(fb_width) * fb_height * kQuadsPerFrame;
+  double pixels_per_second = seconds > 0.0 ? num_pixels / seconds : 0.0;
+  std::string name = MakeTestName(config);
+  RecordBenchmarkResult(name, "pixels_per_second", pixels_per_second, "pixels/s");
+
+  host_.BindTextureMemory(0, TextureHeap::kInvalidHandle);
+  host_.SetTextureStageEnabled(0, false);
+  host_.SetShaderStageProgram(TestHost::STAGE_NONE);
+  host_.SetFinalCombiner0Just(TestHost::SRC_DIFFUSE);
+  host_.SetDefaultTextureParams(0);
+  host_.ReleaseRenderTarget(target);
+  host_.Clear(0xFF000000);
+
+  pb_print("%s\n", name.c_str());
+  pb_print("%u Mpixels/s\n", static_cast<uint32_t>(pixels_per_second / 1000000.0));
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(false, output_dir_, name);
+}
+
+std::string RenderTargetLayoutBenchmarkTests::MakeTestName(const Config& config) {
+  char buf[64] = {0};
+  snprintf(buf, 63, "%s_%s_%u", config.operation == OPERATION_FILL ? "Fill" : "Feedback",
+           config.swizzled ? "Swizzled" : "Pitch", config.size);
+  return buf;
+}
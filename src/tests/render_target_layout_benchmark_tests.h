@@ -0,0 +1,45 @@
+#ifndef NXDK_PGRAPH_TESTS_RENDER_TARGET_LAYOUT_BENCHMARK_TESTS_H
+#define NXDK_PGRAPH_TESTS_RENDER_TARGET_LAYOUT_BENCHMARK_TESTS_H
+
+#include <memory>
+#include <string>
+
+#include "test_host.h"
+#include "test_suite.h"
+
+class VertexShaderProgram;
+
+// Compares swizzled and pitch render targets, measuring both the rate at which each can be filled and the rate at
+// which each can be sampled as a texture by a subsequent pass.
+class RenderTargetLayoutBenchmarkTests : public TestSuite {
+ public:
+  enum Operation {
+    // Draws untextured quads covering the render target.
+    OPERATION_FILL,
+    // Draws full screen quads into the framebuffer, sampling the render target in place.
+    OPERATION_FEEDBACK,
+  };
+
+  struct Config {
+    Operation operation;
+    bool swizzled;
+    uint32_t size;
+  };
+
+ public:
+  RenderTargetLayoutBenchmarkTests(TestHost& host, std::string output_dir);
+  void Initialize() override;
+  void Deinitialize() override;
+  bool IsBenchmark() const override { return true; }
+
+ private:
+  void TestFill(const Config& config);
+  void TestFeedback(const Config& config);
+
+  static std::string MakeTestName(const Config& config);
+
+ private:
+  std::shared_ptr<VertexShaderProgram> shader_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_RENDER_TARGET_LAYOUT_BENCHMARK_TESTS_H
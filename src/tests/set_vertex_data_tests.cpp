@@ -217,7 +217,7 @@ void SetVertexDataTests::Test(SetFunction func, const Color& diffuse, bool satur
   pb_printat(7, 35, (char*)" 1 Normal");
   pb_printat(9, 35, (char*)"-1 Normal");
 
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, name);
 }
@@ -27,6 +27,7 @@ class SetVertexDataTests : public TestSuite {
   SetVertexDataTests(TestHost& host, std::string output_dir);
 
   void Initialize() override;
+  bool SupportsTiledRendering() const override { return true; }
 
  private:
   void CreateGeometry();
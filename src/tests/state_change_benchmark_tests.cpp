@@ -0,0 +1,282 @@
+#include "state_change_benchmark_tests.h"
+
+#include <SDL.h>
+#include <pbkit/pbkit.h>
+
+#include "debug_output.h"
+#include "pbkit_ext.h"
+#include "shaders/precalculated_vertex_shader.h"
+#include "shaders/vertex_program_assembler.h"
+#include "test_host.h"
+#include "texture_format.h"
+#include "texture_generator.h"
+#include "vertex_buffer.h"
+
+// clang-format off
+static constexpr StateChangeBenchmarkTests::StateGroup kStateGroups[] = {
+    StateChangeBenchmarkTests::GROUP_COMBINERS,
+    StateChangeBenchmarkTests::GROUP_TEXTURE_STAGE,
+    StateChangeBenchmarkTests::GROUP_VERTEX_SHADER,
+    StateChangeBenchmarkTests::GROUP_FIXED_FUNCTION_MATRICES,
+    StateChangeBenchmarkTests::GROUP_SURFACE_FORMAT,
+    StateChangeBenchmarkTests::GROUP_DEPTH_STENCIL,
+    StateChangeBenchmarkTests::GROUP_CONSTANT_SET,
+};
+// clang-format on
+
+static constexpr TestHost::CombinerState kModulatedCombinerState =
+    TestHost::CombinerState(TestSuite::kDefaultCombinerState)
+        .SetInputColorCombiner(0, TestHost::ColorInput(TestHost::SRC_DIFFUSE), TestHost::ColorInput(TestHost::SRC_C0));
+
+static constexpr const TestHost::CombinerState* kCombinerStates[] = {
+    &TestSuite::kDefaultCombinerState,
+    &kModulatedCombinerState,
+};
+
+static constexpr TestHost::SurfaceColorFormat kSurfaceFormats[] = {
+    TestHost::SCF_A8R8G8B8,
+    TestHost::SCF_R5G6B5,
+};
+
+static constexpr uint32_t kNumDraws = 2000;
+static constexpr uint32_t kVertexFields = TestHost::POSITION | TestHost::DIFFUSE;
+
+StateChangeBenchmarkTests::StateChangeBenchmarkTests(TestHost& host, std::string output_dir)
+    : TestSuite(host, std::move(output_dir), "State change") {
+  for (auto group : kStateGroups) {
+    tests_[MakeTestName(group, true)] = [this, group]() { Test(group, true); };
+    // Depth and stencil state is pushed directly and constants are tracked by the shader, so neither is affected by the
+    // shadow.
+    if (group != GROUP_DEPTH_STENCIL && group != GROUP_CONSTANT_SET) {
+      tests_[MakeTestName(group, false)] = [this, group]() { Test(group, false); };
+    }
+  }
+}
+
+void StateChangeBenchmarkTests::Initialize() {
+  TestSuite::Initialize();
+
+  shaders_[0] = std::make_shared<PrecalculatedVertexShader>();
+
+  // Equivalent to the precalculated shader, but with the diffuse color scaled by c[0].
+  using VPA = VertexProgramAssembler;
+  VPA vp;
+  vp.Mov(VPA::Output(VPA::OUT_POSITION), VPA::V(0)).Mul(VPA::Output(VPA::OUT_DIFFUSE), VPA::V(3), VPA::C(0));
+  auto& program = vp.Assemble();
+  shaders_[1] = std::make_shared<VertexShaderProgram>();
+  shaders_[1]->SetShaderOverride(program.data(), program.size() * sizeof(uint32_t));
+  shaders_[1]->SetUniformF(0, 1.0f, 1.0f, 1.0f, 1.0f);
+
+  // Scales the diffuse color by c[A0.x + 1], where A0 is loaded from the constant set selector in c[0].
+  VPA set_vp;
+  set_vp.Arl(VPA::C(0).Swizzle("x"))
+      .Mov(VPA::Output(VPA::OUT_POSITION), VPA::V(0))
+      .Mul(VPA::Output(VPA::OUT_DIFFUSE), VPA::V(3), VPA::C(1).Relative());
+  auto& set_program = set_vp.Assemble();
+  constant_set_shader_ = std::make_shared<VertexShaderProgram>();
+  constant_set_shader_->SetShaderOverride(set_program.data(), set_program.size() * sizeof(uint32_t));
+  constant_set_shader_->DefineConstantSets(0, 1, 1, 2);
+  const float full[] = {1.0f, 1.0f, 1.0f, 1.0f};
+  const float half[] = {0.5f, 0.5f, 0.5f, 1.0f};
+  constant_set_shader_->SetConstantSet(0, full);
+  constant_set_shader_->SetConstantSet(1, half);
+
+  matrix_unit(model_view_matrices_[0]);
+  VECTOR translation = {1.0f, 0.0f, 0.0f, 1.0f};
+  matrix_translate(model_view_matrices_[1], model_view_matrices_[0], translation);
+
+  host_.SetVertexShaderProgram(shaders_[0]);
+  CreateGeometry();
+}
+
+void StateChangeBenchmarkTests::Deinitialize() {
+  host_.SetVertexShaderProgram(nullptr);
+  shaders_[0].reset();
+  shaders_[1].reset();
+  constant_set_shader_.reset();
+  host_.SetVertexBuffer(nullptr);
+  ReleaseGeneratedTextures();
+  TestSuite::Deinitialize();
+}
+
+void StateChangeBenchmarkTests::CreateGeometry() {
+  auto buffer = host_.AllocateVertexBuffer(3);
+  float one[] = {32.0f, 32.0f, 0.0f};
+  float two[] = {36.0f, 32.0f, 0.0f};
+  float three[] = {32.0f, 36.0f, 0.0f};
+  Color color{0.25f, 0.75f, 0.5f, 1.0f};
+  buffer->DefineTriangle(0, one, two, three, color, color, color);
+}
+
+void StateChangeBenchmarkTests::Setup(StateGroup group) {
+  switch (group) {
+    case GROUP_TEXTURE_STAGE: {
+      host_.SetTextureFormat(GetTextureFormatInfo(NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8));
+      SDL_Surface* surface = GetGradientSurface(64, 64);
+      ASSERT(surface && "Failed to generate SDL surface");
+      int err = host_.SetTexture(surface);
+      ASSERT(!err && "Failed to set texture");
+      host_.SetTextureStageEnabled(0, true);
+      host_.SetShaderStageProgram(TestHost::STAGE_2D_PROJECTIVE);
+    } break;
+
+    case GROUP_FIXED_FUNCTION_MATRICES:
+      host_.SetVertexShaderProgram(nullptr);
+      host_.SetDefaultViewportAndFixedFunctionMatrices();
+      break;
+
+    case GROUP_CONSTANT_SET:
+      host_.SetVertexShaderProgram(constant_set_shader_);
+      break;
+
+    default:
+      break;
+  }
+}
+
+void StateChangeBenchmarkTests::Teardown(StateGroup group) {
+  Apply(group, 0);
+
+  switch (group) {
+    case GROUP_TEXTURE_STAGE:
+      host_.GetTextureStage(0).SetFilter();
+      host_.SetTextureStageEnabled(0, false);
+      host_.SetShaderStageProgram(TestHost::STAGE_NONE);
+      break;
+
+    case GROUP_FIXED_FUNCTION_MATRICES:
+      host_.SetDefaultViewportAndFixedFunctionMatrices();
+      host_.SetVertexShaderProgram(shaders_[0]);
+      break;
+
+    case GROUP_DEPTH_STENCIL: {
+      auto p = pb_begin();
+      p = pb_push1(p, NV097_SET_DEPTH_TEST_ENABLE, false);
+      p = pb_push1(p, NV097_SET_DEPTH_FUNC, NV097_SET_DEPTH_FUNC_V_LESS);
+      p = pb_push1(p, NV097_SET_STENCIL_TEST_ENABLE, false);
+      pb_end(p);
+      host_.InvalidateRegisterShadow();
+    } break;
+
+    case GROUP_CONSTANT_SET:
+      host_.SetVertexShaderProgram(shaders_[0]);
+      break;
+
+    default:
+      break;
+  }
+}
+
+void StateChangeBenchmarkTests::Apply(StateGroup group, uint32_t configuration) {
+  switch (group) {
+    case GROUP_COMBINERS:
+      host_.SetCombinerState(*kCombinerStates[configuration]);
+      break;
+
+    case GROUP_TEXTURE_STAGE:
+      host_.GetTextureStage(0).SetFilter(0, TextureStage::K_QUINCUNX,
+                                         configuration ? TextureStage::MIN_TENT_LOD0 : TextureStage::MIN_BOX_LOD0,
+                                         configuration ? TextureStage::MAG_TENT_LOD0 : TextureStage::MAG_BOX_LOD0);
+      host_.SetupTextureStages();
+      break;
+
+    case GROUP_VERTEX_SHADER:
+      host_.SetVertexShaderProgram(shaders_[configuration]);
+      host_.GetShaderProgram()->PrepareDraw();
+      break;
+
+    case GROUP_FIXED_FUNCTION_MATRICES:
+      host_.SetFixedFunctionModelViewMatrix(model_view_matrices_[configuration]);
+      break;
+
+    case GROUP_SURFACE_FORMAT:
+      host_.SetSurfaceFormat(kSurfaceFormats[configuration],
+                             static_cast<TestHost::SurfaceZetaFormat>(host_.GetDepthBufferFormat()),
+                             host_.GetFramebufferWidth(), host_.GetFramebufferHeight());
+      break;
+
+    case GROUP_DEPTH_STENCIL: {
+      auto p = pb_begin();
+      p = pb_push1(p, NV097_SET_DEPTH_TEST_ENABLE, configuration);
+      p = pb_push1(p, NV097_SET_DEPTH_FUNC,
+                   configuration ? NV097_SET_DEPTH_FUNC_V_LEQUAL : NV097_SET_DEPTH_FUNC_V_ALWAYS);
+      p = pb_push1(p, NV097_SET_STENCIL_TEST_ENABLE, configuration);
+      pb_end(p);
+    } break;
+
+    case GROUP_CONSTANT_SET:
+      constant_set_shader_->SelectConstantSet(configuration);
+      constant_set_shader_->PrepareDraw();
+      break;
+  }
+}
+
+void StateChangeBenchmarkTests::Test(StateGroup group, bool shadowed) {
+  Setup(group);
+  host_.SetForceStateWrites(!shadowed);
+  host_.PrepareDraw(0xFF202020);
+
+  // The cost of the draws themselves is measured first and subtracted.
+  auto baseline = MeasureSubmission([this]() {
+    for (uint32_t i = 0; i < kNumDraws; ++i) {
+      host_.DrawArrays(kVertexFields);
+    }
+  });
+
+  auto timing = MeasureSubmission([this, group]() {
+    for (uint32_t i = 0; i < kNumDraws; ++i) {
+      Apply(group, i & 1);
+      host_.DrawArrays(kVertexFields);
+    }
+  });
+
+  host_.SetForceStateWrites(false);
+  Teardown(group);
+
+  double cpu_us = (timing.cpu_seconds - baseline.cpu_seconds) * 1000000.0 / kNumDraws;
+  double gpu_us = (timing.gpu_seconds - baseline.gpu_seconds) * 1000000.0 / kNumDraws;
+
+  std::string name = MakeTestName(group, shadowed);
+  RecordBenchmarkResult(name, "cpu_cost_per_change", cpu_us, "us");
+  RecordBenchmarkResult(name, "gpu_cost_per_change", gpu_us, "us");
+
+  host_.Clear(0xFF202020);
+  pb_print("%s\n", name.c_str());
+  pb_print("%u changes\n", kNumDraws);
+  pb_print("CPU: %u ns/change\n", static_cast<uint32_t>(cpu_us > 0.0 ? cpu_us * 1000.0 : 0.0));
+  pb_print("GPU: %u ns/change\n", static_cast<uint32_t>(gpu_us > 0.0 ? gpu_us * 1000.0 : 0.0));
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(false, output_dir_, name);
+}
+
+std::string StateChangeBenchmarkTests::MakeTestName(StateGroup group, bool shadowed) {
+  const char* group_name = "";
+  switch (group) {
+    case GROUP_COMBINERS:
+      group_name = "Combiners";
+      break;
+    case GROUP_TEXTURE_STAGE:
+      group_name = "TextureStage";
+      break;
+    case GROUP_VERTEX_SHADER:
+      group_name = "VertexShader";
+      break;
+    case GROUP_FIXED_FUNCTION_MATRICES:
+      group_name = "FixedFunctionMatrices";
+      break;
+    case GROUP_SURFACE_FORMAT:
+      group_name = "SurfaceFormat";
+      break;
+    case GROUP_DEPTH_STENCIL:
+      group_name = "DepthStencil";
+      break;
+    case GROUP_CONSTANT_SET:
+      group_name = "ConstantSet";
+      break;
+  }
+
+  char buf[64] = {0};
+  snprintf(buf, 63, "%s%s", group_name, shadowed ? "" : "_NoShadow");
+  return buf;
+}
@@ -0,0 +1,52 @@
+#ifndef NXDK_PGRAPH_TESTS_STATE_CHANGE_BENCHMARK_TESTS_H
+#define NXDK_PGRAPH_TESTS_STATE_CHANGE_BENCHMARK_TESTS_H
+
+#include <memory>
+#include <string>
+
+#include "test_suite.h"
+
+class TestHost;
+class VertexShaderProgram;
+
+// Measures the cost of each kind of state change by alternating between two configurations of a single state group
+// before every one of a large number of small draws.
+class StateChangeBenchmarkTests : public TestSuite {
+ public:
+  enum StateGroup {
+    GROUP_COMBINERS,
+    GROUP_TEXTURE_STAGE,
+    GROUP_VERTEX_SHADER,
+    GROUP_FIXED_FUNCTION_MATRICES,
+    GROUP_SURFACE_FORMAT,
+    GROUP_DEPTH_STENCIL,
+    // Selects between two constant sets of a single shader by rewriting only the A0 selector.
+    GROUP_CONSTANT_SET,
+  };
+
+ public:
+  StateChangeBenchmarkTests(TestHost& host, std::string output_dir);
+  void Initialize() override;
+  void Deinitialize() override;
+  bool IsBenchmark() const override { return true; }
+
+ private:
+  void CreateGeometry();
+  // `shadowed` selects whether writes that would not change the latched state are dropped by the TestHost register
+  // shadow.
+  void Test(StateGroup group, bool shadowed);
+
+  void Setup(StateGroup group);
+  void Teardown(StateGroup group);
+  // Applies the first or second configuration of the given group.
+  void Apply(StateGroup group, uint32_t configuration);
+
+  static std::string MakeTestName(StateGroup group, bool shadowed);
+
+ private:
+  std::shared_ptr<VertexShaderProgram> shaders_[2];
+  std::shared_ptr<VertexShaderProgram> constant_set_shader_;
+  float model_view_matrices_[2][16]{};
+};
+
+#endif  // NXDK_PGRAPH_TESTS_STATE_CHANGE_BENCHMARK_TESTS_H
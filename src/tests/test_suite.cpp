@@ -1,8 +1,16 @@
 #include "test_suite.h"
 
+#include <cstdio>
+
+#include "command_recorder.h"
 #include "debug_output.h"
+#include "memory_tracker.h"
 #include "pbkit_ext.h"
+#include "progress_journal.h"
+#include "results_manifest.h"
 #include "shaders/pixel_shader_program.h"
+#include "string_format.h"
+#include "test_filter.h"
 #include "test_host.h"
 #include "texture_format.h"
 
@@ -13,46 +21,454 @@ TestSuite::TestSuite(TestHost& host, std::string output_dir, std::string suite_n
   std::replace(output_dir_.begin(), output_dir_.end(), ' ', '_');
 }
 
-std::vector<std::string> TestSuite::TestNames() const {
-  std::vector<std::string> ret;
-  ret.reserve(tests_.size());
+void TestSuite::ApplyFilter(const TestFilter& filter) {
+  RetainTests([this, &filter](const std::string& test_name) { return filter.Matches(suite_name_, test_name); });
+}
+
+void TestSuite::RetainTests(const std::function<bool(const std::string&)>& predicate) {
+  tests_.Retain([&predicate](const TestTable::Entry& entry) { return predicate(entry.name); });
+}
+
+bool TestSuite::ShouldRun(const std::string& test_name) const {
+  if (!journal_) {
+    return true;
+  }
 
-  for (auto& kv : tests_) {
-    ret.push_back(kv.first);
+  auto key = ProgressJournal::MakeKey(suite_name_, test_name);
+  if (journal_->IsSkipped(key)) {
+    return false;
   }
-  return std::move(ret);
+  // Suites that did not finish are rerun from the start so that their result files are complete, see ProgressJournal.
+  return rerun_completed_ || !journal_->IsSuiteFinished(suite_name_);
+}
+
+bool TestSuite::HasPendingTests() const {
+  for (uint32_t i = 0; i < tests_.size(); ++i) {
+    if (ShouldRun(tests_.At(i).name)) {
+      return true;
+    }
+  }
+  return false;
 }
 
 void TestSuite::Run(const std::string& test_name) {
-  auto it = tests_.find(test_name);
-  if (it == tests_.end()) {
+  auto index = tests_.FindByName(test_name);
+  if (index == TestTable::kInvalidIndex) {
     ASSERT(!"Invalid test name");
   }
+  DiscardRecords();
+  RunEntry(tests_.At(index));
+}
 
-  it->second();
+void TestSuite::RunById(TestTable::TestId id) {
+  auto index = tests_.FindById(id);
+  if (index == TestTable::kInvalidIndex) {
+    ASSERT(!"Invalid test ID");
+  }
+  DiscardRecords();
+  RunEntry(tests_.At(index));
+}
+
+void TestSuite::DiscardRecords() {
+  // Records are only written out by the RunAll variants, so individually run tests keep just their own.
+  timing_records_.clear();
+  benchmark_records_.clear();
+}
+
+void TestSuite::RunEntry(const TestTable::Entry& entry) {
+  host_.ResetTimings();
+  TestHost::TakeGpuTimeoutCount();
+  uint64_t start = TestHost::GetPerformanceCounter();
+
+  entry.test();
+
+  uint64_t total = TestHost::GetPerformanceCounter() - start;
+  timing_records_.push_back({entry.name, total, host_.GetTimings()});
+
+  auto& profiler = host_.GetGpuProfiler();
+  if (profiler.IsEnabled()) {
+    TestHost::WaitForGpuIdle();
+    profiler.Resolve();
+  }
+
+  // A wedged GPU fails the test rather than hanging the run.
+  const uint32_t gpu_timeouts = TestHost::TakeGpuTimeoutCount();
+  if (gpu_timeouts) {
+    PrintMsg("FAILED: %s::%s, %u GPU wait(s) timed out\n", suite_name_.c_str(), entry.name.c_str(), gpu_timeouts);
+  }
+  auto& record = timing_records_.back();
+  for (uint32_t i = 0; i < GpuProfiler::SCOPE_COUNT; ++i) {
+    record.gpu_scopes[i] = profiler.GetStats(static_cast<GpuProfiler::Scope>(i));
+  }
+
+  auto files = host_.TakeQueuedResultFiles();
+  if (!manifest_) {
+    return;
+  }
+
+  static const uint64_t frequency = TestHost::GetPerformanceFrequency();
+  ResultsManifest::Entry manifest_entry{suite_name_, entry.name, std::move(files), total * 1000000ULL / frequency};
+  for (uint32_t i = 0; i < TestHost::TIMING_NUM_PHASES; ++i) {
+    manifest_entry.phase_us[i] = record.timings.ticks[i] * 1000000ULL / frequency;
+  }
+  manifest_entry.memory = MemoryTracker::GetTotalUsage();
+  manifest_entry.gpu_timeouts = gpu_timeouts;
+  manifest_->Record(std::move(manifest_entry));
 }
 
 void TestSuite::RunAll() {
-  auto names = TestNames();
-  for (const auto& test_name : names) {
-    Run(test_name);
+  timing_records_.clear();
+  benchmark_records_.clear();
+  frame_time_records_.clear();
+
+  const uint32_t tiles_per_frame = SupportsTiledRendering() ? host_.GetMaxTilesPerFrame() : 0;
+  uint32_t tile = 0;
+  // Journal keys of the tests in the current tiled frame, which only complete once the frame has been captured.
+  std::vector<std::string> tiled_keys;
+  auto end_tiled_frame = [this, &tiled_keys]() {
+    host_.EndTiledFrame();
+    if (journal_) {
+      for (auto& key : tiled_keys) {
+        journal_->RecordCompleted(key);
+      }
+    }
+    tiled_keys.clear();
+  };
+
+  for (uint32_t i = 0; i < tests_.size(); ++i) {
+    const auto& entry = tests_.At(i);
+    const auto& test_name = entry.name;
+    if (!ShouldRun(test_name)) {
+      continue;
+    }
+
+    if (tiles_per_frame > 1) {
+      if (!tile) {
+        host_.BeginTiledFrame(tiles_per_frame);
+      }
+      host_.SetTile(tile);
+    }
+
+    auto key = journal_ ? ProgressJournal::MakeKey(suite_name_, test_name) : std::string();
+    if (journal_) {
+      journal_->RecordStarted(key);
+    }
+    RunEntry(entry);
+
+    if (tiles_per_frame > 1) {
+      tiled_keys.push_back(std::move(key));
+      if (++tile == tiles_per_frame) {
+        end_tiled_frame();
+        tile = 0;
+      }
+    } else if (journal_) {
+      journal_->RecordCompleted(key);
+    }
   }
+  if (tile) {
+    end_tiled_frame();
+  }
+
+  WriteResults();
+  RecordSuiteFinished();
 }
 
-void TestSuite::SetDefaultTextureFormat() const {
-  const TextureFormatInfo& texture_format = GetTextureFormatInfo(NV097_SET_TEXTURE_FORMAT_COLOR_SZ_X8R8G8B8);
-  host_.SetTextureFormat(texture_format, 0);
-  host_.SetDefaultTextureParams(0);
-  host_.SetTextureFormat(texture_format, 1);
-  host_.SetDefaultTextureParams(1);
-  host_.SetTextureFormat(texture_format, 2);
-  host_.SetDefaultTextureParams(2);
-  host_.SetTextureFormat(texture_format, 3);
-  host_.SetDefaultTextureParams(3);
+void TestSuite::RecordSuiteFinished() {
+  if (!journal_) {
+    return;
+  }
+  // The suite only counts as finished once everything it saved is on disk.
+  host_.WaitForPendingSaves();
+  journal_->RecordSuiteFinished(suite_name_);
 }
 
-void TestSuite::Initialize() {
-  auto p = pb_begin();
+void TestSuite::RunAllSustained(const SustainedRunSettings& settings) {
+  // Bounds the memory used by each histogram regardless of the requested duration.
+  static constexpr uint32_t kMaxIterations = 10000;
+
+  timing_records_.clear();
+  benchmark_records_.clear();
+  frame_time_records_.clear();
+
+  const bool save_results = host_.GetSaveResults();
+  const uint64_t frequency = TestHost::GetPerformanceFrequency();
+  const uint64_t min_duration_ticks = frequency * settings.min_duration_ms / 1000;
+
+  for (uint32_t test_index = 0; test_index < tests_.size(); ++test_index) {
+    const auto& entry = tests_.At(test_index);
+    const auto& test_name = entry.name;
+    if (!ShouldRun(test_name)) {
+      continue;
+    }
+    if (journal_) {
+      journal_->RecordStarted(ProgressJournal::MakeKey(suite_name_, test_name));
+    }
+
+    const auto timing_begin = timing_records_.size();
+    const auto benchmark_begin = benchmark_records_.size();
+    auto discard_records = [this, timing_begin, benchmark_begin]() {
+      timing_records_.erase(timing_records_.begin() + timing_begin, timing_records_.end());
+      benchmark_records_.erase(benchmark_records_.begin() + benchmark_begin, benchmark_records_.end());
+    };
+
+    host_.SetSaveResults(false);
+    for (uint32_t i = 0; i < settings.warmup_iterations; ++i) {
+      RunEntry(entry);
+      discard_records();
+    }
+
+    FrameTimeHistogram histogram;
+    histogram.Reserve(settings.min_iterations);
+    uint64_t start = TestHost::GetPerformanceCounter();
+    for (uint32_t i = 0; i < kMaxIterations; ++i) {
+      discard_records();
+      host_.SetSaveResults(save_results && !i);
+      RunEntry(entry);
+      histogram.Add(static_cast<uint32_t>(timing_records_.back().total_ticks * 1000000ULL / frequency));
+
+      if (i + 1 >= settings.min_iterations && TestHost::GetPerformanceCounter() - start >= min_duration_ticks) {
+        break;
+      }
+    }
+
+    frame_time_records_.push_back({test_name, std::move(histogram)});
+    if (journal_) {
+      journal_->RecordCompleted(ProgressJournal::MakeKey(suite_name_, test_name));
+    }
+  }
+  host_.SetSaveResults(save_results);
+
+  WriteResults();
+  RecordSuiteFinished();
+}
+
+void TestSuite::RunAllSoak(const SoakRunSettings& settings) {
+  ASSERT((settings.max_passes || settings.max_duration_ms) && "Soak runs must be limited by passes or duration.");
+
+  frame_time_records_.clear();
+
+  std::vector<SoakRecord> records;
+  records.reserve(tests_.size());
+  for (uint32_t i = 0; i < tests_.size(); ++i) {
+    records.push_back({tests_.At(i).name, false, 0, 0, 0, 0});
+  }
+
+  const bool save_results = host_.GetSaveResults();
+  const uint64_t max_duration_ticks = TestHost::GetPerformanceFrequency() * settings.max_duration_ms / 1000;
+  host_.SetHashFrames(true);
+
+  const uint64_t start = TestHost::GetPerformanceCounter();
+  uint64_t elapsed = 0;
+  uint32_t pass = 0;
+  bool expired = false;
+  while (!expired && (!settings.max_passes || pass < settings.max_passes)) {
+    host_.SetSaveResults(save_results && !pass);
+    // Only the last pass contributes to the timing and benchmark files.
+    timing_records_.clear();
+    benchmark_records_.clear();
+    for (uint32_t i = 0; i < tests_.size(); ++i) {
+      RunEntry(tests_.At(i));
+
+      auto& record = records[i];
+      ++record.runs;
+      uint32_t hash;
+      if (host_.TakeFrameHash(hash)) {
+        if (!record.hashed) {
+          record.hashed = true;
+          record.reference_hash = hash;
+        } else if (hash != record.reference_hash) {
+          if (!record.mismatches) {
+            record.first_mismatch_pass = pass;
+            PrintMsg("Soak: %s::%s changed on pass %u (%08x != %08x)\n", suite_name_.c_str(),
+                     record.test_name.c_str(), pass, hash, record.reference_hash);
+          }
+          ++record.mismatches;
+        }
+      }
+    }
+    ++pass;
+
+    // Only whole passes are run so that every test has the same number of runs.
+    elapsed = TestHost::GetPerformanceCounter() - start;
+    expired = settings.max_duration_ms && elapsed >= max_duration_ticks;
+  }
+
+  host_.SetHashFrames(false);
+  host_.SetSaveResults(save_results);
+
+  WriteResults();
+  if (allow_saving_ && save_results) {
+    WriteSoakResults(records, pass, elapsed);
+  }
+}
+
+void TestSuite::WriteResults() const {
+  if (!allow_saving_ || !host_.GetSaveResults()) {
+    return;
+  }
+
+  WriteTimings();
+  WriteMemoryUsage();
+  if (!benchmark_records_.empty()) {
+    WriteBenchmarkResults();
+  }
+  if (!frame_time_records_.empty()) {
+    WriteFrameTimes();
+  }
+  host_.SaveResultMetadata(output_dir_);
+}
+
+void TestSuite::WriteTimings() const {
+  TestHost::EnsureFolderExists(output_dir_);
+  std::string path = output_dir_ + "\\" + kTimingFilename;
+
+  std::string contents;
+
+  auto to_us = [](uint64_t ticks) {
+    static const uint64_t frequency = TestHost::GetPerformanceFrequency();
+    return static_cast<unsigned long long>(ticks * 1000000ULL / frequency);
+  };
+
+  // GPU scope columns are only present when profiling, so existing consumers see an unchanged layout otherwise.
+  const bool gpu_profiling = host_.GetGpuProfiler().IsEnabled();
+
+  contents += "test,total_us,prepare_draw_us,build_pushbuffer_us,gpu_wait_us,vblank_wait_us,save_us";
+  if (gpu_profiling) {
+    for (uint32_t i = 0; i < GpuProfiler::SCOPE_COUNT; ++i) {
+      AppendFormatted(contents, ",gpu_%s_us", GpuProfiler::GetScopeName(static_cast<GpuProfiler::Scope>(i)));
+    }
+  }
+  contents += "\n";
+
+  for (auto& record : timing_records_) {
+    auto& ticks = record.timings.ticks;
+    AppendFormatted(contents, "%s,%llu,%llu,%llu,%llu,%llu,%llu", record.test_name.c_str(),
+                    to_us(record.total_ticks), to_us(ticks[TestHost::TIMING_PREPARE_DRAW]),
+                    to_us(ticks[TestHost::TIMING_BUILD_PUSHBUFFER]), to_us(ticks[TestHost::TIMING_GPU_WAIT]),
+                    to_us(ticks[TestHost::TIMING_VBLANK_WAIT]), to_us(ticks[TestHost::TIMING_SAVE]));
+    if (gpu_profiling) {
+      for (auto& scope : record.gpu_scopes) {
+        AppendFormatted(contents, ",%llu", static_cast<unsigned long long>(scope.elapsed_ns / 1000));
+      }
+    }
+    contents += "\n";
+  }
+
+  host_.GetIoWorker().PostWriteFile(path, std::move(contents));
+}
+
+void TestSuite::WriteMemoryUsage() const {
+  TestHost::EnsureFolderExists(output_dir_);
+  host_.GetIoWorker().PostWriteFile(output_dir_ + "\\" + kMemoryUsageFilename, MemoryTracker::FormatUsageCSV());
+}
+
+TestSuite::SubmissionTiming TestSuite::MeasureSubmission(const std::function<void()>& submit) {
+  TestHost::WaitForGpuIdle();
+  uint64_t start = TestHost::GetPerformanceCounter();
+  submit();
+  CommandRecorder::FlushActive();
+  uint64_t submitted = TestHost::GetPerformanceCounter();
+  TestHost::WaitForGpuIdle();
+  uint64_t completed = TestHost::GetPerformanceCounter();
+
+  auto frequency = static_cast<double>(TestHost::GetPerformanceFrequency());
+  return {static_cast<double>(submitted - start) / frequency, static_cast<double>(completed - start) / frequency};
+}
+
+void TestSuite::RecordBenchmarkResult(const std::string& test_name, const std::string& metric, double value,
+                                      const std::string& units) {
+  benchmark_records_.push_back({test_name, metric, value, units});
+}
+
+void TestSuite::WriteBenchmarkResults() const {
+  TestHost::EnsureFolderExists(output_dir_);
+  std::string path = output_dir_ + "\\" + kBenchmarkFilename;
+
+  std::string contents;
+
+  contents += "test,metric,value,units\n";
+  for (auto& record : benchmark_records_) {
+    AppendFormatted(contents, "%s,%s,%.3f,%s\n", record.test_name.c_str(), record.metric.c_str(), record.value,
+                    record.units.c_str());
+  }
+
+  host_.GetIoWorker().PostWriteFile(path, std::move(contents));
+}
+
+void TestSuite::WriteFrameTimes() const {
+  TestHost::EnsureFolderExists(output_dir_);
+  std::string path = output_dir_ + "\\" + kFrameTimeFilename;
+
+  std::string contents;
+
+  contents += "test,iterations,mean_us,p50_us,p95_us,p99_us,max_us\n";
+  for (auto& record : frame_time_records_) {
+    auto& histogram = record.histogram;
+    AppendFormatted(contents, "%s,%u,%u,%u,%u,%u,%u\n", record.test_name.c_str(), histogram.GetNumSamples(),
+                    histogram.GetMean(), histogram.GetPercentile(50), histogram.GetPercentile(95),
+                    histogram.GetPercentile(99), histogram.GetMax());
+  }
+  host_.GetIoWorker().PostWriteFile(path, std::move(contents));
+
+  path = output_dir_ + "\\" + kFrameTimeHistogramFilename;
+  contents.clear();
+
+  // Empty buckets are omitted.
+  contents += "test,bucket_min_us,count\n";
+  for (auto& record : frame_time_records_) {
+    for (uint32_t bucket = 0; bucket < FrameTimeHistogram::kNumBuckets; ++bucket) {
+      uint32_t count = record.histogram.GetBucketCount(bucket);
+      if (count) {
+        AppendFormatted(contents, "%s,%u,%u\n", record.test_name.c_str(), FrameTimeHistogram::GetBucketMin(bucket),
+                        count);
+      }
+    }
+  }
+  host_.GetIoWorker().PostWriteFile(path, std::move(contents));
+}
+
+void TestSuite::WriteSoakResults(const std::vector<SoakRecord>& records, uint32_t passes,
+                                 uint64_t elapsed_ticks) const {
+  TestHost::EnsureFolderExists(output_dir_);
+
+  std::string contents;
+  uint32_t total_runs = 0;
+  uint32_t unstable_tests = 0;
+  contents += "test,runs,reference_hash,mismatches,first_mismatch_pass\n";
+  for (auto& record : records) {
+    total_runs += record.runs;
+    if (record.mismatches) {
+      ++unstable_tests;
+    }
+    if (!record.hashed) {
+      AppendFormatted(contents, "%s,%u,,,\n", record.test_name.c_str(), record.runs);
+    } else if (!record.mismatches) {
+      AppendFormatted(contents, "%s,%u,%08x,0,\n", record.test_name.c_str(), record.runs, record.reference_hash);
+    } else {
+      AppendFormatted(contents, "%s,%u,%08x,%u,%u\n", record.test_name.c_str(), record.runs, record.reference_hash,
+                      record.mismatches, record.first_mismatch_pass);
+    }
+  }
+  host_.GetIoWorker().PostWriteFile(output_dir_ + "\\" + kSoakFilename, std::move(contents));
+
+  const double seconds =
+      static_cast<double>(elapsed_ticks) / static_cast<double>(TestHost::GetPerformanceFrequency());
+  const double tests_per_second = seconds > 0.0 ? static_cast<double>(total_runs) / seconds : 0.0;
+  PrintMsg("Soak: %s ran %u passes (%u tests) in %u ms, %u tests/s, %u unstable\n", suite_name_.c_str(), passes,
+           total_runs, static_cast<uint32_t>(seconds * 1000.0), static_cast<uint32_t>(tests_per_second),
+           unstable_tests);
+
+  contents.clear();
+  contents += "passes,runs,elapsed_ms,tests_per_second,unstable_tests\n";
+  AppendFormatted(contents, "%u,%u,%u,%.3f,%u\n", passes, total_runs, static_cast<uint32_t>(seconds * 1000.0),
+                  tests_per_second, unstable_tests);
+  host_.GetIoWorker().PostWriteFile(output_dir_ + "\\" + kSoakSummaryFilename, std::move(contents));
+}
+
+// Returns the pushbuffer commands that set up the default fixed function state applied by Initialize.
+static std::vector<uint32_t> RecordBaselineState() {
+  uint32_t commands[CommandRecorder::kMaxDwordsPerSubmit];
+  auto p = commands;
   p = pb_push1(p, NV097_SET_LIGHTING_ENABLE, false);
   p = pb_push1(p, NV097_SET_SPECULAR_ENABLE, false);
   p = pb_push1(p, NV097_SET_LIGHT_CONTROL, 0x20001);
@@ -76,78 +492,22 @@ void TestSuite::Initialize() {
   p = pb_push1(p, NV097_SET_POINT_SMOOTH_ENABLE, false);
   p = pb_push1(p, NV097_SET_POINT_SIZE, 8);
 
-  p = pb_push1(p, NV097_SET_COMBINER_CONTROL, 1);
-
-  pb_end(p);
-
-  host_.ClearInputColorCombiners();
-  host_.ClearInputAlphaCombiners();
-  host_.ClearOutputColorCombiners();
-  host_.ClearOutputAlphaCombiners();
-
-  host_.SetInputColorCombiner(0, TestHost::SRC_DIFFUSE, false, TestHost::MAP_UNSIGNED_IDENTITY, TestHost::SRC_ZERO,
-                              false, TestHost::MAP_UNSIGNED_INVERT);
-  host_.SetInputAlphaCombiner(0, TestHost::SRC_DIFFUSE, true, TestHost::MAP_UNSIGNED_IDENTITY, TestHost::SRC_ZERO,
-                              false, TestHost::MAP_UNSIGNED_INVERT);
-
-  host_.SetOutputColorCombiner(0, TestHost::DST_DISCARD, TestHost::DST_DISCARD, TestHost::DST_R0);
-  host_.SetOutputAlphaCombiner(0, TestHost::DST_DISCARD, TestHost::DST_DISCARD, TestHost::DST_R0);
-
-  host_.SetFinalCombiner0(TestHost::SRC_ZERO, false, false, TestHost::SRC_ZERO, false, false, TestHost::SRC_ZERO, false,
-                          false, TestHost::SRC_R0);
-  host_.SetFinalCombiner1(TestHost::SRC_ZERO, false, false, TestHost::SRC_ZERO, false, false, TestHost::SRC_R0, true,
-                          false, false, false, true);
-
-  while (pb_busy()) {
-    /* Wait for completion... */
-  }
-
-  p = pb_begin();
   p = pb_push1(p, NV097_SET_SHADER_STAGE_PROGRAM, 0x0);
 
-  for (auto i = 0; i < 4; ++i) {
-    auto& stage = host_.GetTextureStage(i);
-    stage.SetUWrap(TextureStage::WRAP_CLAMP_TO_EDGE, false);
-    stage.SetVWrap(TextureStage::WRAP_CLAMP_TO_EDGE, false);
-    stage.SetPWrap(TextureStage::WRAP_CLAMP_TO_EDGE, false);
-    stage.SetQWrap(false);
-
-    stage.SetEnabled(false);
-    stage.SetCubemapEnable(false);
-    stage.SetFilter();
-    stage.SetAlphaKillEnable(false);
-    stage.SetLODClamp(0, 4095);
-  }
-
   // TODO: Set up with TextureStage instances in host_.
   {
     uint32_t address = NV097_SET_TEXTURE_ADDRESS;
     uint32_t control = NV097_SET_TEXTURE_CONTROL0;
     uint32_t filter = NV097_SET_TEXTURE_FILTER;
-    p = pb_push1(p, address, 0x10101);
-    p = pb_push1(p, control, 0x3ffc0);
-    p = pb_push1(p, filter, 0x1012000);
-
-    address += 0x40;
-    control += 0x40;
-    filter += 0x40;
-    p = pb_push1(p, address, 0x10101);
-    p = pb_push1(p, control, 0x3ffc0);
-    p = pb_push1(p, filter, 0x1012000);
-
-    address += 0x40;
-    control += 0x40;
-    filter += 0x40;
-    p = pb_push1(p, address, 0x10101);
-    p = pb_push1(p, control, 0x3ffc0);
-    p = pb_push1(p, filter, 0x1012000);
-
-    address += 0x40;
-    control += 0x40;
-    filter += 0x40;
-    p = pb_push1(p, address, 0x10101);
-    p = pb_push1(p, control, 0x3ffc0);
-    p = pb_push1(p, filter, 0x1012000);
+    for (auto i = 0; i < 4; ++i) {
+      p = pb_push1(p, address, 0x10101);
+      p = pb_push1(p, control, 0x3ffc0);
+      p = pb_push1(p, filter, 0x1012000);
+
+      address += 0x40;
+      control += 0x40;
+      filter += 0x40;
+    }
   }
 
   p = pb_push1(p, NV097_SET_FOG_ENABLE, false);
@@ -164,7 +524,52 @@ void TestSuite::Initialize() {
   p = pb_push1(p, NV097_SET_STENCIL_MASK, true);
 
   p = pb_push1(p, NV097_SET_NORMALIZATION_ENABLE, false);
-  pb_end(p);
+
+  return {commands, p};
+}
+
+void TestSuite::SetDefaultTextureFormat() const {
+  const TextureFormatInfo& texture_format = GetTextureFormatInfo(NV097_SET_TEXTURE_FORMAT_COLOR_SZ_X8R8G8B8);
+  host_.SetTextureFormat(texture_format, 0);
+  host_.SetDefaultTextureParams(0);
+  host_.SetTextureFormat(texture_format, 1);
+  host_.SetDefaultTextureParams(1);
+  host_.SetTextureFormat(texture_format, 2);
+  host_.SetDefaultTextureParams(2);
+  host_.SetTextureFormat(texture_format, 3);
+  host_.SetDefaultTextureParams(3);
+}
+
+void TestSuite::Initialize() {
+  if (allow_saving_ && host_.GetSaveResults()) {
+    TestHost::EnsureFolderExists(output_dir_);
+  }
+  // Peak memory usage is reported per suite.
+  MemoryTracker::ResetPeaks();
+
+  // The fixed function state is only recorded once; later calls replay it, along with the register shadowed state
+  // below, in a single submission. Shadowed writes that would not change the latched state are dropped, so only the
+  // state modified since the previous Initialize is actually pushed.
+  static const std::vector<uint32_t> baseline_state = RecordBaselineState();
+
+  host_.BeginCommandRecording();
+  host_.PushStateCommands(baseline_state.data(), baseline_state.size());
+
+  host_.SetCombinerState(kDefaultCombinerState);
+
+  for (auto i = 0; i < 4; ++i) {
+    auto& stage = host_.GetTextureStage(i);
+    stage.SetUWrap(TextureStage::WRAP_CLAMP_TO_EDGE, false);
+    stage.SetVWrap(TextureStage::WRAP_CLAMP_TO_EDGE, false);
+    stage.SetPWrap(TextureStage::WRAP_CLAMP_TO_EDGE, false);
+    stage.SetQWrap(false);
+
+    stage.SetEnabled(false);
+    stage.SetCubemapEnable(false);
+    stage.SetFilter();
+    stage.SetAlphaKillEnable(false);
+    stage.SetLODClamp(0, 4095);
+  }
 
   host_.SetDefaultViewportAndFixedFunctionMatrices();
   host_.SetDepthBufferFormat(NV097_SET_SURFACE_FORMAT_ZETA_Z16);
@@ -172,11 +577,10 @@ void TestSuite::Initialize() {
 
   SetDefaultTextureFormat();
   host_.SetTextureStageEnabled(0, false);
+  host_.SetPixelShaderProgram(PixelShaderProgram::Untextured());
   host_.SetShaderStageProgram(TestHost::STAGE_NONE);
   host_.SetShaderStageInput(0, 0);
 
-  PixelShaderProgram::LoadUntexturedPixelShader();
-  PixelShaderProgram::DisablePixelShader();
-
   host_.ClearAllVertexAttributeStrideOverrides();
+  host_.EndCommandRecording();
 }
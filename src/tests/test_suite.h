@@ -1,13 +1,37 @@
 #ifndef NXDK_PGRAPH_TESTS_TEST_SUITE_H
 #define NXDK_PGRAPH_TESTS_TEST_SUITE_H
 
-#include <map>
+#include <functional>
 #include <string>
 #include <vector>
 
-class TestHost;
+#include "frame_time_histogram.h"
+#include "test_host.h"
+#include "test_table.h"
+
+class ProgressJournal;
+class ResultsManifest;
+class TestFilter;
 
 class TestSuite {
+ public:
+  // Controls how RunAllSustained repeats each test.
+  struct SustainedRunSettings {
+    // Unmeasured iterations run first to bring caches and the GPU to a steady state.
+    uint32_t warmup_iterations;
+    // Measurement continues until at least `min_iterations` have run and at least `min_duration_ms` has elapsed.
+    uint32_t min_iterations;
+    uint32_t min_duration_ms;
+  };
+
+  // Controls how RunAllSoak repeats the suite's tests.
+  struct SoakRunSettings {
+    // Passes over every test stop after `max_passes` passes or, once at least one pass has completed, after
+    // `max_duration_ms` has elapsed. 0 disables either limit, but not both.
+    uint32_t max_passes;
+    uint32_t max_duration_ms;
+  };
+
  public:
   TestSuite(TestHost &host, std::string output_dir, std::string suite_name);
 
@@ -16,16 +40,135 @@ class TestSuite {
   virtual void Initialize();
   virtual void Deinitialize() {}
 
-  std::vector<std::string> TestNames() const;
+  const TestTable &Tests() const { return tests_; }
+  // Removes every test that is not selected by `filter`.
+  void ApplyFilter(const TestFilter &filter);
+  // Removes every test for which `predicate(test_name)` returns false.
+  void RetainTests(const std::function<bool(const std::string &)> &predicate);
+  bool HasTests() const { return !tests_.empty(); }
   void Run(const std::string &test_name);
+  void RunById(TestTable::TestId id);
 
   void RunAll();
+  // As RunAll, but repeats each test as described by `settings` and writes the distribution of its run times to
+  // kFrameTimeFilename and kFrameTimeHistogramFilename. Only the first measured iteration saves results and only the
+  // last one contributes to the timing and benchmark files.
+  void RunAllSustained(const SustainedRunSettings &settings);
+  // Repeatedly runs every test without reinitializing the suite, as described by `settings`, hashing each rendered
+  // frame. The number of runs of each test whose frame differed from its first run is written to kSoakFilename and the
+  // sustained test throughput to kSoakSummaryFilename. Only the first pass saves results.
+  void RunAllSoak(const SoakRunSettings &settings);
+
+  // Causes RunAll and RunAllSustained to record each test in `journal` and to skip tests it lists as skipped or, unless
+  // `rerun_completed` is set, every test if the suite is listed as finished. Pass nullptr to run every test.
+  void SetProgressJournal(ProgressJournal *journal, bool rerun_completed = false) {
+    journal_ = journal;
+    rerun_completed_ = rerun_completed;
+  }
+  // Causes every test run to be recorded in `manifest`. Pass nullptr to stop recording.
+  void SetResultsManifest(ResultsManifest *manifest) { manifest_ = manifest; }
+  // Returns true if RunAll would run at least one test.
+  bool HasPendingTests() const;
+
+  // Indicates that the suite measures performance rather than rendering behavior.
+  virtual bool IsBenchmark() const { return false; }
+  // Indicates that every test renders a single framebuffer sized result that does not depend on the contents of the
+  // framebuffer or depth buffer left by earlier tests, allowing RunAll to batch tests into tiled frames (see
+  // TestHost::BeginTiledFrame).
+  virtual bool SupportsTiledRendering() const { return false; }
 
   void SetSavingAllowed(bool enable = true) { allow_saving_ = enable; }
 
+  // Name of the file within the suite's output directory that receives per-test timings from RunAll.
+  static constexpr const char *kTimingFilename = "timing.csv";
+  // Name of the file within the suite's output directory that receives the suite's memory usage from RunAll (see
+  // MemoryTracker::FormatUsageCSV).
+  static constexpr const char *kMemoryUsageFilename = "memory.csv";
+  // Name of the file within the suite's output directory that receives results recorded via RecordBenchmarkResult.
+  static constexpr const char *kBenchmarkFilename = "benchmark.csv";
+  // Names of the files within the suite's output directory that receive RunAllSustained run time percentiles and
+  // histogram buckets.
+  static constexpr const char *kFrameTimeFilename = "frame_times.csv";
+  static constexpr const char *kFrameTimeHistogramFilename = "frame_time_histogram.csv";
+  // Names of the files within the suite's output directory that receive RunAllSoak per-test hash stability and the
+  // overall throughput of the run.
+  static constexpr const char *kSoakFilename = "soak.csv";
+  static constexpr const char *kSoakSummaryFilename = "soak_summary.csv";
+
+  // Combiner state applied by Initialize, passing the diffuse color through combiner 0 (via R0) to the final combiner.
+  static constexpr TestHost::CombinerState kDefaultCombinerState =
+      TestHost::CombinerState()
+          .SetInputColorCombiner(0, TestHost::ColorInput(TestHost::SRC_DIFFUSE), TestHost::OneInput())
+          .SetInputAlphaCombiner(0, TestHost::AlphaInput(TestHost::SRC_DIFFUSE), TestHost::OneInput())
+          .SetOutputColorCombiner(0, TestHost::DST_DISCARD, TestHost::DST_DISCARD, TestHost::DST_R0)
+          .SetOutputAlphaCombiner(0, TestHost::DST_DISCARD, TestHost::DST_DISCARD, TestHost::DST_R0)
+          .SetFinalCombiner0Just(TestHost::SRC_R0)
+          .SetFinalCombiner1(TestHost::SRC_ZERO, false, false, TestHost::SRC_ZERO, false, false, TestHost::SRC_R0, true,
+                             false, false, false, true);
+
  protected:
   void SetDefaultTextureFormat() const;
 
+  struct SubmissionTiming {
+    // Time taken for `submit` to return.
+    double cpu_seconds;
+    // Time taken for the GPU to complete every command issued by `submit`, measured from the same starting point.
+    double gpu_seconds;
+  };
+
+  // Waits for the GPU to go idle and then times the given submission.
+  static SubmissionTiming MeasureSubmission(const std::function<void()> &submit);
+  static double MeasureGpuSeconds(const std::function<void()> &submit) { return MeasureSubmission(submit).gpu_seconds; }
+
+  // Records a measurement made by `test_name`, written to kBenchmarkFilename when RunAll completes.
+  void RecordBenchmarkResult(const std::string &test_name, const std::string &metric, double value,
+                             const std::string &units);
+
+ private:
+  struct TimingRecord {
+    std::string test_name;
+    uint64_t total_ticks;
+    TestHost::TestTimings timings;
+    GpuProfiler::ScopeStats gpu_scopes[GpuProfiler::SCOPE_COUNT];
+  };
+
+  struct BenchmarkRecord {
+    std::string test_name;
+    std::string metric;
+    double value;
+    std::string units;
+  };
+
+  struct FrameTimeRecord {
+    std::string test_name;
+    FrameTimeHistogram histogram;
+  };
+
+  struct SoakRecord {
+    std::string test_name;
+    // Hash of the frame rendered by the first run, if any.
+    bool hashed;
+    uint32_t reference_hash;
+    uint32_t runs;
+    // Number of runs whose frame hash differed from reference_hash, and the (0-based) pass of the first.
+    uint32_t mismatches;
+    uint32_t first_mismatch_pass;
+  };
+
+  // Clears the timing and benchmark records left by previous runs.
+  void DiscardRecords();
+  void RunEntry(const TestTable::Entry &entry);
+  bool ShouldRun(const std::string &test_name) const;
+  // Journals the suite as finished once its results have been written, see ProgressJournal.
+  void RecordSuiteFinished();
+
+  void WriteResults() const;
+  void WriteTimings() const;
+  void WriteMemoryUsage() const;
+  void WriteBenchmarkResults() const;
+  void WriteFrameTimes() const;
+  void WriteSoakResults(const std::vector<SoakRecord> &records, uint32_t passes, uint64_t elapsed_ticks) const;
+
  protected:
   TestHost &host_;
   std::string output_dir_;
@@ -34,8 +177,20 @@ class TestSuite {
   // Flag to forcibly disallow saving of output (e.g., when in multiframe test mode for debugging).
   bool allow_saving_{true};
 
-  // Map of `test_name` to `void test()`
-  std::map<std::string, std::function<void()>> tests_{};
+  // Table of `test_name` to `void test()`
+  TestTable tests_{};
+
+ private:
+  // Timings for each test run since the last RunAll.
+  std::vector<TimingRecord> timing_records_;
+  // Benchmark results recorded since the last RunAll.
+  std::vector<BenchmarkRecord> benchmark_records_;
+  // Run time distributions collected by the last RunAllSustained.
+  std::vector<FrameTimeRecord> frame_time_records_;
+
+  ProgressJournal *journal_{nullptr};
+  bool rerun_completed_{false};
+  ResultsManifest *manifest_{nullptr};
 };
 
 #endif  // NXDK_PGRAPH_TESTS_TEST_SUITE_H
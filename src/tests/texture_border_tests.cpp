@@ -9,12 +9,10 @@
 #include "debug_output.h"
 #include "test_host.h"
 #include "texture_format.h"
+#include "texture_generator.h"
 #include "vertex_buffer.h"
 
 static int Generate2DSurface(SDL_Surface **gradient_surface, int width, int height);
-static int GeneratePalettized2DSurface(uint8_t **gradient_surface, int width, int height,
-                                       TestHost::PaletteSize palette_size);
-static uint32_t *GeneratePalette(TestHost::PaletteSize size);
 
 static constexpr uint32_t kTextureWidth = 32;
 static constexpr uint32_t kTextureHeight = 32;
@@ -51,6 +49,11 @@ void TextureBorderTests::Initialize() {
   host_.SetFinalCombiner1(TestHost::SRC_ZERO, false, false, TestHost::SRC_ZERO, false, false, TestHost::SRC_R0, true);
 }
 
+void TextureBorderTests::Deinitialize() {
+  ReleaseGeneratedTextures();
+  TestSuite::Deinitialize();
+}
+
 void TextureBorderTests::CreateGeometry() {
   static constexpr float kLeft = -2.75f;
   static constexpr float kRight = 2.75f;
@@ -193,7 +196,7 @@ void TextureBorderTests::Test2D() {
   pb_printat(8, 12, (char *)"Border-C");
   pb_printat(8, 26, (char *)"Border-T");
   pb_printat(8, 39, (char *)"Clamp_OGl");
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, kTest2D);
 }
@@ -203,18 +206,12 @@ void TextureBorderTests::Test2DPalettized() {
   auto &texture_format = GetTextureFormatInfo(NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8);
   host_.SetTextureFormat(texture_format);
 
-  uint8_t *gradient_surface = nullptr;
-  int err = GeneratePalettized2DSurface(&gradient_surface, kTextureWidth, kTextureHeight, TestHost::PALETTE_256);
-  ASSERT(!err && "Failed to generate palettized surface");
-
-  err = host_.SetRawTexture(gradient_surface, host_.GetMaxTextureWidth(), host_.GetMaxTextureHeight(), 1,
-                            host_.GetMaxTextureWidth(), 1, texture_format.xbox_swizzled);
-  delete[] gradient_surface;
+  const uint8_t *gradient_surface = GetPalettizedGradient(kTextureWidth, kTextureHeight, TestHost::PALETTE_256);
+  int err = host_.SetRawTexture(gradient_surface, host_.GetMaxTextureWidth(), host_.GetMaxTextureHeight(), 1,
+                                host_.GetMaxTextureWidth(), 1, texture_format.xbox_swizzled);
   ASSERT(!err && "Failed to set texture");
 
-  auto palette = GeneratePalette(TestHost::PALETTE_256);
-  err = host_.SetPalette(palette, TestHost::PALETTE_256);
-  delete[] palette;
+  err = host_.SetPalette(GetGradientPalette(TestHost::PALETTE_256), TestHost::PALETTE_256);
   ASSERT(!err && "Failed to set palette");
 
   host_.PrepareDraw(0xFE202020);
@@ -267,50 +264,3 @@ static int Generate2DSurface(SDL_Surface **gradient_surface, int width, int heig
 
   return 0;
 }
-
-static int GeneratePalettized2DSurface(uint8_t **gradient_surface, int width, int height,
-                                       TestHost::PaletteSize palette_size) {
-#if 0
-  *gradient_surface = new uint8_t[width * height];
-  if (!(*gradient_surface)) {
-    return 1;
-  }
-
-  auto pixel = *gradient_surface;
-
-  uint32_t total_size = width * height;
-  uint32_t half_size = total_size >> 1;
-
-  for (uint32_t i = 0; i < half_size; ++i, ++pixel) {
-    *pixel = i & (palette_size - 1);
-  }
-
-  for (uint32_t i = half_size; i < total_size; i += 4) {
-    uint8_t value = i & (palette_size - 1);
-    *pixel++ = value;
-    *pixel++ = value;
-    *pixel++ = value;
-    *pixel++ = value;
-  }
-
-#endif
-  return 0;
-}
-
-static uint32_t *GeneratePalette(TestHost::PaletteSize size) {
-  auto ret = new uint32_t[size];
-
-  uint32_t block_size = size / 4;
-  auto component_inc = (uint32_t)ceilf(255.0f / (float)block_size);
-  uint32_t i = 0;
-  uint32_t component = 0;
-  for (; i < block_size; ++i, component += component_inc) {
-    uint32_t color_value = 0xFF - component;
-    ret[i + block_size * 0] = 0xFF000000 + color_value;
-    ret[i + block_size * 1] = 0xFF000000 + (color_value << 8);
-    ret[i + block_size * 2] = 0xFF000000 + (color_value << 16);
-    ret[i + block_size * 3] = 0xFF000000 + color_value + (color_value << 8) + (color_value << 16);
-  }
-
-  return ret;
-}
@@ -13,6 +13,7 @@ class TextureBorderTests : public TestSuite {
   TextureBorderTests(TestHost &host, std::string output_dir);
 
   void Initialize() override;
+  void Deinitialize() override;
 
  private:
   void CreateGeometry();
@@ -11,13 +11,9 @@
 #include "shaders/pixel_shader_program.h"
 #include "test_host.h"
 #include "texture_format.h"
+#include "texture_generator.h"
 #include "vertex_buffer.h"
 
-static int GenerateGradientSurface(SDL_Surface **gradient_surface, int width, int height);
-static int GeneratePalettizedGradientSurface(uint8_t **gradient_surface, int width, int height,
-                                             TestHost::PaletteSize size);
-static uint32_t *GeneratePalette(TestHost::PaletteSize size);
-
 static constexpr TestHost::PaletteSize kPaletteSizes[] = {
     TestHost::PALETTE_256,
     TestHost::PALETTE_128,
@@ -33,9 +29,16 @@ TextureFormatTests::TextureFormatTests(TestHost &host, std::string output_dir)
 
     if (format.xbox_format != NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8) {
       tests_[name] = [this, format]() { Test(format); };
+
+      if (format.xbox_swizzled) {
+        tests_[MakeMipMapTestName(format, false)] = [this, format]() { TestMipMap(format, false); };
+      }
     }
   }
 
+  auto &gamma_format = GetTextureFormatInfo(NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8);
+  tests_[MakeMipMapTestName(gamma_format, true)] = [this, gamma_format]() { TestMipMap(gamma_format, true); };
+
   for (auto size : kPaletteSizes) {
     std::string name = MakePalettizedTestName(size);
     tests_[name] = [this, size]() { TestPalettized(size); };
@@ -51,27 +54,41 @@ void TextureFormatTests::Initialize() {
   host_.SetVertexShaderProgram(shader);
   host_.SetTextureStageEnabled(0, true);
   host_.SetShaderStageProgram(TestHost::STAGE_2D_PROJECTIVE);
+  host_.SetPixelShaderProgram(PixelShaderProgram::Textured());
+}
 
-  PixelShaderProgram::LoadTexturedPixelShader();
+void TextureFormatTests::Deinitialize() {
+  // Later suites write texture memory directly from the CPU, so the queued copies must land first.
+  host_.WaitForTextureUploads();
+  ReleaseGeneratedTextures();
+  TestSuite::Deinitialize();
 }
 
 void TextureFormatTests::CreateGeometry() {
-  std::shared_ptr<VertexBuffer> buffer = host_.AllocateVertexBuffer(6);
-  buffer->DefineBiTri(0, -0.75, 0.75, 0.75, -0.75, 0.1f);
-  buffer->Linearize(static_cast<float>(host_.GetMaxTextureWidth()), static_cast<float>(host_.GetMaxTextureHeight()));
+  // Quads at 1/2, 1/4, and 1/8 of the full size quad, used to exercise minification.
+  mipmap_vertex_buffer_ = host_.AllocateVertexBuffer(18);
+  mipmap_vertex_buffer_->DefineBiTri(0, -0.75f, 0.75f, 0.0f, 0.0f, 0.1f);
+  mipmap_vertex_buffer_->DefineBiTri(1, 0.1f, 0.75f, 0.475f, 0.375f, 0.1f);
+  mipmap_vertex_buffer_->DefineBiTri(2, 0.575f, 0.75f, 0.7625f, 0.5625f, 0.1f);
+
+  vertex_buffer_ = host_.AllocateVertexBuffer(6);
+  vertex_buffer_->DefineBiTri(0, -0.75, 0.75, 0.75, -0.75, 0.1f);
+  vertex_buffer_->Linearize(static_cast<float>(host_.GetMaxTextureWidth()),
+                            static_cast<float>(host_.GetMaxTextureHeight()));
 }
 
 void TextureFormatTests::Test(const TextureFormatInfo &texture_format) {
   host_.SetTextureFormat(texture_format);
   std::string test_name = MakeTestName(texture_format);
 
-  SDL_Surface *gradient_surface;
-  int update_texture_result =
-      GenerateGradientSurface(&gradient_surface, (int)host_.GetMaxTextureWidth(), (int)host_.GetMaxTextureHeight());
-  ASSERT(!update_texture_result && "Failed to generate SDL surface");
+  // Formats that SDL can produce are generated directly, skipping conversion during the upload.
+  uint32_t source_format = texture_format.require_conversion ? SDL_PIXELFORMAT_RGBA8888 : texture_format.sdl_format;
+  SDL_Surface *gradient_surface =
+      GetGradientSurface((int)host_.GetMaxTextureWidth(), (int)host_.GetMaxTextureHeight(), source_format);
+  ASSERT(gradient_surface && "Failed to generate SDL surface");
 
-  update_texture_result = host_.SetTexture(gradient_surface);
-  SDL_FreeSurface(gradient_surface);
+  // Each format is uploaded through staging memory so that conversion overlaps the previous test's draw.
+  int update_texture_result = host_.SetTextureAsync(gradient_surface);
   ASSERT(!update_texture_result && "Failed to set texture");
 
   host_.PrepareDraw(0xFE202020);
@@ -84,7 +101,7 @@ void TextureFormatTests::Test(const TextureFormatInfo &texture_format) {
   pb_print("W: %d\n", host_.GetMaxTextureWidth());
   pb_print("H: %d\n", host_.GetMaxTextureHeight());
   pb_print("P: %d\n", texture_format.xbox_bpp * host_.GetMaxTextureWidth());
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, test_name);
 }
@@ -94,19 +111,13 @@ void TextureFormatTests::TestPalettized(TestHost::PaletteSize size) {
   host_.SetTextureFormat(texture_format);
   std::string test_name = MakePalettizedTestName(size);
 
-  uint8_t *gradient_surface = nullptr;
-  int err = GeneratePalettizedGradientSurface(&gradient_surface, (int)host_.GetMaxTextureWidth(),
-                                              (int)host_.GetMaxTextureHeight(), size);
-  ASSERT(!err && "Failed to generate palettized surface");
-
-  err = host_.SetRawTexture(gradient_surface, host_.GetMaxTextureWidth(), host_.GetMaxTextureHeight(), 1,
-                            host_.GetMaxTextureWidth(), 1, texture_format.xbox_swizzled);
-  delete[] gradient_surface;
+  const uint8_t *gradient_surface =
+      GetPalettizedGradient((int)host_.GetMaxTextureWidth(), (int)host_.GetMaxTextureHeight(), size);
+  int err = host_.SetRawTextureAsync(gradient_surface, host_.GetMaxTextureWidth(), host_.GetMaxTextureHeight(), 1,
+                                     host_.GetMaxTextureWidth(), 1, texture_format.xbox_swizzled);
   ASSERT(!err && "Failed to set texture");
 
-  auto palette = GeneratePalette(size);
-  err = host_.SetPalette(palette, size);
-  delete[] palette;
+  err = host_.SetPalette(GetGradientPalette(size), size);
   ASSERT(!err && "Failed to set palette");
 
   host_.PrepareDraw(0xFE202020);
@@ -120,11 +131,40 @@ void TextureFormatTests::TestPalettized(TestHost::PaletteSize size) {
   pb_print("W: %d\n", host_.GetMaxTextureWidth());
   pb_print("H: %d\n", host_.GetMaxTextureHeight());
   pb_print("P: %d\n", texture_format.xbox_bpp * host_.GetMaxTextureWidth());
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, test_name);
 }
 
+void TextureFormatTests::TestMipMap(const TextureFormatInfo &texture_format, bool gamma_correct) {
+  host_.SetTextureFormat(texture_format);
+  std::string test_name = MakeMipMapTestName(texture_format, gamma_correct);
+
+  SDL_Surface *gradient_surface = GetGradientSurface((int)host_.GetMaxTextureWidth(), (int)host_.GetMaxTextureHeight());
+  ASSERT(gradient_surface && "Failed to generate SDL surface");
+
+  int update_texture_result = host_.SetMipMappedTexture(gradient_surface, 0, gamma_correct);
+  ASSERT(!update_texture_result && "Failed to set texture");
+
+  auto &stage = host_.GetTextureStage(0);
+  stage.SetFilter(0, TextureStage::K_QUINCUNX, TextureStage::MIN_TENT_TENT_LOD, TextureStage::MAG_TENT_LOD0);
+
+  host_.SetVertexBuffer(mipmap_vertex_buffer_);
+  host_.PrepareDraw(0xFE202020);
+  host_.DrawArrays();
+
+  pb_print("N: %s\n", texture_format.name);
+  pb_print("F: 0x%x\n", texture_format.xbox_format);
+  pb_print("L: %d\n", stage.GetMipMapLevels());
+  pb_print("G: %d\n", gamma_correct);
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(allow_saving_, output_dir_, test_name);
+
+  stage.SetFilter();
+  host_.SetVertexBuffer(vertex_buffer_);
+}
+
 std::string TextureFormatTests::MakeTestName(const TextureFormatInfo &texture_format) {
   std::string test_name = "TexFmt_";
   test_name += texture_format.name;
@@ -134,6 +174,15 @@ std::string TextureFormatTests::MakeTestName(const TextureFormatInfo &texture_fo
   return std::move(test_name);
 }
 
+std::string TextureFormatTests::MakeMipMapTestName(const TextureFormatInfo &texture_format, bool gamma_correct) {
+  std::string test_name = "TexFmt_Mip_";
+  test_name += texture_format.name;
+  if (gamma_correct) {
+    test_name += "_Gamma";
+  }
+  return std::move(test_name);
+}
+
 std::string TextureFormatTests::MakePalettizedTestName(TestHost::PaletteSize size) {
   std::string test_name = "TexFmt_";
   auto &fmt = GetTextureFormatInfo(NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8);
@@ -145,74 +194,3 @@ std::string TextureFormatTests::MakePalettizedTestName(TestHost::PaletteSize siz
 
   return std::move(test_name);
 }
-
-static int GenerateGradientSurface(SDL_Surface **gradient_surface, int width, int height) {
-  *gradient_surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA8888);
-  if (!(*gradient_surface)) {
-    return 1;
-  }
-
-  if (SDL_LockSurface(*gradient_surface)) {
-    SDL_FreeSurface(*gradient_surface);
-    *gradient_surface = nullptr;
-    return 2;
-  }
-
-  auto pixels = static_cast<uint32_t *>((*gradient_surface)->pixels);
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x, ++pixels) {
-      int x_normal = static_cast<int>(static_cast<float>(x) * 255.0f / static_cast<float>(width));
-      int y_normal = static_cast<int>(static_cast<float>(y) * 255.0f / static_cast<float>(height));
-      *pixels = SDL_MapRGBA((*gradient_surface)->format, y_normal, x_normal, 255 - y_normal, x_normal + y_normal);
-    }
-  }
-
-  SDL_UnlockSurface(*gradient_surface);
-
-  return 0;
-}
-
-static int GeneratePalettizedGradientSurface(uint8_t **gradient_surface, int width, int height,
-                                             TestHost::PaletteSize palette_size) {
-  *gradient_surface = new uint8_t[width * height];
-  if (!(*gradient_surface)) {
-    return 1;
-  }
-
-  auto pixel = *gradient_surface;
-
-  uint32_t total_size = width * height;
-  uint32_t half_size = total_size >> 1;
-
-  for (uint32_t i = 0; i < half_size; ++i, ++pixel) {
-    *pixel = i & (palette_size - 1);
-  }
-
-  for (uint32_t i = half_size; i < total_size; i += 4) {
-    uint8_t value = i & (palette_size - 1);
-    *pixel++ = value;
-    *pixel++ = value;
-    *pixel++ = value;
-    *pixel++ = value;
-  }
-
-  return 0;
-}
-
-static uint32_t *GeneratePalette(TestHost::PaletteSize size) {
-  auto ret = new uint32_t[size];
-
-  uint32_t block_size = size / 4;
-  auto component_inc = (uint32_t)ceilf(255.0f / (float)block_size);
-  uint32_t i = 0;
-  uint32_t component = 0;
-  for (; i < block_size; ++i, component += component_inc) {
-    uint32_t color_value = 0xFF - component;
-    ret[i + block_size * 0] = 0xFF000000 + color_value;
-    ret[i + block_size * 1] = 0xFF000000 + (color_value << 8);
-    ret[i + block_size * 2] = 0xFF000000 + (color_value << 16);
-    ret[i + block_size * 3] = 0xFF000000 + color_value + (color_value << 8) + (color_value << 16);
-  }
-
-  return ret;
-}
\ No newline at end of file
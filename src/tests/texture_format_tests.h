@@ -1,6 +1,7 @@
 #ifndef NXDK_PGRAPH_TESTS_TEXTURE_FORMAT_TESTS_H
 #define NXDK_PGRAPH_TESTS_TEXTURE_FORMAT_TESTS_H
 
+#include <memory>
 #include <string>
 
 #include "test_host.h"
@@ -13,15 +14,21 @@ class TextureFormatTests : public TestSuite {
   TextureFormatTests(TestHost &host, std::string output_dir);
 
   void Initialize() override;
+  void Deinitialize() override;
 
  private:
   void CreateGeometry();
 
   void Test(const TextureFormatInfo &texture_format);
   void TestPalettized(TestHost::PaletteSize size);
+  void TestMipMap(const TextureFormatInfo &texture_format, bool gamma_correct);
 
   static std::string MakeTestName(const TextureFormatInfo &texture_format);
   static std::string MakePalettizedTestName(TestHost::PaletteSize size);
+  static std::string MakeMipMapTestName(const TextureFormatInfo &texture_format, bool gamma_correct);
+
+  std::shared_ptr<VertexBuffer> vertex_buffer_;
+  std::shared_ptr<VertexBuffer> mipmap_vertex_buffer_;
 };
 
 #endif  // NXDK_PGRAPH_TESTS_TEXTURE_FORMAT_TESTS_H
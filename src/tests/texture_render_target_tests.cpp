@@ -12,23 +12,13 @@
 #include "shaders/precalculated_vertex_shader.h"
 #include "test_host.h"
 #include "texture_format.h"
+#include "texture_generator.h"
 #include "vertex_buffer.h"
 
-#define SET_MASK(mask, val) (((val) << (__builtin_ffs(mask) - 1)) & (mask))
-
-// From pbkit.c, DMA_COLOR is set to channel 9 by default
-// NV097_SET_CONTEXT_DMA_COLOR == NV20_TCL_PRIMITIVE_3D_SET_OBJECT3
-const uint32_t kDefaultDMAColorChannel = 9;
-
 static const uint32_t kTextureWidth = 256;
 static const uint32_t kTexturePitch = kTextureWidth * 4;
 static const uint32_t kTextureHeight = 256;
 
-static int GenerateGradientSurface(SDL_Surface **gradient_surface, int width, int height);
-static int GeneratePalettizedGradientSurface(uint8_t **gradient_surface, int width, int height,
-                                             TestHost::PaletteSize size);
-static uint32_t *GeneratePalette(TestHost::PaletteSize size);
-
 static constexpr TestHost::PaletteSize kPaletteSizes[] = {
     TestHost::PALETTE_256,
     TestHost::PALETTE_128,
@@ -57,16 +47,7 @@ void TextureRenderTargetTests::Initialize() {
   TestSuite::Initialize();
   CreateGeometry();
 
-  auto channel = kNextContextChannel;
-  const uint32_t texture_target_dma_channel = channel++;
-  pb_create_dma_ctx(texture_target_dma_channel, DMA_CLASS_3D, 0, MAXRAM, &texture_target_ctx_);
-  pb_bind_channel(&texture_target_ctx_);
-
-  const uint32_t texture_size = kTexturePitch * kTextureHeight;
-  render_target_ =
-      (uint8_t *)MmAllocateContiguousMemoryEx(texture_size, 0, MAXRAM, 0x1000, PAGE_WRITECOMBINE | PAGE_READWRITE);
-  ASSERT(render_target_ && "Failed to allocate target surface.");
-  pb_set_dma_address(&texture_target_ctx_, render_target_, texture_size - 1);
+  render_target_ = host_.AcquireRenderTarget(kTextureWidth, kTextureHeight);
 
   host_.SetCombinerControl(1, true, true);
   host_.SetFinalCombiner0Just(TestHost::SRC_TEX0);
@@ -77,9 +58,11 @@ void TextureRenderTargetTests::Initialize() {
 }
 
 void TextureRenderTargetTests::Deinitialize() {
+  ReleaseGeneratedTextures();
   TestSuite::Deinitialize();
   if (render_target_) {
-    MmFreeContiguousMemory(render_target_);
+    host_.ReleaseRenderTarget(render_target_);
+    render_target_ = nullptr;
   }
 }
 
@@ -97,38 +80,24 @@ void TextureRenderTargetTests::CreateGeometry() {
 }
 
 void TextureRenderTargetTests::Test(const TextureFormatInfo &texture_format) {
-  const uint32_t kFramebufferPitch = host_.GetFramebufferWidth() * 4;
-
   host_.SetTextureFormat(texture_format);
   std::string test_name = MakeTestName(texture_format);
 
   auto &texture_stage = host_.GetTextureStage(0);
   texture_stage.SetTextureDimensions(host_.GetMaxTextureWidth(), host_.GetMaxTextureHeight());
 
-  SDL_Surface *gradient_surface;
-  int update_texture_result =
-      GenerateGradientSurface(&gradient_surface, (int)host_.GetMaxTextureWidth(), (int)host_.GetMaxTextureHeight());
-  ASSERT(!update_texture_result && "Failed to generate SDL surface");
+  uint32_t source_format = texture_format.require_conversion ? SDL_PIXELFORMAT_RGBA8888 : texture_format.sdl_format;
+  SDL_Surface *gradient_surface =
+      GetGradientSurface((int)host_.GetMaxTextureWidth(), (int)host_.GetMaxTextureHeight(), source_format);
+  ASSERT(gradient_surface && "Failed to generate SDL surface");
 
-  update_texture_result = host_.SetTexture(gradient_surface);
-  SDL_FreeSurface(gradient_surface);
+  int update_texture_result = host_.SetTexture(gradient_surface);
   ASSERT(!update_texture_result && "Failed to set texture");
 
-  uint32_t *p;
-
   host_.PrepareDraw(0xFE202020);
 
   // Redirect the color output to the target texture.
-  p = pb_begin();
-  p = pb_push1(p, NV097_SET_SURFACE_PITCH,
-               SET_MASK(NV097_SET_SURFACE_PITCH_COLOR, kTexturePitch) |
-                   SET_MASK(NV097_SET_SURFACE_PITCH_ZETA, kFramebufferPitch));
-  p = pb_push1(p, NV097_SET_CONTEXT_DMA_COLOR, texture_target_ctx_.ChannelID);
-  p = pb_push1(p, NV097_SET_SURFACE_COLOR_OFFSET, 0);
-  // TODO: Investigate if this is actually necessary. Morrowind does this after changing offsets.
-  p = pb_push1(p, NV097_NO_OPERATION, 0);
-  p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
-  pb_end(p);
+  host_.BindRenderTarget(render_target_);
 
   auto shader = std::make_shared<PrecalculatedVertexShader>();
   host_.SetVertexShaderProgram(shader);
@@ -152,15 +121,9 @@ void TextureRenderTargetTests::Test(const TextureFormatInfo &texture_format) {
   host_.SetWindowClip(host_.GetFramebufferWidth() - 1, host_.GetFramebufferHeight() - 1);
   host_.SetTextureFormat(GetTextureFormatInfo(NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8));
 
-  p = pb_begin();
-  p = pb_push1(p, NV097_SET_SURFACE_PITCH,
-               SET_MASK(NV097_SET_SURFACE_PITCH_COLOR, kFramebufferPitch) |
-                   SET_MASK(NV097_SET_SURFACE_PITCH_ZETA, kFramebufferPitch));
-  p = pb_push1(p, NV097_SET_CONTEXT_DMA_COLOR, kDefaultDMAColorChannel);
-  p = pb_push1(p, NV097_SET_SURFACE_COLOR_OFFSET, 0);
-  pb_end(p);
+  host_.UnbindRenderTarget();
 
-  host_.SetRawTexture(render_target_, kTextureWidth, kTextureHeight, 1, kTexturePitch, 4, false);
+  host_.SetRawTexture(render_target_->memory, kTextureWidth, kTextureHeight, 1, kTexturePitch, 4, false);
 
   host_.SetVertexBuffer(framebuffer_vertex_buffer_);
   host_.PrepareDraw(0xFE202020);
@@ -173,7 +136,7 @@ void TextureRenderTargetTests::Test(const TextureFormatInfo &texture_format) {
   pb_print("W: %d\n", host_.GetMaxTextureWidth());
   pb_print("H: %d\n", host_.GetMaxTextureHeight());
   pb_print("P: %d\n", texture_format.xbox_bpp * host_.GetMaxTextureWidth());
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, test_name);
 
@@ -188,35 +151,19 @@ void TextureRenderTargetTests::TestPalettized(TestHost::PaletteSize size) {
   host_.SetTextureFormat(texture_format);
   std::string test_name = MakePalettizedTestName(size);
 
-  uint8_t *gradient_surface = nullptr;
-  int err = GeneratePalettizedGradientSurface(&gradient_surface, (int)host_.GetMaxTextureWidth(),
-                                              (int)host_.GetMaxTextureHeight(), size);
-  ASSERT(!err && "Failed to generate palettized surface");
-
-  err = host_.SetRawTexture(gradient_surface, host_.GetMaxTextureWidth(), host_.GetMaxTextureHeight(), 1,
-                            host_.GetMaxTextureWidth(), 1, texture_format.xbox_swizzled);
-  delete[] gradient_surface;
+  const uint8_t *gradient_surface =
+      GetPalettizedGradient((int)host_.GetMaxTextureWidth(), (int)host_.GetMaxTextureHeight(), size);
+  int err = host_.SetRawTexture(gradient_surface, host_.GetMaxTextureWidth(), host_.GetMaxTextureHeight(), 1,
+                                host_.GetMaxTextureWidth(), 1, texture_format.xbox_swizzled);
   ASSERT(!err && "Failed to set texture");
 
-  auto palette = GeneratePalette(size);
-  err = host_.SetPalette(palette, size);
-  delete[] palette;
+  err = host_.SetPalette(GetGradientPalette(size), size);
   ASSERT(!err && "Failed to set palette");
 
   host_.PrepareDraw(0xFE202020);
 
-  uint32_t *p;
   // Redirect the color output to the target texture.
-  p = pb_begin();
-  p = pb_push1(p, NV097_SET_SURFACE_PITCH,
-               SET_MASK(NV097_SET_SURFACE_PITCH_COLOR, kTexturePitch) |
-                   SET_MASK(NV097_SET_SURFACE_PITCH_ZETA, kFramebufferPitch));
-  p = pb_push1(p, NV097_SET_CONTEXT_DMA_COLOR, texture_target_ctx_.ChannelID);
-  p = pb_push1(p, NV097_SET_SURFACE_COLOR_OFFSET, 0);
-  // TODO: Investigate if this is actually necessary. Morrowind does this after changing offsets.
-  p = pb_push1(p, NV097_NO_OPERATION, 0);
-  p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
-  pb_end(p);
+  host_.BindRenderTarget(render_target_);
 
   auto shader = std::make_shared<PrecalculatedVertexShader>();
   host_.SetVertexShaderProgram(shader);
@@ -236,15 +183,9 @@ void TextureRenderTargetTests::TestPalettized(TestHost::PaletteSize size) {
 
   host_.SetTextureFormat(GetTextureFormatInfo(NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8));
 
-  p = pb_begin();
-  p = pb_push1(p, NV097_SET_SURFACE_PITCH,
-               SET_MASK(NV097_SET_SURFACE_PITCH_COLOR, kFramebufferPitch) |
-                   SET_MASK(NV097_SET_SURFACE_PITCH_ZETA, kFramebufferPitch));
-  p = pb_push1(p, NV097_SET_CONTEXT_DMA_COLOR, kDefaultDMAColorChannel);
-  p = pb_push1(p, NV097_SET_SURFACE_COLOR_OFFSET, 0);
-  pb_end(p);
+  host_.UnbindRenderTarget();
 
-  host_.SetRawTexture(render_target_, kTextureWidth, kTextureHeight, 1, kTexturePitch, 4, false);
+  host_.SetRawTexture(render_target_->memory, kTextureWidth, kTextureHeight, 1, kTexturePitch, 4, false);
 
   host_.SetVertexBuffer(framebuffer_vertex_buffer_);
   host_.PrepareDraw(0xFE202020);
@@ -258,7 +199,7 @@ void TextureRenderTargetTests::TestPalettized(TestHost::PaletteSize size) {
   pb_print("W: %d\n", host_.GetMaxTextureWidth());
   pb_print("H: %d\n", host_.GetMaxTextureHeight());
   pb_print("P: %d\n", texture_format.xbox_bpp * host_.GetMaxTextureWidth());
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, test_name);
 }
@@ -283,74 +224,3 @@ std::string TextureRenderTargetTests::MakePalettizedTestName(TestHost::PaletteSi
 
   return std::move(test_name);
 }
-
-static int GenerateGradientSurface(SDL_Surface **gradient_surface, int width, int height) {
-  *gradient_surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA8888);
-  if (!(*gradient_surface)) {
-    return 1;
-  }
-
-  if (SDL_LockSurface(*gradient_surface)) {
-    SDL_FreeSurface(*gradient_surface);
-    *gradient_surface = nullptr;
-    return 2;
-  }
-
-  auto pixels = static_cast<uint32_t *>((*gradient_surface)->pixels);
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x, ++pixels) {
-      int x_normal = static_cast<int>(static_cast<float>(x) * 255.0f / static_cast<float>(width));
-      int y_normal = static_cast<int>(static_cast<float>(y) * 255.0f / static_cast<float>(height));
-      *pixels = SDL_MapRGBA((*gradient_surface)->format, y_normal, x_normal, 255 - y_normal, x_normal + y_normal);
-    }
-  }
-
-  SDL_UnlockSurface(*gradient_surface);
-
-  return 0;
-}
-
-static int GeneratePalettizedGradientSurface(uint8_t **gradient_surface, int width, int height,
-                                             TestHost::PaletteSize palette_size) {
-  *gradient_surface = new uint8_t[width * height];
-  if (!(*gradient_surface)) {
-    return 1;
-  }
-
-  auto pixel = *gradient_surface;
-
-  uint32_t total_size = width * height;
-  uint32_t half_size = total_size >> 1;
-
-  for (uint32_t i = 0; i < half_size; ++i, ++pixel) {
-    *pixel = i & (palette_size - 1);
-  }
-
-  for (uint32_t i = half_size; i < total_size; i += 4) {
-    uint8_t value = i & (palette_size - 1);
-    *pixel++ = value;
-    *pixel++ = value;
-    *pixel++ = value;
-    *pixel++ = value;
-  }
-
-  return 0;
-}
-
-static uint32_t *GeneratePalette(TestHost::PaletteSize size) {
-  auto ret = new uint32_t[size];
-
-  uint32_t block_size = size / 4;
-  auto component_inc = (uint32_t)ceilf(255.0f / (float)block_size);
-  uint32_t i = 0;
-  uint32_t component = 0;
-  for (; i < block_size; ++i, component += component_inc) {
-    uint32_t color_value = 0xFF - component;
-    ret[i + block_size * 0] = 0xFF000000 + color_value;
-    ret[i + block_size * 1] = 0xFF000000 + (color_value << 8);
-    ret[i + block_size * 2] = 0xFF000000 + (color_value << 16);
-    ret[i + block_size * 3] = 0xFF000000 + color_value + (color_value << 8) + (color_value << 16);
-  }
-
-  return ret;
-}
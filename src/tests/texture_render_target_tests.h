@@ -27,8 +27,7 @@ class TextureRenderTargetTests : public TestSuite {
   static std::string MakePalettizedTestName(TestHost::PaletteSize size);
 
  private:
-  struct s_CtxDma texture_target_ctx_ {};
-  uint8_t *render_target_{nullptr};
+  TestHost::RenderTarget *render_target_{nullptr};
 
   std::shared_ptr<VertexBuffer> render_target_vertex_buffer_;
   std::shared_ptr<VertexBuffer> framebuffer_vertex_buffer_;
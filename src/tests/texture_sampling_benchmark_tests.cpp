@@ -0,0 +1,220 @@
+#include "texture_sampling_benchmark_tests.h"
+
+#include <SDL.h>
+#include <pbkit/pbkit.h>
+
+#include "debug_output.h"
+#include "shaders/vertex_program_assembler.h"
+#include "shaders/vertex_shader_program.h"
+#include "texture_format.h"
+#include "texture_generator.h"
+#include "vertex_buffer.h"
+
+using TS = TextureStage;
+
+// The LOD selecting filters operate on a single level texture, so they measure the filter cost without the bandwidth
+// saved by sampling smaller levels.
+// clang-format off
+static constexpr TextureSamplingBenchmarkTests::FilterInfo kFilters[] = {
+    {"MinBoxLOD0", TS::K_QUINCUNX, TS::MIN_BOX_LOD0, TS::MAG_BOX_LOD0, true},
+    {"MinTentLOD0", TS::K_QUINCUNX, TS::MIN_TENT_LOD0, TS::MAG_BOX_LOD0, true},
+    {"MinBoxNearestLOD", TS::K_QUINCUNX, TS::MIN_BOX_NEARESTLOD, TS::MAG_BOX_LOD0, true},
+    {"MinTentNearestLOD", TS::K_QUINCUNX, TS::MIN_TENT_NEARESTLOD, TS::MAG_BOX_LOD0, true},
+    {"MinBoxTentLOD", TS::K_QUINCUNX, TS::MIN_BOX_TENT_LOD, TS::MAG_BOX_LOD0, true},
+    {"MinTentTentLOD", TS::K_QUINCUNX, TS::MIN_TENT_TENT_LOD, TS::MAG_BOX_LOD0, true},
+    {"MinConvQuincunx", TS::K_QUINCUNX, TS::MIN_CONVOLUTION_2D_LOD0, TS::MAG_BOX_LOD0, true},
+    {"MinConvGaussian3", TS::K_GAUSSIAN_3, TS::MIN_CONVOLUTION_2D_LOD0, TS::MAG_BOX_LOD0, true},
+    {"MagBoxLOD0", TS::K_QUINCUNX, TS::MIN_BOX_LOD0, TS::MAG_BOX_LOD0, false},
+    {"MagTentLOD0", TS::K_QUINCUNX, TS::MIN_BOX_LOD0, TS::MAG_TENT_LOD0, false},
+    {"MagConvQuincunx", TS::K_QUINCUNX, TS::MIN_BOX_LOD0, TS::MAG_CONVOLUTION_2D_LOD0, false},
+    {"MagConvGaussian3", TS::K_GAUSSIAN_3, TS::MIN_BOX_LOD0, TS::MAG_CONVOLUTION_2D_LOD0, false},
+};
+// clang-format on
+
+// Sums the active textures so that every stage contributes to the output.
+static constexpr TestHost::CombinerState kOneTextureState =
+    TestHost::CombinerState(TestSuite::kDefaultCombinerState)
+        .SetInputColorCombiner(0, TestHost::ColorInput(TestHost::SRC_TEX0), TestHost::OneInput());
+
+static constexpr TestHost::CombinerState kTwoTextureState =
+    TestHost::CombinerState(kOneTextureState)
+        .SetInputColorCombiner(0, TestHost::ColorInput(TestHost::SRC_TEX0), TestHost::OneInput(),
+                               TestHost::ColorInput(TestHost::SRC_TEX1), TestHost::OneInput());
+
+static constexpr TestHost::CombinerState kThreeTextureState =
+    TestHost::CombinerState(kTwoTextureState)
+        .SetCombinerControl(2)
+        .SetInputColorCombiner(1, TestHost::ColorInput(TestHost::SRC_R0), TestHost::OneInput(),
+                               TestHost::ColorInput(TestHost::SRC_TEX2), TestHost::OneInput())
+        .SetOutputColorCombiner(1, TestHost::DST_DISCARD, TestHost::DST_DISCARD, TestHost::DST_R0);
+
+static constexpr TestHost::CombinerState kFourTextureState =
+    TestHost::CombinerState(kThreeTextureState)
+        .SetCombinerControl(3)
+        .SetInputColorCombiner(2, TestHost::ColorInput(TestHost::SRC_R0), TestHost::OneInput(),
+                               TestHost::ColorInput(TestHost::SRC_TEX3), TestHost::OneInput())
+        .SetOutputColorCombiner(2, TestHost::DST_DISCARD, TestHost::DST_DISCARD, TestHost::DST_R0);
+
+static constexpr const TestHost::CombinerState* kCombinerStates[] = {
+    &kOneTextureState,
+    &kTwoTextureState,
+    &kThreeTextureState,
+    &kFourTextureState,
+};
+
+static constexpr uint32_t kMaxStages = 4;
+// Number of times the geometry is drawn per measurement.
+static constexpr uint32_t kPasses = 8;
+
+TextureSamplingBenchmarkTests::TextureSamplingBenchmarkTests(TestHost& host, std::string output_dir)
+    : TestSuite(host, std::move(output_dir), "Texture sampling") {
+  for (auto i = 0; i < kNumFormats; ++i) {
+    auto& format = kTextureFormats[i];
+    // Palettized textures are covered by TextureFormatTests but require a palette per stage.
+    if (format.xbox_format == NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8) {
+      continue;
+    }
+
+    for (auto& filter : kFilters) {
+      for (uint32_t num_stages = 1; num_stages <= kMaxStages; ++num_stages) {
+        tests_[MakeTestName(format, filter, num_stages)] = [this, &format, &filter, num_stages]() {
+          Test(format, filter, num_stages);
+        };
+      }
+    }
+  }
+}
+
+void TextureSamplingBenchmarkTests::Initialize() {
+  TestSuite::Initialize();
+
+  // Pass the first texture coordinate through to every stage.
+  using VPA = VertexProgramAssembler;
+  VPA vp;
+  vp.Mov(VPA::Output(VPA::OUT_POSITION), VPA::V(0)).Mov(VPA::Output(VPA::OUT_DIFFUSE), VPA::V(3));
+  for (auto output : {VPA::OUT_TEX0, VPA::OUT_TEX1, VPA::OUT_TEX2, VPA::OUT_TEX3}) {
+    vp.Mov(VPA::Output(output), VPA::V(9));
+  }
+  auto& program = vp.Assemble();
+
+  shader_ = std::make_shared<VertexShaderProgram>();
+  shader_->SetShaderOverride(program.data(), program.size() * sizeof(uint32_t));
+  host_.SetVertexShaderProgram(shader_);
+
+  resident_format_ = nullptr;
+  CreateGeometry();
+}
+
+void TextureSamplingBenchmarkTests::Deinitialize() {
+  for (uint32_t stage = 0; stage < kMaxStages; ++stage) {
+    host_.GetTextureStage(stage).SetFilter();
+    host_.SetTextureStageEnabled(stage, false);
+  }
+  host_.SetShaderStageProgram(TestHost::STAGE_NONE);
+  host_.SetVertexShaderProgram(nullptr);
+  shader_.reset();
+  host_.SetVertexBuffer(nullptr);
+  minify_vertex_buffer_.reset();
+  magnify_vertex_buffer_.reset();
+  resident_format_ = nullptr;
+  ReleaseGeneratedTextures();
+  TestSuite::Deinitialize();
+}
+
+void TextureSamplingBenchmarkTests::CreateGeometry() {
+  auto fb_width = host_.GetFramebufferWidth();
+  auto fb_height = host_.GetFramebufferHeight();
+  auto texture_width = static_cast<float>(host_.GetMaxTextureWidth());
+  auto texture_height = static_cast<float>(host_.GetMaxTextureHeight());
+
+  // Tiles at half the texture size, giving a minification of 2x in each direction.
+  uint32_t tile_width = host_.GetMaxTextureWidth() / 2;
+  uint32_t tile_height = host_.GetMaxTextureHeight() / 2;
+  uint32_t columns = fb_width / tile_width;
+  uint32_t rows = fb_height / tile_height;
+  uint32_t tiles = columns * rows;
+
+  minify_vertex_buffer_ = host_.AllocateVertexBuffer(6 * tiles * kPasses);
+  uint32_t quad = 0;
+  for (uint32_t pass = 0; pass < kPasses; ++pass) {
+    for (uint32_t y = 0; y < rows; ++y) {
+      for (uint32_t x = 0; x < columns; ++x) {
+        auto left = static_cast<float>(x * tile_width);
+        auto top = static_cast<float>(y * tile_height);
+        minify_vertex_buffer_->DefineBiTri(quad++, left, top, left + static_cast<float>(tile_width),
+                                           top + static_cast<float>(tile_height), 0.0f);
+      }
+    }
+  }
+  minify_vertex_buffer_->Linearize(texture_width, texture_height);
+  minify_pixels_ = tiles * tile_width * tile_height * kPasses;
+
+  magnify_vertex_buffer_ = host_.AllocateVertexBuffer(6 * kPasses);
+  for (uint32_t pass = 0; pass < kPasses; ++pass) {
+    magnify_vertex_buffer_->DefineBiTri(pass, 0.0f, 0.0f, static_cast<float>(fb_width), static_cast<float>(fb_height),
+                                        0.0f);
+  }
+  magnify_vertex_buffer_->Linearize(texture_width, texture_height);
+  magnify_pixels_ = fb_width * fb_height * kPasses;
+}
+
+void TextureSamplingBenchmarkTests::PrepareTextures(const TextureFormatInfo& texture_format) {
+  if (resident_format_ == &texture_format) {
+    return;
+  }
+
+  uint32_t source_format = texture_format.require_conversion ? SDL_PIXELFORMAT_RGBA8888 : texture_format.sdl_format;
+  SDL_Surface* surface =
+      GetGradientSurface((int)host_.GetMaxTextureWidth(), (int)host_.GetMaxTextureHeight(), source_format);
+  ASSERT(surface && "Failed to generate SDL surface");
+
+  for (uint32_t stage = 0; stage < kMaxStages; ++stage) {
+    host_.SetTextureFormat(texture_format, stage);
+    int err = host_.SetTexture(surface, stage);
+    ASSERT(!err && "Failed to set texture");
+  }
+
+  resident_format_ = &texture_format;
+}
+
+void TextureSamplingBenchmarkTests::Test(const TextureFormatInfo& texture_format, const FilterInfo& filter,
+                                         uint32_t num_stages) {
+  PrepareTextures(texture_format);
+
+  auto stage_program = [num_stages](uint32_t stage) {
+    return stage < num_stages ? TestHost::STAGE_2D_PROJECTIVE : TestHost::STAGE_NONE;
+  };
+  for (uint32_t stage = 0; stage < kMaxStages; ++stage) {
+    host_.SetTextureStageEnabled(stage, stage < num_stages);
+    host_.GetTextureStage(stage).SetFilter(0, filter.kernel, filter.min, filter.mag);
+  }
+  host_.SetShaderStageProgram(stage_program(0), stage_program(1), stage_program(2), stage_program(3));
+  host_.SetCombinerState(*kCombinerStates[num_stages - 1]);
+
+  host_.SetVertexBuffer(filter.minify ? minify_vertex_buffer_ : magnify_vertex_buffer_);
+  host_.PrepareDraw(0xFF000000);
+
+  uint32_t vertex_fields = TestHost::POSITION | TestHost::DIFFUSE | TestHost::TEXCOORD0;
+  double seconds = MeasureGpuSeconds([this, vertex_fields]() { host_.DrawArrays(vertex_fields); });
+
+  double num_texels = static_cast<double>(filter.minify ? minify_pixels_ : magnify_pixels_) * num_stages;
+  double texels_per_second = seconds > 0.0 ? num_texels / seconds : 0.0;
+
+  std::string name = MakeTestName(texture_format, filter, num_stages);
+  RecordBenchmarkResult(name, "texels_per_second", texels_per_second, "texels/s");
+
+  host_.Clear(0xFF000000);
+  pb_print("%s\n", name.c_str());
+  pb_print("%u Mtexels/s\n", static_cast<uint32_t>(texels_per_second / 1000000.0));
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(false, output_dir_, name);
+}
+
+std::string TextureSamplingBenchmarkTests::MakeTestName(const TextureFormatInfo& texture_format,
+                                                        const FilterInfo& filter, uint32_t num_stages) {
+  char buf[64] = {0};
+  snprintf(buf, 63, "%s%s_%s_T%u", texture_format.name, texture_format.xbox_swizzled ? "" : "_L", filter.name,
+           num_stages);
+  return buf;
+}
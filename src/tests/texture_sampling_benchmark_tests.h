@@ -0,0 +1,53 @@
+#ifndef NXDK_PGRAPH_TESTS_TEXTURE_SAMPLING_BENCHMARK_TESTS_H
+#define NXDK_PGRAPH_TESTS_TEXTURE_SAMPLING_BENCHMARK_TESTS_H
+
+#include <memory>
+#include <string>
+
+#include "test_host.h"
+#include "test_suite.h"
+#include "texture_stage.h"
+
+struct TextureFormatInfo;
+class VertexBuffer;
+class VertexShaderProgram;
+
+// Measures the texels per second sampled when drawing textured quads for each of the TextureFormatTests formats under
+// every texture filter and with 1 to 4 active texture stages.
+class TextureSamplingBenchmarkTests : public TestSuite {
+ public:
+  struct FilterInfo {
+    const char* name;
+    TextureStage::ConvolutionKernel kernel;
+    TextureStage::MinFilter min;
+    TextureStage::MagFilter mag;
+    // Whether the texture is minified (exercising `min`) or magnified (exercising `mag`).
+    bool minify;
+  };
+
+ public:
+  TextureSamplingBenchmarkTests(TestHost& host, std::string output_dir);
+  void Initialize() override;
+  void Deinitialize() override;
+  bool IsBenchmark() const override { return true; }
+
+ private:
+  void CreateGeometry();
+  // Uploads a texture in the given format to every stage, unless it is already resident.
+  void PrepareTextures(const TextureFormatInfo& texture_format);
+  void Test(const TextureFormatInfo& texture_format, const FilterInfo& filter, uint32_t num_stages);
+
+  static std::string MakeTestName(const TextureFormatInfo& texture_format, const FilterInfo& filter,
+                                  uint32_t num_stages);
+
+ private:
+  std::shared_ptr<VertexShaderProgram> shader_;
+  std::shared_ptr<VertexBuffer> minify_vertex_buffer_;
+  std::shared_ptr<VertexBuffer> magnify_vertex_buffer_;
+  uint32_t minify_pixels_{0};
+  uint32_t magnify_pixels_{0};
+
+  const TextureFormatInfo* resident_format_{nullptr};
+};
+
+#endif  // NXDK_PGRAPH_TESTS_TEXTURE_SAMPLING_BENCHMARK_TESTS_H
@@ -58,61 +58,61 @@ void ThreeDPrimitiveTests::CreateLines() {
   auto buffer = host_.AllocateVertexBuffer(kNumLines * 2);
 
   auto vertex = buffer->Lock();
-  index_buffer_.clear();
+  index_buffer_.Clear();
   auto index = 0;
 
   vertex->SetPosition(kLeft, kTop, kZFront);
   vertex->SetDiffuseGrey(0.75f);
-  index_buffer_.push_back(index++);
+  index_buffer_.Append(index++);
   ++vertex;
   vertex->SetPosition(kRight, kTop, kZFront);
   vertex->SetDiffuseGrey(1.0f);
-  index_buffer_.push_back(index++);
+  index_buffer_.Append(index++);
   ++vertex;
 
   vertex->SetPosition(-2, 1, kZFront);
   vertex->SetDiffuse(1.0f, 0.0f, 0.0f);
-  index_buffer_.push_back(index++);
+  index_buffer_.Append(index++);
   ++vertex;
   vertex->SetPosition(2, 0, kZBack);
   vertex->SetDiffuse(1.0f, 0.0f, 0.0f);
-  index_buffer_.push_back(index++);
+  index_buffer_.Append(index++);
   ++vertex;
 
   vertex->SetPosition(1.5, 0.5, kZBack);
   vertex->SetDiffuse(0.0f, 1.0f, 0.0f);
-  index_buffer_.push_back(index++);
+  index_buffer_.Append(index++);
   ++vertex;
   vertex->SetPosition(-1.5, 0.75, kZBack);
   vertex->SetDiffuse(0.0f, 1.0f, 0.0f);
-  index_buffer_.push_back(index++);
+  index_buffer_.Append(index++);
   ++vertex;
 
   vertex->SetPosition(kRight, 0.25, kZFront);
   vertex->SetDiffuseGrey(1.0f);
-  index_buffer_.push_back(index++);
+  index_buffer_.Append(index++);
   ++vertex;
   vertex->SetPosition(1.75f, 1.25, kZFront);
   vertex->SetDiffuseGrey(0.15f);
-  index_buffer_.push_back(index++);
+  index_buffer_.Append(index++);
   ++vertex;
 
   vertex->SetPosition(kLeft, 1.0f, kZFront);
   vertex->SetDiffuse(0.25f, 0.25f, 1.0f);
-  index_buffer_.push_back(index++);
+  index_buffer_.Append(index++);
   ++vertex;
   vertex->SetPosition(kLeft, -1.0f, kZFront);
   vertex->SetDiffuse(0.65f, 0.65f, 1.0f);
-  index_buffer_.push_back(index++);
+  index_buffer_.Append(index++);
   ++vertex;
 
   vertex->SetPosition(kLeft, kBottom, kZBack);
   vertex->SetDiffuse(0.0f, 1.0f, 1.0f);
-  index_buffer_.push_back(index++);
+  index_buffer_.Append(index++);
   ++vertex;
   vertex->SetPosition(kRight, kBottom, kZBack);
   vertex->SetDiffuse(0.5f, 0.5f, 1.0f);
-  index_buffer_.push_back(index++);
+  index_buffer_.Append(index++);
   ++vertex;
 
   buffer->Unlock();
@@ -157,9 +157,9 @@ void ThreeDPrimitiveTests::CreateTriangles() {
     buffer->DefineTriangle(index++, one, two, three, color_one, color_two, color_three);
   }
 
-  index_buffer_.clear();
+  index_buffer_.Clear();
   for (auto i = 0; i < buffer->GetNumVertices(); ++i) {
-    index_buffer_.push_back(i);
+    index_buffer_.Append(i);
   }
 }
 
@@ -168,13 +168,13 @@ void ThreeDPrimitiveTests::CreateTriangleStrip() {
   auto buffer = host_.AllocateVertexBuffer(3 + (kNumTriangles - 1));
 
   auto vertex = buffer->Lock();
-  index_buffer_.clear();
+  index_buffer_.Clear();
   auto index = 0;
 
   auto add_vertex = [&vertex, &index, this](float x, float y, float z, float r, float g, float b) {
     vertex->SetPosition(x, y, z);
     vertex->SetDiffuse(r, g, b);
-    this->index_buffer_.push_back(index++);
+    this->index_buffer_.Append(index++);
     ++vertex;
   };
 
@@ -200,13 +200,13 @@ void ThreeDPrimitiveTests::CreateTriangleFan() {
   auto buffer = host_.AllocateVertexBuffer(3 + (kNumTriangles - 1));
 
   auto vertex = buffer->Lock();
-  index_buffer_.clear();
+  index_buffer_.Clear();
   auto index = 0;
 
   auto add_vertex = [&vertex, &index, this](float x, float y, float z, float r, float g, float b) {
     vertex->SetPosition(x, y, z);
     vertex->SetDiffuse(r, g, b);
-    this->index_buffer_.push_back(index++);
+    this->index_buffer_.Append(index++);
     ++vertex;
   };
 
@@ -232,13 +232,13 @@ void ThreeDPrimitiveTests::CreateQuads() {
   auto buffer = host_.AllocateVertexBuffer(kNumQuads * 4);
 
   auto vertex = buffer->Lock();
-  index_buffer_.clear();
+  index_buffer_.Clear();
   auto index = 0;
 
   auto add_vertex = [&vertex, &index, this](float x, float y, float z, float r, float g, float b) {
     vertex->SetPosition(x, y, z);
     vertex->SetDiffuse(r, g, b);
-    this->index_buffer_.push_back(index++);
+    this->index_buffer_.Append(index++);
     ++vertex;
   };
 
@@ -265,13 +265,13 @@ void ThreeDPrimitiveTests::CreateQuadStrip() {
   auto buffer = host_.AllocateVertexBuffer(4 + (kNumQuads - 1) * 2);
 
   auto vertex = buffer->Lock();
-  index_buffer_.clear();
+  index_buffer_.Clear();
   auto index = 0;
 
   auto add_vertex = [&vertex, &index, this](float x, float y, float z, float r, float g, float b) {
     vertex->SetPosition(x, y, z);
     vertex->SetDiffuse(r, g, b);
-    this->index_buffer_.push_back(index++);
+    this->index_buffer_.Append(index++);
     ++vertex;
   };
 
@@ -291,13 +291,13 @@ void ThreeDPrimitiveTests::CreatePolygon() {
   auto buffer = host_.AllocateVertexBuffer(kNumVertices);
 
   auto vertex = buffer->Lock();
-  index_buffer_.clear();
+  index_buffer_.Clear();
   auto index = 0;
 
   auto add_vertex = [&vertex, &index, this](float x, float y, float z, float r, float g, float b) {
     vertex->SetPosition(x, y, z);
     vertex->SetDiffuse(r, g, b);
-    this->index_buffer_.push_back(index++);
+    this->index_buffer_.Append(index++);
     ++vertex;
   };
 
@@ -371,7 +371,7 @@ void ThreeDPrimitiveTests::Test(TestHost::DrawPrimitive primitive, DrawMode draw
 
   std::string name = MakeTestName(primitive, draw_mode);
   pb_print("%s\n", name.c_str());
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, name);
 }
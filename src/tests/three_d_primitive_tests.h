@@ -4,6 +4,7 @@
 #include <memory>
 #include <vector>
 
+#include "index_buffer.h"
 #include "test_host.h"
 #include "test_suite.h"
 #include "vertex_buffer.h"
@@ -42,7 +43,7 @@ class ThreeDPrimitiveTests : public TestSuite {
   static std::string MakeTestName(TestHost::DrawPrimitive primitive, DrawMode draw_mode);
 
  private:
-  std::vector<uint32_t> index_buffer_;
+  IndexBuffer index_buffer_;
 };
 
 #endif  // NXDK_PGRAPH_TESTS_THREE_D_PRIMITIVE_TESTS_H
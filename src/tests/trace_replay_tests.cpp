@@ -0,0 +1,73 @@
+#include "trace_replay_tests.h"
+
+#include <pbkit/pbkit.h>
+#include <windows.h>
+
+#include "debug_output.h"
+#include "method_trace.h"
+#include "pushbuffer_trace.h"
+#include "test_host.h"
+
+static constexpr const char* kTraceDirectory = "D:\\traces";
+static constexpr const char* kTraceExtension = ".pbtrace";
+static constexpr const char* kMethodTraceExtension = ".nv2a";
+
+TraceReplayTests::TraceReplayTests(TestHost& host, std::string output_dir)
+    : TestSuite(host, std::move(output_dir), "Trace replay") {
+  RegisterTraces(kTraceExtension, [this](const std::string& path, const std::string& name) {
+    tests_[name] = [this, path, name]() { Test(path, name); };
+  });
+  RegisterTraces(kMethodTraceExtension, [this](const std::string& path, const std::string& name) {
+    tests_[name] = [this, path, name]() { TestMethodTrace(path, name); };
+  });
+}
+
+void TraceReplayTests::RegisterTraces(const std::string& extension,
+                                      const std::function<void(const std::string&, const std::string&)>& add_test) {
+  WIN32_FIND_DATAA find_data;
+  HANDLE find_handle = FindFirstFileA((std::string(kTraceDirectory) + "\\*" + extension).c_str(), &find_data);
+  if (find_handle == INVALID_HANDLE_VALUE) {
+    return;
+  }
+
+  do {
+    std::string filename = find_data.cFileName;
+    if (filename.size() <= extension.size()) {
+      continue;
+    }
+    add_test(std::string(kTraceDirectory) + "\\" + filename, filename.substr(0, filename.size() - extension.size()));
+  } while (FindNextFileA(find_handle, &find_data));
+  FindClose(find_handle);
+}
+
+void TraceReplayTests::Test(const std::string& path, const std::string& name) {
+  PushbufferTrace trace;
+  const bool loaded = trace.Load(path);
+
+  host_.PrepareDraw(0xFF000000);
+  if (!loaded || !trace.Replay()) {
+    pb_print("Failed to replay %s\n", path.c_str());
+  }
+  // The trace may have written any register.
+  host_.InvalidateRegisterShadow();
+
+  pb_print("%s\n", name.c_str());
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(allow_saving_, output_dir_, name);
+}
+
+void TraceReplayTests::TestMethodTrace(const std::string& path, const std::string& name) {
+  MethodTrace trace;
+  if (trace.Load(path)) {
+    trace.Run(host_);
+  } else {
+    host_.PrepareDraw(0xFF000000);
+    pb_print("Failed to load %s\n", path.c_str());
+  }
+
+  pb_print("%s\n", name.c_str());
+  host_.DrawTextScreen();
+
+  host_.FinishDraw(allow_saving_, output_dir_, name);
+}
@@ -0,0 +1,27 @@
+#ifndef NXDK_PGRAPH_TESTS_TRACE_REPLAY_TESTS_H
+#define NXDK_PGRAPH_TESTS_TRACE_REPLAY_TESTS_H
+
+#include <functional>
+#include <string>
+
+#include "test_suite.h"
+
+class TestHost;
+
+// Replays traces from the "traces" directory next to the XBE. Every "*.pbtrace" pushbuffer trace captured via
+// TestHost::SetTraceCaptureEnabled and every "*.nv2a" method trace (see MethodTrace) is registered as a test named
+// after the file, and is reloaded each time it is run so that traces may be edited without restarting.
+class TraceReplayTests : public TestSuite {
+ public:
+  TraceReplayTests(TestHost& host, std::string output_dir);
+
+ private:
+  // Calls `add_test` with the path and name of every trace file with the given extension.
+  static void RegisterTraces(const std::string& extension,
+                             const std::function<void(const std::string&, const std::string&)>& add_test);
+
+  void Test(const std::string& path, const std::string& name);
+  void TestMethodTrace(const std::string& path, const std::string& name);
+};
+
+#endif  // NXDK_PGRAPH_TESTS_TRACE_REPLAY_TESTS_H
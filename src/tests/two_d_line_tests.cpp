@@ -47,15 +47,8 @@ void TwoDLineTests::Initialize() {
   TestSuite::Initialize();
   SetDefaultTextureFormat();
 
-  auto channel = kNextContextChannel;
-
-  pb_create_gr_ctx(channel++, NV04_SOLID_LINE, &solid_lin_ctx_);
-  pb_bind_channel(&solid_lin_ctx_);
-  pb_bind_subchannel(SUBCH_CLASS_5C, &solid_lin_ctx_);
-
-  pb_create_gr_ctx(channel++, NV04_CONTEXT_SURFACES_2D, &surface_destination_ctx_);
-  pb_bind_channel(&surface_destination_ctx_);
-  pb_bind_subchannel(SUBCH_CLASS_42, &surface_destination_ctx_);
+  solid_lin_ctx_ = &host_.GetGraphicsObject(NV04_SOLID_LINE);
+  surface_destination_ctx_ = &host_.GetGraphicsObject(NV04_CONTEXT_SURFACES_2D);
 
   host_.SetVertexShaderProgram(nullptr);
 }
@@ -63,6 +56,10 @@ void TwoDLineTests::Initialize() {
 void TwoDLineTests::Test(const TestCase& test) {
   host_.PrepareDraw(0xFF440011);  // alpha + RRGGBB
 
+  // The subchannels are shared with other suites, so the objects are rebound if another suite replaced them.
+  host_.BindSubchannel(SUBCH_CLASS_5C, *solid_lin_ctx_);
+  host_.BindSubchannel(SUBCH_CLASS_42, *surface_destination_ctx_);
+
   auto p = pb_begin();
 
   p = pb_push1_to(SUBCH_CLASS_42, p, NV04_CONTEXT_SURFACES_2D_SET_DMA_IMAGE_DST, DMA_CHANNEL_PIXEL_RENDERER);
@@ -73,7 +70,7 @@ void TwoDLineTests::Test(const TestCase& test) {
 
   p = pb_push1_to(SUBCH_CLASS_5C, p, NV04_SOLID_LINE_OPERATION, NV09F_SET_OPERATION_SRCCOPY);
   p = pb_push1_to(SUBCH_CLASS_5C, p, NV04_SOLID_LINE_COLOR_VALUE, test.object_color);
-  p = pb_push1_to(SUBCH_CLASS_5C, p, NV04_SOLID_LINE_SURFACE, surface_destination_ctx_.ChannelID);
+  p = pb_push1_to(SUBCH_CLASS_5C, p, NV04_SOLID_LINE_SURFACE, surface_destination_ctx_->ChannelID);
 
   p = pb_push1_to(SUBCH_CLASS_5C, p, NV04_SOLID_LINE_COLOR_FORMAT, test.color_format);
   p = pb_push1_to(SUBCH_CLASS_5C, p, NV04_SOLID_LINE_START, (test.start_y << 16) | test.start_x);
@@ -85,7 +82,7 @@ void TwoDLineTests::Test(const TestCase& test) {
   std::string color_format_name = ColorFormatName(test.color_format, false);
   pb_print("Color: %s - %08X\n", color_format_name.c_str(), test.object_color);
 
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
   std::string name = MakeTestName(test, true);
 
   host_.FinishDraw(allow_saving_, output_dir_, name);
@@ -28,8 +28,9 @@ class TwoDLineTests : public TestSuite {
 
   static std::string MakeTestName(const TestCase& test, bool ReturnShortName);
 
-  struct s_CtxDma solid_lin_ctx_ {};
-  struct s_CtxDma surface_destination_ctx_ {};
+  // Shared objects owned by the TestHost, see TestHost::GetGraphicsObject.
+  const struct s_CtxDma* solid_lin_ctx_{nullptr};
+  const struct s_CtxDma* surface_destination_ctx_{nullptr};
 };
 
 #endif  // NXDK_PGRAPH_TESTS_2D_LINE_TESTS_H
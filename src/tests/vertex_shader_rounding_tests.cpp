@@ -9,14 +9,10 @@
 #include "debug_output.h"
 #include "pbkit_ext.h"
 #include "shaders/precalculated_vertex_shader.h"
+#include "shaders/transform_program_memory.h"
 #include "test_host.h"
 #include "texture_format.h"
 
-#define SET_MASK(mask, val) (((val) << (__builtin_ffs(mask) - 1)) & (mask))
-
-// From pbkit.c, DMA_COLOR is set to channel 9 by default
-const uint32_t kDefaultDMAColorChannel = 9;
-
 static const uint32_t kTextureWidth = 128;
 static const uint32_t kTexturePitch = kTextureWidth * 4;
 static const uint32_t kTextureHeight = 128;
@@ -43,20 +39,11 @@ void VertexShaderRoundingTests::Initialize() {
   TestSuite::Initialize();
   CreateGeometry();
 
-  auto channel = kNextContextChannel;
-  const uint32_t texture_target_dma_channel = channel++;
-  pb_create_dma_ctx(texture_target_dma_channel, DMA_CLASS_3D, 0, MAXRAM, &texture_target_ctx_);
-  pb_bind_channel(&texture_target_ctx_);
-
-  const uint32_t texture_size = kTexturePitch * kTextureHeight;
-  render_target_ =
-      (uint8_t *)MmAllocateContiguousMemoryEx(texture_size, 0, MAXRAM, 0x1000, PAGE_WRITECOMBINE | PAGE_READWRITE);
-  ASSERT(render_target_ && "Failed to allocate target surface.");
-  auto *pixel = reinterpret_cast<uint32_t *>(render_target_);
+  render_target_ = host_.AcquireRenderTarget(kTextureWidth, kTextureHeight);
+  auto *pixel = reinterpret_cast<uint32_t *>(render_target_->memory);
   for (uint32_t i = 0; i < kTextureWidth * kTextureHeight; ++i) {
     *pixel++ = 0x7FFF00FF;
   }
-  pb_set_dma_address(&texture_target_ctx_, render_target_, texture_size - 1);
 
   host_.SetCombinerControl(1, true, true);
   host_.SetFinalCombiner0Just(TestHost::SRC_TEX0);
@@ -69,7 +56,8 @@ void VertexShaderRoundingTests::Initialize() {
 void VertexShaderRoundingTests::Deinitialize() {
   TestSuite::Deinitialize();
   if (render_target_) {
-    MmFreeContiguousMemory(render_target_);
+    host_.ReleaseRenderTarget(render_target_);
+    render_target_ = nullptr;
   }
 }
 
@@ -87,8 +75,6 @@ void VertexShaderRoundingTests::CreateGeometry() {
 }
 
 void VertexShaderRoundingTests::TestRenderTarget() {
-  const uint32_t kFramebufferPitch = host_.GetFramebufferWidth() * 4;
-
   host_.SetTextureFormat(GetTextureFormatInfo(NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_X8R8G8B8));
 
   auto &texture_stage = host_.GetTextureStage(0);
@@ -106,18 +92,8 @@ void VertexShaderRoundingTests::TestRenderTarget() {
 
   host_.PrepareDraw(0xFE202020);
 
-  uint32_t *p;
   // Redirect the color output to the target texture.
-  p = pb_begin();
-  p = pb_push1(
-      p, NV097_SET_SURFACE_PITCH,
-      SET_MASK(NV097_SET_SURFACE_PITCH_COLOR, kTexturePitch) | SET_MASK(NV097_SET_SURFACE_PITCH_ZETA, kTexturePitch));
-  p = pb_push1(p, NV097_SET_CONTEXT_DMA_COLOR, texture_target_ctx_.ChannelID);
-  p = pb_push1(p, NV097_SET_SURFACE_COLOR_OFFSET, 0);
-  // TODO: Investigate if this is actually necessary. Morrowind does this after changing offsets.
-  p = pb_push1(p, NV097_NO_OPERATION, 0);
-  p = pb_push1(p, NV097_WAIT_FOR_IDLE, 0);
-  pb_end(p);
+  host_.BindRenderTarget(render_target_, kTexturePitch);
 
   auto shader = std::make_shared<PrecalculatedVertexShader>();
   host_.SetVertexShaderProgram(shader);
@@ -129,7 +105,7 @@ void VertexShaderRoundingTests::TestRenderTarget() {
   host_.SetViewportScale(320.0f, -240.0f, 16777215.0f, 0.0f);
   host_.SetDepthClip(0.0f, 16777215.0f);
 
-  p = pb_begin();
+  auto p = pb_begin();
   p = pb_push1(p, NV097_SET_TRANSFORM_PROGRAM_LOAD, 0x0);
 
   //  MOV(oPos,xyzw, v0);
@@ -155,6 +131,8 @@ void VertexShaderRoundingTests::TestRenderTarget() {
   p = pb_push4f(p, 0xBA0 /*NV097_SET_TRANSFORM_CONSTANT[8]*/, 0.0f, 0.0f, 0.050505f, 0.242424f);
   p = pb_push4f(p, 0xBB0 /*NV097_SET_TRANSFORM_CONSTANT[12]*/, 0.0f, 0.0f, 0.0f, 1.0f);
   pb_end(p);
+  // The program above overwrites slot 0 directly.
+  TransformProgramMemory::Invalidate();
 
   host_.SetVertexBuffer(render_target_vertex_buffer_);
   bool swizzle = true;
@@ -173,22 +151,16 @@ void VertexShaderRoundingTests::TestRenderTarget() {
   host_.SetWindowClip(host_.GetFramebufferWidth() - 1, host_.GetFramebufferHeight() - 1);
   host_.SetTextureFormat(GetTextureFormatInfo(NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8R8G8B8));
 
-  p = pb_begin();
-  p = pb_push1(p, NV097_SET_SURFACE_PITCH,
-               SET_MASK(NV097_SET_SURFACE_PITCH_COLOR, kFramebufferPitch) |
-                   SET_MASK(NV097_SET_SURFACE_PITCH_ZETA, kFramebufferPitch));
-  p = pb_push1(p, NV097_SET_CONTEXT_DMA_COLOR, kDefaultDMAColorChannel);
-  p = pb_push1(p, NV097_SET_SURFACE_COLOR_OFFSET, 0);
-  pb_end(p);
+  host_.UnbindRenderTarget();
 
-  host_.SetRawTexture(render_target_, kTextureWidth, kTextureHeight, 1, kTexturePitch, 4, false);
+  host_.SetRawTexture(render_target_->memory, kTextureWidth, kTextureHeight, 1, kTexturePitch, 4, false);
 
   host_.SetVertexBuffer(framebuffer_vertex_buffer_);
   host_.PrepareDraw(0xFE202020);
   host_.DrawArrays();
 
   pb_print("%s\n", kTestRenderTargetName);
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, kTestRenderTargetName);
 }
@@ -236,7 +208,7 @@ void VertexShaderRoundingTests::TestGeometry(float bias) {
 
   std::string test_name = MakeGeometryTestName(bias);
   pb_print("%s\n", test_name.c_str());
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, test_name);
 }
@@ -0,0 +1,115 @@
+#include "vertex_shader_throughput_tests.h"
+
+#include <pbkit/pbkit.h>
+
+#include "debug_output.h"
+#include "shaders/vertex_program_assembler.h"
+#include "shaders/vertex_shader_program.h"
+#include "test_host.h"
+#include "vertex_buffer.h"
+
+static constexpr uint32_t kInstructionCounts[] = {4, 8, 16, 32, 64, 128};
+static constexpr uint32_t kConstantDensities[] = {0, 50, 100};
+
+// Number of distinct constant registers read by the generated programs.
+static constexpr uint32_t kNumConstants = 16;
+
+static constexpr uint32_t kNumVertices = 15000;
+static constexpr uint32_t kIterations = 20;
+
+VertexShaderThroughputTests::VertexShaderThroughputTests(TestHost& host, std::string output_dir)
+    : TestSuite(host, std::move(output_dir), "VS throughput") {
+  for (auto num_instructions : kInstructionCounts) {
+    for (auto constant_density : kConstantDensities) {
+      tests_[MakeTestName(num_instructions, constant_density)] = [this, num_instructions, constant_density]() {
+        Test(num_instructions, constant_density);
+      };
+    }
+  }
+}
+
+void VertexShaderThroughputTests::Initialize() {
+  TestSuite::Initialize();
+
+  shader_ = std::make_shared<VertexShaderProgram>();
+  for (uint32_t i = 0; i < kNumConstants; ++i) {
+    shader_->SetUniformF(i, 1.0f, 0.5f, 0.25f, 1.0f);
+  }
+
+  CreateGeometry();
+}
+
+void VertexShaderThroughputTests::Deinitialize() {
+  host_.SetVertexShaderProgram(nullptr);
+  shader_.reset();
+  host_.SetVertexBuffer(nullptr);
+  TestSuite::Deinitialize();
+}
+
+void VertexShaderThroughputTests::CreateGeometry() {
+  // Every triangle is degenerate so that the measurement is not influenced by rasterization.
+  auto buffer = host_.AllocateVertexBuffer(kNumVertices);
+  auto vertex = buffer->Lock();
+  for (uint32_t i = 0; i < kNumVertices; ++i, ++vertex) {
+    vertex->SetPosition(static_cast<float>(host_.GetFramebufferWidth()) * 0.5f,
+                        static_cast<float>(host_.GetFramebufferHeight()) * 0.5f, 0.0f, 1.0f);
+  }
+  buffer->Unlock();
+}
+
+void VertexShaderThroughputTests::Test(uint32_t num_instructions, uint32_t constant_density) {
+  auto& program = GenerateProgram(num_instructions, constant_density);
+  shader_->SetShaderOverride(program.data(), program.size() * sizeof(uint32_t));
+  host_.SetVertexShaderProgram(shader_);
+
+  host_.PrepareDraw(0xFF202020);
+
+  double seconds = MeasureGpuSeconds([this]() {
+    for (uint32_t i = 0; i < kIterations; ++i) {
+      host_.DrawArrays(TestHost::POSITION);
+    }
+  });
+  double vertices_per_second = seconds > 0.0 ? (kNumVertices * kIterations) / seconds : 0.0;
+
+  std::string name = MakeTestName(num_instructions, constant_density);
+  RecordBenchmarkResult(name, "vertices_per_second", vertices_per_second, "vertices/s");
+
+  pb_print("%s\n", name.c_str());
+  pb_print("%u instructions, %u%% constant reads\n", num_instructions, constant_density);
+  pb_print("%u vertices/s\n", static_cast<uint32_t>(vertices_per_second));
+  host_.DrawTextScreen();
+
+  // The rendered output is meaningless, only the measurement is of interest.
+  host_.FinishDraw(false, output_dir_, name);
+}
+
+const std::vector<uint32_t>& VertexShaderThroughputTests::GenerateProgram(uint32_t num_instructions,
+                                                                          uint32_t constant_density) {
+  using VPA = VertexProgramAssembler;
+  ASSERT(num_instructions >= 4 && "Program must contain at least one arithmetic instruction.");
+
+  VPA vp;
+  vp.Mov(VPA::Temp(0), VPA::V(0));
+
+  // Accumulate into R1, spreading the constant reads evenly through the program.
+  uint32_t num_arithmetic = num_instructions - 3;
+  for (uint32_t i = 0; i < num_arithmetic; ++i) {
+    bool read_constant = ((i + 1) * constant_density) / 100 > (i * constant_density) / 100;
+    auto operand = read_constant ? VPA::C(static_cast<int32_t>(i % kNumConstants)) : VPA::R(0);
+    if (!i) {
+      vp.Mul(VPA::Temp(1), VPA::R(0), operand);
+    } else {
+      vp.Mad(VPA::Temp(1), VPA::R(0), operand, VPA::R(1));
+    }
+  }
+
+  vp.Mov(VPA::Output(VPA::OUT_POSITION), VPA::R(0)).Mov(VPA::Output(VPA::OUT_DIFFUSE), VPA::R(1));
+
+  return vp.Assemble();
+}
+
+std::string VertexShaderThroughputTests::MakeTestName(uint32_t num_instructions, uint32_t constant_density) {
+  char buf[32] = {0};
+  snprintf(buf, 31, "Instr%03u_Const%03u", num_instructions, constant_density);
+  return buf;
+}
@@ -0,0 +1,34 @@
+#ifndef NXDK_PGRAPH_TESTS_VERTEX_SHADER_THROUGHPUT_TESTS_H
+#define NXDK_PGRAPH_TESTS_VERTEX_SHADER_THROUGHPUT_TESTS_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "test_suite.h"
+
+class TestHost;
+class VertexShaderProgram;
+
+// Measures transform throughput for generated vertex programs of increasing length and constant read density.
+// Results are recorded in vertices per second.
+class VertexShaderThroughputTests : public TestSuite {
+ public:
+  VertexShaderThroughputTests(TestHost& host, std::string output_dir);
+  void Initialize() override;
+  void Deinitialize() override;
+  bool IsBenchmark() const override { return true; }
+
+ private:
+  void CreateGeometry();
+  void Test(uint32_t num_instructions, uint32_t constant_density);
+
+  // `constant_density` is the percentage of the program's arithmetic instructions that read a constant register.
+  static const std::vector<uint32_t>& GenerateProgram(uint32_t num_instructions, uint32_t constant_density);
+  static std::string MakeTestName(uint32_t num_instructions, uint32_t constant_density);
+
+ private:
+  std::shared_ptr<VertexShaderProgram> shader_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_VERTEX_SHADER_THROUGHPUT_TESTS_H
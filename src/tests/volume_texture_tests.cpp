@@ -9,13 +9,16 @@
 #include "debug_output.h"
 #include "shaders/perspective_vertex_shader.h"
 #include "test_host.h"
+#include "texture_compression.h"
 #include "texture_format.h"
+#include "texture_generator.h"
 #include "vertex_buffer.h"
 
-static int GenerateSurface(SDL_Surface **gradient_surface, int width, int height, int layer);
 static int GeneratePalettizedSurface(uint8_t **ret, uint32_t width, uint32_t height, uint32_t depth,
                                      TestHost::PaletteSize palette_size);
-static uint32_t *GeneratePalette(TestHost::PaletteSize size);
+
+// Color channels retained by each layer of the volume texture.
+static constexpr uint32_t kLayerColorMasks[] = {0xFFFFFF, 0x0000FF, 0xFF0000, 0x00FF00};
 
 static constexpr uint32_t kBackgroundColor = 0xFE202020;
 static const uint32_t kTextureWidth = 256;
@@ -32,6 +35,9 @@ VolumeTextureTests::VolumeTextureTests(TestHost &host, std::string output_dir)
       // Linear volumetric formats are not supported by the hardware.
       continue;
     }
+    if (IsCompressedTextureFormat(format.xbox_format)) {
+      continue;
+    }
 
     if (format.xbox_format != NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8) {
       tests_[format.name] = [this, format]() { Test(format); };
@@ -66,6 +72,11 @@ void VolumeTextureTests::Initialize() {
   host_.SetFinalCombiner1(TestHost::SRC_ZERO, false, false, TestHost::SRC_ZERO, false, false, TestHost::SRC_R0, true);
 }
 
+void VolumeTextureTests::Deinitialize() {
+  ReleaseGeneratedTextures();
+  TestSuite::Deinitialize();
+}
+
 void VolumeTextureTests::CreateGeometry() {
   const float kLeft = -2.75f;
   const float kRight = 2.75f;
@@ -138,21 +149,14 @@ void VolumeTextureTests::Test(const TextureFormatInfo &texture_format) {
   const uint32_t height = kTextureHeight;
 
   host_.SetTextureFormat(texture_format);
-  auto **layers = new SDL_Surface *[kTextureDepth];
-
-  for (auto d = 0; d < kTextureDepth; ++d) {
-    int update_texture_result = GenerateSurface(&layers[d], (int)width, (int)height, d);
-    ASSERT(!update_texture_result && "Failed to generate SDL surface");
-  }
 
-  int update_texture_result = host_.SetVolumetricTexture((const SDL_Surface **)layers, kTextureDepth);
+  // Each layer is generated only as it is uploaded and freed by the stage, so a single layer is held at a time.
+  auto generate_layer = [width, height](uint32_t index) {
+    return CreateGradientSurface((int)width, (int)height, SDL_PIXELFORMAT_RGBA8888, kLayerColorMasks[index % 4]);
+  };
+  int update_texture_result = host_.SetVolumetricTexture(width, height, kTextureDepth, generate_layer);
   ASSERT(!update_texture_result && "Failed to set texture");
 
-  for (auto d = 0; d < kTextureDepth; ++d) {
-    SDL_FreeSurface(layers[d]);
-  }
-  delete[] layers;
-
   auto &stage = host_.GetTextureStage(0);
   stage.SetTextureDimensions(width, height, kTextureDepth);
   stage.SetImageDimensions(width, height, kTextureDepth);
@@ -164,7 +168,7 @@ void VolumeTextureTests::Test(const TextureFormatInfo &texture_format) {
   pb_print("F: 0x%x\n", texture_format.xbox_format);
   pb_print("SZ: %d\n", texture_format.xbox_swizzled);
   pb_print("C: %d\n", texture_format.require_conversion);
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, texture_format.name);
 }
@@ -189,9 +193,7 @@ void VolumeTextureTests::TestPalettized() {
   delete[] surface;
   ASSERT(!err && "Failed to set texture");
 
-  auto palette = GeneratePalette(palette_size);
-  err = host_.SetPalette(palette, palette_size);
-  delete[] palette;
+  err = host_.SetPalette(GetGradientPalette(palette_size), palette_size);
   ASSERT(!err && "Failed to set palette");
 
   host_.PrepareDraw(kBackgroundColor);
@@ -201,55 +203,11 @@ void VolumeTextureTests::TestPalettized() {
   pb_print("F: 0x%x\n", texture_format.xbox_format);
   pb_print("SZ: %d\n", texture_format.xbox_swizzled);
   pb_print("C: %d\n", texture_format.require_conversion);
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, texture_format.name);
 }
 
-static int GenerateSurface(SDL_Surface **gradient_surface, int width, int height, int layer) {
-  *gradient_surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA8888);
-  if (!(*gradient_surface)) {
-    return 1;
-  }
-
-  if (SDL_LockSurface(*gradient_surface)) {
-    SDL_FreeSurface(*gradient_surface);
-    *gradient_surface = nullptr;
-    return 2;
-  }
-
-  uint32_t red_mask = 0xFF;
-  uint32_t green_mask = 0xFF;
-  uint32_t blue_mask = 0xFF;
-
-  layer %= 4;
-
-  if (layer == 1) {
-    red_mask = 0;
-    green_mask = 0;
-  } else if (layer == 2) {
-    green_mask = 0;
-    blue_mask = 0;
-  } else if (layer == 3) {
-    red_mask = 0;
-    blue_mask = 0;
-  }
-
-  auto pixels = static_cast<uint32_t *>((*gradient_surface)->pixels);
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x, ++pixels) {
-      int x_normal = static_cast<int>(static_cast<float>(x) * 255.0f / static_cast<float>(width));
-      int y_normal = static_cast<int>(static_cast<float>(y) * 255.0f / static_cast<float>(height));
-      *pixels = SDL_MapRGBA((*gradient_surface)->format, y_normal & red_mask, x_normal & green_mask,
-                            (255 - y_normal) & blue_mask, x_normal + y_normal);
-    }
-  }
-
-  SDL_UnlockSurface(*gradient_surface);
-
-  return 0;
-}
-
 static int GeneratePalettizedSurface(uint8_t **ret, uint32_t width, uint32_t height, uint32_t depth,
                                      TestHost::PaletteSize palette_size) {
   *ret = new uint8_t[width * height * depth];
@@ -271,21 +229,3 @@ static int GeneratePalettizedSurface(uint8_t **ret, uint32_t width, uint32_t hei
 
   return 0;
 }
-
-static uint32_t *GeneratePalette(TestHost::PaletteSize size) {
-  auto ret = new uint32_t[size];
-
-  uint32_t block_size = size / 4;
-  auto component_inc = (uint32_t)ceilf(255.0f / (float)block_size);
-  uint32_t i = 0;
-  uint32_t component = 0;
-  for (; i < block_size; ++i, component += component_inc) {
-    uint32_t color_value = 0xFF - component;
-    ret[i + block_size * 0] = 0xFF000000 + color_value;
-    ret[i + block_size * 1] = 0xFF000000 + (color_value << 8);
-    ret[i + block_size * 2] = 0xFF000000 + (color_value << 16);
-    ret[i + block_size * 3] = 0xFF000000 + color_value + (color_value << 8) + (color_value << 16);
-  }
-
-  return ret;
-}
\ No newline at end of file
@@ -14,6 +14,7 @@ class VolumeTextureTests : public TestSuite {
   VolumeTextureTests(TestHost &host, std::string output_dir);
 
   void Initialize() override;
+  void Deinitialize() override;
 
  private:
   void CreateGeometry();
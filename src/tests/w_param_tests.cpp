@@ -160,7 +160,7 @@ void WParamTests::TestWGaps() {
   pb_printat(15, 28, (char*)"-0.9,0");
   pb_printat(1, 33, (char*)"-10.9,10");
   pb_printat(15, 39, (char*)"inf,inf");
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, kTestWGaps);
 }
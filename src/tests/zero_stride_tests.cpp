@@ -109,7 +109,7 @@ void ZeroStrideTests::Test(DrawMode draw_mode) {
 
   std::string name = MakeTestName(draw_mode);
   pb_print("%s\n", name.c_str());
-  pb_draw_text_screen();
+  host_.DrawTextScreen();
 
   host_.FinishDraw(allow_saving_, output_dir_, name);
 }
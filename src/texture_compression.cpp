@@ -0,0 +1,373 @@
+#include "texture_compression.h"
+
+#include <pbkit/pbkit.h>
+
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <utility>
+
+#include "hash_manifest.h"
+
+// Maximum number of encoded images retained by GetCompressedSurface.
+static constexpr uint32_t kMaxCachedImages = 32;
+
+typedef uint8_t Block[16][4];
+
+static inline uint16_t PackRGB565(int r, int g, int b) {
+  return static_cast<uint16_t>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+static inline void UnpackRGB565(uint16_t color, int *rgb) {
+  int r = (color >> 11) & 0x1F;
+  int g = (color >> 5) & 0x3F;
+  int b = color & 0x1F;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+static inline int Clamp255(int value) { return value < 0 ? 0 : (value > 255 ? 255 : value); }
+
+static inline void Write16(uint8_t *dest, uint16_t value) {
+  dest[0] = value & 0xFF;
+  dest[1] = value >> 8;
+}
+
+static inline void Write32(uint8_t *dest, uint32_t value) {
+  dest[0] = value & 0xFF;
+  dest[1] = (value >> 8) & 0xFF;
+  dest[2] = (value >> 16) & 0xFF;
+  dest[3] = value >> 24;
+}
+
+// Copies the 4x4 block at (block_x, block_y) out of an RGBA32 surface, clamping at the right and bottom edges.
+static void FetchBlock(const SDL_Surface *surface, uint32_t block_x, uint32_t block_y, Block &block) {
+  auto pixels = static_cast<const uint8_t *>(surface->pixels);
+  for (uint32_t y = 0; y < 4; ++y) {
+    uint32_t source_y = block_y * 4 + y;
+    if (source_y >= static_cast<uint32_t>(surface->h)) {
+      source_y = surface->h - 1;
+    }
+    const uint8_t *row = pixels + source_y * surface->pitch;
+
+    for (uint32_t x = 0; x < 4; ++x) {
+      uint32_t source_x = block_x * 4 + x;
+      if (source_x >= static_cast<uint32_t>(surface->w)) {
+        source_x = surface->w - 1;
+      }
+      memcpy(block[y * 4 + x], row + source_x * 4, 4);
+    }
+  }
+}
+
+// Builds the 4 entry palette for the given endpoints. If `three_color` is set, entry 2 is the midpoint and entry 3 is
+// transparent black.
+static void BuildColorPalette(uint16_t c0, uint16_t c1, bool three_color, int palette[4][3]) {
+  UnpackRGB565(c0, palette[0]);
+  UnpackRGB565(c1, palette[1]);
+  for (auto i = 0; i < 3; ++i) {
+    if (three_color) {
+      palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+      palette[3][i] = 0;
+    } else {
+      palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+      palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+    }
+  }
+}
+
+// Selects the nearest palette entry for each pixel, returning the total squared error.
+static uint32_t SelectColorIndices(const Block &block, const int palette[4][3], const bool *transparent,
+                                   bool three_color, uint32_t &indices) {
+  indices = 0;
+  uint32_t total_error = 0;
+  const uint32_t num_entries = three_color ? 3 : 4;
+  for (auto i = 0; i < 16; ++i) {
+    if (transparent && transparent[i]) {
+      indices |= 3U << (i * 2);
+      continue;
+    }
+
+    uint32_t best = 0;
+    uint32_t best_error = 0xFFFFFFFF;
+    for (uint32_t entry = 0; entry < num_entries; ++entry) {
+      int dr = block[i][0] - palette[entry][0];
+      int dg = block[i][1] - palette[entry][1];
+      int db = block[i][2] - palette[entry][2];
+      uint32_t error = dr * dr + dg * dg + db * db;
+      if (error < best_error) {
+        best_error = error;
+        best = entry;
+      }
+    }
+    indices |= best << (i * 2);
+    total_error += best_error;
+  }
+  return total_error;
+}
+
+// Solves for the endpoints that minimize the squared error of a 4 color block given its current indices.
+static bool RefineEndpoints(const Block &block, uint32_t indices, uint16_t &c0, uint16_t &c1) {
+  static constexpr float kWeights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+
+  float aa = 0.0f;
+  float bb = 0.0f;
+  float ab = 0.0f;
+  float ax[3] = {0.0f, 0.0f, 0.0f};
+  float bx[3] = {0.0f, 0.0f, 0.0f};
+  for (auto i = 0; i < 16; ++i) {
+    const float a = kWeights[(indices >> (i * 2)) & 3];
+    const float b = 1.0f - a;
+    aa += a * a;
+    bb += b * b;
+    ab += a * b;
+    for (auto channel = 0; channel < 3; ++channel) {
+      ax[channel] += a * block[i][channel];
+      bx[channel] += b * block[i][channel];
+    }
+  }
+
+  const float determinant = aa * bb - ab * ab;
+  if (determinant == 0.0f) {
+    return false;
+  }
+
+  int endpoint0[3];
+  int endpoint1[3];
+  const float inverse = 1.0f / determinant;
+  for (auto channel = 0; channel < 3; ++channel) {
+    endpoint0[channel] = Clamp255(static_cast<int>((ax[channel] * bb - bx[channel] * ab) * inverse + 0.5f));
+    endpoint1[channel] = Clamp255(static_cast<int>((bx[channel] * aa - ax[channel] * ab) * inverse + 0.5f));
+  }
+
+  c0 = PackRGB565(endpoint0[0], endpoint0[1], endpoint0[2]);
+  c1 = PackRGB565(endpoint1[0], endpoint1[1], endpoint1[2]);
+  return true;
+}
+
+// Encodes the color portion of a block. If `allow_transparent` is set (DXT1), pixels with alpha < 128 select the
+// transparent entry of a 3 color block.
+static void EncodeColorBlock(const Block &block, CompressionQuality quality, bool allow_transparent, uint8_t *dest) {
+  bool transparent[16];
+  bool any_transparent = false;
+  int min_color[3] = {255, 255, 255};
+  int max_color[3] = {0, 0, 0};
+  for (auto i = 0; i < 16; ++i) {
+    transparent[i] = allow_transparent && block[i][3] < 128;
+    if (transparent[i]) {
+      any_transparent = true;
+      continue;
+    }
+    for (auto channel = 0; channel < 3; ++channel) {
+      if (block[i][channel] < min_color[channel]) {
+        min_color[channel] = block[i][channel];
+      }
+      if (block[i][channel] > max_color[channel]) {
+        max_color[channel] = block[i][channel];
+      }
+    }
+  }
+
+  if (min_color[0] > max_color[0]) {
+    // Every pixel is transparent.
+    Write16(dest, 0);
+    Write16(dest + 2, 0);
+    Write32(dest + 4, 0xFFFFFFFF);
+    return;
+  }
+
+  // Inset the bounding box slightly, the extreme colors are rarely worth representing exactly.
+  for (auto channel = 0; channel < 3; ++channel) {
+    const int inset = (max_color[channel] - min_color[channel]) >> 4;
+    min_color[channel] += inset;
+    max_color[channel] -= inset;
+  }
+
+  uint16_t c0 = PackRGB565(max_color[0], max_color[1], max_color[2]);
+  uint16_t c1 = PackRGB565(min_color[0], min_color[1], min_color[2]);
+
+  // The endpoint order selects the block mode: c0 > c1 gives 4 colors, c0 <= c1 gives 3 colors plus transparency.
+  const bool three_color = any_transparent;
+  if (three_color ? c0 > c1 : c0 < c1) {
+    std::swap(c0, c1);
+  }
+
+  int palette[4][3];
+  uint32_t indices;
+  BuildColorPalette(c0, c1, three_color || c0 == c1, palette);
+  uint32_t error = SelectColorIndices(block, palette, transparent, three_color || c0 == c1, indices);
+
+  if (quality == COMPRESSION_HIGH && !three_color) {
+    for (auto iteration = 0; iteration < 2 && error; ++iteration) {
+      uint16_t refined0 = c0;
+      uint16_t refined1 = c1;
+      if (!RefineEndpoints(block, indices, refined0, refined1)) {
+        break;
+      }
+      if (refined0 < refined1) {
+        std::swap(refined0, refined1);
+      }
+      if (refined0 == refined1) {
+        break;
+      }
+
+      int refined_palette[4][3];
+      uint32_t refined_indices;
+      BuildColorPalette(refined0, refined1, false, refined_palette);
+      uint32_t refined_error = SelectColorIndices(block, refined_palette, nullptr, false, refined_indices);
+      if (refined_error >= error) {
+        break;
+      }
+      c0 = refined0;
+      c1 = refined1;
+      indices = refined_indices;
+      error = refined_error;
+    }
+  }
+
+  Write16(dest, c0);
+  Write16(dest + 2, c1);
+  Write32(dest + 4, indices);
+}
+
+static void EncodeExplicitAlphaBlock(const Block &block, uint8_t *dest) {
+  for (auto i = 0; i < 16; i += 2) {
+    const uint8_t low = (block[i][3] * 15 + 127) / 255;
+    const uint8_t high = (block[i + 1][3] * 15 + 127) / 255;
+    dest[i / 2] = low | (high << 4);
+  }
+}
+
+static void EncodeInterpolatedAlphaBlock(const Block &block, uint8_t *dest) {
+  uint8_t a0 = 0;
+  uint8_t a1 = 255;
+  for (auto i = 0; i < 16; ++i) {
+    if (block[i][3] > a0) {
+      a0 = block[i][3];
+    }
+    if (block[i][3] < a1) {
+      a1 = block[i][3];
+    }
+  }
+
+  dest[0] = a0;
+  dest[1] = a1;
+
+  // With a0 > a1 the palette is a0, a1, followed by six evenly spaced interpolants.
+  int palette[8] = {a0, a1};
+  for (auto i = 1; i < 7; ++i) {
+    palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+  }
+
+  uint64_t indices = 0;
+  if (a0 != a1) {
+    for (auto i = 0; i < 16; ++i) {
+      uint32_t best = 0;
+      int best_error = 256;
+      for (uint32_t entry = 0; entry < 8; ++entry) {
+        int error = block[i][3] - palette[entry];
+        if (error < 0) {
+          error = -error;
+        }
+        if (error < best_error) {
+          best_error = error;
+          best = entry;
+        }
+      }
+      indices |= static_cast<uint64_t>(best) << (i * 3);
+    }
+  }
+
+  for (auto i = 0; i < 6; ++i) {
+    dest[2 + i] = (indices >> (i * 8)) & 0xFF;
+  }
+}
+
+bool IsCompressedTextureFormat(uint32_t xbox_format) {
+  switch (xbox_format) {
+    case NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT1_A1R5G5B5:
+    case NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT23_A8R8G8B8:
+    case NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT45_A8R8G8B8:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+uint32_t GetCompressedImageSize(uint32_t xbox_format, uint32_t width, uint32_t height) {
+  const uint32_t block_size = xbox_format == NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT1_A1R5G5B5 ? 8 : 16;
+  return ((width + 3) / 4) * ((height + 3) / 4) * block_size;
+}
+
+bool CompressSurface(const SDL_Surface *surface, uint32_t xbox_format, CompressionQuality quality,
+                     std::vector<uint8_t> &output) {
+  if (!IsCompressedTextureFormat(xbox_format)) {
+    return false;
+  }
+
+  SDL_Surface *rgba = SDL_ConvertSurfaceFormat(const_cast<SDL_Surface *>(surface), SDL_PIXELFORMAT_RGBA32, 0);
+  if (!rgba) {
+    return false;
+  }
+
+  output.resize(GetCompressedImageSize(xbox_format, surface->w, surface->h));
+  uint8_t *dest = output.data();
+
+  const uint32_t blocks_wide = (surface->w + 3) / 4;
+  const uint32_t blocks_high = (surface->h + 3) / 4;
+  Block block;
+  for (uint32_t block_y = 0; block_y < blocks_high; ++block_y) {
+    for (uint32_t block_x = 0; block_x < blocks_wide; ++block_x) {
+      FetchBlock(rgba, block_x, block_y, block);
+
+      switch (xbox_format) {
+        case NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT1_A1R5G5B5:
+          EncodeColorBlock(block, quality, true, dest);
+          dest += 8;
+          break;
+
+        case NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT23_A8R8G8B8:
+          EncodeExplicitAlphaBlock(block, dest);
+          EncodeColorBlock(block, quality, false, dest + 8);
+          dest += 16;
+          break;
+
+        case NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT45_A8R8G8B8:
+          EncodeInterpolatedAlphaBlock(block, dest);
+          EncodeColorBlock(block, quality, false, dest + 8);
+          dest += 16;
+          break;
+      }
+    }
+  }
+
+  SDL_FreeSurface(rgba);
+  return true;
+}
+
+const std::vector<uint8_t> *GetCompressedSurface(const SDL_Surface *surface, uint32_t xbox_format,
+                                                 CompressionQuality quality) {
+  typedef std::tuple<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t> CacheKey;
+  static std::map<CacheKey, std::vector<uint8_t>> cache;
+
+  uint32_t hash = HashSurface(static_cast<const uint8_t *>(surface->pixels), surface->w, surface->h, surface->pitch,
+                              surface->format->BytesPerPixel);
+  CacheKey key = std::make_tuple(hash, static_cast<uint32_t>(surface->w), static_cast<uint32_t>(surface->h),
+                                 surface->format->format, xbox_format, static_cast<uint32_t>(quality));
+  auto it = cache.find(key);
+  if (it != cache.end()) {
+    return &it->second;
+  }
+
+  if (cache.size() >= kMaxCachedImages) {
+    cache.clear();
+  }
+
+  std::vector<uint8_t> encoded;
+  if (!CompressSurface(surface, xbox_format, quality, encoded)) {
+    return nullptr;
+  }
+  return &cache.emplace(key, std::move(encoded)).first->second;
+}
@@ -0,0 +1,34 @@
+#ifndef NXDK_PGRAPH_TESTS_TEXTURE_COMPRESSION_H
+#define NXDK_PGRAPH_TESTS_TEXTURE_COMPRESSION_H
+
+#include <SDL.h>
+
+#include <cstdint>
+#include <vector>
+
+// S3TC (DXT1/3/5) block encoder for the NV097_SET_TEXTURE_FORMAT_COLOR_L_DXT* formats.
+
+enum CompressionQuality {
+  // Endpoints are taken from the bounding box of each block's colors.
+  COMPRESSION_FAST,
+  // Bounding box endpoints are refined with a least squares fit to the selected indices.
+  COMPRESSION_HIGH,
+};
+
+// Returns true if the given NV097_SET_TEXTURE_FORMAT_COLOR_* format is block compressed.
+bool IsCompressedTextureFormat(uint32_t xbox_format);
+
+// Returns the number of bytes occupied by a single `width` x `height` image in the given compressed format.
+uint32_t GetCompressedImageSize(uint32_t xbox_format, uint32_t width, uint32_t height);
+
+// Encodes `surface` into `output` (which is resized as needed). Dimensions that are not a multiple of 4 are padded by
+// repeating the last row/column. Returns false if `xbox_format` is not a compressed format or conversion failed.
+bool CompressSurface(const SDL_Surface *surface, uint32_t xbox_format, CompressionQuality quality,
+                     std::vector<uint8_t> &output);
+
+// As CompressSurface, but returns a cached encoding if the same image was previously compressed with identical
+// parameters. The returned buffer remains valid until the next call. Returns nullptr on failure.
+const std::vector<uint8_t> *GetCompressedSurface(const SDL_Surface *surface, uint32_t xbox_format,
+                                                 CompressionQuality quality);
+
+#endif  // NXDK_PGRAPH_TESTS_TEXTURE_COMPRESSION_H
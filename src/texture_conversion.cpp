@@ -0,0 +1,194 @@
+#include "texture_conversion.h"
+
+#include <pbkit/pbkit.h>
+
+#include <cstring>
+#include <vector>
+
+#include "debug_output.h"
+#include "nxdk_ext.h"
+
+struct RGBA {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+  uint8_t a;
+};
+
+// Products of every 8-bit channel value with the conversion coefficients. The kernels sum table entries in the same
+// order as the equivalent float expressions, so results are identical to evaluating them directly.
+struct CoefficientTables {
+  // BT.601 studio swing YUV.
+  float y_r[256], y_g[256], y_b[256];
+  float u_r[256], u_g[256], u_b[256];
+  float v_r[256], v_g[256], v_b[256];
+  // Full range luminance.
+  float l_r[256], l_g[256], l_b[256];
+};
+
+static const CoefficientTables &GetTables() {
+  static CoefficientTables tables;
+  static bool initialized = false;
+  if (initialized) {
+    return tables;
+  }
+
+  for (uint32_t i = 0; i < 256; ++i) {
+    auto value = static_cast<float>(i);
+    tables.y_r[i] = 0.257f * value;
+    tables.y_g[i] = 0.504f * value;
+    tables.y_b[i] = 0.098f * value;
+    tables.u_r[i] = 0.148f * value;
+    tables.u_g[i] = 0.291f * value;
+    tables.u_b[i] = 0.439f * value;
+    tables.v_r[i] = 0.439f * value;
+    tables.v_g[i] = 0.368f * value;
+    tables.v_b[i] = 0.071f * value;
+    tables.l_r[i] = 0.299f * value;
+    tables.l_g[i] = 0.587f * value;
+    tables.l_b[i] = 0.114f * value;
+  }
+  initialized = true;
+  return tables;
+}
+
+// Extracts the channels of a row of 32-bit pixels.
+static void UnpackRow(const SDL_PixelFormat *format, const uint32_t *source, uint32_t width, RGBA *out) {
+  // Formats with 8-bit channels can be unpacked with shifts, anything else goes through SDL.
+  if (format->BytesPerPixel != 4 || format->Rloss || format->Gloss || format->Bloss ||
+      (format->Amask && format->Aloss)) {
+    for (uint32_t x = 0; x < width; ++x, ++out) {
+      SDL_GetRGBA(source[x], format, &out->r, &out->g, &out->b, &out->a);
+    }
+    return;
+  }
+
+  const uint32_t r_shift = format->Rshift;
+  const uint32_t g_shift = format->Gshift;
+  const uint32_t b_shift = format->Bshift;
+  const uint32_t a_shift = format->Ashift;
+  const bool has_alpha = format->Amask != 0;
+  for (uint32_t x = 0; x < width; ++x, ++out) {
+    uint32_t pixel = source[x];
+    out->r = static_cast<uint8_t>(pixel >> r_shift);
+    out->g = static_cast<uint8_t>(pixel >> g_shift);
+    out->b = static_cast<uint8_t>(pixel >> b_shift);
+    out->a = has_alpha ? static_cast<uint8_t>(pixel >> a_shift) : 0xFF;
+  }
+}
+
+static inline uint8_t Luma(const CoefficientTables &t, const RGBA &c) {
+  return static_cast<uint8_t>(t.y_r[c.r] + t.y_g[c.g] + t.y_b[c.b] + 16);
+}
+
+static inline uint8_t ChromaU(const CoefficientTables &t, const RGBA &c) {
+  return static_cast<uint8_t>(-t.u_r[c.r] - t.u_g[c.g] + t.u_b[c.b] + 128);
+}
+
+static inline uint8_t ChromaV(const CoefficientTables &t, const RGBA &c) {
+  return static_cast<uint8_t>(t.v_r[c.r] - t.v_g[c.g] - t.v_b[c.b] + 128);
+}
+
+static inline uint8_t Luminance(const CoefficientTables &t, const RGBA &c) {
+  return static_cast<uint8_t>(t.l_r[c.r] + t.l_g[c.g] + t.l_b[c.b]);
+}
+
+// Each kernel converts `width` unpacked pixels into `dest`.
+typedef void (*ConversionKernel)(const CoefficientTables &t, const RGBA *source, uint32_t width, uint8_t *dest);
+
+static void ConvertYUY2(const CoefficientTables &t, const RGBA *source, uint32_t width, uint8_t *dest) {
+  // Chroma is taken from the second pixel of each pair.
+  for (uint32_t x = 0; x + 1 < width; x += 2, source += 2, dest += 4) {
+    dest[0] = Luma(t, source[0]);
+    dest[1] = ChromaU(t, source[1]);
+    dest[2] = Luma(t, source[1]);
+    dest[3] = ChromaV(t, source[1]);
+  }
+}
+
+static void ConvertUYVY(const CoefficientTables &t, const RGBA *source, uint32_t width, uint8_t *dest) {
+  for (uint32_t x = 0; x + 1 < width; x += 2, source += 2, dest += 4) {
+    dest[0] = ChromaU(t, source[1]);
+    dest[1] = Luma(t, source[0]);
+    dest[2] = ChromaV(t, source[1]);
+    dest[3] = Luma(t, source[1]);
+  }
+}
+
+static void ConvertG8B8(const CoefficientTables &, const RGBA *source, uint32_t width, uint8_t *dest) {
+  for (uint32_t x = 0; x < width; ++x, ++source) {
+    *dest++ = source->r;
+    *dest++ = source->b;
+  }
+}
+
+static void ConvertY8(const CoefficientTables &t, const RGBA *source, uint32_t width, uint8_t *dest) {
+  for (uint32_t x = 0; x < width; ++x, ++source) {
+    *dest++ = Luminance(t, *source);
+  }
+}
+
+static void ConvertA8Y8(const CoefficientTables &t, const RGBA *source, uint32_t width, uint8_t *dest) {
+  for (uint32_t x = 0; x < width; ++x, ++source) {
+    *dest++ = Luminance(t, *source);
+    *dest++ = source->a;
+  }
+}
+
+struct ConversionInfo {
+  uint32_t xbox_format;
+  uint32_t bytes_per_pixel;
+  ConversionKernel kernel;
+};
+
+static constexpr ConversionInfo kConversions[] = {
+    {NV097_SET_TEXTURE_FORMAT_COLOR_LC_IMAGE_CR8YB8CB8YA8, 2, ConvertYUY2},
+    {NV097_SET_TEXTURE_FORMAT_COLOR_LC_IMAGE_YB8CR8YA8CB8, 2, ConvertUYVY},
+    {NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_G8B8, 2, ConvertG8B8},
+    {NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_AY8, 1, ConvertY8},
+    {NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_Y8, 1, ConvertY8},
+    {NV097_SET_TEXTURE_FORMAT_COLOR_SZ_AY8, 1, ConvertY8},
+    {NV097_SET_TEXTURE_FORMAT_COLOR_SZ_Y8, 1, ConvertY8},
+    {NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8Y8, 2, ConvertA8Y8},
+};
+
+static const ConversionInfo *FindConversion(uint32_t xbox_format) {
+  for (auto &info : kConversions) {
+    if (info.xbox_format == xbox_format) {
+      return &info;
+    }
+  }
+  return nullptr;
+}
+
+uint32_t GetConvertedBytesPerPixel(uint32_t xbox_format) {
+  auto info = FindConversion(xbox_format);
+  return info ? info->bytes_per_pixel : 0;
+}
+
+bool ConvertSurfaceToTextureFormat(const SDL_Surface *surface, uint32_t xbox_format, uint8_t *dest, uint32_t pitch) {
+  auto info = FindConversion(xbox_format);
+  if (!info) {
+    return false;
+  }
+  ASSERT(surface->format->BytesPerPixel == 4 && "Conversion source must be a 32-bit surface.");
+
+  const auto &tables = GetTables();
+  const auto width = static_cast<uint32_t>(surface->w);
+  const uint32_t row_bytes = width * info->bytes_per_pixel;
+  ASSERT(row_bytes <= pitch && "Destination pitch is too small for the converted texture.");
+
+  std::vector<RGBA> unpacked(width);
+  // Rounded up to a whole number of dwords so that the row can be written out in full dword runs.
+  std::vector<uint32_t> row((row_bytes + 3) / 4);
+  auto row_data = reinterpret_cast<uint8_t *>(row.data());
+
+  auto source = static_cast<const uint8_t *>(surface->pixels);
+  for (int y = 0; y < surface->h; ++y, source += surface->pitch, dest += pitch) {
+    UnpackRow(surface->format, reinterpret_cast<const uint32_t *>(source), width, unpacked.data());
+    info->kernel(tables, unpacked.data(), width, row_data);
+    memcpy(dest, row_data, row_bytes);
+  }
+
+  return true;
+}
@@ -0,0 +1,20 @@
+#ifndef NXDK_PGRAPH_TESTS_TEXTURE_CONVERSION_H
+#define NXDK_PGRAPH_TESTS_TEXTURE_CONVERSION_H
+
+#include <SDL.h>
+
+#include <cstdint>
+
+// Software conversion kernels for texture formats that SDL cannot produce directly (i.e., those with
+// TextureFormatInfo::require_conversion set).
+
+// Returns the number of bytes per texel produced when converting to the given NV097_SET_TEXTURE_FORMAT_COLOR_* format,
+// or 0 if no conversion kernel exists for it.
+uint32_t GetConvertedBytesPerPixel(uint32_t xbox_format);
+
+// Converts the given 32-bit surface to `xbox_format`, writing `surface->h` rows of `pitch` bytes to `dest`.
+// Rows are assembled in a local buffer and written out in whole runs, so `dest` may be write-combined memory.
+// Returns false if no conversion kernel exists for the format.
+bool ConvertSurfaceToTextureFormat(const SDL_Surface *surface, uint32_t xbox_format, uint8_t *dest, uint32_t pitch);
+
+#endif  // NXDK_PGRAPH_TESTS_TEXTURE_CONVERSION_H
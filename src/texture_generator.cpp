@@ -0,0 +1,181 @@
+#include "texture_generator.h"
+
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vector>
+
+enum GeneratorKind {
+  GENERATOR_GRADIENT,
+  GENERATOR_CHECKERBOARD,
+  GENERATOR_NOISE,
+};
+
+// kind, width, height, pixel format, and up to three generator specific parameters.
+typedef std::tuple<uint32_t, int, int, uint32_t, uint32_t, uint32_t, uint32_t> SurfaceKey;
+
+static std::map<SurfaceKey, SDL_Surface *> surfaces;
+static std::map<std::tuple<int, int, uint32_t>, std::vector<uint8_t>> palettized_gradients;
+static std::map<uint32_t, std::vector<uint32_t>> palettes;
+
+// Equivalent to SDL_MapRGBA for non-indexed formats, without the per-texel function call.
+static inline uint32_t MapRGBA(const SDL_PixelFormat *format, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+  return ((r >> format->Rloss) << format->Rshift) | ((g >> format->Gloss) << format->Gshift) |
+         ((b >> format->Bloss) << format->Bshift) | (((a >> format->Aloss) << format->Ashift) & format->Amask);
+}
+
+// Creates a surface in `format`, filling it with the colors returned by `generate(x, y, rgba)`.
+template <typename Generator>
+static SDL_Surface *Generate(int width, int height, uint32_t format, Generator generate) {
+  if (SDL_ISPIXELFORMAT_INDEXED(format)) {
+    return nullptr;
+  }
+
+  SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, SDL_BITSPERPIXEL(format), format);
+  if (!surface) {
+    return nullptr;
+  }
+
+  const SDL_PixelFormat *pixel_format = surface->format;
+  const uint32_t bytes_per_pixel = pixel_format->BytesPerPixel;
+  uint8_t rgba[4];
+
+  for (int y = 0; y < height; ++y) {
+    auto pixel = static_cast<uint8_t *>(surface->pixels) + y * surface->pitch;
+    for (int x = 0; x < width; ++x, pixel += bytes_per_pixel) {
+      generate(x, y, rgba);
+      uint32_t value = MapRGBA(pixel_format, rgba[0], rgba[1], rgba[2], rgba[3]);
+      memcpy(pixel, &value, bytes_per_pixel);
+    }
+  }
+
+  return surface;
+}
+
+template <typename Generator>
+static SDL_Surface *GetSurface(const SurfaceKey &key, Generator generate) {
+  auto it = surfaces.find(key);
+  if (it != surfaces.end()) {
+    return it->second;
+  }
+
+  SDL_Surface *surface = Generate(std::get<1>(key), std::get<2>(key), std::get<3>(key), generate);
+  if (surface) {
+    surfaces[key] = surface;
+  }
+  return surface;
+}
+
+// Returns a generator for GetGradientSurface and CreateGradientSurface.
+static auto MakeGradient(int width, int height, uint32_t rgb_mask) {
+  const uint8_t red_mask = rgb_mask >> 16;
+  const uint8_t green_mask = rgb_mask >> 8;
+  const uint8_t blue_mask = rgb_mask;
+
+  return [=](int x, int y, uint8_t *rgba) {
+    int x_normal = static_cast<int>(static_cast<float>(x) * 255.0f / static_cast<float>(width));
+    int y_normal = static_cast<int>(static_cast<float>(y) * 255.0f / static_cast<float>(height));
+    rgba[0] = y_normal & red_mask;
+    rgba[1] = x_normal & green_mask;
+    rgba[2] = (255 - y_normal) & blue_mask;
+    rgba[3] = static_cast<uint8_t>(x_normal + y_normal);
+  };
+}
+
+SDL_Surface *GetGradientSurface(int width, int height, uint32_t format, uint32_t rgb_mask) {
+  SurfaceKey key{GENERATOR_GRADIENT, width, height, format, rgb_mask, 0, 0};
+  return GetSurface(key, MakeGradient(width, height, rgb_mask));
+}
+
+SDL_Surface *CreateGradientSurface(int width, int height, uint32_t format, uint32_t rgb_mask) {
+  return Generate(width, height, format, MakeGradient(width, height, rgb_mask));
+}
+
+SDL_Surface *GetCheckerboardSurface(int width, int height, uint32_t first_color, uint32_t second_color,
+                                    int checker_size, uint32_t format) {
+  SurfaceKey key{GENERATOR_CHECKERBOARD, width, height, format, first_color, second_color, checker_size};
+  return GetSurface(key, [=](int x, int y, uint8_t *rgba) {
+    uint32_t color = ((x / checker_size) + (y / checker_size)) & 1 ? second_color : first_color;
+    rgba[0] = color >> 16;
+    rgba[1] = color >> 8;
+    rgba[2] = color;
+    rgba[3] = color >> 24;
+  });
+}
+
+SDL_Surface *GetNoiseSurface(int width, int height, uint32_t seed, uint32_t format) {
+  // Texels are generated in raster order, so a simple xorshift stream is sufficient.
+  uint32_t state = seed ? seed : 0x9E3779B9;
+
+  SurfaceKey key{GENERATOR_NOISE, width, height, format, seed, 0, 0};
+  return GetSurface(key, [&state](int, int, uint8_t *rgba) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    rgba[0] = state;
+    rgba[1] = state >> 8;
+    rgba[2] = state >> 16;
+    rgba[3] = 0xFF;
+  });
+}
+
+const uint8_t *GetPalettizedGradient(int width, int height, uint32_t palette_size) {
+  auto key = std::make_tuple(width, height, palette_size);
+  auto it = palettized_gradients.find(key);
+  if (it != palettized_gradients.end()) {
+    return it->second.data();
+  }
+
+  std::vector<uint8_t> &indices = palettized_gradients[key];
+  uint32_t total_size = width * height;
+  uint32_t half_size = total_size >> 1;
+  indices.resize(total_size);
+
+  auto pixel = indices.data();
+  for (uint32_t i = 0; i < half_size; ++i, ++pixel) {
+    *pixel = i & (palette_size - 1);
+  }
+
+  for (uint32_t i = half_size; i < total_size; i += 4) {
+    uint8_t value = i & (palette_size - 1);
+    *pixel++ = value;
+    *pixel++ = value;
+    *pixel++ = value;
+    *pixel++ = value;
+  }
+
+  return indices.data();
+}
+
+const uint32_t *GetGradientPalette(uint32_t palette_size) {
+  auto it = palettes.find(palette_size);
+  if (it != palettes.end()) {
+    return it->second.data();
+  }
+
+  std::vector<uint32_t> &palette = palettes[palette_size];
+  palette.resize(palette_size);
+
+  uint32_t block_size = palette_size / 4;
+  auto component_inc = (uint32_t)ceilf(255.0f / (float)block_size);
+  uint32_t component = 0;
+  for (uint32_t i = 0; i < block_size; ++i, component += component_inc) {
+    uint32_t color_value = 0xFF - component;
+    palette[i + block_size * 0] = 0xFF000000 + color_value;
+    palette[i + block_size * 1] = 0xFF000000 + (color_value << 8);
+    palette[i + block_size * 2] = 0xFF000000 + (color_value << 16);
+    palette[i + block_size * 3] = 0xFF000000 + color_value + (color_value << 8) + (color_value << 16);
+  }
+
+  return palette.data();
+}
+
+void ReleaseGeneratedTextures() {
+  for (auto &entry : surfaces) {
+    SDL_FreeSurface(entry.second);
+  }
+  surfaces.clear();
+  palettized_gradients.clear();
+  palettes.clear();
+}
@@ -0,0 +1,44 @@
+#ifndef NXDK_PGRAPH_TESTS_TEXTURE_GENERATOR_H
+#define NXDK_PGRAPH_TESTS_TEXTURE_GENERATOR_H
+
+#include <SDL.h>
+
+#include <cstdint>
+
+// Procedural source images shared by the texture tests.
+//
+// Results are memoized by their parameters and owned by the generator, so repeated requests (e.g., one per texture
+// format) return the same buffer without allocating or regenerating it. Returned buffers must not be modified or
+// freed by the caller and remain valid until ReleaseGeneratedTextures is called.
+//
+// Surfaces may be requested in any non-indexed SDL pixel format and are written directly in that format, allowing
+// TextureStage to skip SDL conversion when it matches the stage's TextureFormatInfo::sdl_format.
+
+// Returns a `width` x `height` gradient with red increasing along Y, green along X, blue decreasing along Y, and alpha
+// the (8-bit wrapped) sum of the X and Y gradients. `rgb_mask` (0xRRGGBB) is applied to the color channels.
+SDL_Surface *GetGradientSurface(int width, int height, uint32_t format = SDL_PIXELFORMAT_RGBA8888,
+                                uint32_t rgb_mask = 0xFFFFFF);
+// As GetGradientSurface, but returns a new surface that is not memoized and must be freed by the caller.
+SDL_Surface *CreateGradientSurface(int width, int height, uint32_t format = SDL_PIXELFORMAT_RGBA8888,
+                                   uint32_t rgb_mask = 0xFFFFFF);
+
+// Returns a checkerboard of `checker_size` texel squares alternating between the given ARGB colors, starting with
+// `first_color` in the top left.
+SDL_Surface *GetCheckerboardSurface(int width, int height, uint32_t first_color, uint32_t second_color,
+                                    int checker_size, uint32_t format = SDL_PIXELFORMAT_RGBA8888);
+
+// Returns opaque, uniformly distributed RGB noise. The same `seed` always produces the same image.
+SDL_Surface *GetNoiseSurface(int width, int height, uint32_t seed, uint32_t format = SDL_PIXELFORMAT_RGBA8888);
+
+// Returns `width` * `height` 8-bit palette indices. The first half of the image steps through the palette on every
+// texel, the second half every 4 texels.
+const uint8_t *GetPalettizedGradient(int width, int height, uint32_t palette_size);
+
+// Returns a `palette_size` entry ARGB palette made up of four equally sized ramps of blue, green, red, and gray, each
+// decreasing in intensity.
+const uint32_t *GetGradientPalette(uint32_t palette_size);
+
+// Frees all memoized images.
+void ReleaseGeneratedTextures();
+
+#endif  // NXDK_PGRAPH_TESTS_TEXTURE_GENERATOR_H
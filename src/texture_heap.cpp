@@ -0,0 +1,84 @@
+#include "texture_heap.h"
+
+#include <iterator>
+
+#include "debug_output.h"
+
+void TextureHeap::Reset(uint32_t size) {
+  capacity_ = size;
+  bytes_in_use_ = 0;
+  allocations_.clear();
+  free_handles_.clear();
+  free_blocks_.clear();
+  if (size) {
+    free_blocks_[0] = size;
+  }
+}
+
+TextureHeap::Handle TextureHeap::Allocate(uint32_t size, uint32_t alignment) {
+  ASSERT(!(alignment & (alignment - 1)) && "Alignment must be a power of two.");
+  if (!size) {
+    size = 1;
+  }
+
+  for (auto it = free_blocks_.begin(); it != free_blocks_.end(); ++it) {
+    const uint32_t block_offset = it->first;
+    const uint32_t block_end = block_offset + it->second;
+    const uint32_t offset = (block_offset + alignment - 1) & ~(alignment - 1);
+    if (offset >= block_end || block_end - offset < size) {
+      continue;
+    }
+
+    free_blocks_.erase(it);
+    if (offset > block_offset) {
+      free_blocks_[block_offset] = offset - block_offset;
+    }
+    const uint32_t end = offset + size;
+    if (end < block_end) {
+      free_blocks_[end] = block_end - end;
+    }
+
+    Handle handle;
+    if (!free_handles_.empty()) {
+      handle = free_handles_.back();
+      free_handles_.pop_back();
+    } else {
+      handle = static_cast<Handle>(allocations_.size());
+      allocations_.emplace_back();
+    }
+    allocations_[handle] = {offset, size, true};
+    bytes_in_use_ += size;
+    return handle;
+  }
+
+  return kInvalidHandle;
+}
+
+void TextureHeap::Free(Handle handle) {
+  ASSERT(handle < allocations_.size() && allocations_[handle].in_use && "Invalid texture heap handle.");
+  Allocation &allocation = allocations_[handle];
+  allocation.in_use = false;
+  bytes_in_use_ -= allocation.size;
+  free_handles_.push_back(handle);
+
+  uint32_t offset = allocation.offset;
+  uint32_t size = allocation.size;
+
+  // Merge with the following free block, if adjacent.
+  auto next = free_blocks_.lower_bound(offset);
+  if (next != free_blocks_.end() && next->first == offset + size) {
+    size += next->second;
+    next = free_blocks_.erase(next);
+  }
+
+  // Merge with the preceding free block, if adjacent.
+  if (next != free_blocks_.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      prev->second += size;
+      return;
+    }
+  }
+
+  free_blocks_[offset] = size;
+}
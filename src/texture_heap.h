@@ -0,0 +1,51 @@
+#ifndef NXDK_PGRAPH_TESTS_TEXTURE_HEAP_H
+#define NXDK_PGRAPH_TESTS_TEXTURE_HEAP_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Sub-allocator for a contiguous region of texture memory.
+//
+// Only offsets into the region are tracked, the memory itself is owned by the caller. Free space is kept in an
+// offset-ordered list that is coalesced on Free, and allocations are placed first-fit.
+class TextureHeap {
+ public:
+  typedef uint32_t Handle;
+  static constexpr Handle kInvalidHandle = 0xFFFFFFFF;
+
+  // nv2a texture and palette offsets must be 128 byte aligned.
+  static constexpr uint32_t kDefaultAlignment = 128;
+
+ public:
+  // Discards all allocations and makes `size` bytes available.
+  void Reset(uint32_t size);
+
+  // Returns a handle to `size` bytes whose offset is a multiple of `alignment` (which must be a power of two), or
+  // kInvalidHandle if no free block is large enough.
+  Handle Allocate(uint32_t size, uint32_t alignment = kDefaultAlignment);
+  void Free(Handle handle);
+
+  uint32_t GetOffset(Handle handle) const { return allocations_[handle].offset; }
+  uint32_t GetSize(Handle handle) const { return allocations_[handle].size; }
+
+  uint32_t GetCapacity() const { return capacity_; }
+  uint32_t GetBytesInUse() const { return bytes_in_use_; }
+
+ private:
+  struct Allocation {
+    uint32_t offset;
+    uint32_t size;
+    bool in_use;
+  };
+
+  uint32_t capacity_{0};
+  uint32_t bytes_in_use_{0};
+
+  std::vector<Allocation> allocations_;
+  std::vector<Handle> free_handles_;
+  // Maps the offset of each free block to its size.
+  std::map<uint32_t, uint32_t> free_blocks_;
+};
+
+#endif  // NXDK_PGRAPH_TESTS_TEXTURE_HEAP_H
@@ -0,0 +1,107 @@
+#include "texture_mipmaps.h"
+
+#include <cmath>
+
+static constexpr float kGamma = 2.2f;
+
+struct GammaTables {
+  float to_linear[256];
+};
+
+static const GammaTables &GetGammaTables() {
+  static GammaTables tables;
+  static bool initialized = false;
+  if (!initialized) {
+    for (auto i = 0; i < 256; ++i) {
+      tables.to_linear[i] = powf(static_cast<float>(i) / 255.0f, kGamma);
+    }
+    initialized = true;
+  }
+  return tables;
+}
+
+static inline uint8_t FromLinear(float value) {
+  return static_cast<uint8_t>(powf(value, 1.0f / kGamma) * 255.0f + 0.5f);
+}
+
+uint32_t GetFullMipMapLevels(uint32_t width, uint32_t height) {
+  uint32_t levels = 1;
+  while ((width > 1 || height > 1) && levels < kMaxMipMapLevels) {
+    width = width > 1 ? width >> 1 : 1;
+    height = height > 1 ? height >> 1 : 1;
+    ++levels;
+  }
+  return levels;
+}
+
+// Box filters `source` into `dest`, which must be half its size in each dimension that is larger than 1.
+static void Downsample(const SDL_Surface *source, SDL_Surface *dest, bool gamma_correct) {
+  const uint32_t step_x = source->w > 1 ? 2 : 1;
+  const uint32_t step_y = source->h > 1 ? 2 : 1;
+  const auto &tables = GetGammaTables();
+
+  for (auto y = 0; y < dest->h; ++y) {
+    auto row0 = static_cast<const uint8_t *>(source->pixels) + (y * step_y) * source->pitch;
+    auto row1 = row0 + (step_y - 1) * source->pitch;
+    auto out = static_cast<uint8_t *>(dest->pixels) + y * dest->pitch;
+
+    for (auto x = 0; x < dest->w; ++x, row0 += step_x * 4, row1 += step_x * 4, out += 4) {
+      // Dimensions that have already been reduced to 1 reuse the same sample twice.
+      const uint8_t *samples[4] = {row0, row0 + (step_x - 1) * 4, row1, row1 + (step_x - 1) * 4};
+
+      // ARGB8888 is stored as B, G, R, A in memory.
+      for (auto channel = 0; channel < 4; ++channel) {
+        if (gamma_correct && channel != 3) {
+          float sum = 0.0f;
+          for (auto i = 0; i < 4; ++i) {
+            sum += tables.to_linear[samples[i][channel]];
+          }
+          out[channel] = FromLinear(sum * 0.25f);
+        } else {
+          uint32_t sum = 0;
+          for (auto i = 0; i < 4; ++i) {
+            sum += samples[i][channel];
+          }
+          out[channel] = static_cast<uint8_t>((sum + 2) >> 2);
+        }
+      }
+    }
+  }
+}
+
+bool GenerateMipMapChain(const SDL_Surface *source, uint32_t levels, bool gamma_correct,
+                         std::vector<SDL_Surface *> &chain) {
+  const uint32_t full_levels = GetFullMipMapLevels(source->w, source->h);
+  if (!levels || levels > full_levels) {
+    levels = full_levels;
+  }
+
+  SDL_Surface *base = SDL_ConvertSurfaceFormat(const_cast<SDL_Surface *>(source), SDL_PIXELFORMAT_ARGB8888, 0);
+  if (!base) {
+    return false;
+  }
+
+  std::vector<SDL_Surface *> generated;
+  generated.reserve(levels);
+  generated.push_back(base);
+
+  for (uint32_t i = 1; i < levels; ++i) {
+    const SDL_Surface *previous = generated.back();
+    const int width = previous->w > 1 ? previous->w >> 1 : 1;
+    const int height = previous->h > 1 ? previous->h >> 1 : 1;
+
+    SDL_Surface *level = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!level) {
+      for (auto surface : generated) {
+        SDL_FreeSurface(surface);
+      }
+      return false;
+    }
+
+    Downsample(previous, level, gamma_correct);
+    generated.push_back(level);
+  }
+
+  chain.insert(chain.end(), generated.begin(), generated.end());
+  return true;
+}
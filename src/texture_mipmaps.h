@@ -0,0 +1,24 @@
+#ifndef NXDK_PGRAPH_TESTS_TEXTURE_MIPMAPS_H
+#define NXDK_PGRAPH_TESTS_TEXTURE_MIPMAPS_H
+
+#include <SDL.h>
+
+#include <cstdint>
+#include <vector>
+
+// The nv2a supports at most this many mipmap levels (NV097_SET_TEXTURE_FORMAT_MIPMAP_LEVELS is a 4-bit field).
+static constexpr uint32_t kMaxMipMapLevels = 15;
+
+// Returns the number of levels in a complete mipmap chain for the given base level dimensions.
+uint32_t GetFullMipMapLevels(uint32_t width, uint32_t height);
+
+// Appends `levels` ARGB8888 surfaces to `chain`, starting with a copy of `source` and followed by successively
+// halved, 2x2 box filtered levels. If `levels` is 0 the complete chain is generated. When `gamma_correct` is set,
+// color channels are averaged in linear space (assuming a 2.2 gamma source), alpha is always averaged directly.
+//
+// The caller takes ownership of the surfaces and must release them with SDL_FreeSurface. Returns false on failure, in
+// which case `chain` is left unmodified.
+bool GenerateMipMapChain(const SDL_Surface *source, uint32_t levels, bool gamma_correct,
+                         std::vector<SDL_Surface *> &chain);
+
+#endif  // NXDK_PGRAPH_TESTS_TEXTURE_MIPMAPS_H
@@ -1,9 +1,11 @@
 #include "texture_stage.h"
 
+#include "command_recorder.h"
 #include "debug_output.h"
 #include "nxdk_ext.h"
 #include "pbkit_ext.h"
-#include "swizzle.h"
+#include "texture_conversion.h"
+#include "texture_swizzle.h"
 
 // bitscan forward
 static int bsf(int val) { __asm bsf eax, val }
@@ -13,12 +15,12 @@ bool TextureStage::RequiresColorspaceConversion() const {
          format_.xbox_format == NV097_SET_TEXTURE_FORMAT_COLOR_LC_IMAGE_YB8CR8YA8CB8;
 }
 
-void TextureStage::Commit(uint32_t memory_dma_offset, uint32_t palette_dma_offset) const {
+void TextureStage::Commit(uint32_t memory_dma_offset, uint32_t palette_dma_offset, RegisterShadow &shadow) const {
   if (!enabled_) {
-    auto p = pb_begin();
+    auto p = CommandRecorder::Begin();
     // NV097_SET_TEXTURE_CONTROL0
-    p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_ENABLE(stage_), false);
-    pb_end(p);
+    p = shadow.Push(p, NV20_TCL_PRIMITIVE_3D_TX_ENABLE(stage_), false);
+    CommandRecorder::End(p);
     return;
   }
 
@@ -27,13 +29,13 @@ void TextureStage::Commit(uint32_t memory_dma_offset, uint32_t palette_dma_offse
     ASSERT(!"No texture format specified. This will cause an invalid pgraph state exception and a crash.");
   }
 
-  auto p = pb_begin();
+  auto p = CommandRecorder::Begin();
   // NV097_SET_TEXTURE_CONTROL0
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_ENABLE(stage_),
-               NV097_SET_TEXTURE_CONTROL0_ENABLE |
-                   MASK(NV097_SET_TEXTURE_CONTROL0_ALPHA_KILL_ENABLE, alpha_kill_enable_) |
-                   MASK(NV097_SET_TEXTURE_CONTROL0_MIN_LOD_CLAMP, lod_min_) |
-                   MASK(NV097_SET_TEXTURE_CONTROL0_MAX_LOD_CLAMP, lod_max_));
+  p = shadow.Push(p, NV20_TCL_PRIMITIVE_3D_TX_ENABLE(stage_),
+                  NV097_SET_TEXTURE_CONTROL0_ENABLE |
+                      MASK(NV097_SET_TEXTURE_CONTROL0_ALPHA_KILL_ENABLE, alpha_kill_enable_) |
+                      MASK(NV097_SET_TEXTURE_CONTROL0_MIN_LOD_CLAMP, lod_min_) |
+                      MASK(NV097_SET_TEXTURE_CONTROL0_MAX_LOD_CLAMP, lod_max_));
 
   uint32_t dimensionality = GetDimensionality();
 
@@ -60,15 +62,16 @@ void TextureStage::Commit(uint32_t memory_dma_offset, uint32_t palette_dma_offse
   uint32_t offset = reinterpret_cast<uint32_t>(memory_dma_offset) + texture_memory_offset_;
   uint32_t texture_addr = offset & 0x03ffffff;
   // NV097_SET_TEXTURE_OFFSET
-  p = pb_push2(p, NV20_TCL_PRIMITIVE_3D_TX_OFFSET(stage_), texture_addr, format);
+  const uint32_t offset_and_format[] = {texture_addr, format};
+  p = shadow.Push(p, NV20_TCL_PRIMITIVE_3D_TX_OFFSET(stage_), offset_and_format, 2);
 
   uint32_t pitch_param = (format_.xbox_bpp * width_) << 16;
   // NV097_SET_TEXTURE_CONTROL1
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_NPOT_PITCH(stage_), pitch_param);
+  p = shadow.Push(p, NV20_TCL_PRIMITIVE_3D_TX_NPOT_PITCH(stage_), pitch_param);
 
   uint32_t size_param = (width_ << 16) | (height_ & 0xFFFF);
   // NV097_SET_TEXTURE_IMAGE_RECT
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_NPOT_SIZE(stage_), size_param);
+  p = shadow.Push(p, NV20_TCL_PRIMITIVE_3D_TX_NPOT_SIZE(stage_), size_param);
 
   // NV097_SET_TEXTURE_ADDRESS
   uint32_t texture_address = MASK(NV097_SET_TEXTURE_ADDRESS_U, wrap_modes_[0]) |
@@ -78,12 +81,13 @@ void TextureStage::Commit(uint32_t memory_dma_offset, uint32_t palette_dma_offse
                              MASK(NV097_SET_TEXTURE_ADDRESS_P, wrap_modes_[2]) |
                              MASK(NV097_SET_TEXTURE_ADDRESS_CYLINDERWRAP_P, cylinder_wrap_[2]) |
                              MASK(NV097_SET_TEXTURE_ADDRESS_CYLINDERWRAP_Q, cylinder_wrap_[3]);
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_WRAP(stage_), texture_address);
+  p = shadow.Push(p, NV20_TCL_PRIMITIVE_3D_TX_WRAP(stage_), texture_address);
 
   // NV097_SET_TEXTURE_FILTER
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_FILTER(stage_), texture_filter_);
+  p = shadow.Push(p, NV20_TCL_PRIMITIVE_3D_TX_FILTER(stage_), texture_filter_);
 
-  p = pb_push4(p, NV097_SET_TEXTURE_MATRIX_ENABLE, 0, 0, 0, 0);
+  static constexpr uint32_t kTextureMatrixDisabled[] = {0, 0, 0, 0};
+  p = shadow.Push(p, NV097_SET_TEXTURE_MATRIX_ENABLE, kTextureMatrixDisabled, 4);
 
   uint32_t palette_config = 0;
   if (format_.xbox_format == NV097_SET_TEXTURE_FORMAT_COLOR_SZ_I8_A8R8G8B8) {
@@ -95,16 +99,15 @@ void TextureStage::Commit(uint32_t memory_dma_offset, uint32_t palette_dma_offse
   }
 
   // NV097_SET_TEXTURE_PALETTE
-  p = pb_push1(p, NV20_TCL_PRIMITIVE_3D_TX_PALETTE_OFFSET(stage_), palette_config);
+  p = shadow.Push(p, NV20_TCL_PRIMITIVE_3D_TX_PALETTE_OFFSET(stage_), palette_config);
 
-  p = pb_push1(p, NV097_SET_TEXTURE_BORDER_COLOR, border_color_);
+  p = shadow.Push(p, NV097_SET_TEXTURE_BORDER_COLOR, border_color_);
 
-  p = pb_push4f(p, NV097_SET_TEXTURE_SET_BUMP_ENV_MAT, bump_env_material[0], bump_env_material[1], bump_env_material[2],
-                bump_env_material[3]);
-  p = pb_push1f(p, NV097_SET_TEXTURE_SET_BUMP_ENV_SCALE, bump_env_scale);
-  p = pb_push1f(p, NV097_SET_TEXTURE_SET_BUMP_ENV_OFFSET, bump_env_offset);
+  p = shadow.PushF(p, NV097_SET_TEXTURE_SET_BUMP_ENV_MAT, bump_env_material, 4);
+  p = shadow.PushF(p, NV097_SET_TEXTURE_SET_BUMP_ENV_SCALE, bump_env_scale);
+  p = shadow.PushF(p, NV097_SET_TEXTURE_SET_BUMP_ENV_OFFSET, bump_env_offset);
 
-  pb_end(p);
+  CommandRecorder::End(p);
 }
 
 void TextureStage::SetFilter(uint32_t lod_bias, TextureStage::ConvolutionKernel kernel, TextureStage::MinFilter min,
@@ -119,127 +122,68 @@ void TextureStage::SetFilter(uint32_t lod_bias, TextureStage::ConvolutionKernel
 }
 
 int TextureStage::SetTexture(const SDL_Surface *surface, uint8_t *memory_base) const {
-  auto pixels = static_cast<uint32_t *>(surface->pixels);
+  return UploadSurface(surface, memory_base + texture_memory_offset_);
+}
+
+int TextureStage::SetMipMappedTexture(const SDL_Surface *const *levels, uint32_t num_levels,
+                                      uint8_t *memory_base) const {
+  ASSERT(format_.xbox_swizzled && "Mipmapped textures using linear formats are not supported by XBOX.");
+
+  // Levels are packed back to back, each swizzled independently.
+  uint8_t *dest = memory_base + texture_memory_offset_;
+  for (uint32_t i = 0; i < num_levels; ++i) {
+    int ret = UploadSurface(levels[i], dest);
+    if (ret) {
+      return ret;
+    }
+    dest += GetImageSize(levels[i]->w, levels[i]->h);
+  }
+
+  return 0;
+}
+
+uint32_t TextureStage::GetImageSize(uint32_t width, uint32_t height) const {
+  if (IsCompressedTextureFormat(format_.xbox_format)) {
+    return GetCompressedImageSize(format_.xbox_format, width, height);
+  }
+  return width * height * format_.xbox_bpp;
+}
+
+int TextureStage::UploadSurface(const SDL_Surface *surface, uint8_t *dest) const {
+  if (IsCompressedTextureFormat(format_.xbox_format)) {
+    auto blocks = GetCompressedSurface(surface, format_.xbox_format, compression_quality_);
+    if (!blocks) {
+      return 3;
+    }
+    memcpy(dest, blocks->data(), blocks->size());
+    return 0;
+  }
 
   // if conversion required, do so, otherwise use SDL to convert
   if (format_.require_conversion) {
-    uint8_t *dest = memory_base + texture_memory_offset_;
-
-    // Buffer for formats that need to be swizzled after conversion.
-    uint32_t swizzle_w = surface->w;
-    uint32_t swizzle_h = surface->h;
-    uint32_t swizzle_depth = 1;
-    uint32_t swizzle_pitch = surface->pitch;
-    uint32_t swizzle_bpp = surface->format->BytesPerPixel;
-    uint8_t *converted = nullptr;
-
-    // TODO: potential reference material -
-    // https://github.com/scalablecory/colors/blob/master/color.c
-    switch (format_.xbox_format) {
-      case NV097_SET_TEXTURE_FORMAT_COLOR_LC_IMAGE_CR8YB8CB8YA8:  // YUY2 aka
-                                                                  // YUYV
-      {
-        uint32_t *source = pixels;
-        for (int y = 0; y < surface->h; ++y) {
-          for (int x = 0; x < surface->w; x += 2, source += 2) {
-            uint8_t R0, G0, B0, R1, G1, B1;
-            SDL_GetRGB(source[0], surface->format, &R0, &G0, &B0);
-            SDL_GetRGB(source[1], surface->format, &R1, &G1, &B1);
-            dest[0] = (0.257f * R0) + (0.504f * G0) + (0.098f * B0) + 16;    // Y0
-            dest[1] = -(0.148f * R1) - (0.291f * G1) + (0.439f * B1) + 128;  // U
-            dest[2] = (0.257f * R1) + (0.504f * G1) + (0.098f * B1) + 16;    // Y1
-            dest[3] = (0.439f * R1) - (0.368f * G1) - (0.071f * B1) + 128;   // V
-            dest += 4;
-          }
-        }
-      } break;
-
-      case NV097_SET_TEXTURE_FORMAT_COLOR_LC_IMAGE_YB8CR8YA8CB8:  // UYVY
-      {
-        uint32_t *source = pixels;
-        for (int y = 0; y < surface->h; ++y) {
-          for (int x = 0; x < surface->w; x += 2, source += 2) {
-            uint8_t R0, G0, B0, R1, G1, B1;
-            SDL_GetRGB(source[0], surface->format, &R0, &G0, &B0);
-            SDL_GetRGB(source[1], surface->format, &R1, &G1, &B1);
-            dest[0] = -(0.148f * R1) - (0.291f * G1) + (0.439f * B1) + 128;  // U
-            dest[1] = (0.257f * R0) + (0.504f * G0) + (0.098f * B0) + 16;    // Y0
-            dest[2] = (0.439f * R1) - (0.368f * G1) - (0.071f * B1) + 128;   // V
-            dest[3] = (0.257f * R1) + (0.504f * G1) + (0.098f * B1) + 16;    // Y1
-            dest += 4;
-          }
-        }
-      } break;
-
-      case NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_G8B8: {
-        uint32_t *source = pixels;
-        for (int y = 0; y < surface->h; ++y) {
-          for (int x = 0; x < surface->w; ++x, ++source) {
-            uint8_t red, green, blue, alpha;
-            SDL_GetRGBA(*source, surface->format, &red, &green, &blue, &alpha);
-            *dest++ = red + (green << 8);
-            *dest++ = blue + (alpha << 8);
-          }
-        }
-      } break;
-
-      case NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_AY8:
-      case NV097_SET_TEXTURE_FORMAT_COLOR_LU_IMAGE_Y8: {
-        uint32_t *source = pixels;
-        for (int y = 0; y < surface->h; ++y) {
-          for (int x = 0; x < surface->w; ++x, ++source) {
-            uint8_t red, green, blue;
-            SDL_GetRGB(source[0], surface->format, &red, &green, &blue);
-            *dest++ = static_cast<uint8_t>(0.299f * red + 0.587f * green + 0.114f * blue);
-          }
-        }
-      } break;
-
-      case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_AY8:
-      case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_Y8: {
-        uint32_t *source = pixels;
-        swizzle_bpp = 1;
-        swizzle_pitch = swizzle_w * swizzle_bpp;
-        converted = new uint8_t[swizzle_pitch * swizzle_h * swizzle_depth];
-        dest = converted;
-
-        for (int y = 0; y < surface->h; ++y) {
-          for (int x = 0; x < surface->w; ++x, ++source) {
-            uint8_t red, green, blue;
-            SDL_GetRGB(source[0], surface->format, &red, &green, &blue);
-            *dest++ = static_cast<uint8_t>(0.299f * red + 0.587f * green + 0.114f * blue);
-          }
-        }
-      } break;
-
-      case NV097_SET_TEXTURE_FORMAT_COLOR_SZ_A8Y8: {
-        uint32_t *source = pixels;
-        swizzle_bpp = 2;
-        swizzle_pitch = swizzle_w * swizzle_bpp;
-        converted = new uint8_t[swizzle_pitch * swizzle_h * swizzle_depth];
-        dest = converted;
-
-        for (int y = 0; y < surface->h; ++y) {
-          for (int x = 0; x < surface->w; ++x, ++source) {
-            uint8_t red, green, blue, alpha;
-            SDL_GetRGBA(*source, surface->format, &red, &green, &blue, &alpha);
-            *dest++ = static_cast<uint8_t>(0.299f * red + 0.587f * green + 0.114f * blue);
-            *dest++ = alpha;
-          }
-        }
-      } break;
-
-      default:
-        return 3;
+    uint32_t bytes_per_pixel = GetConvertedBytesPerPixel(format_.xbox_format);
+    if (!bytes_per_pixel) {
+      return 3;
     }
+    uint32_t pitch = surface->w * bytes_per_pixel;
 
-    if (format_.xbox_swizzled) {
-      ASSERT(converted && "Swizzle source buffer not populated");
-      SetRawTexture((const uint8_t *)converted, swizzle_w, swizzle_h, swizzle_depth, swizzle_pitch, swizzle_bpp,
-                    format_.xbox_swizzled, memory_base);
-      delete[] converted;
+    if (!format_.xbox_swizzled) {
+      ConvertSurfaceToTextureFormat(surface, format_.xbox_format, dest, pitch);
+      return 0;
     }
 
+    // Formats that need to be swizzled are converted into a temporary buffer first.
+    auto converted = new uint8_t[pitch * surface->h];
+    ConvertSurfaceToTextureFormat(surface, format_.xbox_format, converted, pitch);
+    WriteTexels(converted, surface->w, surface->h, 1, pitch, bytes_per_pixel, format_.xbox_swizzled, dest);
+    delete[] converted;
+    return 0;
+  }
+
+  // Surfaces that are already in the destination format (e.g., from texture_generator) are used as-is.
+  if (surface->format->format == format_.sdl_format) {
+    WriteTexels(static_cast<const uint8_t *>(surface->pixels), surface->w, surface->h, 1, surface->pitch,
+                surface->format->BytesPerPixel, format_.xbox_swizzled, dest);
     return 0;
   }
 
@@ -249,8 +193,8 @@ int TextureStage::SetTexture(const SDL_Surface *surface, uint8_t *memory_base) c
     return 4;
   }
 
-  SetRawTexture((const uint8_t *)new_surf->pixels, new_surf->w, new_surf->h, 1, new_surf->pitch,
-                new_surf->format->BytesPerPixel, format_.xbox_swizzled, memory_base);
+  WriteTexels((const uint8_t *)new_surf->pixels, new_surf->w, new_surf->h, 1, new_surf->pitch,
+              new_surf->format->BytesPerPixel, format_.xbox_swizzled, dest);
 
   SDL_FreeSurface(new_surf);
   return 0;
@@ -258,69 +202,85 @@ int TextureStage::SetTexture(const SDL_Surface *surface, uint8_t *memory_base) c
 
 int TextureStage::SetVolumetricTexture(const SDL_Surface **layers, uint32_t depth, uint8_t *memory_base) const {
   ASSERT(format_.xbox_swizzled && "Volumetric textures using linear formats are not supported by XBOX.")
+  ASSERT(!IsCompressedTextureFormat(format_.xbox_format) && "Compressed volumetric textures are not supported.");
 
-  auto **new_surfaces = new SDL_Surface *[depth];
-
-  for (auto i = 0; i < depth; ++i) {
-    auto *surface = const_cast<SDL_Surface *>(layers[i]);
-    new_surfaces[i] = SDL_ConvertSurfaceFormat(surface, format_.sdl_format, 0);
-
-    if (!new_surfaces[i]) {
-      ASSERT(!"Failed to convert surface format.");
-      // This will leak memory, but the ASSERT will halt execution anyway.
-      return 4;
+  const uint32_t width = layers[0]->w;
+  const uint32_t height = layers[0]->h;
+  uint8_t *dest = memory_base + texture_memory_offset_;
+  for (uint32_t i = 0; i < depth; ++i) {
+    int ret = WriteVolumeLayer(layers[i], i, width, height, depth, dest);
+    if (ret) {
+      return ret;
     }
   }
+  return 0;
+}
 
-  const int32_t width = new_surfaces[0]->w;
-  int32_t height = new_surfaces[0]->h;
-  int32_t pitch = new_surfaces[0]->pitch;
-  int32_t bytes_per_pixel = new_surfaces[0]->format->BytesPerPixel;
-
-  uint32_t converted_surface_size = pitch * height;
-  auto *flattened = new uint8_t[converted_surface_size * depth];
-  uint8_t *dest = flattened;
-  for (auto i = 0; i < depth; ++i) {
-    SDL_Surface *s = new_surfaces[i];
-    ASSERT(s->w == width && "Volumetric surface layers must have identical dimensions");
-    ASSERT(s->h == height && "Volumetric surface layers must have identical dimensions");
-    ASSERT(s->pitch == pitch && "Volumetric surface layers must have identical dimensions");
-    ASSERT(s->format->BytesPerPixel == bytes_per_pixel && "Volumetric surface layers must have identical dimensions");
-
-    memcpy(dest, s->pixels, converted_surface_size);
-    dest += converted_surface_size;
-  }
+int TextureStage::SetVolumetricTexture(uint32_t width, uint32_t height, uint32_t depth,
+                                       const VolumeLayerGenerator &generate_layer, uint8_t *memory_base) const {
+  ASSERT(format_.xbox_swizzled && "Volumetric textures using linear formats are not supported by XBOX.")
+  ASSERT(!IsCompressedTextureFormat(format_.xbox_format) && "Compressed volumetric textures are not supported.");
 
-  for (auto i = 0; i < depth; ++i) {
-    SDL_FreeSurface(new_surfaces[i]);
+  uint8_t *dest = memory_base + texture_memory_offset_;
+  for (uint32_t i = 0; i < depth; ++i) {
+    SDL_Surface *layer = generate_layer(i);
+    if (!layer) {
+      ASSERT(!"Failed to generate volumetric layer.");
+      return 5;
+    }
+    int ret = WriteVolumeLayer(layer, i, width, height, depth, dest);
+    SDL_FreeSurface(layer);
+    if (ret) {
+      return ret;
+    }
   }
-  delete[] new_surfaces;
+  return 0;
+}
 
-  int ret = SetRawTexture(flattened, width, height, depth, pitch, bytes_per_pixel, format_.xbox_swizzled, memory_base);
+int TextureStage::WriteVolumeLayer(const SDL_Surface *layer, uint32_t index, uint32_t width, uint32_t height,
+                                   uint32_t depth, uint8_t *dest) const {
+  ASSERT(layer->w == width && "Volumetric surface layers must have identical dimensions");
+  ASSERT(layer->h == height && "Volumetric surface layers must have identical dimensions");
 
-  delete[] flattened;
+  SDL_Surface *converted = SDL_ConvertSurfaceFormat(const_cast<SDL_Surface *>(layer), format_.sdl_format, 0);
+  if (!converted) {
+    ASSERT(!"Failed to convert surface format.");
+    return 4;
+  }
 
-  return ret;
+  SwizzleSlice(static_cast<const uint8_t *>(converted->pixels), width, height, depth, index, dest, converted->pitch,
+               converted->format->BytesPerPixel);
+  SDL_FreeSurface(converted);
+  return 0;
 }
 
 int TextureStage::SetRawTexture(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint32_t pitch,
                                 uint32_t bytes_per_pixel, bool swizzle, uint8_t *memory_base) const {
-  uint8_t *dest = memory_base + texture_memory_offset_;
+  WriteTexels(source, width, height, depth, pitch, bytes_per_pixel, swizzle, memory_base + texture_memory_offset_);
+  return 0;
+}
 
+void TextureStage::WriteTexels(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint32_t pitch,
+                               uint32_t bytes_per_pixel, bool swizzle, uint8_t *dest) {
   if (swizzle) {
-    if (depth > 1) {
-      swizzle_box(source, width, height, depth, dest, pitch, pitch * height, bytes_per_pixel);
-    } else {
-      swizzle_rect(source, width, height, dest, pitch, bytes_per_pixel);
-    }
+    SwizzleBox(source, width, height, depth, dest, pitch, pitch * height, bytes_per_pixel);
   } else {
     memcpy(dest, source, pitch * height * depth);
   }
+}
+
+int TextureStage::SetPalette(const uint32_t *palette, uint32_t length, uint8_t *memory_base) {
+  int ret = SetPaletteLength(length);
+  if (ret) {
+    return ret;
+  }
 
+  uint8_t *dest = memory_base + palette_memory_offset_;
+  memcpy(dest, palette, length * 4);
   return 0;
 }
 
-int TextureStage::SetPalette(const uint32_t *palette, uint32_t length, uint8_t *memory_base) {
+int TextureStage::SetPaletteLength(uint32_t length) {
   switch (length) {
     case 256:
       palette_length_ = 0;
@@ -338,8 +298,5 @@ int TextureStage::SetPalette(const uint32_t *palette, uint32_t length, uint8_t *
       ASSERT(!"Invalid palette length. Must be 32|64|128|256");
       return 1;
   }
-
-  uint8_t *dest = memory_base + palette_memory_offset_;
-  memcpy(dest, palette, length * 4);
   return 0;
 }
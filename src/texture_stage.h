@@ -4,11 +4,18 @@
 #include <pbkit/pbkit.h>
 #include <printf/printf.h>
 
+#include <functional>
+
+#include "register_shadow.h"
+#include "texture_compression.h"
 #include "texture_format.h"
 
 // Sets up an nv2a texture stage.
 class TextureStage {
  public:
+  // Produces layer `index` of a volumetric texture. Ownership of the returned surface passes to the caller.
+  using VolumeLayerGenerator = std::function<SDL_Surface *(uint32_t index)>;
+
   enum ConvolutionKernel {
     K_QUINCUNX = 1,
     K_GAUSSIAN_3 = 2,
@@ -83,6 +90,14 @@ class TextureStage {
     depth_ = depth;
   }
 
+  // Sets the encoder quality used when uploading to compressed (DXT) formats.
+  void SetCompressionQuality(CompressionQuality quality) { compression_quality_ = quality; }
+  CompressionQuality GetCompressionQuality() const { return compression_quality_; }
+
+  // Sets the number of mipmap levels (including the base level) that follow the texture offset.
+  void SetMipMapLevels(uint32_t levels) { mipmap_levels_ = levels; }
+  uint32_t GetMipMapLevels() const { return mipmap_levels_; }
+
   uint32_t GetDimensionality() const {
     if (height_ == 1 && depth_ == 1) {
       return 1;
@@ -108,16 +123,37 @@ class TextureStage {
   void SetTextureOffset(uint32_t offset) { texture_memory_offset_ = offset; }
   void SetPaletteOffset(uint32_t offset) { palette_memory_offset_ = offset; }
 
-  void Commit(uint32_t memory_dma_offset, uint32_t palette_dma_offset) const;
+  // Pushes the stage configuration, skipping registers that `shadow` shows are already latched.
+  void Commit(uint32_t memory_dma_offset, uint32_t palette_dma_offset, RegisterShadow &shadow) const;
 
   int SetTexture(const SDL_Surface *surface, uint8_t *memory_base) const;
+  // Uploads `num_levels` surfaces, each half the size of the previous one, as a mipmap chain.
+  int SetMipMappedTexture(const SDL_Surface *const *levels, uint32_t num_levels, uint8_t *memory_base) const;
   int SetVolumetricTexture(const SDL_Surface **layers, uint32_t depth, uint8_t *memory_base) const;
+  // As SetVolumetricTexture, but requests each `width` x `height` layer from `generate_layer` only once the previous
+  // one has been swizzled into texture memory and freed, so a single layer is held at a time.
+  int SetVolumetricTexture(uint32_t width, uint32_t height, uint32_t depth, const VolumeLayerGenerator &generate_layer,
+                           uint8_t *memory_base) const;
   int SetRawTexture(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint32_t pitch,
                     uint32_t bytes_per_pixel, bool swizzle, uint8_t *memory_base) const;
 
+  // Uploads `palette` to the stage's palette offset and sets the palette length.
   int SetPalette(const uint32_t *palette, uint32_t length, uint8_t *memory_base);
+  // Sets the number of entries in the palette at the stage's palette offset without uploading it.
+  int SetPaletteLength(uint32_t length);
+
+  // Returns the number of bytes occupied by a single `width` x `height` image in the stage's format.
+  uint32_t GetImageSize(uint32_t width, uint32_t height) const;
+  // Converts `surface` to the stage's format and writes it, swizzling or compressing if necessary, to `dest`.
+  int UploadSurface(const SDL_Surface *surface, uint8_t *dest) const;
+  static void WriteTexels(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint32_t pitch,
+                          uint32_t bytes_per_pixel, bool swizzle, uint8_t *dest);
 
  private:
+  // Converts `layer` to the stage's format and swizzles it into slice `index` of the `depth` deep volume at `dest`.
+  int WriteVolumeLayer(const SDL_Surface *layer, uint32_t index, uint32_t width, uint32_t height, uint32_t depth,
+                       uint8_t *dest) const;
+
   uint32_t stage_{0};
   bool enabled_{false};
   bool alpha_kill_enable_{false};
@@ -135,6 +171,7 @@ class TextureStage {
   uint32_t size_p_{0};
 
   uint32_t mipmap_levels_{1};
+  CompressionQuality compression_quality_{COMPRESSION_FAST};
 
   uint32_t palette_length_{10};
   uint32_t palette_memory_offset_{0};
@@ -0,0 +1,228 @@
+#include "texture_swizzle.h"
+
+#include <cstring>
+
+#include "debug_output.h"
+
+// Swizzled addresses are processed in tiles of 2^kTileBits texels. The low kTileBits of an address select a texel
+// within a tile via a precomputed table of linear offsets, the remaining bits are decoded once per tile.
+static constexpr uint32_t kTileBits = 8;
+static constexpr uint32_t kTileSize = 1 << kTileBits;
+static constexpr uint32_t kTileMask = kTileSize - 1;
+
+struct SwizzleMasks {
+  uint32_t x;
+  uint32_t y;
+  uint32_t z;
+  uint32_t num_bits;
+};
+
+// Builds the bit interleave pattern (...zyxzyx) for the given dimensions. Once a dimension runs out of bits the others
+// are packed more tightly, so a 4x2 image uses the pattern xyx.
+static SwizzleMasks GenerateSwizzleMasks(uint32_t width, uint32_t height, uint32_t depth) {
+  SwizzleMasks masks{0, 0, 0, 0};
+  uint32_t mask_bit = 1;
+  for (uint32_t bit = 1; bit < width || bit < height || bit < depth; bit <<= 1) {
+    if (bit < width) {
+      masks.x |= mask_bit;
+      mask_bit <<= 1;
+      ++masks.num_bits;
+    }
+    if (bit < height) {
+      masks.y |= mask_bit;
+      mask_bit <<= 1;
+      ++masks.num_bits;
+    }
+    if (bit < depth) {
+      masks.z |= mask_bit;
+      mask_bit <<= 1;
+      ++masks.num_bits;
+    }
+  }
+  return masks;
+}
+
+// Gathers the bits of `value` selected by `mask` into the low bits of the result (a software PEXT).
+static inline uint32_t ExtractBits(uint32_t value, uint32_t mask) {
+  uint32_t result = 0;
+  uint32_t result_bit = 1;
+  while (mask) {
+    uint32_t lowest = mask & (~mask + 1);
+    if (value & lowest) {
+      result |= result_bit;
+    }
+    result_bit <<= 1;
+    mask &= mask - 1;
+  }
+  return result;
+}
+
+// Scatters the low bits of `value` into the bits selected by `mask` (a software PDEP).
+static inline uint32_t DepositBits(uint32_t value, uint32_t mask) {
+  uint32_t result = 0;
+  for (uint32_t value_bit = 1; mask; value_bit <<= 1) {
+    uint32_t lowest = mask & (~mask + 1);
+    if (value & value_bit) {
+      result |= lowest;
+    }
+    mask &= mask - 1;
+  }
+  return result;
+}
+
+static inline uint32_t CountBits(uint32_t value) {
+  uint32_t count = 0;
+  for (; value; value &= value - 1) {
+    ++count;
+  }
+  return count;
+}
+
+// Maps each swizzled address `index` to the byte offset of the corresponding texel in the linear image, given masks
+// that have already been shifted down to the bits that `index` covers.
+static inline uint32_t LinearOffset(uint32_t index, uint32_t mask_x, uint32_t mask_y, uint32_t mask_z,
+                                    uint32_t bytes_per_pixel, uint32_t row_pitch, uint32_t slice_pitch) {
+  return ExtractBits(index, mask_x) * bytes_per_pixel + ExtractBits(index, mask_y) * row_pitch +
+         ExtractBits(index, mask_z) * slice_pitch;
+}
+
+template <typename Texel, bool kSwizzle>
+static void SwizzleTile(uint8_t *swizzled, uint8_t *linear, const uint32_t *offsets, uint32_t count) {
+  auto tile = reinterpret_cast<Texel *>(swizzled);
+  for (uint32_t i = 0; i < count; ++i) {
+    auto texel = reinterpret_cast<Texel *>(linear + offsets[i]);
+    if (kSwizzle) {
+      tile[i] = *texel;
+    } else {
+      *texel = tile[i];
+    }
+  }
+}
+
+template <bool kSwizzle>
+static void SwizzleTileGeneric(uint8_t *swizzled, uint8_t *linear, const uint32_t *offsets, uint32_t count,
+                               uint32_t bytes_per_pixel) {
+  for (uint32_t i = 0; i < count; ++i, swizzled += bytes_per_pixel) {
+    if (kSwizzle) {
+      memcpy(swizzled, linear + offsets[i], bytes_per_pixel);
+    } else {
+      memcpy(linear + offsets[i], swizzled, bytes_per_pixel);
+    }
+  }
+}
+
+template <bool kSwizzle>
+static void Swizzle(uint8_t *swizzled, uint8_t *linear, uint32_t width, uint32_t height, uint32_t depth,
+                    uint32_t row_pitch, uint32_t slice_pitch, uint32_t bytes_per_pixel) {
+  ASSERT(!(width & (width - 1)) && !(height & (height - 1)) && !(depth & (depth - 1)) &&
+         "Swizzled dimensions must be powers of two.");
+
+  const SwizzleMasks masks = GenerateSwizzleMasks(width, height, depth);
+  const uint32_t num_texels = 1 << masks.num_bits;
+  const uint32_t tile_texels = num_texels < kTileSize ? num_texels : kTileSize;
+
+  uint32_t tile_offsets[kTileSize];
+  for (uint32_t i = 0; i < tile_texels; ++i) {
+    tile_offsets[i] = LinearOffset(i, masks.x & kTileMask, masks.y & kTileMask, masks.z & kTileMask, bytes_per_pixel,
+                                   row_pitch, slice_pitch);
+  }
+
+  // Bits above the tile are compacted relative to the coordinate bits already consumed by the tile table.
+  const uint32_t high_mask_x = masks.x >> kTileBits;
+  const uint32_t high_mask_y = masks.y >> kTileBits;
+  const uint32_t high_mask_z = masks.z >> kTileBits;
+  const uint32_t shift_x = CountBits(masks.x & kTileMask);
+  const uint32_t shift_y = CountBits(masks.y & kTileMask);
+  const uint32_t shift_z = CountBits(masks.z & kTileMask);
+
+  const uint32_t tile_bytes = tile_texels * bytes_per_pixel;
+  for (uint32_t tile = 0; tile < num_texels / tile_texels; ++tile, swizzled += tile_bytes) {
+    uint8_t *tile_base = linear + (ExtractBits(tile, high_mask_x) << shift_x) * bytes_per_pixel +
+                         (ExtractBits(tile, high_mask_y) << shift_y) * row_pitch +
+                         (ExtractBits(tile, high_mask_z) << shift_z) * slice_pitch;
+
+    switch (bytes_per_pixel) {
+      case 1:
+        SwizzleTile<uint8_t, kSwizzle>(swizzled, tile_base, tile_offsets, tile_texels);
+        break;
+
+      case 2:
+        SwizzleTile<uint16_t, kSwizzle>(swizzled, tile_base, tile_offsets, tile_texels);
+        break;
+
+      case 4:
+        SwizzleTile<uint32_t, kSwizzle>(swizzled, tile_base, tile_offsets, tile_texels);
+        break;
+
+      default:
+        SwizzleTileGeneric<kSwizzle>(swizzled, tile_base, tile_offsets, tile_texels, bytes_per_pixel);
+        break;
+    }
+  }
+}
+
+template <typename Texel>
+static void SwizzleSliceRows(const uint8_t *source, uint32_t width, uint32_t height, const SwizzleMasks &masks,
+                             uint32_t slice_bits, uint8_t *dest, uint32_t row_pitch) {
+  auto swizzled = reinterpret_cast<Texel *>(dest);
+  // Coordinates are advanced directly in their interleaved form: adding one to the bits selected by a mask is
+  // (bits - mask) & mask.
+  uint32_t y_bits = 0;
+  for (uint32_t y = 0; y < height; ++y, source += row_pitch) {
+    auto row = reinterpret_cast<const Texel *>(source);
+    const uint32_t row_bits = y_bits | slice_bits;
+    uint32_t x_bits = 0;
+    for (uint32_t x = 0; x < width; ++x) {
+      swizzled[x_bits | row_bits] = row[x];
+      x_bits = (x_bits - masks.x) & masks.x;
+    }
+    y_bits = (y_bits - masks.y) & masks.y;
+  }
+}
+
+void SwizzleSlice(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint32_t slice,
+                  uint8_t *dest, uint32_t row_pitch, uint32_t bytes_per_pixel) {
+  ASSERT(!(width & (width - 1)) && !(height & (height - 1)) && !(depth & (depth - 1)) &&
+         "Swizzled dimensions must be powers of two.");
+  ASSERT(slice < depth && "Slice out of range.");
+
+  const SwizzleMasks masks = GenerateSwizzleMasks(width, height, depth);
+  const uint32_t slice_bits = DepositBits(slice, masks.z);
+
+  switch (bytes_per_pixel) {
+    case 1:
+      SwizzleSliceRows<uint8_t>(source, width, height, masks, slice_bits, dest, row_pitch);
+      break;
+
+    case 2:
+      SwizzleSliceRows<uint16_t>(source, width, height, masks, slice_bits, dest, row_pitch);
+      break;
+
+    case 4:
+      SwizzleSliceRows<uint32_t>(source, width, height, masks, slice_bits, dest, row_pitch);
+      break;
+
+    default: {
+      uint32_t y_bits = 0;
+      for (uint32_t y = 0; y < height; ++y, source += row_pitch) {
+        uint32_t x_bits = 0;
+        for (uint32_t x = 0; x < width; ++x) {
+          memcpy(dest + (x_bits | y_bits | slice_bits) * bytes_per_pixel, source + x * bytes_per_pixel,
+                 bytes_per_pixel);
+          x_bits = (x_bits - masks.x) & masks.x;
+        }
+        y_bits = (y_bits - masks.y) & masks.y;
+      }
+    } break;
+  }
+}
+
+void SwizzleBox(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint8_t *dest,
+                uint32_t row_pitch, uint32_t slice_pitch, uint32_t bytes_per_pixel) {
+  Swizzle<true>(dest, const_cast<uint8_t *>(source), width, height, depth, row_pitch, slice_pitch, bytes_per_pixel);
+}
+
+void UnswizzleBox(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint8_t *dest,
+                  uint32_t row_pitch, uint32_t slice_pitch, uint32_t bytes_per_pixel) {
+  Swizzle<false>(const_cast<uint8_t *>(source), dest, width, height, depth, row_pitch, slice_pitch, bytes_per_pixel);
+}
@@ -0,0 +1,36 @@
+#ifndef NXDK_PGRAPH_TESTS_TEXTURE_SWIZZLE_H
+#define NXDK_PGRAPH_TESTS_TEXTURE_SWIZZLE_H
+
+#include <cstdint>
+
+// Conversion between linear images and the Morton ordered ("swizzled") layout used by nv2a textures and swizzled
+// surfaces. Width, height, and depth must be powers of two.
+//
+// The swizzled side is always traversed sequentially, so the destination of SwizzleBox (and the source of
+// UnswizzleBox) may be write-combined memory.
+
+// Swizzles `depth` slices of `height` rows from `source` into `dest`.
+void SwizzleBox(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint8_t *dest,
+                uint32_t row_pitch, uint32_t slice_pitch, uint32_t bytes_per_pixel);
+
+// Unswizzles `source` into `depth` slices of `height` rows in `dest`.
+void UnswizzleBox(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint8_t *dest,
+                  uint32_t row_pitch, uint32_t slice_pitch, uint32_t bytes_per_pixel);
+
+// Swizzles the `height` rows of a single slice from `source` into slice `slice` of the `depth` deep volume at `dest`.
+// The slice's texels are interleaved with those of its neighbours, so unlike SwizzleBox the destination is written
+// sparsely.
+void SwizzleSlice(const uint8_t *source, uint32_t width, uint32_t height, uint32_t depth, uint32_t slice,
+                  uint8_t *dest, uint32_t row_pitch, uint32_t bytes_per_pixel);
+
+inline void SwizzleRect(const uint8_t *source, uint32_t width, uint32_t height, uint8_t *dest, uint32_t pitch,
+                        uint32_t bytes_per_pixel) {
+  SwizzleBox(source, width, height, 1, dest, pitch, 0, bytes_per_pixel);
+}
+
+inline void UnswizzleRect(const uint8_t *source, uint32_t width, uint32_t height, uint8_t *dest, uint32_t pitch,
+                          uint32_t bytes_per_pixel) {
+  UnswizzleBox(source, width, height, 1, dest, pitch, 0, bytes_per_pixel);
+}
+
+#endif  // NXDK_PGRAPH_TESTS_TEXTURE_SWIZZLE_H
@@ -1,12 +1,39 @@
 #include "vertex_buffer.h"
 
-#include <xboxkrnl/xboxkrnl.h>
-
+#include <algorithm>
+#include <cmath>
 #include <memory>
 
+#include "contiguous_memory_pool.h"
 #include "debug_output.h"
+#include "frame_pipeline.h"
+#include "math3d_sse.h"
+#include "nxdk_ext.h"
 #include "pbkit_ext.h"
 
+// Byte offset of the float components of each NV2A_VERTEX_ATTR_* within a Vertex.
+static const uint32_t kAttributeOffsets[VertexBuffer::kNumAttributes] = {
+    offsetof(Vertex, pos),          offsetof(Vertex, weight),        offsetof(Vertex, normal),
+    offsetof(Vertex, diffuse),      offsetof(Vertex, specular),      offsetof(Vertex, fog_coord),
+    offsetof(Vertex, point_size),   offsetof(Vertex, back_diffuse),  offsetof(Vertex, back_specular),
+    offsetof(Vertex, texcoord0),    offsetof(Vertex, texcoord1),     offsetof(Vertex, texcoord2),
+    offsetof(Vertex, texcoord3),    0,                               0,
+    0};
+
+static inline int16_t ToShort(float value) {
+  return static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, roundf(value))));
+}
+
+static inline int32_t ToSignedNormalized(float value, int32_t max) {
+  value = std::max(-1.0f, std::min(1.0f, value));
+  return static_cast<int32_t>(roundf(value * static_cast<float>(max)));
+}
+
+static inline uint8_t ToUnsignedNormalizedByte(float value) {
+  value = std::max(0.0f, std::min(1.0f, value));
+  return static_cast<uint8_t>(value * 255.0f + 0.5f);
+}
+
 void Vertex::Translate(float x, float y, float z, float w) {
   pos[0] += x;
   pos[1] += y;
@@ -14,41 +41,103 @@ void Vertex::Translate(float x, float y, float z, float w) {
   pos[3] += w;
 }
 
-VertexBuffer::VertexBuffer(uint32_t num_vertices) : num_vertices_(num_vertices) {
+VertexBuffer::VertexBuffer(uint32_t num_vertices) : num_vertices_(num_vertices), linear_dirty_end_(num_vertices) {
   uint32_t buffer_size = sizeof(Vertex) * num_vertices;
-  normalized_vertex_buffer_ = static_cast<Vertex *>(
-      MmAllocateContiguousMemoryEx(buffer_size, 0, MAXRAM, 0, PAGE_WRITECOMBINE | PAGE_READWRITE));
+  normalized_vertex_buffer_ =
+      static_cast<Vertex *>(ContiguousMemoryPool::Allocate(buffer_size, MemoryTracker::CATEGORY_VERTEX_BUFFER));
+  ASSERT(normalized_vertex_buffer_ && "Failed to allocate vertex buffer.");
 }
 
 VertexBuffer::~VertexBuffer() {
-  if (linear_vertex_buffer_) {
-    MmFreeContiguousMemory(linear_vertex_buffer_);
-  }
-  if (normalized_vertex_buffer_) {
-    MmFreeContiguousMemory(normalized_vertex_buffer_);
-  }
+  uint32_t buffer_size = sizeof(Vertex) * num_vertices_;
+  ContiguousMemoryPool::Release(packed_vertex_buffer_, packed_buffer_size_, MemoryTracker::CATEGORY_VERTEX_BUFFER);
+  ContiguousMemoryPool::Release(linear_vertex_buffer_, buffer_size, MemoryTracker::CATEGORY_LINEAR_VERTICES);
+  ContiguousMemoryPool::Release(normalized_vertex_buffer_, buffer_size, MemoryTracker::CATEGORY_VERTEX_BUFFER);
 }
 
 Vertex *VertexBuffer::Lock() {
-  cache_valid_ = false;
+  MarkDirty(0, num_vertices_);
   return normalized_vertex_buffer_;
 }
 
+Vertex *VertexBuffer::Lock(uint32_t start_index, uint32_t count) {
+  ASSERT(start_index + count <= num_vertices_ && "Invalid lock range.");
+  MarkDirty(start_index, count);
+  return normalized_vertex_buffer_ + start_index;
+}
+
 void VertexBuffer::Unlock() {}
 
-void VertexBuffer::Linearize(float texture_width, float texture_height) {
-  uint32_t buffer_size = sizeof(Vertex) * num_vertices_;
+void VertexBuffer::MarkDirty(uint32_t start_index, uint32_t count) {
+  if (!RequiresPacking()) {
+    // The GPU reads unpacked vertices directly from this buffer, so a frame that is still rendering must finish first.
+    FramePipeline::RetireActive();
+  }
+  cache_valid_ = false;
+  uniform_source_ = nullptr;
+  if (!count) {
+    return;
+  }
+
+  uint32_t end = std::min(start_index + count, num_vertices_);
+  if (linear_dirty_start_ == linear_dirty_end_) {
+    linear_dirty_start_ = start_index;
+    linear_dirty_end_ = end;
+    return;
+  }
+  linear_dirty_start_ = std::min(linear_dirty_start_, start_index);
+  linear_dirty_end_ = std::max(linear_dirty_end_, end);
+}
+
+void VertexBuffer::Linearize(float texture_width, float texture_height) { Linearize(0, texture_width, texture_height); }
+
+void VertexBuffer::Linearize(uint32_t stage, float texture_width, float texture_height) {
+  ASSERT(stage < 4 && "Invalid texture stage.");
+  linearize_ = true;
+
+  float *scale = linear_texcoord_scale_[stage];
+  if (scale[0] == texture_width && scale[1] == texture_height) {
+    return;
+  }
+
+  scale[0] = texture_width;
+  scale[1] = texture_height;
+  MarkDirty(0, num_vertices_);
+}
+
+Vertex *VertexBuffer::GetLinearVertices() {
+  if (!linearize_) {
+    return normalized_vertex_buffer_;
+  }
+
   if (!linear_vertex_buffer_) {
     linear_vertex_buffer_ = static_cast<Vertex *>(
-        MmAllocateContiguousMemoryEx(buffer_size, 0, MAXRAM, 0, PAGE_WRITECOMBINE | PAGE_READWRITE));
+        ContiguousMemoryPool::Allocate(sizeof(Vertex) * num_vertices_, MemoryTracker::CATEGORY_LINEAR_VERTICES));
+    ASSERT(linear_vertex_buffer_ && "Failed to allocate linear vertex buffer.");
+    linear_dirty_start_ = 0;
+    linear_dirty_end_ = num_vertices_;
+  }
+
+  if (linear_dirty_start_ == linear_dirty_end_) {
+    return linear_vertex_buffer_;
   }
 
-  memcpy(linear_vertex_buffer_, normalized_vertex_buffer_, buffer_size);
+  const Vertex *src = normalized_vertex_buffer_ + linear_dirty_start_;
+  Vertex *dst = linear_vertex_buffer_ + linear_dirty_start_;
+  memcpy(dst, src, sizeof(Vertex) * (linear_dirty_end_ - linear_dirty_start_));
 
-  for (int i = 0; i < num_vertices_; i++) {
-    linear_vertex_buffer_[i].texcoord0[0] *= static_cast<float>(texture_width);
-    linear_vertex_buffer_[i].texcoord0[1] *= static_cast<float>(texture_height);
+  Vertex *vertex = dst;
+  for (uint32_t i = linear_dirty_start_; i < linear_dirty_end_; ++i, ++vertex) {
+    float *texcoords[4] = {vertex->texcoord0, vertex->texcoord1, vertex->texcoord2, vertex->texcoord3};
+    for (uint32_t stage = 0; stage < 4; ++stage) {
+      texcoords[stage][0] *= linear_texcoord_scale_[stage][0];
+      texcoords[stage][1] *= linear_texcoord_scale_[stage][1];
+    }
   }
+
+  linear_dirty_start_ = linear_dirty_end_ = 0;
+  packed_source_ = nullptr;
+  return linear_vertex_buffer_;
 }
 
 void VertexBuffer::DefineTriangleCCW(uint32_t start_index, const float *one, const float *two, const float *three) {
@@ -101,7 +190,7 @@ void VertexBuffer::DefineTriangle(uint32_t start_index, const float *one, const
                                   const Color &diffuse_one, const Color &diffuse_two, const Color &diffuse_three) {
   ASSERT(start_index <= (num_vertices_ - 3) && "Invalid start_index, need at least 3 vertices to define triangle.");
 
-  cache_valid_ = false;
+  MarkDirty(start_index * 3, 3);
 
   Vertex *vb = normalized_vertex_buffer_ + (start_index * 3);
 
@@ -153,7 +242,7 @@ void VertexBuffer::DefineBiTriCCW(uint32_t start_index, float left, float top, f
                                   const Color &ll_specular, const Color &lr_specular, const Color &ur_specular) {
   ASSERT(start_index <= (num_vertices_ - 6) && "Invalid start_index, need at least 6 vertices to define quad.");
 
-  cache_valid_ = false;
+  MarkDirty(start_index * 6, 6);
 
   Vertex *vb = normalized_vertex_buffer_ + (start_index * 6);
 
@@ -246,8 +335,8 @@ void VertexBuffer::DefineBiTri(uint32_t start_index, float left, float top, floa
 }
 
 void VertexBuffer::SetDiffuse(uint32_t vertex_index, const Color &color) {
-  cache_valid_ = false;
   ASSERT(vertex_index < num_vertices_ && "Invalid vertex_index.");
+  MarkDirty(vertex_index, 1);
   normalized_vertex_buffer_[vertex_index].diffuse[0] = color.r;
   normalized_vertex_buffer_[vertex_index].diffuse[1] = color.g;
   normalized_vertex_buffer_[vertex_index].diffuse[2] = color.b;
@@ -255,8 +344,8 @@ void VertexBuffer::SetDiffuse(uint32_t vertex_index, const Color &color) {
 }
 
 void VertexBuffer::SetSpecular(uint32_t vertex_index, const Color &color) {
-  cache_valid_ = false;
   ASSERT(vertex_index < num_vertices_ && "Invalid vertex_index.");
+  MarkDirty(vertex_index, 1);
   normalized_vertex_buffer_[vertex_index].specular[0] = color.r;
   normalized_vertex_buffer_[vertex_index].specular[1] = color.g;
   normalized_vertex_buffer_[vertex_index].specular[2] = color.b;
@@ -302,3 +391,215 @@ void VertexBuffer::Translate(float x, float y, float z, float w) {
   }
   Unlock();
 }
+
+void VertexBuffer::Transform(const MATRIX matrix) {
+  auto vertex = Lock();
+  vector_apply_batch_sse(vertex->pos, sizeof(Vertex), vertex->pos, sizeof(Vertex), num_vertices_, matrix);
+  Unlock();
+}
+
+void VertexBuffer::SetAttributeFormat(uint32_t attribute_index, AttributeFormat format) {
+  ASSERT(attribute_index < kNumAttributes && "Invalid attribute_index.");
+  ASSERT((format != ATTRIBUTE_FORMAT_D3DCOLOR || GetComponentCount(attribute_index) == 4) &&
+         "D3DCOLOR requires a 4 component attribute.");
+  ASSERT((format != ATTRIBUTE_FORMAT_NORMPACKED3 || GetComponentCount(attribute_index) == 3) &&
+         "NORMPACKED3 requires a 3 component attribute.");
+
+  if (attribute_formats_[attribute_index] != ATTRIBUTE_FORMAT_FLOAT) {
+    --num_compact_attributes_;
+  }
+  attribute_formats_[attribute_index] = format;
+  if (format != ATTRIBUTE_FORMAT_FLOAT) {
+    ++num_compact_attributes_;
+  }
+
+  cache_valid_ = false;
+  packed_source_ = nullptr;
+}
+
+void VertexBuffer::SetLayout(Layout layout) {
+  if (layout == layout_) {
+    return;
+  }
+  layout_ = layout;
+  cache_valid_ = false;
+  packed_source_ = nullptr;
+}
+
+uint32_t VertexBuffer::GetComponentCount(uint32_t attribute_index) const {
+  switch (attribute_index) {
+    case NV2A_VERTEX_ATTR_POSITION:
+      return position_count_;
+    case NV2A_VERTEX_ATTR_WEIGHT:
+    case NV2A_VERTEX_ATTR_FOG_COORD:
+    case NV2A_VERTEX_ATTR_POINT_SIZE:
+      return 1;
+    case NV2A_VERTEX_ATTR_NORMAL:
+      return 3;
+    case NV2A_VERTEX_ATTR_DIFFUSE:
+    case NV2A_VERTEX_ATTR_SPECULAR:
+    case NV2A_VERTEX_ATTR_BACK_DIFFUSE:
+    case NV2A_VERTEX_ATTR_BACK_SPECULAR:
+      return 4;
+    case NV2A_VERTEX_ATTR_TEXTURE0:
+      return tex0_coord_count_;
+    case NV2A_VERTEX_ATTR_TEXTURE1:
+      return tex1_coord_count_;
+    case NV2A_VERTEX_ATTR_TEXTURE2:
+      return tex2_coord_count_;
+    case NV2A_VERTEX_ATTR_TEXTURE3:
+      return tex3_coord_count_;
+    default:
+      return 0;
+  }
+}
+
+uint32_t VertexBuffer::GetUniformFields(const Vertex *source, uint32_t enabled_fields) {
+  if (source != uniform_source_) {
+    uniform_source_ = source;
+    uniform_checked_fields_ = 0;
+    uniform_fields_ = 0;
+  }
+
+  const uint32_t unchecked_fields = enabled_fields & ~uniform_checked_fields_;
+  if (unchecked_fields && num_vertices_) {
+    auto first = reinterpret_cast<const uint8_t *>(source);
+    for (uint32_t i = 0; i < kNumAttributes; ++i) {
+      const uint32_t size = GetComponentCount(i) * sizeof(float);
+      if (!(unchecked_fields & (1 << i)) || !size) {
+        continue;
+      }
+
+      bool uniform = true;
+      for (uint32_t v = 1; v < num_vertices_ && uniform; ++v) {
+        auto vertex = reinterpret_cast<const uint8_t *>(source + v);
+        uniform = !memcmp(first + kAttributeOffsets[i], vertex + kAttributeOffsets[i], size);
+      }
+      if (uniform) {
+        uniform_fields_ |= 1 << i;
+      }
+    }
+  }
+  uniform_checked_fields_ |= enabled_fields;
+
+  return uniform_fields_ & enabled_fields;
+}
+
+void VertexBuffer::Pack(const Vertex *source, uint32_t enabled_fields) {
+  ASSERT(source && "Vertices must be linearized before being packed.");
+
+  // Lay out every enabled attribute, each padded to a dword boundary.
+  packed_stride_ = 0;
+  for (uint32_t i = 0; i < kNumAttributes; ++i) {
+    auto &attribute = packed_attributes_[i];
+    attribute.offset = packed_stride_;
+    attribute.count = GetComponentCount(i);
+    if (!(enabled_fields & (1 << i))) {
+      attribute.count = 0;
+    }
+
+    switch (attribute_formats_[i]) {
+      case ATTRIBUTE_FORMAT_FLOAT:
+        attribute.type = NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_F;
+        attribute.size = attribute.count * 4;
+        break;
+
+      case ATTRIBUTE_FORMAT_D3DCOLOR:
+        attribute.type = NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_UB_D3D;
+        attribute.size = attribute.count ? 4 : 0;
+        break;
+
+      case ATTRIBUTE_FORMAT_SHORT:
+        attribute.type = NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_S32K;
+        attribute.size = (attribute.count * 2 + 3) & ~3;
+        break;
+
+      case ATTRIBUTE_FORMAT_NORMALIZED_SHORT:
+        attribute.type = NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_S1;
+        attribute.size = (attribute.count * 2 + 3) & ~3;
+        break;
+
+      case ATTRIBUTE_FORMAT_NORMPACKED3:
+        attribute.type = NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE_CMP;
+        // The three components occupy a single element.
+        attribute.count = attribute.count ? 1 : 0;
+        attribute.size = attribute.count * 4;
+        break;
+    }
+
+    packed_stride_ += attribute.size;
+  }
+
+  // Planar layouts place each attribute in its own tightly packed array instead.
+  for (uint32_t i = 0, plane_offset = 0; i < kNumAttributes; ++i) {
+    auto &attribute = packed_attributes_[i];
+    if (layout_ == LAYOUT_PLANAR) {
+      attribute.offset = plane_offset;
+      attribute.stride = attribute.size;
+      plane_offset += attribute.size * num_vertices_;
+    } else {
+      attribute.stride = packed_stride_;
+    }
+  }
+
+  uint32_t required_size = packed_stride_ * num_vertices_;
+  if (required_size > packed_buffer_size_) {
+    ContiguousMemoryPool::Release(packed_vertex_buffer_, packed_buffer_size_, MemoryTracker::CATEGORY_VERTEX_BUFFER);
+    // Use the whole pooled block so that small growth does not require a reallocation.
+    packed_buffer_size_ = ContiguousMemoryPool::GetAllocationSize(required_size);
+    packed_vertex_buffer_ = static_cast<uint8_t *>(
+        ContiguousMemoryPool::Allocate(packed_buffer_size_, MemoryTracker::CATEGORY_VERTEX_BUFFER));
+    ASSERT(packed_vertex_buffer_ && "Failed to allocate packed vertex buffer.");
+  }
+
+  for (uint32_t v = 0; v < num_vertices_; ++v) {
+    auto vertex = reinterpret_cast<const uint8_t *>(source + v);
+
+    for (uint32_t i = 0; i < kNumAttributes; ++i) {
+      const auto &attribute = packed_attributes_[i];
+      if (!attribute.size) {
+        continue;
+      }
+
+      auto in = reinterpret_cast<const float *>(vertex + kAttributeOffsets[i]);
+      uint8_t *dst = packed_vertex_buffer_ + attribute.offset + v * attribute.stride;
+      uint32_t count = GetComponentCount(i);
+
+      switch (attribute_formats_[i]) {
+        case ATTRIBUTE_FORMAT_FLOAT:
+          memcpy(dst, in, attribute.size);
+          break;
+
+        case ATTRIBUTE_FORMAT_D3DCOLOR:
+          dst[0] = ToUnsignedNormalizedByte(in[2]);
+          dst[1] = ToUnsignedNormalizedByte(in[1]);
+          dst[2] = ToUnsignedNormalizedByte(in[0]);
+          dst[3] = ToUnsignedNormalizedByte(in[3]);
+          break;
+
+        case ATTRIBUTE_FORMAT_SHORT:
+        case ATTRIBUTE_FORMAT_NORMALIZED_SHORT: {
+          auto shorts = reinterpret_cast<int16_t *>(dst);
+          const bool normalized = attribute_formats_[i] == ATTRIBUTE_FORMAT_NORMALIZED_SHORT;
+          for (uint32_t c = 0; c < count; ++c) {
+            shorts[c] = normalized ? static_cast<int16_t>(ToSignedNormalized(in[c], 32767)) : ToShort(in[c]);
+          }
+          if (count & 1) {
+            shorts[count] = 0;
+          }
+        } break;
+
+        case ATTRIBUTE_FORMAT_NORMPACKED3: {
+          uint32_t x = ToSignedNormalized(in[0], 1023) & 0x7FF;
+          uint32_t y = ToSignedNormalized(in[1], 1023) & 0x7FF;
+          uint32_t z = ToSignedNormalized(in[2], 511) & 0x3FF;
+          uint32_t packed = x | (y << 11) | (z << 22);
+          memcpy(dst, &packed, sizeof(packed));
+        } break;
+      }
+    }
+  }
+
+  packed_source_ = source;
+  packed_fields_ = enabled_fields;
+}
@@ -4,6 +4,8 @@
 #include <cstdint>
 #include <vector>
 
+#include "math3d.h"
+
 #define TO_BGRA(float_vals)                                                                      \
   (((uint32_t)((float_vals)[3] * 255.0f) << 24) + ((uint32_t)((float_vals)[0] * 255.0f) << 16) + \
    ((uint32_t)((float_vals)[1] * 255.0f) << 8) + ((uint32_t)((float_vals)[2] * 255.0f)))
@@ -194,6 +196,34 @@ struct Color {
 class TestHost;
 
 class VertexBuffer {
+ public:
+  // Storage formats for attributes fetched by the GPU (i.e., via DrawArrays, DrawInlineArray, and DrawInlineElements*).
+  enum AttributeFormat {
+    // 32-bit float per component.
+    ATTRIBUTE_FORMAT_FLOAT,
+    // 4 unsigned normalized bytes in D3DCOLOR (BGRA) order. Only valid for 4 component attributes.
+    ATTRIBUTE_FORMAT_D3DCOLOR,
+    // Signed 16-bit integer per component, not normalized (S32K).
+    ATTRIBUTE_FORMAT_SHORT,
+    // Signed normalized 16-bit integer per component (S1).
+    ATTRIBUTE_FORMAT_NORMALIZED_SHORT,
+    // 11:11:10 signed normalized components packed into a single dword (CMP). Only valid for 3 component attributes.
+    ATTRIBUTE_FORMAT_NORMPACKED3,
+  };
+
+  // Arrangement of the attributes fetched by the GPU.
+  enum Layout {
+    // Attributes are fetched directly from the Vertex array with a stride of sizeof(Vertex). Selecting any compact
+    // attribute format implies LAYOUT_INTERLEAVED.
+    LAYOUT_VERTEX,
+    // Only the enabled attributes are copied into a tightly packed interleaved array.
+    LAYOUT_INTERLEAVED,
+    // Each enabled attribute is copied into its own tightly packed array (structure of arrays).
+    LAYOUT_PLANAR,
+  };
+
+  static constexpr uint32_t kNumAttributes = 16;
+
  public:
   explicit VertexBuffer(uint32_t num_vertices);
   ~VertexBuffer();
@@ -202,7 +232,10 @@ class VertexBuffer {
   // buffer as a triangle strip.
   std::shared_ptr<VertexBuffer> ConvertFromTriangleStripToTriangles() const;
 
+  // Returns the vertex array, marking every vertex as modified.
   Vertex* Lock();
+  // Returns a pointer to vertex `start_index`, marking only `count` vertices from it as modified.
+  Vertex* Lock(uint32_t start_index, uint32_t count);
   void Unlock();
 
   uint32_t GetNumVertices() const { return num_vertices_; }
@@ -210,7 +243,11 @@ class VertexBuffer {
   void SetCacheValid(bool valid = true) { cache_valid_ = valid; }
   bool IsCacheValid() const { return cache_valid_; }
 
+  // Scales texcoord0 by the given texture dimensions when the buffer is used with linear textures.
   void Linearize(float texture_width, float texture_height);
+  // Scales the texcoords for the given stage by the given texture dimensions when the buffer is used with linear
+  // textures. The linear copy is rebuilt lazily at draw time, and only for vertices modified since the last draw.
+  void Linearize(uint32_t stage, float texture_width, float texture_height);
 
   // Defines a triangle with the give 3-element vertices.
   void DefineTriangleCCW(uint32_t start_index, const float* one, const float* two, const float* three);
@@ -258,17 +295,72 @@ class VertexBuffer {
   void SetDiffuse(uint32_t vertex_index, const Color& color);
   void SetSpecular(uint32_t vertex_index, const Color& color);
 
-  inline void SetPositionIncludesW(bool enabled = true) { position_count_ = enabled ? 4 : 3; }
-  inline void SetTexCoord0Count(uint32_t val) { tex0_coord_count_ = val; }
-  inline void SetTexCoord1Count(uint32_t val) { tex1_coord_count_ = val; }
-  inline void SetTexCoord2Count(uint32_t val) { tex2_coord_count_ = val; }
-  inline void SetTexCoord3Count(uint32_t val) { tex3_coord_count_ = val; }
+  inline void SetPositionIncludesW(bool enabled = true) {
+    position_count_ = enabled ? 4 : 3;
+    uniform_source_ = nullptr;
+  }
+  inline void SetTexCoord0Count(uint32_t val) {
+    tex0_coord_count_ = val;
+    uniform_source_ = nullptr;
+  }
+  inline void SetTexCoord1Count(uint32_t val) {
+    tex1_coord_count_ = val;
+    uniform_source_ = nullptr;
+  }
+  inline void SetTexCoord2Count(uint32_t val) {
+    tex2_coord_count_ = val;
+    uniform_source_ = nullptr;
+  }
+  inline void SetTexCoord3Count(uint32_t val) {
+    tex3_coord_count_ = val;
+    uniform_source_ = nullptr;
+  }
 
   void Translate(float x, float y, float z, float w = 0.0f);
+  // Replaces every vertex position with the result of vector_apply(position, matrix).
+  void Transform(const MATRIX matrix);
+
+  // Sets the format used to store the given NV2A_VERTEX_ATTR_* attribute in GPU visible memory. If any attribute uses a
+  // format other than ATTRIBUTE_FORMAT_FLOAT, the enabled attributes are repacked into a compact buffer whenever the
+  // vertices change; otherwise the Vertex array is used directly.
+  void SetAttributeFormat(uint32_t attribute_index, AttributeFormat format);
+  AttributeFormat GetAttributeFormat(uint32_t attribute_index) const { return attribute_formats_[attribute_index]; }
+  bool HasCompactAttributes() const { return num_compact_attributes_ > 0; }
+
+  // Sets the arrangement used for GPU fetched attributes. Non-vertex layouts are regenerated for the enabled attribute
+  // mask whenever the vertices or the mask change.
+  void SetLayout(Layout layout);
+  Layout GetLayout() const { return layout_; }
+
+  // Indicates whether the GPU fetches from the packed buffer rather than the Vertex array.
+  bool RequiresPacking() const { return layout_ != LAYOUT_VERTEX || HasCompactAttributes(); }
+
+  // Returns the subset of `enabled_fields` (a mask of 1 << NV2A_VERTEX_ATTR_*) whose attribute holds the same value in
+  // every vertex of `source`, i.e., attributes that may be fetched with a stride of 0. Results are cached until the
+  // vertices change.
+  uint32_t GetUniformFields(const Vertex* source, uint32_t enabled_fields);
 
  private:
   friend class TestHost;
 
+  struct PackedAttribute {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t stride;
+    // NV097_SET_VERTEX_DATA_ARRAY_FORMAT_TYPE/SIZE values.
+    uint32_t type;
+    uint32_t count;
+  };
+
+  void MarkDirty(uint32_t start_index, uint32_t count);
+  // Returns the vertices to use with linear textures, first updating any modified ones.
+  Vertex* GetLinearVertices();
+
+  // Number of float components present in the Vertex for the given attribute.
+  uint32_t GetComponentCount(uint32_t attribute_index) const;
+  // Rebuilds packed_vertex_buffer_ from the enabled attributes of the given (normalized or linear) vertices.
+  void Pack(const Vertex* source, uint32_t enabled_fields);
+
   uint32_t num_vertices_;
   Vertex* linear_vertex_buffer_ = nullptr;      // texcoords 0 to kFramebufferWidth/kFramebufferHeight
   Vertex* normalized_vertex_buffer_ = nullptr;  // texcoords normalized 0 to 1
@@ -283,6 +375,29 @@ class VertexBuffer {
   uint32_t tex3_coord_count_ = 2;
 
   bool cache_valid_{false};  // Indicates whether the HW should be forced to reload this buffer.
+
+  bool linearize_{false};
+  float linear_texcoord_scale_[4][2]{{1.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 1.0f}};
+  // Range of vertices [start, end) modified since linear_vertex_buffer_ was last updated.
+  uint32_t linear_dirty_start_{0};
+  uint32_t linear_dirty_end_{0};
+
+  AttributeFormat attribute_formats_[kNumAttributes]{};
+  uint32_t num_compact_attributes_{0};
+
+  // Copy of the enabled attributes in their storage formats, arranged according to layout_.
+  uint8_t* packed_vertex_buffer_ = nullptr;
+  uint32_t packed_buffer_size_{0};
+  uint32_t packed_stride_{0};
+  PackedAttribute packed_attributes_[kNumAttributes]{};
+  const Vertex* packed_source_{nullptr};
+  uint32_t packed_fields_{0};
+  Layout layout_{LAYOUT_VERTEX};
+
+  // Vertices last examined by GetUniformFields, the fields examined, and those found to be uniform.
+  const Vertex* uniform_source_{nullptr};
+  uint32_t uniform_checked_fields_{0};
+  uint32_t uniform_fields_{0};
 };
 
 #endif  // NXDK_PGRAPH_TESTS__VERTEX_BUFFER_H_
@@ -0,0 +1,129 @@
+#ifndef NXDK_PGRAPH_TESTS_VERTEX_EMITTERS_H
+#define NXDK_PGRAPH_TESTS_VERTEX_EMITTERS_H
+
+#include <pbkit/pbkit.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "nxdk_ext.h"
+#include "pbkit_ext.h"
+#include "vertex_buffer.h"
+
+// Per-vertex pushbuffer emitters used by the TestHost inline draw paths.
+//
+// Each emitter is specialized on a mask of (1 << NV2A_VERTEX_ATTR_*) fields. When the mask is a compile time constant
+// every field test folds away, leaving straight line code. kRuntimeVertexFields instead tests `enabled_fields` for
+// each vertex.
+static constexpr uint32_t kRuntimeVertexFields = 0xFFFFFFFF;
+
+// Emits `count` consecutive vertices starting at `vertex`, returning the advanced pushbuffer pointer.
+typedef uint32_t *(*InlineVertexEmitter)(uint32_t *p, const Vertex *vertex, uint32_t count, uint32_t enabled_fields,
+                                         bool position_is_4f);
+
+// Emits immediate mode SET_* methods for each vertex, as used by DrawInlineBuffer.
+template <uint32_t kFields>
+struct InlineBufferEmitter {
+  static uint32_t *Emit(uint32_t *p, const Vertex *vertex, uint32_t count, uint32_t enabled_fields,
+                        bool position_is_4f) {
+    for (uint32_t i = 0; i < count; ++i, ++vertex) {
+      p = EmitVertex(p, vertex, kFields == kRuntimeVertexFields ? enabled_fields : kFields, position_is_4f);
+    }
+    return p;
+  }
+
+ private:
+  static inline uint32_t *EmitVertex(uint32_t *p, const Vertex *vertex, uint32_t fields, bool position_is_4f) {
+    if (fields & (1 << NV2A_VERTEX_ATTR_WEIGHT)) {
+      p = pb_push1f(p, NV097_SET_WEIGHT1F, vertex->weight[0]);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_NORMAL)) {
+      p = pb_push3f(p, NV097_SET_NORMAL3F, vertex->normal[0], vertex->normal[1], vertex->normal[2]);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_DIFFUSE)) {
+      p = pb_push4f(p, NV097_SET_DIFFUSE_COLOR4F, vertex->diffuse[0], vertex->diffuse[1], vertex->diffuse[2],
+                    vertex->diffuse[3]);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_SPECULAR)) {
+      p = pb_push4f(p, NV097_SET_SPECULAR_COLOR4F, vertex->specular[0], vertex->specular[1], vertex->specular[2],
+                    vertex->specular[3]);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_FOG_COORD)) {
+      p = pb_push1f(p, NV097_SET_FOG_COORD, vertex->fog_coord);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_POINT_SIZE)) {
+      p = pb_push1f(p, NV097_SET_POINT_SIZE, vertex->point_size);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_TEXTURE0)) {
+      p = pb_push2f(p, NV097_SET_TEXCOORD0_2F, vertex->texcoord0[0], vertex->texcoord0[1]);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_TEXTURE1)) {
+      p = pb_push2f(p, NV097_SET_TEXCOORD1_2F, vertex->texcoord1[0], vertex->texcoord1[1]);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_TEXTURE2)) {
+      p = pb_push2f(p, NV097_SET_TEXCOORD2_2F, vertex->texcoord2[0], vertex->texcoord2[1]);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_TEXTURE3)) {
+      p = pb_push2f(p, NV097_SET_TEXCOORD3_2F, vertex->texcoord3[0], vertex->texcoord3[1]);
+    }
+
+    // Setting the position locks in the previously set values and must be done last.
+    if (fields & (1 << NV2A_VERTEX_ATTR_POSITION)) {
+      if (position_is_4f) {
+        p = pb_push4f(p, NV097_SET_VERTEX4F, vertex->pos[0], vertex->pos[1], vertex->pos[2], vertex->pos[3]);
+      } else {
+        p = pb_push3f(p, NV097_SET_VERTEX3F, vertex->pos[0], vertex->pos[1], vertex->pos[2]);
+      }
+    }
+    return p;
+  }
+};
+
+// Emits the INLINE_ARRAY parameters (without a method header) for each vertex, as used by DrawInlineArray.
+// Only POSITION, NORMAL, DIFFUSE, SPECULAR, and TEXCOORD0-3 are supported.
+template <uint32_t kFields>
+struct InlineArrayEmitter {
+  static uint32_t *Emit(uint32_t *p, const Vertex *vertex, uint32_t count, uint32_t enabled_fields,
+                        bool position_is_4f) {
+    for (uint32_t i = 0; i < count; ++i, ++vertex) {
+      p = EmitVertex(p, vertex, kFields == kRuntimeVertexFields ? enabled_fields : kFields, position_is_4f);
+    }
+    return p;
+  }
+
+ private:
+  static inline uint32_t *EmitVertex(uint32_t *p, const Vertex *vertex, uint32_t fields, bool position_is_4f) {
+    // Note: Ordering is important and must follow the NV2A_VERTEX_ATTR_POSITION, ... ordering.
+    auto copy = [&p](const float *values, uint32_t count) {
+      memcpy(p, values, count * sizeof(*p));
+      p += count;
+    };
+    if (fields & (1 << NV2A_VERTEX_ATTR_POSITION)) {
+      copy(vertex->pos, position_is_4f ? 4 : 3);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_NORMAL)) {
+      copy(vertex->normal, 3);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_DIFFUSE)) {
+      copy(vertex->diffuse, 4);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_SPECULAR)) {
+      copy(vertex->specular, 4);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_TEXTURE0)) {
+      copy(vertex->texcoord0, 2);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_TEXTURE1)) {
+      copy(vertex->texcoord1, 2);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_TEXTURE2)) {
+      copy(vertex->texcoord2, 2);
+    }
+    if (fields & (1 << NV2A_VERTEX_ATTR_TEXTURE3)) {
+      copy(vertex->texcoord3, 2);
+    }
+    return p;
+  }
+};
+
+#endif  // NXDK_PGRAPH_TESTS_VERTEX_EMITTERS_H